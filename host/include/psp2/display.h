@@ -0,0 +1,28 @@
+#ifndef _PSP2_DISPLAY_H_
+#define _PSP2_DISPLAY_H_
+
+#include <psp2/types.h>
+
+enum {
+	SCE_DISPLAY_PIXELFORMAT_A8B8G8R8 = 0x00000000,
+	SCE_DISPLAY_PIXELFORMAT_R5G6B5   = 0x50000000
+};
+
+typedef enum SceDisplaySetBufSync {
+	SCE_DISPLAY_SETBUF_IMMEDIATE = 0,
+	SCE_DISPLAY_SETBUF_NEXTFRAME = 1
+} SceDisplaySetBufSync;
+
+typedef struct SceDisplayFrameBuf {
+	SceSize size;
+	void *base;
+	unsigned int pitch;
+	unsigned int pixelformat;
+	unsigned int width;
+	unsigned int height;
+} SceDisplayFrameBuf;
+
+int sceDisplaySetFrameBuf(const SceDisplayFrameBuf *pParam, SceDisplaySetBufSync sync);
+int sceDisplayWaitVblankStart(void);
+
+#endif
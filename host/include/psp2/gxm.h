@@ -0,0 +1,458 @@
+#ifndef _PSP2_GXM_H_
+#define _PSP2_GXM_H_
+
+/*
+ * Host backend: the subset of libgxm used by gxmfun, with the same
+ * signatures as the VitaSDK. Objects that are opaque on the Vita are
+ * opaque here too, the surfaces and the command list are plain structs
+ * laid out for the software renderer.
+ */
+
+#include <psp2/types.h>
+
+#define SCE_GXM_DEFAULT_PARAMETER_BUFFER_SIZE          0x01000000
+#define SCE_GXM_DEFAULT_VDM_RING_BUFFER_SIZE           0x00020000
+#define SCE_GXM_DEFAULT_VERTEX_RING_BUFFER_SIZE        0x00200000
+#define SCE_GXM_DEFAULT_FRAGMENT_RING_BUFFER_SIZE      0x00080000
+#define SCE_GXM_DEFAULT_FRAGMENT_USSE_RING_BUFFER_SIZE 0x00004000
+
+#define SCE_GXM_MINIMUM_CONTEXT_HOST_MEM_SIZE          0x00000800
+#define SCE_GXM_MINIMUM_DEFERRED_CONTEXT_HOST_MEM_SIZE 0x00000800
+
+#define SCE_GXM_TILE_SIZEX 32
+#define SCE_GXM_TILE_SIZEY 32
+
+#define SCE_GXM_MAX_TEXTURE_UNITS 16
+
+#define SCE_GXM_ERROR_INVALID_VALUE        0x805B0001
+#define SCE_GXM_ERROR_INVALID_POINTER      0x805B0002
+#define SCE_GXM_ERROR_OUT_OF_MEMORY        0x805B0006
+#define SCE_GXM_ERROR_WITHIN_SCENE         0x805B0009
+#define SCE_GXM_ERROR_NOT_WITHIN_SCENE     0x805B000A
+#define SCE_GXM_ERROR_RESERVE_FAILED       0x805B0017
+#define SCE_GXM_ERROR_WITHIN_COMMAND_LIST  0x805B0021
+#define SCE_GXM_ERROR_INVALID_PROGRAM      0x805B0033
+
+typedef struct SceGxmContext SceGxmContext;
+typedef struct SceGxmRenderTarget SceGxmRenderTarget;
+typedef struct SceGxmSyncObject SceGxmSyncObject;
+typedef struct SceGxmShaderPatcher SceGxmShaderPatcher;
+typedef struct SceGxmProgram SceGxmProgram;
+typedef struct SceGxmProgramParameter SceGxmProgramParameter;
+typedef struct SceGxmVertexProgram SceGxmVertexProgram;
+typedef struct SceGxmFragmentProgram SceGxmFragmentProgram;
+typedef struct SceGxmRegisteredProgram SceGxmRegisteredProgram;
+typedef SceGxmRegisteredProgram *SceGxmShaderPatcherId;
+
+typedef enum SceGxmMemoryAttribFlags {
+	SCE_GXM_MEMORY_ATTRIB_READ  = 1,
+	SCE_GXM_MEMORY_ATTRIB_WRITE = 2,
+	SCE_GXM_MEMORY_ATTRIB_RW    = 3
+} SceGxmMemoryAttribFlags;
+
+typedef enum SceGxmColorFormat {
+	SCE_GXM_COLOR_FORMAT_A8B8G8R8   = 0x00000000,
+	SCE_GXM_COLOR_FORMAT_U5U6U5_RGB = 0x30100000
+} SceGxmColorFormat;
+
+typedef enum SceGxmColorSurfaceType {
+	SCE_GXM_COLOR_SURFACE_LINEAR = 0x00000000,
+	SCE_GXM_COLOR_SURFACE_TILED  = 0x04000000
+} SceGxmColorSurfaceType;
+
+typedef enum SceGxmColorSurfaceScaleMode {
+	SCE_GXM_COLOR_SURFACE_SCALE_NONE = 0x00000000
+} SceGxmColorSurfaceScaleMode;
+
+typedef enum SceGxmOutputRegisterSize {
+	SCE_GXM_OUTPUT_REGISTER_SIZE_32BIT = 0x00000000,
+	SCE_GXM_OUTPUT_REGISTER_SIZE_64BIT = 0x00000001
+} SceGxmOutputRegisterSize;
+
+typedef enum SceGxmTextureFormat {
+	SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR = 0x0C000000,
+	SCE_GXM_TEXTURE_FORMAT_U5U6U5_RGB    = 0x05001000,
+	SCE_GXM_TEXTURE_FORMAT_UBC1_ABGR     = 0x85000000,
+	SCE_GXM_TEXTURE_FORMAT_UBC3_ABGR     = 0x87000000
+} SceGxmTextureFormat;
+
+typedef enum SceGxmTextureFilter {
+	SCE_GXM_TEXTURE_FILTER_POINT  = 0x00000000,
+	SCE_GXM_TEXTURE_FILTER_LINEAR = 0x00000001
+} SceGxmTextureFilter;
+
+typedef enum SceGxmTextureMipFilter {
+	SCE_GXM_TEXTURE_MIP_FILTER_DISABLED = 0x00000000,
+	SCE_GXM_TEXTURE_MIP_FILTER_ENABLED  = 0x00000200
+} SceGxmTextureMipFilter;
+
+typedef enum SceGxmTextureAddrMode {
+	SCE_GXM_TEXTURE_ADDR_REPEAT = 0x00000000,
+	SCE_GXM_TEXTURE_ADDR_CLAMP  = 0x00000002
+} SceGxmTextureAddrMode;
+
+typedef enum SceGxmTextureType {
+	SCE_GXM_TEXTURE_SWIZZLED       = 0x00000000,
+	SCE_GXM_TEXTURE_LINEAR_STRIDED = 0x0C000000
+} SceGxmTextureType;
+
+typedef enum SceGxmDepthStencilFormat {
+	SCE_GXM_DEPTH_STENCIL_FORMAT_S8D24 = 0x01000000
+} SceGxmDepthStencilFormat;
+
+typedef enum SceGxmDepthStencilSurfaceType {
+	SCE_GXM_DEPTH_STENCIL_SURFACE_LINEAR = 0x00000000,
+	SCE_GXM_DEPTH_STENCIL_SURFACE_TILED  = 0x00011000
+} SceGxmDepthStencilSurfaceType;
+
+typedef enum SceGxmMultisampleMode {
+	SCE_GXM_MULTISAMPLE_NONE = 0
+} SceGxmMultisampleMode;
+
+typedef enum SceGxmOutputRegisterFormat {
+	SCE_GXM_OUTPUT_REGISTER_FORMAT_UCHAR4 = 4
+} SceGxmOutputRegisterFormat;
+
+typedef enum SceGxmAttributeFormat {
+	SCE_GXM_ATTRIBUTE_FORMAT_F32 = 9
+} SceGxmAttributeFormat;
+
+typedef enum SceGxmIndexSource {
+	SCE_GXM_INDEX_SOURCE_INDEX_16BIT = 0x0000
+} SceGxmIndexSource;
+
+typedef enum SceGxmIndexFormat {
+	SCE_GXM_INDEX_FORMAT_U16 = 0x00000000,
+	SCE_GXM_INDEX_FORMAT_U32 = 0x01000000
+} SceGxmIndexFormat;
+
+typedef enum SceGxmPrimitiveType {
+	SCE_GXM_PRIMITIVE_TRIANGLES      = 0x00000000,
+	SCE_GXM_PRIMITIVE_TRIANGLE_STRIP = 0x20000000
+} SceGxmPrimitiveType;
+
+typedef enum SceGxmColorMask {
+	SCE_GXM_COLOR_MASK_NONE = 0,
+	SCE_GXM_COLOR_MASK_A    = (1 << 0),
+	SCE_GXM_COLOR_MASK_R    = (1 << 1),
+	SCE_GXM_COLOR_MASK_G    = (1 << 2),
+	SCE_GXM_COLOR_MASK_B    = (1 << 3),
+	SCE_GXM_COLOR_MASK_ALL  = (SCE_GXM_COLOR_MASK_A | SCE_GXM_COLOR_MASK_B |
+		SCE_GXM_COLOR_MASK_G | SCE_GXM_COLOR_MASK_R)
+} SceGxmColorMask;
+
+typedef enum SceGxmBlendFunc {
+	SCE_GXM_BLEND_FUNC_NONE = 0
+} SceGxmBlendFunc;
+
+typedef enum SceGxmBlendFactor {
+	SCE_GXM_BLEND_FACTOR_ZERO = 0,
+	SCE_GXM_BLEND_FACTOR_ONE  = 1
+} SceGxmBlendFactor;
+
+typedef enum SceGxmStencilFunc {
+	SCE_GXM_STENCIL_FUNC_NEVER         = 0x00000000,
+	SCE_GXM_STENCIL_FUNC_LESS          = 0x02000000,
+	SCE_GXM_STENCIL_FUNC_EQUAL         = 0x04000000,
+	SCE_GXM_STENCIL_FUNC_LESS_EQUAL    = 0x06000000,
+	SCE_GXM_STENCIL_FUNC_GREATER       = 0x08000000,
+	SCE_GXM_STENCIL_FUNC_NOT_EQUAL     = 0x0a000000,
+	SCE_GXM_STENCIL_FUNC_GREATER_EQUAL = 0x0c000000,
+	SCE_GXM_STENCIL_FUNC_ALWAYS        = 0x0e000000
+} SceGxmStencilFunc;
+
+typedef enum SceGxmStencilOp {
+	SCE_GXM_STENCIL_OP_KEEP      = 0x00000000,
+	SCE_GXM_STENCIL_OP_ZERO      = 0x00000001,
+	SCE_GXM_STENCIL_OP_REPLACE   = 0x00000002,
+	SCE_GXM_STENCIL_OP_INCR      = 0x00000003,
+	SCE_GXM_STENCIL_OP_DECR      = 0x00000004,
+	SCE_GXM_STENCIL_OP_INVERT    = 0x00000005,
+	SCE_GXM_STENCIL_OP_INCR_WRAP = 0x00000006,
+	SCE_GXM_STENCIL_OP_DECR_WRAP = 0x00000007
+} SceGxmStencilOp;
+
+typedef enum SceGxmDepthFunc {
+	SCE_GXM_DEPTH_FUNC_NEVER         = 0x00000000,
+	SCE_GXM_DEPTH_FUNC_LESS          = 0x00400000,
+	SCE_GXM_DEPTH_FUNC_EQUAL         = 0x00800000,
+	SCE_GXM_DEPTH_FUNC_LESS_EQUAL    = 0x00c00000,
+	SCE_GXM_DEPTH_FUNC_GREATER       = 0x01000000,
+	SCE_GXM_DEPTH_FUNC_NOT_EQUAL     = 0x01400000,
+	SCE_GXM_DEPTH_FUNC_GREATER_EQUAL = 0x01800000,
+	SCE_GXM_DEPTH_FUNC_ALWAYS        = 0x01c00000
+} SceGxmDepthFunc;
+
+typedef enum SceGxmDepthWriteMode {
+	SCE_GXM_DEPTH_WRITE_DISABLED = 0x00100000,
+	SCE_GXM_DEPTH_WRITE_ENABLED  = 0x00000000
+} SceGxmDepthWriteMode;
+
+typedef struct SceGxmValidRegion {
+	unsigned int xMin;
+	unsigned int yMin;
+	unsigned int xMax;
+	unsigned int yMax;
+} SceGxmValidRegion;
+
+typedef struct SceGxmNotification {
+	volatile unsigned int *address;
+	unsigned int value;
+} SceGxmNotification;
+
+typedef struct SceGxmColorSurface {
+	SceGxmColorFormat colorFormat;
+	SceGxmColorSurfaceType surfaceType;
+	unsigned int width;
+	unsigned int height;
+	unsigned int strideInPixels;
+	void *data;
+} SceGxmColorSurface;
+
+/* The host keeps depth and stencil packed as S8D24 words in depthData */
+typedef struct SceGxmDepthStencilSurface {
+	SceGxmDepthStencilFormat format;
+	SceGxmDepthStencilSurfaceType surfaceType;
+	unsigned int strideInSamples;
+	void *depthData;
+	void *stencilData;
+	float backgroundDepth;
+	unsigned char backgroundStencil;
+} SceGxmDepthStencilSurface;
+
+/* Control words on the Vita, laid out for the software sampler here */
+typedef struct SceGxmTexture {
+	SceGxmTextureFormat format;
+	unsigned int width;
+	unsigned int height;
+	unsigned int byteStride;
+	SceGxmTextureFilter minFilter;
+	SceGxmTextureFilter magFilter;
+	SceGxmTextureMipFilter mipFilter;
+	SceGxmTextureAddrMode uAddrMode;
+	SceGxmTextureAddrMode vAddrMode;
+	/* Levels from the full size down, 1 for linear textures */
+	unsigned int mipCount;
+	/* Texels, or 4x4 blocks of compressed formats, in Morton order, with no stride */
+	int swizzled;
+	const void *data;
+} SceGxmTexture;
+
+typedef struct SceGxmCommandList {
+	void *commands;
+	unsigned int size;
+} SceGxmCommandList;
+
+typedef struct SceGxmBlendInfo {
+	unsigned char colorMask;
+	unsigned char colorFunc;
+	unsigned char alphaFunc;
+	unsigned char colorSrc;
+	unsigned char colorDst;
+	unsigned char alphaSrc;
+	unsigned char alphaDst;
+} SceGxmBlendInfo;
+
+typedef struct SceGxmVertexAttribute {
+	unsigned short streamIndex;
+	unsigned short offset;
+	unsigned char format;
+	unsigned char componentCount;
+	unsigned short regIndex;
+} SceGxmVertexAttribute;
+
+typedef struct SceGxmVertexStream {
+	unsigned short stride;
+	unsigned short indexSource;
+} SceGxmVertexStream;
+
+typedef void (SceGxmDisplayQueueCallback)(const void *callbackData);
+
+typedef struct SceGxmInitializeParams {
+	unsigned int flags;
+	unsigned int displayQueueMaxPendingCount;
+	SceGxmDisplayQueueCallback *displayQueueCallback;
+	unsigned int displayQueueCallbackDataSize;
+	SceSize parameterBufferSize;
+} SceGxmInitializeParams;
+
+typedef struct SceGxmContextParams {
+	void *hostMem;
+	SceSize hostMemSize;
+	void *vdmRingBufferMem;
+	SceSize vdmRingBufferMemSize;
+	void *vertexRingBufferMem;
+	SceSize vertexRingBufferMemSize;
+	void *fragmentRingBufferMem;
+	SceSize fragmentRingBufferMemSize;
+	void *fragmentUsseRingBufferMem;
+	SceSize fragmentUsseRingBufferMemSize;
+	unsigned int fragmentUsseRingBufferOffset;
+} SceGxmContextParams;
+
+typedef void *(SceGxmDeferredContextCallback)(void *userData, unsigned int minSize, unsigned int *size);
+
+typedef struct SceGxmDeferredContextParams {
+	void *hostMem;
+	SceSize hostMemSize;
+	SceGxmDeferredContextCallback *vdmCallback;
+	SceGxmDeferredContextCallback *vertexCallback;
+	SceGxmDeferredContextCallback *fragmentCallback;
+	void *userData;
+} SceGxmDeferredContextParams;
+
+typedef struct SceGxmRenderTargetParams {
+	unsigned int flags;
+	unsigned short width;
+	unsigned short height;
+	unsigned short scenesPerFrame;
+	unsigned short multisampleMode;
+	unsigned int multisampleLocations;
+	SceUID driverMemBlock;
+} SceGxmRenderTargetParams;
+
+typedef void *(SceGxmShaderPatcherHostAllocCallback)(void *userData, unsigned int size);
+typedef void (SceGxmShaderPatcherHostFreeCallback)(void *userData, void *mem);
+typedef void *(SceGxmShaderPatcherBufferAllocCallback)(void *userData, unsigned int size);
+typedef void (SceGxmShaderPatcherBufferFreeCallback)(void *userData, void *mem);
+typedef void *(SceGxmShaderPatcherUsseAllocCallback)(void *userData, unsigned int size, unsigned int *usseOffset);
+typedef void (SceGxmShaderPatcherUsseFreeCallback)(void *userData, void *mem);
+
+typedef struct SceGxmShaderPatcherParams {
+	void *userData;
+	SceGxmShaderPatcherHostAllocCallback *hostAllocCallback;
+	SceGxmShaderPatcherHostFreeCallback *hostFreeCallback;
+	SceGxmShaderPatcherBufferAllocCallback *bufferAllocCallback;
+	SceGxmShaderPatcherBufferFreeCallback *bufferFreeCallback;
+	void *bufferMem;
+	SceSize bufferMemSize;
+	SceGxmShaderPatcherUsseAllocCallback *vertexUsseAllocCallback;
+	SceGxmShaderPatcherUsseFreeCallback *vertexUsseFreeCallback;
+	void *vertexUsseMem;
+	SceSize vertexUsseMemSize;
+	unsigned int vertexUsseOffset;
+	SceGxmShaderPatcherUsseAllocCallback *fragmentUsseAllocCallback;
+	SceGxmShaderPatcherUsseFreeCallback *fragmentUsseFreeCallback;
+	void *fragmentUsseMem;
+	SceSize fragmentUsseMemSize;
+	unsigned int fragmentUsseOffset;
+} SceGxmShaderPatcherParams;
+
+int sceGxmInitialize(const SceGxmInitializeParams *params);
+int sceGxmTerminate(void);
+
+int sceGxmCreateContext(const SceGxmContextParams *params, SceGxmContext **context);
+int sceGxmDestroyContext(SceGxmContext *context);
+int sceGxmCreateDeferredContext(const SceGxmDeferredContextParams *params, SceGxmContext **deferredContext);
+int sceGxmDestroyDeferredContext(SceGxmContext *deferredContext);
+int sceGxmBeginCommandList(SceGxmContext *deferredContext);
+int sceGxmEndCommandList(SceGxmContext *deferredContext, SceGxmCommandList *commandList);
+int sceGxmExecuteCommandList(SceGxmContext *context, SceGxmCommandList *commandList);
+
+int sceGxmCreateRenderTarget(const SceGxmRenderTargetParams *params, SceGxmRenderTarget **renderTarget);
+int sceGxmDestroyRenderTarget(SceGxmRenderTarget *renderTarget);
+
+int sceGxmColorSurfaceInit(SceGxmColorSurface *surface, SceGxmColorFormat colorFormat,
+	SceGxmColorSurfaceType surfaceType, SceGxmColorSurfaceScaleMode scaleMode,
+	SceGxmOutputRegisterSize outputRegisterSize, unsigned int width, unsigned int height,
+	unsigned int strideInPixels, void *data);
+void *sceGxmColorSurfaceGetData(const SceGxmColorSurface *surface);
+SceGxmColorFormat sceGxmColorSurfaceGetFormat(const SceGxmColorSurface *surface);
+unsigned int sceGxmColorSurfaceGetStrideInPixels(const SceGxmColorSurface *surface);
+int sceGxmDepthStencilSurfaceInit(SceGxmDepthStencilSurface *surface,
+	SceGxmDepthStencilFormat depthStencilFormat, SceGxmDepthStencilSurfaceType surfaceType,
+	unsigned int strideInSamples, void *depthData, void *stencilData);
+
+int sceGxmTextureInitLinearStrided(SceGxmTexture *texture, const void *data,
+	SceGxmTextureFormat texFormat, unsigned int width, unsigned int height,
+	unsigned int byteStride);
+int sceGxmTextureSetMinFilter(SceGxmTexture *texture, SceGxmTextureFilter minFilter);
+int sceGxmTextureSetMagFilter(SceGxmTexture *texture, SceGxmTextureFilter magFilter);
+int sceGxmTextureInitSwizzled(SceGxmTexture *texture, const void *data,
+	SceGxmTextureFormat texFormat, unsigned int width, unsigned int height,
+	unsigned int mipCount);
+int sceGxmTextureSetMipFilter(SceGxmTexture *texture, SceGxmTextureMipFilter mipFilter);
+int sceGxmTextureSetUAddrMode(SceGxmTexture *texture, SceGxmTextureAddrMode mode);
+int sceGxmTextureSetVAddrMode(SceGxmTexture *texture, SceGxmTextureAddrMode mode);
+void *sceGxmTextureGetData(const SceGxmTexture *texture);
+SceGxmTextureType sceGxmTextureGetType(const SceGxmTexture *texture);
+SceGxmTextureFormat sceGxmTextureGetFormat(const SceGxmTexture *texture);
+unsigned int sceGxmTextureGetWidth(const SceGxmTexture *texture);
+unsigned int sceGxmTextureGetHeight(const SceGxmTexture *texture);
+/* Bytes per row of linear strided textures */
+unsigned int sceGxmTextureGetStride(const SceGxmTexture *texture);
+unsigned int sceGxmTextureGetMipmapCount(const SceGxmTexture *texture);
+SceGxmTextureFilter sceGxmTextureGetMinFilter(const SceGxmTexture *texture);
+SceGxmTextureFilter sceGxmTextureGetMagFilter(const SceGxmTexture *texture);
+SceGxmTextureMipFilter sceGxmTextureGetMipFilter(const SceGxmTexture *texture);
+SceGxmTextureAddrMode sceGxmTextureGetUAddrMode(const SceGxmTexture *texture);
+SceGxmTextureAddrMode sceGxmTextureGetVAddrMode(const SceGxmTexture *texture);
+
+int sceGxmSyncObjectCreate(SceGxmSyncObject **syncObject);
+int sceGxmSyncObjectDestroy(SceGxmSyncObject *syncObject);
+
+int sceGxmShaderPatcherCreate(const SceGxmShaderPatcherParams *params, SceGxmShaderPatcher **shaderPatcher);
+int sceGxmShaderPatcherDestroy(SceGxmShaderPatcher *shaderPatcher);
+int sceGxmShaderPatcherRegisterProgram(SceGxmShaderPatcher *shaderPatcher,
+	const SceGxmProgram *programHeader, SceGxmShaderPatcherId *programId);
+int sceGxmShaderPatcherUnregisterProgram(SceGxmShaderPatcher *shaderPatcher, SceGxmShaderPatcherId programId);
+const SceGxmProgram *sceGxmShaderPatcherGetProgramFromId(SceGxmShaderPatcherId programId);
+int sceGxmShaderPatcherCreateVertexProgram(SceGxmShaderPatcher *shaderPatcher,
+	SceGxmShaderPatcherId programId, const SceGxmVertexAttribute *attributes,
+	unsigned int attributeCount, const SceGxmVertexStream *streams, unsigned int streamCount,
+	SceGxmVertexProgram **vertexProgram);
+int sceGxmShaderPatcherCreateFragmentProgram(SceGxmShaderPatcher *shaderPatcher,
+	SceGxmShaderPatcherId programId, SceGxmOutputRegisterFormat outputFormat,
+	SceGxmMultisampleMode multisampleMode, const SceGxmBlendInfo *blendInfo,
+	const SceGxmProgram *vertexProgram, SceGxmFragmentProgram **fragmentProgram);
+int sceGxmShaderPatcherReleaseVertexProgram(SceGxmShaderPatcher *shaderPatcher, SceGxmVertexProgram *vertexProgram);
+int sceGxmShaderPatcherReleaseFragmentProgram(SceGxmShaderPatcher *shaderPatcher, SceGxmFragmentProgram *fragmentProgram);
+
+unsigned int sceGxmProgramGetSize(const SceGxmProgram *program);
+unsigned int sceGxmProgramGetParameterCount(const SceGxmProgram *program);
+const SceGxmProgramParameter *sceGxmProgramGetParameter(const SceGxmProgram *program, unsigned int index);
+const SceGxmProgramParameter *sceGxmProgramFindParameterByName(const SceGxmProgram *program, const char *name);
+unsigned int sceGxmProgramParameterGetIndex(const SceGxmProgram *program, const SceGxmProgramParameter *parameter);
+unsigned int sceGxmProgramParameterGetResourceIndex(const SceGxmProgramParameter *parameter);
+
+int sceGxmBeginScene(SceGxmContext *context, unsigned int flags,
+	const SceGxmRenderTarget *renderTarget, const SceGxmValidRegion *validRegion,
+	SceGxmSyncObject *vertexSyncObject, SceGxmSyncObject *fragmentSyncObject,
+	const SceGxmColorSurface *colorSurface, const SceGxmDepthStencilSurface *depthStencil);
+int sceGxmEndScene(SceGxmContext *context, const SceGxmNotification *vertexNotification,
+	const SceGxmNotification *fragmentNotification);
+
+void sceGxmSetVertexProgram(SceGxmContext *context, const SceGxmVertexProgram *vertexProgram);
+void sceGxmSetFragmentProgram(SceGxmContext *context, const SceGxmFragmentProgram *fragmentProgram);
+int sceGxmReserveVertexDefaultUniformBuffer(SceGxmContext *context, void **uniformBuffer);
+int sceGxmReserveFragmentDefaultUniformBuffer(SceGxmContext *context, void **uniformBuffer);
+int sceGxmSetUniformDataF(void *uniformBuffer, const SceGxmProgramParameter *parameter,
+	unsigned int componentOffset, unsigned int componentCount, const float *sourceData);
+
+void sceGxmSetFrontStencilFunc(SceGxmContext *context, SceGxmStencilFunc func,
+	SceGxmStencilOp stencilFail, SceGxmStencilOp depthFail, SceGxmStencilOp depthPass,
+	unsigned char compareMask, unsigned char writeMask);
+void sceGxmSetFrontStencilRef(SceGxmContext *context, unsigned int sref);
+void sceGxmSetFrontDepthWriteEnable(SceGxmContext *context, SceGxmDepthWriteMode enable);
+void sceGxmSetFrontDepthFunc(SceGxmContext *context, SceGxmDepthFunc depthFunc);
+void sceGxmSetViewport(SceGxmContext *context, float xOffset, float xScale, float yOffset,
+	float yScale, float zOffset, float zScale);
+
+int sceGxmSetVertexStream(SceGxmContext *context, unsigned int streamIndex, const void *streamData);
+int sceGxmSetFragmentTexture(SceGxmContext *context, unsigned int textureIndex, const SceGxmTexture *texture);
+int sceGxmDraw(SceGxmContext *context, SceGxmPrimitiveType primType, SceGxmIndexFormat indexType,
+	const void *indexData, unsigned int indexCount);
+
+int sceGxmPadHeartbeat(const SceGxmColorSurface *displaySurface, SceGxmSyncObject *displaySyncObject);
+int sceGxmDisplayQueueAddEntry(SceGxmSyncObject *oldBuffer, SceGxmSyncObject *newBuffer, const void *callbackData);
+int sceGxmDisplayQueueFinish(void);
+void sceGxmFinish(SceGxmContext *context);
+
+int sceGxmMapMemory(void *base, SceSize size, SceGxmMemoryAttribFlags attr);
+int sceGxmUnmapMemory(void *base);
+int sceGxmMapVertexUsseMemory(void *base, SceSize size, unsigned int *offset);
+int sceGxmUnmapVertexUsseMemory(void *base);
+int sceGxmMapFragmentUsseMemory(void *base, SceSize size, unsigned int *offset);
+int sceGxmUnmapFragmentUsseMemory(void *base);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _PSP2_IO_FCNTL_H_
+#define _PSP2_IO_FCNTL_H_
+
+#include <psp2/types.h>
+
+/*
+ * Host backend: the file API is a stand-in over the host's files, paths
+ * are host paths.
+ */
+
+#define SCE_O_RDONLY 0x0001
+
+typedef enum SceIoSeekMode {
+	SCE_SEEK_SET,
+	SCE_SEEK_CUR,
+	SCE_SEEK_END
+} SceIoSeekMode;
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode);
+int sceIoClose(SceUID fd);
+int sceIoRead(SceUID fd, void *buf, SceSize nbyte);
+/* Read at offset without moving the file position, safe from several threads */
+int sceIoPread(SceUID fd, void *data, SceSize size, SceOff offset);
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _PSP2_KERNEL_PROCESSMGR_H_
+#define _PSP2_KERNEL_PROCESSMGR_H_
+
+#include <psp2/types.h>
+
+/* Microseconds since the process started */
+SceUInt64 sceKernelGetProcessTimeWide(void);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _PSP2_KERNEL_SYSMEM_H_
+#define _PSP2_KERNEL_SYSMEM_H_
+
+#include <psp2/types.h>
+
+typedef enum SceKernelMemBlockType {
+	SCE_KERNEL_MEMBLOCK_TYPE_USER_RW              = 0x0C20D060,
+	SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE      = 0x0C208060,
+	SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW        = 0x09408060,
+	SCE_KERNEL_MEMBLOCK_TYPE_USER_MAIN_PHYCONT_RW = 0x0C80D060
+} SceKernelMemBlockType;
+
+SceUID sceKernelAllocMemBlock(const char *name, SceKernelMemBlockType type, SceSize size, void *optp);
+int sceKernelFreeMemBlock(SceUID uid);
+int sceKernelGetMemBlockBase(SceUID uid, void **basep);
+
+#endif
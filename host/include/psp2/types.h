@@ -0,0 +1,17 @@
+#ifndef _PSP2_TYPES_H_
+#define _PSP2_TYPES_H_
+
+/*
+ * Host backend: the subset of the VitaSDK types used by gxmfun.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int SceUID;
+typedef unsigned int SceSize;
+typedef uint64_t SceUInt64;
+typedef int64_t SceOff;
+typedef int SceMode;
+
+#endif
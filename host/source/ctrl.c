@@ -0,0 +1,22 @@
+#include <string.h>
+#include <psp2/ctrl.h>
+
+int sceCtrlSetSamplingMode(SceCtrlPadInputMode mode)
+{
+	return 0;
+}
+
+int sceCtrlPeekBufferPositive(int port, SceCtrlData *pad_data, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		memset(&pad_data[i], 0, sizeof(pad_data[i]));
+		pad_data[i].lx = 128;
+		pad_data[i].ly = 128;
+		pad_data[i].rx = 128;
+		pad_data[i].ry = 128;
+	}
+
+	return count;
+}
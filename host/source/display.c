@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <psp2/display.h>
+
+/*
+ * Host display: there is no screen, but A8B8G8R8 and R5G6B5 frames can be
+ * dumped as PPM images. GXMFUN_HOST_DUMP is a printf pattern taking the
+ * frame number (e.g. "frame_%04u.ppm") and GXMFUN_HOST_DUMP_INTERVAL
+ * selects every Nth frame (1 by default).
+ */
+
+#define VBLANK_NS (1000000000ull / 60)
+
+static unsigned int frame_count;
+static uint64_t next_vblank_ns;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void dump_frame(const SceDisplayFrameBuf *fb, const char *pattern, unsigned int frame)
+{
+	char path[256];
+	unsigned char *row;
+	unsigned int x, y;
+	FILE *file;
+
+	snprintf(path, sizeof(path), pattern, frame);
+
+	file = fopen(path, "wb");
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return;
+	}
+
+	row = malloc(fb->width * 3);
+	if (!row) {
+		fclose(file);
+		return;
+	}
+
+	fprintf(file, "P6\n%u %u\n255\n", fb->width, fb->height);
+
+	for (y = 0; y < fb->height; y++) {
+		if (fb->pixelformat == SCE_DISPLAY_PIXELFORMAT_R5G6B5) {
+			const uint16_t *src = (const uint16_t *)fb->base + y * fb->pitch;
+
+			for (x = 0; x < fb->width; x++) {
+				unsigned int r = src[x] >> 11, g = (src[x] >> 5) & 0x3F, b = src[x] & 0x1F;
+
+				row[x * 3 + 0] = (r << 3) | (r >> 2);
+				row[x * 3 + 1] = (g << 2) | (g >> 4);
+				row[x * 3 + 2] = (b << 3) | (b >> 2);
+			}
+		} else {
+			const uint32_t *src = (const uint32_t *)fb->base + y * fb->pitch;
+
+			for (x = 0; x < fb->width; x++) {
+				row[x * 3 + 0] = src[x] & 0xFF;
+				row[x * 3 + 1] = (src[x] >> 8) & 0xFF;
+				row[x * 3 + 2] = (src[x] >> 16) & 0xFF;
+			}
+		}
+		fwrite(row, 3, fb->width, file);
+	}
+
+	free(row);
+	fclose(file);
+}
+
+int sceDisplaySetFrameBuf(const SceDisplayFrameBuf *pParam, SceDisplaySetBufSync sync)
+{
+	const char *pattern = getenv("GXMFUN_HOST_DUMP");
+	const char *interval_env = getenv("GXMFUN_HOST_DUMP_INTERVAL");
+	unsigned int interval = interval_env ? strtoul(interval_env, NULL, 10) : 1;
+	unsigned int frame = frame_count++;
+
+	if (!pParam || !pParam->base)
+		return -1;
+
+	if (pattern && (interval <= 1 || frame % interval == 0))
+		dump_frame(pParam, pattern, frame);
+
+	return 0;
+}
+
+int sceDisplayWaitVblankStart(void)
+{
+	uint64_t now = now_ns();
+	struct timespec ts;
+
+	if (next_vblank_ns <= now)
+		next_vblank_ns = now + VBLANK_NS;
+
+	ts.tv_sec = (next_vblank_ns - now) / 1000000000;
+	ts.tv_nsec = (next_vblank_ns - now) % 1000000000;
+	nanosleep(&ts, NULL);
+	next_vblank_ns += VBLANK_NS;
+
+	return 0;
+}
@@ -0,0 +1,959 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "gxm_internal.h"
+
+/*
+ * Host libgxm. The immediate context rasterizes every draw as soon as it
+ * is submitted, so a scene is complete when sceGxmEndScene() returns.
+ * Deferred contexts record draws, together with a copy of the render
+ * state, into memory handed out by their callbacks.
+ */
+
+#define ALIGN(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
+
+#define HOST_GXM_DISPLAY_QUEUE_SIZE 8
+
+enum host_gxm_command_type {
+	HOST_GXM_COMMAND_DRAW,
+	/* Continue in the next chunk of command memory */
+	HOST_GXM_COMMAND_JUMP,
+	HOST_GXM_COMMAND_END
+};
+
+struct host_gxm_command {
+	enum host_gxm_command_type type;
+	union {
+		struct host_gxm_draw draw;
+		struct host_gxm_command *next;
+	};
+};
+
+struct display_queue_entry {
+	SceGxmSyncObject *old_buffer;
+	SceGxmSyncObject *new_buffer;
+	void *callback_data;
+};
+
+static struct {
+	SceGxmInitializeParams params;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int running;
+	struct display_queue_entry entries[HOST_GXM_DISPLAY_QUEUE_SIZE];
+	char *callback_data;
+	unsigned int head;
+	unsigned int count;
+	/* An entry was taken off the queue but its callback is still running */
+	int flipping;
+} display_queue;
+
+static void *display_queue_thread(void *arg)
+{
+	struct display_queue_entry *entry;
+
+	pthread_mutex_lock(&display_queue.lock);
+
+	for (;;) {
+		while (display_queue.running && !display_queue.count)
+			pthread_cond_wait(&display_queue.cond, &display_queue.lock);
+		if (!display_queue.count)
+			break;
+
+		entry = &display_queue.entries[display_queue.head];
+		display_queue.flipping = 1;
+		pthread_mutex_unlock(&display_queue.lock);
+
+		if (display_queue.params.displayQueueCallback)
+			display_queue.params.displayQueueCallback(entry->callback_data);
+
+		pthread_mutex_lock(&display_queue.lock);
+		/* The old buffer is no longer scanned out */
+		if (entry->old_buffer && entry->old_buffer->busy)
+			entry->old_buffer->busy--;
+		display_queue.head = (display_queue.head + 1) % HOST_GXM_DISPLAY_QUEUE_SIZE;
+		display_queue.count--;
+		display_queue.flipping = 0;
+		pthread_cond_broadcast(&display_queue.cond);
+	}
+
+	pthread_mutex_unlock(&display_queue.lock);
+
+	return NULL;
+}
+
+int sceGxmInitialize(const SceGxmInitializeParams *params)
+{
+	unsigned int i, data_size;
+
+	if (!params)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	memset(&display_queue, 0, sizeof(display_queue));
+	display_queue.params = *params;
+	if (display_queue.params.displayQueueMaxPendingCount < 1)
+		display_queue.params.displayQueueMaxPendingCount = 1;
+	if (display_queue.params.displayQueueMaxPendingCount > HOST_GXM_DISPLAY_QUEUE_SIZE)
+		display_queue.params.displayQueueMaxPendingCount = HOST_GXM_DISPLAY_QUEUE_SIZE;
+
+	data_size = ALIGN(params->displayQueueCallbackDataSize, 16);
+	display_queue.callback_data = calloc(HOST_GXM_DISPLAY_QUEUE_SIZE, data_size ? data_size : 16);
+	if (!display_queue.callback_data)
+		return SCE_GXM_ERROR_OUT_OF_MEMORY;
+	for (i = 0; i < HOST_GXM_DISPLAY_QUEUE_SIZE; i++)
+		display_queue.entries[i].callback_data = display_queue.callback_data + i * data_size;
+
+	pthread_mutex_init(&display_queue.lock, NULL);
+	pthread_cond_init(&display_queue.cond, NULL);
+	display_queue.running = 1;
+	if (pthread_create(&display_queue.thread, NULL, display_queue_thread, NULL) != 0) {
+		free(display_queue.callback_data);
+		return SCE_GXM_ERROR_OUT_OF_MEMORY;
+	}
+
+	host_gxm_raster_init();
+
+	return 0;
+}
+
+int sceGxmTerminate(void)
+{
+	pthread_mutex_lock(&display_queue.lock);
+	display_queue.running = 0;
+	pthread_cond_broadcast(&display_queue.cond);
+	pthread_mutex_unlock(&display_queue.lock);
+
+	pthread_join(display_queue.thread, NULL);
+	pthread_cond_destroy(&display_queue.cond);
+	pthread_mutex_destroy(&display_queue.lock);
+	free(display_queue.callback_data);
+
+	host_gxm_raster_terminate();
+
+	return 0;
+}
+
+int sceGxmDisplayQueueAddEntry(SceGxmSyncObject *oldBuffer, SceGxmSyncObject *newBuffer, const void *callbackData)
+{
+	struct display_queue_entry *entry;
+
+	pthread_mutex_lock(&display_queue.lock);
+
+	while (display_queue.count >= display_queue.params.displayQueueMaxPendingCount)
+		pthread_cond_wait(&display_queue.cond, &display_queue.lock);
+
+	entry = &display_queue.entries[(display_queue.head + display_queue.count) %
+		HOST_GXM_DISPLAY_QUEUE_SIZE];
+	entry->old_buffer = oldBuffer;
+	entry->new_buffer = newBuffer;
+	memcpy(entry->callback_data, callbackData, display_queue.params.displayQueueCallbackDataSize);
+	if (newBuffer)
+		newBuffer->busy++;
+	display_queue.count++;
+
+	pthread_cond_broadcast(&display_queue.cond);
+	pthread_mutex_unlock(&display_queue.lock);
+
+	return 0;
+}
+
+int sceGxmDisplayQueueFinish(void)
+{
+	pthread_mutex_lock(&display_queue.lock);
+	while (display_queue.count)
+		pthread_cond_wait(&display_queue.cond, &display_queue.lock);
+	pthread_mutex_unlock(&display_queue.lock);
+
+	return 0;
+}
+
+/* Wait until the display no longer needs the buffer guarded by sync_object */
+void host_gxm_sync_object_wait(SceGxmSyncObject *sync_object)
+{
+	pthread_mutex_lock(&display_queue.lock);
+	while (sync_object->busy)
+		pthread_cond_wait(&display_queue.cond, &display_queue.lock);
+	pthread_mutex_unlock(&display_queue.lock);
+}
+
+int sceGxmSyncObjectCreate(SceGxmSyncObject **syncObject)
+{
+	*syncObject = calloc(1, sizeof(**syncObject));
+
+	return *syncObject ? 0 : SCE_GXM_ERROR_OUT_OF_MEMORY;
+}
+
+int sceGxmSyncObjectDestroy(SceGxmSyncObject *syncObject)
+{
+	free(syncObject);
+
+	return 0;
+}
+
+int sceGxmPadHeartbeat(const SceGxmColorSurface *displaySurface, SceGxmSyncObject *displaySyncObject)
+{
+	return 0;
+}
+
+static void state_init_default(struct host_gxm_state *state)
+{
+	memset(state, 0, sizeof(*state));
+	state->depth_func = SCE_GXM_DEPTH_FUNC_ALWAYS;
+	state->depth_write = SCE_GXM_DEPTH_WRITE_ENABLED;
+	state->stencil_func = SCE_GXM_STENCIL_FUNC_ALWAYS;
+	state->stencil_fail = SCE_GXM_STENCIL_OP_KEEP;
+	state->depth_fail = SCE_GXM_STENCIL_OP_KEEP;
+	state->depth_pass = SCE_GXM_STENCIL_OP_KEEP;
+	state->stencil_compare_mask = 0xFF;
+	state->stencil_write_mask = 0xFF;
+}
+
+static void heap_init(struct host_gxm_heap *heap, void *base, unsigned int size,
+	SceGxmDeferredContextCallback *callback)
+{
+	heap->base = base;
+	heap->size = size;
+	heap->offset = 0;
+	heap->callback = callback;
+}
+
+static void *heap_alloc(struct host_gxm_heap *heap, void *user_data, unsigned int size)
+{
+	unsigned int offset = ALIGN(heap->offset, 16);
+	void *mem;
+
+	if (!heap->base || offset + size > heap->size) {
+		if (heap->callback) {
+			/* Deferred: ask for a new chunk */
+			unsigned int chunk_size = 0;
+
+			heap->base = heap->callback(user_data, size, &chunk_size);
+			heap->size = heap->base ? chunk_size : 0;
+		} else if (size > heap->size) {
+			return NULL;
+		}
+		/* Immediate: draws are done by now, wrap around the ring */
+		offset = 0;
+		if (!heap->base || size > heap->size)
+			return NULL;
+	}
+
+	mem = heap->base + offset;
+	heap->offset = offset + size;
+
+	return mem;
+}
+
+int sceGxmCreateContext(const SceGxmContextParams *params, SceGxmContext **context)
+{
+	SceGxmContext *ctx;
+
+	if (!params || !context)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return SCE_GXM_ERROR_OUT_OF_MEMORY;
+
+	state_init_default(&ctx->state);
+	heap_init(&ctx->vertex_heap, params->vertexRingBufferMem,
+		params->vertexRingBufferMemSize, NULL);
+	heap_init(&ctx->fragment_heap, params->fragmentRingBufferMem,
+		params->fragmentRingBufferMemSize, NULL);
+	*context = ctx;
+
+	return 0;
+}
+
+int sceGxmDestroyContext(SceGxmContext *context)
+{
+	free(context);
+
+	return 0;
+}
+
+int sceGxmCreateDeferredContext(const SceGxmDeferredContextParams *params, SceGxmContext **deferredContext)
+{
+	SceGxmContext *ctx;
+
+	if (!params || !deferredContext)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+	if (!params->vdmCallback || !params->vertexCallback || !params->fragmentCallback)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return SCE_GXM_ERROR_OUT_OF_MEMORY;
+
+	ctx->deferred = 1;
+	ctx->user_data = params->userData;
+	state_init_default(&ctx->state);
+	heap_init(&ctx->vertex_heap, NULL, 0, params->vertexCallback);
+	heap_init(&ctx->fragment_heap, NULL, 0, params->fragmentCallback);
+	heap_init(&ctx->command_heap, NULL, 0, params->vdmCallback);
+	*deferredContext = ctx;
+
+	return 0;
+}
+
+int sceGxmDestroyDeferredContext(SceGxmContext *deferredContext)
+{
+	free(deferredContext);
+
+	return 0;
+}
+
+/*
+ * Append a command, keeping room for the jump to the next chunk. Returns
+ * NULL if the vdm callback runs out of memory.
+ */
+static struct host_gxm_command *append_command(SceGxmContext *context)
+{
+	struct host_gxm_heap *heap = &context->command_heap;
+	const unsigned int size = sizeof(struct host_gxm_command);
+	struct host_gxm_command *command;
+
+	if (!heap->base || heap->offset + 2 * size > heap->size) {
+		struct host_gxm_command *jump = NULL;
+		unsigned int chunk_size = 0;
+		char *chunk;
+
+		if (heap->base)
+			jump = (struct host_gxm_command *)(heap->base + heap->offset);
+
+		chunk = heap->callback(context->user_data, 2 * size, &chunk_size);
+		if (!chunk || chunk_size < 2 * size)
+			return NULL;
+
+		chunk = (char *)ALIGN((uintptr_t)chunk, 16);
+		if (jump) {
+			jump->type = HOST_GXM_COMMAND_JUMP;
+			jump->next = (struct host_gxm_command *)chunk;
+		} else {
+			context->commands = chunk;
+		}
+
+		heap->base = chunk;
+		heap->size = chunk_size - 16;
+		heap->offset = 0;
+	}
+
+	command = (struct host_gxm_command *)(heap->base + heap->offset);
+	heap->offset += size;
+	context->commands_size += size;
+
+	return command;
+}
+
+int sceGxmBeginCommandList(SceGxmContext *deferredContext)
+{
+	if (!deferredContext->deferred)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+	if (deferredContext->in_command_list)
+		return SCE_GXM_ERROR_WITHIN_COMMAND_LIST;
+
+	/* Every list starts from a fresh chunk and the default state */
+	state_init_default(&deferredContext->state);
+	deferredContext->vertex_uniforms = NULL;
+	deferredContext->fragment_uniforms = NULL;
+	deferredContext->vertex_reserved = NULL;
+	deferredContext->fragment_reserved = NULL;
+	heap_init(&deferredContext->vertex_heap, NULL, 0, deferredContext->vertex_heap.callback);
+	heap_init(&deferredContext->fragment_heap, NULL, 0, deferredContext->fragment_heap.callback);
+	heap_init(&deferredContext->command_heap, NULL, 0, deferredContext->command_heap.callback);
+	deferredContext->commands = NULL;
+	deferredContext->commands_size = 0;
+	deferredContext->in_command_list = 1;
+
+	return 0;
+}
+
+int sceGxmEndCommandList(SceGxmContext *deferredContext, SceGxmCommandList *commandList)
+{
+	struct host_gxm_command *end;
+
+	if (!deferredContext->in_command_list)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	deferredContext->in_command_list = 0;
+
+	end = append_command(deferredContext);
+	if (!end) {
+		commandList->commands = NULL;
+		commandList->size = 0;
+		return SCE_GXM_ERROR_RESERVE_FAILED;
+	}
+	end->type = HOST_GXM_COMMAND_END;
+
+	commandList->commands = deferredContext->commands;
+	commandList->size = deferredContext->commands_size;
+
+	return 0;
+}
+
+int sceGxmExecuteCommandList(SceGxmContext *context, SceGxmCommandList *commandList)
+{
+	const struct host_gxm_command *command = commandList->commands;
+
+	if (context->deferred)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+	if (!context->in_scene)
+		return SCE_GXM_ERROR_NOT_WITHIN_SCENE;
+
+	while (command && command->type != HOST_GXM_COMMAND_END) {
+		if (command->type == HOST_GXM_COMMAND_JUMP) {
+			command = command->next;
+			continue;
+		}
+
+		host_gxm_scene_draw(&command->draw);
+		command++;
+	}
+
+	return 0;
+}
+
+int sceGxmCreateRenderTarget(const SceGxmRenderTargetParams *params, SceGxmRenderTarget **renderTarget)
+{
+	SceGxmRenderTarget *target;
+
+	if (!params || !renderTarget)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	target = calloc(1, sizeof(*target));
+	if (!target)
+		return SCE_GXM_ERROR_OUT_OF_MEMORY;
+
+	target->width = params->width;
+	target->height = params->height;
+	*renderTarget = target;
+
+	return 0;
+}
+
+int sceGxmDestroyRenderTarget(SceGxmRenderTarget *renderTarget)
+{
+	free(renderTarget);
+
+	return 0;
+}
+
+unsigned int host_gxm_color_format_size(SceGxmColorFormat format)
+{
+	switch (format) {
+	case SCE_GXM_COLOR_FORMAT_A8B8G8R8:
+		return 4;
+	case SCE_GXM_COLOR_FORMAT_U5U6U5_RGB:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+unsigned int host_gxm_texture_format_size(SceGxmTextureFormat format)
+{
+	switch (format) {
+	case SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR:
+		return 4;
+	case SCE_GXM_TEXTURE_FORMAT_U5U6U5_RGB:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+unsigned int host_gxm_texture_block_size(SceGxmTextureFormat format)
+{
+	switch (format) {
+	case SCE_GXM_TEXTURE_FORMAT_UBC1_ABGR:
+		return 8;
+	case SCE_GXM_TEXTURE_FORMAT_UBC3_ABGR:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+int sceGxmColorSurfaceInit(SceGxmColorSurface *surface, SceGxmColorFormat colorFormat,
+	SceGxmColorSurfaceType surfaceType, SceGxmColorSurfaceScaleMode scaleMode,
+	SceGxmOutputRegisterSize outputRegisterSize, unsigned int width, unsigned int height,
+	unsigned int strideInPixels, void *data)
+{
+	if (!surface)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+	if (!host_gxm_color_format_size(colorFormat))
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	surface->colorFormat = colorFormat;
+	surface->surfaceType = surfaceType;
+	surface->width = width;
+	surface->height = height;
+	surface->strideInPixels = strideInPixels;
+	surface->data = data;
+
+	return 0;
+}
+
+void *sceGxmColorSurfaceGetData(const SceGxmColorSurface *surface)
+{
+	return surface->data;
+}
+
+SceGxmColorFormat sceGxmColorSurfaceGetFormat(const SceGxmColorSurface *surface)
+{
+	return surface->colorFormat;
+}
+
+unsigned int sceGxmColorSurfaceGetStrideInPixels(const SceGxmColorSurface *surface)
+{
+	return surface->strideInPixels;
+}
+
+int sceGxmDepthStencilSurfaceInit(SceGxmDepthStencilSurface *surface,
+	SceGxmDepthStencilFormat depthStencilFormat, SceGxmDepthStencilSurfaceType surfaceType,
+	unsigned int strideInSamples, void *depthData, void *stencilData)
+{
+	if (!surface)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	surface->format = depthStencilFormat;
+	surface->surfaceType = surfaceType;
+	surface->strideInSamples = strideInSamples;
+	surface->depthData = depthData;
+	surface->stencilData = stencilData;
+	surface->backgroundDepth = 1.0f;
+	surface->backgroundStencil = 0;
+
+	return 0;
+}
+
+int sceGxmTextureInitLinearStrided(SceGxmTexture *texture, const void *data,
+	SceGxmTextureFormat texFormat, unsigned int width, unsigned int height,
+	unsigned int byteStride)
+{
+	if (!texture)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+	if (!width || !height || !host_gxm_texture_format_size(texFormat) ||
+	    byteStride < width * host_gxm_texture_format_size(texFormat))
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	texture->format = texFormat;
+	texture->width = width;
+	texture->height = height;
+	texture->byteStride = byteStride;
+	texture->minFilter = SCE_GXM_TEXTURE_FILTER_POINT;
+	texture->magFilter = SCE_GXM_TEXTURE_FILTER_POINT;
+	texture->mipFilter = SCE_GXM_TEXTURE_MIP_FILTER_DISABLED;
+	/* The render targets sampled here must not wrap at their edges */
+	texture->uAddrMode = SCE_GXM_TEXTURE_ADDR_CLAMP;
+	texture->vAddrMode = SCE_GXM_TEXTURE_ADDR_CLAMP;
+	texture->mipCount = 1;
+	texture->swizzled = 0;
+	texture->data = data;
+
+	return 0;
+}
+
+int sceGxmTextureInitSwizzled(SceGxmTexture *texture, const void *data,
+	SceGxmTextureFormat texFormat, unsigned int width, unsigned int height,
+	unsigned int mipCount)
+{
+	unsigned int max_levels = 1;
+
+	if (!texture)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+	while (max_levels < 32 && ((width | height) >> max_levels))
+		max_levels++;
+	if (!width || !height || (width & (width - 1)) || (height & (height - 1)) ||
+	    (!host_gxm_texture_format_size(texFormat) && !host_gxm_texture_block_size(texFormat)) ||
+	    !mipCount || mipCount > max_levels)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	texture->format = texFormat;
+	texture->width = width;
+	texture->height = height;
+	texture->byteStride = 0;
+	texture->minFilter = SCE_GXM_TEXTURE_FILTER_POINT;
+	texture->magFilter = SCE_GXM_TEXTURE_FILTER_POINT;
+	texture->mipFilter = SCE_GXM_TEXTURE_MIP_FILTER_DISABLED;
+	texture->uAddrMode = SCE_GXM_TEXTURE_ADDR_REPEAT;
+	texture->vAddrMode = SCE_GXM_TEXTURE_ADDR_REPEAT;
+	texture->mipCount = mipCount;
+	texture->swizzled = 1;
+	texture->data = data;
+
+	return 0;
+}
+
+int sceGxmTextureSetMinFilter(SceGxmTexture *texture, SceGxmTextureFilter minFilter)
+{
+	if (!texture)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	texture->minFilter = minFilter;
+
+	return 0;
+}
+
+int sceGxmTextureSetMagFilter(SceGxmTexture *texture, SceGxmTextureFilter magFilter)
+{
+	if (!texture)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	texture->magFilter = magFilter;
+
+	return 0;
+}
+
+int sceGxmTextureSetMipFilter(SceGxmTexture *texture, SceGxmTextureMipFilter mipFilter)
+{
+	if (!texture)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	texture->mipFilter = mipFilter;
+
+	return 0;
+}
+
+int sceGxmTextureSetUAddrMode(SceGxmTexture *texture, SceGxmTextureAddrMode mode)
+{
+	if (!texture)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	texture->uAddrMode = mode;
+
+	return 0;
+}
+
+int sceGxmTextureSetVAddrMode(SceGxmTexture *texture, SceGxmTextureAddrMode mode)
+{
+	if (!texture)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	texture->vAddrMode = mode;
+
+	return 0;
+}
+
+void *sceGxmTextureGetData(const SceGxmTexture *texture)
+{
+	return (void *)texture->data;
+}
+
+SceGxmTextureType sceGxmTextureGetType(const SceGxmTexture *texture)
+{
+	return texture->swizzled ? SCE_GXM_TEXTURE_SWIZZLED : SCE_GXM_TEXTURE_LINEAR_STRIDED;
+}
+
+SceGxmTextureFormat sceGxmTextureGetFormat(const SceGxmTexture *texture)
+{
+	return texture->format;
+}
+
+unsigned int sceGxmTextureGetWidth(const SceGxmTexture *texture)
+{
+	return texture->width;
+}
+
+unsigned int sceGxmTextureGetHeight(const SceGxmTexture *texture)
+{
+	return texture->height;
+}
+
+unsigned int sceGxmTextureGetStride(const SceGxmTexture *texture)
+{
+	return texture->byteStride;
+}
+
+unsigned int sceGxmTextureGetMipmapCount(const SceGxmTexture *texture)
+{
+	return texture->mipCount;
+}
+
+SceGxmTextureFilter sceGxmTextureGetMinFilter(const SceGxmTexture *texture)
+{
+	return texture->minFilter;
+}
+
+SceGxmTextureFilter sceGxmTextureGetMagFilter(const SceGxmTexture *texture)
+{
+	return texture->magFilter;
+}
+
+SceGxmTextureMipFilter sceGxmTextureGetMipFilter(const SceGxmTexture *texture)
+{
+	return texture->mipFilter;
+}
+
+SceGxmTextureAddrMode sceGxmTextureGetUAddrMode(const SceGxmTexture *texture)
+{
+	return texture->uAddrMode;
+}
+
+SceGxmTextureAddrMode sceGxmTextureGetVAddrMode(const SceGxmTexture *texture)
+{
+	return texture->vAddrMode;
+}
+
+int sceGxmBeginScene(SceGxmContext *context, unsigned int flags,
+	const SceGxmRenderTarget *renderTarget, const SceGxmValidRegion *validRegion,
+	SceGxmSyncObject *vertexSyncObject, SceGxmSyncObject *fragmentSyncObject,
+	const SceGxmColorSurface *colorSurface, const SceGxmDepthStencilSurface *depthStencil)
+{
+	int err;
+
+	if (context->deferred)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+	if (context->in_scene)
+		return SCE_GXM_ERROR_WITHIN_SCENE;
+	if (!renderTarget || !colorSurface)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	/* Don't draw into a buffer that is still queued for display */
+	if (fragmentSyncObject)
+		host_gxm_sync_object_wait(fragmentSyncObject);
+
+	memset(&context->target, 0, sizeof(context->target));
+	context->target.width = renderTarget->width;
+	context->target.height = renderTarget->height;
+	context->target.color = *colorSurface;
+	if (depthStencil)
+		context->target.depth_stencil = *depthStencil;
+
+	context->target.valid_region.xMax = renderTarget->width - 1;
+	context->target.valid_region.yMax = renderTarget->height - 1;
+	if (validRegion) {
+		if (validRegion->xMin > validRegion->xMax || validRegion->yMin > validRegion->yMax ||
+		    validRegion->xMax >= renderTarget->width || validRegion->yMax >= renderTarget->height)
+			return SCE_GXM_ERROR_INVALID_VALUE;
+		context->target.valid_region = *validRegion;
+	}
+
+	err = host_gxm_scene_begin(&context->target);
+	if (err < 0)
+		return err;
+
+	context->fragment_sync_object = fragmentSyncObject;
+	context->in_scene = 1;
+
+	return 0;
+}
+
+int sceGxmEndScene(SceGxmContext *context, const SceGxmNotification *vertexNotification,
+	const SceGxmNotification *fragmentNotification)
+{
+	if (!context->in_scene)
+		return SCE_GXM_ERROR_NOT_WITHIN_SCENE;
+
+	context->in_scene = 0;
+
+	host_gxm_scene_end();
+
+	if (vertexNotification)
+		*vertexNotification->address = vertexNotification->value;
+	if (fragmentNotification)
+		*fragmentNotification->address = fragmentNotification->value;
+
+	return 0;
+}
+
+void sceGxmFinish(SceGxmContext *context)
+{
+}
+
+void sceGxmSetVertexProgram(SceGxmContext *context, const SceGxmVertexProgram *vertexProgram)
+{
+	context->state.vertex_program = vertexProgram;
+}
+
+void sceGxmSetFragmentProgram(SceGxmContext *context, const SceGxmFragmentProgram *fragmentProgram)
+{
+	context->state.fragment_program = fragmentProgram;
+}
+
+int sceGxmReserveVertexDefaultUniformBuffer(SceGxmContext *context, void **uniformBuffer)
+{
+	const SceGxmVertexProgram *program = context->state.vertex_program;
+	float *buffer;
+
+	if (!program)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	if (context->vertex_reserved == program) {
+		*uniformBuffer = (void *)context->vertex_uniforms;
+		return 0;
+	}
+
+	buffer = heap_alloc(&context->vertex_heap, context->user_data,
+		ALIGN(program->info->uniform_count, 4) * sizeof(float) + 16);
+	if (!buffer)
+		return SCE_GXM_ERROR_RESERVE_FAILED;
+
+	context->vertex_uniforms = buffer;
+	context->vertex_reserved = program;
+	*uniformBuffer = buffer;
+
+	return 0;
+}
+
+int sceGxmReserveFragmentDefaultUniformBuffer(SceGxmContext *context, void **uniformBuffer)
+{
+	const SceGxmFragmentProgram *program = context->state.fragment_program;
+	float *buffer;
+
+	if (!program)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	if (context->fragment_reserved == program) {
+		*uniformBuffer = (void *)context->fragment_uniforms;
+		return 0;
+	}
+
+	buffer = heap_alloc(&context->fragment_heap, context->user_data,
+		ALIGN(program->info->uniform_count, 4) * sizeof(float) + 16);
+	if (!buffer)
+		return SCE_GXM_ERROR_RESERVE_FAILED;
+
+	context->fragment_uniforms = buffer;
+	context->fragment_reserved = program;
+	*uniformBuffer = buffer;
+
+	return 0;
+}
+
+void sceGxmSetFrontStencilFunc(SceGxmContext *context, SceGxmStencilFunc func,
+	SceGxmStencilOp stencilFail, SceGxmStencilOp depthFail, SceGxmStencilOp depthPass,
+	unsigned char compareMask, unsigned char writeMask)
+{
+	context->state.stencil_func = func;
+	context->state.stencil_fail = stencilFail;
+	context->state.depth_fail = depthFail;
+	context->state.depth_pass = depthPass;
+	context->state.stencil_compare_mask = compareMask;
+	context->state.stencil_write_mask = writeMask;
+}
+
+void sceGxmSetFrontStencilRef(SceGxmContext *context, unsigned int sref)
+{
+	context->state.stencil_ref = sref;
+}
+
+void sceGxmSetFrontDepthWriteEnable(SceGxmContext *context, SceGxmDepthWriteMode enable)
+{
+	context->state.depth_write = enable;
+}
+
+void sceGxmSetFrontDepthFunc(SceGxmContext *context, SceGxmDepthFunc depthFunc)
+{
+	context->state.depth_func = depthFunc;
+}
+
+void sceGxmSetViewport(SceGxmContext *context, float xOffset, float xScale, float yOffset,
+	float yScale, float zOffset, float zScale)
+{
+	context->state.viewport_set = 1;
+	context->state.viewport_offset[0] = xOffset;
+	context->state.viewport_offset[1] = yOffset;
+	context->state.viewport_offset[2] = zOffset;
+	context->state.viewport_scale[0] = xScale;
+	context->state.viewport_scale[1] = yScale;
+	context->state.viewport_scale[2] = zScale;
+}
+
+int sceGxmSetVertexStream(SceGxmContext *context, unsigned int streamIndex, const void *streamData)
+{
+	if (streamIndex >= HOST_GXM_MAX_STREAMS)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	context->state.vertex_streams[streamIndex] = streamData;
+
+	return 0;
+}
+
+int sceGxmSetFragmentTexture(SceGxmContext *context, unsigned int textureIndex, const SceGxmTexture *texture)
+{
+	if (!texture)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+	if (textureIndex >= HOST_GXM_MAX_TEXTURES)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	context->state.fragment_textures[textureIndex] = *texture;
+
+	return 0;
+}
+
+int sceGxmDraw(SceGxmContext *context, SceGxmPrimitiveType primType, SceGxmIndexFormat indexType,
+	const void *indexData, unsigned int indexCount)
+{
+	struct host_gxm_draw draw;
+
+	if (!context->state.vertex_program || !context->state.fragment_program)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	draw.state = context->state;
+	draw.vertex_uniforms = context->vertex_uniforms;
+	draw.fragment_uniforms = context->fragment_uniforms;
+	draw.primitive = primType;
+	draw.index_format = indexType;
+	draw.indices = indexData;
+	draw.index_count = indexCount;
+
+	context->vertex_reserved = NULL;
+	context->fragment_reserved = NULL;
+
+	if (context->deferred) {
+		struct host_gxm_command *command;
+
+		if (!context->in_command_list)
+			return SCE_GXM_ERROR_INVALID_VALUE;
+
+		command = append_command(context);
+		if (!command)
+			return SCE_GXM_ERROR_RESERVE_FAILED;
+
+		command->type = HOST_GXM_COMMAND_DRAW;
+		command->draw = draw;
+	} else {
+		if (!context->in_scene)
+			return SCE_GXM_ERROR_NOT_WITHIN_SCENE;
+
+		return host_gxm_scene_draw(&draw);
+	}
+
+	return 0;
+}
+
+int sceGxmMapMemory(void *base, SceSize size, SceGxmMemoryAttribFlags attr)
+{
+	return base ? 0 : SCE_GXM_ERROR_INVALID_POINTER;
+}
+
+int sceGxmUnmapMemory(void *base)
+{
+	return 0;
+}
+
+int sceGxmMapVertexUsseMemory(void *base, SceSize size, unsigned int *offset)
+{
+	*offset = 0;
+
+	return base ? 0 : SCE_GXM_ERROR_INVALID_POINTER;
+}
+
+int sceGxmUnmapVertexUsseMemory(void *base)
+{
+	return 0;
+}
+
+int sceGxmMapFragmentUsseMemory(void *base, SceSize size, unsigned int *offset)
+{
+	*offset = 0;
+
+	return base ? 0 : SCE_GXM_ERROR_INVALID_POINTER;
+}
+
+int sceGxmUnmapFragmentUsseMemory(void *base)
+{
+	return 0;
+}
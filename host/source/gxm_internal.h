@@ -0,0 +1,193 @@
+#ifndef GXM_INTERNAL_H
+#define GXM_INTERNAL_H
+
+#include <pthread.h>
+#include <psp2/gxm.h>
+
+/*
+ * Internals of the host libgxm: programs are C functions looked up by
+ * the name stored in their "binary", draws are rasterized on the CPU
+ * when they are submitted on the immediate context and recorded as
+ * plain structs when submitted on a deferred context.
+ */
+
+#define HOST_GXM_PROGRAM_MAGIC "HGXP"
+#define HOST_GXM_PROGRAM_NAME_SIZE 28
+
+#define HOST_GXM_MAX_ATTRIBUTES 8
+#define HOST_GXM_MAX_STREAMS 4
+#define HOST_GXM_MAX_VARYINGS 16
+#define HOST_GXM_MAX_DERIVATIVES 4
+/* Texture units a draw keeps, of the SCE_GXM_MAX_TEXTURE_UNITS */
+#define HOST_GXM_MAX_TEXTURES 4
+/* Default uniform buffer size of a fragment program, in floats */
+#define HOST_GXM_MAX_UNIFORMS 64
+
+enum host_gxm_program_type {
+	HOST_GXM_VERTEX_PROGRAM,
+	HOST_GXM_FRAGMENT_PROGRAM
+};
+
+enum host_gxm_parameter_category {
+	HOST_GXM_PARAMETER_ATTRIBUTE,
+	HOST_GXM_PARAMETER_UNIFORM,
+	HOST_GXM_PARAMETER_SAMPLER
+};
+
+/* What sceGxmShaderPatcherGetProgramFromId() points to */
+struct SceGxmProgram {
+	char magic[4];
+	char name[HOST_GXM_PROGRAM_NAME_SIZE];
+};
+
+struct SceGxmProgramParameter {
+	const char *name;
+	enum host_gxm_parameter_category category;
+	/* Input register for attributes, float offset for uniforms, unit for samplers */
+	unsigned int resource_index;
+	unsigned int component_count;
+};
+
+typedef void (*host_gxm_vertex_function)(const float *uniforms,
+	const float attributes[HOST_GXM_MAX_ATTRIBUTES][4], float position[4], float *varyings);
+typedef void (*host_gxm_fragment_function)(const float *uniforms,
+	const SceGxmTexture *textures, const float *varyings, float color[4]);
+
+struct host_gxm_program_info {
+	const char *name;
+	enum host_gxm_program_type type;
+	const SceGxmProgramParameter *parameters;
+	unsigned int parameter_count;
+	/* Size of the default uniform buffer in floats */
+	unsigned int uniform_count;
+	/* Outputs of a vertex program, inputs of a fragment program */
+	unsigned int varying_count;
+	host_gxm_vertex_function vertex;
+	host_gxm_fragment_function fragment;
+	/*
+	 * Leading varyings whose screen space derivatives the fragment program
+	 * reads, for tex2D() to pick a level. They follow the varyings, d/dx
+	 * of each then d/dy of each.
+	 */
+	unsigned int derivative_count;
+};
+
+struct SceGxmRegisteredProgram {
+	const SceGxmProgram *program;
+	const struct host_gxm_program_info *info;
+};
+
+struct SceGxmVertexProgram {
+	const struct host_gxm_program_info *info;
+	SceGxmVertexAttribute attributes[HOST_GXM_MAX_ATTRIBUTES];
+	unsigned int attribute_count;
+	SceGxmVertexStream streams[HOST_GXM_MAX_STREAMS];
+	unsigned int stream_count;
+};
+
+struct SceGxmFragmentProgram {
+	const struct host_gxm_program_info *info;
+	unsigned char color_mask;
+};
+
+struct SceGxmRenderTarget {
+	unsigned int width;
+	unsigned int height;
+};
+
+struct SceGxmSyncObject {
+	/* Display queue entries that still reference the buffer */
+	unsigned int busy;
+};
+
+struct host_gxm_state {
+	const SceGxmVertexProgram *vertex_program;
+	const SceGxmFragmentProgram *fragment_program;
+	const void *vertex_streams[HOST_GXM_MAX_STREAMS];
+	SceGxmTexture fragment_textures[HOST_GXM_MAX_TEXTURES];
+	SceGxmDepthFunc depth_func;
+	SceGxmDepthWriteMode depth_write;
+	SceGxmStencilFunc stencil_func;
+	SceGxmStencilOp stencil_fail;
+	SceGxmStencilOp depth_fail;
+	SceGxmStencilOp depth_pass;
+	unsigned char stencil_compare_mask;
+	unsigned char stencil_write_mask;
+	unsigned char stencil_ref;
+	/* Window coordinates are ndc * scale + offset, the whole target until set */
+	int viewport_set;
+	float viewport_offset[3];
+	float viewport_scale[3];
+};
+
+struct host_gxm_draw {
+	struct host_gxm_state state;
+	const float *vertex_uniforms;
+	const float *fragment_uniforms;
+	SceGxmPrimitiveType primitive;
+	SceGxmIndexFormat index_format;
+	const void *indices;
+	unsigned int index_count;
+};
+
+struct host_gxm_target {
+	unsigned int width;
+	unsigned int height;
+	/* Only the tiles that overlap it are cleared and rasterized */
+	SceGxmValidRegion valid_region;
+	SceGxmColorSurface color;
+	SceGxmDepthStencilSurface depth_stencil;
+};
+
+/* Bump allocator over a ring buffer or the chunks of a deferred callback */
+struct host_gxm_heap {
+	char *base;
+	unsigned int size;
+	unsigned int offset;
+	SceGxmDeferredContextCallback *callback;
+};
+
+struct SceGxmContext {
+	int deferred;
+	struct host_gxm_state state;
+	const float *vertex_uniforms;
+	const float *fragment_uniforms;
+	/*
+	 * Reservations are handed out again until the next draw consumes
+	 * them, as long as the program does not change
+	 */
+	const SceGxmVertexProgram *vertex_reserved;
+	const SceGxmFragmentProgram *fragment_reserved;
+	struct host_gxm_heap vertex_heap;
+	struct host_gxm_heap fragment_heap;
+
+	/* Immediate context */
+	int in_scene;
+	struct host_gxm_target target;
+	SceGxmSyncObject *fragment_sync_object;
+
+	/* Deferred context */
+	void *user_data;
+	int in_command_list;
+	struct host_gxm_heap command_heap;
+	void *commands;
+	unsigned int commands_size;
+};
+
+const struct host_gxm_program_info *host_gxm_find_program_info(const SceGxmProgram *program);
+/* Bytes per pixel, 0 for the formats the host can't draw into or sample */
+unsigned int host_gxm_color_format_size(SceGxmColorFormat format);
+unsigned int host_gxm_texture_format_size(SceGxmTextureFormat format);
+/* Bytes per 4x4 block of the compressed formats, 0 for the others */
+unsigned int host_gxm_texture_block_size(SceGxmTextureFormat format);
+
+void host_gxm_raster_init(void);
+void host_gxm_raster_terminate(void);
+/* Draws are binned when submitted and rasterized by host_gxm_scene_end() */
+int host_gxm_scene_begin(const struct host_gxm_target *target);
+int host_gxm_scene_draw(const struct host_gxm_draw *draw);
+void host_gxm_scene_end(void);
+
+void host_gxm_sync_object_wait(SceGxmSyncObject *sync_object);
+
+#endif
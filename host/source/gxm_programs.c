@@ -0,0 +1,656 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "gxm_internal.h"
+
+/*
+ * C equivalents of the shaders in shader/. Each one has a small header
+ * exported under the symbol objcopy gives the compiled .gxp on the Vita,
+ * so main.c picks them up unchanged.
+ */
+
+#define PROGRAM_BINARY(name) \
+	unsigned char _binary_##name##_gxp_start[sizeof(SceGxmProgram)] \
+		__attribute__((aligned(16))) = HOST_GXM_PROGRAM_MAGIC #name
+
+PROGRAM_BINARY(clear_v);
+PROGRAM_BINARY(clear_f);
+PROGRAM_BINARY(color_v);
+PROGRAM_BINARY(color_f);
+PROGRAM_BINARY(cube_v);
+PROGRAM_BINARY(cube_f);
+PROGRAM_BINARY(cube_textured_v);
+PROGRAM_BINARY(cube_textured_f);
+PROGRAM_BINARY(disable_color_buffer_v);
+PROGRAM_BINARY(disable_color_buffer_f);
+PROGRAM_BINARY(portal_texture_v);
+PROGRAM_BINARY(portal_texture_f);
+PROGRAM_BINARY(upscale_v);
+PROGRAM_BINARY(upscale_f);
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+static void mul_matrix4x4(float out[4], const float m[16], float x, float y, float z, float w)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		out[i] = m[i * 4 + 0] * x + m[i * 4 + 1] * y + m[i * 4 + 2] * z + m[i * 4 + 3] * w;
+}
+
+static void mul_matrix3x3(float out[3], const float m[9], const float v[3])
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+		out[i] = m[i * 3 + 0] * v[0] + m[i * 3 + 1] * v[1] + m[i * 3 + 2] * v[2];
+}
+
+static float dot3(const float a[3], const float b[3])
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void normalize3(float v[3])
+{
+	float length = sqrtf(dot3(v, v));
+
+	if (length > 0.0f) {
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+	}
+}
+
+/* A level of a texture as the sampler addresses it */
+struct texture_level {
+	const char *data;
+	unsigned int width;
+	unsigned int height;
+};
+
+static void get_texture_level(const SceGxmTexture *texture, unsigned int level,
+	struct texture_level *out)
+{
+	unsigned int texel_size = host_gxm_texture_format_size(texture->format);
+	unsigned int block_size = host_gxm_texture_block_size(texture->format);
+	const char *data = texture->data;
+	unsigned int i;
+
+	/* The levels follow each other from the full size down */
+	for (i = 0; i < level; i++) {
+		unsigned int width = texture->width >> i ? texture->width >> i : 1;
+		unsigned int height = texture->height >> i ? texture->height >> i : 1;
+
+		if (block_size)
+			data += ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+		else
+			data += width * height * texel_size;
+	}
+
+	out->data = data;
+	out->width = texture->width >> level ? texture->width >> level : 1;
+	out->height = texture->height >> level ? texture->height >> level : 1;
+}
+
+/*
+ * Offset of the texel, or block, at x, y of a swizzled level of width by
+ * height of them, both powers of two: the bits of y and x interleaved up
+ * to the shorter side, y in the even bits, then those left of the longer.
+ */
+static unsigned int morton_index(unsigned int x, unsigned int y,
+	unsigned int width, unsigned int height)
+{
+	unsigned int shorter = width < height ? width : height;
+	unsigned int index = 0, shift = 0;
+
+	for (; (1u << shift) < shorter; shift++) {
+		index |= (y & (1u << shift)) << shift;
+		index |= (x & (1u << shift)) << (shift + 1);
+	}
+
+	return index | ((width > height ? x : y) >> shift) << (2 * shift);
+}
+
+static int address_texel(int x, unsigned int size, SceGxmTextureAddrMode mode)
+{
+	if (mode == SCE_GXM_TEXTURE_ADDR_REPEAT) {
+		x %= (int)size;
+		return x < 0 ? x + (int)size : x;
+	}
+
+	return x < 0 ? 0 : (x >= (int)size ? (int)size - 1 : x);
+}
+
+/* Replicate the high bits so that 0x1F expands to 0xFF */
+static uint32_t expand_565(uint32_t texel)
+{
+	uint32_t r = (texel >> 11) & 0x1F;
+	uint32_t g = (texel >> 5) & 0x3F;
+	uint32_t b = texel & 0x1F;
+
+	return 0xFF000000u | (((b << 3) | (b >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) |
+		((r << 3) | (r >> 2));
+}
+
+/* (a * wa + b * wb) / (wa + wb) of each 8-bit channel */
+static uint32_t blend_texels(uint32_t a, uint32_t b, unsigned int wa, unsigned int wb)
+{
+	uint32_t texel = 0;
+	int i;
+
+	for (i = 0; i < 32; i += 8) {
+		uint32_t channel = (((a >> i) & 0xFF) * wa + ((b >> i) & 0xFF) * wb) / (wa + wb);
+		texel |= channel << i;
+	}
+
+	return texel;
+}
+
+/*
+ * Texel x, y of a UBC1 color block: two 565 endpoints and 2-bit indices,
+ * four colors if the first endpoint is the larger, three and transparent
+ * black otherwise. The color half of a UBC3 block always has four.
+ */
+static uint32_t decode_ubc1(const unsigned char *block, unsigned int x, unsigned int y,
+	int four_colors)
+{
+	unsigned int c0 = block[0] | block[1] << 8;
+	unsigned int c1 = block[2] | block[3] << 8;
+	uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+	uint32_t e0 = expand_565(c0), e1 = expand_565(c1);
+
+	switch ((indices >> (2 * (y * 4 + x))) & 3) {
+	case 0:
+		return e0;
+	case 1:
+		return e1;
+	case 2:
+		return four_colors || c0 > c1 ? blend_texels(e0, e1, 2, 1) : blend_texels(e0, e1, 1, 1);
+	default:
+		return four_colors || c0 > c1 ? blend_texels(e0, e1, 1, 2) : 0;
+	}
+}
+
+/*
+ * Alpha of texel x, y of a UBC3 alpha block: two 8-bit endpoints and 3-bit
+ * indices, eight levels between them if the first is the larger, six and
+ * 0 and 255 otherwise.
+ */
+static uint32_t decode_ubc3_alpha(const unsigned char *block, unsigned int x, unsigned int y)
+{
+	unsigned int a0 = block[0], a1 = block[1];
+	unsigned int bit = 3 * (y * 4 + x);
+	uint64_t indices = 0;
+	unsigned int index;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		indices |= (uint64_t)block[2 + i] << (8 * i);
+	index = (indices >> bit) & 7;
+
+	if (index < 2)
+		return index ? a1 : a0;
+	if (a0 > a1)
+		return ((8 - index) * a0 + (index - 1) * a1) / 7;
+	if (index >= 6)
+		return index == 6 ? 0 : 255;
+	return ((6 - index) * a0 + (index - 1) * a1) / 5;
+}
+
+/* Texel as A8B8G8R8 whatever the texture format */
+static uint32_t fetch_texel(const SceGxmTexture *texture, const struct texture_level *level,
+	int x, int y)
+{
+	unsigned int block_size = host_gxm_texture_block_size(texture->format);
+	const char *texel;
+	uint32_t color;
+
+	x = address_texel(x, level->width, texture->uAddrMode);
+	y = address_texel(y, level->height, texture->vAddrMode);
+
+	if (block_size) {
+		const unsigned char *block = (const unsigned char *)level->data +
+			morton_index(x / 4, y / 4, (level->width + 3) / 4, (level->height + 3) / 4) *
+			block_size;
+
+		if (texture->format == SCE_GXM_TEXTURE_FORMAT_UBC1_ABGR)
+			return decode_ubc1(block, x % 4, y % 4, 0);
+
+		color = decode_ubc1(block + 8, x % 4, y % 4, 1) & 0x00FFFFFFu;
+		return color | decode_ubc3_alpha(block, x % 4, y % 4) << 24;
+	}
+
+	if (texture->swizzled)
+		texel = level->data + morton_index(x, y, level->width, level->height) *
+			host_gxm_texture_format_size(texture->format);
+	else
+		texel = level->data + y * texture->byteStride +
+			x * host_gxm_texture_format_size(texture->format);
+
+	if (texture->format != SCE_GXM_TEXTURE_FORMAT_U5U6U5_RGB)
+		return *(const uint32_t *)texel;
+
+	return expand_565(*(const uint16_t *)texel);
+}
+
+static void unpack_texel(uint32_t texel, float weight, float color[4])
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		color[i] += ((texel >> (i * 8)) & 0xFF) * (weight / 255.0f);
+}
+
+/* Add the filtered texel of a level at u, v to color, times weight */
+static void sample_level(const SceGxmTexture *texture, unsigned int level,
+	SceGxmTextureFilter filter, float u, float v, float weight, float color[4])
+{
+	struct texture_level texels;
+	float x, y, fx, fy;
+	int x0, y0;
+
+	get_texture_level(texture, level, &texels);
+	x = u * texels.width - 0.5f;
+	y = v * texels.height - 0.5f;
+
+	if (filter == SCE_GXM_TEXTURE_FILTER_POINT) {
+		unpack_texel(fetch_texel(texture, &texels, (int)floorf(x + 0.5f), (int)floorf(y + 0.5f)),
+			weight, color);
+		return;
+	}
+
+	x0 = (int)floorf(x);
+	y0 = (int)floorf(y);
+	fx = x - x0;
+	fy = y - y0;
+	unpack_texel(fetch_texel(texture, &texels, x0, y0), weight * (1.0f - fx) * (1.0f - fy), color);
+	unpack_texel(fetch_texel(texture, &texels, x0 + 1, y0), weight * fx * (1.0f - fy), color);
+	unpack_texel(fetch_texel(texture, &texels, x0, y0 + 1), weight * (1.0f - fx) * fy, color);
+	unpack_texel(fetch_texel(texture, &texels, x0 + 1, y0 + 1), weight * fx * fy, color);
+}
+
+/*
+ * tex2D() in the shaders that don't ask for derivatives. Without them the
+ * host can't tell minification from magnification, the magnification
+ * filter is used on the full size level.
+ */
+static void sample_texture(const SceGxmTexture *texture, float u, float v, float color[4])
+{
+	memset(color, 0, 4 * sizeof(float));
+	if (!texture->data)
+		return;
+
+	sample_level(texture, 0, texture->magFilter, u, v, 1.0f, color);
+}
+
+/*
+ * tex2D() with the screen space derivatives of u, v. Their longer side
+ * in texels gives the level of detail: at most 0 is magnification, above
+ * it the minification filter is used on the nearest level, or on the two
+ * around it blended when mip filtering is enabled.
+ */
+static void sample_texture_grad(const SceGxmTexture *texture, float u, float v,
+	const float ddx[2], const float ddy[2], float color[4])
+{
+	float rho_x = hypotf(ddx[0] * texture->width, ddx[1] * texture->height);
+	float rho_y = hypotf(ddy[0] * texture->width, ddy[1] * texture->height);
+	float lod = log2f(rho_x > rho_y ? rho_x : rho_y);
+	unsigned int level;
+	float blend;
+
+	memset(color, 0, 4 * sizeof(float));
+	if (!texture->data)
+		return;
+
+	if (!(lod > 0.0f)) {
+		sample_level(texture, 0, texture->magFilter, u, v, 1.0f, color);
+		return;
+	}
+
+	if (lod > texture->mipCount - 1)
+		lod = texture->mipCount - 1;
+
+	if (texture->mipFilter == SCE_GXM_TEXTURE_MIP_FILTER_DISABLED) {
+		sample_level(texture, (unsigned int)(lod + 0.5f), texture->minFilter, u, v, 1.0f, color);
+		return;
+	}
+
+	level = (unsigned int)lod;
+	blend = lod - level;
+	sample_level(texture, level, texture->minFilter, u, v, 1.0f - blend, color);
+	if (blend > 0.0f)
+		sample_level(texture, level + 1, texture->minFilter, u, v, blend, color);
+}
+
+/* clear_v.cg / clear_f.cg */
+
+static const SceGxmProgramParameter clear_v_parameters[] = {
+	{"position", HOST_GXM_PARAMETER_ATTRIBUTE, 0, 2},
+};
+
+static void clear_v(const float *uniforms, const float attributes[HOST_GXM_MAX_ATTRIBUTES][4],
+	float position[4], float *varyings)
+{
+	position[0] = attributes[0][0];
+	position[1] = attributes[0][1];
+	position[2] = 1.0f;
+	position[3] = 1.0f;
+}
+
+static const SceGxmProgramParameter clear_f_parameters[] = {
+	{"u_clear_color", HOST_GXM_PARAMETER_UNIFORM, 0, 4},
+};
+
+static void clear_f(const float *uniforms, const SceGxmTexture *textures,
+	const float *varyings, float color[4])
+{
+	memcpy(color, uniforms, 4 * sizeof(float));
+}
+
+/* color_v.cg / color_f.cg */
+
+static const SceGxmProgramParameter color_v_parameters[] = {
+	{"position", HOST_GXM_PARAMETER_ATTRIBUTE, 0, 3},
+	{"color", HOST_GXM_PARAMETER_ATTRIBUTE, 1, 4},
+	{"u_mvp_matrix", HOST_GXM_PARAMETER_UNIFORM, 0, 16},
+};
+
+static void color_v(const float *uniforms, const float attributes[HOST_GXM_MAX_ATTRIBUTES][4],
+	float position[4], float *varyings)
+{
+	mul_matrix4x4(position, uniforms, attributes[0][0], attributes[0][1], 0.5f, 1.0f);
+	memcpy(varyings, attributes[1], 4 * sizeof(float));
+}
+
+static void color_f(const float *uniforms, const SceGxmTexture *textures,
+	const float *varyings, float color[4])
+{
+	memcpy(color, varyings, 4 * sizeof(float));
+}
+
+/* cube_v.cg / cube_f.cg */
+
+static const SceGxmProgramParameter cube_v_parameters[] = {
+	{"position", HOST_GXM_PARAMETER_ATTRIBUTE, 0, 3},
+	{"normal", HOST_GXM_PARAMETER_ATTRIBUTE, 1, 3},
+	{"color", HOST_GXM_PARAMETER_ATTRIBUTE, 2, 4},
+	{"u_mvp_matrix", HOST_GXM_PARAMETER_UNIFORM, 0, 16},
+};
+
+static void cube_v(const float *uniforms, const float attributes[HOST_GXM_MAX_ATTRIBUTES][4],
+	float position[4], float *varyings)
+{
+	memcpy(&varyings[0], attributes[0], 3 * sizeof(float));
+	memcpy(&varyings[3], attributes[1], 3 * sizeof(float));
+	memcpy(&varyings[6], attributes[2], 4 * sizeof(float));
+
+	mul_matrix4x4(position, uniforms, attributes[0][0], attributes[0][1], attributes[0][2], 1.0f);
+}
+
+enum cube_f_uniform {
+	CUBE_F_MODELVIEW_MATRIX = 0,
+	CUBE_F_NORMAL_MATRIX = 16,
+	CUBE_F_MATERIAL_AMBIENT = 25,
+	CUBE_F_MATERIAL_DIFFUSE = 28,
+	CUBE_F_MATERIAL_SPECULAR = 31,
+	CUBE_F_MATERIAL_SHININESS = 34,
+	CUBE_F_LIGHT_POSITION = 35,
+	CUBE_F_LIGHT_COLOR = 38,
+	CUBE_F_UNIFORM_COUNT = 41
+};
+
+static const SceGxmProgramParameter cube_f_parameters[] = {
+	{"u_modelview_matrix", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MODELVIEW_MATRIX, 16},
+	{"u_normal_matrix", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_NORMAL_MATRIX, 9},
+	{"u_material.ambient", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MATERIAL_AMBIENT, 3},
+	{"u_material.diffuse", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MATERIAL_DIFFUSE, 3},
+	{"u_material.specular", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MATERIAL_SPECULAR, 3},
+	{"u_material.shininess", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MATERIAL_SHININESS, 1},
+	{"u_light.position", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_LIGHT_POSITION, 3},
+	{"u_light.color", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_LIGHT_COLOR, 3},
+};
+
+/* phong_lighting() of the model space position and normal */
+static void cube_lighting(const float *uniforms, const float *model_position,
+	const float *model_normal, float lit[3])
+{
+	const float *ambient = &uniforms[CUBE_F_MATERIAL_AMBIENT];
+	const float *diffuse = &uniforms[CUBE_F_MATERIAL_DIFFUSE];
+	const float *specular = &uniforms[CUBE_F_MATERIAL_SPECULAR];
+	const float *light_position = &uniforms[CUBE_F_LIGHT_POSITION];
+	const float *light_color = &uniforms[CUBE_F_LIGHT_COLOR];
+	float position[4], normal[3], L[3], R[3], V[3];
+	float n_dot_l, r_dot_v, specular_component;
+	int i;
+
+	mul_matrix4x4(position, &uniforms[CUBE_F_MODELVIEW_MATRIX],
+		model_position[0], model_position[1], model_position[2], 1.0f);
+	mul_matrix3x3(normal, &uniforms[CUBE_F_NORMAL_MATRIX], model_normal);
+	normalize3(normal);
+
+	for (i = 0; i < 3; i++) {
+		L[i] = light_position[i] - position[i];
+		V[i] = -position[i];
+	}
+	normalize3(L);
+	normalize3(V);
+
+	/* reflect(-L, N) = -L + 2 * dot(L, N) * N */
+	n_dot_l = dot3(L, normal);
+	for (i = 0; i < 3; i++)
+		R[i] = -L[i] + 2.0f * n_dot_l * normal[i];
+
+	r_dot_v = dot3(R, V);
+	specular_component = powf(r_dot_v > 0.0f ? r_dot_v : 0.0f,
+		uniforms[CUBE_F_MATERIAL_SHININESS]);
+	if (n_dot_l < 0.0f)
+		n_dot_l = 0.0f;
+
+	for (i = 0; i < 3; i++)
+		lit[i] = (ambient[i] + n_dot_l * diffuse[i] + specular_component * specular[i]) *
+			light_color[i];
+}
+
+static void cube_f(const float *uniforms, const SceGxmTexture *textures,
+	const float *varyings, float color[4])
+{
+	float lit[3];
+	int i;
+
+	cube_lighting(uniforms, &varyings[0], &varyings[3], lit);
+
+	for (i = 0; i < 3; i++)
+		color[i] = lit[i] * varyings[6 + i];
+	color[3] = varyings[9];
+}
+
+/* cube_textured_v.cg / cube_textured_f.cg */
+
+static const SceGxmProgramParameter cube_textured_v_parameters[] = {
+	{"position", HOST_GXM_PARAMETER_ATTRIBUTE, 0, 3},
+	{"normal", HOST_GXM_PARAMETER_ATTRIBUTE, 1, 3},
+	{"color", HOST_GXM_PARAMETER_ATTRIBUTE, 2, 4},
+	{"u_mvp_matrix", HOST_GXM_PARAMETER_UNIFORM, 0, 16},
+};
+
+static void cube_textured_v(const float *uniforms,
+	const float attributes[HOST_GXM_MAX_ATTRIBUTES][4], float position[4], float *varyings)
+{
+	const float *p = attributes[0];
+	float nx = fabsf(attributes[1][0]), ny = fabsf(attributes[1][1]), nz = fabsf(attributes[1][2]);
+
+	/* Projected along the axis the normal is closest to */
+	if (nx > ny && nx > nz) {
+		varyings[0] = p[2];
+		varyings[1] = -p[1];
+	} else if (ny > nz) {
+		varyings[0] = p[0];
+		varyings[1] = p[2];
+	} else {
+		varyings[0] = p[0];
+		varyings[1] = -p[1];
+	}
+
+	cube_v(uniforms, attributes, position, &varyings[2]);
+}
+
+
+static const SceGxmProgramParameter cube_textured_f_parameters[] = {
+	{"u_modelview_matrix", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MODELVIEW_MATRIX, 16},
+	{"u_normal_matrix", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_NORMAL_MATRIX, 9},
+	{"u_material.ambient", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MATERIAL_AMBIENT, 3},
+	{"u_material.diffuse", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MATERIAL_DIFFUSE, 3},
+	{"u_material.specular", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MATERIAL_SPECULAR, 3},
+	{"u_material.shininess", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_MATERIAL_SHININESS, 1},
+	{"u_light.position", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_LIGHT_POSITION, 3},
+	{"u_light.color", HOST_GXM_PARAMETER_UNIFORM, CUBE_F_LIGHT_COLOR, 3},
+	{"u_texture", HOST_GXM_PARAMETER_SAMPLER, 0, 0},
+};
+
+/* The texture coordinates are first, their derivatives follow the 12 varyings */
+static void cube_textured_f(const float *uniforms, const SceGxmTexture *textures,
+	const float *varyings, float color[4])
+{
+	float lit[3], texel[4];
+	int i;
+
+	sample_texture_grad(&textures[0], varyings[0], varyings[1],
+		&varyings[12], &varyings[14], texel);
+	cube_lighting(uniforms, &varyings[2], &varyings[5], lit);
+
+	for (i = 0; i < 3; i++)
+		color[i] = lit[i] * varyings[8 + i] * texel[i];
+	color[3] = varyings[11] * texel[3];
+}
+
+/* disable_color_buffer_v.cg / disable_color_buffer_f.cg */
+
+static const SceGxmProgramParameter disable_color_buffer_v_parameters[] = {
+	{"position", HOST_GXM_PARAMETER_ATTRIBUTE, 0, 3},
+	{"u_mvp_matrix", HOST_GXM_PARAMETER_UNIFORM, 0, 16},
+};
+
+static void disable_color_buffer_v(const float *uniforms,
+	const float attributes[HOST_GXM_MAX_ATTRIBUTES][4], float position[4], float *varyings)
+{
+	mul_matrix4x4(position, uniforms, attributes[0][0], attributes[0][1], attributes[0][2], 1.0f);
+}
+
+static void disable_color_buffer_f(const float *uniforms, const SceGxmTexture *textures,
+	const float *varyings, float color[4])
+{
+	memset(color, 0, 4 * sizeof(float));
+}
+
+/* portal_texture_v.cg / portal_texture_f.cg */
+
+enum portal_texture_v_uniform {
+	PORTAL_TEXTURE_V_MVP_MATRIX = 0,
+	PORTAL_TEXTURE_V_SCREEN_TO_TEXTURE = 16,
+	PORTAL_TEXTURE_V_UNIFORM_COUNT = 20
+};
+
+static const SceGxmProgramParameter portal_texture_v_parameters[] = {
+	{"position", HOST_GXM_PARAMETER_ATTRIBUTE, 0, 3},
+	{"u_mvp_matrix", HOST_GXM_PARAMETER_UNIFORM, PORTAL_TEXTURE_V_MVP_MATRIX, 16},
+	{"u_screen_to_texture", HOST_GXM_PARAMETER_UNIFORM, PORTAL_TEXTURE_V_SCREEN_TO_TEXTURE, 4},
+};
+
+static void portal_texture_v(const float *uniforms,
+	const float attributes[HOST_GXM_MAX_ATTRIBUTES][4], float position[4], float *varyings)
+{
+	const float *screen_to_texture = &uniforms[PORTAL_TEXTURE_V_SCREEN_TO_TEXTURE];
+
+	mul_matrix4x4(position, &uniforms[PORTAL_TEXTURE_V_MVP_MATRIX],
+		attributes[0][0], attributes[0][1], attributes[0][2], 1.0f);
+
+	varyings[0] = position[0] * screen_to_texture[0] + position[3] * screen_to_texture[2];
+	varyings[1] = position[1] * screen_to_texture[1] + position[3] * screen_to_texture[3];
+	varyings[2] = position[3];
+}
+
+static const SceGxmProgramParameter portal_texture_f_parameters[] = {
+	{"u_texture", HOST_GXM_PARAMETER_SAMPLER, 0, 0},
+};
+
+static void portal_texture_f(const float *uniforms, const SceGxmTexture *textures,
+	const float *varyings, float color[4])
+{
+	/* tex2Dproj() */
+	sample_texture(&textures[0], varyings[0] / varyings[2], varyings[1] / varyings[2], color);
+}
+
+/* upscale_v.cg / upscale_f.cg */
+
+static const SceGxmProgramParameter upscale_v_parameters[] = {
+	{"position", HOST_GXM_PARAMETER_ATTRIBUTE, 0, 2},
+};
+
+static void upscale_v(const float *uniforms, const float attributes[HOST_GXM_MAX_ATTRIBUTES][4],
+	float position[4], float *varyings)
+{
+	position[0] = attributes[0][0];
+	position[1] = attributes[0][1];
+	position[2] = 1.0f;
+	position[3] = 1.0f;
+
+	varyings[0] = attributes[0][0] * 0.5f + 0.5f;
+	varyings[1] = 0.5f - attributes[0][1] * 0.5f;
+}
+
+static const SceGxmProgramParameter upscale_f_parameters[] = {
+	{"u_texture", HOST_GXM_PARAMETER_SAMPLER, 0, 0},
+};
+
+static void upscale_f(const float *uniforms, const SceGxmTexture *textures,
+	const float *varyings, float color[4])
+{
+	sample_texture(&textures[0], varyings[0], varyings[1], color);
+}
+
+#define VERTEX_PROGRAM(name, uniform_count, varying_count) \
+	{#name, HOST_GXM_VERTEX_PROGRAM, name##_parameters, ARRAY_SIZE(name##_parameters), \
+	 uniform_count, varying_count, name, NULL}
+#define FRAGMENT_PROGRAM(name, parameters, parameter_count, uniform_count, varying_count) \
+	{#name, HOST_GXM_FRAGMENT_PROGRAM, parameters, parameter_count, \
+	 uniform_count, varying_count, NULL, name, 0}
+#define FRAGMENT_PROGRAM_DERIVATIVES(name, parameters, parameter_count, uniform_count, \
+		varying_count, derivative_count) \
+	{#name, HOST_GXM_FRAGMENT_PROGRAM, parameters, parameter_count, \
+	 uniform_count, varying_count, NULL, name, derivative_count}
+
+static const struct host_gxm_program_info program_infos[] = {
+	VERTEX_PROGRAM(clear_v, 0, 0),
+	FRAGMENT_PROGRAM(clear_f, clear_f_parameters, ARRAY_SIZE(clear_f_parameters), 4, 0),
+	VERTEX_PROGRAM(color_v, 16, 4),
+	FRAGMENT_PROGRAM(color_f, NULL, 0, 0, 4),
+	VERTEX_PROGRAM(cube_v, 16, 10),
+	FRAGMENT_PROGRAM(cube_f, cube_f_parameters, ARRAY_SIZE(cube_f_parameters),
+		CUBE_F_UNIFORM_COUNT, 10),
+	VERTEX_PROGRAM(cube_textured_v, 16, 12),
+	FRAGMENT_PROGRAM_DERIVATIVES(cube_textured_f, cube_textured_f_parameters,
+		ARRAY_SIZE(cube_textured_f_parameters), CUBE_F_UNIFORM_COUNT, 12, 2),
+	VERTEX_PROGRAM(disable_color_buffer_v, 16, 0),
+	FRAGMENT_PROGRAM(disable_color_buffer_f, NULL, 0, 0, 0),
+	VERTEX_PROGRAM(portal_texture_v, PORTAL_TEXTURE_V_UNIFORM_COUNT, 3),
+	FRAGMENT_PROGRAM(portal_texture_f, portal_texture_f_parameters,
+		ARRAY_SIZE(portal_texture_f_parameters), 0, 3),
+	VERTEX_PROGRAM(upscale_v, 0, 2),
+	FRAGMENT_PROGRAM(upscale_f, upscale_f_parameters, ARRAY_SIZE(upscale_f_parameters), 0, 2),
+};
+
+const struct host_gxm_program_info *host_gxm_find_program_info(const SceGxmProgram *program)
+{
+	unsigned int i;
+
+	if (!program || memcmp(program->magic, HOST_GXM_PROGRAM_MAGIC, sizeof(program->magic)) != 0)
+		return NULL;
+
+	for (i = 0; i < ARRAY_SIZE(program_infos); i++) {
+		if (strncmp(program->name, program_infos[i].name, HOST_GXM_PROGRAM_NAME_SIZE) == 0)
+			return &program_infos[i];
+	}
+
+	return NULL;
+}
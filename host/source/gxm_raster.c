@@ -0,0 +1,958 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "gxm_internal.h"
+
+/*
+ * Tile-based rasterizer. Draws are vertex shaded, clipped against the near
+ * plane and set up as soon as they are submitted, and their triangles are
+ * binned into TILE_SIZE square tiles. sceGxmEndScene() then rasterizes
+ * the tiles in parallel, each one walking its bin in submission order, so
+ * the image does not depend on the number of threads.
+ *
+ * Tiles are scanned 4 pixels at a time with GCC vector extensions: edge
+ * functions (top-left fill rule, pixel centers at +0.5), depth, stencil
+ * tests and stencil ops are evaluated for the 4 pixels at once and only
+ * the pixels that pass run the fragment program. Varyings are interpolated
+ * perspective-correctly, depth linearly in screen space.
+ *
+ * Only the tiles overlapping the scene's valid region are binned, cleared
+ * and rasterized, so pixels outside it but in those tiles may be written.
+ *
+ * The number of threads (including the one calling sceGxmEndScene) is
+ * taken from GXMFUN_HOST_RASTER_THREADS, defaulting to one per CPU. When
+ * GXMFUN_HOST_STATS is set the totals are printed by sceGxmTerminate().
+ */
+
+#define TILE_SIZE 32
+#define MAX_RASTER_THREADS 16
+#define DEPTH_MAX 0xFFFFFF
+/* Clip position followed by the varyings */
+#define VERTEX_SIZE (4 + HOST_GXM_MAX_VARYINGS)
+/* A triangle clipped against one plane has at most 4 vertices */
+#define MAX_CLIPPED_VERTICES 4
+
+typedef float vec4f __attribute__((vector_size(16)));
+typedef int32_t vec4i __attribute__((vector_size(16)));
+typedef uint32_t vec4u __attribute__((vector_size(16)));
+
+struct screen_vertex {
+	float x;
+	float y;
+	float z;
+	/* 1/w, and the varyings divided by w */
+	float inv_w;
+	float varyings[HOST_GXM_MAX_VARYINGS];
+};
+
+/* What the tiles need from a draw once the vertices are processed */
+struct scene_draw {
+	struct host_gxm_state state;
+	float fragment_uniforms[HOST_GXM_MAX_UNIFORMS];
+};
+
+struct triangle {
+	struct screen_vertex v[3];
+	float inv_area;
+	/* All ones for the edges (v1 v2, v2 v0, v0 v1) that are top-left */
+	int32_t top_left[3];
+	int min_x;
+	int min_y;
+	int max_x;
+	int max_y;
+	unsigned int draw;
+};
+
+struct tile_bin {
+	unsigned int *triangles;
+	unsigned int count;
+	unsigned int capacity;
+};
+
+struct tile_counters {
+	uint64_t covered;
+	uint64_t shaded;
+};
+
+static struct {
+	struct host_gxm_target target;
+	struct scene_draw *draws;
+	unsigned int draw_count;
+	unsigned int draw_capacity;
+	struct triangle *triangles;
+	unsigned int triangle_count;
+	unsigned int triangle_capacity;
+	/* Tiles of the valid region, the first one is (tile_x0, tile_y0) */
+	struct tile_bin *bins;
+	unsigned int tile_x0;
+	unsigned int tile_y0;
+	unsigned int tiles_x;
+	unsigned int tiles_y;
+	/* Pixels covered by those tiles, inclusive */
+	int min_x;
+	int min_y;
+	int max_x;
+	int max_y;
+	unsigned int bin_capacity;
+	float *vertex_cache;
+	unsigned int vertex_cache_size;
+} scene;
+
+static struct {
+	pthread_t threads[MAX_RASTER_THREADS];
+	unsigned int thread_count;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned int generation;
+	/* Worker threads still rasterizing the current scene */
+	unsigned int running;
+	int quit;
+	unsigned int next_tile;
+} pool;
+
+static struct {
+	uint64_t scenes;
+	uint64_t triangles;
+	uint64_t pixels_covered;
+	uint64_t pixels_shaded;
+	/* Bytes of color written by the shaded pixels */
+	uint64_t color_bytes;
+	uint64_t geometry_ns;
+	uint64_t raster_ns;
+} stats;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static float clampf(float x)
+{
+	return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+/* Geometry: runs on the thread submitting the draws */
+
+static unsigned int fetch_index(const struct host_gxm_draw *draw, unsigned int i)
+{
+	if (draw->index_format == SCE_GXM_INDEX_FORMAT_U32)
+		return ((const uint32_t *)draw->indices)[i];
+	return ((const uint16_t *)draw->indices)[i];
+}
+
+static void shade_vertex(const struct host_gxm_draw *draw, unsigned int index, float *out)
+{
+	const SceGxmVertexProgram *program = draw->state.vertex_program;
+	float attributes[HOST_GXM_MAX_ATTRIBUTES][4];
+	unsigned int i, j;
+
+	for (i = 0; i < HOST_GXM_MAX_ATTRIBUTES; i++) {
+		attributes[i][0] = 0.0f;
+		attributes[i][1] = 0.0f;
+		attributes[i][2] = 0.0f;
+		attributes[i][3] = 1.0f;
+	}
+
+	for (i = 0; i < program->attribute_count; i++) {
+		const SceGxmVertexAttribute *attribute = &program->attributes[i];
+		const SceGxmVertexStream *stream = &program->streams[attribute->streamIndex];
+		const char *data = draw->state.vertex_streams[attribute->streamIndex];
+		const float *src;
+
+		if (!data || attribute->regIndex >= HOST_GXM_MAX_ATTRIBUTES ||
+		    attribute->format != SCE_GXM_ATTRIBUTE_FORMAT_F32)
+			continue;
+
+		src = (const float *)(data + index * stream->stride + attribute->offset);
+		for (j = 0; j < attribute->componentCount && j < 4; j++)
+			attributes[attribute->regIndex][j] = src[j];
+	}
+
+	program->info->vertex(draw->vertex_uniforms, (const float (*)[4])attributes, out, out + 4);
+}
+
+static void to_screen(const struct host_gxm_state *state, const float *clip,
+	unsigned int varying_count, struct screen_vertex *out)
+{
+	float inv_w = 1.0f / clip[3];
+	unsigned int i;
+
+	if (state->viewport_set) {
+		out->x = clip[0] * inv_w * state->viewport_scale[0] + state->viewport_offset[0];
+		out->y = clip[1] * inv_w * state->viewport_scale[1] + state->viewport_offset[1];
+		out->z = clip[2] * inv_w * state->viewport_scale[2] + state->viewport_offset[2];
+	} else {
+		out->x = (clip[0] * inv_w * 0.5f + 0.5f) * scene.target.width;
+		out->y = (0.5f - clip[1] * inv_w * 0.5f) * scene.target.height;
+		out->z = clip[2] * inv_w * 0.5f + 0.5f;
+	}
+	out->inv_w = inv_w;
+	for (i = 0; i < varying_count; i++)
+		out->varyings[i] = clip[4 + i] * inv_w;
+}
+
+static float edge(const struct screen_vertex *a, const struct screen_vertex *b, float px, float py)
+{
+	return (b->x - a->x) * (py - a->y) - (b->y - a->y) * (px - a->x);
+}
+
+/* Top-left rule for the edge a -> b of a triangle with positive area */
+static int is_top_left(const struct screen_vertex *a, const struct screen_vertex *b)
+{
+	float dx = b->x - a->x;
+	float dy = b->y - a->y;
+
+	return (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+}
+
+static int bin_push(struct tile_bin *bin, unsigned int triangle)
+{
+	if (bin->count == bin->capacity) {
+		unsigned int capacity = bin->capacity ? bin->capacity * 2 : 64;
+		unsigned int *triangles = realloc(bin->triangles, capacity * sizeof(*triangles));
+
+		if (!triangles)
+			return -1;
+		bin->triangles = triangles;
+		bin->capacity = capacity;
+	}
+
+	bin->triangles[bin->count++] = triangle;
+
+	return 0;
+}
+
+/* No pixel center of the tile is inside the edge a -> b */
+static int tile_outside_edge(const struct screen_vertex *a, const struct screen_vertex *b,
+	float x0, float y0, float x1, float y1)
+{
+	return edge(a, b, x0, y0) < 0.0f && edge(a, b, x1, y0) < 0.0f &&
+	       edge(a, b, x0, y1) < 0.0f && edge(a, b, x1, y1) < 0.0f;
+}
+
+static void bin_triangle(const struct screen_vertex *v0, const struct screen_vertex *v1,
+	const struct screen_vertex *v2, unsigned int draw)
+{
+	float area, min_x, min_y, max_x, max_y;
+	struct triangle *triangle;
+	unsigned int index, tx, ty;
+
+	area = edge(v0, v1, v2->x, v2->y);
+	if (area == 0.0f)
+		return;
+	if (area < 0.0f) {
+		const struct screen_vertex *tmp = v1;
+		v1 = v2;
+		v2 = tmp;
+		area = -area;
+	}
+
+	min_x = v0->x < v1->x ? v0->x : v1->x;
+	min_x = min_x < v2->x ? min_x : v2->x;
+	min_y = v0->y < v1->y ? v0->y : v1->y;
+	min_y = min_y < v2->y ? min_y : v2->y;
+	max_x = v0->x > v1->x ? v0->x : v1->x;
+	max_x = max_x > v2->x ? max_x : v2->x;
+	max_y = v0->y > v1->y ? v0->y : v1->y;
+	max_y = max_y > v2->y ? max_y : v2->y;
+
+	if (max_x < scene.min_x || max_y < scene.min_y ||
+	    min_x >= scene.max_x + 1 || min_y >= scene.max_y + 1)
+		return;
+
+	if (scene.triangle_count == scene.triangle_capacity) {
+		unsigned int capacity = scene.triangle_capacity ? scene.triangle_capacity * 2 : 256;
+		struct triangle *triangles = realloc(scene.triangles, capacity * sizeof(*triangles));
+
+		if (!triangles)
+			return;
+		scene.triangles = triangles;
+		scene.triangle_capacity = capacity;
+	}
+
+	index = scene.triangle_count++;
+	triangle = &scene.triangles[index];
+	triangle->v[0] = *v0;
+	triangle->v[1] = *v1;
+	triangle->v[2] = *v2;
+	triangle->inv_area = 1.0f / area;
+	triangle->top_left[0] = is_top_left(v1, v2) ? -1 : 0;
+	triangle->top_left[1] = is_top_left(v2, v0) ? -1 : 0;
+	triangle->top_left[2] = is_top_left(v0, v1) ? -1 : 0;
+	triangle->min_x = min_x < scene.min_x ? scene.min_x : (int)min_x;
+	triangle->min_y = min_y < scene.min_y ? scene.min_y : (int)min_y;
+	triangle->max_x = max_x >= scene.max_x + 1 ? scene.max_x : (int)max_x;
+	triangle->max_y = max_y >= scene.max_y + 1 ? scene.max_y : (int)max_y;
+	triangle->draw = draw;
+
+	for (ty = triangle->min_y / TILE_SIZE; ty <= triangle->max_y / TILE_SIZE; ty++) {
+		for (tx = triangle->min_x / TILE_SIZE; tx <= triangle->max_x / TILE_SIZE; tx++) {
+			float x0 = tx * TILE_SIZE + 0.5f;
+			float y0 = ty * TILE_SIZE + 0.5f;
+			float x1 = x0 + TILE_SIZE - 1;
+			float y1 = y0 + TILE_SIZE - 1;
+
+			if (tile_outside_edge(v1, v2, x0, y0, x1, y1) ||
+			    tile_outside_edge(v2, v0, x0, y0, x1, y1) ||
+			    tile_outside_edge(v0, v1, x0, y0, x1, y1))
+				continue;
+
+			bin_push(&scene.bins[(ty - scene.tile_y0) * scene.tiles_x + tx - scene.tile_x0],
+				index);
+		}
+	}
+}
+
+static void clip_lerp(const float *a, const float *b, float t, unsigned int size, float *out)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		out[i] = a[i] + (b[i] - a[i]) * t;
+}
+
+/* Clip against the near plane (z >= -w) and bin the resulting fan */
+static void setup_triangle(const struct host_gxm_draw *draw, unsigned int draw_index,
+	const float *c0, const float *c1, const float *c2)
+{
+	const unsigned int varying_count = draw->state.vertex_program->info->varying_count;
+	const unsigned int size = 4 + varying_count;
+	const float *in[3] = {c0, c1, c2};
+	float clipped[MAX_CLIPPED_VERTICES][VERTEX_SIZE];
+	struct screen_vertex screen[MAX_CLIPPED_VERTICES];
+	unsigned int count = 0;
+	unsigned int i;
+
+	for (i = 0; i < 3; i++) {
+		const float *a = in[i];
+		const float *b = in[(i + 1) % 3];
+		float da = a[2] + a[3];
+		float db = b[2] + b[3];
+
+		if (da >= 0.0f)
+			memcpy(clipped[count++], a, size * sizeof(float));
+		if ((da >= 0.0f) != (db >= 0.0f))
+			clip_lerp(a, b, da / (da - db), size, clipped[count++]);
+	}
+
+	if (count < 3)
+		return;
+
+	for (i = 0; i < count; i++)
+		to_screen(&draw->state, clipped[i], varying_count, &screen[i]);
+
+	for (i = 1; i + 1 < count; i++)
+		bin_triangle(&screen[0], &screen[i], &screen[i + 1], draw_index);
+}
+
+int host_gxm_scene_draw(const struct host_gxm_draw *draw)
+{
+	const struct host_gxm_program_info *fragment_info;
+	unsigned int i, max_index = 0, draw_index, triangle_count;
+	struct scene_draw *scene_draw;
+	const float *cache = NULL;
+	uint64_t start = now_ns();
+
+	if (!draw->index_count || !draw->state.vertex_program || !draw->state.fragment_program)
+		return 0;
+
+	for (i = 0; i < draw->index_count; i++) {
+		unsigned int index = fetch_index(draw, i);
+		if (index > max_index)
+			max_index = index;
+	}
+
+	if (scene.vertex_cache_size < max_index + 1) {
+		float *vertex_cache = realloc(scene.vertex_cache,
+			(max_index + 1) * VERTEX_SIZE * sizeof(float));
+		if (!vertex_cache)
+			return SCE_GXM_ERROR_OUT_OF_MEMORY;
+		scene.vertex_cache = vertex_cache;
+		scene.vertex_cache_size = max_index + 1;
+	}
+	cache = scene.vertex_cache;
+
+	if (scene.draw_count == scene.draw_capacity) {
+		unsigned int capacity = scene.draw_capacity ? scene.draw_capacity * 2 : 64;
+		struct scene_draw *draws = realloc(scene.draws, capacity * sizeof(*draws));
+
+		if (!draws)
+			return SCE_GXM_ERROR_OUT_OF_MEMORY;
+		scene.draws = draws;
+		scene.draw_capacity = capacity;
+	}
+
+	/* The uniform buffers may be reused before the tiles are rasterized */
+	draw_index = scene.draw_count++;
+	scene_draw = &scene.draws[draw_index];
+	scene_draw->state = draw->state;
+	fragment_info = draw->state.fragment_program->info;
+	if (draw->fragment_uniforms && fragment_info->uniform_count)
+		memcpy(scene_draw->fragment_uniforms, draw->fragment_uniforms,
+			(fragment_info->uniform_count < HOST_GXM_MAX_UNIFORMS ?
+			 fragment_info->uniform_count : HOST_GXM_MAX_UNIFORMS) * sizeof(float));
+
+	/* Draws only reference small index ranges, so shade all of them once */
+	for (i = 0; i <= max_index; i++)
+		shade_vertex(draw, i, scene.vertex_cache + i * VERTEX_SIZE);
+
+	triangle_count = scene.triangle_count;
+
+	if (draw->primitive == SCE_GXM_PRIMITIVE_TRIANGLE_STRIP) {
+		for (i = 0; i + 2 < draw->index_count; i++) {
+			const float *a = cache + fetch_index(draw, i) * VERTEX_SIZE;
+			const float *b = cache + fetch_index(draw, i + 1) * VERTEX_SIZE;
+			const float *c = cache + fetch_index(draw, i + 2) * VERTEX_SIZE;
+
+			/* Keep the winding of odd triangles consistent */
+			if (i & 1)
+				setup_triangle(draw, draw_index, b, a, c);
+			else
+				setup_triangle(draw, draw_index, a, b, c);
+		}
+	} else {
+		for (i = 0; i + 2 < draw->index_count; i += 3) {
+			setup_triangle(draw, draw_index,
+				cache + fetch_index(draw, i) * VERTEX_SIZE,
+				cache + fetch_index(draw, i + 1) * VERTEX_SIZE,
+				cache + fetch_index(draw, i + 2) * VERTEX_SIZE);
+		}
+	}
+
+	stats.triangles += scene.triangle_count - triangle_count;
+	stats.geometry_ns += now_ns() - start;
+
+	return 0;
+}
+
+/* Rasterization: runs on the raster threads, one tile at a time */
+
+static vec4i stencil_test(SceGxmStencilFunc func, vec4u ref, vec4u value)
+{
+	switch (func) {
+	case SCE_GXM_STENCIL_FUNC_NEVER:
+		return (vec4i){0, 0, 0, 0};
+	case SCE_GXM_STENCIL_FUNC_LESS:
+		return ref < value;
+	case SCE_GXM_STENCIL_FUNC_EQUAL:
+		return ref == value;
+	case SCE_GXM_STENCIL_FUNC_LESS_EQUAL:
+		return ref <= value;
+	case SCE_GXM_STENCIL_FUNC_GREATER:
+		return ref > value;
+	case SCE_GXM_STENCIL_FUNC_NOT_EQUAL:
+		return ref != value;
+	case SCE_GXM_STENCIL_FUNC_GREATER_EQUAL:
+		return ref >= value;
+	default:
+		return (vec4i){-1, -1, -1, -1};
+	}
+}
+
+static vec4i depth_test(SceGxmDepthFunc func, vec4u depth, vec4u stored)
+{
+	switch (func) {
+	case SCE_GXM_DEPTH_FUNC_NEVER:
+		return (vec4i){0, 0, 0, 0};
+	case SCE_GXM_DEPTH_FUNC_LESS:
+		return depth < stored;
+	case SCE_GXM_DEPTH_FUNC_EQUAL:
+		return depth == stored;
+	case SCE_GXM_DEPTH_FUNC_LESS_EQUAL:
+		return depth <= stored;
+	case SCE_GXM_DEPTH_FUNC_GREATER:
+		return depth > stored;
+	case SCE_GXM_DEPTH_FUNC_NOT_EQUAL:
+		return depth != stored;
+	case SCE_GXM_DEPTH_FUNC_GREATER_EQUAL:
+		return depth >= stored;
+	default:
+		return (vec4i){-1, -1, -1, -1};
+	}
+}
+
+static vec4u stencil_op(SceGxmStencilOp op, vec4u ref, vec4u value)
+{
+	const vec4u zero = {0, 0, 0, 0};
+	const vec4u max = {0xFF, 0xFF, 0xFF, 0xFF};
+
+	switch (op) {
+	case SCE_GXM_STENCIL_OP_ZERO:
+		return zero;
+	case SCE_GXM_STENCIL_OP_REPLACE:
+		return ref;
+	case SCE_GXM_STENCIL_OP_INCR:
+		return value + ((vec4u)(value < max) & 1);
+	case SCE_GXM_STENCIL_OP_DECR:
+		return value - ((vec4u)(value > zero) & 1);
+	case SCE_GXM_STENCIL_OP_INVERT:
+		return ~value & max;
+	case SCE_GXM_STENCIL_OP_INCR_WRAP:
+		return (value + 1) & max;
+	case SCE_GXM_STENCIL_OP_DECR_WRAP:
+		return (value - 1) & max;
+	default:
+		return value;
+	}
+}
+
+static uint32_t pack_color(const float color[4], uint32_t dst, unsigned char mask)
+{
+	uint32_t r = clampf(color[0]) * 255.0f + 0.5f;
+	uint32_t g = clampf(color[1]) * 255.0f + 0.5f;
+	uint32_t b = clampf(color[2]) * 255.0f + 0.5f;
+	uint32_t a = clampf(color[3]) * 255.0f + 0.5f;
+
+	if (mask & SCE_GXM_COLOR_MASK_R)
+		dst = (dst & ~0x000000FFu) | r;
+	if (mask & SCE_GXM_COLOR_MASK_G)
+		dst = (dst & ~0x0000FF00u) | (g << 8);
+	if (mask & SCE_GXM_COLOR_MASK_B)
+		dst = (dst & ~0x00FF0000u) | (b << 16);
+	if (mask & SCE_GXM_COLOR_MASK_A)
+		dst = (dst & ~0xFF000000u) | (a << 24);
+
+	return dst;
+}
+
+/* U5U6U5_RGB has no alpha, red is in the high bits */
+static uint16_t pack_color_565(const float color[4], uint16_t dst, unsigned char mask)
+{
+	uint16_t r = clampf(color[0]) * 31.0f + 0.5f;
+	uint16_t g = clampf(color[1]) * 63.0f + 0.5f;
+	uint16_t b = clampf(color[2]) * 31.0f + 0.5f;
+
+	if (mask & SCE_GXM_COLOR_MASK_R)
+		dst = (dst & ~0xF800u) | (r << 11);
+	if (mask & SCE_GXM_COLOR_MASK_G)
+		dst = (dst & ~0x07E0u) | (g << 5);
+	if (mask & SCE_GXM_COLOR_MASK_B)
+		dst = (dst & ~0x001Fu) | b;
+
+	return dst;
+}
+
+static vec4i lane_mask(int x, int end)
+{
+	const vec4i lanes = {0, 1, 2, 3};
+
+	return lanes < (vec4i){end - x, end - x, end - x, end - x};
+}
+
+static unsigned int count_lanes(vec4i mask)
+{
+	return (mask[0] & 1) + (mask[1] & 1) + (mask[2] & 1) + (mask[3] & 1);
+}
+
+static vec4u load4(const uint32_t *p, int count)
+{
+	vec4u v = {0, 0, 0, 0};
+	int i;
+
+	if (count >= 4) {
+		memcpy(&v, p, sizeof(v));
+	} else {
+		for (i = 0; i < count; i++)
+			v[i] = p[i];
+	}
+
+	return v;
+}
+
+static void store4(uint32_t *p, vec4u v, int count)
+{
+	int i;
+
+	if (count >= 4) {
+		memcpy(p, &v, sizeof(v));
+	} else {
+		for (i = 0; i < count; i++)
+			p[i] = v[i];
+	}
+}
+
+/* Perspective correct varyings at the barycentric coordinates b */
+static void interpolate_varyings(const struct triangle *triangle, const float b[3],
+	unsigned int count, float *varyings)
+{
+	const struct screen_vertex *v = triangle->v;
+	float pw = 1.0f / (b[0] * v[0].inv_w + b[1] * v[1].inv_w + b[2] * v[2].inv_w);
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		varyings[i] = (b[0] * v[0].varyings[i] + b[1] * v[1].varyings[i] +
+			b[2] * v[2].varyings[i]) * pw;
+}
+
+static void rasterize_triangle(const struct triangle *triangle, int tile_x0, int tile_y0,
+	int tile_x1, int tile_y1, struct tile_counters *counters)
+{
+	const struct scene_draw *draw = &scene.draws[triangle->draw];
+	const struct host_gxm_state *state = &draw->state;
+	const SceGxmFragmentProgram *fragment = state->fragment_program;
+	const unsigned int varying_count = fragment->info->varying_count;
+	const unsigned int derivative_count = fragment->info->derivative_count;
+	const struct screen_vertex *v0 = &triangle->v[0];
+	const struct screen_vertex *v1 = &triangle->v[1];
+	const struct screen_vertex *v2 = &triangle->v[2];
+	const struct screen_vertex *edge_a[3] = {v1, v2, v0};
+	const struct screen_vertex *edge_b[3] = {v2, v0, v1};
+	const vec4f lanes = {0.5f, 1.5f, 2.5f, 3.5f};
+	const vec4f one = {1.0f, 1.0f, 1.0f, 1.0f};
+	const vec4u stencil_mask = {state->stencil_compare_mask, state->stencil_compare_mask,
+		state->stencil_compare_mask, state->stencil_compare_mask};
+	const vec4u stencil_write_mask = {state->stencil_write_mask, state->stencil_write_mask,
+		state->stencil_write_mask, state->stencil_write_mask};
+	const vec4u stencil_ref = {state->stencil_ref, state->stencil_ref,
+		state->stencil_ref, state->stencil_ref};
+	const int write_depth = state->depth_write == SCE_GXM_DEPTH_WRITE_ENABLED;
+	const int color_565 = scene.target.color.colorFormat == SCE_GXM_COLOR_FORMAT_U5U6U5_RGB;
+	char *color_data = scene.target.color.data;
+	uint32_t *ds_data = scene.target.depth_stencil.depthData;
+	float dx[3], dy[3];
+	int x0, y0, x1, y1, x, y;
+	unsigned int i, lane;
+
+	x0 = triangle->min_x > tile_x0 ? triangle->min_x : tile_x0;
+	y0 = triangle->min_y > tile_y0 ? triangle->min_y : tile_y0;
+	x1 = triangle->max_x < tile_x1 - 1 ? triangle->max_x + 1 : tile_x1;
+	y1 = triangle->max_y < tile_y1 - 1 ? triangle->max_y + 1 : tile_y1;
+	/* Quads start 4-aligned within the tile */
+	x0 &= ~3;
+
+	for (i = 0; i < 3; i++) {
+		dx[i] = edge_b[i]->x - edge_a[i]->x;
+		dy[i] = edge_b[i]->y - edge_a[i]->y;
+	}
+
+	for (y = y0; y < y1; y++) {
+		float py = y + 0.5f;
+		float row[3];
+		char *color_row = color_data + y * scene.target.color.strideInPixels *
+			(color_565 ? 2 : 4);
+		uint32_t *ds_row = ds_data ?
+			ds_data + y * scene.target.depth_stencil.strideInSamples : NULL;
+
+		for (i = 0; i < 3; i++)
+			row[i] = dx[i] * (py - edge_a[i]->y);
+
+		for (x = x0; x < x1; x += 4) {
+			vec4f px = (float)x + lanes;
+			vec4f w[3];
+			vec4i covered = lane_mask(x, x1);
+			vec4i pass;
+
+			for (i = 0; i < 3; i++) {
+				w[i] = row[i] - dy[i] * (px - edge_a[i]->x);
+				covered &= (w[i] > 0.0f) | ((w[i] == 0.0f) & triangle->top_left[i]);
+			}
+
+			if (!(covered[0] | covered[1] | covered[2] | covered[3]))
+				continue;
+
+			counters->covered += count_lanes(covered);
+			pass = covered;
+
+			if (ds_row) {
+				vec4f b0 = w[0] * triangle->inv_area;
+				vec4f b1 = w[1] * triangle->inv_area;
+				vec4f b2 = w[2] * triangle->inv_area;
+				vec4f z = b0 * v0->z + b1 * v1->z + b2 * v2->z;
+				vec4u depth, stored_depth, stencil, new_stencil, ds;
+				vec4i stencil_pass, depth_pass;
+
+				/* clamp to [0, 1], 0.0f is all zero bits */
+				z = (vec4f)((vec4i)z & ~(z < 0.0f));
+				z = (vec4f)(((vec4i)z & ~(z > 1.0f)) | ((vec4i)one & (z > 1.0f)));
+				depth = __builtin_convertvector(z * (float)DEPTH_MAX, vec4u);
+
+				ds = load4(ds_row + x, x1 - x);
+				stored_depth = ds & DEPTH_MAX;
+				stencil = ds >> 24;
+
+				stencil_pass = stencil_test(state->stencil_func,
+					stencil_ref & stencil_mask, stencil & stencil_mask);
+				depth_pass = depth_test(state->depth_func, depth, stored_depth) & stencil_pass;
+
+				new_stencil = ((vec4u)~stencil_pass &
+						stencil_op(state->stencil_fail, stencil_ref, stencil)) |
+					((vec4u)(stencil_pass & ~depth_pass) &
+						stencil_op(state->depth_fail, stencil_ref, stencil)) |
+					((vec4u)depth_pass &
+						stencil_op(state->depth_pass, stencil_ref, stencil));
+				new_stencil = (stencil & ~stencil_write_mask) |
+					(new_stencil & stencil_write_mask);
+
+				if (write_depth)
+					stored_depth = ((vec4u)depth_pass & depth) |
+						((vec4u)~depth_pass & stored_depth);
+
+				ds = ((vec4u)covered & ((new_stencil << 24) | stored_depth)) |
+					((vec4u)~covered & ds);
+				store4(ds_row + x, ds, x1 - x);
+
+				pass &= depth_pass;
+			}
+
+			if (!fragment->color_mask)
+				continue;
+
+			for (lane = 0; lane < 4; lane++) {
+				float varyings[HOST_GXM_MAX_VARYINGS + 2 * HOST_GXM_MAX_DERIVATIVES];
+				float color[4];
+				float b[3];
+
+				if (!pass[lane])
+					continue;
+
+				for (i = 0; i < 3; i++)
+					b[i] = w[i][lane] * triangle->inv_area;
+				interpolate_varyings(triangle, b, varying_count, varyings);
+
+				/* Forward differences with the pixels right of and below this one */
+				if (derivative_count) {
+					float *ddx = &varyings[varying_count];
+					float *ddy = ddx + derivative_count;
+
+					for (i = 0; i < 3; i++)
+						b[i] = (w[i][lane] - dy[i]) * triangle->inv_area;
+					interpolate_varyings(triangle, b, derivative_count, ddx);
+					for (i = 0; i < 3; i++)
+						b[i] = (w[i][lane] + dx[i]) * triangle->inv_area;
+					interpolate_varyings(triangle, b, derivative_count, ddy);
+					for (i = 0; i < derivative_count; i++) {
+						ddx[i] -= varyings[i];
+						ddy[i] -= varyings[i];
+					}
+				}
+
+				fragment->info->fragment(draw->fragment_uniforms, state->fragment_textures,
+					varyings, color);
+				if (color_565) {
+					uint16_t *pixel = (uint16_t *)color_row + x + lane;
+
+					*pixel = pack_color_565(color, *pixel, fragment->color_mask);
+				} else {
+					uint32_t *pixel = (uint32_t *)color_row + x + lane;
+
+					*pixel = pack_color(color, *pixel, fragment->color_mask);
+				}
+				counters->shaded++;
+			}
+		}
+	}
+}
+
+static void rasterize_tile(unsigned int tile)
+{
+	const SceGxmDepthStencilSurface *ds = &scene.target.depth_stencil;
+	const struct tile_bin *bin = &scene.bins[tile];
+	struct tile_counters counters = {0, 0};
+	int x0 = (scene.tile_x0 + tile % scene.tiles_x) * TILE_SIZE;
+	int y0 = (scene.tile_y0 + tile / scene.tiles_x) * TILE_SIZE;
+	int x1 = x0 + TILE_SIZE < (int)scene.target.width ? x0 + TILE_SIZE : (int)scene.target.width;
+	int y1 = y0 + TILE_SIZE < (int)scene.target.height ? y0 + TILE_SIZE : (int)scene.target.height;
+	unsigned int i;
+	int x, y;
+
+	/* Depth and stencil are not loaded, they start from the background values */
+	if (ds->depthData) {
+		uint32_t value = ((uint32_t)ds->backgroundStencil << 24) |
+			(uint32_t)(ds->backgroundDepth * DEPTH_MAX);
+
+		for (y = y0; y < y1; y++) {
+			uint32_t *row = (uint32_t *)ds->depthData + y * ds->strideInSamples;
+			for (x = x0; x < x1; x++)
+				row[x] = value;
+		}
+	}
+
+	for (i = 0; i < bin->count; i++)
+		rasterize_triangle(&scene.triangles[bin->triangles[i]], x0, y0, x1, y1, &counters);
+
+	__atomic_fetch_add(&stats.pixels_covered, counters.covered, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.pixels_shaded, counters.shaded, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.color_bytes,
+		counters.shaded * host_gxm_color_format_size(scene.target.color.colorFormat),
+		__ATOMIC_RELAXED);
+}
+
+static void rasterize_tiles(void)
+{
+	const unsigned int tile_count = scene.tiles_x * scene.tiles_y;
+	unsigned int tile;
+
+	while ((tile = __atomic_fetch_add(&pool.next_tile, 1, __ATOMIC_RELAXED)) < tile_count)
+		rasterize_tile(tile);
+}
+
+static void *raster_thread(void *arg)
+{
+	unsigned int generation = 0;
+
+	pthread_mutex_lock(&pool.lock);
+
+	for (;;) {
+		while (!pool.quit && pool.generation == generation)
+			pthread_cond_wait(&pool.start, &pool.lock);
+		if (pool.quit)
+			break;
+
+		generation = pool.generation;
+		pthread_mutex_unlock(&pool.lock);
+
+		rasterize_tiles();
+
+		pthread_mutex_lock(&pool.lock);
+		if (--pool.running == 0)
+			pthread_cond_signal(&pool.done);
+	}
+
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+void host_gxm_raster_init(void)
+{
+	const char *threads_env = getenv("GXMFUN_HOST_RASTER_THREADS");
+	long thread_count;
+	unsigned int i;
+
+	memset(&stats, 0, sizeof(stats));
+	memset(&pool, 0, sizeof(pool));
+
+	thread_count = threads_env ? strtol(threads_env, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+	if (thread_count < 1)
+		thread_count = 1;
+	if (thread_count > MAX_RASTER_THREADS)
+		thread_count = MAX_RASTER_THREADS;
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.start, NULL);
+	pthread_cond_init(&pool.done, NULL);
+
+	/* The thread ending the scene rasterizes too */
+	pool.thread_count = 1;
+	for (i = 1; i < thread_count; i++) {
+		if (pthread_create(&pool.threads[i], NULL, raster_thread, NULL) != 0)
+			break;
+		pool.thread_count++;
+	}
+}
+
+void host_gxm_raster_terminate(void)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.quit = 1;
+	pthread_cond_broadcast(&pool.start);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 1; i < pool.thread_count; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	pthread_cond_destroy(&pool.done);
+	pthread_cond_destroy(&pool.start);
+	pthread_mutex_destroy(&pool.lock);
+
+	if (getenv("GXMFUN_HOST_STATS") && stats.scenes) {
+		double scenes = stats.scenes;
+		double raster_s = stats.raster_ns / 1e9;
+
+		printf("host gxm: %u raster threads, %llu scenes, %.1f triangles, "
+			"geometry %.3f ms, raster %.3f ms per scene, "
+			"%.3f Mpixels covered, %.3f Mpixels shaded per scene, %.1f Mpixels/s, "
+			"%.3f MB color written per scene\n",
+			pool.thread_count, (unsigned long long)stats.scenes,
+			stats.triangles / scenes, stats.geometry_ns / 1e6 / scenes,
+			stats.raster_ns / 1e6 / scenes, stats.pixels_covered / 1e6 / scenes,
+			stats.pixels_shaded / 1e6 / scenes,
+			raster_s > 0.0 ? stats.pixels_covered / 1e6 / raster_s : 0.0,
+			stats.color_bytes / 1e6 / scenes);
+	}
+
+	for (i = 0; i < scene.bin_capacity; i++)
+		free(scene.bins[i].triangles);
+	free(scene.bins);
+	free(scene.triangles);
+	free(scene.draws);
+	free(scene.vertex_cache);
+	memset(&scene, 0, sizeof(scene));
+}
+
+int host_gxm_scene_begin(const struct host_gxm_target *target)
+{
+	const SceGxmValidRegion *region = &target->valid_region;
+	unsigned int tile_x0 = region->xMin / TILE_SIZE;
+	unsigned int tile_y0 = region->yMin / TILE_SIZE;
+	unsigned int tiles_x = region->xMax / TILE_SIZE + 1 - tile_x0;
+	unsigned int tiles_y = region->yMax / TILE_SIZE + 1 - tile_y0;
+	unsigned int i;
+
+	if (tiles_x * tiles_y > scene.bin_capacity) {
+		struct tile_bin *bins = realloc(scene.bins, tiles_x * tiles_y * sizeof(*bins));
+
+		if (!bins)
+			return SCE_GXM_ERROR_OUT_OF_MEMORY;
+		memset(bins + scene.bin_capacity, 0,
+			(tiles_x * tiles_y - scene.bin_capacity) * sizeof(*bins));
+		scene.bins = bins;
+		scene.bin_capacity = tiles_x * tiles_y;
+	}
+
+	scene.target = *target;
+	scene.tile_x0 = tile_x0;
+	scene.tile_y0 = tile_y0;
+	scene.tiles_x = tiles_x;
+	scene.tiles_y = tiles_y;
+	scene.min_x = tile_x0 * TILE_SIZE;
+	scene.min_y = tile_y0 * TILE_SIZE;
+	scene.max_x = (tile_x0 + tiles_x) * TILE_SIZE < target->width ?
+		(int)((tile_x0 + tiles_x) * TILE_SIZE) - 1 : (int)target->width - 1;
+	scene.max_y = (tile_y0 + tiles_y) * TILE_SIZE < target->height ?
+		(int)((tile_y0 + tiles_y) * TILE_SIZE) - 1 : (int)target->height - 1;
+	scene.draw_count = 0;
+	scene.triangle_count = 0;
+	for (i = 0; i < tiles_x * tiles_y; i++)
+		scene.bins[i].count = 0;
+
+	return 0;
+}
+
+void host_gxm_scene_end(void)
+{
+	uint64_t start = now_ns();
+
+	pool.next_tile = 0;
+
+	if (pool.thread_count > 1) {
+		pthread_mutex_lock(&pool.lock);
+		pool.running = pool.thread_count - 1;
+		pool.generation++;
+		pthread_cond_broadcast(&pool.start);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	rasterize_tiles();
+
+	if (pool.thread_count > 1) {
+		pthread_mutex_lock(&pool.lock);
+		while (pool.running)
+			pthread_cond_wait(&pool.done, &pool.lock);
+		pthread_mutex_unlock(&pool.lock);
+	}
+
+	stats.scenes++;
+	stats.raster_ns += now_ns() - start;
+}
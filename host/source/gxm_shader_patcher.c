@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <string.h>
+#include "gxm_internal.h"
+
+/*
+ * There is nothing to patch on the host: registering a program looks up
+ * its C implementation, and vertex/fragment programs only keep the
+ * attribute layout and the color mask the rasterizer needs.
+ */
+
+struct SceGxmShaderPatcher {
+	SceGxmShaderPatcherParams params;
+};
+
+static void *patcher_alloc(SceGxmShaderPatcher *patcher, unsigned int size)
+{
+	if (patcher->params.hostAllocCallback)
+		return patcher->params.hostAllocCallback(patcher->params.userData, size);
+
+	return malloc(size);
+}
+
+static void patcher_free(SceGxmShaderPatcher *patcher, void *mem)
+{
+	if (patcher->params.hostFreeCallback)
+		patcher->params.hostFreeCallback(patcher->params.userData, mem);
+	else
+		free(mem);
+}
+
+int sceGxmShaderPatcherCreate(const SceGxmShaderPatcherParams *params, SceGxmShaderPatcher **shaderPatcher)
+{
+	SceGxmShaderPatcher *patcher;
+
+	if (!params || !shaderPatcher)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+
+	patcher = calloc(1, sizeof(*patcher));
+	if (!patcher)
+		return SCE_GXM_ERROR_OUT_OF_MEMORY;
+
+	patcher->params = *params;
+	*shaderPatcher = patcher;
+
+	return 0;
+}
+
+int sceGxmShaderPatcherDestroy(SceGxmShaderPatcher *shaderPatcher)
+{
+	free(shaderPatcher);
+
+	return 0;
+}
+
+int sceGxmShaderPatcherRegisterProgram(SceGxmShaderPatcher *shaderPatcher,
+	const SceGxmProgram *programHeader, SceGxmShaderPatcherId *programId)
+{
+	const struct host_gxm_program_info *info = host_gxm_find_program_info(programHeader);
+	SceGxmRegisteredProgram *registered;
+
+	if (!info)
+		return SCE_GXM_ERROR_INVALID_PROGRAM;
+
+	registered = patcher_alloc(shaderPatcher, sizeof(*registered));
+	if (!registered)
+		return SCE_GXM_ERROR_OUT_OF_MEMORY;
+
+	registered->program = programHeader;
+	registered->info = info;
+	*programId = registered;
+
+	return 0;
+}
+
+int sceGxmShaderPatcherUnregisterProgram(SceGxmShaderPatcher *shaderPatcher, SceGxmShaderPatcherId programId)
+{
+	patcher_free(shaderPatcher, programId);
+
+	return 0;
+}
+
+const SceGxmProgram *sceGxmShaderPatcherGetProgramFromId(SceGxmShaderPatcherId programId)
+{
+	return programId ? programId->program : NULL;
+}
+
+int sceGxmShaderPatcherCreateVertexProgram(SceGxmShaderPatcher *shaderPatcher,
+	SceGxmShaderPatcherId programId, const SceGxmVertexAttribute *attributes,
+	unsigned int attributeCount, const SceGxmVertexStream *streams, unsigned int streamCount,
+	SceGxmVertexProgram **vertexProgram)
+{
+	SceGxmVertexProgram *program;
+
+	if (!programId || programId->info->type != HOST_GXM_VERTEX_PROGRAM)
+		return SCE_GXM_ERROR_INVALID_PROGRAM;
+	if (attributeCount > HOST_GXM_MAX_ATTRIBUTES || streamCount > HOST_GXM_MAX_STREAMS)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	program = patcher_alloc(shaderPatcher, sizeof(*program));
+	if (!program)
+		return SCE_GXM_ERROR_OUT_OF_MEMORY;
+
+	memset(program, 0, sizeof(*program));
+	program->info = programId->info;
+	memcpy(program->attributes, attributes, attributeCount * sizeof(*attributes));
+	program->attribute_count = attributeCount;
+	memcpy(program->streams, streams, streamCount * sizeof(*streams));
+	program->stream_count = streamCount;
+	*vertexProgram = program;
+
+	return 0;
+}
+
+int sceGxmShaderPatcherCreateFragmentProgram(SceGxmShaderPatcher *shaderPatcher,
+	SceGxmShaderPatcherId programId, SceGxmOutputRegisterFormat outputFormat,
+	SceGxmMultisampleMode multisampleMode, const SceGxmBlendInfo *blendInfo,
+	const SceGxmProgram *vertexProgram, SceGxmFragmentProgram **fragmentProgram)
+{
+	SceGxmFragmentProgram *program;
+
+	if (!programId || programId->info->type != HOST_GXM_FRAGMENT_PROGRAM)
+		return SCE_GXM_ERROR_INVALID_PROGRAM;
+
+	program = patcher_alloc(shaderPatcher, sizeof(*program));
+	if (!program)
+		return SCE_GXM_ERROR_OUT_OF_MEMORY;
+
+	program->info = programId->info;
+	program->color_mask = blendInfo ? blendInfo->colorMask : SCE_GXM_COLOR_MASK_ALL;
+	*fragmentProgram = program;
+
+	return 0;
+}
+
+int sceGxmShaderPatcherReleaseVertexProgram(SceGxmShaderPatcher *shaderPatcher, SceGxmVertexProgram *vertexProgram)
+{
+	patcher_free(shaderPatcher, vertexProgram);
+
+	return 0;
+}
+
+int sceGxmShaderPatcherReleaseFragmentProgram(SceGxmShaderPatcher *shaderPatcher, SceGxmFragmentProgram *fragmentProgram)
+{
+	patcher_free(shaderPatcher, fragmentProgram);
+
+	return 0;
+}
+
+unsigned int sceGxmProgramGetSize(const SceGxmProgram *program)
+{
+	return sizeof(*program);
+}
+
+unsigned int sceGxmProgramGetParameterCount(const SceGxmProgram *program)
+{
+	const struct host_gxm_program_info *info = host_gxm_find_program_info(program);
+
+	return info ? info->parameter_count : 0;
+}
+
+const SceGxmProgramParameter *sceGxmProgramGetParameter(const SceGxmProgram *program, unsigned int index)
+{
+	const struct host_gxm_program_info *info = host_gxm_find_program_info(program);
+
+	if (!info || index >= info->parameter_count)
+		return NULL;
+
+	return &info->parameters[index];
+}
+
+const SceGxmProgramParameter *sceGxmProgramFindParameterByName(const SceGxmProgram *program, const char *name)
+{
+	const struct host_gxm_program_info *info = host_gxm_find_program_info(program);
+	unsigned int i;
+
+	if (!info || !name)
+		return NULL;
+
+	for (i = 0; i < info->parameter_count; i++) {
+		if (strcmp(info->parameters[i].name, name) == 0)
+			return &info->parameters[i];
+	}
+
+	return NULL;
+}
+
+unsigned int sceGxmProgramParameterGetIndex(const SceGxmProgram *program, const SceGxmProgramParameter *parameter)
+{
+	const struct host_gxm_program_info *info = host_gxm_find_program_info(program);
+
+	if (!info || parameter < info->parameters ||
+	    parameter >= info->parameters + info->parameter_count)
+		return 0;
+
+	return parameter - info->parameters;
+}
+
+unsigned int sceGxmProgramParameterGetResourceIndex(const SceGxmProgramParameter *parameter)
+{
+	return parameter ? parameter->resource_index : 0;
+}
+
+int sceGxmSetUniformDataF(void *uniformBuffer, const SceGxmProgramParameter *parameter,
+	unsigned int componentOffset, unsigned int componentCount, const float *sourceData)
+{
+	if (!uniformBuffer || !parameter || !sourceData)
+		return SCE_GXM_ERROR_INVALID_POINTER;
+	if (parameter->category != HOST_GXM_PARAMETER_UNIFORM ||
+	    componentOffset + componentCount > parameter->component_count)
+		return SCE_GXM_ERROR_INVALID_VALUE;
+
+	memcpy((float *)uniformBuffer + parameter->resource_index + componentOffset,
+		sourceData, componentCount * sizeof(float));
+
+	return 0;
+}
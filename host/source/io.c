@@ -0,0 +1,41 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <psp2/io/fcntl.h>
+
+/* Only reading is supported, uids are the host file descriptors */
+SceUID sceIoOpen(const char *file, int flags, SceMode mode)
+{
+	if (flags != SCE_O_RDONLY)
+		return -1;
+
+	return open(file, O_RDONLY);
+}
+
+int sceIoClose(SceUID fd)
+{
+	return close(fd) == 0 ? 0 : -1;
+}
+
+int sceIoRead(SceUID fd, void *buf, SceSize nbyte)
+{
+	return read(fd, buf, nbyte);
+}
+
+int sceIoPread(SceUID fd, void *data, SceSize size, SceOff offset)
+{
+	return pread(fd, data, size, offset);
+}
+
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence)
+{
+	static const int whences[] = {
+		[SCE_SEEK_SET] = SEEK_SET,
+		[SCE_SEEK_CUR] = SEEK_CUR,
+		[SCE_SEEK_END] = SEEK_END
+	};
+
+	if (whence < SCE_SEEK_SET || whence > SCE_SEEK_END)
+		return -1;
+
+	return lseek(fd, offset, whences[whence]);
+}
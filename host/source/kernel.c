@@ -0,0 +1,68 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <psp2/kernel/sysmem.h>
+#include <psp2/kernel/processmgr.h>
+
+#define MAX_MEMBLOCKS 64
+#define MEMBLOCK_ALIGNMENT 4096
+
+static void *memblocks[MAX_MEMBLOCKS];
+
+/* Memory blocks are plain page aligned allocations, uids are index + 1 */
+SceUID sceKernelAllocMemBlock(const char *name, SceKernelMemBlockType type, SceSize size, void *optp)
+{
+	SceSize aligned_size = (size + MEMBLOCK_ALIGNMENT - 1) & ~(MEMBLOCK_ALIGNMENT - 1);
+	unsigned int i;
+
+	if (!aligned_size)
+		return -1;
+
+	for (i = 0; i < MAX_MEMBLOCKS; i++) {
+		if (memblocks[i])
+			continue;
+
+		memblocks[i] = aligned_alloc(MEMBLOCK_ALIGNMENT, aligned_size);
+		if (!memblocks[i])
+			return -1;
+		memset(memblocks[i], 0, aligned_size);
+
+		return i + 1;
+	}
+
+	return -1;
+}
+
+int sceKernelFreeMemBlock(SceUID uid)
+{
+	if (uid < 1 || uid > MAX_MEMBLOCKS || !memblocks[uid - 1])
+		return -1;
+
+	free(memblocks[uid - 1]);
+	memblocks[uid - 1] = NULL;
+
+	return 0;
+}
+
+int sceKernelGetMemBlockBase(SceUID uid, void **basep)
+{
+	if (uid < 1 || uid > MAX_MEMBLOCKS || !memblocks[uid - 1])
+		return -1;
+
+	*basep = memblocks[uid - 1];
+
+	return 0;
+}
+
+SceUInt64 sceKernelGetProcessTimeWide(void)
+{
+	static struct timespec start;
+	struct timespec ts;
+
+	if (!start.tv_sec && !start.tv_nsec)
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (SceUInt64)(ts.tv_sec - start.tv_sec) * 1000000 +
+		(ts.tv_nsec - start.tv_nsec) / 1000;
+}
@@ -0,0 +1,96 @@
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <stdint.h>
+#include <psp2/types.h>
+
+/*
+ * Packed asset archive, written by tools/asset_pack. A header and a
+ * table of contents sorted by name are followed by the data of each
+ * entry, stored as is or as one LZ4 block, at an offset aligned to what
+ * the entry asked for so an uncompressed entry can be read straight into
+ * its destination. Opening an archive reads the header and the table of
+ * contents; entries are then read with positional reads, so any thread
+ * can load them. All values are little-endian.
+ */
+
+#define ASSET_ARCHIVE_MAGIC "GXMA"
+#define ASSET_ARCHIVE_VERSION 1
+#define ASSET_ARCHIVE_NAME_SIZE 48
+/* Smallest alignment of the entries, a power of two like all of them */
+#define ASSET_ARCHIVE_MIN_ALIGN 16
+#define ASSET_ARCHIVE_MAX_ALIGN 4096
+
+enum asset_compression {
+	ASSET_COMPRESSION_NONE,
+	ASSET_COMPRESSION_LZ4
+};
+
+struct asset_archive_entry {
+	/* NUL terminated */
+	char name[ASSET_ARCHIVE_NAME_SIZE];
+	uint32_t offset;
+	/* Bytes in the archive */
+	uint32_t stored_size;
+	/* Bytes once loaded */
+	uint32_t size;
+	uint32_t compression;
+	/* Of the offset, and what the destination should be aligned to */
+	uint32_t alignment;
+	uint32_t reserved;
+};
+
+struct asset_archive_header {
+	char magic[4];
+	uint32_t version;
+	/* Bytes in the file */
+	uint32_t size;
+	uint32_t entry_count;
+	uint32_t toc_offset;
+	uint32_t reserved[3];
+};
+
+struct asset_archive {
+	SceUID fd;
+	struct asset_archive_header header;
+	struct asset_archive_entry *entries;
+	/* Largest stored size of a compressed entry */
+	uint32_t max_compressed_size;
+};
+
+/* Returns -1 if the file can't be read or is malformed */
+int asset_archive_open(struct asset_archive *archive, const char *path);
+void asset_archive_close(struct asset_archive *archive);
+/* NULL if there is no entry with that name */
+const struct asset_archive_entry *asset_archive_find(const struct asset_archive *archive,
+	const char *name);
+
+/* Read size bytes at offset in the file. Returns -1 on a read error */
+int asset_archive_read(const struct asset_archive *archive, uint32_t offset, void *data,
+	uint32_t size);
+/*
+ * Load an entry into entry->size bytes at destination, on the calling
+ * thread. A compressed entry is read into scratch first, which needs
+ * entry->stored_size bytes. Returns -1 on a read error or a corrupt entry.
+ */
+int asset_archive_load(const struct asset_archive *archive,
+	const struct asset_archive_entry *entry, void *destination, void *scratch);
+
+struct asset_archive_source {
+	const char *name;
+	const void *data;
+	uint32_t size;
+	/* 0 for ASSET_ARCHIVE_MIN_ALIGN */
+	uint32_t alignment;
+	/* Stored with LZ4 if that makes it smaller */
+	int compress;
+};
+
+/*
+ * Write an archive of count entries with unique names. Returns -1 if a
+ * name or an alignment is invalid or the file can't be written.
+ */
+int asset_archive_write(const char *path, const struct asset_archive_source *sources,
+	unsigned int count);
+
+#endif
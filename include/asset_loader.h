@@ -0,0 +1,117 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "asset_archive.h"
+#include "spsc_queue.h"
+
+/*
+ * Loads archive entries on a background thread. One thread (the render
+ * thread in the demo) queues requests with memory it allocated, since
+ * gpu_memory is not thread-safe, and polls for the finished ones, which
+ * the loader hands back through a lock-free queue: neither call waits on
+ * I/O. Entries are read ASSET_LOADER_CHUNK_SIZE bytes at a time, so
+ * progress moves through large entries and finishing doesn't wait for a
+ * whole one. Compressed entries are read into a staging buffer and
+ * decompressed into their destination.
+ */
+
+#define ASSET_LOADER_MAX_REQUESTS 64
+#define ASSET_LOADER_CHUNK_SIZE (256 * 1024)
+
+enum asset_request_status {
+	ASSET_REQUEST_PENDING,
+	ASSET_REQUEST_DONE,
+	/* Read error, corrupt entry, or the loader finished first */
+	ASSET_REQUEST_FAILED
+};
+
+struct asset_request {
+	const struct asset_archive_entry *entry;
+	/* entry->size bytes */
+	void *destination;
+	void *user;
+	enum asset_request_status status;
+	/* From the loader taking the request to the end of the load */
+	uint64_t load_ns;
+};
+
+struct asset_loader_progress {
+	unsigned int requested;
+	/* Polled, failed included */
+	unsigned int completed;
+	unsigned int failed;
+	uint64_t bytes_requested;
+	/*
+	 * Of bytes_requested, the part the loader is through with, partly
+	 * loaded entries included. Reaches bytes_requested when every request
+	 * finished, failed ones included.
+	 */
+	uint64_t bytes_loaded;
+};
+
+struct asset_loader_stats {
+	/* Read from the archive and written to the destinations */
+	uint64_t bytes_read;
+	uint64_t bytes_loaded;
+	/* Part of bytes_loaded that was compressed */
+	uint64_t bytes_decompressed;
+	uint64_t read_ns;
+	uint64_t decompress_ns;
+	/* Time the loader had requests to work on */
+	uint64_t busy_ns;
+};
+
+struct asset_loader {
+	const struct asset_archive *archive;
+	pthread_t thread;
+	/* Only wake the loader, which sleeps on cond while it has no request */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int running;
+
+	struct asset_request requests[ASSET_LOADER_MAX_REQUESTS];
+	/* Published by the caller, the loader takes them in order */
+	unsigned int submitted;
+	struct spsc_queue completed;
+
+	/* Loader thread only */
+	void *staging;
+	unsigned int taken;
+
+	/* Caller only */
+	unsigned int requested;
+	unsigned int polled;
+	unsigned int failed;
+	uint64_t bytes_requested;
+
+	/* Written by the loader, read atomically */
+	uint64_t bytes_loaded;
+	struct asset_loader_stats stats;
+};
+
+/* Starts the loader thread. Returns -1 on failure */
+int asset_loader_init(struct asset_loader *loader, const struct asset_archive *archive);
+/*
+ * Stop the loader thread, leaving the requests it hasn't finished. Their
+ * destinations are no longer written once this returns.
+ */
+void asset_loader_finish(struct asset_loader *loader);
+
+/*
+ * Queue a load of entry into destination. Returns the request, which
+ * stays valid until asset_loader_poll() returns it, or NULL if
+ * ASSET_LOADER_MAX_REQUESTS are already in flight.
+ */
+struct asset_request *asset_loader_request(struct asset_loader *loader,
+	const struct asset_archive_entry *entry, void *destination, void *user);
+/* A finished request, in request order, or NULL if none finished since */
+struct asset_request *asset_loader_poll(struct asset_loader *loader);
+
+void asset_loader_get_progress(struct asset_loader *loader,
+	struct asset_loader_progress *progress);
+void asset_loader_get_stats(struct asset_loader *loader, struct asset_loader_stats *stats);
+void asset_loader_print_stats(const struct asset_loader_stats *stats);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+#include "render_counters.h"
+
+/*
+ * Benchmark results of a run: frame time percentiles, CPU time per
+ * profiler scope, draws and primitives per pass and the GPU memory peak,
+ * written as JSON for tools/bench_compare. The first warmup frames, while
+ * caches and the shader patcher settle, are left out.
+ *
+ * Every metric is a number where lower is better, so a comparison only
+ * has to look for increases.
+ */
+
+#ifndef BENCHMARK_WARMUP_FRAMES
+#define BENCHMARK_WARMUP_FRAMES 10
+#endif
+
+struct benchmark {
+	unsigned int warmup_frames;
+	/* Frames begun so far, including the warmup */
+	unsigned int frames;
+	uint64_t last_frame_start_ns;
+	/* Start to start time of every measured frame */
+	uint64_t *frame_ns;
+	unsigned int frame_ns_count;
+	unsigned int frame_ns_capacity;
+	uint64_t counters[RENDER_PASS_COUNT][RENDER_COUNTER_COUNT];
+	unsigned int counted_frames;
+};
+
+void benchmark_init(struct benchmark *benchmark, unsigned int warmup_frames);
+void benchmark_free(struct benchmark *benchmark);
+/* Call at the start of every frame */
+void benchmark_begin_frame(struct benchmark *benchmark, uint64_t now_ns);
+/* Call after render_counters_end_frame() */
+void benchmark_end_frame(struct benchmark *benchmark);
+/* Returns -1 if there are no measured frames or the file can't be written */
+int benchmark_write_json(const struct benchmark *benchmark, const char *path);
+
+#endif
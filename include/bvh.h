@@ -0,0 +1,87 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdint.h>
+#include "math_utils.h"
+
+/*
+ * Bounding volume hierarchy over axis-aligned boxes, built with the
+ * binned surface area heuristic. Nodes are 32 bytes, two per cache line
+ * on 64-byte lines, and siblings are stored next to each other after
+ * their parent, so a refit is a single back to front pass.
+ *
+ * Culling walks the tree once for up to BVH_MAX_FRUSTUMS frustums (e.g.
+ * the camera and the portal views): a subtree is only visited for the
+ * frustums that may see it, and once it is entirely inside a frustum its
+ * boxes are reported without further tests. The box tests check four
+ * planes at a time with the compiler's vector extensions.
+ */
+
+#define BVH_MAX_FRUSTUMS 8
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_BINS 12
+/* Deeper nodes become leaves whatever their size */
+#define BVH_MAX_DEPTH 64
+
+struct bvh_aabb {
+	vector3f min;
+	vector3f max;
+};
+
+struct bvh_node {
+	vector3f min;
+	/* First primitive of a leaf, left child of an inner node */
+	uint32_t first;
+	vector3f max;
+	/* 0 for an inner node */
+	uint32_t count;
+};
+
+struct bvh {
+	struct bvh_node *nodes;
+	unsigned int node_count;
+	/* Primitive indices, each leaf references a range */
+	uint32_t *indices;
+	unsigned int primitive_count;
+	unsigned int capacity;
+	/* Scratch for the build and refit */
+	vector3f *centroids;
+	uint8_t *node_changed;
+};
+
+/*
+ * Six planes padded to eight, laid out for four-wide tests, with the
+ * absolute values of the normals for the box extents.
+ */
+struct bvh_frustum {
+	float x[8] __attribute__((aligned(16)));
+	float y[8] __attribute__((aligned(16)));
+	float z[8] __attribute__((aligned(16)));
+	float w[8] __attribute__((aligned(16)));
+	float abs_x[8] __attribute__((aligned(16)));
+	float abs_y[8] __attribute__((aligned(16)));
+	float abs_z[8] __attribute__((aligned(16)));
+};
+
+void bvh_init(struct bvh *bvh);
+void bvh_free(struct bvh *bvh);
+/* Returns -1 on allocation failure */
+int bvh_build(struct bvh *bvh, const struct bvh_aabb *boxes, unsigned int count);
+/*
+ * Update the node bounds after boxes moved, keeping the tree topology.
+ * changed flags the moved boxes (nonzero), NULL refits everything.
+ */
+void bvh_refit(struct bvh *bvh, const struct bvh_aabb *boxes, const uint8_t *changed);
+
+void bvh_frustum_init(struct bvh_frustum *frustum, const vector4f planes[6]);
+/*
+ * Write the indices of the boxes that intersect each frustum to
+ * visible[i], which has room for capacity of them, and their number to
+ * visible_count[i]. Boxes from index capacity on are left out. boxes are
+ * the ones the tree was built or refit with.
+ */
+void bvh_cull(const struct bvh *bvh, const struct bvh_aabb *boxes,
+	const struct bvh_frustum *frustums, unsigned int frustum_count,
+	uint32_t *const visible[], unsigned int visible_count[], unsigned int capacity);
+
+#endif
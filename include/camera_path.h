@@ -0,0 +1,41 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include "math_utils.h"
+
+/*
+ * Scripted camera and portal path, a Catmull-Rom spline through keyframes.
+ *
+ * Text format, one keyframe per line in increasing time order, blank
+ * lines and lines starting with '#' are ignored:
+ *
+ *   time  camera_position(x y z)  camera_rotation(x y z)
+ *         portal_end2_translation(x y z)  portal_end2_rotation(x y z)
+ *
+ * Times are in seconds and rotations in degrees.
+ */
+
+#define CAMERA_PATH_MAX_KEYS 256
+
+struct camera_path_key {
+	float time;
+	vector3f camera_position;
+	vector3f camera_rotation;
+	vector3f portal_end2_translation;
+	vector3f portal_end2_rotation;
+};
+
+struct camera_path {
+	struct camera_path_key *keys;
+	unsigned int num_keys;
+};
+
+/* Returns -1 if the file can't be read or is malformed */
+int camera_path_load(struct camera_path *path, const char *filename);
+void camera_path_free(struct camera_path *path);
+float camera_path_duration(const struct camera_path *path);
+/* time is clamped to [0, duration], rotations are returned in radians */
+void camera_path_evaluate(const struct camera_path *path, float time,
+	struct camera_path_key *key);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef COMMAND_MEMORY_H
+#define COMMAND_MEMORY_H
+
+#include <psp2/gxm.h>
+
+/*
+ * Command memory for a GXM deferred context. Each of the VDM, vertex and
+ * fragment pools is split in region_count regions, and a region is handed
+ * out in chunks to the context callbacks while a frame is recorded. With
+ * as many regions as frames that can be in flight, a region is never
+ * reused while the GPU may still read the command lists recorded in it.
+ */
+
+#define COMMAND_MEMORY_CHUNK_SIZE (16 * 1024)
+
+struct command_memory_pool {
+	char *base;
+	unsigned int region_size;
+	/* Offset within the current region */
+	unsigned int offset;
+	/* Highest offset reached in any region */
+	unsigned int peak;
+	/* Callback requests that could not be satisfied */
+	unsigned int failed;
+};
+
+struct command_memory {
+	unsigned int region_count;
+	unsigned int region;
+	struct command_memory_pool vdm;
+	struct command_memory_pool vertex;
+	struct command_memory_pool fragment;
+};
+
+unsigned int command_memory_required_size(unsigned int vdm_size, unsigned int vertex_size,
+	unsigned int fragment_size, unsigned int region_count);
+
+/* memory must be GPU mapped and command_memory_required_size() bytes long */
+void command_memory_init(struct command_memory *memory, void *base, unsigned int vdm_size,
+	unsigned int vertex_size, unsigned int fragment_size, unsigned int region_count);
+
+/* Switch to the next region, call before recording each frame */
+void command_memory_next_region(struct command_memory *memory);
+
+/* Sets the callbacks and callback data of the deferred context params */
+void command_memory_set_deferred_context_params(struct command_memory *memory,
+	SceGxmDeferredContextParams *params);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <stdint.h>
+
+/*
+ * Resolution scale controller. Fed the time of every frame, it picks the
+ * scale of the render size to the display size for the next one, within
+ * [min_scale, max_scale].
+ *
+ * The GPU time goes with the pixel count, so it controls the logarithm of
+ * the rendered area: a PI controller in velocity form on
+ * log(target / frame time), the change of log area that would meet the
+ * target if the frame were all fill. It takes resolution away faster than
+ * it gives it back, so a spike is absorbed in a few frames without the
+ * scale oscillating around the target.
+ *
+ * With vsync the frame time can't drop below the refresh period and shows
+ * no headroom, so frames within the deadband of the target slowly raise
+ * the scale until one misses.
+ */
+
+struct dynres_controller {
+	float min_scale;
+	float max_scale;
+	float target_ms;
+	/* Log of the rendered area over the display area */
+	float log_area;
+	float previous_error;
+	float scale;
+	/* Since the last dynres_reset_stats() */
+	unsigned int frames;
+	float scale_sum;
+	float scale_min;
+	float scale_max;
+};
+
+/* Starts at max_scale */
+void dynres_init(struct dynres_controller *controller, float min_scale, float max_scale,
+	float target_ms);
+/* Returns the scale for the next frame */
+float dynres_update(struct dynres_controller *controller, uint64_t frame_ns);
+void dynres_print_stats(const struct dynres_controller *controller, const char *name);
+void dynres_reset_stats(struct dynres_controller *controller);
+
+#endif
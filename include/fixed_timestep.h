@@ -0,0 +1,30 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <stdint.h>
+
+/*
+ * Fixed timestep accumulator: the elapsed real time is consumed in
+ * steps of step_ns, and whatever is left is the fraction of a step the
+ * renderer should interpolate by between the last two states.
+ */
+
+struct fixed_timestep {
+	uint64_t step_ns;
+	uint64_t accumulator_ns;
+	uint64_t last_ns;
+	/* Steps taken at most per advance, the rest of the time is dropped */
+	unsigned int max_steps;
+	/* Time dropped because of max_steps */
+	uint64_t dropped_ns;
+};
+
+void fixed_timestep_init(struct fixed_timestep *timestep, unsigned int steps_per_second,
+	unsigned int max_steps);
+/* Returns the number of steps to simulate to catch up with now_ns */
+unsigned int fixed_timestep_advance(struct fixed_timestep *timestep, uint64_t now_ns);
+/* Interpolation factor in [0, 1) between the previous and the current step */
+float fixed_timestep_alpha(const struct fixed_timestep *timestep);
+float fixed_timestep_step_seconds(const struct fixed_timestep *timestep);
+
+#endif
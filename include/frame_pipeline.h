@@ -0,0 +1,90 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "spsc_queue.h"
+
+/*
+ * Runs the simulation of frame N+1 on its own thread while the render
+ * thread submits frame N. The simulation writes each frame into one of
+ * the snapshot slots and hands it over through a lock-free queue; the
+ * render thread gives the slot back once it is done with it. A thread
+ * that finds its queue empty spins briefly, then sleeps until the other
+ * one pushes.
+ */
+
+#define FRAME_PIPELINE_MAX_SLOTS 3
+
+enum pipeline_mode {
+	/* Simulate and render in sequence on the calling thread */
+	PIPELINE_MODE_OFF,
+	/* Double buffered: the simulation runs at most one frame ahead */
+	PIPELINE_MODE_LATENCY,
+	/* Triple buffered: the simulation can run two frames ahead */
+	PIPELINE_MODE_THROUGHPUT
+};
+
+/* Fills the snapshot for the next frame, returns 0 after the last one */
+typedef int (*frame_pipeline_produce_function)(void *user_data, void *snapshot);
+
+struct frame_pipeline_slot {
+	void *snapshot;
+	int last;
+	uint64_t produce_ns;
+};
+
+struct frame_pipeline_stats {
+	unsigned int frames;
+	/* Time spent producing snapshots */
+	uint64_t simulation_ns;
+	/* Time between acquiring and releasing a snapshot */
+	uint64_t render_ns;
+	/* Time between consecutive acquires */
+	uint64_t frame_ns;
+	/* Time each thread spent blocked on the other */
+	uint64_t render_wait_ns;
+	uint64_t simulation_wait_ns;
+};
+
+struct frame_pipeline {
+	enum pipeline_mode mode;
+	unsigned int slot_count;
+	struct frame_pipeline_slot slots[FRAME_PIPELINE_MAX_SLOTS];
+	struct spsc_queue ready_queue;
+	struct spsc_queue free_queue;
+	frame_pipeline_produce_function produce;
+	void *user_data;
+	pthread_t thread;
+	int running;
+	/* Sleeping on the queues, both paired with lock */
+	pthread_mutex_t lock;
+	pthread_cond_t ready_cond;
+	pthread_cond_t free_cond;
+	int ready_waiting;
+	int free_waiting;
+	uint64_t last_acquire_ns;
+	uint64_t acquire_ns;
+	uint64_t simulation_wait_ns;
+	struct frame_pipeline_stats stats;
+};
+
+/* snapshots points to FRAME_PIPELINE_MAX_SLOTS snapshots of snapshot_size bytes */
+int frame_pipeline_init(struct frame_pipeline *pipeline, enum pipeline_mode mode,
+	void *snapshots, unsigned int snapshot_size,
+	frame_pipeline_produce_function produce, void *user_data);
+void frame_pipeline_finish(struct frame_pipeline *pipeline);
+
+/* Render thread side */
+struct frame_pipeline_slot *frame_pipeline_acquire(struct frame_pipeline *pipeline);
+void frame_pipeline_release(struct frame_pipeline *pipeline, struct frame_pipeline_slot *slot);
+
+/* Returns the stats accumulated since the last call and resets them */
+void frame_pipeline_collect_stats(struct frame_pipeline *pipeline,
+	struct frame_pipeline_stats *stats);
+void frame_pipeline_print_stats(const struct frame_pipeline *pipeline,
+	const struct frame_pipeline_stats *stats);
+
+const char *pipeline_mode_name(enum pipeline_mode mode);
+
+#endif
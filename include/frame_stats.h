@@ -0,0 +1,30 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <stdint.h>
+
+/*
+ * Frame time and CPU stall statistics of the render loop. The stall is
+ * the time the render thread spends blocked on the GPU or the display
+ * queue before it can start recording the next frame.
+ */
+
+struct frame_stats {
+	unsigned int frames;
+	uint64_t last_frame_start_ns;
+	uint64_t frame_ns;
+	uint64_t min_frame_ns;
+	uint64_t max_frame_ns;
+	uint64_t stall_ns;
+	uint64_t max_stall_ns;
+};
+
+void frame_stats_init(struct frame_stats *stats);
+/* Call at the start of every frame */
+void frame_stats_begin_frame(struct frame_stats *stats, uint64_t now_ns);
+void frame_stats_add_stall(struct frame_stats *stats, uint64_t stall_ns);
+void frame_stats_print(const struct frame_stats *stats);
+/* Clear the accumulated stats, keeping the current frame start */
+void frame_stats_reset(struct frame_stats *stats);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <stddef.h>
+#include <psp2/gxm.h>
+#include <psp2/kernel/sysmem.h>
+
+/*
+ * GPU mapped memory blocks. Every block is tagged with a category, and
+ * the live, peak and alignment waste (block size minus requested size)
+ * of each category are tracked so memory budgets can be checked while
+ * running. Not thread-safe: allocate and free from one thread.
+ */
+
+enum gpu_memory_category {
+	GPU_MEMORY_RING_BUFFERS,
+	GPU_MEMORY_SURFACES,
+	GPU_MEMORY_SHADER_PATCHER,
+	GPU_MEMORY_MESHES,
+	GPU_MEMORY_TEXTURES,
+	GPU_MEMORY_COMMAND_LISTS,
+	GPU_MEMORY_CATEGORY_COUNT
+};
+
+struct gpu_memory_usage {
+	unsigned int blocks;
+	/* Bytes in live blocks, after alignment */
+	size_t live;
+	/* Bytes the live blocks were requested with */
+	size_t requested;
+	/* Highest live */
+	size_t peak;
+};
+
+struct gpu_memory_stats {
+	struct gpu_memory_usage categories[GPU_MEMORY_CATEGORY_COUNT];
+	struct gpu_memory_usage total;
+	/* Part of the total in CDRAM, which has its own budget */
+	struct gpu_memory_usage cdram;
+};
+
+void *gpu_alloc_map(enum gpu_memory_category category, SceKernelMemBlockType type,
+	SceGxmMemoryAttribFlags gpu_attrib, size_t size, SceUID *uid);
+void gpu_unmap_free(SceUID uid);
+void *gpu_vertex_usse_alloc_map(enum gpu_memory_category category, size_t size, SceUID *uid,
+	unsigned int *usse_offset);
+void gpu_vertex_usse_unmap_free(SceUID uid);
+void *gpu_fragment_usse_alloc_map(enum gpu_memory_category category, size_t size, SceUID *uid,
+	unsigned int *usse_offset);
+void gpu_fragment_usse_unmap_free(SceUID uid);
+
+void gpu_memory_get_stats(struct gpu_memory_stats *stats);
+void gpu_memory_print_stats(const struct gpu_memory_stats *stats);
+/* Prints the blocks that are still allocated and returns their count */
+unsigned int gpu_memory_report_leaks(void);
+const char *gpu_memory_category_name(enum gpu_memory_category category);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef GXM_TRACE_H
+#define GXM_TRACE_H
+
+#include <psp2/gxm.h>
+
+/*
+ * GXM command capture. Between gxm_trace_begin() and gxm_trace_end() the
+ * calls below are serialized, one frame per display queue entry, into a
+ * trace (see gxm_trace_format.h) that tools/gxm_replay re-issues.
+ *
+ * Including this header after <psp2/gxm.h> routes the calls through the
+ * capture layer. When no trace is being captured they are only forwarded.
+ * Programs and render targets are recorded when they are created, so
+ * capture must begin before that. Textures sampling a color surface that
+ * a traced scene drew to refer to it, the texels of others are stored when
+ * the commands binding them are written, like vertex data.
+ */
+
+/* Returns -1 if the file can't be created */
+int gxm_trace_begin(const char *path);
+void gxm_trace_end(void);
+
+int gxm_trace_create_render_target(const SceGxmRenderTargetParams *params,
+	SceGxmRenderTarget **renderTarget);
+int gxm_trace_create_vertex_program(SceGxmShaderPatcher *shaderPatcher,
+	SceGxmShaderPatcherId programId, const SceGxmVertexAttribute *attributes,
+	unsigned int attributeCount, const SceGxmVertexStream *streams, unsigned int streamCount,
+	SceGxmVertexProgram **vertexProgram);
+int gxm_trace_create_fragment_program(SceGxmShaderPatcher *shaderPatcher,
+	SceGxmShaderPatcherId programId, SceGxmOutputRegisterFormat outputFormat,
+	SceGxmMultisampleMode multisampleMode, const SceGxmBlendInfo *blendInfo,
+	const SceGxmProgram *vertexProgram, SceGxmFragmentProgram **fragmentProgram);
+int gxm_trace_begin_scene(SceGxmContext *context, unsigned int flags,
+	const SceGxmRenderTarget *renderTarget, const SceGxmValidRegion *validRegion,
+	SceGxmSyncObject *vertexSyncObject, SceGxmSyncObject *fragmentSyncObject,
+	const SceGxmColorSurface *colorSurface, const SceGxmDepthStencilSurface *depthStencil);
+int gxm_trace_end_scene(SceGxmContext *context, const SceGxmNotification *vertexNotification,
+	const SceGxmNotification *fragmentNotification);
+int gxm_trace_begin_command_list(SceGxmContext *deferredContext);
+int gxm_trace_end_command_list(SceGxmContext *deferredContext, SceGxmCommandList *commandList);
+int gxm_trace_execute_command_list(SceGxmContext *context, SceGxmCommandList *commandList);
+void gxm_trace_set_vertex_program(SceGxmContext *context, const SceGxmVertexProgram *vertexProgram);
+void gxm_trace_set_fragment_program(SceGxmContext *context,
+	const SceGxmFragmentProgram *fragmentProgram);
+int gxm_trace_reserve_vertex_default_uniform_buffer(SceGxmContext *context, void **uniformBuffer);
+int gxm_trace_reserve_fragment_default_uniform_buffer(SceGxmContext *context, void **uniformBuffer);
+int gxm_trace_set_uniform_data(void *uniformBuffer, const SceGxmProgramParameter *parameter,
+	unsigned int componentOffset, unsigned int componentCount, const float *sourceData);
+void gxm_trace_set_front_stencil_func(SceGxmContext *context, SceGxmStencilFunc func,
+	SceGxmStencilOp stencilFail, SceGxmStencilOp depthFail, SceGxmStencilOp depthPass,
+	unsigned char compareMask, unsigned char writeMask);
+void gxm_trace_set_front_stencil_ref(SceGxmContext *context, unsigned int sref);
+void gxm_trace_set_front_depth_func(SceGxmContext *context, SceGxmDepthFunc depthFunc);
+void gxm_trace_set_front_depth_write_enable(SceGxmContext *context, SceGxmDepthWriteMode enable);
+void gxm_trace_set_viewport(SceGxmContext *context, float xOffset, float xScale, float yOffset,
+	float yScale, float zOffset, float zScale);
+int gxm_trace_set_vertex_stream(SceGxmContext *context, unsigned int streamIndex,
+	const void *streamData);
+int gxm_trace_set_fragment_texture(SceGxmContext *context, unsigned int textureIndex,
+	const SceGxmTexture *texture);
+int gxm_trace_draw(SceGxmContext *context, SceGxmPrimitiveType primType,
+	SceGxmIndexFormat indexType, const void *indexData, unsigned int indexCount);
+int gxm_trace_display_queue_add_entry(SceGxmSyncObject *oldBuffer, SceGxmSyncObject *newBuffer,
+	const void *callbackData);
+
+#ifndef GXM_TRACE_NO_INTERPOSE
+#define sceGxmCreateRenderTarget gxm_trace_create_render_target
+#define sceGxmShaderPatcherCreateVertexProgram gxm_trace_create_vertex_program
+#define sceGxmShaderPatcherCreateFragmentProgram gxm_trace_create_fragment_program
+#define sceGxmBeginScene gxm_trace_begin_scene
+#define sceGxmEndScene gxm_trace_end_scene
+#define sceGxmBeginCommandList gxm_trace_begin_command_list
+#define sceGxmEndCommandList gxm_trace_end_command_list
+#define sceGxmExecuteCommandList gxm_trace_execute_command_list
+#define sceGxmSetVertexProgram gxm_trace_set_vertex_program
+#define sceGxmSetFragmentProgram gxm_trace_set_fragment_program
+#define sceGxmReserveVertexDefaultUniformBuffer gxm_trace_reserve_vertex_default_uniform_buffer
+#define sceGxmReserveFragmentDefaultUniformBuffer gxm_trace_reserve_fragment_default_uniform_buffer
+#define sceGxmSetUniformDataF gxm_trace_set_uniform_data
+#define sceGxmSetFrontStencilFunc gxm_trace_set_front_stencil_func
+#define sceGxmSetFrontStencilRef gxm_trace_set_front_stencil_ref
+#define sceGxmSetFrontDepthFunc gxm_trace_set_front_depth_func
+#define sceGxmSetFrontDepthWriteEnable gxm_trace_set_front_depth_write_enable
+#define sceGxmSetViewport gxm_trace_set_viewport
+#define sceGxmSetVertexStream gxm_trace_set_vertex_stream
+#define sceGxmSetFragmentTexture gxm_trace_set_fragment_texture
+#define sceGxmDraw gxm_trace_draw
+#define sceGxmDisplayQueueAddEntry gxm_trace_display_queue_add_entry
+#endif
+
+#endif
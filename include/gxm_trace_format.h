@@ -0,0 +1,211 @@
+#ifndef GXM_TRACE_FORMAT_H
+#define GXM_TRACE_FORMAT_H
+
+#include <stdint.h>
+
+/*
+ * GXM trace file: a gxm_trace_header followed by records, each one a
+ * gxm_trace_record header and a payload padded to GXM_TRACE_ALIGNMENT
+ * bytes. Program binaries, vertex, index and texture data are stored once
+ * in BLOB records, deduplicated by content, and referenced by their id.
+ * A blob always precedes the first record that uses it, so a trace can be
+ * replayed front to back. All values are little-endian.
+ *
+ * Every record is issued on the immediate context: command lists
+ * recorded on deferred contexts are inlined where they are executed,
+ * between BEGIN_COMMAND_LIST and END_COMMAND_LIST, and start from the
+ * default state.
+ *
+ * Color surfaces get an id the first time a scene draws to them, so
+ * textures sampling what an earlier scene rendered can name the surface
+ * instead of storing texels that change every frame. The surface of the
+ * last scene of a frame is the one displayed.
+ */
+
+#define GXM_TRACE_MAGIC "GXMT"
+#define GXM_TRACE_VERSION 3
+#define GXM_TRACE_ALIGNMENT 8
+
+#define GXM_TRACE_MAX_ATTRIBUTES 16
+#define GXM_TRACE_MAX_STREAMS 4
+
+enum gxm_trace_record_type {
+	GXM_TRACE_BLOB,
+	GXM_TRACE_VERTEX_PROGRAM,
+	GXM_TRACE_FRAGMENT_PROGRAM,
+	GXM_TRACE_BEGIN_SCENE,
+	GXM_TRACE_END_SCENE,
+	GXM_TRACE_END_FRAME,
+	GXM_TRACE_BEGIN_COMMAND_LIST,
+	GXM_TRACE_END_COMMAND_LIST,
+	GXM_TRACE_SET_VERTEX_PROGRAM,
+	GXM_TRACE_SET_FRAGMENT_PROGRAM,
+	GXM_TRACE_RESERVE_VERTEX_UNIFORMS,
+	GXM_TRACE_RESERVE_FRAGMENT_UNIFORMS,
+	GXM_TRACE_UNIFORM_DATA,
+	GXM_TRACE_SET_STENCIL_FUNC,
+	GXM_TRACE_SET_STENCIL_REF,
+	GXM_TRACE_SET_DEPTH_FUNC,
+	GXM_TRACE_SET_DEPTH_WRITE,
+	GXM_TRACE_SET_VERTEX_STREAM,
+	GXM_TRACE_DRAW,
+	GXM_TRACE_SET_FRAGMENT_TEXTURE,
+	GXM_TRACE_SET_VIEWPORT,
+	GXM_TRACE_RECORD_TYPE_COUNT
+};
+
+struct gxm_trace_header {
+	char magic[4];
+	uint32_t version;
+};
+
+struct gxm_trace_record {
+	uint32_t type;
+	/* Payload size, including the padding */
+	uint32_t size;
+};
+
+/* Followed by size bytes of data */
+struct gxm_trace_blob {
+	uint32_t id;
+	uint32_t size;
+	uint64_t hash;
+};
+
+struct gxm_trace_attribute {
+	uint16_t stream_index;
+	uint16_t offset;
+	uint8_t format;
+	uint8_t component_count;
+	uint16_t reg_index;
+};
+
+struct gxm_trace_stream {
+	uint16_t stride;
+	uint16_t index_source;
+};
+
+struct gxm_trace_vertex_program {
+	uint32_t id;
+	uint32_t program_blob;
+	uint32_t attribute_count;
+	uint32_t stream_count;
+	struct gxm_trace_attribute attributes[GXM_TRACE_MAX_ATTRIBUTES];
+	struct gxm_trace_stream streams[GXM_TRACE_MAX_STREAMS];
+};
+
+struct gxm_trace_blend {
+	uint8_t color_mask;
+	uint8_t color_func;
+	uint8_t alpha_func;
+	uint8_t color_src;
+	uint8_t color_dst;
+	uint8_t alpha_src;
+	uint8_t alpha_dst;
+	uint8_t reserved;
+};
+
+struct gxm_trace_fragment_program {
+	uint32_t id;
+	uint32_t program_blob;
+	uint32_t output_format;
+	uint32_t multisample_mode;
+	uint32_t has_blend;
+	struct gxm_trace_blend blend;
+};
+
+struct gxm_trace_begin_scene {
+	uint32_t flags;
+	/* Size of the render target */
+	uint32_t width;
+	uint32_t height;
+	/* Color surface id, its SceGxmColorFormat and row length in pixels */
+	uint32_t surface;
+	uint32_t color_format;
+	uint32_t stride;
+	/* Nonzero if the scene has a depth/stencil surface */
+	uint32_t depth_stencil;
+	/* Valid region, inclusive */
+	uint32_t x_min;
+	uint32_t y_min;
+	uint32_t x_max;
+	uint32_t y_max;
+};
+
+struct gxm_trace_end_frame {
+	uint32_t frame;
+};
+
+/* SET_VERTEX_PROGRAM, SET_FRAGMENT_PROGRAM */
+struct gxm_trace_program_id {
+	uint32_t id;
+};
+
+/* Followed by count floats */
+struct gxm_trace_uniform_data {
+	/* 0 for the vertex default uniform buffer, 1 for the fragment one */
+	uint32_t fragment;
+	/* sceGxmProgramGetParameter() index in the bound program */
+	uint32_t parameter;
+	uint32_t offset;
+	uint32_t count;
+};
+
+struct gxm_trace_stencil_func {
+	uint32_t func;
+	uint32_t stencil_fail;
+	uint32_t depth_fail;
+	uint32_t depth_pass;
+	uint32_t compare_mask;
+	uint32_t write_mask;
+};
+
+/* SET_STENCIL_REF, SET_DEPTH_FUNC, SET_DEPTH_WRITE */
+struct gxm_trace_value {
+	uint32_t value;
+};
+
+struct gxm_trace_vertex_stream {
+	uint32_t index;
+	uint32_t blob;
+};
+
+struct gxm_trace_draw {
+	uint32_t primitive;
+	uint32_t index_format;
+	uint32_t index_count;
+	uint32_t index_blob;
+};
+
+struct gxm_trace_viewport {
+	float x_offset;
+	float x_scale;
+	float y_offset;
+	float y_scale;
+	float z_offset;
+	float z_scale;
+};
+
+struct gxm_trace_texture {
+	uint32_t index;
+	/* SceGxmTextureType, linear strided or swizzled */
+	uint32_t type;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	/* Bytes per row of linear strided textures */
+	uint32_t stride;
+	uint32_t mip_count;
+	uint32_t min_filter;
+	uint32_t mag_filter;
+	uint32_t mip_filter;
+	uint32_t u_addr_mode;
+	uint32_t v_addr_mode;
+	/* Texels at offset bytes into a color surface, or 0xFFFFFFFF */
+	uint32_t surface;
+	uint32_t offset;
+	/* Texels of every level when they aren't in a surface */
+	uint32_t blob;
+};
+
+#endif
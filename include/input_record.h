@@ -0,0 +1,47 @@
+#ifndef INPUT_RECORD_H
+#define INPUT_RECORD_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Input recording: one input_record_frame per simulated frame, holding
+ * the pad state and the clock the fixed timestep was advanced to. Feeding
+ * both back makes the simulation step exactly as it did when recorded,
+ * whatever the frame rate of the replay. The file is an
+ * input_record_header followed by the frames, all values little-endian.
+ */
+
+#define INPUT_RECORD_MAGIC "GXMI"
+#define INPUT_RECORD_VERSION 1
+
+struct input_record_header {
+	char magic[4];
+	uint32_t version;
+	/* Simulation step of the recording, replays must use the same */
+	uint64_t step_ns;
+};
+
+struct input_record_frame {
+	uint64_t time_ns;
+	uint32_t buttons;
+	uint8_t lx;
+	uint8_t ly;
+	uint8_t rx;
+	uint8_t ry;
+};
+
+struct input_record {
+	FILE *file;
+	unsigned int frame_count;
+};
+
+/* Return -1 if the file can't be created/opened or doesn't match step_ns */
+int input_record_open_write(struct input_record *record, const char *path, uint64_t step_ns);
+int input_record_open_read(struct input_record *record, const char *path, uint64_t step_ns);
+int input_record_write(struct input_record *record, const struct input_record_frame *frame);
+/* Returns 0 once all the frames have been read */
+int input_record_read(struct input_record *record, struct input_record_frame *frame);
+void input_record_close(struct input_record *record);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stddef.h>
+
+/*
+ * Work-stealing job system: each thread owns a job deque, pushes and pops
+ * jobs at its bottom and idle threads steal from the top of the others.
+ * The thread that calls job_system_init() becomes worker 0 and only
+ * executes jobs while waiting in job_wait(). Threads that find no work
+ * for a while sleep until a job is pushed (or, in job_wait(), finished).
+ *
+ * Jobs are taken from a per-thread ring allocator and are recycled after
+ * JOB_POOL_SIZE allocations, so a job must be finished before its thread
+ * allocates that many new ones.
+ */
+
+#define JOB_SYSTEM_MAX_THREADS 16
+#define JOB_POOL_SIZE 4096
+#define JOB_MAX_CONTINUATIONS 8
+#define JOB_DATA_SIZE 64
+
+struct job;
+
+typedef void (*job_function)(struct job *job, void *data);
+typedef void (*job_parallel_for_function)(void *data, unsigned int start, unsigned int count);
+
+int job_system_init(unsigned int thread_count);
+void job_system_finish(void);
+unsigned int job_system_get_thread_count(void);
+unsigned int job_system_get_default_thread_count(void);
+
+/* data is copied into the job (up to JOB_DATA_SIZE bytes) */
+struct job *job_create(job_function function, const void *data, size_t data_size);
+struct job *job_create_child(struct job *parent, job_function function,
+	const void *data, size_t data_size);
+
+/*
+ * Make job wait for dependency to finish (including its children) before
+ * being executed. Must be called before both jobs are run. At most
+ * JOB_MAX_CONTINUATIONS jobs can wait for one dependency: past that it
+ * asserts, or returns -1 without the dependency when asserts are off.
+ */
+int job_add_dependency(struct job *job, struct job *dependency);
+
+void job_run(struct job *job);
+void job_wait(const struct job *job);
+int job_is_finished(const struct job *job);
+
+/*
+ * Split [0, count) in ranges of at most granularity elements and call
+ * function on each of them from any thread. The granularity is raised if
+ * needed to bound the number of jobs. The returned job is not run yet, so
+ * dependencies can be added first.
+ */
+struct job *job_parallel_for(job_parallel_for_function function, void *data,
+	unsigned int count, unsigned int granularity);
+/*
+ * Same as a child of parent, for work whose size is only known once
+ * parent runs: jobs that depend on parent also wait for the loop.
+ */
+struct job *job_parallel_for_child(struct job *parent, job_parallel_for_function function,
+	void *data, unsigned int count, unsigned int granularity);
+
+#endif
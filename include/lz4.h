@@ -0,0 +1,32 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+/*
+ * LZ4 block format: sequences of literals and matches of at least 4
+ * bytes up to 64 KiB back, no framing. Decompression only copies bytes,
+ * which is why it can keep up with the card reader on the Vita; the
+ * greedy compressor is meant for packing assets offline.
+ */
+
+/* Largest size size bytes can compress to */
+static inline unsigned int lz4_compress_bound(unsigned int size)
+{
+	return size + size / 255 + 16;
+}
+
+/*
+ * Compress size bytes into at most capacity bytes. Returns the compressed
+ * size, or 0 if it doesn't fit.
+ */
+unsigned int lz4_compress(const void *source, unsigned int size, void *destination,
+	unsigned int capacity);
+
+/*
+ * Decompress a block into at most capacity bytes. Returns the decompressed
+ * size, or -1 if the block is malformed or doesn't fit. Never reads or
+ * writes out of the buffers.
+ */
+int lz4_decompress(const void *source, unsigned int size, void *destination,
+	unsigned int capacity);
+
+#endif
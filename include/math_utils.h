@@ -32,6 +32,7 @@ float vector3f_length(const vector3f *v);
 void vector3f_add(vector3f *v1, const vector3f *v2);
 void vector3f_scalar_mult(vector3f *v, float a);
 void vector3f_add_mult(vector3f *v, const vector3f *u, float a);
+void vector3f_lerp(vector3f *dst, const vector3f *v0, const vector3f *v1, float t);
 void vector3f_opposite(vector3f *v1, const vector3f *v0);
 float vector3f_dot_product(const vector3f *v1, const vector3f *v2);
 void vector3f_cross_product(vector3f *w, const vector3f *u, const vector3f *v);
@@ -83,5 +84,8 @@ void matrix3x3_normal_matrix(matrix3x3 out, const matrix4x4 m);
 void matrix4x4_build_model_matrix(matrix4x4 m, const vector3f *translation,
 	const vector3f *rotation);
 void matrix4x4_oblique_near_plane(matrix4x4 projection, const vector4f *clip_plane);
+void matrix4x4_frustum_planes(vector4f planes[6], const matrix4x4 view_projection);
+float matrix4x4_max_axis_scale(const matrix4x4 m);
+int frustum_planes_test_sphere(const vector4f planes[6], const vector3f *center, float radius);
 
 #endif
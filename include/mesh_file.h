@@ -0,0 +1,98 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Binary mesh file, written by tools/mesh_convert. The vertices and the
+ * 16-bit indices of every level of detail are stored the way the GPU
+ * reads them, so loading is one read of the whole file into GPU memory
+ * and a check of the header, after which the sections are used in place.
+ *
+ * The file is a mesh_file_header followed by the vertex section and the
+ * index section of each level, each at a MESH_FILE_ALIGN aligned offset
+ * from the start of the file. All values are little-endian.
+ */
+
+#define MESH_FILE_MAGIC "GXMM"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ALIGN 16
+#define MESH_FILE_MAX_LODS 4
+
+enum mesh_file_vertex_format {
+	/* float position[3], normal[3], color[4] */
+	MESH_FILE_VERTEX_POSITION_NORMAL_COLOR
+};
+
+#define MESH_FILE_POSITION_NORMAL_COLOR_SIZE (10 * sizeof(float))
+
+enum mesh_file_primitive {
+	MESH_FILE_PRIMITIVE_TRIANGLES,
+	MESH_FILE_PRIMITIVE_TRIANGLE_STRIP
+};
+
+struct mesh_file_lod {
+	uint32_t index_offset;
+	uint32_t index_count;
+	/* Distance the surface moved from the full mesh, in model units */
+	float error;
+	uint32_t reserved;
+};
+
+struct mesh_file_header {
+	char magic[4];
+	uint32_t version;
+	/* Bytes in the file */
+	uint32_t size;
+	uint32_t vertex_format;
+	uint32_t vertex_size;
+	uint32_t vertex_count;
+	uint32_t vertex_offset;
+	uint32_t primitive;
+	/* The first level is the full mesh, the others share its vertices */
+	uint32_t lod_count;
+	/* Bounding box and sphere in model space */
+	float bounds_min[3];
+	float bounds_max[3];
+	float center[3];
+	float radius;
+	struct mesh_file_lod lods[MESH_FILE_MAX_LODS];
+};
+
+/*
+ * Check the header and that the sections lie within the size bytes of
+ * the file at data. The indices themselves are not checked. Returns the
+ * header, or NULL if the file is truncated or malformed.
+ */
+const struct mesh_file_header *mesh_file_parse(const void *data, size_t size);
+
+/* Open a mesh file and return its size, NULL if it can't be opened */
+FILE *mesh_file_open(const char *path, size_t *size);
+/*
+ * Read the file opened by mesh_file_open() into size bytes at data with
+ * one read, close it and parse it.
+ */
+const struct mesh_file_header *mesh_file_read(FILE *file, void *data, size_t size);
+
+/*
+ * Write a mesh whose header is filled in but for the size and the
+ * offsets, which are set here, followed by the vertices and the indices
+ * of each level. Returns -1 if the file can't be written.
+ */
+int mesh_file_write(const char *path, struct mesh_file_header *header,
+	const void *vertices, const uint16_t *const *lod_indices);
+
+static inline const void *mesh_file_vertices(const struct mesh_file_header *header)
+{
+	return (const char *)header + header->vertex_offset;
+}
+
+static inline const uint16_t *mesh_file_indices(const struct mesh_file_header *header,
+	unsigned int lod)
+{
+	return (const uint16_t *)((const char *)header + header->lods[lod].index_offset);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef MESH_GEN_H
+#define MESH_GEN_H
+
+#include <stddef.h>
+#include "math_utils.h"
+
+/*
+ * Parametric mesh generator. A shape is written as an indexed triangle
+ * list straight into buffers the caller sized with mesh_gen_count(). The
+ * vertices are welded: no two have the same position and, in the formats
+ * that have them, the same normal and color. Quad grids are walked in
+ * bands MESH_GEN_CACHE_SIZE / 2 vertices wide, so a row of the band is
+ * still in the post-transform cache when the next row uses it. The bounds
+ * come from the parameters, not from a pass over the vertices.
+ *
+ * Triangles are counterclockwise seen from outside. Indices are 16-bit,
+ * a shape has at most MESH_GEN_MAX_VERTICES vertices.
+ */
+
+#define MESH_GEN_MAX_VERTICES 65536
+/* Sphere rings and segments */
+#define MESH_GEN_MAX_SEGMENTS 256
+/* Post-transform cache entries the triangle order is made for */
+#define MESH_GEN_CACHE_SIZE 16
+
+enum mesh_gen_format {
+	/* vector3f position */
+	MESH_GEN_POSITION,
+	/* float position[3], normal[3], color[4], MESH_FILE_POSITION_NORMAL_COLOR */
+	MESH_GEN_POSITION_NORMAL_COLOR
+};
+
+/* Faces of a box, and which way a plane or a frame faces */
+enum mesh_gen_face {
+	MESH_GEN_FACE_FRONT,  /* +z */
+	MESH_GEN_FACE_RIGHT,  /* +x */
+	MESH_GEN_FACE_BACK,   /* -z */
+	MESH_GEN_FACE_LEFT,   /* -x */
+	MESH_GEN_FACE_TOP,    /* +y */
+	MESH_GEN_FACE_BOTTOM, /* -y */
+	MESH_GEN_FACE_COUNT
+};
+
+enum mesh_gen_type {
+	/* Box of size, each face split in segments[0] by segments[0] quads */
+	MESH_GEN_BOX,
+	/*
+	 * Rectangle through the origin facing face, of size along the other
+	 * two axes, split in segments[0] by segments[1] quads along them in
+	 * x, y, z order
+	 */
+	MESH_GEN_PLANE,
+	/* Border wide rim around a plane's rectangle, which is left open */
+	MESH_GEN_FRAME,
+	/* Sphere of radius, segments[0] rings from pole to pole and segments[1] around */
+	MESH_GEN_SPHERE,
+	/*
+	 * segments[0] by segments[1] boxes of size along x and z, spacing
+	 * apart, as one mesh
+	 */
+	MESH_GEN_GRID
+};
+
+struct mesh_gen_shape {
+	enum mesh_gen_type type;
+	/* Planes and frames */
+	enum mesh_gen_face face;
+	vector3f size;
+	unsigned int segments[2];
+	/* Spheres */
+	float radius;
+	/* Frames */
+	float border;
+	/* Grids */
+	float spacing;
+	vector4f color;
+	/* Boxes and grids: a color per face, in mesh_gen_face order, NULL for color */
+	const vector4f *face_colors;
+};
+
+struct mesh_gen_result {
+	unsigned int vertex_count;
+	unsigned int index_count;
+	/* Bounding box and sphere */
+	vector3f bounds_min;
+	vector3f bounds_max;
+	vector3f center;
+	float radius;
+};
+
+size_t mesh_gen_vertex_size(enum mesh_gen_format format);
+
+/*
+ * Number of vertices and indices of the shape. Returns -1 if its
+ * parameters are out of range or it takes more than MESH_GEN_MAX_VERTICES.
+ */
+int mesh_gen_count(const struct mesh_gen_shape *shape, enum mesh_gen_format format,
+	unsigned int *vertex_count, unsigned int *index_count);
+
+/*
+ * Write the shape to vertices and indices, sized by mesh_gen_count(), and
+ * its counts and bounds to result. Returns -1 if mesh_gen_count() fails.
+ */
+int mesh_gen_generate(const struct mesh_gen_shape *shape, enum mesh_gen_format format,
+	void *vertices, unsigned short *indices, struct mesh_gen_result *result);
+
+#endif
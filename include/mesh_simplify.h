@@ -0,0 +1,33 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <stddef.h>
+
+/*
+ * Quadric error mesh simplifier. Edges are collapsed into one of their
+ * vertices, cheapest first, so the result is a new index buffer over the
+ * same vertices and every level of detail can share one vertex buffer.
+ *
+ * Vertices are welded by position to find the topology. A vertex whose
+ * copies have different attributes (e.g. one per face normal of a cube
+ * corner) is only collapsed if each copy has one with the same attributes
+ * at the other end, open borders only collapse along themselves and
+ * non-manifold vertices are kept, so the outline and the attribute seams
+ * of the mesh are preserved. Smooth attributes are not part of the error.
+ */
+
+/*
+ * Simplify a triangle list down to target_index_count indices or until a
+ * collapse would move the surface more than target_error (in model units).
+ * Each vertex starts with its position as three floats, the rest of its
+ * vertex_size bytes are attributes compared bytewise. destination needs
+ * room for index_count indices and can be indices itself. Returns the new
+ * index count and the largest error in result_error (may be NULL), or -1
+ * on allocation failure.
+ */
+int mesh_simplify(unsigned short *destination, const unsigned short *indices,
+	unsigned int index_count, const void *vertices, unsigned int vertex_count,
+	size_t vertex_size, unsigned int target_index_count, float target_error,
+	float *result_error);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "math_utils.h"
+
+/*
+ * Low resolution CPU depth buffer to cull what large occluders hide
+ * before any GXM work is issued. Occluders are drawn with their depth at
+ * the pixel centers, four pixels at a time with the compiler's vector
+ * extensions. The buffer keeps the farthest depth of each tile, so a
+ * test only reads the pixels of the tiles where it can't decide.
+ *
+ * Depth is the normalized device z mapped to [0, 1], the far plane being
+ * 1. Tests are conservative: a box is only reported hidden when every
+ * pixel it may cover holds an occluder in front of its nearest point.
+ */
+
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+#define OCCLUSION_TILE_SIZE 8
+#define OCCLUSION_TILES_X (OCCLUSION_WIDTH / OCCLUSION_TILE_SIZE)
+#define OCCLUSION_TILES_Y (OCCLUSION_HEIGHT / OCCLUSION_TILE_SIZE)
+
+/* Closed triangle list in model space, with no attributes */
+struct occlusion_mesh {
+	const vector3f *vertices;
+	const unsigned short *indices;
+	unsigned int index_count;
+};
+
+struct occlusion_buffer {
+	float depth[OCCLUSION_HEIGHT][OCCLUSION_WIDTH] __attribute__((aligned(16)));
+	/* Farthest depth of each tile, valid after occlusion_end() */
+	float tile_max_depth[OCCLUSION_TILES_Y][OCCLUSION_TILES_X];
+	matrix4x4 view_projection;
+	unsigned int occluder_triangles;
+};
+
+/* Clear the buffer to the far plane */
+void occlusion_begin(struct occlusion_buffer *buffer, const matrix4x4 view_projection);
+void occlusion_draw(struct occlusion_buffer *buffer, const matrix4x4 model_matrix,
+	const struct occlusion_mesh *mesh);
+/* Build the tile depths, call it before testing */
+void occlusion_end(struct occlusion_buffer *buffer);
+
+/*
+ * Return nonzero if the world space box, or the convex hull of the
+ * points, may be visible. Both are hidden when they are off screen.
+ */
+int occlusion_test_aabb(const struct occlusion_buffer *buffer,
+	const vector3f *min, const vector3f *max);
+int occlusion_test_points(const struct occlusion_buffer *buffer,
+	const vector3f *points, unsigned int count);
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "frame_pipeline.h"
+#include "scene_gen.h"
+
+#define OPTIONS_MIN_DISPLAY_BUFFERS 2
+#define OPTIONS_MAX_DISPLAY_BUFFERS 4
+
+/*
+ * Runtime options. The defaults can be overridden at build time
+ * (e.g. -DOPTIONS_DEFAULT_PIPELINE_MODE=PIPELINE_MODE_THROUGHPUT) and,
+ * where the loader passes arguments, on the command line.
+ */
+
+enum display_latency_mode {
+	/* At most one frame queued for display */
+	DISPLAY_LATENCY_LOW,
+	/* Queue as many frames as there are back buffers */
+	DISPLAY_LATENCY_THROUGHPUT
+};
+
+enum portal_mode {
+	/* Draw the portal view through a stencil mask on the screen */
+	PORTAL_MODE_STENCIL,
+	/* Render it offscreen and texture the portal with it, reusing it while nothing changed */
+	PORTAL_MODE_TEXTURE
+};
+
+enum color_depth {
+	/* A8B8G8R8 surfaces and display */
+	COLOR_DEPTH_32,
+	/* R5G6B5, half the framebuffer bandwidth and memory */
+	COLOR_DEPTH_16
+};
+
+struct options {
+	enum pipeline_mode pipeline_mode;
+	/* Print the timing report every N frames, 0 to disable */
+	unsigned int report_interval;
+	/* Number of color surfaces, OPTIONS_MIN_DISPLAY_BUFFERS to OPTIONS_MAX_DISPLAY_BUFFERS */
+	unsigned int display_buffers;
+	enum display_latency_mode display_latency;
+	/* 0 flips immediately and never waits for vblank */
+	int vsync;
+	enum color_depth color_depth;
+	/* Cull what the occluders hide before drawing it */
+	int occlusion;
+	enum portal_mode portal_mode;
+	/* Scale the render size of each view to meet dynres_target_ms */
+	int dynamic_resolution;
+	float dynres_target_ms;
+	/* Bounds of the scale of the main view and of the portal texture */
+	float dynres_min_scale;
+	float dynres_max_scale;
+	float dynres_portal_min_scale;
+	float dynres_portal_max_scale;
+	/* Divides the screen size of the objects to pick their level of detail */
+	float lod_bias;
+	/* Mesh file (see include/mesh_file.h) the cubes are drawn with, NULL for the cube */
+	const char *mesh_path;
+	/* Texture file (see include/texture_file.h) the scene is drawn with, NULL for none */
+	const char *texture_path;
+	/* Objects, portal pairs and lights generated around the demo's scene */
+	struct scene_gen_params scene;
+	/* Asset archive loaded in the background while running, NULL for none */
+	const char *assets_path;
+	/* Fixed simulation steps per second */
+	unsigned int simulation_rate;
+	/* Exit after N frames, 0 to run until START is pressed */
+	unsigned int frame_limit;
+	/* Record the GXM command stream to this file, NULL to disable */
+	const char *trace_path;
+	/* Write the profiler's Chrome trace-event JSON to this file, NULL to disable */
+	const char *profile_path;
+	/* Write the per-pass render counters of every frame to this CSV file */
+	const char *counters_path;
+	/* Save the pad input of every frame to this file, or replay it from this one */
+	const char *record_input_path;
+	const char *replay_input_path;
+	/* Drive the camera and the portal from this path file instead of the pad */
+	const char *camera_path;
+	/* Write the benchmark results of the run as JSON to this file */
+	const char *benchmark_path;
+};
+
+void options_init_default(struct options *options);
+/* Returns -1 on an unknown or malformed option */
+int options_parse(struct options *options, int argc, char *argv[]);
+void options_print_usage(const char *program);
+const char *display_latency_mode_name(enum display_latency_mode mode);
+const char *portal_mode_name(enum portal_mode mode);
+const char *color_depth_name(enum color_depth depth);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include "time_utils.h"
+#endif
+
+/*
+ * CPU profiler. Scoped markers write one event per scope, with its start
+ * and end ticks, to a ring buffer owned by the calling thread, so marking
+ * a scope costs two clock reads and a few stores, without locks.
+ * profiler_collect() drains the rings once per frame into a rolling
+ * per-scope summary and, optionally, a Chrome trace-event JSON file
+ * (chrome://tracing, https://ui.perfetto.dev).
+ *
+ * The markers are compiled out with -DPROFILER_ENABLED=0. Scope names
+ * must be string literals, they are stored by pointer.
+ */
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILER_MAX_THREADS 32
+#define PROFILER_MAX_SCOPES 64
+/* Events per thread between two collections, must be a power of two */
+#define PROFILER_THREAD_EVENTS 8192
+/* Durations kept per scope for the summary */
+#define PROFILER_WINDOW 256
+
+struct profiler_scope {
+	const char *name;
+	uint64_t start;
+};
+
+/* TSC on x86 hosts, the process time (microsecond resolution) elsewhere */
+static inline uint64_t profiler_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return time_get_ns();
+#endif
+}
+
+/* trace_path is NULL to only keep the summary. Returns -1 on failure */
+int profiler_init(const char *trace_path);
+/* Collects the remaining events and completes the trace file */
+void profiler_finish(void);
+/* name must outlive the profiler */
+void profiler_set_thread_name(const char *name);
+void profiler_record(const char *name, uint64_t start);
+void profiler_scope_end(const struct profiler_scope *scope);
+/* Call from a single thread, e.g. once per frame */
+void profiler_collect(void);
+/* Min, average and 99th percentile of the last PROFILER_WINDOW calls per scope */
+void profiler_print_summary(void);
+
+struct profiler_scope_total {
+	const char *name;
+	unsigned int calls;
+	float total_ms;
+};
+
+/*
+ * Calls and time per scope collected since profiler_init() or the last
+ * profiler_reset_totals(). Returns the number of scopes written.
+ */
+unsigned int profiler_get_totals(struct profiler_scope_total *totals, unsigned int max_scopes);
+void profiler_reset_totals(void);
+
+#if PROFILER_ENABLED
+#define PROFILE_BEGIN(id, name) \
+	struct profiler_scope profile_##id = { (name), profiler_ticks() }
+#define PROFILE_END(id) \
+	profiler_record(profile_##id.name, profile_##id.start)
+/* Ends when the enclosing block is left */
+#define PROFILE_SCOPE(id, name) \
+	struct profiler_scope profile_##id __attribute__((cleanup(profiler_scope_end))) = \
+		{ (name), profiler_ticks() }
+#else
+#define PROFILE_BEGIN(id, name) do { } while (0)
+#define PROFILE_END(id) do { } while (0)
+#define PROFILE_SCOPE(id, name) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef RENDER_COUNTERS_H
+#define RENDER_COUNTERS_H
+
+#include <stdint.h>
+#include <psp2/gxm.h>
+#include "gxm_trace.h"
+
+/*
+ * Per-pass render counters. Including this header routes the GXM state
+ * and draw calls through counting wrappers (on top of the trace capture
+ * layer of gxm_trace.h), which add to the pass last set on the calling
+ * context with render_counters_set_pass(). Deferred contexts count into
+ * their own pass, so command lists may be recorded on any thread.
+ *
+ * render_counters_end_frame() sums every context into a frame snapshot
+ * kept in a ring of the last RENDER_COUNTERS_HISTORY frames, and appends
+ * it to the CSV file if one was opened. It must be called by the thread
+ * owning the immediate context once no command list is being recorded.
+ */
+
+#define RENDER_COUNTERS_HISTORY 128
+
+enum render_pass {
+	/* Anything issued outside of the passes below */
+	RENDER_PASS_OTHER,
+	RENDER_PASS_CLEAR,
+	RENDER_PASS_STENCIL_MARK,
+	RENDER_PASS_PORTAL_VIEW,
+	RENDER_PASS_DEPTH_RESET,
+	RENDER_PASS_MAIN_VIEW,
+	/* Dynamic resolution's stretch to the display surface */
+	RENDER_PASS_UPSCALE,
+	RENDER_PASS_COUNT
+};
+
+enum render_counter {
+	RENDER_COUNTER_DRAWS,
+	RENDER_COUNTER_PRIMITIVES,
+	RENDER_COUNTER_VERTEX_PROGRAM_BINDS,
+	RENDER_COUNTER_FRAGMENT_PROGRAM_BINDS,
+	RENDER_COUNTER_STENCIL_STATE_CHANGES,
+	RENDER_COUNTER_DEPTH_STATE_CHANGES,
+	RENDER_COUNTER_VERTEX_STREAM_BINDS,
+	RENDER_COUNTER_UNIFORM_RESERVATIONS,
+	RENDER_COUNTER_UNIFORM_BYTES,
+	RENDER_COUNTER_COMMAND_LISTS,
+	RENDER_COUNTER_COUNT
+};
+
+struct render_counters_frame {
+	unsigned int frame;
+	uint32_t values[RENDER_PASS_COUNT][RENDER_COUNTER_COUNT];
+};
+
+/* csv_path is NULL to only keep the history. Returns -1 on failure */
+int render_counters_init(const char *csv_path);
+void render_counters_finish(void);
+void render_counters_set_pass(SceGxmContext *context, enum render_pass pass);
+void render_counters_end_frame(void);
+/* Snapshot of the frame age frames ago (0 is the last one), NULL if too old */
+const struct render_counters_frame *render_counters_get_frame(unsigned int age);
+/* Average per frame over the last frames */
+void render_counters_print(unsigned int frames);
+const char *render_pass_name(enum render_pass pass);
+const char *render_counter_name(enum render_counter counter);
+
+void render_counters_set_vertex_program(SceGxmContext *context,
+	const SceGxmVertexProgram *vertexProgram);
+void render_counters_set_fragment_program(SceGxmContext *context,
+	const SceGxmFragmentProgram *fragmentProgram);
+int render_counters_reserve_vertex_default_uniform_buffer(SceGxmContext *context,
+	void **uniformBuffer);
+int render_counters_reserve_fragment_default_uniform_buffer(SceGxmContext *context,
+	void **uniformBuffer);
+int render_counters_set_uniform_data(void *uniformBuffer, const SceGxmProgramParameter *parameter,
+	unsigned int componentOffset, unsigned int componentCount, const float *sourceData);
+void render_counters_set_front_stencil_func(SceGxmContext *context, SceGxmStencilFunc func,
+	SceGxmStencilOp stencilFail, SceGxmStencilOp depthFail, SceGxmStencilOp depthPass,
+	unsigned char compareMask, unsigned char writeMask);
+void render_counters_set_front_stencil_ref(SceGxmContext *context, unsigned int sref);
+void render_counters_set_front_depth_func(SceGxmContext *context, SceGxmDepthFunc depthFunc);
+void render_counters_set_front_depth_write_enable(SceGxmContext *context,
+	SceGxmDepthWriteMode enable);
+int render_counters_set_vertex_stream(SceGxmContext *context, unsigned int streamIndex,
+	const void *streamData);
+int render_counters_draw(SceGxmContext *context, SceGxmPrimitiveType primType,
+	SceGxmIndexFormat indexType, const void *indexData, unsigned int indexCount);
+int render_counters_execute_command_list(SceGxmContext *context, SceGxmCommandList *commandList);
+
+#ifndef RENDER_COUNTERS_NO_INTERPOSE
+#undef sceGxmSetVertexProgram
+#undef sceGxmSetFragmentProgram
+#undef sceGxmReserveVertexDefaultUniformBuffer
+#undef sceGxmReserveFragmentDefaultUniformBuffer
+#undef sceGxmSetUniformDataF
+#undef sceGxmSetFrontStencilFunc
+#undef sceGxmSetFrontStencilRef
+#undef sceGxmSetFrontDepthFunc
+#undef sceGxmSetFrontDepthWriteEnable
+#undef sceGxmSetVertexStream
+#undef sceGxmDraw
+#undef sceGxmExecuteCommandList
+#define sceGxmSetVertexProgram render_counters_set_vertex_program
+#define sceGxmSetFragmentProgram render_counters_set_fragment_program
+#define sceGxmReserveVertexDefaultUniformBuffer render_counters_reserve_vertex_default_uniform_buffer
+#define sceGxmReserveFragmentDefaultUniformBuffer render_counters_reserve_fragment_default_uniform_buffer
+#define sceGxmSetUniformDataF render_counters_set_uniform_data
+#define sceGxmSetFrontStencilFunc render_counters_set_front_stencil_func
+#define sceGxmSetFrontStencilRef render_counters_set_front_stencil_ref
+#define sceGxmSetFrontDepthFunc render_counters_set_front_depth_func
+#define sceGxmSetFrontDepthWriteEnable render_counters_set_front_depth_write_enable
+#define sceGxmSetVertexStream render_counters_set_vertex_stream
+#define sceGxmDraw render_counters_draw
+#define sceGxmExecuteCommandList render_counters_execute_command_list
+#endif
+
+#endif
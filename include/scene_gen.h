@@ -0,0 +1,109 @@
+#ifndef SCENE_GEN_H
+#define SCENE_GEN_H
+
+#include <stdint.h>
+#include "math_utils.h"
+
+/*
+ * Procedural stress scene: objects, portal pairs, lights and materials
+ * placed on the ground plane from a seed, to measure how the renderer
+ * scales with each of them. Every object, portal, light and material is
+ * drawn from its own random stream, seeded by the seed and its index, so
+ * the same parameters always give the same scene on every platform.
+ *
+ * Objects are unit shapes (a box of side 1, a sphere of diameter 1)
+ * scaled and standing on y = 0. Portal ends are points on the ground
+ * with a rotation about y, the caller lifts them by its portal size.
+ */
+
+#define SCENE_GEN_MAX_OBJECTS 100000
+#define SCENE_GEN_MAX_PORTALS 64
+#define SCENE_GEN_MAX_LIGHTS 31
+#define SCENE_GEN_MAX_MATERIALS 64
+/* Side of the ground square per object, when the extent is automatic */
+#define SCENE_GEN_SPACING 3.0f
+#define SCENE_GEN_MIN_EXTENT 20.0f
+
+enum scene_gen_layout {
+	/* Anywhere on the ground square */
+	SCENE_GEN_UNIFORM,
+	/* In about sqrt(objects) / 2 clusters of normally distributed objects */
+	SCENE_GEN_CLUSTERED,
+	/* On the cells of a square grid, slightly jittered */
+	SCENE_GEN_GRID
+};
+
+enum scene_gen_shape {
+	SCENE_GEN_BOX,
+	SCENE_GEN_SPHERE
+};
+
+struct scene_gen_params {
+	unsigned int object_count;
+	unsigned int portal_count;
+	unsigned int light_count;
+	/* 1 to SCENE_GEN_MAX_MATERIALS */
+	unsigned int material_count;
+	uint32_t seed;
+	enum scene_gen_layout layout;
+	/* Side of the ground square centered on the origin, 0 to size it by the objects */
+	float extent;
+	/* Objects and portals stay this far from the origin when they can */
+	float clear_radius;
+};
+
+struct scene_gen_object {
+	enum scene_gen_shape shape;
+	vector3f position;
+	vector3f rotation;
+	vector3f scale;
+	unsigned int material;
+};
+
+struct scene_gen_portal {
+	vector3f end1_position;
+	vector3f end1_rotation;
+	vector3f end2_position;
+	vector3f end2_rotation;
+};
+
+struct scene_gen_light {
+	vector3f position;
+	vector3f color;
+};
+
+struct scene_gen_material {
+	vector3f ambient;
+	vector3f diffuse;
+	vector3f specular;
+	float shininess;
+};
+
+struct scene_gen {
+	float extent;
+	struct scene_gen_object *objects;
+	unsigned int object_count;
+	struct scene_gen_portal portals[SCENE_GEN_MAX_PORTALS];
+	unsigned int portal_count;
+	struct scene_gen_light lights[SCENE_GEN_MAX_LIGHTS];
+	unsigned int light_count;
+	struct scene_gen_material materials[SCENE_GEN_MAX_MATERIALS];
+	unsigned int material_count;
+};
+
+/* No objects, portals or lights: the generated scene is empty */
+void scene_gen_params_init(struct scene_gen_params *params);
+/*
+ * Set the parameters from a description of comma separated KEY=VALUE,
+ * KEY one of objects, portals, lights, materials, seed, layout
+ * (uniform|clustered|grid) and extent. Returns -1 on an unknown key or
+ * a value out of range.
+ */
+int scene_gen_parse(struct scene_gen_params *params, const char *description);
+const char *scene_gen_layout_name(enum scene_gen_layout layout);
+
+/* Returns -1 if the objects can't be allocated */
+int scene_gen_generate(struct scene_gen *scene, const struct scene_gen_params *params);
+void scene_gen_free(struct scene_gen *scene);
+
+#endif
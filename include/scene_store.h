@@ -0,0 +1,80 @@
+#ifndef SCENE_STORE_H
+#define SCENE_STORE_H
+
+#include <stdint.h>
+#include "math_utils.h"
+
+/*
+ * Scene nodes stored as structure of arrays, indexed by node: code that
+ * walks one attribute of every node (transforms, bounds, draw handles)
+ * reads contiguous memory.
+ *
+ * A node's parent is always added before it, so a single front to back
+ * pass updates the world matrices. Only nodes whose local transform was
+ * set, or whose parent's world matrix changed, are recomputed; the others
+ * keep last frame's matrices.
+ */
+
+#define SCENE_NODE_NONE UINT32_MAX
+#define SCENE_HANDLE_NONE UINT16_MAX
+
+enum scene_node_flags {
+	/* The local transform changed since the last update */
+	SCENE_NODE_DIRTY = 1 << 0,
+	/* The world matrix was recomputed by the last update */
+	SCENE_NODE_WORLD_CHANGED = 1 << 1
+};
+
+struct scene_store {
+	unsigned int count;
+	unsigned int capacity;
+
+	/* Local transform, relative to the parent */
+	vector3f *positions;
+	vector3f *rotations;
+	vector3f *scales;
+	uint32_t *parents;
+	uint8_t *flags;
+
+	matrix4x4 *local_matrices;
+	matrix4x4 *world_matrices;
+
+	/* Bounding sphere in model space and in world space */
+	vector3f *bound_centers;
+	float *bound_radii;
+	vector3f *world_centers;
+	float *world_radii;
+
+	/* What to draw, SCENE_HANDLE_NONE for pure transform nodes */
+	uint16_t *meshes;
+	uint16_t *materials;
+};
+
+/* Returns -1 if the arrays can't be allocated */
+int scene_store_init(struct scene_store *store, unsigned int capacity);
+void scene_store_free(struct scene_store *store);
+void scene_store_clear(struct scene_store *store);
+
+/* parent is SCENE_NODE_NONE for a root. Returns SCENE_NODE_NONE on failure */
+uint32_t scene_store_add(struct scene_store *store, uint32_t parent,
+	const vector3f *position, const vector3f *rotation, const vector3f *scale);
+void scene_store_set_renderable(struct scene_store *store, uint32_t node,
+	uint16_t mesh, uint16_t material, const vector3f *bound_center, float bound_radius);
+
+void scene_store_set_position(struct scene_store *store, uint32_t node, const vector3f *position);
+void scene_store_set_rotation(struct scene_store *store, uint32_t node, const vector3f *rotation);
+void scene_store_set_scale(struct scene_store *store, uint32_t node, const vector3f *scale);
+
+/*
+ * Rebuild the local matrix of the dirty nodes in [start, start + count).
+ * Ranges can be updated in parallel.
+ */
+void scene_store_update_local(struct scene_store *store, unsigned int start, unsigned int count);
+/*
+ * Propagate the local matrices down the hierarchy and update the world
+ * bounds, after scene_store_update_local() on every node. Returns the
+ * number of world matrices recomputed.
+ */
+unsigned int scene_store_update_world(struct scene_store *store);
+
+#endif
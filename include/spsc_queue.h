@@ -0,0 +1,27 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+/*
+ * Lock-free single-producer single-consumer queue of pointers.
+ * SPSC_QUEUE_CAPACITY must be a power of two, and holds every request
+ * the asset loader can have in flight.
+ */
+
+#define SPSC_QUEUE_CAPACITY 64
+
+struct spsc_queue {
+	/* Written by the consumer */
+	unsigned int head __attribute__((aligned(64)));
+	/* Written by the producer */
+	unsigned int tail __attribute__((aligned(64)));
+	void *items[SPSC_QUEUE_CAPACITY];
+};
+
+void spsc_queue_init(struct spsc_queue *queue);
+/* Returns 0 if the queue is full */
+int spsc_queue_push(struct spsc_queue *queue, void *item);
+/* Returns NULL if the queue is empty */
+void *spsc_queue_pop(struct spsc_queue *queue);
+unsigned int spsc_queue_size(const struct spsc_queue *queue);
+
+#endif
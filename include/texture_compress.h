@@ -0,0 +1,30 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <stdint.h>
+#include "texture_file.h"
+
+/*
+ * Texture encoder of tools/texture_encode: box filtered mip chains and
+ * UBC1/UBC3 block compression, written in the swizzled order of
+ * include/texture_file.h. Images are 8-bit R, G, B, A texels in rows
+ * from the top, the sizes powers of two.
+ *
+ * The color endpoints of a block are fitted along the principal axis of
+ * its colors, then refined once by least squares over the indices they
+ * give. UBC1 blocks with texels of alpha under 128 use the three color
+ * mode, whose fourth index is transparent black.
+ */
+
+/* Image of half the size (at least 1) whose texels average 2x2 of src */
+void texture_compress_downsample(const uint8_t *src, unsigned int width, unsigned int height,
+	uint8_t *dst);
+
+/* Write a level to the texture_file_level_size() bytes at dst */
+void texture_compress_level(enum texture_file_format format, const uint8_t *src,
+	unsigned int width, unsigned int height, void *dst);
+/* Decode a level written by texture_compress_level(), to measure its error */
+void texture_decompress_level(enum texture_file_format format, const void *src,
+	unsigned int width, unsigned int height, uint8_t *dst);
+
+#endif
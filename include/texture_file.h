@@ -0,0 +1,96 @@
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Binary texture file, written by tools/texture_encode. Every level of
+ * the mip chain is stored the way the GPU samples it, block compressed
+ * and swizzled, so loading is one read of the whole file into GPU memory
+ * and a check of the header, after which the levels are used in place.
+ *
+ * The file is a texture_file_header followed by the levels from the full
+ * size down to at least 1x1, the first at a TEXTURE_FILE_ALIGN aligned
+ * offset from the start of the file and each of the others right after
+ * the one before. The width and the height are powers of two. All values
+ * are little-endian.
+ *
+ * Swizzled levels are in Morton order of their texels, or of their 4x4
+ * blocks for the compressed formats (a level smaller than a block takes
+ * one): the bits of y and x interleaved up to the shorter side, y in the
+ * even bits, followed by the bits left of the longer side.
+ */
+
+#define TEXTURE_FILE_MAGIC "GXMT"
+#define TEXTURE_FILE_VERSION 1
+#define TEXTURE_FILE_ALIGN 16
+#define TEXTURE_FILE_MAX_SIZE 4096
+#define TEXTURE_FILE_MAX_LEVELS 13
+
+enum texture_file_format {
+	/* 8-bit R, G, B, A texels, SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR */
+	TEXTURE_FILE_FORMAT_RGBA8,
+	/*
+	 * 8 bytes per 4x4 block, two 565 colors and 2-bit indices, opaque or
+	 * with 1-bit alpha, SCE_GXM_TEXTURE_FORMAT_UBC1_ABGR
+	 */
+	TEXTURE_FILE_FORMAT_UBC1,
+	/*
+	 * 16 bytes per 4x4 block, an 8-bit alpha block with 3-bit indices then
+	 * a UBC1 color block, SCE_GXM_TEXTURE_FORMAT_UBC3_ABGR
+	 */
+	TEXTURE_FILE_FORMAT_UBC3,
+	TEXTURE_FILE_FORMAT_COUNT
+};
+
+struct texture_file_header {
+	char magic[4];
+	uint32_t version;
+	/* Bytes in the file */
+	uint32_t size;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t level_count;
+	uint32_t data_offset;
+};
+
+const char *texture_file_format_name(enum texture_file_format format);
+/* Bytes of a level of width by height texels */
+size_t texture_file_level_size(enum texture_file_format format, unsigned int width,
+	unsigned int height);
+/* Bytes of level_count levels from width by height down */
+size_t texture_file_data_size(enum texture_file_format format, unsigned int width,
+	unsigned int height, unsigned int level_count);
+
+/*
+ * Check the header and that the levels lie within the size bytes of the
+ * file at data. Returns the header, or NULL if the file is truncated or
+ * malformed.
+ */
+const struct texture_file_header *texture_file_parse(const void *data, size_t size);
+
+/* Open a texture file and return its size, NULL if it can't be opened */
+FILE *texture_file_open(const char *path, size_t *size);
+/*
+ * Read the file opened by texture_file_open() into size bytes at data
+ * with one read, close it and parse it.
+ */
+const struct texture_file_header *texture_file_read(FILE *file, void *data, size_t size);
+
+/*
+ * Write a texture whose header is filled in but for the size and the
+ * offset, which are set here, followed by the levels at data. Returns -1
+ * if the file can't be written.
+ */
+int texture_file_write(const char *path, struct texture_file_header *header,
+	const void *data);
+
+static inline const void *texture_file_data(const struct texture_file_header *header)
+{
+	return (const char *)header + header->data_offset;
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef TIME_UTILS_H
+#define TIME_UTILS_H
+
+#include <stdint.h>
+
+/* Monotonic clock */
+uint64_t time_get_ns(void);
+
+static inline float time_ns_to_ms(uint64_t ns)
+{
+	return ns / 1000000.0f;
+}
+
+#endif
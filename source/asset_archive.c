@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <psp2/io/fcntl.h>
+#include "asset_archive.h"
+#include "lz4.h"
+
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+static int valid_alignment(uint32_t alignment)
+{
+	return alignment >= ASSET_ARCHIVE_MIN_ALIGN && alignment <= ASSET_ARCHIVE_MAX_ALIGN &&
+		!(alignment & (alignment - 1));
+}
+
+static int valid_entry(const struct asset_archive_entry *entry, uint32_t file_size)
+{
+	if (!memchr(entry->name, '\0', sizeof(entry->name)) || !entry->name[0] ||
+	    !valid_alignment(entry->alignment) || entry->offset % entry->alignment ||
+	    entry->offset > file_size || entry->stored_size > file_size - entry->offset)
+		return 0;
+
+	switch (entry->compression) {
+	case ASSET_COMPRESSION_NONE:
+		return entry->stored_size == entry->size;
+	case ASSET_COMPRESSION_LZ4:
+		return entry->stored_size <= lz4_compress_bound(entry->size);
+	default:
+		return 0;
+	}
+}
+
+int asset_archive_read(const struct asset_archive *archive, uint32_t offset, void *data,
+	uint32_t size)
+{
+	char *p = data;
+
+	while (size) {
+		int read = sceIoPread(archive->fd, p, size, offset);
+
+		if (read <= 0)
+			return -1;
+
+		p += read;
+		offset += read;
+		size -= read;
+	}
+
+	return 0;
+}
+
+int asset_archive_open(struct asset_archive *archive, const char *path)
+{
+	struct asset_archive_header *header = &archive->header;
+	SceOff file_size;
+	unsigned int i;
+
+	memset(archive, 0, sizeof(*archive));
+
+	archive->fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+	if (archive->fd < 0)
+		return -1;
+
+	file_size = sceIoLseek(archive->fd, 0, SCE_SEEK_END);
+	if (file_size < (SceOff)sizeof(*header) || file_size > UINT32_MAX ||
+	    asset_archive_read(archive, 0, header, sizeof(*header)) < 0)
+		goto err_close;
+
+	if (memcmp(header->magic, ASSET_ARCHIVE_MAGIC, sizeof(header->magic)) ||
+	    header->version != ASSET_ARCHIVE_VERSION || header->size != file_size ||
+	    header->toc_offset > header->size ||
+	    header->entry_count > (header->size - header->toc_offset) / sizeof(*archive->entries))
+		goto err_close;
+
+	archive->entries = malloc(header->entry_count * sizeof(*archive->entries));
+	if (header->entry_count && (!archive->entries ||
+	    asset_archive_read(archive, header->toc_offset, archive->entries,
+	    header->entry_count * sizeof(*archive->entries)) < 0))
+		goto err_free;
+
+	/* Sorted by name, for asset_archive_find() */
+	for (i = 0; i < header->entry_count; i++) {
+		const struct asset_archive_entry *entry = &archive->entries[i];
+
+		if (!valid_entry(entry, header->size) ||
+		    (i && strcmp(entry[-1].name, entry->name) >= 0))
+			goto err_free;
+
+		if (entry->compression == ASSET_COMPRESSION_LZ4 &&
+		    entry->stored_size > archive->max_compressed_size)
+			archive->max_compressed_size = entry->stored_size;
+	}
+
+	return 0;
+
+err_free:
+	free(archive->entries);
+	archive->entries = NULL;
+err_close:
+	sceIoClose(archive->fd);
+	archive->fd = -1;
+	return -1;
+}
+
+void asset_archive_close(struct asset_archive *archive)
+{
+	free(archive->entries);
+	archive->entries = NULL;
+	if (archive->fd >= 0)
+		sceIoClose(archive->fd);
+	archive->fd = -1;
+}
+
+static int compare_entry_name(const void *key, const void *element)
+{
+	return strcmp(key, ((const struct asset_archive_entry *)element)->name);
+}
+
+const struct asset_archive_entry *asset_archive_find(const struct asset_archive *archive,
+	const char *name)
+{
+	return bsearch(name, archive->entries, archive->header.entry_count,
+		sizeof(*archive->entries), compare_entry_name);
+}
+
+int asset_archive_load(const struct asset_archive *archive,
+	const struct asset_archive_entry *entry, void *destination, void *scratch)
+{
+	if (entry->compression == ASSET_COMPRESSION_NONE)
+		return asset_archive_read(archive, entry->offset, destination, entry->size);
+
+	if (asset_archive_read(archive, entry->offset, scratch, entry->stored_size) < 0)
+		return -1;
+
+	return lz4_decompress(scratch, entry->stored_size, destination, entry->size) ==
+		(int)entry->size ? 0 : -1;
+}
+
+static int compare_source_name(const void *a, const void *b)
+{
+	return strcmp((*(const struct asset_archive_source *const *)a)->name,
+		(*(const struct asset_archive_source *const *)b)->name);
+}
+
+static int write_padding(FILE *file, uint32_t *offset, uint32_t alignment)
+{
+	static const char zeros[ASSET_ARCHIVE_MAX_ALIGN];
+	uint32_t aligned = ALIGN_UP(*offset, alignment);
+
+	if (fwrite(zeros, 1, aligned - *offset, file) != aligned - *offset)
+		return -1;
+
+	*offset = aligned;
+
+	return 0;
+}
+
+int asset_archive_write(const char *path, const struct asset_archive_source *sources,
+	unsigned int count)
+{
+	const struct asset_archive_source **sorted;
+	struct asset_archive_header header;
+	struct asset_archive_entry *entries;
+	void **compressed;
+	uint32_t offset;
+	unsigned int i;
+	FILE *file = NULL;
+	int ret = -1;
+
+	sorted = calloc(count + 1, sizeof(*sorted));
+	entries = calloc(count + 1, sizeof(*entries));
+	compressed = calloc(count + 1, sizeof(*compressed));
+	if (!sorted || !entries || !compressed)
+		goto out;
+
+	for (i = 0; i < count; i++)
+		sorted[i] = &sources[i];
+	qsort(sorted, count, sizeof(*sorted), compare_source_name);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ASSET_ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = ASSET_ARCHIVE_VERSION;
+	header.entry_count = count;
+	header.toc_offset = sizeof(header);
+	offset = header.toc_offset + count * sizeof(*entries);
+
+	for (i = 0; i < count; i++) {
+		const struct asset_archive_source *source = sorted[i];
+		struct asset_archive_entry *entry = &entries[i];
+		uint32_t alignment = source->alignment ? source->alignment : ASSET_ARCHIVE_MIN_ALIGN;
+
+		if (strlen(source->name) >= sizeof(entry->name) || !source->name[0] ||
+		    (i && strcmp(sorted[i - 1]->name, source->name) == 0) ||
+		    !valid_alignment(alignment))
+			goto out;
+
+		strcpy(entry->name, source->name);
+		entry->size = source->size;
+		entry->stored_size = source->size;
+		entry->compression = ASSET_COMPRESSION_NONE;
+		entry->alignment = alignment;
+
+		if (source->compress && source->size) {
+			unsigned int bound = lz4_compress_bound(source->size);
+			unsigned int size;
+
+			compressed[i] = malloc(bound);
+			if (!compressed[i])
+				goto out;
+
+			size = lz4_compress(source->data, source->size, compressed[i], bound);
+			if (size && size < source->size) {
+				entry->stored_size = size;
+				entry->compression = ASSET_COMPRESSION_LZ4;
+			}
+		}
+
+		offset = ALIGN_UP(offset, alignment);
+		entry->offset = offset;
+		offset += entry->stored_size;
+	}
+	header.size = offset;
+
+	file = fopen(path, "wb");
+	if (!file)
+		goto out;
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+	    fwrite(entries, sizeof(*entries), count, file) != count)
+		goto out;
+
+	offset = header.toc_offset + count * sizeof(*entries);
+	for (i = 0; i < count; i++) {
+		const void *data = entries[i].compression == ASSET_COMPRESSION_LZ4 ?
+			compressed[i] : sorted[i]->data;
+
+		if (write_padding(file, &offset, entries[i].alignment) < 0 ||
+		    fwrite(data, 1, entries[i].stored_size, file) != entries[i].stored_size)
+			goto out;
+		offset += entries[i].stored_size;
+	}
+
+	ret = 0;
+
+out:
+	if (file && fclose(file) != 0)
+		ret = -1;
+	for (i = 0; compressed && i < count; i++)
+		free(compressed[i]);
+	free(compressed);
+	free(entries);
+	free(sorted);
+
+	return ret;
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "asset_loader.h"
+#include "lz4.h"
+#include "time_utils.h"
+
+#define ASSET_LOADER_THREAD_STACK_SIZE (64 * 1024)
+
+/* The completion queue must take every request in flight, so pushing it never fails */
+#if SPSC_QUEUE_CAPACITY < ASSET_LOADER_MAX_REQUESTS
+#error "SPSC_QUEUE_CAPACITY is smaller than ASSET_LOADER_MAX_REQUESTS"
+#endif
+
+static int loader_running(const struct asset_loader *loader)
+{
+	return __atomic_load_n(&loader->running, __ATOMIC_RELAXED);
+}
+
+static void add_stat(uint64_t *stat, uint64_t value)
+{
+	__atomic_fetch_add(stat, value, __ATOMIC_RELAXED);
+}
+
+/*
+ * A compressed entry is counted as loaded in proportion to how much of
+ * it was read, and a failed one as a whole, so the progress reaches the
+ * requested bytes once every request is through.
+ */
+static int load_entry(struct asset_loader *loader, const struct asset_archive_entry *entry,
+	void *destination)
+{
+	int compressed = entry->compression == ASSET_COMPRESSION_LZ4;
+	char *target = compressed ? loader->staging : destination;
+	uint64_t counted = 0, start;
+	uint32_t done = 0;
+
+	while (done < entry->stored_size) {
+		uint32_t chunk = entry->stored_size - done;
+		uint64_t loaded;
+
+		if (chunk > ASSET_LOADER_CHUNK_SIZE)
+			chunk = ASSET_LOADER_CHUNK_SIZE;
+		if (!loader_running(loader))
+			goto err;
+
+		start = time_get_ns();
+		if (asset_archive_read(loader->archive, entry->offset + done, target + done, chunk) < 0)
+			goto err;
+		add_stat(&loader->stats.read_ns, time_get_ns() - start);
+		add_stat(&loader->stats.bytes_read, chunk);
+		done += chunk;
+
+		loaded = (uint64_t)done * entry->size / entry->stored_size;
+		add_stat(&loader->bytes_loaded, loaded - counted);
+		counted = loaded;
+	}
+
+	if (compressed) {
+		start = time_get_ns();
+		if (lz4_decompress(loader->staging, entry->stored_size, destination, entry->size) !=
+		    (int)entry->size)
+			goto err;
+		add_stat(&loader->stats.decompress_ns, time_get_ns() - start);
+		add_stat(&loader->stats.bytes_decompressed, entry->size);
+	}
+
+	add_stat(&loader->stats.bytes_loaded, entry->size);
+
+	return 0;
+
+err:
+	add_stat(&loader->bytes_loaded, entry->size - counted);
+	return -1;
+}
+
+static void *loader_thread(void *arg)
+{
+	struct asset_loader *loader = arg;
+
+	for (;;) {
+		struct asset_request *request;
+		uint64_t start;
+
+		pthread_mutex_lock(&loader->mutex);
+		while (loader_running(loader) &&
+		       __atomic_load_n(&loader->submitted, __ATOMIC_ACQUIRE) == loader->taken)
+			pthread_cond_wait(&loader->cond, &loader->mutex);
+		pthread_mutex_unlock(&loader->mutex);
+
+		if (!loader_running(loader))
+			break;
+
+		request = &loader->requests[loader->taken++ % ASSET_LOADER_MAX_REQUESTS];
+		start = time_get_ns();
+		request->status = load_entry(loader, request->entry, request->destination) == 0 ?
+			ASSET_REQUEST_DONE : ASSET_REQUEST_FAILED;
+		request->load_ns = time_get_ns() - start;
+		add_stat(&loader->stats.busy_ns, request->load_ns);
+
+		spsc_queue_push(&loader->completed, request);
+	}
+
+	return NULL;
+}
+
+int asset_loader_init(struct asset_loader *loader, const struct asset_archive *archive)
+{
+	pthread_attr_t attr;
+	int ret;
+
+	memset(loader, 0, sizeof(*loader));
+	loader->archive = archive;
+	spsc_queue_init(&loader->completed);
+
+	if (archive->max_compressed_size) {
+		loader->staging = malloc(archive->max_compressed_size);
+		if (!loader->staging)
+			return -1;
+	}
+
+	pthread_mutex_init(&loader->mutex, NULL);
+	pthread_cond_init(&loader->cond, NULL);
+	loader->running = 1;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, ASSET_LOADER_THREAD_STACK_SIZE);
+	ret = pthread_create(&loader->thread, &attr, loader_thread, loader);
+	pthread_attr_destroy(&attr);
+
+	if (ret != 0) {
+		pthread_cond_destroy(&loader->cond);
+		pthread_mutex_destroy(&loader->mutex);
+		free(loader->staging);
+		return -1;
+	}
+
+	return 0;
+}
+
+void asset_loader_finish(struct asset_loader *loader)
+{
+	pthread_mutex_lock(&loader->mutex);
+	__atomic_store_n(&loader->running, 0, __ATOMIC_RELAXED);
+	pthread_cond_signal(&loader->cond);
+	pthread_mutex_unlock(&loader->mutex);
+
+	pthread_join(loader->thread, NULL);
+	pthread_cond_destroy(&loader->cond);
+	pthread_mutex_destroy(&loader->mutex);
+	free(loader->staging);
+	loader->staging = NULL;
+}
+
+struct asset_request *asset_loader_request(struct asset_loader *loader,
+	const struct asset_archive_entry *entry, void *destination, void *user)
+{
+	struct asset_request *request;
+
+	if (loader->requested - loader->polled >= ASSET_LOADER_MAX_REQUESTS)
+		return NULL;
+
+	request = &loader->requests[loader->requested % ASSET_LOADER_MAX_REQUESTS];
+	request->entry = entry;
+	request->destination = destination;
+	request->user = user;
+	request->status = ASSET_REQUEST_PENDING;
+	request->load_ns = 0;
+
+	loader->requested++;
+	loader->bytes_requested += entry->size;
+
+	/* Held only to not miss the loader going to sleep */
+	pthread_mutex_lock(&loader->mutex);
+	__atomic_store_n(&loader->submitted, loader->requested, __ATOMIC_RELEASE);
+	pthread_cond_signal(&loader->cond);
+	pthread_mutex_unlock(&loader->mutex);
+
+	return request;
+}
+
+struct asset_request *asset_loader_poll(struct asset_loader *loader)
+{
+	struct asset_request *request = spsc_queue_pop(&loader->completed);
+
+	if (!request)
+		return NULL;
+
+	loader->polled++;
+	if (request->status == ASSET_REQUEST_FAILED)
+		loader->failed++;
+
+	return request;
+}
+
+void asset_loader_get_progress(struct asset_loader *loader,
+	struct asset_loader_progress *progress)
+{
+	progress->requested = loader->requested;
+	progress->completed = loader->polled;
+	progress->failed = loader->failed;
+	progress->bytes_requested = loader->bytes_requested;
+	progress->bytes_loaded = __atomic_load_n(&loader->bytes_loaded, __ATOMIC_RELAXED);
+}
+
+void asset_loader_get_stats(struct asset_loader *loader, struct asset_loader_stats *stats)
+{
+	stats->bytes_read = __atomic_load_n(&loader->stats.bytes_read, __ATOMIC_RELAXED);
+	stats->bytes_loaded = __atomic_load_n(&loader->stats.bytes_loaded, __ATOMIC_RELAXED);
+	stats->bytes_decompressed = __atomic_load_n(&loader->stats.bytes_decompressed,
+		__ATOMIC_RELAXED);
+	stats->read_ns = __atomic_load_n(&loader->stats.read_ns, __ATOMIC_RELAXED);
+	stats->decompress_ns = __atomic_load_n(&loader->stats.decompress_ns, __ATOMIC_RELAXED);
+	stats->busy_ns = __atomic_load_n(&loader->stats.busy_ns, __ATOMIC_RELAXED);
+}
+
+static float megabytes_per_second(uint64_t bytes, uint64_t ns)
+{
+	return ns ? bytes / (1024.0f * 1024.0f) / (ns / 1e9f) : 0.0f;
+}
+
+void asset_loader_print_stats(const struct asset_loader_stats *stats)
+{
+	printf("assets: %.2f MB loaded from %.2f MB read in %.3f ms, %.1f MB/s "
+		"(read %.1f MB/s, decompress %.1f MB/s)\n",
+		stats->bytes_loaded / (1024.0f * 1024.0f), stats->bytes_read / (1024.0f * 1024.0f),
+		time_ns_to_ms(stats->busy_ns), megabytes_per_second(stats->bytes_loaded, stats->busy_ns),
+		megabytes_per_second(stats->bytes_read, stats->read_ns),
+		megabytes_per_second(stats->bytes_decompressed, stats->decompress_ns));
+}
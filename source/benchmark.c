@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmark.h"
+#include "gpu_memory.h"
+#include "profiler.h"
+#include "time_utils.h"
+
+void benchmark_init(struct benchmark *benchmark, unsigned int warmup_frames)
+{
+	memset(benchmark, 0, sizeof(*benchmark));
+	benchmark->warmup_frames = warmup_frames;
+}
+
+void benchmark_free(struct benchmark *benchmark)
+{
+	free(benchmark->frame_ns);
+	benchmark->frame_ns = NULL;
+}
+
+static int measuring(const struct benchmark *benchmark)
+{
+	return benchmark->frames > benchmark->warmup_frames;
+}
+
+void benchmark_begin_frame(struct benchmark *benchmark, uint64_t now_ns)
+{
+	/* The frame that just ended, if it wasn't part of the warmup */
+	if (measuring(benchmark)) {
+		if (benchmark->frame_ns_count == benchmark->frame_ns_capacity) {
+			unsigned int capacity = benchmark->frame_ns_capacity ?
+				benchmark->frame_ns_capacity * 2 : 1024;
+			uint64_t *frame_ns = realloc(benchmark->frame_ns,
+				capacity * sizeof(*frame_ns));
+
+			if (!frame_ns)
+				return;
+
+			benchmark->frame_ns = frame_ns;
+			benchmark->frame_ns_capacity = capacity;
+		}
+
+		benchmark->frame_ns[benchmark->frame_ns_count++] =
+			now_ns - benchmark->last_frame_start_ns;
+	}
+
+	benchmark->last_frame_start_ns = now_ns;
+
+	if (++benchmark->frames == benchmark->warmup_frames + 1)
+		profiler_reset_totals();
+}
+
+void benchmark_end_frame(struct benchmark *benchmark)
+{
+	const struct render_counters_frame *frame;
+	unsigned int pass, counter;
+
+	if (!measuring(benchmark))
+		return;
+
+	frame = render_counters_get_frame(0);
+	if (!frame)
+		return;
+
+	for (pass = 0; pass < RENDER_PASS_COUNT; pass++) {
+		for (counter = 0; counter < RENDER_COUNTER_COUNT; counter++)
+			benchmark->counters[pass][counter] += frame->values[pass][counter];
+	}
+
+	benchmark->counted_frames++;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Nearest rank percentile of sorted values */
+static float percentile_ms(const uint64_t *sorted, unsigned int count, unsigned int percent)
+{
+	unsigned int rank = (count * percent + 99) / 100;
+
+	return time_ns_to_ms(sorted[rank ? rank - 1 : 0]);
+}
+
+static void write_metric(FILE *file, unsigned int *count, const char *name, double value)
+{
+	fprintf(file, "%s\t\t\"%s\": %.9g", (*count)++ ? ",\n" : "", name, value);
+}
+
+int benchmark_write_json(const struct benchmark *benchmark, const char *path)
+{
+	struct profiler_scope_total totals[PROFILER_MAX_SCOPES];
+	struct gpu_memory_stats memory_stats;
+	unsigned int count = benchmark->frame_ns_count;
+	unsigned int metrics = 0;
+	unsigned int scope_count, pass, i;
+	uint64_t *sorted, total_ns = 0;
+	char name[96];
+	FILE *file;
+
+	if (!count)
+		return -1;
+
+	sorted = malloc(count * sizeof(*sorted));
+	if (!sorted)
+		return -1;
+
+	memcpy(sorted, benchmark->frame_ns, count * sizeof(*sorted));
+	qsort(sorted, count, sizeof(*sorted), compare_u64);
+	for (i = 0; i < count; i++)
+		total_ns += sorted[i];
+
+	file = fopen(path, "w");
+	if (!file) {
+		free(sorted);
+		return -1;
+	}
+
+	fprintf(file, "{\n\t\"frames\": %u,\n\t\"warmup_frames\": %u,\n\t\"metrics\": {\n",
+		count, benchmark->warmup_frames);
+
+	write_metric(file, &metrics, "frame_ms.avg", time_ns_to_ms(total_ns) / count);
+	write_metric(file, &metrics, "frame_ms.p50", percentile_ms(sorted, count, 50));
+	write_metric(file, &metrics, "frame_ms.p95", percentile_ms(sorted, count, 95));
+	write_metric(file, &metrics, "frame_ms.p99", percentile_ms(sorted, count, 99));
+
+	/* Average time per measured frame of every profiler scope */
+	scope_count = profiler_get_totals(totals, PROFILER_MAX_SCOPES);
+	for (i = 0; i < scope_count; i++) {
+		snprintf(name, sizeof(name), "cpu_ms.%s", totals[i].name);
+		write_metric(file, &metrics, name, totals[i].total_ms / count);
+	}
+
+	if (benchmark->counted_frames) {
+		uint64_t draws = 0, primitives = 0;
+
+		for (pass = 0; pass < RENDER_PASS_COUNT; pass++) {
+			draws += benchmark->counters[pass][RENDER_COUNTER_DRAWS];
+			primitives += benchmark->counters[pass][RENDER_COUNTER_PRIMITIVES];
+
+			snprintf(name, sizeof(name), "draws.%s", render_pass_name(pass));
+			write_metric(file, &metrics, name,
+				(double)benchmark->counters[pass][RENDER_COUNTER_DRAWS] /
+				benchmark->counted_frames);
+		}
+
+		write_metric(file, &metrics, "draws", (double)draws / benchmark->counted_frames);
+		write_metric(file, &metrics, "primitives",
+			(double)primitives / benchmark->counted_frames);
+	}
+
+	gpu_memory_get_stats(&memory_stats);
+	write_metric(file, &metrics, "gpu_memory.peak_bytes", memory_stats.total.peak);
+	write_metric(file, &metrics, "gpu_memory.cdram_peak_bytes", memory_stats.cdram.peak);
+
+	fprintf(file, "\n\t}\n}\n");
+
+	free(sorted);
+
+	return fclose(file) ? -1 : 0;
+}
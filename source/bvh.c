@@ -0,0 +1,469 @@
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include "bvh.h"
+
+typedef float vec4f __attribute__((vector_size(16)));
+typedef int32_t vec4i __attribute__((vector_size(16)));
+
+enum box_test {
+	BOX_OUTSIDE,
+	BOX_INTERSECTS,
+	BOX_INSIDE
+};
+
+struct bin {
+	struct bvh_aabb bounds;
+	unsigned int count;
+};
+
+struct build_entry {
+	uint32_t node;
+	unsigned int depth;
+};
+
+struct cull_entry {
+	uint32_t node;
+	/* Frustums that partially see the node, and those that contain it */
+	uint8_t active;
+	uint8_t inside;
+};
+
+static void aabb_empty(struct bvh_aabb *box)
+{
+	vector3f_init(&box->min, FLT_MAX, FLT_MAX, FLT_MAX);
+	vector3f_init(&box->max, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+static void aabb_grow(struct bvh_aabb *box, const vector3f *min, const vector3f *max)
+{
+	/* Not fminf()/fmaxf(), which are library calls without -ffast-math */
+	box->min.x = min->x < box->min.x ? min->x : box->min.x;
+	box->min.y = min->y < box->min.y ? min->y : box->min.y;
+	box->min.z = min->z < box->min.z ? min->z : box->min.z;
+	box->max.x = max->x > box->max.x ? max->x : box->max.x;
+	box->max.y = max->y > box->max.y ? max->y : box->max.y;
+	box->max.z = max->z > box->max.z ? max->z : box->max.z;
+}
+
+/* Half the surface area, which is all the heuristic needs */
+static float aabb_area(const struct bvh_aabb *box)
+{
+	float dx = box->max.x - box->min.x;
+	float dy = box->max.y - box->min.y;
+	float dz = box->max.z - box->min.z;
+
+	if (dx < 0.0f)
+		return 0.0f;
+
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static inline float vector3f_axis(const vector3f *v, int axis)
+{
+	return ((const float *)v)[axis];
+}
+
+void bvh_init(struct bvh *bvh)
+{
+	memset(bvh, 0, sizeof(*bvh));
+}
+
+void bvh_free(struct bvh *bvh)
+{
+	free(bvh->nodes);
+	free(bvh->indices);
+	free(bvh->centroids);
+	free(bvh->node_changed);
+	bvh_init(bvh);
+}
+
+static int bvh_reserve(struct bvh *bvh, unsigned int count)
+{
+	if (count <= bvh->capacity)
+		return 0;
+
+	free(bvh->nodes);
+	free(bvh->indices);
+	free(bvh->centroids);
+	free(bvh->node_changed);
+
+	/* A binary tree with a primitive per leaf at worst */
+	bvh->nodes = malloc(2 * count * sizeof(*bvh->nodes));
+	bvh->indices = malloc(count * sizeof(*bvh->indices));
+	bvh->centroids = malloc(count * sizeof(*bvh->centroids));
+	bvh->node_changed = malloc(2 * count * sizeof(*bvh->node_changed));
+	if (!bvh->nodes || !bvh->indices || !bvh->centroids || !bvh->node_changed) {
+		bvh_free(bvh);
+		return -1;
+	}
+
+	bvh->capacity = count;
+
+	return 0;
+}
+
+static void node_bounds(struct bvh *bvh, struct bvh_node *node, const struct bvh_aabb *boxes)
+{
+	struct bvh_aabb bounds;
+	unsigned int i;
+
+	aabb_empty(&bounds);
+	for (i = node->first; i < node->first + node->count; i++) {
+		const struct bvh_aabb *box = &boxes[bvh->indices[i]];
+
+		aabb_grow(&bounds, &box->min, &box->max);
+	}
+
+	node->min = bounds.min;
+	node->max = bounds.max;
+}
+
+/*
+ * Binned SAH split of the node's primitives: returns the number that go
+ * to the left child, after partitioning them, or 0 to keep a leaf.
+ */
+static unsigned int split_node(struct bvh *bvh, const struct bvh_node *node,
+	const struct bvh_aabb *boxes)
+{
+	struct bin bins[BVH_BINS];
+	struct bvh_aabb centroid_bounds, left, right;
+	float left_area[BVH_BINS - 1];
+	unsigned int left_count[BVH_BINS - 1];
+	float best_cost = FLT_MAX, leaf_cost, node_area;
+	int best_axis = -1, best_split = 0;
+	unsigned int i, j, count;
+	int axis;
+
+	aabb_empty(&centroid_bounds);
+	for (i = node->first; i < node->first + node->count; i++) {
+		const vector3f *c = &bvh->centroids[bvh->indices[i]];
+
+		aabb_grow(&centroid_bounds, c, c);
+	}
+
+	for (axis = 0; axis < 3; axis++) {
+		float min = vector3f_axis(&centroid_bounds.min, axis);
+		float extent = vector3f_axis(&centroid_bounds.max, axis) - min;
+		float scale;
+
+		if (extent <= 0.0f)
+			continue;
+
+		scale = BVH_BINS / extent;
+
+		for (j = 0; j < BVH_BINS; j++) {
+			aabb_empty(&bins[j].bounds);
+			bins[j].count = 0;
+		}
+
+		for (i = node->first; i < node->first + node->count; i++) {
+			uint32_t index = bvh->indices[i];
+			unsigned int b = (vector3f_axis(&bvh->centroids[index], axis) - min) * scale;
+
+			if (b >= BVH_BINS)
+				b = BVH_BINS - 1;
+			bins[b].count++;
+			aabb_grow(&bins[b].bounds, &boxes[index].min, &boxes[index].max);
+		}
+
+		/* Sweep from the left, then from the right evaluating each split */
+		aabb_empty(&left);
+		count = 0;
+		for (j = 0; j < BVH_BINS - 1; j++) {
+			count += bins[j].count;
+			aabb_grow(&left, &bins[j].bounds.min, &bins[j].bounds.max);
+			left_count[j] = count;
+			left_area[j] = aabb_area(&left);
+		}
+
+		aabb_empty(&right);
+		count = 0;
+		for (j = BVH_BINS - 1; j > 0; j--) {
+			float cost;
+
+			count += bins[j].count;
+			aabb_grow(&right, &bins[j].bounds.min, &bins[j].bounds.max);
+
+			if (!left_count[j - 1] || !count)
+				continue;
+
+			cost = left_area[j - 1] * left_count[j - 1] + aabb_area(&right) * count;
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_split = j;
+			}
+		}
+	}
+
+	node_area = aabb_area(&(struct bvh_aabb){node->min, node->max});
+	leaf_cost = node->count * node_area;
+
+	if (best_axis < 0) {
+		/* Every centroid in the same spot, halve the range */
+		return node->count > BVH_MAX_LEAF_SIZE ? node->count / 2 : 0;
+	}
+
+	/* Visiting two children costs about as much as testing a box */
+	if (node->count <= BVH_MAX_LEAF_SIZE && best_cost + node_area >= leaf_cost)
+		return 0;
+
+	{
+		float min = vector3f_axis(&centroid_bounds.min, best_axis);
+		float scale = BVH_BINS / (vector3f_axis(&centroid_bounds.max, best_axis) - min);
+		uint32_t *first = &bvh->indices[node->first];
+		uint32_t *last = first + node->count - 1;
+
+		while (first <= last) {
+			unsigned int b = (vector3f_axis(&bvh->centroids[*first], best_axis) - min) * scale;
+
+			if (b >= BVH_BINS)
+				b = BVH_BINS - 1;
+
+			if ((int)b < best_split) {
+				first++;
+			} else {
+				uint32_t tmp = *first;
+
+				*first = *last;
+				*last-- = tmp;
+			}
+		}
+
+		return first - &bvh->indices[node->first];
+	}
+}
+
+int bvh_build(struct bvh *bvh, const struct bvh_aabb *boxes, unsigned int count)
+{
+	struct build_entry stack[BVH_MAX_DEPTH + 1];
+	unsigned int stack_size = 0;
+	unsigned int i;
+
+	bvh->node_count = 0;
+	bvh->primitive_count = 0;
+
+	if (!count)
+		return 0;
+
+	if (bvh_reserve(bvh, count) < 0)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		bvh->indices[i] = i;
+		vector3f_lerp(&bvh->centroids[i], &boxes[i].min, &boxes[i].max, 0.5f);
+	}
+
+	bvh->primitive_count = count;
+	bvh->node_count = 1;
+	bvh->nodes[0].first = 0;
+	bvh->nodes[0].count = count;
+	node_bounds(bvh, &bvh->nodes[0], boxes);
+
+	stack[stack_size++] = (struct build_entry){0, 0};
+
+	while (stack_size) {
+		struct build_entry entry = stack[--stack_size];
+		struct bvh_node *node = &bvh->nodes[entry.node];
+		struct bvh_node *children;
+		unsigned int left_count;
+
+		if (entry.depth == BVH_MAX_DEPTH)
+			continue;
+
+		left_count = split_node(bvh, node, boxes);
+		if (!left_count)
+			continue;
+
+		children = &bvh->nodes[bvh->node_count];
+		children[0].first = node->first;
+		children[0].count = left_count;
+		children[1].first = node->first + left_count;
+		children[1].count = node->count - left_count;
+		node_bounds(bvh, &children[0], boxes);
+		node_bounds(bvh, &children[1], boxes);
+
+		node->first = bvh->node_count;
+		node->count = 0;
+		bvh->node_count += 2;
+
+		stack[stack_size++] = (struct build_entry){node->first, entry.depth + 1};
+		stack[stack_size++] = (struct build_entry){node->first + 1, entry.depth + 1};
+	}
+
+	return 0;
+}
+
+void bvh_refit(struct bvh *bvh, const struct bvh_aabb *boxes, const uint8_t *changed)
+{
+	unsigned int n, i;
+
+	/* Children are always after their parent */
+	for (n = bvh->node_count; n-- > 0;) {
+		struct bvh_node *node = &bvh->nodes[n];
+		int node_changed = 0;
+
+		if (node->count) {
+			for (i = node->first; i < node->first + node->count && !node_changed; i++)
+				node_changed = !changed || changed[bvh->indices[i]];
+			if (node_changed)
+				node_bounds(bvh, node, boxes);
+		} else {
+			const struct bvh_node *left = &bvh->nodes[node->first];
+			const struct bvh_node *right = left + 1;
+
+			node_changed = bvh->node_changed[node->first] ||
+				bvh->node_changed[node->first + 1];
+			if (node_changed) {
+				struct bvh_aabb bounds = {left->min, left->max};
+
+				aabb_grow(&bounds, &right->min, &right->max);
+				node->min = bounds.min;
+				node->max = bounds.max;
+			}
+		}
+
+		bvh->node_changed[n] = node_changed;
+	}
+}
+
+void bvh_frustum_init(struct bvh_frustum *frustum, const vector4f planes[6])
+{
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		/* The padding planes contain everything */
+		const vector4f pass = {.x = 0.0f, .y = 0.0f, .z = 0.0f, .w = 1.0f};
+		const vector4f *plane = i < 6 ? &planes[i] : &pass;
+
+		frustum->x[i] = plane->x;
+		frustum->y[i] = plane->y;
+		frustum->z[i] = plane->z;
+		frustum->w[i] = plane->w;
+		frustum->abs_x[i] = fabsf(plane->x);
+		frustum->abs_y[i] = fabsf(plane->y);
+		frustum->abs_z[i] = fabsf(plane->z);
+	}
+}
+
+static inline vec4f splat(float x)
+{
+	return (vec4f){x, x, x, x};
+}
+
+/*
+ * Distance from the box center to each plane against the box's
+ * projected radius on the plane normal: the box is out if it's entirely
+ * behind any plane and inside if it's in front of all of them.
+ */
+static enum box_test test_box(const struct bvh_frustum *frustum,
+	const vector3f *min, const vector3f *max)
+{
+	vec4f cx = splat((min->x + max->x) * 0.5f);
+	vec4f cy = splat((min->y + max->y) * 0.5f);
+	vec4f cz = splat((min->z + max->z) * 0.5f);
+	vec4f ex = splat((max->x - min->x) * 0.5f);
+	vec4f ey = splat((max->y - min->y) * 0.5f);
+	vec4f ez = splat((max->z - min->z) * 0.5f);
+	vec4i outside = {0, 0, 0, 0};
+	vec4i inside = {-1, -1, -1, -1};
+	int i;
+
+	for (i = 0; i < 8; i += 4) {
+		vec4f d = *(const vec4f *)&frustum->x[i] * cx + *(const vec4f *)&frustum->y[i] * cy +
+			*(const vec4f *)&frustum->z[i] * cz + *(const vec4f *)&frustum->w[i];
+		vec4f r = *(const vec4f *)&frustum->abs_x[i] * ex +
+			*(const vec4f *)&frustum->abs_y[i] * ey + *(const vec4f *)&frustum->abs_z[i] * ez;
+
+		outside |= (d + r) < 0.0f;
+		inside &= (d - r) >= 0.0f;
+	}
+
+	if (outside[0] | outside[1] | outside[2] | outside[3])
+		return BOX_OUTSIDE;
+	if (inside[0] & inside[1] & inside[2] & inside[3])
+		return BOX_INSIDE;
+
+	return BOX_INTERSECTS;
+}
+
+static uint8_t test_frustums(const struct bvh_frustum *frustums, uint8_t *active,
+	const vector3f *min, const vector3f *max)
+{
+	uint8_t inside = 0;
+	unsigned int mask = *active;
+
+	while (mask) {
+		unsigned int f = __builtin_ctz(mask);
+		enum box_test result = test_box(&frustums[f], min, max);
+
+		mask &= mask - 1;
+		if (result == BOX_OUTSIDE)
+			*active &= ~(1u << f);
+		else if (result == BOX_INSIDE)
+			inside |= 1u << f;
+	}
+
+	*active &= ~inside;
+
+	return inside;
+}
+
+void bvh_cull(const struct bvh *bvh, const struct bvh_aabb *boxes,
+	const struct bvh_frustum *frustums, unsigned int frustum_count,
+	uint32_t *const visible[], unsigned int visible_count[], unsigned int capacity)
+{
+	struct cull_entry stack[BVH_MAX_DEPTH + 2];
+	unsigned int stack_size = 0;
+	unsigned int f, i;
+
+	if (frustum_count > BVH_MAX_FRUSTUMS)
+		frustum_count = BVH_MAX_FRUSTUMS;
+
+	for (f = 0; f < frustum_count; f++)
+		visible_count[f] = 0;
+
+	if (!bvh->node_count || !frustum_count)
+		return;
+
+	stack[stack_size++] = (struct cull_entry){0, (1u << frustum_count) - 1, 0};
+
+	while (stack_size) {
+		struct cull_entry entry = stack[--stack_size];
+		const struct bvh_node *node = &bvh->nodes[entry.node];
+		uint8_t active = entry.active;
+		uint8_t inside = entry.inside;
+
+		if (active)
+			inside |= test_frustums(frustums, &active, &node->min, &node->max);
+		if (!(active | inside))
+			continue;
+
+		if (!node->count) {
+			stack[stack_size++] = (struct cull_entry){node->first + 1, active, inside};
+			stack[stack_size++] = (struct cull_entry){node->first, active, inside};
+			continue;
+		}
+
+		for (i = node->first; i < node->first + node->count; i++) {
+			uint32_t index = bvh->indices[i];
+			uint8_t box_active = active;
+			unsigned int mask;
+
+			if (index >= capacity)
+				continue;
+
+			mask = inside;
+			if (box_active)
+				mask |= test_frustums(frustums, &box_active,
+					&boxes[index].min, &boxes[index].max) | box_active;
+
+			while (mask) {
+				f = __builtin_ctz(mask);
+				mask &= mask - 1;
+				visible[f][visible_count[f]++] = index;
+			}
+		}
+	}
+}
@@ -0,0 +1,175 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "camera_path.h"
+
+#define CAMERA_PATH_KEY_FLOATS 13
+
+static int parse_key(const char *line, struct camera_path_key *key)
+{
+	float values[CAMERA_PATH_KEY_FLOATS];
+	const char *p = line;
+	char *end;
+	int i;
+
+	for (i = 0; i < CAMERA_PATH_KEY_FLOATS; i++) {
+		values[i] = strtof(p, &end);
+		if (end == p)
+			return -1;
+		p = end;
+	}
+
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		p++;
+	if (*p)
+		return -1;
+
+	key->time = values[0];
+	vector3f_init(&key->camera_position, values[1], values[2], values[3]);
+	vector3f_init(&key->camera_rotation,
+		DEG_TO_RAD(values[4]), DEG_TO_RAD(values[5]), DEG_TO_RAD(values[6]));
+	vector3f_init(&key->portal_end2_translation, values[7], values[8], values[9]);
+	vector3f_init(&key->portal_end2_rotation,
+		DEG_TO_RAD(values[10]), DEG_TO_RAD(values[11]), DEG_TO_RAD(values[12]));
+
+	return 0;
+}
+
+int camera_path_load(struct camera_path *path, const char *filename)
+{
+	char line[512];
+	unsigned int line_number = 0;
+	FILE *file;
+
+	memset(path, 0, sizeof(*path));
+
+	file = fopen(filename, "r");
+	if (!file)
+		return -1;
+
+	path->keys = malloc(CAMERA_PATH_MAX_KEYS * sizeof(*path->keys));
+	if (!path->keys)
+		goto err_close;
+
+	while (fgets(line, sizeof(line), file)) {
+		struct camera_path_key *key = &path->keys[path->num_keys];
+		const char *p = line;
+
+		line_number++;
+
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '#' || *p == '\n' || *p == '\r' || !*p)
+			continue;
+
+		if (path->num_keys == CAMERA_PATH_MAX_KEYS) {
+			printf("%s:%u: more than %u keys\n", filename, line_number,
+				CAMERA_PATH_MAX_KEYS);
+			goto err_free;
+		}
+
+		if (parse_key(p, key) < 0) {
+			printf("%s:%u: expected %u numbers\n", filename, line_number,
+				CAMERA_PATH_KEY_FLOATS);
+			goto err_free;
+		}
+
+		if (path->num_keys && key->time <= key[-1].time) {
+			printf("%s:%u: key times must increase\n", filename, line_number);
+			goto err_free;
+		}
+
+		path->num_keys++;
+	}
+
+	fclose(file);
+
+	if (!path->num_keys) {
+		printf("%s: no keys\n", filename);
+		camera_path_free(path);
+		return -1;
+	}
+
+	return 0;
+
+err_free:
+	camera_path_free(path);
+err_close:
+	fclose(file);
+	return -1;
+}
+
+void camera_path_free(struct camera_path *path)
+{
+	free(path->keys);
+	path->keys = NULL;
+	path->num_keys = 0;
+}
+
+float camera_path_duration(const struct camera_path *path)
+{
+	return path->keys[path->num_keys - 1].time;
+}
+
+/*
+ * Tangent at key i, the Catmull-Rom finite difference with the keys'
+ * actual times so unevenly spaced keys don't overshoot. The end keys
+ * use a one-sided difference.
+ */
+static float key_tangent(const struct camera_path *path, unsigned int i, size_t offset)
+{
+	unsigned int prev = i > 0 ? i - 1 : i;
+	unsigned int next = i + 1 < path->num_keys ? i + 1 : i;
+	const float *p0 = (const float *)((const char *)&path->keys[prev] + offset);
+	const float *p1 = (const float *)((const char *)&path->keys[next] + offset);
+
+	return (*p1 - *p0) / (path->keys[next].time - path->keys[prev].time);
+}
+
+static float hermite(float p0, float m0, float p1, float m1, float t)
+{
+	float t2 = t * t;
+	float t3 = t2 * t;
+
+	return (2.0f * t3 - 3.0f * t2 + 1.0f) * p0 + (t3 - 2.0f * t2 + t) * m0 +
+		(-2.0f * t3 + 3.0f * t2) * p1 + (t3 - t2) * m1;
+}
+
+void camera_path_evaluate(const struct camera_path *path, float time,
+	struct camera_path_key *key)
+{
+	const struct camera_path_key *k0, *k1;
+	unsigned int i, segment;
+	float duration, t;
+	size_t offset;
+
+	if (path->num_keys == 1 || time <= path->keys[0].time) {
+		*key = path->keys[0];
+		return;
+	} else if (time >= camera_path_duration(path)) {
+		*key = path->keys[path->num_keys - 1];
+		return;
+	}
+
+	for (segment = 0; path->keys[segment + 1].time < time; segment++)
+		;
+
+	k0 = &path->keys[segment];
+	k1 = &path->keys[segment + 1];
+	duration = k1->time - k0->time;
+	t = (time - k0->time) / duration;
+
+	key->time = time;
+
+	/* The keys are all floats after the time, interpolate them one by one */
+	for (i = 0; i < CAMERA_PATH_KEY_FLOATS - 1; i++) {
+		offset = offsetof(struct camera_path_key, camera_position) + i * sizeof(float);
+
+		*(float *)((char *)key + offset) = hermite(
+			*(const float *)((const char *)k0 + offset),
+			key_tangent(path, segment, offset) * duration,
+			*(const float *)((const char *)k1 + offset),
+			key_tangent(path, segment + 1, offset) * duration, t);
+	}
+}
@@ -0,0 +1,105 @@
+#include <string.h>
+#include "command_memory.h"
+
+#define ALIGN(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
+
+#define COMMAND_MEMORY_ALIGNMENT 16
+
+static void pool_init(struct command_memory_pool *pool, char *base, unsigned int region_size)
+{
+	memset(pool, 0, sizeof(*pool));
+	pool->base = base;
+	pool->region_size = region_size;
+}
+
+static void *pool_alloc(struct command_memory_pool *pool, unsigned int region,
+	unsigned int min_size, unsigned int *size)
+{
+	unsigned int offset = ALIGN(pool->offset, COMMAND_MEMORY_ALIGNMENT);
+	unsigned int available;
+	unsigned int chunk;
+
+	available = offset < pool->region_size ? pool->region_size - offset : 0;
+	if (available < min_size) {
+		pool->failed++;
+		*size = 0;
+		return NULL;
+	}
+
+	chunk = min_size > COMMAND_MEMORY_CHUNK_SIZE ? min_size : COMMAND_MEMORY_CHUNK_SIZE;
+	if (chunk > available)
+		chunk = available;
+
+	pool->offset = offset + chunk;
+	if (pool->offset > pool->peak)
+		pool->peak = pool->offset;
+
+	*size = chunk;
+
+	return pool->base + region * pool->region_size + offset;
+}
+
+static void *vdm_callback(void *user_data, unsigned int min_size, unsigned int *size)
+{
+	struct command_memory *memory = user_data;
+
+	return pool_alloc(&memory->vdm, memory->region, min_size, size);
+}
+
+static void *vertex_callback(void *user_data, unsigned int min_size, unsigned int *size)
+{
+	struct command_memory *memory = user_data;
+
+	return pool_alloc(&memory->vertex, memory->region, min_size, size);
+}
+
+static void *fragment_callback(void *user_data, unsigned int min_size, unsigned int *size)
+{
+	struct command_memory *memory = user_data;
+
+	return pool_alloc(&memory->fragment, memory->region, min_size, size);
+}
+
+unsigned int command_memory_required_size(unsigned int vdm_size, unsigned int vertex_size,
+	unsigned int fragment_size, unsigned int region_count)
+{
+	return (ALIGN(vdm_size, COMMAND_MEMORY_ALIGNMENT) +
+		ALIGN(vertex_size, COMMAND_MEMORY_ALIGNMENT) +
+		ALIGN(fragment_size, COMMAND_MEMORY_ALIGNMENT)) * region_count;
+}
+
+void command_memory_init(struct command_memory *memory, void *base, unsigned int vdm_size,
+	unsigned int vertex_size, unsigned int fragment_size, unsigned int region_count)
+{
+	char *addr = base;
+
+	vdm_size = ALIGN(vdm_size, COMMAND_MEMORY_ALIGNMENT);
+	vertex_size = ALIGN(vertex_size, COMMAND_MEMORY_ALIGNMENT);
+	fragment_size = ALIGN(fragment_size, COMMAND_MEMORY_ALIGNMENT);
+
+	memory->region_count = region_count;
+	memory->region = 0;
+
+	pool_init(&memory->vdm, addr, vdm_size);
+	addr += vdm_size * region_count;
+	pool_init(&memory->vertex, addr, vertex_size);
+	addr += vertex_size * region_count;
+	pool_init(&memory->fragment, addr, fragment_size);
+}
+
+void command_memory_next_region(struct command_memory *memory)
+{
+	memory->region = (memory->region + 1) % memory->region_count;
+	memory->vdm.offset = 0;
+	memory->vertex.offset = 0;
+	memory->fragment.offset = 0;
+}
+
+void command_memory_set_deferred_context_params(struct command_memory *memory,
+	SceGxmDeferredContextParams *params)
+{
+	params->vdmCallback = vdm_callback;
+	params->vertexCallback = vertex_callback;
+	params->fragmentCallback = fragment_callback;
+	params->userData = memory;
+}
@@ -0,0 +1,81 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "dynamic_resolution.h"
+#include "time_utils.h"
+
+#define DYNRES_KP 0.3f
+#define DYNRES_KI_DOWN 0.25f
+#define DYNRES_KI_UP 0.05f
+/* Log frame time error treated as on target, about 5% */
+#define DYNRES_DEADBAND 0.05f
+/* Log area added per frame on target, about 20% more pixels a second at 60 fps */
+#define DYNRES_PROBE 0.003f
+
+void dynres_init(struct dynres_controller *controller, float min_scale, float max_scale,
+	float target_ms)
+{
+	memset(controller, 0, sizeof(*controller));
+	controller->min_scale = min_scale;
+	controller->max_scale = max_scale;
+	controller->target_ms = target_ms;
+	controller->log_area = 2.0f * logf(max_scale);
+	controller->scale = max_scale;
+	dynres_reset_stats(controller);
+}
+
+float dynres_update(struct dynres_controller *controller, uint64_t frame_ns)
+{
+	float frame_ms = time_ns_to_ms(frame_ns);
+	float min_log_area = 2.0f * logf(controller->min_scale);
+	float max_log_area = 2.0f * logf(controller->max_scale);
+	float error;
+
+	if (frame_ms > 0.0f) {
+		error = logf(controller->target_ms / frame_ms);
+
+		if (fabsf(error) < DYNRES_DEADBAND) {
+			error = 0.0f;
+			controller->log_area += DYNRES_PROBE;
+		}
+
+		controller->log_area += DYNRES_KP * (error - controller->previous_error) +
+			(error < 0.0f ? DYNRES_KI_DOWN : DYNRES_KI_UP) * error;
+		controller->previous_error = error;
+
+		if (controller->log_area < min_log_area)
+			controller->log_area = min_log_area;
+		if (controller->log_area > max_log_area)
+			controller->log_area = max_log_area;
+
+		controller->scale = expf(0.5f * controller->log_area);
+	}
+
+	controller->frames++;
+	controller->scale_sum += controller->scale;
+	if (controller->scale < controller->scale_min)
+		controller->scale_min = controller->scale;
+	if (controller->scale > controller->scale_max)
+		controller->scale_max = controller->scale;
+
+	return controller->scale;
+}
+
+void dynres_print_stats(const struct dynres_controller *controller, const char *name)
+{
+	float frames = controller->frames ? controller->frames : 1;
+
+	printf("%s resolution: scale %.3f (avg %.3f, min %.3f, max %.3f, target %.2f ms)\n",
+		name, controller->scale, controller->scale_sum / frames,
+		controller->frames ? controller->scale_min : controller->scale,
+		controller->frames ? controller->scale_max : controller->scale,
+		controller->target_ms);
+}
+
+void dynres_reset_stats(struct dynres_controller *controller)
+{
+	controller->frames = 0;
+	controller->scale_sum = 0.0f;
+	controller->scale_min = INFINITY;
+	controller->scale_max = 0.0f;
+}
@@ -0,0 +1,48 @@
+#include <string.h>
+#include "fixed_timestep.h"
+
+void fixed_timestep_init(struct fixed_timestep *timestep, unsigned int steps_per_second,
+	unsigned int max_steps)
+{
+	memset(timestep, 0, sizeof(*timestep));
+	timestep->step_ns = 1000000000ull / (steps_per_second ? steps_per_second : 1);
+	timestep->max_steps = max_steps ? max_steps : 1;
+}
+
+unsigned int fixed_timestep_advance(struct fixed_timestep *timestep, uint64_t now_ns)
+{
+	unsigned int steps;
+
+	/* The first call only starts the clock */
+	if (!timestep->last_ns) {
+		timestep->last_ns = now_ns;
+		return 0;
+	}
+
+	timestep->accumulator_ns += now_ns - timestep->last_ns;
+	timestep->last_ns = now_ns;
+
+	steps = timestep->accumulator_ns / timestep->step_ns;
+	if (steps > timestep->max_steps) {
+		/* Too far behind (e.g. after a hitch), don't try to catch up */
+		uint64_t dropped_ns = (steps - timestep->max_steps) * timestep->step_ns;
+
+		timestep->dropped_ns += dropped_ns;
+		timestep->accumulator_ns -= dropped_ns;
+		steps = timestep->max_steps;
+	}
+
+	timestep->accumulator_ns -= steps * timestep->step_ns;
+
+	return steps;
+}
+
+float fixed_timestep_alpha(const struct fixed_timestep *timestep)
+{
+	return (float)timestep->accumulator_ns / timestep->step_ns;
+}
+
+float fixed_timestep_step_seconds(const struct fixed_timestep *timestep)
+{
+	return timestep->step_ns / 1000000000.0f;
+}
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include "frame_pipeline.h"
+#include "time_utils.h"
+
+/* Empty looks at a queue before sleeping on it */
+#define FRAME_PIPELINE_SPINS 64
+
+static void produce_slot(struct frame_pipeline *pipeline, struct frame_pipeline_slot *slot)
+{
+	uint64_t start = time_get_ns();
+
+	slot->last = !pipeline->produce(pipeline->user_data, slot->snapshot);
+	slot->produce_ns = time_get_ns() - start;
+}
+
+/*
+ * The waiter flags itself before its last look at the queue and the
+ * pusher looks at the flag after pushing, so one of them sees the other.
+ * Returns NULL once the pipeline stops running.
+ */
+static struct frame_pipeline_slot *wait_pop(struct frame_pipeline *pipeline,
+	struct spsc_queue *queue, pthread_cond_t *cond, int *waiting)
+{
+	struct frame_pipeline_slot *slot;
+	unsigned int i;
+
+	for (i = 0; i < FRAME_PIPELINE_SPINS; i++) {
+		if ((slot = spsc_queue_pop(queue)))
+			return slot;
+		if (!__atomic_load_n(&pipeline->running, __ATOMIC_ACQUIRE))
+			return NULL;
+		sched_yield();
+	}
+
+	pthread_mutex_lock(&pipeline->lock);
+	__atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+	while (!(slot = spsc_queue_pop(queue)) &&
+	       __atomic_load_n(&pipeline->running, __ATOMIC_ACQUIRE))
+		pthread_cond_wait(cond, &pipeline->lock);
+	__atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&pipeline->lock);
+
+	return slot;
+}
+
+static void push_wake(struct frame_pipeline *pipeline, struct spsc_queue *queue,
+	pthread_cond_t *cond, int *waiting, struct frame_pipeline_slot *slot)
+{
+	spsc_queue_push(queue, slot);
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(waiting, __ATOMIC_RELAXED))
+		return;
+
+	pthread_mutex_lock(&pipeline->lock);
+	pthread_cond_signal(cond);
+	pthread_mutex_unlock(&pipeline->lock);
+}
+
+static void *simulation_thread(void *arg)
+{
+	struct frame_pipeline *pipeline = arg;
+	struct frame_pipeline_slot *slot;
+	uint64_t wait_start;
+
+	while (__atomic_load_n(&pipeline->running, __ATOMIC_ACQUIRE)) {
+		wait_start = time_get_ns();
+		slot = wait_pop(pipeline, &pipeline->free_queue, &pipeline->free_cond,
+			&pipeline->free_waiting);
+		if (!slot)
+			return NULL;
+		__atomic_add_fetch(&pipeline->simulation_wait_ns,
+			time_get_ns() - wait_start, __ATOMIC_RELAXED);
+
+		produce_slot(pipeline, slot);
+		push_wake(pipeline, &pipeline->ready_queue, &pipeline->ready_cond,
+			&pipeline->ready_waiting, slot);
+
+		if (slot->last)
+			break;
+	}
+
+	return NULL;
+}
+
+int frame_pipeline_init(struct frame_pipeline *pipeline, enum pipeline_mode mode,
+	void *snapshots, unsigned int snapshot_size,
+	frame_pipeline_produce_function produce, void *user_data)
+{
+	unsigned int i;
+
+	memset(pipeline, 0, sizeof(*pipeline));
+	pipeline->mode = mode;
+	pipeline->produce = produce;
+	pipeline->user_data = user_data;
+
+	if (mode == PIPELINE_MODE_OFF)
+		pipeline->slot_count = 1;
+	else if (mode == PIPELINE_MODE_LATENCY)
+		pipeline->slot_count = 2;
+	else
+		pipeline->slot_count = 3;
+
+	spsc_queue_init(&pipeline->ready_queue);
+	spsc_queue_init(&pipeline->free_queue);
+
+	for (i = 0; i < pipeline->slot_count; i++) {
+		pipeline->slots[i].snapshot = (char *)snapshots + i * snapshot_size;
+		spsc_queue_push(&pipeline->free_queue, &pipeline->slots[i]);
+	}
+
+	if (mode == PIPELINE_MODE_OFF)
+		return 0;
+
+	pthread_mutex_init(&pipeline->lock, NULL);
+	pthread_cond_init(&pipeline->ready_cond, NULL);
+	pthread_cond_init(&pipeline->free_cond, NULL);
+
+	pipeline->running = 1;
+	if (pthread_create(&pipeline->thread, NULL, simulation_thread, pipeline) != 0) {
+		/* Keep going without the simulation thread */
+		pthread_cond_destroy(&pipeline->free_cond);
+		pthread_cond_destroy(&pipeline->ready_cond);
+		pthread_mutex_destroy(&pipeline->lock);
+		pipeline->running = 0;
+		pipeline->mode = PIPELINE_MODE_OFF;
+		pipeline->slot_count = 1;
+		spsc_queue_init(&pipeline->free_queue);
+		spsc_queue_push(&pipeline->free_queue, &pipeline->slots[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+void frame_pipeline_finish(struct frame_pipeline *pipeline)
+{
+	if (pipeline->mode == PIPELINE_MODE_OFF)
+		return;
+
+	pthread_mutex_lock(&pipeline->lock);
+	__atomic_store_n(&pipeline->running, 0, __ATOMIC_RELEASE);
+	pthread_cond_signal(&pipeline->free_cond);
+	pthread_mutex_unlock(&pipeline->lock);
+	pthread_join(pipeline->thread, NULL);
+
+	pthread_cond_destroy(&pipeline->free_cond);
+	pthread_cond_destroy(&pipeline->ready_cond);
+	pthread_mutex_destroy(&pipeline->lock);
+}
+
+struct frame_pipeline_slot *frame_pipeline_acquire(struct frame_pipeline *pipeline)
+{
+	struct frame_pipeline_slot *slot;
+	uint64_t start = time_get_ns();
+
+	if (pipeline->mode == PIPELINE_MODE_OFF) {
+		slot = spsc_queue_pop(&pipeline->free_queue);
+		produce_slot(pipeline, slot);
+	} else {
+		slot = wait_pop(pipeline, &pipeline->ready_queue, &pipeline->ready_cond,
+			&pipeline->ready_waiting);
+		pipeline->stats.render_wait_ns += time_get_ns() - start;
+	}
+
+	pipeline->acquire_ns = time_get_ns();
+	if (pipeline->last_acquire_ns)
+		pipeline->stats.frame_ns += start - pipeline->last_acquire_ns;
+	pipeline->last_acquire_ns = start;
+
+	pipeline->stats.simulation_ns += slot->produce_ns;
+
+	return slot;
+}
+
+void frame_pipeline_release(struct frame_pipeline *pipeline, struct frame_pipeline_slot *slot)
+{
+	pipeline->stats.render_ns += time_get_ns() - pipeline->acquire_ns;
+	pipeline->stats.frames++;
+
+	if (pipeline->mode == PIPELINE_MODE_OFF)
+		spsc_queue_push(&pipeline->free_queue, slot);
+	else
+		push_wake(pipeline, &pipeline->free_queue, &pipeline->free_cond,
+			&pipeline->free_waiting, slot);
+}
+
+void frame_pipeline_collect_stats(struct frame_pipeline *pipeline,
+	struct frame_pipeline_stats *stats)
+{
+	*stats = pipeline->stats;
+	stats->simulation_wait_ns = __atomic_exchange_n(&pipeline->simulation_wait_ns,
+		0, __ATOMIC_RELAXED);
+	memset(&pipeline->stats, 0, sizeof(pipeline->stats));
+}
+
+void frame_pipeline_print_stats(const struct frame_pipeline *pipeline,
+	const struct frame_pipeline_stats *stats)
+{
+	float frames = stats->frames ? stats->frames : 1;
+	float simulation_ms = time_ns_to_ms(stats->simulation_ns) / frames;
+	float render_ms = time_ns_to_ms(stats->render_ns) / frames;
+	float frame_ms = time_ns_to_ms(stats->frame_ns) / frames;
+	float shorter_ms = simulation_ms < render_ms ? simulation_ms : render_ms;
+	float overlap = 0.0f;
+
+	/*
+	 * 0% means the stages ran back to back (frame = sim + render),
+	 * 100% means the shorter stage was completely hidden behind the
+	 * longer one (frame = max(sim, render)).
+	 */
+	if (shorter_ms > 0.0f)
+		overlap = (simulation_ms + render_ms - frame_ms) / shorter_ms;
+	if (overlap < 0.0f)
+		overlap = 0.0f;
+	if (overlap > 1.0f)
+		overlap = 1.0f;
+
+	printf("pipeline %s: %u frames, frame %.3f ms, sim %.3f ms, render %.3f ms, "
+		"render wait %.3f ms, sim wait %.3f ms, overlap %.0f%%\n",
+		pipeline_mode_name(pipeline->mode), stats->frames, frame_ms,
+		simulation_ms, render_ms,
+		time_ns_to_ms(stats->render_wait_ns) / frames,
+		time_ns_to_ms(stats->simulation_wait_ns) / frames,
+		overlap * 100.0f);
+}
+
+const char *pipeline_mode_name(enum pipeline_mode mode)
+{
+	switch (mode) {
+	case PIPELINE_MODE_LATENCY:
+		return "latency";
+	case PIPELINE_MODE_THROUGHPUT:
+		return "throughput";
+	default:
+		return "off";
+	}
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <string.h>
+#include "frame_stats.h"
+#include "time_utils.h"
+
+void frame_stats_init(struct frame_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->min_frame_ns = UINT64_MAX;
+}
+
+void frame_stats_begin_frame(struct frame_stats *stats, uint64_t now_ns)
+{
+	if (stats->last_frame_start_ns) {
+		uint64_t frame_ns = now_ns - stats->last_frame_start_ns;
+
+		stats->frames++;
+		stats->frame_ns += frame_ns;
+		if (frame_ns < stats->min_frame_ns)
+			stats->min_frame_ns = frame_ns;
+		if (frame_ns > stats->max_frame_ns)
+			stats->max_frame_ns = frame_ns;
+	}
+
+	stats->last_frame_start_ns = now_ns;
+}
+
+void frame_stats_add_stall(struct frame_stats *stats, uint64_t stall_ns)
+{
+	stats->stall_ns += stall_ns;
+	if (stall_ns > stats->max_stall_ns)
+		stats->max_stall_ns = stall_ns;
+}
+
+void frame_stats_print(const struct frame_stats *stats)
+{
+	float frames = stats->frames ? stats->frames : 1;
+	float frame_ms = time_ns_to_ms(stats->frame_ns) / frames;
+
+	printf("frames %u: frame %.3f ms (min %.3f, max %.3f, %.1f fps), "
+		"stall %.3f ms (max %.3f)\n",
+		stats->frames, frame_ms,
+		stats->frames ? time_ns_to_ms(stats->min_frame_ns) : 0.0f,
+		time_ns_to_ms(stats->max_frame_ns),
+		frame_ms > 0.0f ? 1000.0f / frame_ms : 0.0f,
+		time_ns_to_ms(stats->stall_ns) / frames,
+		time_ns_to_ms(stats->max_stall_ns));
+}
+
+void frame_stats_reset(struct frame_stats *stats)
+{
+	uint64_t last_frame_start_ns = stats->last_frame_start_ns;
+
+	frame_stats_init(stats);
+	stats->last_frame_start_ns = last_frame_start_ns;
+}
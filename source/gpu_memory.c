@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpu_memory.h"
+
+#define ALIGN(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
+
+enum block_mapping {
+	BLOCK_MAPPING_GPU,
+	BLOCK_MAPPING_VERTEX_USSE,
+	BLOCK_MAPPING_FRAGMENT_USSE
+};
+
+struct block {
+	SceUID uid;
+	enum gpu_memory_category category;
+	enum block_mapping mapping;
+	int cdram;
+	size_t requested;
+	size_t size;
+};
+
+static struct {
+	struct block *blocks;
+	unsigned int block_count;
+	unsigned int block_capacity;
+	struct gpu_memory_stats stats;
+} memory;
+
+static const char *const category_names[GPU_MEMORY_CATEGORY_COUNT] = {
+	[GPU_MEMORY_RING_BUFFERS] = "ring buffers",
+	[GPU_MEMORY_SURFACES] = "surfaces",
+	[GPU_MEMORY_SHADER_PATCHER] = "shader patcher",
+	[GPU_MEMORY_MESHES] = "meshes",
+	[GPU_MEMORY_TEXTURES] = "textures",
+	[GPU_MEMORY_COMMAND_LISTS] = "command lists"
+};
+
+const char *gpu_memory_category_name(enum gpu_memory_category category)
+{
+	return category < GPU_MEMORY_CATEGORY_COUNT ? category_names[category] : "unknown";
+}
+
+static void usage_add(struct gpu_memory_usage *usage, const struct block *block)
+{
+	usage->blocks++;
+	usage->live += block->size;
+	usage->requested += block->requested;
+	if (usage->live > usage->peak)
+		usage->peak = usage->live;
+}
+
+static void usage_remove(struct gpu_memory_usage *usage, const struct block *block)
+{
+	usage->blocks--;
+	usage->live -= block->size;
+	usage->requested -= block->requested;
+}
+
+static int track_block(const struct block *block)
+{
+	if (memory.block_count == memory.block_capacity) {
+		unsigned int capacity = memory.block_capacity ? memory.block_capacity * 2 : 32;
+		struct block *blocks = realloc(memory.blocks, capacity * sizeof(*blocks));
+
+		if (!blocks)
+			return -1;
+		memory.blocks = blocks;
+		memory.block_capacity = capacity;
+	}
+
+	memory.blocks[memory.block_count++] = *block;
+
+	usage_add(&memory.stats.categories[block->category], block);
+	usage_add(&memory.stats.total, block);
+	if (block->cdram)
+		usage_add(&memory.stats.cdram, block);
+
+	return 0;
+}
+
+/* Returns 0 and fills block if uid was allocated here with the mapping */
+static int untrack_block(SceUID uid, enum block_mapping mapping, struct block *block)
+{
+	unsigned int i;
+
+	for (i = 0; i < memory.block_count; i++) {
+		if (memory.blocks[i].uid != uid || memory.blocks[i].mapping != mapping)
+			continue;
+
+		*block = memory.blocks[i];
+		memory.blocks[i] = memory.blocks[--memory.block_count];
+
+		usage_remove(&memory.stats.categories[block->category], block);
+		usage_remove(&memory.stats.total, block);
+		if (block->cdram)
+			usage_remove(&memory.stats.cdram, block);
+
+		return 0;
+	}
+
+	return -1;
+}
+
+static void *alloc_map(enum gpu_memory_category category, enum block_mapping mapping,
+	SceKernelMemBlockType type, SceGxmMemoryAttribFlags gpu_attrib, size_t size,
+	SceUID *uid, unsigned int *usse_offset)
+{
+	struct block block;
+	void *addr;
+	int err;
+
+	if (category >= GPU_MEMORY_CATEGORY_COUNT)
+		return NULL;
+
+	block.category = category;
+	block.mapping = mapping;
+	block.cdram = type == SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW;
+	block.requested = size;
+
+	if (block.cdram)
+		block.size = ALIGN(size, 256 * 1024);
+	else
+		block.size = ALIGN(size, 4 * 1024);
+
+	block.uid = sceKernelAllocMemBlock(category_names[category], type, block.size, NULL);
+	if (block.uid < 0)
+		return NULL;
+
+	if (sceKernelGetMemBlockBase(block.uid, &addr) < 0) {
+		sceKernelFreeMemBlock(block.uid);
+		return NULL;
+	}
+
+	switch (mapping) {
+	case BLOCK_MAPPING_VERTEX_USSE:
+		err = sceGxmMapVertexUsseMemory(addr, block.size, usse_offset);
+		break;
+	case BLOCK_MAPPING_FRAGMENT_USSE:
+		err = sceGxmMapFragmentUsseMemory(addr, block.size, usse_offset);
+		break;
+	default:
+		err = sceGxmMapMemory(addr, block.size, gpu_attrib);
+		break;
+	}
+
+	if (err < 0) {
+		sceKernelFreeMemBlock(block.uid);
+		return NULL;
+	}
+
+	if (track_block(&block) < 0) {
+		if (mapping == BLOCK_MAPPING_VERTEX_USSE)
+			sceGxmUnmapVertexUsseMemory(addr);
+		else if (mapping == BLOCK_MAPPING_FRAGMENT_USSE)
+			sceGxmUnmapFragmentUsseMemory(addr);
+		else
+			sceGxmUnmapMemory(addr);
+		sceKernelFreeMemBlock(block.uid);
+		return NULL;
+	}
+
+	if (uid)
+		*uid = block.uid;
+
+	return addr;
+}
+
+static void unmap_free(SceUID uid, enum block_mapping mapping)
+{
+	struct block block;
+	void *addr;
+
+	if (sceKernelGetMemBlockBase(uid, &addr) < 0)
+		return;
+
+	if (untrack_block(uid, mapping, &block) < 0)
+		fprintf(stderr, "gpu memory: freeing untracked block %d\n", (int)uid);
+
+	if (mapping == BLOCK_MAPPING_VERTEX_USSE)
+		sceGxmUnmapVertexUsseMemory(addr);
+	else if (mapping == BLOCK_MAPPING_FRAGMENT_USSE)
+		sceGxmUnmapFragmentUsseMemory(addr);
+	else
+		sceGxmUnmapMemory(addr);
+
+	sceKernelFreeMemBlock(uid);
+}
+
+void *gpu_alloc_map(enum gpu_memory_category category, SceKernelMemBlockType type,
+	SceGxmMemoryAttribFlags gpu_attrib, size_t size, SceUID *uid)
+{
+	return alloc_map(category, BLOCK_MAPPING_GPU, type, gpu_attrib, size, uid, NULL);
+}
+
+void gpu_unmap_free(SceUID uid)
+{
+	unmap_free(uid, BLOCK_MAPPING_GPU);
+}
+
+void *gpu_vertex_usse_alloc_map(enum gpu_memory_category category, size_t size, SceUID *uid,
+	unsigned int *usse_offset)
+{
+	return alloc_map(category, BLOCK_MAPPING_VERTEX_USSE,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, 0, size, uid, usse_offset);
+}
+
+void gpu_vertex_usse_unmap_free(SceUID uid)
+{
+	unmap_free(uid, BLOCK_MAPPING_VERTEX_USSE);
+}
+
+void *gpu_fragment_usse_alloc_map(enum gpu_memory_category category, size_t size, SceUID *uid,
+	unsigned int *usse_offset)
+{
+	return alloc_map(category, BLOCK_MAPPING_FRAGMENT_USSE,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, 0, size, uid, usse_offset);
+}
+
+void gpu_fragment_usse_unmap_free(SceUID uid)
+{
+	unmap_free(uid, BLOCK_MAPPING_FRAGMENT_USSE);
+}
+
+void gpu_memory_get_stats(struct gpu_memory_stats *stats)
+{
+	*stats = memory.stats;
+}
+
+static void print_usage(const char *name, const struct gpu_memory_usage *usage)
+{
+	printf("  %-16s %3u blocks, live %8.1f KB, peak %8.1f KB, waste %7.1f KB\n", name,
+		usage->blocks, usage->live / 1024.0f, usage->peak / 1024.0f,
+		(usage->live - usage->requested) / 1024.0f);
+}
+
+void gpu_memory_print_stats(const struct gpu_memory_stats *stats)
+{
+	unsigned int i;
+
+	printf("gpu memory:\n");
+	for (i = 0; i < GPU_MEMORY_CATEGORY_COUNT; i++)
+		print_usage(category_names[i], &stats->categories[i]);
+	print_usage("total", &stats->total);
+	print_usage("cdram", &stats->cdram);
+}
+
+unsigned int gpu_memory_report_leaks(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < memory.block_count; i++) {
+		const struct block *block = &memory.blocks[i];
+
+		printf("gpu memory: leaked %s block %d, %zu bytes (%zu requested)\n",
+			category_names[block->category], (int)block->uid, block->size,
+			block->requested);
+	}
+
+	return memory.block_count;
+}
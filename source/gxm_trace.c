@@ -0,0 +1,1091 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#define GXM_TRACE_NO_INTERPOSE
+#include "gxm_trace.h"
+#include "gxm_trace_format.h"
+
+/*
+ * Every context records into its own buffer, so deferred contexts can be
+ * traced from any thread. Buffers are written to the file by the thread
+ * owning the immediate context: its own buffer at the end of each scene,
+ * and a command list's buffer when the list is executed. Draws and
+ * textures keep pointers to their index, vertex and texel data until then,
+ * and are turned into blob references as they are written.
+ */
+
+#define TRACE_MAX_CONTEXTS 8
+#define TRACE_MAX_PROGRAMS 32
+#define TRACE_MAX_RENDER_TARGETS 8
+#define TRACE_MAX_SURFACES 16
+
+/* Only found in context buffers, written as GXM_TRACE_DRAW */
+#define TRACE_PENDING_DRAW GXM_TRACE_RECORD_TYPE_COUNT
+/* Written as GXM_TRACE_SET_FRAGMENT_TEXTURE */
+#define TRACE_PENDING_TEXTURE (GXM_TRACE_RECORD_TYPE_COUNT + 1)
+
+#define NO_BLOB 0xFFFFFFFF
+#define NO_SURFACE 0xFFFFFFFF
+
+struct trace_buffer {
+	char *data;
+	size_t size;
+	size_t capacity;
+};
+
+struct pending_draw {
+	struct gxm_trace_draw draw;
+	const void *indices;
+	uint32_t index_size;
+	uint32_t stream_count;
+	const void *streams[GXM_TRACE_MAX_STREAMS];
+	uint32_t stream_sizes[GXM_TRACE_MAX_STREAMS];
+};
+
+struct pending_texture {
+	struct gxm_trace_texture texture;
+	const void *data;
+	uint32_t size;
+};
+
+struct traced_vertex_program {
+	const SceGxmVertexProgram *program;
+	const SceGxmProgram *gxp;
+	uint32_t id;
+	unsigned int stream_count;
+	SceGxmVertexStream streams[GXM_TRACE_MAX_STREAMS];
+};
+
+struct traced_fragment_program {
+	const SceGxmFragmentProgram *program;
+	const SceGxmProgram *gxp;
+	uint32_t id;
+};
+
+struct traced_render_target {
+	const SceGxmRenderTarget *render_target;
+	unsigned int width;
+	unsigned int height;
+};
+
+/* The id of a surface is its index */
+struct traced_surface {
+	const char *data;
+	size_t size;
+};
+
+struct traced_context {
+	SceGxmContext *context;
+	int deferred;
+	struct trace_buffer buffer;
+	const struct traced_vertex_program *vertex_program;
+	const struct traced_fragment_program *fragment_program;
+	const void *streams[GXM_TRACE_MAX_STREAMS];
+	/* Last reserved default uniform buffers, to route sceGxmSetUniformDataF */
+	void *vertex_uniforms;
+	void *fragment_uniforms;
+	/* Command list recorded in buffer */
+	const SceGxmCommandList *command_list;
+};
+
+struct blob_entry {
+	uint64_t hash;
+	uint32_t size;
+	/* id + 1, 0 for a free entry */
+	uint32_t id;
+	/* Copy of the content, to tell hash collisions apart */
+	void *data;
+};
+
+static struct {
+	FILE *file;
+	pthread_mutex_t lock;
+	struct traced_context contexts[TRACE_MAX_CONTEXTS];
+	unsigned int context_count;
+	struct traced_vertex_program vertex_programs[TRACE_MAX_PROGRAMS];
+	unsigned int vertex_program_count;
+	struct traced_fragment_program fragment_programs[TRACE_MAX_PROGRAMS];
+	unsigned int fragment_program_count;
+	struct traced_render_target render_targets[TRACE_MAX_RENDER_TARGETS];
+	unsigned int render_target_count;
+	struct traced_surface surfaces[TRACE_MAX_SURFACES];
+	unsigned int surface_count;
+	struct blob_entry *blobs;
+	unsigned int blob_count;
+	unsigned int blob_capacity;
+	/* Blobs bound to the vertex streams as written to the file */
+	uint32_t stream_blobs[GXM_TRACE_MAX_STREAMS];
+	uint32_t frame;
+	uint64_t bytes;
+	uint64_t blob_bytes;
+	int failed;
+} trace = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static size_t padded_size(size_t size)
+{
+	return (size + GXM_TRACE_ALIGNMENT - 1) & ~(size_t)(GXM_TRACE_ALIGNMENT - 1);
+}
+
+static void write_record(uint32_t type, const void *payload, size_t size,
+	const void *data, size_t data_size)
+{
+	static const char padding[GXM_TRACE_ALIGNMENT];
+	struct gxm_trace_record record;
+
+	record.type = type;
+	record.size = padded_size(size + data_size);
+
+	if (fwrite(&record, sizeof(record), 1, trace.file) != 1 ||
+	    (size && fwrite(payload, size, 1, trace.file) != 1) ||
+	    (data_size && fwrite(data, data_size, 1, trace.file) != 1) ||
+	    (record.size > size + data_size &&
+	     fwrite(padding, record.size - size - data_size, 1, trace.file) != 1))
+		trace.failed = 1;
+
+	trace.bytes += sizeof(record) + record.size;
+}
+
+/* FNV-1a */
+static uint64_t hash_data(const void *data, size_t size)
+{
+	const unsigned char *bytes = data;
+	uint64_t hash = 0xcbf29ce484222325ull;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static int grow_blob_table(void)
+{
+	unsigned int capacity = trace.blob_capacity ? trace.blob_capacity * 2 : 256;
+	struct blob_entry *blobs = calloc(capacity, sizeof(*blobs));
+	unsigned int i, j;
+
+	if (!blobs)
+		return -1;
+
+	for (i = 0; i < trace.blob_capacity; i++) {
+		if (!trace.blobs[i].id)
+			continue;
+		j = trace.blobs[i].hash & (capacity - 1);
+		while (blobs[j].id)
+			j = (j + 1) & (capacity - 1);
+		blobs[j] = trace.blobs[i];
+	}
+
+	free(trace.blobs);
+	trace.blobs = blobs;
+	trace.blob_capacity = capacity;
+
+	return 0;
+}
+
+/* Id of the blob with this content, written to the file the first time */
+static uint32_t blob_id(const void *data, uint32_t size)
+{
+	uint64_t hash = hash_data(data, size);
+	struct gxm_trace_blob blob;
+	unsigned int i;
+
+	if (trace.blob_count * 2 >= trace.blob_capacity && grow_blob_table() < 0) {
+		trace.failed = 1;
+		return NO_BLOB;
+	}
+
+	i = hash & (trace.blob_capacity - 1);
+	while (trace.blobs[i].id) {
+		if (trace.blobs[i].hash == hash && trace.blobs[i].size == size &&
+		    memcmp(trace.blobs[i].data, data, size) == 0)
+			return trace.blobs[i].id - 1;
+		i = (i + 1) & (trace.blob_capacity - 1);
+	}
+
+	/* The data may change or go away after this call */
+	trace.blobs[i].data = malloc(size ? size : 1);
+	if (!trace.blobs[i].data) {
+		trace.failed = 1;
+		return NO_BLOB;
+	}
+	memcpy(trace.blobs[i].data, data, size);
+
+	blob.id = trace.blob_count++;
+	blob.size = size;
+	blob.hash = hash;
+	trace.blobs[i].hash = hash;
+	trace.blobs[i].size = size;
+	trace.blobs[i].id = blob.id + 1;
+
+	write_record(GXM_TRACE_BLOB, &blob, sizeof(blob), data, size);
+	trace.blob_bytes += size;
+
+	return blob.id;
+}
+
+static void reset_stream_blobs(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < GXM_TRACE_MAX_STREAMS; i++)
+		trace.stream_blobs[i] = NO_BLOB;
+}
+
+static void write_pending_draw(const struct pending_draw *pending)
+{
+	struct gxm_trace_draw draw = pending->draw;
+	unsigned int i;
+
+	draw.index_blob = blob_id(pending->indices, pending->index_size);
+
+	for (i = 0; i < pending->stream_count; i++) {
+		struct gxm_trace_vertex_stream stream;
+
+		if (!pending->streams[i])
+			continue;
+
+		stream.index = i;
+		stream.blob = blob_id(pending->streams[i], pending->stream_sizes[i]);
+		if (stream.blob == trace.stream_blobs[i])
+			continue;
+
+		write_record(GXM_TRACE_SET_VERTEX_STREAM, &stream, sizeof(stream), NULL, 0);
+		trace.stream_blobs[i] = stream.blob;
+	}
+
+	write_record(GXM_TRACE_DRAW, &draw, sizeof(draw), NULL, 0);
+}
+
+static void write_pending_texture(const struct pending_texture *pending)
+{
+	struct gxm_trace_texture texture = pending->texture;
+
+	texture.blob = blob_id(pending->data, pending->size);
+	write_record(GXM_TRACE_SET_FRAGMENT_TEXTURE, &texture, sizeof(texture), NULL, 0);
+}
+
+/* Must be called with trace.lock held */
+static void write_buffer(const struct trace_buffer *buffer)
+{
+	size_t offset = 0;
+
+	while (offset < buffer->size) {
+		const struct gxm_trace_record *record =
+			(const struct gxm_trace_record *)(buffer->data + offset);
+		const void *payload = record + 1;
+
+		switch (record->type) {
+		case TRACE_PENDING_DRAW:
+			write_pending_draw(payload);
+			break;
+		case TRACE_PENDING_TEXTURE:
+			write_pending_texture(payload);
+			break;
+		case GXM_TRACE_BEGIN_SCENE:
+		case GXM_TRACE_BEGIN_COMMAND_LIST:
+		case GXM_TRACE_END_COMMAND_LIST:
+			reset_stream_blobs();
+			/* fallthrough */
+		default:
+			write_record(record->type, payload, record->size, NULL, 0);
+			break;
+		}
+
+		offset += sizeof(*record) + record->size;
+	}
+}
+
+/* Must be called with trace.lock held */
+static void flush_immediate_contexts(void)
+{
+	unsigned int count = __atomic_load_n(&trace.context_count, __ATOMIC_ACQUIRE);
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		struct traced_context *traced = &trace.contexts[i];
+
+		if (traced->deferred)
+			continue;
+
+		write_buffer(&traced->buffer);
+		traced->buffer.size = 0;
+	}
+}
+
+static void *buffer_append(struct trace_buffer *buffer, uint32_t type, size_t size)
+{
+	size_t total = sizeof(struct gxm_trace_record) + padded_size(size);
+	struct gxm_trace_record *record;
+
+	if (buffer->size + total > buffer->capacity) {
+		size_t capacity = buffer->capacity ? buffer->capacity * 2 : 64 * 1024;
+		char *data;
+
+		while (capacity < buffer->size + total)
+			capacity *= 2;
+
+		data = realloc(buffer->data, capacity);
+		if (!data) {
+			trace.failed = 1;
+			return NULL;
+		}
+		buffer->data = data;
+		buffer->capacity = capacity;
+	}
+
+	record = (struct gxm_trace_record *)(buffer->data + buffer->size);
+	record->type = type;
+	record->size = padded_size(size);
+	memset(record + 1, 0, record->size);
+	buffer->size += total;
+
+	return record + 1;
+}
+
+static struct traced_context *get_context(SceGxmContext *context)
+{
+	unsigned int count = __atomic_load_n(&trace.context_count, __ATOMIC_ACQUIRE);
+	struct traced_context *traced = NULL;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (trace.contexts[i].context == context)
+			return &trace.contexts[i];
+	}
+
+	pthread_mutex_lock(&trace.lock);
+
+	count = trace.context_count;
+	for (i = 0; i < count; i++) {
+		if (trace.contexts[i].context == context)
+			traced = &trace.contexts[i];
+	}
+
+	if (!traced && count < TRACE_MAX_CONTEXTS) {
+		traced = &trace.contexts[count];
+		memset(traced, 0, sizeof(*traced));
+		traced->context = context;
+		__atomic_store_n(&trace.context_count, count + 1, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&trace.lock);
+
+	return traced;
+}
+
+static void *context_append(SceGxmContext *context, uint32_t type, size_t size)
+{
+	struct traced_context *traced = get_context(context);
+
+	return traced ? buffer_append(&traced->buffer, type, size) : NULL;
+}
+
+static unsigned int color_format_size(SceGxmColorFormat format)
+{
+	return format == SCE_GXM_COLOR_FORMAT_U5U6U5_RGB ? 2 : 4;
+}
+
+/* Bytes of a texture's texels, every level of a swizzled one, 0 if unknown */
+static size_t texture_data_size(const SceGxmTexture *texture)
+{
+	SceGxmTextureFormat format = sceGxmTextureGetFormat(texture);
+	unsigned int width = sceGxmTextureGetWidth(texture);
+	unsigned int height = sceGxmTextureGetHeight(texture);
+	unsigned int levels = sceGxmTextureGetMipmapCount(texture);
+	unsigned int texel_size = 0, block_size = 0, i;
+	size_t size = 0;
+
+	switch (format) {
+	case SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR:
+		texel_size = 4;
+		break;
+	case SCE_GXM_TEXTURE_FORMAT_U5U6U5_RGB:
+		texel_size = 2;
+		break;
+	case SCE_GXM_TEXTURE_FORMAT_UBC1_ABGR:
+		block_size = 8;
+		break;
+	case SCE_GXM_TEXTURE_FORMAT_UBC3_ABGR:
+		block_size = 16;
+		break;
+	default:
+		return 0;
+	}
+
+	if (sceGxmTextureGetType(texture) != SCE_GXM_TEXTURE_SWIZZLED)
+		return (size_t)sceGxmTextureGetStride(texture) * height;
+
+	for (i = 0; i < levels; i++) {
+		if (block_size)
+			size += (size_t)((width + 3) / 4) * ((height + 3) / 4) * block_size;
+		else
+			size += (size_t)width * height * texel_size;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	return size;
+}
+
+/* Must be called with trace.lock held */
+static uint32_t surface_id(const void *data, size_t size)
+{
+	unsigned int i;
+
+	for (i = 0; i < trace.surface_count; i++) {
+		if (trace.surfaces[i].data == data)
+			break;
+	}
+	if (i == TRACE_MAX_SURFACES)
+		return NO_SURFACE;
+	if (i == trace.surface_count)
+		trace.surface_count++;
+
+	trace.surfaces[i].data = data;
+	if (size > trace.surfaces[i].size)
+		trace.surfaces[i].size = size;
+
+	return i;
+}
+
+/* Must be called with trace.lock held */
+static uint32_t find_surface(const void *data, uint32_t *offset)
+{
+	unsigned int i;
+
+	for (i = 0; i < trace.surface_count; i++) {
+		const struct traced_surface *surface = &trace.surfaces[i];
+
+		if ((const char *)data >= surface->data &&
+		    (const char *)data < surface->data + surface->size) {
+			*offset = (const char *)data - surface->data;
+			return i;
+		}
+	}
+
+	return NO_SURFACE;
+}
+
+static const struct traced_vertex_program *find_vertex_program(const SceGxmVertexProgram *program)
+{
+	unsigned int i;
+
+	for (i = 0; i < trace.vertex_program_count; i++) {
+		if (trace.vertex_programs[i].program == program)
+			return &trace.vertex_programs[i];
+	}
+
+	return NULL;
+}
+
+static const struct traced_fragment_program *find_fragment_program(
+	const SceGxmFragmentProgram *program)
+{
+	unsigned int i;
+
+	for (i = 0; i < trace.fragment_program_count; i++) {
+		if (trace.fragment_programs[i].program == program)
+			return &trace.fragment_programs[i];
+	}
+
+	return NULL;
+}
+
+int gxm_trace_begin(const char *path)
+{
+	struct gxm_trace_header header;
+
+	if (trace.file)
+		return -1;
+
+	trace.file = fopen(path, "wb");
+	if (!trace.file)
+		return -1;
+
+	memcpy(header.magic, GXM_TRACE_MAGIC, sizeof(header.magic));
+	header.version = GXM_TRACE_VERSION;
+	fwrite(&header, sizeof(header), 1, trace.file);
+
+	trace.bytes = sizeof(header);
+	trace.frame = 0;
+	trace.failed = 0;
+	reset_stream_blobs();
+
+	return 0;
+}
+
+void gxm_trace_end(void)
+{
+	unsigned int i;
+
+	if (!trace.file)
+		return;
+
+	pthread_mutex_lock(&trace.lock);
+	flush_immediate_contexts();
+	pthread_mutex_unlock(&trace.lock);
+
+	if (fclose(trace.file) != 0)
+		trace.failed = 1;
+	trace.file = NULL;
+
+	printf("trace: %u frames, %u blobs (%.1f KB), %.1f KB written%s\n", trace.frame,
+		trace.blob_count, trace.blob_bytes / 1024.0f, trace.bytes / 1024.0f,
+		trace.failed ? ", incomplete (write or allocation failed)" : "");
+
+	for (i = 0; i < trace.context_count; i++)
+		free(trace.contexts[i].buffer.data);
+	for (i = 0; i < trace.blob_capacity; i++)
+		free(trace.blobs[i].data);
+	free(trace.blobs);
+	trace.blobs = NULL;
+	trace.blob_count = 0;
+	trace.blob_capacity = 0;
+	trace.context_count = 0;
+	trace.vertex_program_count = 0;
+	trace.fragment_program_count = 0;
+	trace.render_target_count = 0;
+	trace.surface_count = 0;
+	memset(trace.surfaces, 0, sizeof(trace.surfaces));
+}
+
+int gxm_trace_create_render_target(const SceGxmRenderTargetParams *params,
+	SceGxmRenderTarget **renderTarget)
+{
+	int ret = sceGxmCreateRenderTarget(params, renderTarget);
+	struct traced_render_target *traced;
+
+	if (ret < 0 || !trace.file || trace.render_target_count == TRACE_MAX_RENDER_TARGETS)
+		return ret;
+
+	traced = &trace.render_targets[trace.render_target_count++];
+	traced->render_target = *renderTarget;
+	traced->width = params->width;
+	traced->height = params->height;
+
+	return ret;
+}
+
+int gxm_trace_create_vertex_program(SceGxmShaderPatcher *shaderPatcher,
+	SceGxmShaderPatcherId programId, const SceGxmVertexAttribute *attributes,
+	unsigned int attributeCount, const SceGxmVertexStream *streams, unsigned int streamCount,
+	SceGxmVertexProgram **vertexProgram)
+{
+	int ret = sceGxmShaderPatcherCreateVertexProgram(shaderPatcher, programId,
+		attributes, attributeCount, streams, streamCount, vertexProgram);
+	struct gxm_trace_vertex_program record;
+	struct traced_vertex_program *traced;
+	unsigned int i;
+
+	if (ret < 0 || !trace.file || trace.vertex_program_count == TRACE_MAX_PROGRAMS ||
+	    attributeCount > GXM_TRACE_MAX_ATTRIBUTES || streamCount > GXM_TRACE_MAX_STREAMS)
+		return ret;
+
+	traced = &trace.vertex_programs[trace.vertex_program_count];
+	traced->program = *vertexProgram;
+	traced->gxp = sceGxmShaderPatcherGetProgramFromId(programId);
+	traced->id = trace.vertex_program_count;
+	traced->stream_count = streamCount;
+	memcpy(traced->streams, streams, streamCount * sizeof(*streams));
+
+	memset(&record, 0, sizeof(record));
+	record.id = traced->id;
+	record.attribute_count = attributeCount;
+	record.stream_count = streamCount;
+	for (i = 0; i < attributeCount; i++) {
+		record.attributes[i].stream_index = attributes[i].streamIndex;
+		record.attributes[i].offset = attributes[i].offset;
+		record.attributes[i].format = attributes[i].format;
+		record.attributes[i].component_count = attributes[i].componentCount;
+		record.attributes[i].reg_index = attributes[i].regIndex;
+	}
+	for (i = 0; i < streamCount; i++) {
+		record.streams[i].stride = streams[i].stride;
+		record.streams[i].index_source = streams[i].indexSource;
+	}
+
+	pthread_mutex_lock(&trace.lock);
+	flush_immediate_contexts();
+	record.program_blob = blob_id(traced->gxp, sceGxmProgramGetSize(traced->gxp));
+	write_record(GXM_TRACE_VERTEX_PROGRAM, &record, sizeof(record), NULL, 0);
+	pthread_mutex_unlock(&trace.lock);
+
+	trace.vertex_program_count++;
+
+	return ret;
+}
+
+int gxm_trace_create_fragment_program(SceGxmShaderPatcher *shaderPatcher,
+	SceGxmShaderPatcherId programId, SceGxmOutputRegisterFormat outputFormat,
+	SceGxmMultisampleMode multisampleMode, const SceGxmBlendInfo *blendInfo,
+	const SceGxmProgram *vertexProgram, SceGxmFragmentProgram **fragmentProgram)
+{
+	int ret = sceGxmShaderPatcherCreateFragmentProgram(shaderPatcher, programId,
+		outputFormat, multisampleMode, blendInfo, vertexProgram, fragmentProgram);
+	struct gxm_trace_fragment_program record;
+	struct traced_fragment_program *traced;
+
+	if (ret < 0 || !trace.file || trace.fragment_program_count == TRACE_MAX_PROGRAMS)
+		return ret;
+
+	traced = &trace.fragment_programs[trace.fragment_program_count];
+	traced->program = *fragmentProgram;
+	traced->gxp = sceGxmShaderPatcherGetProgramFromId(programId);
+	traced->id = trace.fragment_program_count;
+
+	memset(&record, 0, sizeof(record));
+	record.id = traced->id;
+	record.output_format = outputFormat;
+	record.multisample_mode = multisampleMode;
+	if (blendInfo) {
+		record.has_blend = 1;
+		record.blend.color_mask = blendInfo->colorMask;
+		record.blend.color_func = blendInfo->colorFunc;
+		record.blend.alpha_func = blendInfo->alphaFunc;
+		record.blend.color_src = blendInfo->colorSrc;
+		record.blend.color_dst = blendInfo->colorDst;
+		record.blend.alpha_src = blendInfo->alphaSrc;
+		record.blend.alpha_dst = blendInfo->alphaDst;
+	}
+
+	pthread_mutex_lock(&trace.lock);
+	flush_immediate_contexts();
+	record.program_blob = blob_id(traced->gxp, sceGxmProgramGetSize(traced->gxp));
+	write_record(GXM_TRACE_FRAGMENT_PROGRAM, &record, sizeof(record), NULL, 0);
+	pthread_mutex_unlock(&trace.lock);
+
+	trace.fragment_program_count++;
+
+	return ret;
+}
+
+int gxm_trace_begin_scene(SceGxmContext *context, unsigned int flags,
+	const SceGxmRenderTarget *renderTarget, const SceGxmValidRegion *validRegion,
+	SceGxmSyncObject *vertexSyncObject, SceGxmSyncObject *fragmentSyncObject,
+	const SceGxmColorSurface *colorSurface, const SceGxmDepthStencilSurface *depthStencil)
+{
+	int ret = sceGxmBeginScene(context, flags, renderTarget, validRegion,
+		vertexSyncObject, fragmentSyncObject, colorSurface, depthStencil);
+	struct gxm_trace_begin_scene *record;
+	unsigned int i;
+
+	if (ret < 0 || !trace.file)
+		return ret;
+
+	record = context_append(context, GXM_TRACE_BEGIN_SCENE, sizeof(*record));
+	if (!record)
+		return ret;
+
+	record->flags = flags;
+	for (i = 0; i < trace.render_target_count; i++) {
+		if (trace.render_targets[i].render_target == renderTarget) {
+			record->width = trace.render_targets[i].width;
+			record->height = trace.render_targets[i].height;
+		}
+	}
+
+	record->color_format = sceGxmColorSurfaceGetFormat(colorSurface);
+	record->stride = sceGxmColorSurfaceGetStrideInPixels(colorSurface);
+	record->depth_stencil = depthStencil != NULL;
+	if (validRegion) {
+		record->x_min = validRegion->xMin;
+		record->y_min = validRegion->yMin;
+		record->x_max = validRegion->xMax;
+		record->y_max = validRegion->yMax;
+	} else {
+		record->x_max = record->width - 1;
+		record->y_max = record->height - 1;
+	}
+
+	pthread_mutex_lock(&trace.lock);
+	record->surface = surface_id(sceGxmColorSurfaceGetData(colorSurface),
+		(size_t)record->stride * record->height * color_format_size(record->color_format));
+	pthread_mutex_unlock(&trace.lock);
+
+	return ret;
+}
+
+int gxm_trace_end_scene(SceGxmContext *context, const SceGxmNotification *vertexNotification,
+	const SceGxmNotification *fragmentNotification)
+{
+	int ret = sceGxmEndScene(context, vertexNotification, fragmentNotification);
+
+	if (ret < 0 || !trace.file || !context_append(context, GXM_TRACE_END_SCENE, 0))
+		return ret;
+
+	pthread_mutex_lock(&trace.lock);
+	flush_immediate_contexts();
+	pthread_mutex_unlock(&trace.lock);
+
+	return ret;
+}
+
+int gxm_trace_begin_command_list(SceGxmContext *deferredContext)
+{
+	int ret = sceGxmBeginCommandList(deferredContext);
+	struct traced_context *traced;
+
+	if (ret < 0 || !trace.file || !(traced = get_context(deferredContext)))
+		return ret;
+
+	/* The context starts over from the default state */
+	traced->deferred = 1;
+	traced->buffer.size = 0;
+	traced->command_list = NULL;
+	traced->vertex_program = NULL;
+	traced->fragment_program = NULL;
+	memset(traced->streams, 0, sizeof(traced->streams));
+	buffer_append(&traced->buffer, GXM_TRACE_BEGIN_COMMAND_LIST, 0);
+
+	return ret;
+}
+
+int gxm_trace_end_command_list(SceGxmContext *deferredContext, SceGxmCommandList *commandList)
+{
+	int ret = sceGxmEndCommandList(deferredContext, commandList);
+	struct traced_context *traced;
+
+	if (ret < 0 || !trace.file || !(traced = get_context(deferredContext)))
+		return ret;
+
+	buffer_append(&traced->buffer, GXM_TRACE_END_COMMAND_LIST, 0);
+	traced->command_list = commandList;
+
+	return ret;
+}
+
+int gxm_trace_execute_command_list(SceGxmContext *context, SceGxmCommandList *commandList)
+{
+	int ret = sceGxmExecuteCommandList(context, commandList);
+	unsigned int count, i;
+
+	if (ret < 0 || !trace.file)
+		return ret;
+
+	get_context(context);
+	count = __atomic_load_n(&trace.context_count, __ATOMIC_ACQUIRE);
+
+	pthread_mutex_lock(&trace.lock);
+	flush_immediate_contexts();
+	for (i = 0; i < count; i++) {
+		if (trace.contexts[i].deferred && trace.contexts[i].command_list == commandList)
+			write_buffer(&trace.contexts[i].buffer);
+	}
+	pthread_mutex_unlock(&trace.lock);
+
+	return ret;
+}
+
+void gxm_trace_set_vertex_program(SceGxmContext *context, const SceGxmVertexProgram *vertexProgram)
+{
+	const struct traced_vertex_program *program;
+	struct gxm_trace_program_id *record;
+	struct traced_context *traced;
+
+	sceGxmSetVertexProgram(context, vertexProgram);
+
+	if (!trace.file || !(traced = get_context(context)))
+		return;
+
+	program = find_vertex_program(vertexProgram);
+	traced->vertex_program = program;
+	if (program && (record = buffer_append(&traced->buffer,
+			GXM_TRACE_SET_VERTEX_PROGRAM, sizeof(*record))))
+		record->id = program->id;
+}
+
+void gxm_trace_set_fragment_program(SceGxmContext *context,
+	const SceGxmFragmentProgram *fragmentProgram)
+{
+	const struct traced_fragment_program *program;
+	struct gxm_trace_program_id *record;
+	struct traced_context *traced;
+
+	sceGxmSetFragmentProgram(context, fragmentProgram);
+
+	if (!trace.file || !(traced = get_context(context)))
+		return;
+
+	program = find_fragment_program(fragmentProgram);
+	traced->fragment_program = program;
+	if (program && (record = buffer_append(&traced->buffer,
+			GXM_TRACE_SET_FRAGMENT_PROGRAM, sizeof(*record))))
+		record->id = program->id;
+}
+
+int gxm_trace_reserve_vertex_default_uniform_buffer(SceGxmContext *context, void **uniformBuffer)
+{
+	int ret = sceGxmReserveVertexDefaultUniformBuffer(context, uniformBuffer);
+	struct traced_context *traced;
+
+	if (ret < 0 || !trace.file || !(traced = get_context(context)))
+		return ret;
+
+	__atomic_store_n(&traced->vertex_uniforms, *uniformBuffer, __ATOMIC_RELAXED);
+	buffer_append(&traced->buffer, GXM_TRACE_RESERVE_VERTEX_UNIFORMS, 0);
+
+	return ret;
+}
+
+int gxm_trace_reserve_fragment_default_uniform_buffer(SceGxmContext *context, void **uniformBuffer)
+{
+	int ret = sceGxmReserveFragmentDefaultUniformBuffer(context, uniformBuffer);
+	struct traced_context *traced;
+
+	if (ret < 0 || !trace.file || !(traced = get_context(context)))
+		return ret;
+
+	__atomic_store_n(&traced->fragment_uniforms, *uniformBuffer, __ATOMIC_RELAXED);
+	buffer_append(&traced->buffer, GXM_TRACE_RESERVE_FRAGMENT_UNIFORMS, 0);
+
+	return ret;
+}
+
+int gxm_trace_set_uniform_data(void *uniformBuffer, const SceGxmProgramParameter *parameter,
+	unsigned int componentOffset, unsigned int componentCount, const float *sourceData)
+{
+	int ret = sceGxmSetUniformDataF(uniformBuffer, parameter, componentOffset,
+		componentCount, sourceData);
+	struct gxm_trace_uniform_data *record;
+	struct traced_context *traced = NULL;
+	const SceGxmProgram *gxp = NULL;
+	unsigned int count, i;
+	int fragment = 0;
+
+	if (ret < 0 || !trace.file)
+		return ret;
+
+	/* The buffer was reserved on the calling thread's context */
+	count = __atomic_load_n(&trace.context_count, __ATOMIC_ACQUIRE);
+	for (i = 0; i < count && !traced; i++) {
+		struct traced_context *context = &trace.contexts[i];
+
+		if (__atomic_load_n(&context->vertex_uniforms, __ATOMIC_RELAXED) == uniformBuffer) {
+			traced = context;
+			gxp = context->vertex_program ? context->vertex_program->gxp : NULL;
+		} else if (__atomic_load_n(&context->fragment_uniforms, __ATOMIC_RELAXED) ==
+			   uniformBuffer) {
+			traced = context;
+			gxp = context->fragment_program ? context->fragment_program->gxp : NULL;
+			fragment = 1;
+		}
+	}
+
+	if (!gxp)
+		return ret;
+
+	record = buffer_append(&traced->buffer, GXM_TRACE_UNIFORM_DATA,
+		sizeof(*record) + componentCount * sizeof(float));
+	if (!record)
+		return ret;
+
+	record->fragment = fragment;
+	record->parameter = sceGxmProgramParameterGetIndex(gxp, parameter);
+	record->offset = componentOffset;
+	record->count = componentCount;
+	memcpy(record + 1, sourceData, componentCount * sizeof(float));
+
+	return ret;
+}
+
+void gxm_trace_set_front_stencil_func(SceGxmContext *context, SceGxmStencilFunc func,
+	SceGxmStencilOp stencilFail, SceGxmStencilOp depthFail, SceGxmStencilOp depthPass,
+	unsigned char compareMask, unsigned char writeMask)
+{
+	struct gxm_trace_stencil_func *record;
+
+	sceGxmSetFrontStencilFunc(context, func, stencilFail, depthFail, depthPass,
+		compareMask, writeMask);
+
+	if (!trace.file || !(record = context_append(context,
+			GXM_TRACE_SET_STENCIL_FUNC, sizeof(*record))))
+		return;
+
+	record->func = func;
+	record->stencil_fail = stencilFail;
+	record->depth_fail = depthFail;
+	record->depth_pass = depthPass;
+	record->compare_mask = compareMask;
+	record->write_mask = writeMask;
+}
+
+void gxm_trace_set_front_stencil_ref(SceGxmContext *context, unsigned int sref)
+{
+	struct gxm_trace_value *record;
+
+	sceGxmSetFrontStencilRef(context, sref);
+
+	if (trace.file && (record = context_append(context,
+			GXM_TRACE_SET_STENCIL_REF, sizeof(*record))))
+		record->value = sref;
+}
+
+void gxm_trace_set_front_depth_func(SceGxmContext *context, SceGxmDepthFunc depthFunc)
+{
+	struct gxm_trace_value *record;
+
+	sceGxmSetFrontDepthFunc(context, depthFunc);
+
+	if (trace.file && (record = context_append(context,
+			GXM_TRACE_SET_DEPTH_FUNC, sizeof(*record))))
+		record->value = depthFunc;
+}
+
+void gxm_trace_set_front_depth_write_enable(SceGxmContext *context, SceGxmDepthWriteMode enable)
+{
+	struct gxm_trace_value *record;
+
+	sceGxmSetFrontDepthWriteEnable(context, enable);
+
+	if (trace.file && (record = context_append(context,
+			GXM_TRACE_SET_DEPTH_WRITE, sizeof(*record))))
+		record->value = enable;
+}
+
+void gxm_trace_set_viewport(SceGxmContext *context, float xOffset, float xScale, float yOffset,
+	float yScale, float zOffset, float zScale)
+{
+	struct gxm_trace_viewport *record;
+
+	sceGxmSetViewport(context, xOffset, xScale, yOffset, yScale, zOffset, zScale);
+
+	if (!trace.file || !(record = context_append(context,
+			GXM_TRACE_SET_VIEWPORT, sizeof(*record))))
+		return;
+
+	record->x_offset = xOffset;
+	record->x_scale = xScale;
+	record->y_offset = yOffset;
+	record->y_scale = yScale;
+	record->z_offset = zOffset;
+	record->z_scale = zScale;
+}
+
+int gxm_trace_set_vertex_stream(SceGxmContext *context, unsigned int streamIndex,
+	const void *streamData)
+{
+	int ret = sceGxmSetVertexStream(context, streamIndex, streamData);
+	struct traced_context *traced;
+
+	/* Bound streams are written with the draws that use them */
+	if (ret >= 0 && trace.file && streamIndex < GXM_TRACE_MAX_STREAMS &&
+	    (traced = get_context(context)))
+		traced->streams[streamIndex] = streamData;
+
+	return ret;
+}
+
+int gxm_trace_set_fragment_texture(SceGxmContext *context, unsigned int textureIndex,
+	const SceGxmTexture *texture)
+{
+	int ret = sceGxmSetFragmentTexture(context, textureIndex, texture);
+	const void *data = sceGxmTextureGetData(texture);
+	struct gxm_trace_texture *record;
+	struct pending_texture *pending;
+	uint32_t surface, offset = 0;
+	size_t size;
+
+	if (ret < 0 || !trace.file)
+		return ret;
+
+	pthread_mutex_lock(&trace.lock);
+	surface = find_surface(data, &offset);
+	pthread_mutex_unlock(&trace.lock);
+
+	/* Texels that aren't rendered to are stored as a blob when written */
+	if (surface != NO_SURFACE) {
+		record = context_append(context, GXM_TRACE_SET_FRAGMENT_TEXTURE, sizeof(*record));
+	} else {
+		size = texture_data_size(texture);
+		if (!size || size > UINT32_MAX || !(pending = context_append(context,
+				TRACE_PENDING_TEXTURE, sizeof(*pending))))
+			return ret;
+		pending->data = data;
+		pending->size = size;
+		record = &pending->texture;
+	}
+	if (!record)
+		return ret;
+
+	record->index = textureIndex;
+	record->type = sceGxmTextureGetType(texture);
+	record->format = sceGxmTextureGetFormat(texture);
+	record->width = sceGxmTextureGetWidth(texture);
+	record->height = sceGxmTextureGetHeight(texture);
+	record->stride = sceGxmTextureGetStride(texture);
+	record->mip_count = sceGxmTextureGetMipmapCount(texture);
+	record->min_filter = sceGxmTextureGetMinFilter(texture);
+	record->mag_filter = sceGxmTextureGetMagFilter(texture);
+	record->mip_filter = sceGxmTextureGetMipFilter(texture);
+	record->u_addr_mode = sceGxmTextureGetUAddrMode(texture);
+	record->v_addr_mode = sceGxmTextureGetVAddrMode(texture);
+	record->surface = surface;
+	record->offset = offset;
+	record->blob = NO_BLOB;
+
+	return ret;
+}
+
+int gxm_trace_draw(SceGxmContext *context, SceGxmPrimitiveType primType,
+	SceGxmIndexFormat indexType, const void *indexData, unsigned int indexCount)
+{
+	int ret = sceGxmDraw(context, primType, indexType, indexData, indexCount);
+	const unsigned int index_size = indexType == SCE_GXM_INDEX_FORMAT_U32 ? 4 : 2;
+	const struct traced_vertex_program *program;
+	struct traced_context *traced;
+	struct pending_draw *pending;
+	unsigned int i, max_index = 0;
+
+	if (ret < 0 || !trace.file || !(traced = get_context(context)) ||
+	    !(program = traced->vertex_program))
+		return ret;
+
+	for (i = 0; i < indexCount; i++) {
+		unsigned int index = index_size == 4 ? ((const uint32_t *)indexData)[i] :
+			((const uint16_t *)indexData)[i];
+		if (index > max_index)
+			max_index = index;
+	}
+
+	pending = buffer_append(&traced->buffer, TRACE_PENDING_DRAW, sizeof(*pending));
+	if (!pending)
+		return ret;
+
+	pending->draw.primitive = primType;
+	pending->draw.index_format = indexType;
+	pending->draw.index_count = indexCount;
+	pending->indices = indexData;
+	pending->index_size = indexCount * index_size;
+	pending->stream_count = program->stream_count;
+	for (i = 0; i < program->stream_count; i++) {
+		if (!program->streams[i].stride)
+			continue;
+		pending->streams[i] = traced->streams[i];
+		pending->stream_sizes[i] = (max_index + 1) * program->streams[i].stride;
+	}
+
+	return ret;
+}
+
+int gxm_trace_display_queue_add_entry(SceGxmSyncObject *oldBuffer, SceGxmSyncObject *newBuffer,
+	const void *callbackData)
+{
+	if (trace.file) {
+		struct gxm_trace_end_frame record;
+
+		record.frame = trace.frame++;
+
+		pthread_mutex_lock(&trace.lock);
+		flush_immediate_contexts();
+		write_record(GXM_TRACE_END_FRAME, &record, sizeof(record), NULL, 0);
+		pthread_mutex_unlock(&trace.lock);
+	}
+
+	return sceGxmDisplayQueueAddEntry(oldBuffer, newBuffer, callbackData);
+}
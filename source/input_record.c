@@ -0,0 +1,78 @@
+#include <string.h>
+#include "input_record.h"
+
+int input_record_open_write(struct input_record *record, const char *path, uint64_t step_ns)
+{
+	struct input_record_header header;
+
+	memset(record, 0, sizeof(*record));
+
+	record->file = fopen(path, "wb");
+	if (!record->file)
+		return -1;
+
+	memcpy(header.magic, INPUT_RECORD_MAGIC, sizeof(header.magic));
+	header.version = INPUT_RECORD_VERSION;
+	header.step_ns = step_ns;
+
+	if (fwrite(&header, sizeof(header), 1, record->file) != 1) {
+		input_record_close(record);
+		return -1;
+	}
+
+	return 0;
+}
+
+int input_record_open_read(struct input_record *record, const char *path, uint64_t step_ns)
+{
+	struct input_record_header header;
+
+	memset(record, 0, sizeof(*record));
+
+	record->file = fopen(path, "rb");
+	if (!record->file)
+		return -1;
+
+	if (fread(&header, sizeof(header), 1, record->file) != 1 ||
+	    memcmp(header.magic, INPUT_RECORD_MAGIC, sizeof(header.magic)) ||
+	    header.version != INPUT_RECORD_VERSION) {
+		input_record_close(record);
+		return -1;
+	}
+
+	if (header.step_ns != step_ns) {
+		printf("Input recorded at a %.3f ms step, simulating at %.3f ms\n",
+			header.step_ns / 1000000.0f, step_ns / 1000000.0f);
+		input_record_close(record);
+		return -1;
+	}
+
+	return 0;
+}
+
+int input_record_write(struct input_record *record, const struct input_record_frame *frame)
+{
+	if (fwrite(frame, sizeof(*frame), 1, record->file) != 1)
+		return -1;
+
+	record->frame_count++;
+
+	return 0;
+}
+
+int input_record_read(struct input_record *record, struct input_record_frame *frame)
+{
+	if (fread(frame, sizeof(*frame), 1, record->file) != 1)
+		return 0;
+
+	record->frame_count++;
+
+	return 1;
+}
+
+void input_record_close(struct input_record *record)
+{
+	if (record->file)
+		fclose(record->file);
+	record->file = NULL;
+}
@@ -0,0 +1,570 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#ifndef __vita__
+#include <unistd.h>
+#endif
+#include "job_system.h"
+
+#define JOB_QUEUE_SIZE JOB_POOL_SIZE
+#define JOB_QUEUE_MASK (JOB_QUEUE_SIZE - 1)
+#define JOB_THREAD_STACK_SIZE (256 * 1024)
+#define CACHE_LINE_SIZE 64
+/* Keeps a whole parallel for well within one thread's job pool */
+#define PARALLEL_FOR_MAX_LEAF_JOBS (JOB_POOL_SIZE / 16)
+/* Empty looks for a job before an idle thread sleeps */
+#define JOB_IDLE_SPINS 64
+
+struct job {
+	job_function function;
+	struct job *parent;
+	int unfinished_jobs;
+	int pending_dependencies;
+	int continuation_count;
+	struct job *continuations[JOB_MAX_CONTINUATIONS];
+	unsigned char data[JOB_DATA_SIZE];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/*
+ * Chase-Lev deque: the owner pushes and pops at the bottom,
+ * thieves take from the top.
+ */
+struct job_queue {
+	unsigned int top __attribute__((aligned(CACHE_LINE_SIZE)));
+	unsigned int bottom __attribute__((aligned(CACHE_LINE_SIZE)));
+	struct job *jobs[JOB_QUEUE_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+struct worker {
+	unsigned int index;
+	pthread_t thread;
+	struct job_queue *queue;
+	struct job *pool;
+	unsigned int pool_index;
+	unsigned int rand_state;
+};
+
+struct parallel_for_data {
+	job_parallel_for_function function;
+	void *data;
+	unsigned int start;
+	unsigned int count;
+	unsigned int granularity;
+};
+
+static struct worker workers[JOB_SYSTEM_MAX_THREADS];
+static unsigned int worker_count;
+static int workers_running;
+static pthread_key_t worker_key;
+
+/*
+ * Idle threads sleep instead of spinning, so they leave the cores to the
+ * other threads of the demo. A thread counts itself as sleeping before
+ * its last look for work, and whoever pushes a job or finishes one looks
+ * at the count after doing so: either the sleeper sees the new state or
+ * the other thread sees the sleeper and bumps the generation to wake it.
+ */
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Workers with nothing to run, woken by new jobs */
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static int sleeping_workers;
+static unsigned int work_generation;
+/* Threads in job_wait(), woken by finished jobs */
+static pthread_cond_t finished_cond = PTHREAD_COND_INITIALIZER;
+static int sleeping_waiters;
+static unsigned int finished_generation;
+
+static int queue_push(struct job_queue *queue, struct job *job)
+{
+	unsigned int bottom = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED);
+	unsigned int top = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+
+	if (bottom - top >= JOB_QUEUE_SIZE)
+		return 0;
+
+	__atomic_store_n(&queue->jobs[bottom & JOB_QUEUE_MASK], job, __ATOMIC_RELAXED);
+	__atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+static struct job *queue_pop(struct job_queue *queue)
+{
+	struct job *job;
+	unsigned int bottom = __atomic_load_n(&queue->bottom, __ATOMIC_RELAXED) - 1;
+	unsigned int top;
+
+	__atomic_store_n(&queue->bottom, bottom, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	top = __atomic_load_n(&queue->top, __ATOMIC_RELAXED);
+
+	if ((int)(bottom - top) < 0) {
+		/* Empty queue */
+		__atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	job = __atomic_load_n(&queue->jobs[bottom & JOB_QUEUE_MASK], __ATOMIC_RELAXED);
+	if (bottom != top)
+		return job;
+
+	/* Last job in the queue: race against the thieves */
+	if (!__atomic_compare_exchange_n(&queue->top, &top, top + 1, 0,
+	    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		job = NULL;
+
+	__atomic_store_n(&queue->bottom, bottom + 1, __ATOMIC_RELAXED);
+
+	return job;
+}
+
+static struct job *queue_steal(struct job_queue *queue)
+{
+	struct job *job;
+	unsigned int top = __atomic_load_n(&queue->top, __ATOMIC_ACQUIRE);
+	unsigned int bottom;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	bottom = __atomic_load_n(&queue->bottom, __ATOMIC_ACQUIRE);
+
+	if ((int)(bottom - top) <= 0)
+		return NULL;
+
+	job = __atomic_load_n(&queue->jobs[top & JOB_QUEUE_MASK], __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&queue->top, &top, top + 1, 0,
+	    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return NULL;
+
+	return job;
+}
+
+static struct worker *get_current_worker(void)
+{
+	struct worker *worker = pthread_getspecific(worker_key);
+
+	/* Threads outside the job system share worker 0 */
+	return worker ? worker : &workers[0];
+}
+
+static unsigned int worker_rand(struct worker *worker)
+{
+	/* xorshift32 */
+	unsigned int x = worker->rand_state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	worker->rand_state = x;
+
+	return x;
+}
+
+static void wake_sleepers(int *sleeping, unsigned int *generation, pthread_cond_t *cond)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(sleeping, __ATOMIC_RELAXED))
+		return;
+
+	pthread_mutex_lock(&idle_mutex);
+	__atomic_add_fetch(generation, 1, __ATOMIC_RELAXED);
+	pthread_cond_broadcast(cond);
+	pthread_mutex_unlock(&idle_mutex);
+}
+
+/* Sleep until the generation moves on from the one read before the last look */
+static void sleep_until(unsigned int *generation, unsigned int seen, pthread_cond_t *cond)
+{
+	pthread_mutex_lock(&idle_mutex);
+	while (__atomic_load_n(generation, __ATOMIC_RELAXED) == seen &&
+	       __atomic_load_n(&workers_running, __ATOMIC_RELAXED))
+		pthread_cond_wait(cond, &idle_mutex);
+	pthread_mutex_unlock(&idle_mutex);
+}
+
+static struct job *get_job(struct worker *worker)
+{
+	struct job *job;
+	unsigned int victim;
+
+	job = queue_pop(worker->queue);
+	if (job)
+		return job;
+
+	if (worker_count < 2)
+		return NULL;
+
+	victim = worker_rand(worker) % worker_count;
+	if (victim == worker->index)
+		victim = (victim + 1) % worker_count;
+
+	return queue_steal(workers[victim].queue);
+}
+
+/* Last look before sleeping: every other queue, not a random one */
+static struct job *get_any_job(struct worker *worker)
+{
+	struct job *job;
+	unsigned int i;
+
+	job = queue_pop(worker->queue);
+	for (i = 0; !job && i < worker_count; i++) {
+		if (i != worker->index)
+			job = queue_steal(workers[i].queue);
+	}
+
+	return job;
+}
+
+static void execute_job(struct job *job);
+
+static void push_job(struct job *job)
+{
+	struct worker *worker = get_current_worker();
+
+	/* Fall back to running the job inline if the queue is full */
+	if (!queue_push(worker->queue, job)) {
+		execute_job(job);
+		return;
+	}
+
+	wake_sleepers(&sleeping_workers, &work_generation, &work_cond);
+}
+
+static void release_dependency(struct job *job)
+{
+	if (__atomic_sub_fetch(&job->pending_dependencies, 1, __ATOMIC_ACQ_REL) == 0)
+		push_job(job);
+}
+
+static void finish_job(struct job *job)
+{
+	int i, continuation_count;
+
+	if (__atomic_sub_fetch(&job->unfinished_jobs, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+	wake_sleepers(&sleeping_waiters, &finished_generation, &finished_cond);
+
+	/*
+	 * Read the continuations before notifying the parent: once the parent
+	 * is finished a waiter may recycle this job.
+	 */
+	struct job *continuations[JOB_MAX_CONTINUATIONS];
+	continuation_count = __atomic_load_n(&job->continuation_count, __ATOMIC_ACQUIRE);
+	for (i = 0; i < continuation_count; i++)
+		continuations[i] = job->continuations[i];
+
+	if (job->parent)
+		finish_job(job->parent);
+
+	for (i = 0; i < continuation_count; i++)
+		release_dependency(continuations[i]);
+}
+
+static void execute_job(struct job *job)
+{
+	job->function(job, job->data);
+	finish_job(job);
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *worker = arg;
+	struct job *job;
+	unsigned int idle = 0, generation;
+
+	pthread_setspecific(worker_key, worker);
+
+	while (__atomic_load_n(&workers_running, __ATOMIC_RELAXED)) {
+		job = get_job(worker);
+		if (job) {
+			execute_job(job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < JOB_IDLE_SPINS) {
+			sched_yield();
+			continue;
+		}
+
+		__atomic_add_fetch(&sleeping_workers, 1, __ATOMIC_SEQ_CST);
+		generation = __atomic_load_n(&work_generation, __ATOMIC_SEQ_CST);
+		job = get_any_job(worker);
+		if (!job)
+			sleep_until(&work_generation, generation, &work_cond);
+		__atomic_sub_fetch(&sleeping_workers, 1, __ATOMIC_SEQ_CST);
+
+		if (job)
+			execute_job(job);
+		idle = 0;
+	}
+
+	return NULL;
+}
+
+static int worker_init(struct worker *worker, unsigned int index)
+{
+	memset(worker, 0, sizeof(*worker));
+	worker->index = index;
+	worker->rand_state = 0x9E3779B9u * (index + 1);
+
+	worker->queue = malloc(sizeof(struct job_queue));
+	worker->pool = malloc(JOB_POOL_SIZE * sizeof(struct job) + CACHE_LINE_SIZE);
+	if (!worker->queue || !worker->pool)
+		return -1;
+
+	memset(worker->queue, 0, sizeof(struct job_queue));
+
+	return 0;
+}
+
+static void worker_term(struct worker *worker)
+{
+	free(worker->queue);
+	free(worker->pool);
+	worker->queue = NULL;
+	worker->pool = NULL;
+}
+
+int job_system_init(unsigned int thread_count)
+{
+	unsigned int i;
+	pthread_attr_t attr;
+
+	if (thread_count == 0)
+		thread_count = job_system_get_default_thread_count();
+	if (thread_count > JOB_SYSTEM_MAX_THREADS)
+		thread_count = JOB_SYSTEM_MAX_THREADS;
+
+	if (pthread_key_create(&worker_key, NULL) != 0)
+		return -1;
+
+	for (i = 0; i < thread_count; i++) {
+		if (worker_init(&workers[i], i) < 0) {
+			worker_count = i + 1;
+			job_system_finish();
+			return -1;
+		}
+	}
+
+	worker_count = thread_count;
+	workers_running = 1;
+
+	workers[0].thread = pthread_self();
+	pthread_setspecific(worker_key, &workers[0]);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, JOB_THREAD_STACK_SIZE);
+
+	for (i = 1; i < thread_count; i++) {
+		if (pthread_create(&workers[i].thread, &attr, worker_thread, &workers[i]) != 0) {
+			unsigned int j;
+			for (j = i; j < thread_count; j++)
+				worker_term(&workers[j]);
+			worker_count = i;
+			pthread_attr_destroy(&attr);
+			job_system_finish();
+			return -1;
+		}
+	}
+
+	pthread_attr_destroy(&attr);
+
+	return 0;
+}
+
+void job_system_finish(void)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&idle_mutex);
+	__atomic_store_n(&workers_running, 0, __ATOMIC_RELAXED);
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&idle_mutex);
+
+	for (i = 1; i < worker_count; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	for (i = 0; i < worker_count; i++)
+		worker_term(&workers[i]);
+
+	pthread_setspecific(worker_key, NULL);
+	pthread_key_delete(worker_key);
+
+	worker_count = 0;
+}
+
+unsigned int job_system_get_thread_count(void)
+{
+	return worker_count;
+}
+
+unsigned int job_system_get_default_thread_count(void)
+{
+#ifdef __vita__
+	/* Cores 0 to 2 are available to applications */
+	return 3;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (count < 1)
+		return 1;
+	if (count > JOB_SYSTEM_MAX_THREADS)
+		return JOB_SYSTEM_MAX_THREADS;
+	return count;
+#endif
+}
+
+static struct job *allocate_job(void)
+{
+	struct worker *worker = get_current_worker();
+	struct job *pool = (struct job *)(((size_t)worker->pool + CACHE_LINE_SIZE - 1) &
+		~(size_t)(CACHE_LINE_SIZE - 1));
+
+	return &pool[worker->pool_index++ & (JOB_POOL_SIZE - 1)];
+}
+
+struct job *job_create(job_function function, const void *data, size_t data_size)
+{
+	struct job *job = allocate_job();
+
+	job->function = function;
+	job->parent = NULL;
+	job->unfinished_jobs = 1;
+	job->pending_dependencies = 1;
+	job->continuation_count = 0;
+
+	if (data_size > JOB_DATA_SIZE)
+		data_size = JOB_DATA_SIZE;
+	if (data && data_size)
+		memcpy(job->data, data, data_size);
+
+	return job;
+}
+
+struct job *job_create_child(struct job *parent, job_function function,
+	const void *data, size_t data_size)
+{
+	struct job *job = job_create(function, data, data_size);
+
+	__atomic_add_fetch(&parent->unfinished_jobs, 1, __ATOMIC_RELAXED);
+	job->parent = parent;
+
+	return job;
+}
+
+int job_add_dependency(struct job *job, struct job *dependency)
+{
+	int index;
+
+	index = __atomic_fetch_add(&dependency->continuation_count, 1, __ATOMIC_ACQ_REL);
+	assert(index < JOB_MAX_CONTINUATIONS);
+	if (index >= JOB_MAX_CONTINUATIONS) {
+		/* Without asserts, the dependency is not made and the caller told */
+		__atomic_sub_fetch(&dependency->continuation_count, 1, __ATOMIC_ACQ_REL);
+		return -1;
+	}
+
+	__atomic_add_fetch(&job->pending_dependencies, 1, __ATOMIC_RELAXED);
+	dependency->continuations[index] = job;
+
+	return 0;
+}
+
+void job_run(struct job *job)
+{
+	release_dependency(job);
+}
+
+int job_is_finished(const struct job *job)
+{
+	return __atomic_load_n(&job->unfinished_jobs, __ATOMIC_ACQUIRE) == 0;
+}
+
+void job_wait(const struct job *job)
+{
+	struct worker *worker = get_current_worker();
+	struct job *next;
+	unsigned int idle = 0, generation;
+
+	while (!job_is_finished(job)) {
+		next = get_job(worker);
+		if (next) {
+			execute_job(next);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < JOB_IDLE_SPINS) {
+			sched_yield();
+			continue;
+		}
+
+		/* Woken by any job finishing, the job's other jobs may run elsewhere */
+		__atomic_add_fetch(&sleeping_waiters, 1, __ATOMIC_SEQ_CST);
+		generation = __atomic_load_n(&finished_generation, __ATOMIC_SEQ_CST);
+		next = get_any_job(worker);
+		if (!next && !job_is_finished(job))
+			sleep_until(&finished_generation, generation, &finished_cond);
+		__atomic_sub_fetch(&sleeping_waiters, 1, __ATOMIC_SEQ_CST);
+
+		if (next)
+			execute_job(next);
+		idle = 0;
+	}
+}
+
+static void parallel_for_job(struct job *job, void *data)
+{
+	const struct parallel_for_data *range = data;
+
+	if (range->count > range->granularity) {
+		struct parallel_for_data left = *range;
+		struct parallel_for_data right = *range;
+
+		left.count = range->count / 2;
+		right.start = range->start + left.count;
+		right.count = range->count - left.count;
+
+		job_run(job_create_child(job, parallel_for_job, &left, sizeof(left)));
+		job_run(job_create_child(job, parallel_for_job, &right, sizeof(right)));
+	} else {
+		range->function(range->data, range->start, range->count);
+	}
+}
+
+static void parallel_for_range_init(struct parallel_for_data *range,
+	job_parallel_for_function function, void *data, unsigned int count,
+	unsigned int granularity)
+{
+	range->function = function;
+	range->data = data;
+	range->start = 0;
+	range->count = count;
+	range->granularity = granularity ? granularity : 1;
+
+	if (count / range->granularity > PARALLEL_FOR_MAX_LEAF_JOBS)
+		range->granularity = (count + PARALLEL_FOR_MAX_LEAF_JOBS - 1) / PARALLEL_FOR_MAX_LEAF_JOBS;
+}
+
+struct job *job_parallel_for(job_parallel_for_function function, void *data,
+	unsigned int count, unsigned int granularity)
+{
+	struct parallel_for_data range;
+
+	parallel_for_range_init(&range, function, data, count, granularity);
+
+	return job_create(parallel_for_job, &range, sizeof(range));
+}
+
+struct job *job_parallel_for_child(struct job *parent, job_parallel_for_function function,
+	void *data, unsigned int count, unsigned int granularity)
+{
+	struct parallel_for_data range;
+
+	parallel_for_range_init(&range, function, data, count, granularity);
+
+	return job_create_child(parent, parallel_for_job, &range, sizeof(range));
+}
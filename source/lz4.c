@@ -0,0 +1,195 @@
+#include <stdint.h>
+#include <string.h>
+#include "lz4.h"
+
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+/* The last 5 bytes are literals and the last match starts 12 bytes before the end */
+#define LAST_LITERALS 5
+#define MATCH_FIND_LIMIT 12
+#define HASH_BITS 12
+/* Misses in a row before the search starts skipping ahead */
+#define SKIP_TRIGGER 6
+
+static uint32_t read32(const uint8_t *p)
+{
+	uint32_t value;
+
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+static uint32_t hash32(uint32_t value)
+{
+	return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Bytes of a literal or match length past the 15 of the token */
+static uint8_t *write_length(uint8_t *op, unsigned int length)
+{
+	while (length >= 255) {
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = length;
+
+	return op;
+}
+
+static unsigned int sequence_bound(unsigned int literal_length, unsigned int match_length)
+{
+	return 1 + literal_length + literal_length / 255 + 1 + 2 + match_length / 255 + 1;
+}
+
+unsigned int lz4_compress(const void *source, unsigned int size, void *destination,
+	unsigned int capacity)
+{
+	const uint8_t *in = source;
+	const uint8_t *end = in + size;
+	const uint8_t *ip = in, *anchor = in;
+	uint8_t *out = destination, *op = out;
+	uint32_t table[1 << HASH_BITS];
+	unsigned int literal_length;
+
+	memset(table, 0, sizeof(table));
+
+	if (size > MATCH_FIND_LIMIT) {
+		const uint8_t *match_limit = end - MATCH_FIND_LIMIT;
+		unsigned int misses = 0;
+
+		while (ip <= match_limit) {
+			uint32_t hash = hash32(read32(ip));
+			const uint8_t *ref = in + table[hash];
+			const uint8_t *match_end;
+			unsigned int match_length, offset;
+			uint8_t *token;
+
+			table[hash] = ip - in;
+			if (ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != read32(ip)) {
+				ip += 1 + (misses++ >> SKIP_TRIGGER);
+				continue;
+			}
+			misses = 0;
+
+			while (ip > anchor && ref > in && ip[-1] == ref[-1]) {
+				ip--;
+				ref--;
+			}
+
+			match_end = ip + MIN_MATCH;
+			while (match_end < end - LAST_LITERALS && *match_end == ref[match_end - ip])
+				match_end++;
+
+			literal_length = ip - anchor;
+			match_length = match_end - ip - MIN_MATCH;
+			if (sequence_bound(literal_length, match_length) > capacity - (op - out))
+				return 0;
+
+			token = op++;
+			*token = (literal_length < 15 ? literal_length : 15) << 4;
+			if (literal_length >= 15)
+				op = write_length(op, literal_length - 15);
+			memcpy(op, anchor, literal_length);
+			op += literal_length;
+
+			offset = ip - ref;
+			*op++ = offset & 0xFF;
+			*op++ = offset >> 8;
+			*token |= match_length < 15 ? match_length : 15;
+			if (match_length >= 15)
+				op = write_length(op, match_length - 15);
+
+			ip = anchor = match_end;
+			/* Lets the next match start right where this one ended */
+			table[hash32(read32(ip - 2))] = ip - 2 - in;
+		}
+	}
+
+	literal_length = end - anchor;
+	if (1 + literal_length + literal_length / 255 + 1 > capacity - (op - out))
+		return 0;
+
+	*op++ = (literal_length < 15 ? literal_length : 15) << 4;
+	if (literal_length >= 15)
+		op = write_length(op, literal_length - 15);
+	memcpy(op, anchor, literal_length);
+	op += literal_length;
+
+	return op - out;
+}
+
+/* Adds the length bytes after a token nibble of 15, -1 past limit */
+static int read_length(const uint8_t **ip, const uint8_t *end, unsigned int *length,
+	unsigned int limit)
+{
+	uint8_t byte;
+
+	do {
+		if (*ip >= end)
+			return -1;
+		byte = *(*ip)++;
+		*length += byte;
+		if (*length > limit)
+			return -1;
+	} while (byte == 255);
+
+	return 0;
+}
+
+int lz4_decompress(const void *source, unsigned int size, void *destination,
+	unsigned int capacity)
+{
+	const uint8_t *ip = source;
+	const uint8_t *end = ip + size;
+	uint8_t *out = destination, *op = out;
+	uint8_t *out_end = out + capacity;
+
+	for (;;) {
+		unsigned int token, length, offset;
+		const uint8_t *match;
+
+		if (ip >= end)
+			return -1;
+		token = *ip++;
+
+		length = token >> 4;
+		if (length == 15 && read_length(&ip, end, &length, capacity) < 0)
+			return -1;
+		if (length > (unsigned int)(end - ip) || length > (unsigned int)(out_end - op))
+			return -1;
+		memcpy(op, ip, length);
+		op += length;
+		ip += length;
+
+		/* The last sequence has no match */
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			return -1;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (!offset || offset > (unsigned int)(op - out))
+			return -1;
+
+		length = token & 15;
+		if (length == 15 && read_length(&ip, end, &length, capacity) < 0)
+			return -1;
+		length += MIN_MATCH;
+		if (length > (unsigned int)(out_end - op))
+			return -1;
+
+		/* Overlapping matches repeat the last offset bytes */
+		match = op - offset;
+		if (offset >= length) {
+			memcpy(op, match, length);
+			op += length;
+		} else {
+			while (length--)
+				*op++ = *match++;
+		}
+	}
+
+	return op - out;
+}
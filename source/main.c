@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,21 +6,112 @@
 #include <psp2/display.h>
 #include <psp2/ctrl.h>
 #include <psp2/kernel/sysmem.h>
+#include "gxm_trace.h"
+#include "render_counters.h"
+#include "gpu_memory.h"
 #include "math_utils.h"
 #include "camera.h"
+#include "job_system.h"
+#include "frame_pipeline.h"
+#include "options.h"
+#include "command_memory.h"
+#include "time_utils.h"
+#include "frame_stats.h"
+#include "fixed_timestep.h"
+#include "profiler.h"
+#include "input_record.h"
+#include "camera_path.h"
+#include "benchmark.h"
+#include "scene_store.h"
+#include "bvh.h"
+#include "occlusion.h"
+#include "mesh_simplify.h"
+#include "mesh_file.h"
+#include "texture_file.h"
+#include "mesh_gen.h"
+#include "scene_gen.h"
+#include "asset_archive.h"
+#include "asset_loader.h"
+#include "dynamic_resolution.h"
 
 #define ALIGN(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
 #define abs(x) (((x) < 0) ? -(x) : (x))
 
 #define ANALOG_THRESHOLD 20
 
+/*
+ * Simulation speeds, per second. They match the per frame increments
+ * the demo used when it was locked to 60 fps.
+ */
+#define SIMULATION_MAX_STEPS_PER_FRAME 8
+#define CAMERA_ANALOG_SPEED (60.0f / 1536.0f)
+#define CAMERA_VERTICAL_SPEED 6.0f
+#define PORTAL_MOVE_SPEED 1.5f
+#define PORTAL_ROTATION_SPEED 1.5f
+#define LIGHT_ROTATION_SPEED 6.0f
+
 #define DISPLAY_WIDTH 960
 #define DISPLAY_HEIGHT 544
 #define DISPLAY_STRIDE 1024
-#define DISPLAY_BUFFER_COUNT 2
-#define DISPLAY_COLOR_FORMAT SCE_GXM_COLOR_FORMAT_A8B8G8R8
-#define DISPLAY_PIXEL_FORMAT SCE_DISPLAY_PIXELFORMAT_A8B8G8R8
-#define MAX_PENDING_SWAPS (DISPLAY_BUFFER_COUNT - 1)
+#define DISPLAY_MAX_BUFFER_COUNT OPTIONS_MAX_DISPLAY_BUFFERS
+
+#define SCENE_INITIAL_CAPACITY 64
+#define SCENE_OBJECTS_PER_JOB 16
+
+/*
+ * Each level of detail keeps at most half the triangles of the previous
+ * one and moves the surface by at most a fraction of the bounding radius.
+ * Levels that remove too little are dropped.
+ */
+#define MESH_MAX_LODS 4
+#define MESH_LOD_MAX_ERROR 0.05f
+#define MESH_LOD_MIN_REDUCTION 0.8f
+/*
+ * A level is drawn once its error projects to less than this many pixels,
+ * and a switch needs the screen size to be this far past the threshold.
+ */
+#define LOD_MAX_PIXEL_ERROR 1.0f
+#define LOD_HYSTERESIS 0.15f
+
+/* Entry of the --assets archive that replaces the cube mesh */
+#define ASSET_CUBE_MESH "cube.gxmm"
+
+/*
+ * In texture mode the portal texture is kept while every element of the
+ * portal view matrix and of the lights stays within this of what it was
+ * rendered with, and no object moved.
+ */
+#define PORTAL_TEXTURE_REUSE_TOLERANCE 1e-4f
+
+/* The light circling the scene, then the ones --scene generated */
+#define SCENE_MAX_LIGHTS (1 + SCENE_GEN_MAX_LIGHTS)
+/* --scene places nothing this close to the demo's portal and cubes */
+#define SCENE_CLEAR_RADIUS 8.0f
+
+/*
+ * The portal's resolution controller aims below the frame target, so
+ * under load the portal view gives up resolution before the main view
+ * and gets it back after it.
+ */
+#define DYNRES_PORTAL_TARGET_FRACTION 0.9f
+
+/*
+ * Each view records into its own deferred context. Its command memory has
+ * one region per frame that can be in flight on the GPU.
+ */
+#define VIEW_COMMAND_MEMORY_REGIONS (DISPLAY_MAX_BUFFER_COUNT + 1)
+#define VIEW_VDM_COMMAND_MEMORY_SIZE (32 * 1024)
+#define VIEW_VERTEX_COMMAND_MEMORY_SIZE (128 * 1024)
+#define VIEW_FRAGMENT_COMMAND_MEMORY_SIZE (128 * 1024)
+/*
+ * Those are for the demo's scene, --scene adds this much per object it
+ * generates. Views of scenes of more objects than VIEW_MAX_DEFERRED_DRAWS
+ * are drawn on the immediate context instead.
+ */
+#define VIEW_VDM_COMMAND_BYTES_PER_DRAW 256
+#define VIEW_VERTEX_COMMAND_BYTES_PER_DRAW 128
+#define VIEW_FRAGMENT_COMMAND_BYTES_PER_DRAW 256
+#define VIEW_MAX_DEFERRED_DRAWS 8192
 
 struct clear_vertex {
 	vector2f position;
@@ -60,6 +152,99 @@ struct portal {
 	} end1, end2;
 };
 
+/* Pixels of the screen, the origin is the top left corner */
+struct portal_rect {
+	unsigned int x;
+	unsigned int y;
+	unsigned int width;
+	unsigned int height;
+};
+
+/* What the portal texture was last rendered with */
+struct portal_texture {
+	int valid;
+	struct portal_rect rect;
+	unsigned int view_width;
+	unsigned int view_height;
+	matrix4x4 view_matrix;
+	struct light lights[SCENE_MAX_LIGHTS];
+	unsigned int light_count;
+};
+
+struct mesh_lod {
+	const unsigned short *indices;
+	unsigned int index_count;
+	/* Distance the surface moved from the full mesh, in model units */
+	float error;
+	/* Largest screen size (see select_lod()) the level is drawn at */
+	float max_size;
+	SceUID uid;
+};
+
+struct mesh {
+	const void *vertices;
+	const unsigned short *indices;
+	unsigned int index_count;
+	SceGxmPrimitiveType primitive;
+	/* The first level is the full mesh, the others share its vertices */
+	struct mesh_lod lods[MESH_MAX_LODS];
+	unsigned int lod_count;
+	/* Bounding sphere in model space */
+	vector3f center;
+	float radius;
+	/* Drawn into the views' CPU depth buffers, NULL if it hides nothing */
+	const struct occlusion_mesh *occluder;
+};
+
+struct draw_packet {
+	int visible;
+	unsigned int lod;
+	/* The scene light nearest to the object, the only one it is lit by */
+	unsigned int light;
+	matrix4x4 mvp_matrix;
+	matrix4x4 modelview_matrix;
+	matrix3x3 normal_matrix;
+};
+
+enum view_id {
+	VIEW_PORTAL,
+	VIEW_MAIN,
+	VIEW_COUNT
+};
+
+struct view {
+	enum view_id id;
+	const struct scene_state *state;
+	const struct scene_store *store;
+	matrix4x4 projection_matrix;
+	matrix4x4 view_matrix;
+	vector4f frustum_planes[6];
+	/* Pixels the viewport maps the clip volume to */
+	unsigned int width;
+	unsigned int height;
+	/* Nodes that passed the BVH cull and their packets, grown with the scene */
+	uint32_t *visible;
+	struct draw_packet *packets;
+	unsigned int visible_count;
+	unsigned int packet_capacity;
+	/* Level of detail each node was last drawn with, hysteresis needs it */
+	uint8_t *lods;
+	/* Depth of the view's occluders, hidden nodes leave the visible list */
+	struct occlusion_buffer occlusion;
+	unsigned int total_occlusion_tested;
+	unsigned int total_occlusion_hidden;
+	uint64_t total_occlusion_ns;
+
+	/* Deferred context, NULL if the view is drawn on the immediate context */
+	SceGxmContext *context;
+	void *context_host_mem;
+	SceUID command_memory_uid;
+	struct command_memory command_memory;
+	SceGxmCommandList command_list;
+	/* Time spent recording the command list of the last frame */
+	uint64_t record_ns;
+	uint64_t total_record_ns;
+};
 
 struct scene_state {
 	/* Portal's second end parameters */
@@ -71,11 +256,51 @@ struct scene_state {
 	float light_x_rot;
 	float light_y_rot;
 
-	struct light light;
+	/* In eye space, and where they are in the world */
+	struct light lights[SCENE_MAX_LIGHTS];
+	vector3f light_world_positions[SCENE_MAX_LIGHTS];
+	unsigned int light_count;
 
 	struct portal portal;
 };
 
+enum input_source {
+	/* Sample the pad and the clock */
+	INPUT_SOURCE_LIVE,
+	/* Sample them and save them to input_record */
+	INPUT_SOURCE_RECORD,
+	/* Read them back from input_record */
+	INPUT_SOURCE_REPLAY
+};
+
+/* State owned by the simulation, carried from one frame to the next */
+struct simulation {
+	SceCtrlData pad;
+	enum input_source input_source;
+	struct input_record input_record;
+	/* Scripted camera and portal, num_keys is 0 when they follow the pad */
+	struct camera_path camera_path;
+	/* Clock of the fixed timestep when running a camera path live */
+	uint64_t path_clock_ns;
+	/* Steps simulated so far */
+	uint64_t step_count;
+	struct fixed_timestep timestep;
+	struct camera camera;
+	struct scene_state scene_state;
+	/* State before the last step, rendering interpolates from it */
+	struct camera previous_camera;
+	struct scene_state previous_scene_state;
+	/* Frames simulated so far and how many to render, 0 for no limit */
+	unsigned int frame_count;
+	unsigned int frame_limit;
+};
+
+/* What the render thread needs from the simulation to draw a frame */
+struct frame_snapshot {
+	struct camera camera;
+	struct scene_state scene_state;
+};
+
 struct phong_material_gxm_params {
 	const SceGxmProgramParameter *ambient;
 	const SceGxmProgramParameter *diffuse;
@@ -88,8 +313,24 @@ struct light_gxm_params {
 	const SceGxmProgramParameter *color;
 };
 
+/*
+ * Formats for a color depth. The display, offscreen and texture views of
+ * the surfaces must agree, and so must the fragment programs: their
+ * UCHAR4 output fits the 32-bit register and is packed to the surface
+ * format when the tile is written out.
+ */
+struct color_mode {
+	SceGxmColorFormat color_format;
+	SceGxmTextureFormat texture_format;
+	unsigned int display_pixel_format;
+	SceGxmOutputRegisterFormat output_register_format;
+	SceGxmOutputRegisterSize output_register_size;
+	unsigned int bytes_per_pixel;
+};
+
 struct display_queue_callback_data {
 	void *addr;
+	int vsync;
 };
 
 extern unsigned char _binary_disable_color_buffer_v_gxp_start;
@@ -98,6 +339,12 @@ extern unsigned char _binary_clear_v_gxp_start;
 extern unsigned char _binary_clear_f_gxp_start;
 extern unsigned char _binary_cube_v_gxp_start;
 extern unsigned char _binary_cube_f_gxp_start;
+extern unsigned char _binary_cube_textured_v_gxp_start;
+extern unsigned char _binary_cube_textured_f_gxp_start;
+extern unsigned char _binary_portal_texture_v_gxp_start;
+extern unsigned char _binary_portal_texture_f_gxp_start;
+extern unsigned char _binary_upscale_v_gxp_start;
+extern unsigned char _binary_upscale_f_gxp_start;
 
 static const SceGxmProgram *const gxm_program_disable_color_buffer_v = (SceGxmProgram *)&_binary_disable_color_buffer_v_gxp_start;
 static const SceGxmProgram *const gxm_program_disable_color_buffer_f = (SceGxmProgram *)&_binary_disable_color_buffer_f_gxp_start;
@@ -105,6 +352,12 @@ static const SceGxmProgram *const gxm_program_clear_v = (SceGxmProgram *)&_binar
 static const SceGxmProgram *const gxm_program_clear_f = (SceGxmProgram *)&_binary_clear_f_gxp_start;
 static const SceGxmProgram *const gxm_program_cube_v = (SceGxmProgram *)&_binary_cube_v_gxp_start;
 static const SceGxmProgram *const gxm_program_cube_f = (SceGxmProgram *)&_binary_cube_f_gxp_start;
+static const SceGxmProgram *const gxm_program_cube_textured_v = (SceGxmProgram *)&_binary_cube_textured_v_gxp_start;
+static const SceGxmProgram *const gxm_program_cube_textured_f = (SceGxmProgram *)&_binary_cube_textured_f_gxp_start;
+static const SceGxmProgram *const gxm_program_portal_texture_v = (SceGxmProgram *)&_binary_portal_texture_v_gxp_start;
+static const SceGxmProgram *const gxm_program_portal_texture_f = (SceGxmProgram *)&_binary_portal_texture_f_gxp_start;
+static const SceGxmProgram *const gxm_program_upscale_v = (SceGxmProgram *)&_binary_upscale_v_gxp_start;
+static const SceGxmProgram *const gxm_program_upscale_f = (SceGxmProgram *)&_binary_upscale_f_gxp_start;
 
 static SceGxmContext *gxm_context;
 static SceUID vdm_ring_buffer_uid;
@@ -115,16 +368,46 @@ static SceUID fragment_ring_buffer_uid;
 static void *fragment_ring_buffer_addr;
 static SceUID fragment_usse_ring_buffer_uid;
 static void *fragment_usse_ring_buffer_addr;
+static const struct color_mode color_modes[] = {
+	[COLOR_DEPTH_32] = {
+		SCE_GXM_COLOR_FORMAT_A8B8G8R8,
+		SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR,
+		SCE_DISPLAY_PIXELFORMAT_A8B8G8R8,
+		SCE_GXM_OUTPUT_REGISTER_FORMAT_UCHAR4,
+		SCE_GXM_OUTPUT_REGISTER_SIZE_32BIT,
+		4
+	},
+	[COLOR_DEPTH_16] = {
+		SCE_GXM_COLOR_FORMAT_U5U6U5_RGB,
+		SCE_GXM_TEXTURE_FORMAT_U5U6U5_RGB,
+		SCE_DISPLAY_PIXELFORMAT_R5G6B5,
+		SCE_GXM_OUTPUT_REGISTER_FORMAT_UCHAR4,
+		SCE_GXM_OUTPUT_REGISTER_SIZE_32BIT,
+		2
+	},
+};
+static const struct color_mode *color_mode;
 static SceGxmRenderTarget *gxm_render_target;
-static SceGxmColorSurface gxm_color_surfaces[DISPLAY_BUFFER_COUNT];
-static SceUID gxm_color_surfaces_uid[DISPLAY_BUFFER_COUNT];
-static void *gxm_color_surfaces_addr[DISPLAY_BUFFER_COUNT];
-static SceGxmSyncObject *gxm_sync_objects[DISPLAY_BUFFER_COUNT];
+static unsigned int gxm_display_buffer_count;
+static SceGxmColorSurface gxm_color_surfaces[DISPLAY_MAX_BUFFER_COUNT];
+static SceUID gxm_color_surfaces_uid[DISPLAY_MAX_BUFFER_COUNT];
+static void *gxm_color_surfaces_addr[DISPLAY_MAX_BUFFER_COUNT];
+static SceGxmSyncObject *gxm_sync_objects[DISPLAY_MAX_BUFFER_COUNT];
 static unsigned int gxm_front_buffer_index;
 static unsigned int gxm_back_buffer_index;
 static SceUID gxm_depth_stencil_surface_uid;
 static void *gxm_depth_stencil_surface_addr;
 static SceGxmDepthStencilSurface gxm_depth_stencil_surface;
+static SceGxmRenderTarget *gxm_portal_render_target;
+static SceGxmColorSurface gxm_portal_color_surface;
+static SceUID gxm_portal_color_surface_uid;
+static void *gxm_portal_color_surface_addr;
+static SceGxmTexture gxm_portal_texture;
+static SceGxmRenderTarget *gxm_scene_render_target;
+static SceGxmColorSurface gxm_scene_color_surface;
+static SceUID gxm_scene_color_surface_uid;
+static void *gxm_scene_color_surface_addr;
+static SceGxmTexture gxm_scene_texture;
 static SceGxmShaderPatcher *gxm_shader_patcher;
 static SceUID gxm_shader_patcher_buffer_uid;
 static void *gxm_shader_patcher_buffer_addr;
@@ -157,40 +440,217 @@ static const SceGxmProgramParameter *gxm_cube_fragment_program_u_modelview_matri
 static const SceGxmProgramParameter *gxm_cube_fragment_program_u_normal_matrix_param;
 static struct phong_material_gxm_params gxm_cube_fragment_program_phong_material_params;
 static struct light_gxm_params gxm_cube_fragment_program_light_params;
+/* Only in the textured variant */
+static const SceGxmProgramParameter *gxm_cube_fragment_program_u_texture_param;
 static SceGxmVertexProgram *gxm_cube_vertex_program_patched;
 static SceGxmFragmentProgram *gxm_cube_fragment_program_patched;
 
-static struct mesh_vertex *cube_mesh_data;
-static unsigned short *cube_indices_data;
-static struct mesh_vertex *floor_mesh_data;
-static unsigned short *floor_indices_data;
-static struct mesh_vertex *portal_frame_mesh_data;
-static unsigned short *portal_frame_indices_data;
-
-static void set_vertex_default_uniform_data(const SceGxmProgramParameter *param,
-	unsigned int component_count, const void *data);
-static void set_fragment_default_uniform_data(const SceGxmProgramParameter *param,
-	unsigned int component_count, const void *data);
-static void set_cube_fragment_material_uniform_params(const struct phong_material *material,
-	const struct phong_material_gxm_params *params);
-static void set_cube_matrices_uniform_params(matrix4x4 mvp_matrix,
-	matrix4x4 modelview_matrix, matrix3x3 normal_matrix);
-static void set_cube_fragment_light_uniform_params(const struct light *light,
-	const struct light_gxm_params *params);
-
-static void update_camera(struct camera *camera, SceCtrlData *pad);
-static void draw_scene(const struct scene_state *state, matrix4x4 projection_matrix, matrix4x4 view_matrix);
-static void update_scene(struct scene_state *state, const struct camera *camera, SceCtrlData *pad);
-
-static void draw_cube(const struct scene_state *state, const matrix4x4 projection_matrix,
-	const matrix4x4 view_matrix, const matrix4x4 model_matrix, const struct phong_material *material);
-
-static void *gpu_alloc_map(SceKernelMemBlockType type, SceGxmMemoryAttribFlags gpu_attrib, size_t size, SceUID *uid);
-static void gpu_unmap_free(SceUID uid);
-static void *gpu_vertex_usse_alloc_map(size_t size, SceUID *uid, unsigned int *usse_offset);
-static void gpu_vertex_usse_unmap_free(SceUID uid);
-static void *gpu_fragment_usse_alloc_map(size_t size, SceUID *uid, unsigned int *usse_offset);
-static void gpu_fragment_usse_unmap_free(SceUID uid);
+/* --texture, the scene is drawn with cube_textured_v/f when it loads */
+static SceGxmTexture material_texture;
+static int material_textured;
+
+static SceGxmShaderPatcherId gxm_portal_texture_vertex_program_id;
+static SceGxmShaderPatcherId gxm_portal_texture_fragment_program_id;
+static const SceGxmProgramParameter *gxm_portal_texture_vertex_program_position_param;
+static const SceGxmProgramParameter *gxm_portal_texture_vertex_program_u_mvp_matrix_param;
+static const SceGxmProgramParameter *gxm_portal_texture_vertex_program_u_screen_to_texture_param;
+static const SceGxmProgramParameter *gxm_portal_texture_fragment_program_u_texture_param;
+static SceGxmVertexProgram *gxm_portal_texture_vertex_program_patched;
+static SceGxmFragmentProgram *gxm_portal_texture_fragment_program_patched;
+
+static SceGxmShaderPatcherId gxm_upscale_vertex_program_id;
+static SceGxmShaderPatcherId gxm_upscale_fragment_program_id;
+static const SceGxmProgramParameter *gxm_upscale_vertex_program_position_param;
+static const SceGxmProgramParameter *gxm_upscale_fragment_program_u_texture_param;
+static SceGxmVertexProgram *gxm_upscale_vertex_program_patched;
+static SceGxmFragmentProgram *gxm_upscale_fragment_program_patched;
+
+static struct clear_vertex *clear_vertices_data;
+static unsigned short *clear_indices_data;
+
+static struct mesh cube_mesh;
+static struct mesh floor_mesh;
+static struct mesh portal_frame_mesh;
+/* White unit shapes of the --scene objects, their materials color them */
+static struct mesh box_mesh;
+static struct mesh sphere_mesh;
+/* The cube mesh replace_cube_mesh() took out, freed at exit */
+static struct mesh retired_cube_mesh;
+
+/* Mesh and material handles of the scene store index these tables */
+enum scene_mesh {
+	SCENE_MESH_CUBE,
+	SCENE_MESH_FLOOR,
+	SCENE_MESH_PORTAL_FRAME,
+	SCENE_MESH_BOX,
+	SCENE_MESH_SPHERE,
+	SCENE_MESH_COUNT
+};
+
+enum scene_material {
+	SCENE_MATERIAL_PORTAL_FRAME,
+	SCENE_MATERIAL_CUBE,
+	SCENE_MATERIAL_FLOOR,
+	SCENE_MATERIAL_COUNT
+};
+
+static const struct mesh *const scene_meshes[SCENE_MESH_COUNT] = {
+	[SCENE_MESH_CUBE] = &cube_mesh,
+	[SCENE_MESH_FLOOR] = &floor_mesh,
+	[SCENE_MESH_PORTAL_FRAME] = &portal_frame_mesh,
+	[SCENE_MESH_BOX] = &box_mesh,
+	[SCENE_MESH_SPHERE] = &sphere_mesh
+};
+
+/* The materials --scene generated follow these */
+static struct phong_material scene_materials[SCENE_MATERIAL_COUNT + SCENE_GEN_MAX_MATERIALS] = {
+	[SCENE_MATERIAL_PORTAL_FRAME] = {
+		.ambient = {.r = 0.2f, .g = 0.2f, .b = 0.2f},
+		.diffuse = {.r = 0.6f, .g = 0.6f, .b = 0.6f},
+		.specular = {.r = 0.6f, .g = 0.6f, .b = 0.6f},
+		.shininess = 40.0f
+	},
+	[SCENE_MATERIAL_CUBE] = {
+		.ambient = {.r = 0.1f, .g = 0.1f, .b = 0.1f},
+		.diffuse = {.r = 0.8f, .g = 0.8f, .b = 0.8f},
+		.specular = {.r = 0.6f, .g = 0.6f, .b = 0.6f},
+		.shininess = 80.0f
+	},
+	[SCENE_MATERIAL_FLOOR] = {
+		.ambient = {.r = 0.1f, .g = 0.1f, .b = 0.1f},
+		.diffuse = {.r = 0.8f, .g = 0.8f, .b = 0.8f},
+		.specular = {.r = 0.7f, .g = 0.7f, .b = 0.7f},
+		.shininess = 20.0f
+	}
+};
+
+/*
+ * The objects of the scene. Only the render thread touches it, the
+ * simulation's state reaches it through the frame snapshots.
+ */
+static struct scene_store scene_store;
+
+/*
+ * Portal pairs --scene generated. The portal view goes through one pair
+ * per frame, the demo's or the nearest of these, see select_portal().
+ */
+static struct portal scene_portals[SCENE_GEN_MAX_PORTALS];
+static unsigned int scene_portal_count;
+static unsigned int total_portal_switches;
+
+/* Archive of --assets=FILE, streamed while the demo runs */
+static struct asset_archive asset_archive;
+static struct asset_loader asset_loader;
+static int assets_loading;
+static uint64_t assets_start_ns;
+static unsigned int assets_frames;
+static SceUID streamed_mesh_uid = -1;
+
+/* Culling hierarchy over the bounding spheres of the scene nodes */
+static struct bvh scene_bvh;
+static struct bvh_aabb *scene_bvh_boxes;
+static unsigned int scene_bvh_box_capacity;
+
+static struct view views[VIEW_COUNT];
+/* Divides the screen sizes, raising it sheds load with coarser levels */
+static float lod_bias = 1.0f;
+/*
+ * Whether the main view may see the portal, set by the cull job. When it
+ * doesn't, the portal passes are skipped.
+ */
+static int portal_visible;
+static unsigned int total_portal_skipped;
+/* World matrices the last transform update recomputed */
+static unsigned int scene_world_updated;
+
+/*
+ * Texture mode: the portal's footprint on the screen this frame, and
+ * whether the cull job found the texture still holds the portal view.
+ */
+static enum portal_mode portal_mode;
+static struct portal_rect portal_rect;
+/* Size of the portal texture this frame, its corner of the portal view */
+static unsigned int portal_texture_width;
+static unsigned int portal_texture_height;
+static struct portal_texture portal_texture;
+static int portal_texture_reused;
+static unsigned int total_portal_texture_reused;
+
+static struct simulation simulation;
+static struct frame_snapshot frame_snapshots[FRAME_PIPELINE_MAX_SLOTS];
+static struct frame_pipeline frame_pipeline;
+
+static void set_vertex_default_uniform_data(SceGxmContext *context,
+	const SceGxmProgramParameter *param, unsigned int component_count, const void *data);
+static void set_fragment_default_uniform_data(SceGxmContext *context,
+	const SceGxmProgramParameter *param, unsigned int component_count, const void *data);
+static void set_cube_fragment_material_uniform_params(SceGxmContext *context,
+	const struct phong_material *material, const struct phong_material_gxm_params *params);
+static void set_cube_matrices_uniform_params(SceGxmContext *context, const matrix4x4 mvp_matrix,
+	const matrix4x4 modelview_matrix, const matrix3x3 normal_matrix);
+static void set_cube_fragment_light_uniform_params(SceGxmContext *context,
+	const struct light *light, const struct light_gxm_params *params);
+
+static int simulate_frame(void *user_data, void *snapshot_data);
+static void update_camera(struct camera *camera, SceCtrlData *pad, float dt);
+static void update_scene(struct scene_state *state, SceCtrlData *pad, float dt);
+static void update_scene_derived(struct scene_state *state, const struct camera *camera);
+static void interpolate_simulation(struct frame_snapshot *snapshot,
+	const struct simulation *sim, float alpha);
+static void simulation_open_input(struct simulation *sim, const struct options *options);
+static void simulation_close_input(struct simulation *sim);
+static void apply_camera_path(struct simulation *sim, float time);
+static uint32_t scene_add_object(struct scene_store *store, uint32_t parent,
+	enum scene_mesh mesh, unsigned int material,
+	const vector3f *translation, const vector3f *rotation, const vector3f *scale);
+static int scene_generate(const struct scene_gen_params *params, struct scene_state *state,
+	uint32_t floor_node);
+static void select_portal(struct scene_state *state, const struct camera *camera,
+	const matrix4x4 projection_matrix);
+static unsigned int nearest_light(const struct scene_state *state, const vector3f *position);
+
+static void update_local_transforms(void *data, unsigned int start, unsigned int count);
+static void update_world_transforms(struct job *job, void *data);
+static void update_scene_bvh(const struct scene_store *store, unsigned int updated);
+static void cull_views(struct job *job, void *data);
+static void occlusion_cull_view(struct view *view);
+static int portal_test_visible(const struct view *view);
+static void portal_footprint(struct portal_rect *rect, const matrix4x4 projection_matrix,
+	const matrix4x4 camera_view_matrix, const struct portal *portal);
+static void portal_texture_view_init(struct view *view, const struct scene_state *state,
+	const struct scene_store *store, const matrix4x4 projection_matrix,
+	const matrix4x4 view_matrix, const matrix4x4 camera_view_matrix, float scale);
+static int portal_texture_can_reuse(const struct view *view);
+static void portal_texture_set_contents(const struct view *view);
+static void view_init(struct view *view, const struct scene_state *state,
+	const struct scene_store *store, const matrix4x4 projection_matrix,
+	const matrix4x4 view_matrix);
+static void prepare_view_draw_packets(void *data, unsigned int start, unsigned int count);
+static unsigned int select_lod(const struct mesh *mesh, float size, unsigned int current);
+static void mesh_build_lods(struct mesh *mesh, unsigned int vertex_count, size_t vertex_size);
+static void mesh_free_lods(struct mesh *mesh);
+static int mesh_generate(struct mesh *mesh, const struct mesh_gen_shape *shape, SceUID *uid);
+static void mesh_init_file(struct mesh *mesh, const struct mesh_file_header *header);
+static int mesh_load_file(struct mesh *mesh, const char *path, SceUID *uid);
+static int texture_load_file(SceGxmTexture *texture, const char *path, SceUID *uid);
+static void replace_cube_mesh(const struct mesh *mesh);
+static int assets_start(const char *path);
+static void assets_stop(void);
+static void assets_update(void);
+static void assets_print_progress(void);
+static void draw_scene(SceGxmContext *context, const struct view *view);
+static void draw_clear(SceGxmContext *context);
+static void set_viewport(SceGxmContext *context, unsigned int width, unsigned int height);
+static unsigned int scale_size(unsigned int size, float scale);
+static void view_create_deferred_context(struct view *view, enum view_id id,
+	unsigned int scene_draws);
+static void view_destroy_deferred_context(struct view *view);
+static void set_view_render_state(SceGxmContext *context, const struct view *view);
+static void record_view(struct job *job, void *data);
+static void draw_view(struct view *view);
+static void print_view_record_stats(unsigned int frames);
+static void print_occlusion_stats(unsigned int frames);
+
 static void *shader_patcher_host_alloc_cb(void *user_data, unsigned int size);
 static void shader_patcher_host_free_cb(void *user_data, void *mem);
 static void display_queue_callback(const void *callbackData);
@@ -199,32 +659,64 @@ int main(int argc, char *argv[])
 {
 	int i;
 
+	struct options options;
+	options_init_default(&options);
+	if (options_parse(&options, argc, argv) < 0) {
+		options_print_usage(argc > 0 ? argv[0] : "gxmfun");
+		return 1;
+	}
+	lod_bias = options.lod_bias;
+	portal_mode = options.portal_mode;
+	color_mode = &color_modes[options.color_depth];
+
+	if (profiler_init(options.profile_path) < 0)
+		printf("Could not create profile file %s\n", options.profile_path);
+	profiler_set_thread_name("render");
+
+	if (render_counters_init(options.counters_path) < 0)
+		printf("Could not create counters file %s\n", options.counters_path);
+
+	if (options.trace_path && gxm_trace_begin(options.trace_path) < 0)
+		printf("Could not create trace file %s\n", options.trace_path);
+
+	job_system_init(0);
+
 	sceCtrlSetSamplingMode(SCE_CTRL_MODE_ANALOG);
 
 	SceGxmInitializeParams gxm_init_params;
 	memset(&gxm_init_params, 0, sizeof(gxm_init_params));
 	gxm_init_params.flags = 0;
-	gxm_init_params.displayQueueMaxPendingCount = MAX_PENDING_SWAPS;
+	/*
+	 * In low latency mode at most one frame waits for display, so the
+	 * CPU never gets more than one frame ahead of the screen. In
+	 * throughput mode every back buffer can be queued, which absorbs
+	 * GPU hiccups at the cost of up to (buffers - 1) frames of latency.
+	 */
+	gxm_display_buffer_count = options.display_buffers;
+	if (options.display_latency == DISPLAY_LATENCY_THROUGHPUT)
+		gxm_init_params.displayQueueMaxPendingCount = gxm_display_buffer_count - 1;
+	else
+		gxm_init_params.displayQueueMaxPendingCount = 1;
 	gxm_init_params.displayQueueCallback = display_queue_callback;
 	gxm_init_params.displayQueueCallbackDataSize = sizeof(struct display_queue_callback_data);
 	gxm_init_params.parameterBufferSize = SCE_GXM_DEFAULT_PARAMETER_BUFFER_SIZE;
 
 	sceGxmInitialize(&gxm_init_params);
 
-	vdm_ring_buffer_addr = gpu_alloc_map(SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
-		SCE_GXM_MEMORY_ATTRIB_READ, SCE_GXM_DEFAULT_VDM_RING_BUFFER_SIZE,
-		&vdm_ring_buffer_uid);
+	vdm_ring_buffer_addr = gpu_alloc_map(GPU_MEMORY_RING_BUFFERS,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW, SCE_GXM_MEMORY_ATTRIB_READ,
+		SCE_GXM_DEFAULT_VDM_RING_BUFFER_SIZE, &vdm_ring_buffer_uid);
 
-	vertex_ring_buffer_addr = gpu_alloc_map(SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
-		SCE_GXM_MEMORY_ATTRIB_READ, SCE_GXM_DEFAULT_VERTEX_RING_BUFFER_SIZE,
-		&vertex_ring_buffer_uid);
+	vertex_ring_buffer_addr = gpu_alloc_map(GPU_MEMORY_RING_BUFFERS,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW, SCE_GXM_MEMORY_ATTRIB_READ,
+		SCE_GXM_DEFAULT_VERTEX_RING_BUFFER_SIZE, &vertex_ring_buffer_uid);
 
-	fragment_ring_buffer_addr = gpu_alloc_map(SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
-		SCE_GXM_MEMORY_ATTRIB_READ, SCE_GXM_DEFAULT_FRAGMENT_RING_BUFFER_SIZE,
-		&fragment_ring_buffer_uid);
+	fragment_ring_buffer_addr = gpu_alloc_map(GPU_MEMORY_RING_BUFFERS,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW, SCE_GXM_MEMORY_ATTRIB_READ,
+		SCE_GXM_DEFAULT_FRAGMENT_RING_BUFFER_SIZE, &fragment_ring_buffer_uid);
 
 	unsigned int fragment_usse_offset;
-	fragment_usse_ring_buffer_addr = gpu_fragment_usse_alloc_map(
+	fragment_usse_ring_buffer_addr = gpu_fragment_usse_alloc_map(GPU_MEMORY_RING_BUFFERS,
 		SCE_GXM_DEFAULT_FRAGMENT_USSE_RING_BUFFER_SIZE,
 		&fragment_usse_ring_buffer_uid, &fragment_usse_offset);
 
@@ -244,6 +736,10 @@ int main(int argc, char *argv[])
 
 	sceGxmCreateContext(&gxm_context_params, &gxm_context);
 
+	for (i = 0; i < VIEW_COUNT; i++)
+		view_create_deferred_context(&views[i], i,
+			options.scene.object_count + 2 * options.scene.portal_count);
+
 	SceGxmRenderTargetParams render_target_params;
 	memset(&render_target_params, 0, sizeof(render_target_params));
 	render_target_params.flags = 0;
@@ -256,19 +752,22 @@ int main(int argc, char *argv[])
 
 	sceGxmCreateRenderTarget(&render_target_params, &gxm_render_target);
 
-	for (i = 0; i < DISPLAY_BUFFER_COUNT; i++) {
-		gxm_color_surfaces_addr[i] = gpu_alloc_map(SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
+	for (i = 0; i < gxm_display_buffer_count; i++) {
+		gxm_color_surfaces_addr[i] = gpu_alloc_map(GPU_MEMORY_SURFACES,
+			SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
 			SCE_GXM_MEMORY_ATTRIB_READ | SCE_GXM_MEMORY_ATTRIB_WRITE,
-			ALIGN(4 * DISPLAY_STRIDE * DISPLAY_HEIGHT, 1 * 1024 * 1024),
+			ALIGN(color_mode->bytes_per_pixel * DISPLAY_STRIDE * DISPLAY_HEIGHT,
+				1 * 1024 * 1024),
 			&gxm_color_surfaces_uid[i]);
 
-		memset(gxm_color_surfaces_addr[i], 0, DISPLAY_STRIDE * DISPLAY_HEIGHT);
+		memset(gxm_color_surfaces_addr[i], 0,
+			color_mode->bytes_per_pixel * DISPLAY_STRIDE * DISPLAY_HEIGHT);
 
 		sceGxmColorSurfaceInit(&gxm_color_surfaces[i],
-			DISPLAY_COLOR_FORMAT,
+			color_mode->color_format,
 			SCE_GXM_COLOR_SURFACE_LINEAR,
 			SCE_GXM_COLOR_SURFACE_SCALE_NONE,
-			SCE_GXM_OUTPUT_REGISTER_SIZE_32BIT,
+			color_mode->output_register_size,
 			DISPLAY_WIDTH,
 			DISPLAY_HEIGHT,
 			DISPLAY_STRIDE,
@@ -281,7 +780,8 @@ int main(int argc, char *argv[])
 	unsigned int depth_stencil_height = ALIGN(DISPLAY_HEIGHT, SCE_GXM_TILE_SIZEY);
 	unsigned int depth_stencil_samples = depth_stencil_width * depth_stencil_height;
 
-	gxm_depth_stencil_surface_addr = gpu_alloc_map(SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
+	gxm_depth_stencil_surface_addr = gpu_alloc_map(GPU_MEMORY_SURFACES,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
 		SCE_GXM_MEMORY_ATTRIB_READ | SCE_GXM_MEMORY_ATTRIB_WRITE,
 		4 * depth_stencil_samples, &gxm_depth_stencil_surface_uid);
 
@@ -292,21 +792,73 @@ int main(int argc, char *argv[])
 		gxm_depth_stencil_surface_addr,
 		NULL);
 
+	/*
+	 * Texture mode renders the portal view at the top left of its own
+	 * target, sized for a portal covering the screen. The scene ends
+	 * before the main one begins, so it shares the depth/stencil surface.
+	 */
+	if (options.portal_mode == PORTAL_MODE_TEXTURE) {
+		sceGxmCreateRenderTarget(&render_target_params, &gxm_portal_render_target);
+
+		gxm_portal_color_surface_addr = gpu_alloc_map(GPU_MEMORY_SURFACES,
+			SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
+			SCE_GXM_MEMORY_ATTRIB_READ | SCE_GXM_MEMORY_ATTRIB_WRITE,
+			ALIGN(color_mode->bytes_per_pixel * DISPLAY_STRIDE * DISPLAY_HEIGHT,
+				1 * 1024 * 1024),
+			&gxm_portal_color_surface_uid);
+
+		sceGxmColorSurfaceInit(&gxm_portal_color_surface,
+			color_mode->color_format,
+			SCE_GXM_COLOR_SURFACE_LINEAR,
+			SCE_GXM_COLOR_SURFACE_SCALE_NONE,
+			color_mode->output_register_size,
+			DISPLAY_WIDTH,
+			DISPLAY_HEIGHT,
+			DISPLAY_STRIDE,
+			gxm_portal_color_surface_addr);
+	}
+
+	/*
+	 * Dynamic resolution renders the scene at the top left of this
+	 * surface, then stretches it over the display surface.
+	 */
+	if (options.dynamic_resolution) {
+		sceGxmCreateRenderTarget(&render_target_params, &gxm_scene_render_target);
+
+		gxm_scene_color_surface_addr = gpu_alloc_map(GPU_MEMORY_SURFACES,
+			SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
+			SCE_GXM_MEMORY_ATTRIB_READ | SCE_GXM_MEMORY_ATTRIB_WRITE,
+			ALIGN(color_mode->bytes_per_pixel * DISPLAY_STRIDE * DISPLAY_HEIGHT,
+				1 * 1024 * 1024),
+			&gxm_scene_color_surface_uid);
+
+		sceGxmColorSurfaceInit(&gxm_scene_color_surface,
+			color_mode->color_format,
+			SCE_GXM_COLOR_SURFACE_LINEAR,
+			SCE_GXM_COLOR_SURFACE_SCALE_NONE,
+			color_mode->output_register_size,
+			DISPLAY_WIDTH,
+			DISPLAY_HEIGHT,
+			DISPLAY_STRIDE,
+			gxm_scene_color_surface_addr);
+	}
+
 	static const unsigned int shader_patcher_buffer_size = 64 * 1024;
 	static const unsigned int shader_patcher_vertex_usse_size = 64 * 1024;
 	static const unsigned int shader_patcher_fragment_usse_size = 64 * 1024;
 
-	gxm_shader_patcher_buffer_addr = gpu_alloc_map(SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
+	gxm_shader_patcher_buffer_addr = gpu_alloc_map(GPU_MEMORY_SHADER_PATCHER,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW,
 		SCE_GXM_MEMORY_ATTRIB_READ | SCE_GXM_MEMORY_ATTRIB_READ,
 		shader_patcher_buffer_size, &gxm_shader_patcher_buffer_uid);
 
 	unsigned int shader_patcher_vertex_usse_offset;
-	gxm_shader_patcher_vertex_usse_addr = gpu_vertex_usse_alloc_map(
+	gxm_shader_patcher_vertex_usse_addr = gpu_vertex_usse_alloc_map(GPU_MEMORY_SHADER_PATCHER,
 		shader_patcher_vertex_usse_size, &gxm_shader_patcher_vertex_usse_uid,
 		&shader_patcher_vertex_usse_offset);
 
 	unsigned int shader_patcher_fragment_usse_offset;
-	gxm_shader_patcher_fragment_usse_addr = gpu_fragment_usse_alloc_map(
+	gxm_shader_patcher_fragment_usse_addr = gpu_fragment_usse_alloc_map(GPU_MEMORY_SHADER_PATCHER,
 		shader_patcher_fragment_usse_size, &gxm_shader_patcher_fragment_usse_uid,
 		&shader_patcher_fragment_usse_offset);
 
@@ -373,7 +925,7 @@ int main(int argc, char *argv[])
 
 	sceGxmShaderPatcherCreateFragmentProgram(gxm_shader_patcher,
 		gxm_disable_color_buffer_fragment_program_id,
-		SCE_GXM_OUTPUT_REGISTER_FORMAT_UCHAR4,
+		color_mode->output_register_format,
 		SCE_GXM_MULTISAMPLE_NONE,
 		&disable_color_buffer_blend_info,
 		disable_color_buffer_vertex_program,
@@ -411,17 +963,17 @@ int main(int argc, char *argv[])
 		1, &clear_vertex_stream, 1, &gxm_clear_vertex_program_patched);
 
 	sceGxmShaderPatcherCreateFragmentProgram(gxm_shader_patcher,
-		gxm_clear_fragment_program_id, SCE_GXM_OUTPUT_REGISTER_FORMAT_UCHAR4,
+		gxm_clear_fragment_program_id, color_mode->output_register_format,
 		SCE_GXM_MULTISAMPLE_NONE, NULL, clear_vertex_program,
 		&gxm_clear_fragment_program_patched);
 
 	SceUID clear_vertices_uid;
-	struct clear_vertex *const clear_vertices_data = gpu_alloc_map(
+	clear_vertices_data = gpu_alloc_map(GPU_MEMORY_MESHES,
 		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
 		4 * sizeof(struct clear_vertex), &clear_vertices_uid);
 
 	SceUID clear_indices_uid;
-	unsigned short *const clear_indices_data = gpu_alloc_map(
+	clear_indices_data = gpu_alloc_map(GPU_MEMORY_MESHES,
 		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
 		4 * sizeof(unsigned short), &clear_indices_uid);
 
@@ -435,9 +987,22 @@ int main(int argc, char *argv[])
 	clear_indices_data[2] = 2;
 	clear_indices_data[3] = 3;
 
-	sceGxmShaderPatcherRegisterProgram(gxm_shader_patcher, gxm_program_cube_v,
+	/* The textured variant of the cube programs takes the same uniforms and a texture */
+	SceUID material_texture_uid = -1;
+	if (options.texture_path) {
+		if (texture_load_file(&material_texture, options.texture_path,
+		    &material_texture_uid) == 0) {
+			material_textured = 1;
+		} else {
+			printf("Could not load texture %s\n", options.texture_path);
+		}
+	}
+
+	sceGxmShaderPatcherRegisterProgram(gxm_shader_patcher,
+		material_textured ? gxm_program_cube_textured_v : gxm_program_cube_v,
 		&gxm_cube_vertex_program_id);
-	sceGxmShaderPatcherRegisterProgram(gxm_shader_patcher, gxm_program_cube_f,
+	sceGxmShaderPatcherRegisterProgram(gxm_shader_patcher,
+		material_textured ? gxm_program_cube_textured_f : gxm_program_cube_f,
 		&gxm_cube_fragment_program_id);
 
 	const SceGxmProgram *cube_vertex_program =
@@ -472,6 +1037,8 @@ int main(int argc, char *argv[])
 		cube_fragment_program, "u_light.position");
 	gxm_cube_fragment_program_light_params.color = sceGxmProgramFindParameterByName(
 		cube_fragment_program, "u_light.color");
+	gxm_cube_fragment_program_u_texture_param = sceGxmProgramFindParameterByName(
+		cube_fragment_program, "u_texture");
 
 	SceGxmVertexAttribute cube_vertex_attributes[3];
 	SceGxmVertexStream cube_vertex_stream;
@@ -501,44 +1068,85 @@ int main(int argc, char *argv[])
 		3, &cube_vertex_stream, 1, &gxm_cube_vertex_program_patched);
 
 	sceGxmShaderPatcherCreateFragmentProgram(gxm_shader_patcher,
-		gxm_cube_fragment_program_id, SCE_GXM_OUTPUT_REGISTER_FORMAT_UCHAR4,
+		gxm_cube_fragment_program_id, color_mode->output_register_format,
 		SCE_GXM_MULTISAMPLE_NONE, NULL, cube_vertex_program,
 		&gxm_cube_fragment_program_patched);
 
-	SceUID cube_mesh_uid;
-	cube_mesh_data = gpu_alloc_map(
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
-		36 * sizeof(struct mesh_vertex), &cube_mesh_uid);
+	sceGxmShaderPatcherRegisterProgram(gxm_shader_patcher, gxm_program_portal_texture_v,
+		&gxm_portal_texture_vertex_program_id);
+	sceGxmShaderPatcherRegisterProgram(gxm_shader_patcher, gxm_program_portal_texture_f,
+		&gxm_portal_texture_fragment_program_id);
+
+	const SceGxmProgram *portal_texture_vertex_program =
+		sceGxmShaderPatcherGetProgramFromId(gxm_portal_texture_vertex_program_id);
+	const SceGxmProgram *portal_texture_fragment_program =
+		sceGxmShaderPatcherGetProgramFromId(gxm_portal_texture_fragment_program_id);
+
+	gxm_portal_texture_vertex_program_position_param = sceGxmProgramFindParameterByName(
+		portal_texture_vertex_program, "position");
+	gxm_portal_texture_vertex_program_u_mvp_matrix_param = sceGxmProgramFindParameterByName(
+		portal_texture_vertex_program, "u_mvp_matrix");
+	gxm_portal_texture_vertex_program_u_screen_to_texture_param = sceGxmProgramFindParameterByName(
+		portal_texture_vertex_program, "u_screen_to_texture");
+	gxm_portal_texture_fragment_program_u_texture_param = sceGxmProgramFindParameterByName(
+		portal_texture_fragment_program, "u_texture");
+
+	SceGxmVertexAttribute portal_texture_vertex_attributes;
+	SceGxmVertexStream portal_texture_vertex_stream;
+	portal_texture_vertex_attributes.streamIndex = 0;
+	portal_texture_vertex_attributes.offset = 0;
+	portal_texture_vertex_attributes.format = SCE_GXM_ATTRIBUTE_FORMAT_F32;
+	portal_texture_vertex_attributes.componentCount = 3;
+	portal_texture_vertex_attributes.regIndex = sceGxmProgramParameterGetResourceIndex(
+		gxm_portal_texture_vertex_program_position_param);
+	portal_texture_vertex_stream.stride = sizeof(struct position_vertex);
+	portal_texture_vertex_stream.indexSource = SCE_GXM_INDEX_SOURCE_INDEX_16BIT;
 
-	SceUID cube_indices_uid;
-	cube_indices_data = gpu_alloc_map(
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
-		36 * sizeof(unsigned short), &cube_indices_uid);
+	sceGxmShaderPatcherCreateVertexProgram(gxm_shader_patcher,
+		gxm_portal_texture_vertex_program_id, &portal_texture_vertex_attributes,
+		1, &portal_texture_vertex_stream, 1, &gxm_portal_texture_vertex_program_patched);
 
-	#define CUBE_SIZE 1.0f
-	#define CUBE_HALF_SIZE (CUBE_SIZE / 2.0f)
-
-	static const vector3f cube_vertices[] = {
-		{.x = -CUBE_HALF_SIZE, .y = +CUBE_HALF_SIZE, .z = +CUBE_HALF_SIZE},
-		{.x = -CUBE_HALF_SIZE, .y = -CUBE_HALF_SIZE, .z = +CUBE_HALF_SIZE},
-		{.x = +CUBE_HALF_SIZE, .y = +CUBE_HALF_SIZE, .z = +CUBE_HALF_SIZE},
-		{.x = +CUBE_HALF_SIZE, .y = -CUBE_HALF_SIZE, .z = +CUBE_HALF_SIZE},
-		{.x = +CUBE_HALF_SIZE, .y = +CUBE_HALF_SIZE, .z = -CUBE_HALF_SIZE},
-		{.x = +CUBE_HALF_SIZE, .y = -CUBE_HALF_SIZE, .z = -CUBE_HALF_SIZE},
-		{.x = -CUBE_HALF_SIZE, .y = +CUBE_HALF_SIZE, .z = -CUBE_HALF_SIZE},
-		{.x = -CUBE_HALF_SIZE, .y = -CUBE_HALF_SIZE, .z = -CUBE_HALF_SIZE}
-	};
+	sceGxmShaderPatcherCreateFragmentProgram(gxm_shader_patcher,
+		gxm_portal_texture_fragment_program_id, color_mode->output_register_format,
+		SCE_GXM_MULTISAMPLE_NONE, NULL, portal_texture_vertex_program,
+		&gxm_portal_texture_fragment_program_patched);
+
+	sceGxmShaderPatcherRegisterProgram(gxm_shader_patcher, gxm_program_upscale_v,
+		&gxm_upscale_vertex_program_id);
+	sceGxmShaderPatcherRegisterProgram(gxm_shader_patcher, gxm_program_upscale_f,
+		&gxm_upscale_fragment_program_id);
+
+	const SceGxmProgram *upscale_vertex_program =
+		sceGxmShaderPatcherGetProgramFromId(gxm_upscale_vertex_program_id);
+	const SceGxmProgram *upscale_fragment_program =
+		sceGxmShaderPatcherGetProgramFromId(gxm_upscale_fragment_program_id);
+
+	gxm_upscale_vertex_program_position_param = sceGxmProgramFindParameterByName(
+		upscale_vertex_program, "position");
+	gxm_upscale_fragment_program_u_texture_param = sceGxmProgramFindParameterByName(
+		upscale_fragment_program, "u_texture");
+
+	SceGxmVertexAttribute upscale_vertex_attributes;
+	SceGxmVertexStream upscale_vertex_stream;
+	upscale_vertex_attributes.streamIndex = 0;
+	upscale_vertex_attributes.offset = 0;
+	upscale_vertex_attributes.format = SCE_GXM_ATTRIBUTE_FORMAT_F32;
+	upscale_vertex_attributes.componentCount = 2;
+	upscale_vertex_attributes.regIndex = sceGxmProgramParameterGetResourceIndex(
+		gxm_upscale_vertex_program_position_param);
+	upscale_vertex_stream.stride = sizeof(struct clear_vertex);
+	upscale_vertex_stream.indexSource = SCE_GXM_INDEX_SOURCE_INDEX_16BIT;
 
-	static const vector3f cube_face_normals[] = {
-		{.x =  0.0f, .y =  0.0f, .z =  1.0f}, /* Front */
-		{.x =  1.0f, .y =  0.0f, .z =  0.0f}, /* Right */
-		{.x =  0.0f, .y =  0.0f, .z = -1.0f}, /* Back */
-		{.x = -1.0f, .y =  0.0f, .z =  0.0f}, /* Left */
-		{.x =  0.0f, .y =  1.0f, .z =  0.0f}, /* Top */
-		{.x =  0.0f, .y = -1.0f, .z =  0.0f}, /* Bottom */
-	};
+	sceGxmShaderPatcherCreateVertexProgram(gxm_shader_patcher,
+		gxm_upscale_vertex_program_id, &upscale_vertex_attributes,
+		1, &upscale_vertex_stream, 1, &gxm_upscale_vertex_program_patched);
+
+	sceGxmShaderPatcherCreateFragmentProgram(gxm_shader_patcher,
+		gxm_upscale_fragment_program_id, color_mode->output_register_format,
+		SCE_GXM_MULTISAMPLE_NONE, NULL, upscale_vertex_program,
+		&gxm_upscale_fragment_program_patched);
 
-	static const vector4f cube_colors[] = {
+	static const vector4f cube_colors[MESH_GEN_FACE_COUNT] = {
 		{.r = 1.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f},
 		{.r = 0.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f},
 		{.r = 0.0f, .g = 0.0f, .b = 1.0f, .a = 1.0f},
@@ -547,186 +1155,140 @@ int main(int argc, char *argv[])
 		{.r = 1.0f, .g = 0.0f, .b = 1.0f, .a = 1.0f},
 	};
 
-	cube_mesh_data[0] = (struct mesh_vertex){cube_vertices[0], cube_face_normals[0], cube_colors[0]};
-	cube_mesh_data[1] = (struct mesh_vertex){cube_vertices[1], cube_face_normals[0], cube_colors[0]};
-	cube_mesh_data[2] = (struct mesh_vertex){cube_vertices[2], cube_face_normals[0], cube_colors[0]};
-	cube_mesh_data[3] = (struct mesh_vertex){cube_vertices[2], cube_face_normals[0], cube_colors[0]};
-	cube_mesh_data[4] = (struct mesh_vertex){cube_vertices[1], cube_face_normals[0], cube_colors[0]};
-	cube_mesh_data[5] = (struct mesh_vertex){cube_vertices[3], cube_face_normals[0], cube_colors[0]};
-
-	cube_mesh_data[6] = (struct mesh_vertex){cube_vertices[2], cube_face_normals[1], cube_colors[1]};
-	cube_mesh_data[7] = (struct mesh_vertex){cube_vertices[3], cube_face_normals[1], cube_colors[1]};
-	cube_mesh_data[8] = (struct mesh_vertex){cube_vertices[4], cube_face_normals[1], cube_colors[1]};
-	cube_mesh_data[9] = (struct mesh_vertex){cube_vertices[4], cube_face_normals[1], cube_colors[1]};
-	cube_mesh_data[10] = (struct mesh_vertex){cube_vertices[3], cube_face_normals[1], cube_colors[1]};
-	cube_mesh_data[11] = (struct mesh_vertex){cube_vertices[5], cube_face_normals[1], cube_colors[1]};
-
-	cube_mesh_data[12] = (struct mesh_vertex){cube_vertices[4], cube_face_normals[2], cube_colors[2]};
-	cube_mesh_data[13] = (struct mesh_vertex){cube_vertices[5], cube_face_normals[2], cube_colors[2]};
-	cube_mesh_data[14] = (struct mesh_vertex){cube_vertices[6], cube_face_normals[2], cube_colors[2]};
-	cube_mesh_data[15] = (struct mesh_vertex){cube_vertices[6], cube_face_normals[2], cube_colors[2]};
-	cube_mesh_data[16] = (struct mesh_vertex){cube_vertices[5], cube_face_normals[2], cube_colors[2]};
-	cube_mesh_data[17] = (struct mesh_vertex){cube_vertices[7], cube_face_normals[2], cube_colors[2]};
-
-	cube_mesh_data[18] = (struct mesh_vertex){cube_vertices[6], cube_face_normals[3], cube_colors[3]};
-	cube_mesh_data[19] = (struct mesh_vertex){cube_vertices[7], cube_face_normals[3], cube_colors[3]};
-	cube_mesh_data[20] = (struct mesh_vertex){cube_vertices[0], cube_face_normals[3], cube_colors[3]};
-	cube_mesh_data[21] = (struct mesh_vertex){cube_vertices[0], cube_face_normals[3], cube_colors[3]};
-	cube_mesh_data[22] = (struct mesh_vertex){cube_vertices[7], cube_face_normals[3], cube_colors[3]};
-	cube_mesh_data[23] = (struct mesh_vertex){cube_vertices[1], cube_face_normals[3], cube_colors[3]};
-
-	cube_mesh_data[24] = (struct mesh_vertex){cube_vertices[6], cube_face_normals[4], cube_colors[4]};
-	cube_mesh_data[25] = (struct mesh_vertex){cube_vertices[0], cube_face_normals[4], cube_colors[4]};
-	cube_mesh_data[26] = (struct mesh_vertex){cube_vertices[4], cube_face_normals[4], cube_colors[4]};
-	cube_mesh_data[27] = (struct mesh_vertex){cube_vertices[4], cube_face_normals[4], cube_colors[4]};
-	cube_mesh_data[28] = (struct mesh_vertex){cube_vertices[0], cube_face_normals[4], cube_colors[4]};
-	cube_mesh_data[29] = (struct mesh_vertex){cube_vertices[2], cube_face_normals[4], cube_colors[4]};
-
-	cube_mesh_data[30] = (struct mesh_vertex){cube_vertices[1], cube_face_normals[5], cube_colors[5]};
-	cube_mesh_data[31] = (struct mesh_vertex){cube_vertices[7], cube_face_normals[5], cube_colors[5]};
-	cube_mesh_data[32] = (struct mesh_vertex){cube_vertices[3], cube_face_normals[5], cube_colors[5]};
-	cube_mesh_data[33] = (struct mesh_vertex){cube_vertices[3], cube_face_normals[5], cube_colors[5]};
-	cube_mesh_data[34] = (struct mesh_vertex){cube_vertices[7], cube_face_normals[5], cube_colors[5]};
-	cube_mesh_data[35] = (struct mesh_vertex){cube_vertices[5], cube_face_normals[5], cube_colors[5]};
-
-	for (i = 0; i < 36; i++)
-		cube_indices_data[i] = i;
-
-	SceUID floor_mesh_uid;
-	floor_mesh_data = gpu_alloc_map(
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
-		4 * sizeof(struct mesh_vertex), &floor_mesh_uid);
-
-	SceUID floor_indices_uid;
-	floor_indices_data = gpu_alloc_map(
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
-		4 * sizeof(unsigned short), &floor_indices_uid);
-
-	#define FLOOR_SIZE 20.0f
-	#define FLOOR_HALF_SIZE (FLOOR_SIZE / 2.0f)
+	#define CUBE_SIZE 1.0f
 
-	static const vector3f floor_vertices[] = {
-		{.x = -FLOOR_HALF_SIZE, .y = 0.0f, .z = -FLOOR_HALF_SIZE},
-		{.x = -FLOOR_HALF_SIZE, .y = 0.0f, .z = +FLOOR_HALF_SIZE},
-		{.x = +FLOOR_HALF_SIZE, .y = 0.0f, .z = -FLOOR_HALF_SIZE},
-		{.x = +FLOOR_HALF_SIZE, .y = 0.0f, .z = +FLOOR_HALF_SIZE}
+	static const struct mesh_gen_shape cube_shape = {
+		.type = MESH_GEN_BOX,
+		.size = {.x = CUBE_SIZE, .y = CUBE_SIZE, .z = CUBE_SIZE},
+		.segments = {1},
+		.face_colors = cube_colors
 	};
 
-	static const vector4f floor_color = {
-		.r = 0.5f, .g = 0.5f, .b = 0.5f, .a = 1.0f
-	};
+	#define FLOOR_SIZE 20.0f
 
-	static const vector3f floor_normal = {
-		.x = 0.0f, .y = 1.0f, .z = 0.0f
+	static const struct mesh_gen_shape floor_shape = {
+		.type = MESH_GEN_PLANE,
+		.face = MESH_GEN_FACE_TOP,
+		.size = {.x = FLOOR_SIZE, .z = FLOOR_SIZE},
+		.segments = {1, 1},
+		.color = {.r = 0.5f, .g = 0.5f, .b = 0.5f, .a = 1.0f}
 	};
 
-	for (i = 0; i < 4; i++) {
-		floor_mesh_data[i] = (struct mesh_vertex){floor_vertices[i], floor_normal, floor_color};
-		floor_indices_data[i] = i;
-	}
-
-	SceUID portal_mesh_uid;
-	struct position_vertex *const portal_mesh_data = gpu_alloc_map(
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
-		4 * sizeof(struct position_vertex), &portal_mesh_uid);
-
-	SceUID portal_indices_uid;
-	unsigned short *const portal_indices_data = gpu_alloc_map(
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
-		4 * sizeof(unsigned short), &portal_indices_uid);
-
 	#define PORTAL_SIZE 4.0f
 	#define PORTAL_HALF_SIZE (PORTAL_SIZE / 2.0f)
+	#define PORTAL_FRAME_SIZE 0.2f
 
-	static const vector3f portal_vertices[] = {
-		{.x = -PORTAL_HALF_SIZE, .y = +PORTAL_HALF_SIZE, .z = 0.0f},
-		{.x = -PORTAL_HALF_SIZE, .y = -PORTAL_HALF_SIZE, .z = 0.0f},
-		{.x = +PORTAL_HALF_SIZE, .y = +PORTAL_HALF_SIZE, .z = 0.0f},
-		{.x = +PORTAL_HALF_SIZE, .y = -PORTAL_HALF_SIZE, .z = 0.0f}
+	/* The portal's opening faces -z, its frame surrounds it */
+	static const struct mesh_gen_shape portal_shape = {
+		.type = MESH_GEN_PLANE,
+		.face = MESH_GEN_FACE_BACK,
+		.size = {.x = PORTAL_SIZE, .y = PORTAL_SIZE},
+		.segments = {1, 1}
 	};
 
-	static const vector3f portal_normal = {
-		.x = 0.0f, .y = 0.0f, .z = -1.0f
+	static const struct mesh_gen_shape portal_frame_shape = {
+		.type = MESH_GEN_FRAME,
+		.face = MESH_GEN_FACE_BACK,
+		.size = {.x = PORTAL_SIZE, .y = PORTAL_SIZE},
+		.border = PORTAL_FRAME_SIZE,
+		.color = {.r = 0.3f, .g = 0.0f, .b = 1.0f, .a = 1.0f}
 	};
 
-	for (i = 0; i < 4; i++) {
-		portal_mesh_data[i] = (struct position_vertex){portal_vertices[i]};
-		portal_indices_data[i] = i;
-	}
+	/* --scene's objects: the box is the cube's size, it shares its occluder */
+	static const struct mesh_gen_shape box_shape = {
+		.type = MESH_GEN_BOX,
+		.size = {.x = CUBE_SIZE, .y = CUBE_SIZE, .z = CUBE_SIZE},
+		.segments = {1},
+		.color = {.r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f}
+	};
 
-	SceUID portal_frame_mesh_uid;
-	portal_frame_mesh_data = gpu_alloc_map(
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
-		12 * sizeof(struct mesh_vertex), &portal_frame_mesh_uid);
+	static const struct mesh_gen_shape sphere_shape = {
+		.type = MESH_GEN_SPHERE,
+		.radius = CUBE_SIZE / 2.0f,
+		.segments = {12, 16},
+		.color = {.r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f}
+	};
 
-	SceUID portal_frame_indices_uid;
-	portal_frame_indices_data = gpu_alloc_map(
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
-		8 * 3 * sizeof(unsigned short), &portal_frame_indices_uid);
+	/* Shared corners of a box and a plane of one quad per face */
+	static vector3f cube_occluder_vertices[8];
+	static unsigned short cube_occluder_indices[36];
+	static vector3f floor_occluder_vertices[4];
+	static unsigned short floor_occluder_indices[6];
+	static struct occlusion_mesh cube_occluder;
+	static struct occlusion_mesh floor_occluder;
+	struct mesh_gen_result result;
+
+	SceUID cube_mesh_uid, floor_mesh_uid, portal_frame_mesh_uid;
+	if (mesh_generate(&cube_mesh, &cube_shape, &cube_mesh_uid) < 0 ||
+	    mesh_generate(&floor_mesh, &floor_shape, &floor_mesh_uid) < 0 ||
+	    mesh_generate(&portal_frame_mesh, &portal_frame_shape, &portal_frame_mesh_uid) < 0) {
+		printf("Could not generate the meshes\n");
+		return 1;
+	}
 
-	#define PORTAL_FRAME_SIZE 0.2f
+	SceUID box_mesh_uid = -1, sphere_mesh_uid = -1;
+	if (options.scene.object_count &&
+	    (mesh_generate(&box_mesh, &box_shape, &box_mesh_uid) < 0 ||
+	     mesh_generate(&sphere_mesh, &sphere_shape, &sphere_mesh_uid) < 0)) {
+		printf("Could not generate the scene meshes\n");
+		return 1;
+	}
 
-	static const vector4f portal_frame_color = {
-		.r = 0.3f, .g = 0.0f, .b = 1.0f, .a = 1.0f
+	mesh_gen_generate(&cube_shape, MESH_GEN_POSITION, cube_occluder_vertices,
+		cube_occluder_indices, &result);
+	cube_occluder = (struct occlusion_mesh){
+		cube_occluder_vertices, cube_occluder_indices, result.index_count
 	};
+	cube_mesh.occluder = &cube_occluder;
 
-	static const vector2f portal_frame_position_offsets[12] = {
-		{.x = -PORTAL_HALF_SIZE - PORTAL_FRAME_SIZE, .y = +PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE},
-		{.x = -PORTAL_HALF_SIZE - PORTAL_FRAME_SIZE, .y = +PORTAL_HALF_SIZE},
-		{.x = +PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE, .y = +PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE},
-		{.x = +PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE, .y = +PORTAL_HALF_SIZE},
-		{.x = -PORTAL_HALF_SIZE - PORTAL_FRAME_SIZE, .y = -PORTAL_HALF_SIZE},
-		{.x = -PORTAL_HALF_SIZE, .y = +PORTAL_HALF_SIZE},
-		{.x = -PORTAL_HALF_SIZE, .y = -PORTAL_HALF_SIZE},
-		{.x = +PORTAL_HALF_SIZE, .y = +PORTAL_HALF_SIZE},
-		{.x = +PORTAL_HALF_SIZE, .y = -PORTAL_HALF_SIZE},
-		{.x = +PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE, .y = -PORTAL_HALF_SIZE},
-		{.x = -PORTAL_HALF_SIZE - PORTAL_FRAME_SIZE, .y = -PORTAL_HALF_SIZE - PORTAL_FRAME_SIZE},
-		{.x = +PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE, .y = -PORTAL_HALF_SIZE - PORTAL_FRAME_SIZE},
+	mesh_gen_generate(&floor_shape, MESH_GEN_POSITION, floor_occluder_vertices,
+		floor_occluder_indices, &result);
+	floor_occluder = (struct occlusion_mesh){
+		floor_occluder_vertices, floor_occluder_indices, result.index_count
 	};
-
-	for (i = 0; i < 12; i++) {
-		portal_frame_mesh_data[i] = (struct mesh_vertex){
-			.position = {.x = portal_frame_position_offsets[i].x, .y = portal_frame_position_offsets[i].y, .z = 0.0f},
-			.normal = portal_normal,
-			.color = portal_frame_color
-		};
+	floor_mesh.occluder = &floor_occluder;
+	box_mesh.occluder = &cube_occluder;
+
+	/* Mostly the hole it frames */
+	portal_frame_mesh.occluder = NULL;
+
+	/* A converted mesh takes the cube's place, it doesn't occlude */
+	SceUID loaded_mesh_uid = -1;
+	if (options.mesh_path) {
+		struct mesh loaded_mesh;
+		uint64_t load_start = time_get_ns();
+
+		if (mesh_load_file(&loaded_mesh, options.mesh_path, &loaded_mesh_uid) == 0) {
+			mesh_free_lods(&cube_mesh);
+			cube_mesh = loaded_mesh;
+			printf("mesh: %s, %u triangles, %u levels of detail, loaded in %.3f ms\n",
+				options.mesh_path, cube_mesh.index_count / 3, cube_mesh.lod_count,
+				time_ns_to_ms(time_get_ns() - load_start));
+		} else {
+			printf("Could not load mesh %s\n", options.mesh_path);
+		}
 	}
 
-	portal_frame_indices_data[0] = 0;
-	portal_frame_indices_data[1] = 1;
-	portal_frame_indices_data[2] = 2;
-	portal_frame_indices_data[3] = 2;
-	portal_frame_indices_data[4] = 1;
-	portal_frame_indices_data[5] = 3;
-	portal_frame_indices_data[6] = 1;
-	portal_frame_indices_data[7] = 4;
-	portal_frame_indices_data[8] = 5;
-	portal_frame_indices_data[9] = 5;
-	portal_frame_indices_data[10] = 4;
-	portal_frame_indices_data[11] = 6;
-	portal_frame_indices_data[12] = 7;
-	portal_frame_indices_data[13] = 8;
-	portal_frame_indices_data[14] = 3;
-	portal_frame_indices_data[15] = 3;
-	portal_frame_indices_data[16] = 8;
-	portal_frame_indices_data[17] = 9;
-	portal_frame_indices_data[18] = 4;
-	portal_frame_indices_data[19] = 10;
-	portal_frame_indices_data[20] = 9;
-	portal_frame_indices_data[21] = 9;
-	portal_frame_indices_data[22] = 10;
-	portal_frame_indices_data[23] = 11;
-
-	gxm_front_buffer_index = DISPLAY_BUFFER_COUNT - 1;
+	SceUID portal_mesh_uid;
+	unsigned int portal_vertex_count, portal_index_count;
+	mesh_gen_count(&portal_shape, MESH_GEN_POSITION, &portal_vertex_count, &portal_index_count);
+	struct position_vertex *const portal_mesh_data = gpu_alloc_map(GPU_MEMORY_MESHES,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
+		portal_vertex_count * sizeof(struct position_vertex) +
+		portal_index_count * sizeof(unsigned short), &portal_mesh_uid);
+	unsigned short *const portal_indices_data =
+		(unsigned short *)(portal_mesh_data + portal_vertex_count);
+	mesh_gen_generate(&portal_shape, MESH_GEN_POSITION, portal_mesh_data,
+		portal_indices_data, &result);
+
+	gxm_front_buffer_index = gxm_display_buffer_count - 1;
 	gxm_back_buffer_index = 0;
 
 	matrix4x4 projection_matrix;
 	matrix4x4_init_perspective(projection_matrix, 90.0f,
 		DISPLAY_WIDTH / (float)DISPLAY_HEIGHT, 0.01f, 100.0f);
 
-	SceCtrlData pad;
-	memset(&pad, 0, sizeof(pad));
+	memset(&simulation.pad, 0, sizeof(simulation.pad));
 
 	static vector3f camera_initial_pos = {
 		.x = 0.0f, .y = 3.0f, .z = 5.0f
@@ -737,12 +1299,10 @@ int main(int argc, char *argv[])
 		.x = 0.0f, .y = 0.0f, .z = 0.0f
 	};
 
-	struct camera camera;
-	camera_init(&camera, &camera_initial_pos, &camera_initial_rot);
+	camera_init(&simulation.camera, &camera_initial_pos, &camera_initial_rot);
 
-	struct scene_state scene_state;
-	scene_state.portal.width = PORTAL_SIZE;
-	scene_state.portal.height = PORTAL_SIZE;
+	simulation.scene_state.portal.width = PORTAL_SIZE;
+	simulation.scene_state.portal.height = PORTAL_SIZE;
 
 	static const vector3f portal_end1_translation = {
 		.x = 0.0f, .y = PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE, .z = 0.0f
@@ -751,63 +1311,292 @@ int main(int argc, char *argv[])
 		.x = 0.0f, .y = M_PI, .z = 0.0f
 	};
 
-	matrix4x4_build_model_matrix(scene_state.portal.end1.model_matrix,
+	matrix4x4_build_model_matrix(simulation.scene_state.portal.end1.model_matrix,
 		&portal_end1_translation, &portal_end1_rotation);
 
-	scene_state.portal_end2_translation.x = 0.0f;
-	scene_state.portal_end2_translation.y = PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE;
-	scene_state.portal_end2_translation.z = 4.0f;
-	scene_state.portal_end2_rotation.y = 0.0f;
-	scene_state.portal_end2_rotation.x = 0.0f;
-	scene_state.portal_end2_rotation.z = 0.0f;
-
-	matrix4x4_build_model_matrix(scene_state.portal.end2.model_matrix,
-		&scene_state.portal_end2_translation, &scene_state.portal_end2_rotation);
-
-	scene_state.light_distance = 8.0f;
-	scene_state.light_x_rot = DEG_TO_RAD(20.0f);
-	scene_state.light_y_rot = 0.0f;
-
-	static int run = 1;
-	while (run) {
-		sceCtrlPeekBufferPositive(0, &pad, 1);
-		if (pad.buttons & SCE_CTRL_START)
-			run = 0;
-
-		update_camera(&camera, &pad);
-		update_scene(&scene_state, &camera, &pad);
-
-		sceGxmBeginScene(gxm_context,
-			0,
-			gxm_render_target,
-			NULL,
-			NULL,
-			gxm_sync_objects[gxm_back_buffer_index],
-			&gxm_color_surfaces[gxm_back_buffer_index],
-			&gxm_depth_stencil_surface);
-
-		{ /* Clear the color and the depth/stencil buffers */
-			sceGxmSetVertexProgram(gxm_context, gxm_clear_vertex_program_patched);
-			sceGxmSetFragmentProgram(gxm_context, gxm_clear_fragment_program_patched);
+	simulation.scene_state.portal_end2_translation.x = 0.0f;
+	simulation.scene_state.portal_end2_translation.y = PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE;
+	simulation.scene_state.portal_end2_translation.z = 4.0f;
+	simulation.scene_state.portal_end2_rotation.y = 0.0f;
+	simulation.scene_state.portal_end2_rotation.x = 0.0f;
+	simulation.scene_state.portal_end2_rotation.z = 0.0f;
+
+	matrix4x4_build_model_matrix(simulation.scene_state.portal.end2.model_matrix,
+		&simulation.scene_state.portal_end2_translation,
+		&simulation.scene_state.portal_end2_rotation);
+
+	simulation.scene_state.light_distance = 8.0f;
+	simulation.scene_state.light_x_rot = DEG_TO_RAD(20.0f);
+	simulation.scene_state.light_y_rot = 0.0f;
+	simulation.scene_state.light_count = 1;
+
+	static const vector3f cube1_translation = {.x = 5.0f, .y = CUBE_SIZE + 0.1f, .z = 0.0f};
+	static const vector3f cube2_translation = {.x = 0.0f, .y = 2.0f, .z = 1.5f};
+	static const vector3f zero_vector = {.x = 0.0f, .y = 0.0f, .z = 0.0f};
+	static const vector3f unit_scale = {.x = 1.0f, .y = 1.0f, .z = 1.0f};
+
+	scene_store_init(&scene_store, SCENE_INITIAL_CAPACITY);
+	scene_add_object(&scene_store, SCENE_NODE_NONE, SCENE_MESH_PORTAL_FRAME,
+		SCENE_MATERIAL_PORTAL_FRAME, &portal_end1_translation, &portal_end1_rotation,
+		&unit_scale);
+	scene_add_object(&scene_store, SCENE_NODE_NONE, SCENE_MESH_CUBE,
+		SCENE_MATERIAL_CUBE, &cube1_translation, &zero_vector, &unit_scale);
+	scene_add_object(&scene_store, SCENE_NODE_NONE, SCENE_MESH_CUBE,
+		SCENE_MATERIAL_CUBE, &cube2_translation, &zero_vector, &unit_scale);
+	uint32_t floor_node = scene_add_object(&scene_store, SCENE_NODE_NONE, SCENE_MESH_FLOOR,
+		SCENE_MATERIAL_FLOOR, &zero_vector, &zero_vector, &unit_scale);
+
+	if (scene_generate(&options.scene, &simulation.scene_state, floor_node) < 0) {
+		printf("Could not generate the scene\n");
+		return 1;
+	}
 
-			static const float clear_color[4] = {
-				1.0f, 1.0f, 1.0f, 1.0f
-			};
+	update_scene_derived(&simulation.scene_state, &simulation.camera);
 
-			set_fragment_default_uniform_data(gxm_clear_fragment_program_u_clear_color_param,
-				sizeof(clear_color) / sizeof(float), clear_color);
+	fixed_timestep_init(&simulation.timestep, options.simulation_rate,
+		SIMULATION_MAX_STEPS_PER_FRAME);
+	simulation.previous_camera = simulation.camera;
+	simulation.previous_scene_state = simulation.scene_state;
+	simulation.frame_limit = options.frame_limit;
+	simulation_open_input(&simulation, &options);
 
-			sceGxmSetFrontStencilFunc(gxm_context,
-				SCE_GXM_STENCIL_FUNC_ALWAYS,
-				SCE_GXM_STENCIL_OP_ZERO,
-				SCE_GXM_STENCIL_OP_ZERO,
-				SCE_GXM_STENCIL_OP_ZERO,
-				0, 0xFF);
+	frame_pipeline_init(&frame_pipeline, options.pipeline_mode, frame_snapshots,
+		sizeof(struct frame_snapshot), simulate_frame, &simulation);
 
-			sceGxmSetVertexStream(gxm_context, 0, clear_vertices_data);
-			sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLE_STRIP,
-				SCE_GXM_INDEX_FORMAT_U16, clear_indices_data, 4);
+	printf("display: %u buffers, %s latency, vsync %s\n", gxm_display_buffer_count,
+		display_latency_mode_name(options.display_latency), options.vsync ? "on" : "off");
+
+	printf("render: %s color, portal %s, dynamic resolution %s\n",
+		color_depth_name(options.color_depth), portal_mode_name(options.portal_mode),
+		options.dynamic_resolution ? "on" : "off");
+
+	struct frame_stats frame_stats;
+	frame_stats_init(&frame_stats);
+
+	struct dynres_controller main_resolution;
+	struct dynres_controller portal_resolution;
+	dynres_init(&main_resolution, options.dynres_min_scale, options.dynres_max_scale,
+		options.dynres_target_ms);
+	dynres_init(&portal_resolution, options.dynres_portal_min_scale,
+		options.dynres_portal_max_scale,
+		options.dynres_target_ms * DYNRES_PORTAL_TARGET_FRACTION);
+	uint64_t previous_frame_start_ns = 0;
+
+	struct benchmark benchmark;
+	benchmark_init(&benchmark, BENCHMARK_WARMUP_FRAMES);
+
+	if (options.assets_path && assets_start(options.assets_path) < 0)
+		printf("Could not stream %s from %s\n", ASSET_CUBE_MESH, options.assets_path);
+
+	unsigned int frame_count = 0;
+	for (;;) {
+		/*
+		 * Get the camera and scene state for this frame. In pipelined mode
+		 * the next frame is being simulated while this one is recorded.
+		 */
+		PROFILE_BEGIN(frame, "frame");
+		PROFILE_BEGIN(acquire, "acquire snapshot");
+		struct frame_pipeline_slot *frame_slot = frame_pipeline_acquire(&frame_pipeline);
+		PROFILE_END(acquire);
+		if (frame_slot->last) {
+			frame_pipeline_release(&frame_pipeline, frame_slot);
+			break;
+		}
+
+		uint64_t frame_start_ns = time_get_ns();
+		frame_stats_begin_frame(&frame_stats, frame_start_ns);
+		if (options.benchmark_path)
+			benchmark_begin_frame(&benchmark, frame_start_ns);
+
+		/* Size the views for the time the last frame took */
+		float main_scale = 1.0f;
+		float portal_scale = 1.0f;
+		if (options.dynamic_resolution) {
+			if (previous_frame_start_ns) {
+				uint64_t frame_ns = frame_start_ns - previous_frame_start_ns;
+
+				dynres_update(&main_resolution, frame_ns);
+				if (portal_mode == PORTAL_MODE_TEXTURE)
+					dynres_update(&portal_resolution, frame_ns);
+			}
+			main_scale = main_resolution.scale;
+			portal_scale = portal_resolution.scale;
+		}
+		previous_frame_start_ns = frame_start_ns;
+
+		struct frame_snapshot *snapshot = frame_slot->snapshot;
+		const struct camera *camera = &snapshot->camera;
+		struct scene_state *scene_state = &snapshot->scene_state;
+
+		/*
+		 * Render the scene from the other portal's end view:
+		 * If V is the camera's view matrix,
+		 *    M1 is the portal source model matrix,
+		 *    M2 is the portal destination model matrix,
+		 * for non-static portals:
+		 *     V' = V * M1 * ROT_Y_180 * M2^-1
+		 */
+		PROFILE_BEGIN(setup_views, "setup views");
+		select_portal(scene_state, camera, projection_matrix);
+		matrix4x4 portal_end2_view_matrix;
+		{
+			matrix4x4 end1_modelview;
+			matrix4x4_multiply(end1_modelview, camera->view_matrix, scene_state->portal.end1.model_matrix);
+
+			matrix4x4 rot_y_180;
+			matrix4x4_init_rotation_y(rot_y_180, M_PI);
+
+			matrix4x4 end1_modelview_rot_y_180;
+			matrix4x4_multiply(end1_modelview_rot_y_180, end1_modelview, rot_y_180);
+
+			matrix4x4 end2_model_inv;
+			matrix4x4_invert(end2_model_inv, scene_state->portal.end2.model_matrix);
+
+			matrix4x4_multiply(portal_end2_view_matrix, end1_modelview_rot_y_180, end2_model_inv);
+
+			/*
+			 * TODO: Clip projection's matrix zNear plane to
+			 *       the portal's plane.
+			 */
+		}
+
+		if (portal_mode == PORTAL_MODE_TEXTURE)
+			portal_texture_view_init(&views[VIEW_PORTAL], scene_state, &scene_store,
+				projection_matrix, portal_end2_view_matrix, camera->view_matrix,
+				portal_scale);
+		else
+			view_init(&views[VIEW_PORTAL], scene_state, &scene_store,
+				projection_matrix, portal_end2_view_matrix);
+		view_init(&views[VIEW_MAIN], scene_state, &scene_store,
+			projection_matrix, camera->view_matrix);
+
+		/* The stencil portal pass draws into the main view's pixels */
+		views[VIEW_MAIN].width = scale_size(DISPLAY_WIDTH, main_scale);
+		views[VIEW_MAIN].height = scale_size(DISPLAY_HEIGHT, main_scale);
+		if (portal_mode == PORTAL_MODE_STENCIL) {
+			views[VIEW_PORTAL].width = views[VIEW_MAIN].width;
+			views[VIEW_PORTAL].height = views[VIEW_MAIN].height;
+		}
+
+		/*
+		 * Rebuild the transforms of the objects that changed and refit the
+		 * BVH, cull every view in a single walk of it and drop what the
+		 * occluders hide, then generate the draw packets and record them
+		 * into each view's deferred context on the job system while this
+		 * thread starts recording the frame.
+		 */
+		struct scene_store *store = &scene_store;
+		struct job *local_transforms_job = job_parallel_for(update_local_transforms,
+			store, store->count, SCENE_OBJECTS_PER_JOB);
+		struct job *transforms_job = job_create(update_world_transforms,
+			&store, sizeof(store));
+		job_add_dependency(transforms_job, local_transforms_job);
+		/* Also generates the packets, in child jobs */
+		struct job *cull_job = job_create(cull_views,
+			&options.occlusion, sizeof(options.occlusion));
+		job_add_dependency(cull_job, transforms_job);
+
+		struct job *record_jobs[VIEW_COUNT];
+		for (i = 0; i < VIEW_COUNT; i++) {
+			struct view *view = &views[i];
+
+			if (view->context) {
+				record_jobs[i] = job_create(record_view, &view, sizeof(view));
+				job_add_dependency(record_jobs[i], cull_job);
+				job_run(record_jobs[i]);
+			} else {
+				record_jobs[i] = cull_job;
+			}
+		}
+
+		job_run(cull_job);
+		job_run(transforms_job);
+		job_run(local_transforms_job);
+		PROFILE_END(setup_views);
+
+		/*
+		 * Texture mode: render the portal view into its texture first,
+		 * unless the cull found last frame's is still good.
+		 */
+		if (portal_mode == PORTAL_MODE_TEXTURE) {
+			PROFILE_BEGIN(portal_offscreen, "portal texture");
+			job_wait(cull_job);
+			if (portal_visible && !portal_texture_reused) {
+				SceGxmValidRegion portal_region = {
+					0, 0, portal_texture_width - 1, portal_texture_height - 1
+				};
+
+				sceGxmBeginScene(gxm_context,
+					0,
+					gxm_portal_render_target,
+					&portal_region,
+					NULL,
+					NULL,
+					&gxm_portal_color_surface,
+					&gxm_depth_stencil_surface);
+
+				render_counters_set_pass(gxm_context, RENDER_PASS_CLEAR);
+				set_viewport(gxm_context, views[VIEW_PORTAL].width, views[VIEW_PORTAL].height);
+				draw_clear(gxm_context);
+				render_counters_set_pass(gxm_context, RENDER_PASS_PORTAL_VIEW);
+				job_wait(record_jobs[VIEW_PORTAL]);
+				draw_view(&views[VIEW_PORTAL]);
+				render_counters_set_pass(gxm_context, RENDER_PASS_OTHER);
+
+				sceGxmEndScene(gxm_context, NULL, NULL);
+
+				sceGxmTextureInitLinearStrided(&gxm_portal_texture,
+					gxm_portal_color_surface_addr,
+					color_mode->texture_format,
+					portal_texture_width, portal_texture_height,
+					color_mode->bytes_per_pixel * DISPLAY_STRIDE);
+				/* Texels map one to one to pixels unless the resolution is scaled */
+				SceGxmTextureFilter portal_filter = options.dynamic_resolution ?
+					SCE_GXM_TEXTURE_FILTER_LINEAR : SCE_GXM_TEXTURE_FILTER_POINT;
+				sceGxmTextureSetMinFilter(&gxm_portal_texture, portal_filter);
+				sceGxmTextureSetMagFilter(&gxm_portal_texture, portal_filter);
+			}
+			PROFILE_END(portal_offscreen);
+		}
+
+		/*
+		 * Blocks while the back buffer is still in use by the GPU. With
+		 * dynamic resolution the scene goes to its own surface and the
+		 * upscale waits for the back buffer instead.
+		 */
+		PROFILE_BEGIN(begin_scene, "begin scene");
+		uint64_t stall_start = time_get_ns();
+		if (options.dynamic_resolution) {
+			SceGxmValidRegion scene_region = {
+				0, 0, views[VIEW_MAIN].width - 1, views[VIEW_MAIN].height - 1
+			};
+
+			sceGxmBeginScene(gxm_context,
+				0,
+				gxm_scene_render_target,
+				&scene_region,
+				NULL,
+				NULL,
+				&gxm_scene_color_surface,
+				&gxm_depth_stencil_surface);
+		} else {
+			sceGxmBeginScene(gxm_context,
+				0,
+				gxm_render_target,
+				NULL,
+				NULL,
+				gxm_sync_objects[gxm_back_buffer_index],
+				&gxm_color_surfaces[gxm_back_buffer_index],
+				&gxm_depth_stencil_surface);
 		}
+		uint64_t stall_ns = time_get_ns() - stall_start;
+		PROFILE_END(begin_scene);
+		set_viewport(gxm_context, views[VIEW_MAIN].width, views[VIEW_MAIN].height);
+
+		PROFILE_BEGIN(clear, "clear");
+		render_counters_set_pass(gxm_context, RENDER_PASS_CLEAR);
+		draw_clear(gxm_context);
+		PROFILE_END(clear);
 
 		/*
 		 * Step 1: Disable drawing to the color buffer and the depth buffer,
@@ -817,6 +1606,11 @@ int main(int argc, char *argv[])
 		 * Step 3: Set the stencil function to GL_NEVER, which makes sure that
 		 *         the stencil test always fails on every pixel drawn.
 		 */
+		PROFILE_BEGIN(portal_stencil, "steps 1-4 portal stencil");
+		render_counters_set_pass(gxm_context, RENDER_PASS_STENCIL_MARK);
+		/* The cull decides whether the portal passes are needed */
+		job_wait(cull_job);
+		int portal_stencil = portal_visible && portal_mode == PORTAL_MODE_STENCIL;
 		sceGxmSetFrontDepthWriteEnable(gxm_context,
 			SCE_GXM_DEPTH_WRITE_DISABLED);
 		sceGxmSetFrontStencilFunc(gxm_context,
@@ -830,7 +1624,7 @@ int main(int argc, char *argv[])
 		 * Step 4: Draw the portal's frame. At this point the stencil buffer is filled
 		 *         with zero's on the outside of the portal's frame and one's on the inside.
 		 */
-		{
+		if (portal_stencil) {
 			sceGxmSetVertexProgram(gxm_context, gxm_disable_color_buffer_vertex_program_patched);
 			sceGxmSetFragmentProgram(gxm_context, gxm_disable_color_buffer_fragment_program_patched);
 
@@ -838,16 +1632,17 @@ int main(int argc, char *argv[])
 			matrix4x4 portal_modelview_matrix;
 
 			matrix4x4_multiply(portal_modelview_matrix,
-				camera.view_matrix, scene_state.portal.end1.model_matrix);
+				camera->view_matrix, scene_state->portal.end1.model_matrix);
 			matrix4x4_multiply(portal_mvp_matrix,
 				projection_matrix, portal_modelview_matrix);
 
-			set_vertex_default_uniform_data(gxm_disable_color_buffer_vertex_program_u_mvp_matrix_param,
+			set_vertex_default_uniform_data(gxm_context,
+				gxm_disable_color_buffer_vertex_program_u_mvp_matrix_param,
 				sizeof(portal_mvp_matrix) / sizeof(float), portal_mvp_matrix);
 
 			sceGxmSetVertexStream(gxm_context, 0, portal_mesh_data);
-			sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLE_STRIP,
-				SCE_GXM_INDEX_FORMAT_U16, portal_indices_data, 4);
+			sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLES,
+				SCE_GXM_INDEX_FORMAT_U16, portal_indices_data, portal_index_count);
 		}
 
 		/*
@@ -861,53 +1656,23 @@ int main(int argc, char *argv[])
 		 * Step 8: Draw the scene using the virtual camera from step 5. This will
 		 *         only draw inside of the portal's frame because of the stencil test.
 		 */
-		sceGxmSetFrontDepthWriteEnable(gxm_context,
-			SCE_GXM_DEPTH_WRITE_ENABLED);
-		sceGxmSetFrontStencilRef(gxm_context, 1);
-		sceGxmSetFrontStencilFunc(gxm_context,
-			SCE_GXM_STENCIL_FUNC_LESS_EQUAL,
-			SCE_GXM_STENCIL_OP_KEEP,
-			SCE_GXM_STENCIL_OP_KEEP,
-			SCE_GXM_STENCIL_OP_KEEP,
-			0xFF, 0);
-		{
-			/*
-			 * Render the scene from the other portal's end view:
-			 * If V is the camera's view matrix,
-			 *    M1 is the portal source model matrix,
-			 *    M2 is the portal destination model matrix,
-			 * for non-static portals:
-			 *     V' = V * M1 * ROT_Y_180 * M2^-1
-			 */
-
-			matrix4x4 end1_modelview;
-			matrix4x4_multiply(end1_modelview, camera.view_matrix, scene_state.portal.end1.model_matrix);
-
-			matrix4x4 rot_y_180;
-			matrix4x4_init_rotation_y(rot_y_180, M_PI);
-
-			matrix4x4 end1_modelview_rot_y_180;
-			matrix4x4_multiply(end1_modelview_rot_y_180, end1_modelview, rot_y_180);
-
-			matrix4x4 end2_model_inv;
-			matrix4x4_invert(end2_model_inv, scene_state.portal.end2.model_matrix);
-
-			matrix4x4 portal_end2_view_matrix;
-			matrix4x4_multiply(portal_end2_view_matrix, end1_modelview_rot_y_180, end2_model_inv);
-
-			/*
-			 * TODO: Clip projection's matrix zNear plane to
-			 *       the portal's plane.
-			 */
-
-			draw_scene(&scene_state, projection_matrix, portal_end2_view_matrix);
-		}
+		PROFILE_END(portal_stencil);
+		PROFILE_BEGIN(portal_view, "steps 5-8 portal view");
+		render_counters_set_pass(gxm_context, RENDER_PASS_PORTAL_VIEW);
+		job_wait(record_jobs[VIEW_PORTAL]);
+		if (portal_stencil)
+			draw_view(&views[VIEW_PORTAL]);
+		PROFILE_END(portal_view);
 
 		/*
 		 * Step 9: Disable the stencil test, disable drawing to the color
 		 *         buffer, and enable drawing to the depth buffer.
 		 * Step 10: Clear the depth buffer.
 		 */
+		PROFILE_BEGIN(depth_clear, "steps 9-10 depth clear");
+		render_counters_set_pass(gxm_context, RENDER_PASS_DEPTH_RESET);
+		sceGxmSetFrontDepthWriteEnable(gxm_context,
+			SCE_GXM_DEPTH_WRITE_ENABLED);
 		sceGxmSetFrontDepthFunc(gxm_context,
 			SCE_GXM_DEPTH_FUNC_ALWAYS);
 		sceGxmSetFrontStencilFunc(gxm_context,
@@ -917,7 +1682,7 @@ int main(int argc, char *argv[])
 			SCE_GXM_STENCIL_OP_KEEP,
 			0, 0);
 
-		{
+		if (portal_stencil) {
 			sceGxmSetVertexProgram(gxm_context, gxm_clear_vertex_program_patched);
 			sceGxmSetFragmentProgram(gxm_context, gxm_disable_color_buffer_fragment_program_patched);
 
@@ -933,7 +1698,7 @@ int main(int argc, char *argv[])
 		 * Step 10: Draw the portal frame once again, this time
 		 *          to the depth buffer which was just cleared.
 		 */
-		{
+		if (portal_stencil) {
 			sceGxmSetVertexProgram(gxm_context, gxm_disable_color_buffer_vertex_program_patched);
 			sceGxmSetFragmentProgram(gxm_context, gxm_disable_color_buffer_fragment_program_patched);
 
@@ -941,57 +1706,227 @@ int main(int argc, char *argv[])
 			matrix4x4 portal_modelview_matrix;
 
 			matrix4x4_multiply(portal_modelview_matrix,
-				camera.view_matrix, scene_state.portal.end1.model_matrix);
+				camera->view_matrix, scene_state->portal.end1.model_matrix);
 			matrix4x4_multiply(portal_mvp_matrix,
 				projection_matrix, portal_modelview_matrix);
 
-			set_vertex_default_uniform_data(gxm_disable_color_buffer_vertex_program_u_mvp_matrix_param,
+			set_vertex_default_uniform_data(gxm_context,
+				gxm_disable_color_buffer_vertex_program_u_mvp_matrix_param,
 				sizeof(portal_mvp_matrix) / sizeof(float), portal_mvp_matrix);
 
 			sceGxmSetVertexStream(gxm_context, 0, portal_mesh_data);
-			sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLE_STRIP,
-				SCE_GXM_INDEX_FORMAT_U16, portal_indices_data, 4);
+			sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLES,
+				SCE_GXM_INDEX_FORMAT_U16, portal_indices_data, portal_index_count);
+		} else if (portal_visible) {
+			/*
+			 * Texture mode: draw the portal's opening with the texture
+			 * instead, its pixels map one to one to the screen's.
+			 */
+			render_counters_set_pass(gxm_context, RENDER_PASS_PORTAL_VIEW);
+			sceGxmSetVertexProgram(gxm_context, gxm_portal_texture_vertex_program_patched);
+			sceGxmSetFragmentProgram(gxm_context, gxm_portal_texture_fragment_program_patched);
+
+			matrix4x4 portal_mvp_matrix;
+			matrix4x4 portal_modelview_matrix;
+
+			matrix4x4_multiply(portal_modelview_matrix,
+				camera->view_matrix, scene_state->portal.end1.model_matrix);
+			matrix4x4_multiply(portal_mvp_matrix,
+				projection_matrix, portal_modelview_matrix);
+
+			/*
+			 * Clip space to the texture's coordinates, before the divide.
+			 * The texture spans this many screen pixels.
+			 */
+			float portal_texture_span_x = (float)portal_texture_width *
+				DISPLAY_WIDTH / views[VIEW_PORTAL].width;
+			float portal_texture_span_y = (float)portal_texture_height *
+				DISPLAY_HEIGHT / views[VIEW_PORTAL].height;
+			const float screen_to_texture[4] = {
+				DISPLAY_WIDTH / (2.0f * portal_texture_span_x),
+				-(DISPLAY_HEIGHT / (2.0f * portal_texture_span_y)),
+				(DISPLAY_WIDTH / 2.0f - portal_rect.x) / portal_texture_span_x,
+				(DISPLAY_HEIGHT / 2.0f - portal_rect.y) / portal_texture_span_y
+			};
+
+			set_vertex_default_uniform_data(gxm_context,
+				gxm_portal_texture_vertex_program_u_mvp_matrix_param,
+				sizeof(portal_mvp_matrix) / sizeof(float), portal_mvp_matrix);
+			set_vertex_default_uniform_data(gxm_context,
+				gxm_portal_texture_vertex_program_u_screen_to_texture_param,
+				sizeof(screen_to_texture) / sizeof(float), screen_to_texture);
+			sceGxmSetFragmentTexture(gxm_context,
+				sceGxmProgramParameterGetResourceIndex(
+					gxm_portal_texture_fragment_program_u_texture_param),
+				&gxm_portal_texture);
+
+			sceGxmSetVertexStream(gxm_context, 0, portal_mesh_data);
+			sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLES,
+				SCE_GXM_INDEX_FORMAT_U16, portal_indices_data, portal_index_count);
 		}
 
 		/*
 		 * Step 11: Enable the color buffer again.
 		 * step 12: Draw the whole scene with the regular camera.
 		 */
+		PROFILE_END(depth_clear);
+		PROFILE_BEGIN(main_view, "steps 11-12 main view");
+		render_counters_set_pass(gxm_context, RENDER_PASS_MAIN_VIEW);
+		job_wait(record_jobs[VIEW_MAIN]);
+		draw_view(&views[VIEW_MAIN]);
+		PROFILE_END(main_view);
+		render_counters_set_pass(gxm_context, RENDER_PASS_OTHER);
+
+		PROFILE_BEGIN(end_scene, "end scene");
+		sceGxmEndScene(gxm_context, NULL, NULL);
+		PROFILE_END(end_scene);
+
+		/* Dynamic resolution: stretch the scene over the back buffer */
+		if (options.dynamic_resolution) {
+			PROFILE_BEGIN(upscale, "upscale");
+			stall_start = time_get_ns();
+			sceGxmBeginScene(gxm_context,
+				0,
+				gxm_render_target,
+				NULL,
+				NULL,
+				gxm_sync_objects[gxm_back_buffer_index],
+				&gxm_color_surfaces[gxm_back_buffer_index],
+				NULL);
+			stall_ns += time_get_ns() - stall_start;
+
+			render_counters_set_pass(gxm_context, RENDER_PASS_UPSCALE);
+			set_viewport(gxm_context, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+
+			sceGxmTextureInitLinearStrided(&gxm_scene_texture,
+				gxm_scene_color_surface_addr,
+				color_mode->texture_format,
+				views[VIEW_MAIN].width, views[VIEW_MAIN].height,
+				color_mode->bytes_per_pixel * DISPLAY_STRIDE);
+			sceGxmTextureSetMinFilter(&gxm_scene_texture, SCE_GXM_TEXTURE_FILTER_LINEAR);
+			sceGxmTextureSetMagFilter(&gxm_scene_texture, SCE_GXM_TEXTURE_FILTER_LINEAR);
+
+			sceGxmSetVertexProgram(gxm_context, gxm_upscale_vertex_program_patched);
+			sceGxmSetFragmentProgram(gxm_context, gxm_upscale_fragment_program_patched);
+			sceGxmSetFragmentTexture(gxm_context,
+				sceGxmProgramParameterGetResourceIndex(
+					gxm_upscale_fragment_program_u_texture_param),
+				&gxm_scene_texture);
 
-		draw_scene(&scene_state, projection_matrix, camera.view_matrix);
+			sceGxmSetVertexStream(gxm_context, 0, clear_vertices_data);
+			sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLE_STRIP,
+				SCE_GXM_INDEX_FORMAT_U16, clear_indices_data, 4);
 
-		sceGxmEndScene(gxm_context, NULL, NULL);
+			render_counters_set_pass(gxm_context, RENDER_PASS_OTHER);
+			sceGxmEndScene(gxm_context, NULL, NULL);
+			PROFILE_END(upscale);
+		}
 
 		sceGxmPadHeartbeat(&gxm_color_surfaces[gxm_back_buffer_index],
 			gxm_sync_objects[gxm_back_buffer_index]);
 
 		struct display_queue_callback_data queue_cb_data;
 		queue_cb_data.addr = gxm_color_surfaces_addr[gxm_back_buffer_index];
+		queue_cb_data.vsync = options.vsync;
 
+		/* Blocks while the display queue is full */
+		PROFILE_BEGIN(display_queue, "display queue");
+		stall_start = time_get_ns();
 		sceGxmDisplayQueueAddEntry(gxm_sync_objects[gxm_front_buffer_index],
 			gxm_sync_objects[gxm_back_buffer_index], &queue_cb_data);
+		stall_ns += time_get_ns() - stall_start;
+		PROFILE_END(display_queue);
+
+		/* Every command list of the frame has been recorded */
+		render_counters_end_frame();
+		frame_stats_add_stall(&frame_stats, stall_ns);
+		if (options.benchmark_path)
+			benchmark_end_frame(&benchmark);
 
 		gxm_front_buffer_index = gxm_back_buffer_index;
-		gxm_back_buffer_index = (gxm_back_buffer_index + 1) % DISPLAY_BUFFER_COUNT;
+		gxm_back_buffer_index = (gxm_back_buffer_index + 1) % gxm_display_buffer_count;
+
+		frame_pipeline_release(&frame_pipeline, frame_slot);
+		PROFILE_END(frame);
+
+		profiler_collect();
+
+		if (assets_loading)
+			assets_update();
+
+		if (options.report_interval && ++frame_count % options.report_interval == 0) {
+			struct frame_pipeline_stats pipeline_stats;
+			frame_pipeline_collect_stats(&frame_pipeline, &pipeline_stats);
+			frame_pipeline_print_stats(&frame_pipeline, &pipeline_stats);
+			print_view_record_stats(options.report_interval);
+			print_occlusion_stats(options.report_interval);
+			if (options.dynamic_resolution) {
+				dynres_print_stats(&main_resolution, "main");
+				dynres_reset_stats(&main_resolution);
+				if (portal_mode == PORTAL_MODE_TEXTURE) {
+					dynres_print_stats(&portal_resolution, "portal");
+					dynres_reset_stats(&portal_resolution);
+				}
+			}
+			render_counters_print(options.report_interval);
+			if (assets_loading)
+				assets_print_progress();
+
+			struct gpu_memory_stats memory_stats;
+			gpu_memory_get_stats(&memory_stats);
+			gpu_memory_print_stats(&memory_stats);
+			frame_stats_print(&frame_stats);
+			frame_stats_reset(&frame_stats);
+			profiler_print_summary();
+		}
 	}
 
+	frame_pipeline_finish(&frame_pipeline);
+	if (assets_loading)
+		assets_stop();
+
 	sceGxmDisplayQueueFinish();
 	sceGxmFinish(gxm_context);
 
+	gxm_trace_end();
+	render_counters_finish();
+	simulation_close_input(&simulation);
+
+	if (options.benchmark_path) {
+		profiler_collect();
+		if (benchmark_write_json(&benchmark, options.benchmark_path) < 0)
+			printf("Could not write benchmark results to %s\n", options.benchmark_path);
+		else
+			printf("benchmark: %u frames written to %s\n", benchmark.frame_ns_count,
+				options.benchmark_path);
+	}
+	benchmark_free(&benchmark);
+
 	gpu_unmap_free(clear_vertices_uid);
 	gpu_unmap_free(clear_indices_uid);
 
+	mesh_free_lods(&cube_mesh);
+	mesh_free_lods(&floor_mesh);
+	mesh_free_lods(&portal_frame_mesh);
+	mesh_free_lods(&box_mesh);
+	mesh_free_lods(&sphere_mesh);
+
 	gpu_unmap_free(cube_mesh_uid);
-	gpu_unmap_free(cube_indices_uid);
+	if (loaded_mesh_uid >= 0)
+		gpu_unmap_free(loaded_mesh_uid);
+	mesh_free_lods(&retired_cube_mesh);
+	if (streamed_mesh_uid >= 0)
+		gpu_unmap_free(streamed_mesh_uid);
 
 	gpu_unmap_free(floor_mesh_uid);
-	gpu_unmap_free(floor_indices_uid);
-
 	gpu_unmap_free(portal_mesh_uid);
-	gpu_unmap_free(portal_indices_uid);
-
 	gpu_unmap_free(portal_frame_mesh_uid);
-	gpu_unmap_free(portal_frame_indices_uid);
+	if (box_mesh_uid >= 0)
+		gpu_unmap_free(box_mesh_uid);
+	if (material_texture_uid >= 0)
+		gpu_unmap_free(material_texture_uid);
+	if (sphere_mesh_uid >= 0)
+		gpu_unmap_free(sphere_mesh_uid);
 
 	sceGxmShaderPatcherReleaseVertexProgram(gxm_shader_patcher,
 		gxm_disable_color_buffer_vertex_program_patched);
@@ -1008,6 +1943,16 @@ int main(int argc, char *argv[])
 	sceGxmShaderPatcherReleaseFragmentProgram(gxm_shader_patcher,
 		gxm_cube_fragment_program_patched);
 
+	sceGxmShaderPatcherReleaseVertexProgram(gxm_shader_patcher,
+		gxm_portal_texture_vertex_program_patched);
+	sceGxmShaderPatcherReleaseFragmentProgram(gxm_shader_patcher,
+		gxm_portal_texture_fragment_program_patched);
+
+	sceGxmShaderPatcherReleaseVertexProgram(gxm_shader_patcher,
+		gxm_upscale_vertex_program_patched);
+	sceGxmShaderPatcherReleaseFragmentProgram(gxm_shader_patcher,
+		gxm_upscale_fragment_program_patched);
+
 	sceGxmShaderPatcherUnregisterProgram(gxm_shader_patcher,
 		gxm_clear_vertex_program_id);
 	sceGxmShaderPatcherUnregisterProgram(gxm_shader_patcher,
@@ -1018,6 +1963,16 @@ int main(int argc, char *argv[])
 	sceGxmShaderPatcherUnregisterProgram(gxm_shader_patcher,
 		gxm_cube_fragment_program_id);
 
+	sceGxmShaderPatcherUnregisterProgram(gxm_shader_patcher,
+		gxm_portal_texture_vertex_program_id);
+	sceGxmShaderPatcherUnregisterProgram(gxm_shader_patcher,
+		gxm_portal_texture_fragment_program_id);
+
+	sceGxmShaderPatcherUnregisterProgram(gxm_shader_patcher,
+		gxm_upscale_vertex_program_id);
+	sceGxmShaderPatcherUnregisterProgram(gxm_shader_patcher,
+		gxm_upscale_fragment_program_id);
+
 	sceGxmShaderPatcherDestroy(gxm_shader_patcher);
 
 	gpu_unmap_free(gxm_shader_patcher_buffer_uid);
@@ -1026,7 +1981,17 @@ int main(int argc, char *argv[])
 
 	gpu_unmap_free(gxm_depth_stencil_surface_uid);
 
-	for (i = 0; i < DISPLAY_BUFFER_COUNT; i++) {
+	if (options.portal_mode == PORTAL_MODE_TEXTURE) {
+		gpu_unmap_free(gxm_portal_color_surface_uid);
+		sceGxmDestroyRenderTarget(gxm_portal_render_target);
+	}
+
+	if (options.dynamic_resolution) {
+		gpu_unmap_free(gxm_scene_color_surface_uid);
+		sceGxmDestroyRenderTarget(gxm_scene_render_target);
+	}
+
+	for (i = 0; i < gxm_display_buffer_count; i++) {
 		gpu_unmap_free(gxm_color_surfaces_uid[i]);
 		sceGxmSyncObjectDestroy(gxm_sync_objects[i]);
 	}
@@ -1038,34 +2003,229 @@ int main(int argc, char *argv[])
 	gpu_unmap_free(fragment_ring_buffer_uid);
 	gpu_fragment_usse_unmap_free(fragment_usse_ring_buffer_uid);
 
+	for (i = 0; i < VIEW_COUNT; i++) {
+		view_destroy_deferred_context(&views[i]);
+		free(views[i].visible);
+		free(views[i].packets);
+		free(views[i].lods);
+	}
+
+	bvh_free(&scene_bvh);
+	free(scene_bvh_boxes);
+	scene_store_free(&scene_store);
+
 	sceGxmDestroyContext(gxm_context);
 
+	gpu_memory_report_leaks();
+
 	sceGxmTerminate();
 
+	job_system_finish();
+
+	profiler_finish();
+
 	return 0;
 }
 
-static void update_scene(struct scene_state *state, const struct camera *camera, SceCtrlData *pad)
+static int simulate_frame(void *user_data, void *snapshot_data)
+{
+	struct simulation *sim = user_data;
+	struct frame_snapshot *snapshot = snapshot_data;
+
+	struct input_record_frame input;
+	unsigned int steps;
+	uint64_t now_ns;
+	float dt;
+
+	PROFILE_SCOPE(simulate, "simulate");
+	profiler_set_thread_name("simulation");
+
+	if (sim->input_source == INPUT_SOURCE_REPLAY) {
+		if (!input_record_read(&sim->input_record, &input))
+			return 0;
+
+		sim->pad.buttons = input.buttons;
+		sim->pad.lx = input.lx;
+		sim->pad.ly = input.ly;
+		sim->pad.rx = input.rx;
+		sim->pad.ry = input.ry;
+		now_ns = input.time_ns;
+	} else {
+		sceCtrlPeekBufferPositive(0, &sim->pad, 1);
+
+		/*
+		 * A camera path runs one step per frame instead of following
+		 * the real time, so every run renders the same frames.
+		 */
+		if (sim->camera_path.num_keys)
+			now_ns = sim->path_clock_ns += sim->timestep.step_ns;
+		else
+			now_ns = time_get_ns();
+
+		if (sim->input_source == INPUT_SOURCE_RECORD) {
+			input.time_ns = now_ns;
+			input.buttons = sim->pad.buttons;
+			input.lx = sim->pad.lx;
+			input.ly = sim->pad.ly;
+			input.rx = sim->pad.rx;
+			input.ry = sim->pad.ry;
+			input_record_write(&sim->input_record, &input);
+		}
+	}
+
+	/*
+	 * Advance the simulation in fixed steps to catch up with the real
+	 * time, then hand the renderer a state interpolated between the last
+	 * two steps so the motion stays smooth at any frame rate.
+	 */
+	steps = fixed_timestep_advance(&sim->timestep, now_ns);
+	dt = fixed_timestep_step_seconds(&sim->timestep);
+
+	while (steps--) {
+		sim->previous_camera = sim->camera;
+		sim->previous_scene_state = sim->scene_state;
+
+		PROFILE_BEGIN(camera, "update_camera");
+		update_camera(&sim->camera, &sim->pad, dt);
+		PROFILE_END(camera);
+
+		PROFILE_BEGIN(scene, "update_scene");
+		update_scene(&sim->scene_state, &sim->pad, dt);
+		PROFILE_END(scene);
+
+		sim->step_count++;
+		if (sim->camera_path.num_keys)
+			apply_camera_path(sim, sim->step_count * dt);
+	}
+
+	interpolate_simulation(snapshot, sim, fixed_timestep_alpha(&sim->timestep));
+
+	if (sim->frame_limit && ++sim->frame_count > sim->frame_limit)
+		return 0;
+
+	if (sim->camera_path.num_keys &&
+	    sim->step_count * dt > camera_path_duration(&sim->camera_path))
+		return 0;
+
+	return !(sim->pad.buttons & SCE_CTRL_START);
+}
+
+static void simulation_open_input(struct simulation *sim, const struct options *options)
+{
+	sim->input_source = INPUT_SOURCE_LIVE;
+
+	if (options->record_input_path) {
+		if (input_record_open_write(&sim->input_record, options->record_input_path,
+		    sim->timestep.step_ns) < 0)
+			printf("Could not create input recording %s\n", options->record_input_path);
+		else
+			sim->input_source = INPUT_SOURCE_RECORD;
+	} else if (options->replay_input_path) {
+		if (input_record_open_read(&sim->input_record, options->replay_input_path,
+		    sim->timestep.step_ns) < 0)
+			printf("Could not open input recording %s\n", options->replay_input_path);
+		else
+			sim->input_source = INPUT_SOURCE_REPLAY;
+	}
+
+	if (options->camera_path) {
+		if (camera_path_load(&sim->camera_path, options->camera_path) < 0) {
+			printf("Could not load camera path %s\n", options->camera_path);
+		} else {
+			/* Start on the path rather than interpolating from the default camera */
+			apply_camera_path(sim, 0.0f);
+			sim->previous_camera = sim->camera;
+			sim->previous_scene_state = sim->scene_state;
+			printf("camera path: %u keys, %.2f s\n", sim->camera_path.num_keys,
+				camera_path_duration(&sim->camera_path));
+		}
+	}
+}
+
+static void simulation_close_input(struct simulation *sim)
+{
+	if (sim->input_source == INPUT_SOURCE_RECORD)
+		printf("input: recorded %u frames\n", sim->input_record.frame_count);
+	else if (sim->input_source == INPUT_SOURCE_REPLAY)
+		printf("input: replayed %u frames\n", sim->input_record.frame_count);
+
+	input_record_close(&sim->input_record);
+	if (sim->camera_path.num_keys)
+		camera_path_free(&sim->camera_path);
+}
+
+/* Override the pad driven camera and portal with the scripted path */
+static void apply_camera_path(struct simulation *sim, float time)
+{
+	struct camera_path_key key;
+
+	camera_path_evaluate(&sim->camera_path, time, &key);
+
+	sim->camera.position = key.camera_position;
+	sim->camera.rotation = key.camera_rotation;
+	camera_update_view_matrix(&sim->camera);
+
+	sim->scene_state.portal_end2_translation = key.portal_end2_translation;
+	sim->scene_state.portal_end2_rotation = key.portal_end2_rotation;
+}
+
+static void interpolate_simulation(struct frame_snapshot *snapshot,
+	const struct simulation *sim, float alpha)
 {
+	const struct scene_state *previous = &sim->previous_scene_state;
+	const struct scene_state *current = &sim->scene_state;
+	struct scene_state *state = &snapshot->scene_state;
+
+	vector3f_lerp(&snapshot->camera.position, &sim->previous_camera.position,
+		&sim->camera.position, alpha);
+	vector3f_lerp(&snapshot->camera.rotation, &sim->previous_camera.rotation,
+		&sim->camera.rotation, alpha);
+	camera_update_view_matrix(&snapshot->camera);
+
+	*state = *current;
+
+	vector3f_lerp(&state->portal_end2_translation, &previous->portal_end2_translation,
+		&current->portal_end2_translation, alpha);
+	vector3f_lerp(&state->portal_end2_rotation, &previous->portal_end2_rotation,
+		&current->portal_end2_rotation, alpha);
+	state->light_y_rot = previous->light_y_rot +
+		(current->light_y_rot - previous->light_y_rot) * alpha;
+
+	update_scene_derived(state, &snapshot->camera);
+}
+
+static void update_scene(struct scene_state *state, SceCtrlData *pad, float dt)
+{
+	const float portal_move = PORTAL_MOVE_SPEED * dt;
+	const float portal_rotation = PORTAL_ROTATION_SPEED * dt;
+
 	if (pad->buttons & SCE_CTRL_UP)
-		state->portal_end2_translation.z -= 0.025f;
+		state->portal_end2_translation.z -= portal_move;
 	else if (pad->buttons & SCE_CTRL_DOWN)
-		state->portal_end2_translation.z += 0.025f;
+		state->portal_end2_translation.z += portal_move;
 
 	if (pad->buttons & SCE_CTRL_RIGHT)
-		state->portal_end2_translation.x += 0.025f;
+		state->portal_end2_translation.x += portal_move;
 	else if (pad->buttons & SCE_CTRL_LEFT)
-		state->portal_end2_translation.x -= 0.025f;
+		state->portal_end2_translation.x -= portal_move;
 
 	if (pad->buttons & SCE_CTRL_SQUARE)
-		state->portal_end2_rotation.y += 0.025f;
+		state->portal_end2_rotation.y += portal_rotation;
 	else if (pad->buttons & SCE_CTRL_CIRCLE)
-		state->portal_end2_rotation.y -= 0.025f;
+		state->portal_end2_rotation.y -= portal_rotation;
 
 	if (pad->buttons & SCE_CTRL_CROSS)
-		state->portal_end2_rotation.x += 0.025f;
+		state->portal_end2_rotation.x += portal_rotation;
 	else if (pad->buttons & SCE_CTRL_TRIANGLE)
-		state->portal_end2_rotation.x -= 0.025f;
+		state->portal_end2_rotation.x -= portal_rotation;
+
+	state->light_y_rot += LIGHT_ROTATION_SPEED * dt;
+}
+
+/* State computed from the simulated parameters, done once per rendered frame */
+static void update_scene_derived(struct scene_state *state, const struct camera *camera)
+{
+	unsigned int i;
 
 	/*
 	 * Update the portal's other end model matrix.
@@ -1081,326 +2241,1362 @@ static void update_scene(struct scene_state *state, const struct camera *camera,
 	light_position.y = state->light_distance * sinf(state->light_x_rot);
 	light_position.z = state->light_distance * cosf(state->light_x_rot) * sinf(state->light_y_rot);
 
-	state->light_y_rot += 0.1f;
-	vector3f_matrix4x4_mult(&state->light.position,
-		camera->view_matrix, &light_position, 1.0f);
+	state->light_world_positions[0] = light_position;
+	state->lights[0].color = (vector3f){.r = 1.0f, .g = 1.0f, .b = 1.0f};
+
+	for (i = 0; i < state->light_count; i++) {
+		vector3f_matrix4x4_mult(&state->lights[i].position,
+			camera->view_matrix, &state->light_world_positions[i], 1.0f);
+	}
+}
+
+static uint32_t scene_add_object(struct scene_store *store, uint32_t parent,
+	enum scene_mesh mesh, unsigned int material,
+	const vector3f *translation, const vector3f *rotation, const vector3f *scale)
+{
+	uint32_t node;
+
+	node = scene_store_add(store, parent, translation, rotation, scale);
+	if (node == SCENE_NODE_NONE)
+		return node;
+
+	scene_store_set_renderable(store, node, mesh, material,
+		&scene_meshes[mesh]->center, scene_meshes[mesh]->radius);
 
-	state->light.color = (vector3f){.r = 1.0f, .g = 1.0f, .b = 1.0f};
+	return node;
 }
 
-static void draw_scene(const struct scene_state *state, matrix4x4 projection_matrix, matrix4x4 view_matrix)
+/*
+ * Add the objects, portal pairs, lights and materials of --scene around
+ * the demo's scene, and stretch the floor under them.
+ */
+static int scene_generate(const struct scene_gen_params *params, struct scene_state *state,
+	uint32_t floor_node)
 {
-	sceGxmSetVertexProgram(gxm_context, gxm_cube_vertex_program_patched);
-	sceGxmSetFragmentProgram(gxm_context, gxm_cube_fragment_program_patched);
-
-	{ /* Draw the portal frame */
-		static const struct phong_material portal_frame_material = {
-			.ambient = {.r = 0.2f, .g = 0.2f, .b = 0.2f},
-			.diffuse = {.r = 0.6f, .g = 0.6f, .b = 0.6f},
-			.specular = {.r = 0.6f, .g = 0.6f, .b = 0.6f},
-			.shininess = 40.0f
+	struct scene_gen_params clear_params = *params;
+	uint64_t start = time_get_ns();
+	struct scene_gen scene;
+	unsigned int i;
+
+	if (!params->object_count && !params->portal_count && !params->light_count)
+		return 0;
+
+	/* Keep the demo's portal, cubes and starting camera in the clear */
+	clear_params.clear_radius = SCENE_CLEAR_RADIUS;
+	if (scene_gen_generate(&scene, &clear_params) < 0)
+		return -1;
+
+	for (i = 0; i < scene.material_count; i++) {
+		const struct scene_gen_material *material = &scene.materials[i];
+
+		scene_materials[SCENE_MATERIAL_COUNT + i] = (struct phong_material){
+			material->ambient, material->diffuse, material->specular, material->shininess
 		};
+	}
 
-		matrix4x4 portal_frame_mvp_matrix;
-		matrix4x4 portal_frame_modelview_matrix;
-		matrix3x3 portal_frame_normal_matrix;
+	for (i = 0; i < scene.object_count; i++) {
+		const struct scene_gen_object *object = &scene.objects[i];
 
-		matrix4x4_multiply(portal_frame_modelview_matrix, view_matrix, state->portal.end1.model_matrix);
-		matrix4x4_multiply(portal_frame_mvp_matrix, projection_matrix, portal_frame_modelview_matrix);
-		matrix3x3_normal_matrix(portal_frame_normal_matrix, portal_frame_modelview_matrix);
+		if (scene_add_object(&scene_store, SCENE_NODE_NONE,
+		    object->shape == SCENE_GEN_BOX ? SCENE_MESH_BOX : SCENE_MESH_SPHERE,
+		    SCENE_MATERIAL_COUNT + object->material, &object->position,
+		    &object->rotation, &object->scale) == SCENE_NODE_NONE) {
+			scene_gen_free(&scene);
+			return -1;
+		}
+	}
 
-		set_cube_fragment_light_uniform_params(&state->light,
-			&gxm_cube_fragment_program_light_params);
-		set_cube_fragment_material_uniform_params(&portal_frame_material,
-			&gxm_cube_fragment_program_phong_material_params);
-		set_cube_matrices_uniform_params(portal_frame_mvp_matrix,
-			portal_frame_modelview_matrix, portal_frame_normal_matrix);
+	/* Both ends are framed, the portals stand on the floor like the demo's */
+	for (i = 0; i < scene.portal_count; i++) {
+		static const vector3f unit_scale = {.x = 1.0f, .y = 1.0f, .z = 1.0f};
+		const struct scene_gen_portal *generated = &scene.portals[i];
+		struct portal *portal = &scene_portals[i];
+		vector3f end1 = generated->end1_position, end2 = generated->end2_position;
+
+		end1.y = end2.y = PORTAL_HALF_SIZE + PORTAL_FRAME_SIZE;
+		portal->width = PORTAL_SIZE;
+		portal->height = PORTAL_SIZE;
+		matrix4x4_build_model_matrix(portal->end1.model_matrix, &end1,
+			&generated->end1_rotation);
+		matrix4x4_build_model_matrix(portal->end2.model_matrix, &end2,
+			&generated->end2_rotation);
+
+		scene_add_object(&scene_store, SCENE_NODE_NONE, SCENE_MESH_PORTAL_FRAME,
+			SCENE_MATERIAL_PORTAL_FRAME, &end1, &generated->end1_rotation, &unit_scale);
+		scene_add_object(&scene_store, SCENE_NODE_NONE, SCENE_MESH_PORTAL_FRAME,
+			SCENE_MATERIAL_PORTAL_FRAME, &end2, &generated->end2_rotation, &unit_scale);
+	}
+	scene_portal_count = scene.portal_count;
 
-		sceGxmSetVertexStream(gxm_context, 0, portal_frame_mesh_data);
-		sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLES,
-			SCE_GXM_INDEX_FORMAT_U16, portal_frame_indices_data, 24);
+	for (i = 0; i < scene.light_count; i++) {
+		state->light_world_positions[state->light_count] = scene.lights[i].position;
+		state->lights[state->light_count].color = scene.lights[i].color;
+		state->light_count++;
 	}
 
-	{ /* Draw the cube */
-		static const struct phong_material cube1_material = {
-			.ambient = {.r = 0.1f, .g = 0.1f, .b = 0.1f},
-			.diffuse = {.r = 0.8f, .g = 0.8f, .b = 0.8f},
-			.specular = {.r = 0.6f, .g = 0.6f, .b = 0.6f},
-			.shininess = 80.0f
+	if (scene.extent > FLOOR_SIZE) {
+		vector3f floor_scale = {
+			.x = scene.extent / FLOOR_SIZE, .y = 1.0f, .z = scene.extent / FLOOR_SIZE
 		};
 
-		matrix4x4 cube1_model_matrix;
-		matrix4x4_init_translation(cube1_model_matrix,
-			5.0f, CUBE_SIZE + 0.1f, 0.0f);
+		scene_store_set_scale(&scene_store, floor_node, &floor_scale);
+	}
 
-		draw_cube(state, projection_matrix, view_matrix,
-			cube1_model_matrix, &cube1_material);
+	printf("scene: %u objects, %u portal pairs, %u lights, %u materials, %s layout,"
+		" seed %u, %.1f units wide, generated in %.3f ms\n", scene.object_count,
+		scene.portal_count, scene.light_count, scene.material_count,
+		scene_gen_layout_name(params->layout), params->seed, scene.extent,
+		time_ns_to_ms(time_get_ns() - start));
 
-		static const struct phong_material cube2_material = {
-			.ambient = {.r = 0.1f, .g = 0.1f, .b = 0.1f},
-			.diffuse = {.r = 0.8f, .g = 0.8f, .b = 0.8f},
-			.specular = {.r = 0.6f, .g = 0.6f, .b = 0.6f},
-			.shininess = 80.0f
-		};
+	scene_gen_free(&scene);
+
+	return 0;
+}
+
+/*
+ * The renderer draws a single portal view. Give it the pair whose opening
+ * is nearest to the camera among those in front of it and in view, the
+ * demo's when none of them is.
+ */
+static void select_portal(struct scene_state *state, const struct camera *camera,
+	const matrix4x4 projection_matrix)
+{
+	static const vector3f origin = {.x = 0.0f, .y = 0.0f, .z = 0.0f};
+	static const vector3f opening_normal = {.x = 0.0f, .y = 0.0f, .z = -1.0f};
+	static unsigned int active = UINT32_MAX;
+	const struct portal *nearest = NULL;
+	float nearest_distance = INFINITY;
+	matrix4x4 view_projection_matrix;
+	vector4f frustum_planes[6];
+	unsigned int i, nearest_index = UINT32_MAX;
+
+	if (!scene_portal_count)
+		return;
 
-		matrix4x4 cube2_model_matrix;
-		matrix4x4_init_translation(cube2_model_matrix, 0.0f, 2.0f, 1.5f);
+	PROFILE_SCOPE(select_portal, "select portal");
+
+	matrix4x4_multiply(view_projection_matrix, projection_matrix, camera->view_matrix);
+	matrix4x4_frustum_planes(frustum_planes, view_projection_matrix);
+
+	for (i = 0; i <= scene_portal_count; i++) {
+		const struct portal *portal = i ? &scene_portals[i - 1] : &state->portal;
+		float radius = sqrtf(portal->width * portal->width +
+			portal->height * portal->height) / 2.0f;
+		vector3f center, normal, to_camera;
+		float distance;
+
+		/* The opening is centered on the end's origin and faces its -z */
+		vector3f_matrix4x4_mult(&center, portal->end1.model_matrix, &origin, 1.0f);
+		vector3f_matrix4x4_mult(&normal, portal->end1.model_matrix, &opening_normal, 0.0f);
+		vector3f_init(&to_camera, camera->position.x - center.x,
+			camera->position.y - center.y, camera->position.z - center.z);
+
+		if (vector3f_dot_product(&to_camera, &normal) <= 0.0f ||
+		    !frustum_planes_test_sphere(frustum_planes, &center, radius))
+			continue;
+
+		distance = vector3f_length(&to_camera);
+		if (distance < nearest_distance) {
+			nearest_distance = distance;
+			nearest = portal;
+			nearest_index = i;
+		}
+	}
 
-		draw_cube(state, projection_matrix, view_matrix,
-			cube2_model_matrix, &cube2_material);
+	if (nearest_index != UINT32_MAX && nearest_index != active) {
+		if (active != UINT32_MAX)
+			total_portal_switches++;
+		active = nearest_index;
 	}
 
-	{ /* Draw the floor */
-		static const struct phong_material floor_material = {
-			.ambient = {.r = 0.1f, .g = 0.1f, .b = 0.1f},
-			.diffuse = {.r = 0.8f, .g = 0.8f, .b = 0.8f},
-			.specular = {.r = 0.7f, .g = 0.7f, .b = 0.7f},
-			.shininess = 20.0f
-		};
+	if (nearest && nearest != &state->portal)
+		state->portal = *nearest;
+}
+
+/* Each object is lit by the light nearest to its center */
+static unsigned int nearest_light(const struct scene_state *state, const vector3f *position)
+{
+	float nearest_distance = INFINITY;
+	unsigned int i, nearest = 0;
+
+	for (i = 0; i < state->light_count; i++) {
+		const vector3f *light = &state->light_world_positions[i];
+		float dx = light->x - position->x;
+		float dy = light->y - position->y;
+		float dz = light->z - position->z;
+		float distance = dx * dx + dy * dy + dz * dz;
+
+		if (distance < nearest_distance) {
+			nearest_distance = distance;
+			nearest = i;
+		}
+	}
 
-		matrix4x4 floor_mvp_matrix;
-		matrix4x4 floor_modelview_matrix;
-		matrix3x3 floor_normal_matrix;
-		matrix4x4 floor_model_matrix;
+	return nearest;
+}
 
-		matrix4x4_identity(floor_model_matrix);
-		matrix4x4_multiply(floor_modelview_matrix, view_matrix, floor_model_matrix);
-		matrix4x4_multiply(floor_mvp_matrix, projection_matrix, floor_modelview_matrix);
-		matrix3x3_normal_matrix(floor_normal_matrix, floor_modelview_matrix);
+static void update_local_transforms(void *data, unsigned int start, unsigned int count)
+{
+	PROFILE_SCOPE(transforms, "update transforms");
 
-		set_cube_fragment_light_uniform_params(&state->light,
-			&gxm_cube_fragment_program_light_params);
-		set_cube_fragment_material_uniform_params(&floor_material,
-			&gxm_cube_fragment_program_phong_material_params);
-		set_cube_matrices_uniform_params(floor_mvp_matrix,
-			floor_modelview_matrix, floor_normal_matrix);
+	scene_store_update_local(data, start, count);
+}
 
-		sceGxmSetVertexStream(gxm_context, 0, floor_mesh_data);
-		sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLE_STRIP,
-			SCE_GXM_INDEX_FORMAT_U16, floor_indices_data, 4);
+static void update_world_transforms(struct job *job, void *data)
+{
+	PROFILE_SCOPE(world_transforms, "update world transforms");
+
+	const struct scene_store *store = *(struct scene_store **)data;
+	unsigned int updated;
+
+	updated = scene_store_update_world(*(struct scene_store **)data);
+	update_scene_bvh(store, updated);
+	scene_world_updated = updated;
+}
+
+/*
+ * Rebuild the BVH when nodes were added and refit it when some moved.
+ * The BVH works on boxes around the nodes' bounding spheres.
+ */
+static void update_scene_bvh(const struct scene_store *store, unsigned int updated)
+{
+	unsigned int i;
+
+	PROFILE_SCOPE(bvh, "update bvh");
+
+	if (!updated && store->count == scene_bvh.primitive_count)
+		return;
+
+	if (store->count > scene_bvh_box_capacity) {
+		struct bvh_aabb *boxes = realloc(scene_bvh_boxes,
+			store->capacity * sizeof(*boxes));
+
+		if (!boxes)
+			return;
+
+		scene_bvh_boxes = boxes;
+		scene_bvh_box_capacity = store->capacity;
 	}
+
+	for (i = 0; i < store->count; i++) {
+		const vector3f *center = &store->world_centers[i];
+		float radius = store->world_radii[i];
+
+		if (!(store->flags[i] & SCENE_NODE_WORLD_CHANGED))
+			continue;
+
+		vector3f_init(&scene_bvh_boxes[i].min,
+			center->x - radius, center->y - radius, center->z - radius);
+		vector3f_init(&scene_bvh_boxes[i].max,
+			center->x + radius, center->y + radius, center->z + radius);
+	}
+
+	/* Right after the world update, the flags of the moved nodes are nonzero */
+	if (store->count != scene_bvh.primitive_count)
+		bvh_build(&scene_bvh, scene_bvh_boxes, store->count);
+	else
+		bvh_refit(&scene_bvh, scene_bvh_boxes, store->flags);
 }
 
-static void update_camera(struct camera *camera, SceCtrlData *pad)
+static void cull_views(struct job *job, void *data)
 {
-	vector3f camera_look;
-	vector3f camera_right;
+	int occlusion = *(int *)data;
+	struct bvh_frustum frustums[VIEW_COUNT];
+	uint32_t *visible[VIEW_COUNT];
+	unsigned int visible_count[VIEW_COUNT];
+	unsigned int capacity = UINT_MAX;
+	unsigned int i;
+
+	PROFILE_BEGIN(cull, "cull views");
+
+	/* If the arrays of a view couldn't grow, the nodes past them aren't drawn */
+	for (i = 0; i < VIEW_COUNT; i++) {
+		bvh_frustum_init(&frustums[i], views[i].frustum_planes);
+		visible[i] = views[i].visible;
+		if (views[i].packet_capacity < capacity)
+			capacity = views[i].packet_capacity;
+	}
 
-	camera_get_look_vector(camera, &camera_look);
-	camera_get_right_vector(camera, &camera_right);
+	bvh_cull(&scene_bvh, scene_bvh_boxes, frustums, VIEW_COUNT, visible, visible_count,
+		capacity);
 
-	float forward = 0.0f;
-	float lateral = 0.0f;
+	PROFILE_END(cull);
 
-	signed char lx = (signed char)pad->lx - 128;
-	if (abs(lx) > ANALOG_THRESHOLD)
-		lateral = lx / 1536.0f;
+	for (i = 0; i < VIEW_COUNT; i++)
+		views[i].visible_count = visible_count[i];
 
-	signed char ly = (signed char)pad->ly - 128;
-	if (abs(ly) > ANALOG_THRESHOLD)
-		forward = ly / 1536.0f;
+	/* What the main view sees decides whether the portal view is drawn */
+	portal_visible = 1;
+	if (occlusion) {
+		occlusion_cull_view(&views[VIEW_MAIN]);
+		portal_visible = portal_test_visible(&views[VIEW_MAIN]);
+	}
+	if (portal_mode == PORTAL_MODE_TEXTURE && (!portal_rect.width || !portal_rect.height))
+		portal_visible = 0;
+
+	portal_texture_reused = 0;
+	if (!portal_visible) {
+		views[VIEW_PORTAL].visible_count = 0;
+		total_portal_skipped++;
+	} else if (portal_mode == PORTAL_MODE_TEXTURE &&
+	           portal_texture_can_reuse(&views[VIEW_PORTAL])) {
+		views[VIEW_PORTAL].visible_count = 0;
+		portal_texture_reused = 1;
+		total_portal_texture_reused++;
+	} else {
+		if (portal_mode == PORTAL_MODE_TEXTURE)
+			portal_texture_set_contents(&views[VIEW_PORTAL]);
+		if (occlusion)
+			occlusion_cull_view(&views[VIEW_PORTAL]);
+	}
 
-	signed char rx = (signed char)pad->rx - 128;
-	if (abs(rx) > ANALOG_THRESHOLD)
-		camera->rotation.y -= rx / 1536.0f;
+	for (i = 0; i < VIEW_COUNT; i++) {
+		job_run(job_parallel_for_child(job, prepare_view_draw_packets, &views[i],
+			views[i].visible_count, SCENE_OBJECTS_PER_JOB));
+	}
+}
 
-	signed char ry = (signed char)pad->ry - 128;
-	if (abs(ry) > ANALOG_THRESHOLD)
-		camera->rotation.x -= ry / 1536.0f;
+/*
+ * Draw the occluders among the nodes that passed the BVH cull into the
+ * view's depth buffer, then remove the nodes it hides from the visible
+ * list, keeping their order.
+ */
+static void occlusion_cull_view(struct view *view)
+{
+	const struct scene_store *store = view->store;
+	uint64_t start = time_get_ns();
+	matrix4x4 view_projection_matrix;
+	unsigned int i, count;
 
-	if (pad->buttons & SCE_CTRL_RTRIGGER)
-		camera->position.y += 0.1f;
-	else if (pad->buttons & SCE_CTRL_LTRIGGER)
-		camera->position.y -= 0.1f;
+	PROFILE_SCOPE(occlusion, "occlusion cull");
 
-	vector3f_add_mult(&camera->position, &camera_look, forward);
-	vector3f_add_mult(&camera->position, &camera_right, lateral);
+	matrix4x4_multiply(view_projection_matrix, view->projection_matrix, view->view_matrix);
+	occlusion_begin(&view->occlusion, view_projection_matrix);
 
-	camera_update_view_matrix(camera);
+	for (i = 0; i < view->visible_count; i++) {
+		uint32_t node = view->visible[i];
+		const struct mesh *mesh;
+
+		if (store->meshes[node] == SCENE_HANDLE_NONE)
+			continue;
+
+		mesh = scene_meshes[store->meshes[node]];
+		if (mesh->occluder)
+			occlusion_draw(&view->occlusion, store->world_matrices[node], mesh->occluder);
+	}
+
+	occlusion_end(&view->occlusion);
+
+	count = 0;
+	for (i = 0; i < view->visible_count; i++) {
+		uint32_t node = view->visible[i];
+		const struct bvh_aabb *box = &scene_bvh_boxes[node];
+
+		if (occlusion_test_aabb(&view->occlusion, &box->min, &box->max))
+			view->visible[count++] = node;
+	}
+
+	view->total_occlusion_tested += view->visible_count;
+	view->total_occlusion_hidden += view->visible_count - count;
+	view->visible_count = count;
+	view->total_occlusion_ns += time_get_ns() - start;
 }
 
-static void draw_cube(const struct scene_state *state, const matrix4x4 projection_matrix,
-	const matrix4x4 view_matrix, const matrix4x4 model_matrix, const struct phong_material *material)
+/*
+ * Test the portal's opening against the view's occlusion buffer, which
+ * also rejects it when it's off screen.
+ */
+static int portal_test_visible(const struct view *view)
 {
-	matrix4x4 mvp_matrix;
-	matrix4x4 modelview_matrix;
-	matrix3x3 normal_matrix;
+	const struct portal *portal = &view->state->portal;
+	float half_width = portal->width / 2.0f;
+	float half_height = portal->height / 2.0f;
+	vector3f corners[4];
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		vector3f corner = {
+			.x = (i & 1) ? half_width : -half_width,
+			.y = (i & 2) ? half_height : -half_height,
+			.z = 0.0f
+		};
+
+		vector3f_matrix4x4_mult(&corners[i], portal->end1.model_matrix, &corner, 1.0f);
+	}
+
+	return occlusion_test_points(&view->occlusion, corners, 4);
+}
+
+/*
+ * Bounds of the portal's opening on the screen in whole pixels, clamped
+ * to the screen. The whole screen when it crosses the near plane.
+ */
+static void portal_footprint(struct portal_rect *rect, const matrix4x4 projection_matrix,
+	const matrix4x4 camera_view_matrix, const struct portal *portal)
+{
+	float half_width = portal->width / 2.0f;
+	float half_height = portal->height / 2.0f;
+	float min_x = DISPLAY_WIDTH, min_y = DISPLAY_HEIGHT;
+	float max_x = 0.0f, max_y = 0.0f;
+	matrix4x4 modelview_matrix, mvp_matrix;
+	int i;
 
-	matrix4x4_multiply(modelview_matrix, view_matrix, model_matrix);
+	matrix4x4_multiply(modelview_matrix, camera_view_matrix, portal->end1.model_matrix);
 	matrix4x4_multiply(mvp_matrix, projection_matrix, modelview_matrix);
-	matrix3x3_normal_matrix(normal_matrix, modelview_matrix);
-
-	set_cube_fragment_light_uniform_params(&state->light,
-		&gxm_cube_fragment_program_light_params);
-	set_cube_fragment_material_uniform_params(material,
-		&gxm_cube_fragment_program_phong_material_params);
-	set_cube_matrices_uniform_params(mvp_matrix,
-		modelview_matrix, normal_matrix);
-
-	sceGxmSetVertexStream(gxm_context, 0, cube_mesh_data);
-	sceGxmDraw(gxm_context, SCE_GXM_PRIMITIVE_TRIANGLES,
-		SCE_GXM_INDEX_FORMAT_U16, cube_indices_data, 36);
+
+	for (i = 0; i < 4; i++) {
+		vector4f corner = {
+			.x = (i & 1) ? half_width : -half_width,
+			.y = (i & 2) ? half_height : -half_height,
+			.z = 0.0f,
+			.w = 1.0f
+		};
+		vector4f clip;
+		float x, y;
+
+		vector4f_matrix4x4_mult(&clip, mvp_matrix, &corner);
+
+		if (clip.z < -clip.w || clip.w <= 0.0f) {
+			*rect = (struct portal_rect){0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT};
+			return;
+		}
+
+		x = (clip.x / clip.w * 0.5f + 0.5f) * DISPLAY_WIDTH;
+		y = (0.5f - clip.y / clip.w * 0.5f) * DISPLAY_HEIGHT;
+		min_x = fminf(min_x, x);
+		max_x = fmaxf(max_x, x);
+		min_y = fminf(min_y, y);
+		max_y = fmaxf(max_y, y);
+	}
+
+	min_x = floorf(fmaxf(min_x, 0.0f));
+	min_y = floorf(fmaxf(min_y, 0.0f));
+	max_x = ceilf(fminf(max_x, DISPLAY_WIDTH));
+	max_y = ceilf(fminf(max_y, DISPLAY_HEIGHT));
+
+	/* Off screen */
+	if (max_x <= min_x || max_y <= min_y) {
+		*rect = (struct portal_rect){0, 0, 0, 0};
+		return;
+	}
+
+	rect->x = min_x;
+	rect->y = min_y;
+	rect->width = max_x - min_x;
+	rect->height = max_y - min_y;
 }
 
-static void set_cube_fragment_light_uniform_params(const struct light *light,
-	const struct light_gxm_params *params)
+/*
+ * Texture mode renders the portal view at the top left of the offscreen
+ * target: its projection moves the portal's footprint there, pixel for
+ * pixel, so the texture maps one to one to the screen. The view is only
+ * culled against the footprint.
+ */
+static void portal_texture_view_init(struct view *view, const struct scene_state *state,
+	const struct scene_store *store, const matrix4x4 projection_matrix,
+	const matrix4x4 view_matrix, const matrix4x4 camera_view_matrix, float scale)
 {
-	set_fragment_default_uniform_data(params->position,
-		sizeof(light->position) / sizeof(float), &light->position);
-	set_fragment_default_uniform_data(params->color,
-		sizeof(light->color) / sizeof(float), &light->color);
+	const struct portal_rect *rect = &portal_rect;
+	matrix4x4 offset_projection_matrix, cull_projection_matrix;
+	matrix4x4 view_projection_matrix;
+	float x0, y0, x1, y1;
+	int i;
+
+	portal_footprint(&portal_rect, projection_matrix, camera_view_matrix, &state->portal);
+
+	/* The footprint in normalized device coordinates, y up */
+	x0 = 2.0f * rect->x / DISPLAY_WIDTH - 1.0f;
+	x1 = 2.0f * (rect->x + rect->width) / DISPLAY_WIDTH - 1.0f;
+	y0 = 1.0f - 2.0f * (rect->y + rect->height) / DISPLAY_HEIGHT;
+	y1 = 1.0f - 2.0f * rect->y / DISPLAY_HEIGHT;
+
+	for (i = 0; i < 4; i++) {
+		const float w = projection_matrix[3][i];
+
+		/* Translate the footprint's top left corner to the screen's */
+		offset_projection_matrix[0][i] = projection_matrix[0][i] + (-1.0f - x0) * w;
+		offset_projection_matrix[1][i] = projection_matrix[1][i] + (1.0f - y1) * w;
+		offset_projection_matrix[2][i] = projection_matrix[2][i];
+		offset_projection_matrix[3][i] = w;
+
+		/* Stretch the footprint over the whole clip volume */
+		cull_projection_matrix[0][i] = (2.0f * projection_matrix[0][i] - (x0 + x1) * w) /
+			(x1 - x0);
+		cull_projection_matrix[1][i] = (2.0f * projection_matrix[1][i] - (y0 + y1) * w) /
+			(y1 - y0);
+		cull_projection_matrix[2][i] = projection_matrix[2][i];
+		cull_projection_matrix[3][i] = w;
+	}
+
+	view_init(view, state, store, offset_projection_matrix, view_matrix);
+
+	/* Scaled, the footprint shrinks towards the top left corner */
+	view->width = scale_size(DISPLAY_WIDTH, scale);
+	view->height = scale_size(DISPLAY_HEIGHT, scale);
+	portal_texture_width = (rect->width * view->width + DISPLAY_WIDTH - 1) / DISPLAY_WIDTH;
+	portal_texture_height = (rect->height * view->height + DISPLAY_HEIGHT - 1) / DISPLAY_HEIGHT;
+
+	if (rect->width && rect->height) {
+		matrix4x4_multiply(view_projection_matrix, cull_projection_matrix, view_matrix);
+		matrix4x4_frustum_planes(view->frustum_planes, view_projection_matrix);
+	}
 }
 
-static void set_cube_matrices_uniform_params(matrix4x4 mvp_matrix,
-	matrix4x4 modelview_matrix, matrix3x3 normal_matrix)
+static int nearly_equal(float a, float b)
 {
-	set_vertex_default_uniform_data(gxm_cube_vertex_program_u_mvp_matrix_param,
-		sizeof(matrix4x4) / sizeof(float), mvp_matrix);
-	set_fragment_default_uniform_data(gxm_cube_fragment_program_u_modelview_matrix_param,
-		sizeof(matrix4x4) / sizeof(float), modelview_matrix);
-	set_fragment_default_uniform_data(gxm_cube_fragment_program_u_normal_matrix_param,
-		sizeof(matrix3x3) / sizeof(float), normal_matrix);
+	return fabsf(a - b) <= PORTAL_TEXTURE_REUSE_TOLERANCE;
 }
 
-static void set_cube_fragment_material_uniform_params(const struct phong_material *material,
-	const struct phong_material_gxm_params *params)
+/*
+ * Whether the portal texture still shows what the portal view would
+ * render: same footprint, view and lights, and no object moved.
+ */
+static int portal_texture_can_reuse(const struct view *view)
 {
-	set_fragment_default_uniform_data(params->ambient,
-		sizeof(material->ambient) / sizeof(float), &material->ambient);
-	set_fragment_default_uniform_data(params->diffuse,
-		sizeof(material->diffuse) / sizeof(float), &material->diffuse);
-	set_fragment_default_uniform_data(params->specular,
-		sizeof(material->specular) / sizeof(float), &material->specular);
-	set_fragment_default_uniform_data(params->shininess,
-		sizeof(material->shininess) / sizeof(float), &material->shininess);
+	const struct scene_state *state = view->state;
+	unsigned int i, j;
+
+	if (!portal_texture.valid || scene_world_updated)
+		return 0;
+
+	if (memcmp(&portal_texture.rect, &portal_rect, sizeof(portal_rect)) != 0 ||
+	    portal_texture.view_width != view->width || portal_texture.view_height != view->height)
+		return 0;
+
+	for (i = 0; i < 4; i++) {
+		for (j = 0; j < 4; j++) {
+			if (!nearly_equal(portal_texture.view_matrix[i][j], view->view_matrix[i][j]))
+				return 0;
+		}
+	}
+
+	if (portal_texture.light_count != state->light_count)
+		return 0;
+
+	for (i = 0; i < state->light_count; i++) {
+		const struct light *light = &state->lights[i];
+		const struct light *old_light = &portal_texture.lights[i];
+
+		if (!nearly_equal(light->position.x, old_light->position.x) ||
+		    !nearly_equal(light->position.y, old_light->position.y) ||
+		    !nearly_equal(light->position.z, old_light->position.z) ||
+		    !nearly_equal(light->color.x, old_light->color.x) ||
+		    !nearly_equal(light->color.y, old_light->color.y) ||
+		    !nearly_equal(light->color.z, old_light->color.z))
+			return 0;
+	}
+
+	return 1;
 }
 
-void set_vertex_default_uniform_data(const SceGxmProgramParameter *param,
-	unsigned int component_count, const void *data)
+/* Record what the portal texture is about to be rendered with */
+static void portal_texture_set_contents(const struct view *view)
 {
-	void *uniform_buffer;
-	sceGxmReserveVertexDefaultUniformBuffer(gxm_context, &uniform_buffer);
-	sceGxmSetUniformDataF(uniform_buffer, param, 0, component_count, data);
+	portal_texture.valid = 1;
+	portal_texture.rect = portal_rect;
+	portal_texture.view_width = view->width;
+	portal_texture.view_height = view->height;
+	matrix4x4_copy(portal_texture.view_matrix, view->view_matrix);
+	memcpy(portal_texture.lights, view->state->lights,
+		view->state->light_count * sizeof(portal_texture.lights[0]));
+	portal_texture.light_count = view->state->light_count;
 }
 
-void set_fragment_default_uniform_data(const SceGxmProgramParameter *param,
-	unsigned int component_count, const void *data)
+static void view_init(struct view *view, const struct scene_state *state,
+	const struct scene_store *store, const matrix4x4 projection_matrix,
+	const matrix4x4 view_matrix)
 {
-	void *uniform_buffer;
-	sceGxmReserveFragmentDefaultUniformBuffer(gxm_context, &uniform_buffer);
-	sceGxmSetUniformDataF(uniform_buffer, param, 0, component_count, data);
+	matrix4x4 view_projection_matrix;
+
+	view->state = state;
+	view->store = store;
+
+	/* The cull can report every node */
+	if (store->count > view->packet_capacity) {
+		uint32_t *visible = realloc(view->visible, store->capacity * sizeof(*visible));
+		struct draw_packet *packets = realloc(view->packets,
+			store->capacity * sizeof(*packets));
+		uint8_t *lods = realloc(view->lods, store->capacity * sizeof(*lods));
+
+		if (visible)
+			view->visible = visible;
+		if (packets)
+			view->packets = packets;
+		if (lods)
+			view->lods = lods;
+		if (visible && packets && lods) {
+			/* New nodes start at full detail */
+			memset(view->lods + view->packet_capacity, 0,
+				store->capacity - view->packet_capacity);
+			view->packet_capacity = store->capacity;
+		}
+	}
+	view->visible_count = 0;
+	matrix4x4_copy(view->projection_matrix, projection_matrix);
+	matrix4x4_copy(view->view_matrix, view_matrix);
+
+	matrix4x4_multiply(view_projection_matrix, projection_matrix, view_matrix);
+	matrix4x4_frustum_planes(view->frustum_planes, view_projection_matrix);
 }
 
-void *gpu_alloc_map(SceKernelMemBlockType type, SceGxmMemoryAttribFlags gpu_attrib, size_t size, SceUID *uid)
+static void prepare_view_draw_packets(void *data, unsigned int start, unsigned int count)
 {
-	SceUID memuid;
-	void *addr;
+	struct view *view = data;
+	const struct scene_store *store = view->store;
+	unsigned int i;
 
-	if (type == SCE_KERNEL_MEMBLOCK_TYPE_USER_CDRAM_RW)
-		size = ALIGN(size, 256 * 1024);
-	else
-		size = ALIGN(size, 4 * 1024);
+	PROFILE_SCOPE(packets, "prepare draw packets");
+
+	for (i = start; i < start + count; i++) {
+		struct draw_packet *packet = &view->packets[i];
+		uint32_t node = view->visible[i];
+
+		/* The BVH tested a box around the sphere, test the sphere itself */
+		packet->visible = store->meshes[node] != SCENE_HANDLE_NONE &&
+			frustum_planes_test_sphere(view->frustum_planes,
+				&store->world_centers[node], store->world_radii[node]);
+		if (!packet->visible)
+			continue;
 
-	memuid = sceKernelAllocMemBlock("gpumem", type, size, NULL);
-	if (memuid < 0)
-		return NULL;
+		matrix4x4_multiply(packet->modelview_matrix, view->view_matrix,
+			store->world_matrices[node]);
+		matrix4x4_multiply(packet->mvp_matrix, view->projection_matrix, packet->modelview_matrix);
+		matrix3x3_normal_matrix(packet->normal_matrix, packet->modelview_matrix);
 
-	if (sceKernelGetMemBlockBase(memuid, &addr) < 0)
-		return NULL;
+		/* Radius of the bounding sphere over half the viewport height */
+		vector3f center;
+		float radius = store->world_radii[node];
+		float size = INFINITY;
 
-	if (sceGxmMapMemory(addr, size, gpu_attrib) < 0) {
-		sceKernelFreeMemBlock(memuid);
-		return NULL;
+		vector3f_matrix4x4_mult(&center, view->view_matrix, &store->world_centers[node], 1.0f);
+		if (-center.z > radius)
+			size = radius * view->projection_matrix[1][1] / -center.z;
+
+		/* A view rendered at a lower resolution can do with coarser levels */
+		size *= (float)view->height / DISPLAY_HEIGHT;
+
+		packet->lod = select_lod(scene_meshes[store->meshes[node]],
+			size / lod_bias, view->lods[node]);
+		view->lods[node] = packet->lod;
+
+		packet->light = nearest_light(view->state, &store->world_centers[node]);
 	}
+}
+
+/*
+ * size is the projected radius of the bounding sphere over half the
+ * viewport height. The level the size alone picks is used, unless the
+ * current one is still within the hysteresis band around its thresholds.
+ */
+static unsigned int select_lod(const struct mesh *mesh, float size, unsigned int current)
+{
+	unsigned int coarsest = 0, finest = 0;
 
-	if (uid)
-		*uid = memuid;
+	while (coarsest + 1 < mesh->lod_count &&
+	       size * (1.0f - LOD_HYSTERESIS) < mesh->lods[coarsest + 1].max_size)
+		coarsest++;
+	while (finest + 1 < mesh->lod_count &&
+	       size * (1.0f + LOD_HYSTERESIS) < mesh->lods[finest + 1].max_size)
+		finest++;
 
-	return addr;
+	if (current < finest)
+		return finest;
+	if (current > coarsest)
+		return coarsest;
+
+	return current;
 }
 
-void gpu_unmap_free(SceUID uid)
+/*
+ * Simplify each level from the previous one and size it so its error
+ * stays under LOD_MAX_PIXEL_ERROR on the display. Only triangle lists are
+ * simplified, the other meshes keep their single level.
+ */
+static float lod_max_size(float radius, float error)
 {
-	void *addr;
+	return error > 0.0f ?
+		LOD_MAX_PIXEL_ERROR * radius / (error * DISPLAY_HEIGHT / 2.0f) : INFINITY;
+}
+
+static void mesh_build_lods(struct mesh *mesh, unsigned int vertex_count, size_t vertex_size)
+{
+	unsigned short *scratch;
+
+	mesh->lods[0].indices = mesh->indices;
+	mesh->lods[0].index_count = mesh->index_count;
+	mesh->lods[0].error = 0.0f;
+	mesh->lods[0].max_size = INFINITY;
+	mesh->lods[0].uid = -1;
+	mesh->lod_count = 1;
+
+	if (mesh->primitive != SCE_GXM_PRIMITIVE_TRIANGLES)
+		return;
 
-	if (sceKernelGetMemBlockBase(uid, &addr) < 0)
+	scratch = malloc(mesh->index_count * sizeof(*scratch));
+	if (!scratch)
 		return;
 
-	sceGxmUnmapMemory(addr);
+	while (mesh->lod_count < MESH_MAX_LODS) {
+		const struct mesh_lod *previous = &mesh->lods[mesh->lod_count - 1];
+		struct mesh_lod *lod = &mesh->lods[mesh->lod_count];
+		unsigned short *indices;
+		float error;
+		int count;
+
+		count = mesh_simplify(scratch, previous->indices, previous->index_count,
+			mesh->vertices, vertex_count, vertex_size, previous->index_count / 2,
+			mesh->radius * MESH_LOD_MAX_ERROR, &error);
+		if (count <= 0 || count > previous->index_count * MESH_LOD_MIN_REDUCTION)
+			break;
+
+		indices = gpu_alloc_map(GPU_MEMORY_MESHES,
+			SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
+			count * sizeof(*indices), &lod->uid);
+		if (!indices)
+			break;
+
+		memcpy(indices, scratch, count * sizeof(*indices));
+		lod->indices = indices;
+		lod->index_count = count;
+		lod->error = previous->error + error;
+		lod->max_size = lod_max_size(mesh->radius, lod->error);
+		mesh->lod_count++;
+	}
 
-	sceKernelFreeMemBlock(uid);
+	free(scratch);
 }
 
-void *gpu_vertex_usse_alloc_map(size_t size, SceUID *uid, unsigned int *usse_offset)
+static void mesh_free_lods(struct mesh *mesh)
 {
-	SceUID memuid;
-	void *addr;
+	unsigned int i;
 
-	size = ALIGN(size, 4 * 1024);
+	for (i = 1; i < mesh->lod_count; i++) {
+		if (mesh->lods[i].uid >= 0)
+			gpu_unmap_free(mesh->lods[i].uid);
+	}
 
-	memuid = sceKernelAllocMemBlock("gpu_vertex_usse",
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, size, NULL);
-	if (memuid < 0)
-		return NULL;
+	mesh->lod_count = 0;
+}
+
+/*
+ * Generate a shape into one GPU block, its vertices then its indices, and
+ * build its levels of detail. The mesh doesn't occlude.
+ */
+static int mesh_generate(struct mesh *mesh, const struct mesh_gen_shape *shape, SceUID *uid)
+{
+	struct mesh_gen_result result;
+	unsigned int vertex_count, index_count;
+	size_t vertices_size;
+	char *data;
 
-	if (sceKernelGetMemBlockBase(memuid, &addr) < 0)
-		return NULL;
+	if (mesh_gen_count(shape, MESH_GEN_POSITION_NORMAL_COLOR, &vertex_count, &index_count) < 0)
+		return -1;
 
-	if (sceGxmMapVertexUsseMemory(addr, size, usse_offset) < 0)
-		return NULL;
+	vertices_size = vertex_count * sizeof(struct mesh_vertex);
+	data = gpu_alloc_map(GPU_MEMORY_MESHES,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
+		vertices_size + index_count * sizeof(unsigned short), uid);
+	if (!data)
+		return -1;
+
+	mesh_gen_generate(shape, MESH_GEN_POSITION_NORMAL_COLOR, data,
+		(unsigned short *)(data + vertices_size), &result);
+
+	memset(mesh, 0, sizeof(*mesh));
+	mesh->vertices = data;
+	mesh->indices = (const unsigned short *)(data + vertices_size);
+	mesh->index_count = result.index_count;
+	mesh->primitive = SCE_GXM_PRIMITIVE_TRIANGLES;
+	mesh->center = result.center;
+	mesh->radius = result.radius;
+	mesh_build_lods(mesh, result.vertex_count, sizeof(struct mesh_vertex));
 
-	if (uid)
-		*uid = memuid;
+	return 0;
+}
 
-	return addr;
+/* Draw from a parsed mesh file in place, levels of detail included */
+static void mesh_init_file(struct mesh *mesh, const struct mesh_file_header *header)
+{
+	unsigned int i;
+
+	memset(mesh, 0, sizeof(*mesh));
+	mesh->vertices = mesh_file_vertices(header);
+	mesh->indices = mesh_file_indices(header, 0);
+	mesh->index_count = header->lods[0].index_count;
+	mesh->primitive = header->primitive == MESH_FILE_PRIMITIVE_TRIANGLE_STRIP ?
+		SCE_GXM_PRIMITIVE_TRIANGLE_STRIP : SCE_GXM_PRIMITIVE_TRIANGLES;
+	vector3f_init(&mesh->center, header->center[0], header->center[1], header->center[2]);
+	mesh->radius = header->radius;
+
+	for (i = 0; i < header->lod_count; i++) {
+		mesh->lods[i].indices = mesh_file_indices(header, i);
+		mesh->lods[i].index_count = header->lods[i].index_count;
+		mesh->lods[i].error = header->lods[i].error;
+		mesh->lods[i].max_size = i ? lod_max_size(mesh->radius, header->lods[i].error) : INFINITY;
+		mesh->lods[i].uid = -1;
+	}
+	mesh->lod_count = header->lod_count;
 }
 
-void gpu_vertex_usse_unmap_free(SceUID uid)
+/*
+ * Read a mesh file into one GPU block and draw from it in place, without
+ * touching the vertices.
+ */
+static int mesh_load_file(struct mesh *mesh, const char *path, SceUID *uid)
 {
-	void *addr;
+	const struct mesh_file_header *header;
+	size_t size;
+	void *data;
+	FILE *file;
 
-	if (sceKernelGetMemBlockBase(uid, &addr) < 0)
-		return;
+	file = mesh_file_open(path, &size);
+	if (!file)
+		return -1;
 
-	sceGxmUnmapVertexUsseMemory(addr);
+	data = gpu_alloc_map(GPU_MEMORY_MESHES,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
+		size, uid);
+	if (!data) {
+		fclose(file);
+		return -1;
+	}
+
+	header = mesh_file_read(file, data, size);
+	if (!header || header->vertex_size != sizeof(struct mesh_vertex)) {
+		gpu_unmap_free(*uid);
+		*uid = -1;
+		return -1;
+	}
 
-	sceKernelFreeMemBlock(uid);
+	mesh_init_file(mesh, header);
+
+	return 0;
 }
 
-void *gpu_fragment_usse_alloc_map(size_t size, SceUID *uid, unsigned int *usse_offset)
+/*
+ * Read a texture file into one GPU block and sample its levels in place,
+ * repeated, trilinear filtered.
+ */
+static int texture_load_file(SceGxmTexture *texture, const char *path, SceUID *uid)
 {
-	SceUID memuid;
-	void *addr;
+	static const SceGxmTextureFormat formats[TEXTURE_FILE_FORMAT_COUNT] = {
+		[TEXTURE_FILE_FORMAT_RGBA8] = SCE_GXM_TEXTURE_FORMAT_U8U8U8U8_ABGR,
+		[TEXTURE_FILE_FORMAT_UBC1] = SCE_GXM_TEXTURE_FORMAT_UBC1_ABGR,
+		[TEXTURE_FILE_FORMAT_UBC3] = SCE_GXM_TEXTURE_FORMAT_UBC3_ABGR
+	};
+	const struct texture_file_header *header;
+	size_t size;
+	void *data;
+	FILE *file;
 
-	size = ALIGN(size, 4 * 1024);
+	file = texture_file_open(path, &size);
+	if (!file)
+		return -1;
 
-	memuid = sceKernelAllocMemBlock("gpu_fragment_usse",
-		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, size, NULL);
-	if (memuid < 0)
-		return NULL;
+	data = gpu_alloc_map(GPU_MEMORY_TEXTURES,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
+		size, uid);
+	if (!data) {
+		fclose(file);
+		return -1;
+	}
 
-	if (sceKernelGetMemBlockBase(memuid, &addr) < 0)
-		return NULL;
+	header = texture_file_read(file, data, size);
+	if (!header || sceGxmTextureInitSwizzled(texture, texture_file_data(header),
+	    formats[header->format], header->width, header->height, header->level_count) < 0) {
+		gpu_unmap_free(*uid);
+		*uid = -1;
+		return -1;
+	}
 
-	if (sceGxmMapFragmentUsseMemory(addr, size, usse_offset) < 0)
-		return NULL;
+	sceGxmTextureSetMinFilter(texture, SCE_GXM_TEXTURE_FILTER_LINEAR);
+	sceGxmTextureSetMagFilter(texture, SCE_GXM_TEXTURE_FILTER_LINEAR);
+	sceGxmTextureSetMipFilter(texture, SCE_GXM_TEXTURE_MIP_FILTER_ENABLED);
+	sceGxmTextureSetUAddrMode(texture, SCE_GXM_TEXTURE_ADDR_REPEAT);
+	sceGxmTextureSetVAddrMode(texture, SCE_GXM_TEXTURE_ADDR_REPEAT);
 
-	if (uid)
-		*uid = memuid;
+	printf("texture: %s, %s %ux%u, %u levels\n", path,
+		texture_file_format_name(header->format), header->width, header->height,
+		header->level_count);
 
-	return addr;
+	return 0;
 }
 
-void gpu_fragment_usse_unmap_free(SceUID uid)
+/*
+ * Draw the cubes with mesh from the next frame. The GPU may still be
+ * drawing the old one, so it is kept until exit. Resetting the bounds of
+ * the cubes refits the BVH and invalidates the portal texture.
+ */
+static void replace_cube_mesh(const struct mesh *mesh)
 {
-	void *addr;
+	uint32_t node;
+
+	retired_cube_mesh = cube_mesh;
+	cube_mesh = *mesh;
+
+	for (node = 0; node < scene_store.count; node++) {
+		if (scene_store.meshes[node] == SCENE_MESH_CUBE)
+			scene_store_set_renderable(&scene_store, node, SCENE_MESH_CUBE,
+				scene_store.materials[node], &cube_mesh.center, cube_mesh.radius);
+	}
+}
+
+/* Start streaming the cube mesh of the archive at path */
+static int assets_start(const char *path)
+{
+	const struct asset_archive_entry *entry;
+	void *data;
+
+	if (asset_archive_open(&asset_archive, path) < 0)
+		return -1;
+
+	entry = asset_archive_find(&asset_archive, ASSET_CUBE_MESH);
+	if (!entry)
+		goto err_close;
+
+	data = gpu_alloc_map(GPU_MEMORY_MESHES,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
+		entry->size, &streamed_mesh_uid);
+	if (!data)
+		goto err_close;
+
+	if (asset_loader_init(&asset_loader, &asset_archive) < 0)
+		goto err_free;
+
+	asset_loader_request(&asset_loader, entry, data, NULL);
+	assets_loading = 1;
+	assets_start_ns = time_get_ns();
+
+	return 0;
+
+err_free:
+	gpu_unmap_free(streamed_mesh_uid);
+	streamed_mesh_uid = -1;
+err_close:
+	asset_archive_close(&asset_archive);
+	return -1;
+}
+
+static void assets_stop(void)
+{
+	asset_loader_finish(&asset_loader);
+	asset_archive_close(&asset_archive);
+	assets_loading = 0;
+}
+
+/* Between frames: swap in what finished loading, never waits */
+static void assets_update(void)
+{
+	const struct mesh_file_header *header;
+	struct asset_loader_progress progress;
+	struct asset_loader_stats stats;
+	struct asset_request *request;
+	struct mesh mesh;
+
+	assets_frames++;
+
+	while ((request = asset_loader_poll(&asset_loader))) {
+		header = request->status == ASSET_REQUEST_DONE ?
+			mesh_file_parse(request->destination, request->entry->size) : NULL;
+		if (!header || header->vertex_size != sizeof(struct mesh_vertex)) {
+			printf("Could not load %s from the asset archive\n", request->entry->name);
+			continue;
+		}
 
-	if (sceKernelGetMemBlockBase(uid, &addr) < 0)
+		mesh_init_file(&mesh, header);
+		replace_cube_mesh(&mesh);
+		printf("assets: %s streamed in %.3f ms over %u frames, %u triangles, "
+			"%u levels of detail\n", request->entry->name,
+			time_ns_to_ms(time_get_ns() - assets_start_ns), assets_frames,
+			mesh.index_count / 3, mesh.lod_count);
+	}
+
+	asset_loader_get_progress(&asset_loader, &progress);
+	if (progress.completed == progress.requested) {
+		asset_loader_get_stats(&asset_loader, &stats);
+		asset_loader_print_stats(&stats);
+		assets_stop();
+	}
+}
+
+static void assets_print_progress(void)
+{
+	struct asset_loader_progress progress;
+
+	asset_loader_get_progress(&asset_loader, &progress);
+	printf("assets: %u/%u entries, %.2f/%.2f MB\n", progress.completed, progress.requested,
+		progress.bytes_loaded / (1024.0f * 1024.0f),
+		progress.bytes_requested / (1024.0f * 1024.0f));
+}
+
+static void draw_scene(SceGxmContext *context, const struct view *view)
+{
+	const struct scene_state *state = view->state;
+	const struct scene_store *store = view->store;
+	unsigned int i;
+
+	PROFILE_SCOPE(draw, "draw_scene");
+
+	sceGxmSetVertexProgram(context, gxm_cube_vertex_program_patched);
+	sceGxmSetFragmentProgram(context, gxm_cube_fragment_program_patched);
+	if (material_textured)
+		sceGxmSetFragmentTexture(context,
+			sceGxmProgramParameterGetResourceIndex(gxm_cube_fragment_program_u_texture_param),
+			&material_texture);
+
+	for (i = 0; i < view->visible_count; i++) {
+		const struct draw_packet *packet = &view->packets[i];
+		uint32_t node = view->visible[i];
+		const struct mesh *mesh;
+		const struct mesh_lod *lod;
+
+		if (!packet->visible)
+			continue;
+
+		mesh = scene_meshes[store->meshes[node]];
+
+		set_cube_fragment_light_uniform_params(context, &state->lights[packet->light],
+			&gxm_cube_fragment_program_light_params);
+		set_cube_fragment_material_uniform_params(context,
+			&scene_materials[store->materials[node]],
+			&gxm_cube_fragment_program_phong_material_params);
+		set_cube_matrices_uniform_params(context, packet->mvp_matrix,
+			packet->modelview_matrix, packet->normal_matrix);
+
+		lod = &mesh->lods[packet->lod];
+		sceGxmSetVertexStream(context, 0, mesh->vertices);
+		sceGxmDraw(context, mesh->primitive,
+			SCE_GXM_INDEX_FORMAT_U16, lod->indices, lod->index_count);
+	}
+}
+
+/* Clear the color and the depth/stencil buffers */
+static void draw_clear(SceGxmContext *context)
+{
+	static const float clear_color[4] = {
+		1.0f, 1.0f, 1.0f, 1.0f
+	};
+
+	sceGxmSetVertexProgram(context, gxm_clear_vertex_program_patched);
+	sceGxmSetFragmentProgram(context, gxm_clear_fragment_program_patched);
+
+	set_fragment_default_uniform_data(context,
+		gxm_clear_fragment_program_u_clear_color_param,
+		sizeof(clear_color) / sizeof(float), clear_color);
+
+	sceGxmSetFrontStencilFunc(context,
+		SCE_GXM_STENCIL_FUNC_ALWAYS,
+		SCE_GXM_STENCIL_OP_ZERO,
+		SCE_GXM_STENCIL_OP_ZERO,
+		SCE_GXM_STENCIL_OP_ZERO,
+		0, 0xFF);
+
+	sceGxmSetVertexStream(context, 0, clear_vertices_data);
+	sceGxmDraw(context, SCE_GXM_PRIMITIVE_TRIANGLE_STRIP,
+		SCE_GXM_INDEX_FORMAT_U16, clear_indices_data, 4);
+}
+
+/* Map the clip volume to the top left width x height pixels */
+static void set_viewport(SceGxmContext *context, unsigned int width, unsigned int height)
+{
+	sceGxmSetViewport(context,
+		width / 2.0f, width / 2.0f,
+		height / 2.0f, -(height / 2.0f),
+		0.5f, 0.5f);
+}
+
+static unsigned int scale_size(unsigned int size, float scale)
+{
+	unsigned int scaled = lroundf(size * scale);
+
+	return scaled ? (scaled < size ? scaled : size) : 1;
+}
+
+/* Whole chunks for the demo's draws and scene_draws more */
+static unsigned int view_command_memory_size(unsigned int size, unsigned int bytes_per_draw,
+	unsigned int scene_draws)
+{
+	size += scene_draws * bytes_per_draw;
+
+	return (size + COMMAND_MEMORY_CHUNK_SIZE - 1) / COMMAND_MEMORY_CHUNK_SIZE *
+		COMMAND_MEMORY_CHUNK_SIZE;
+}
+
+static void view_create_deferred_context(struct view *view, enum view_id id,
+	unsigned int scene_draws)
+{
+	unsigned int vdm_size = view_command_memory_size(VIEW_VDM_COMMAND_MEMORY_SIZE,
+		VIEW_VDM_COMMAND_BYTES_PER_DRAW, scene_draws);
+	unsigned int vertex_size = view_command_memory_size(VIEW_VERTEX_COMMAND_MEMORY_SIZE,
+		VIEW_VERTEX_COMMAND_BYTES_PER_DRAW, scene_draws);
+	unsigned int fragment_size = view_command_memory_size(VIEW_FRAGMENT_COMMAND_MEMORY_SIZE,
+		VIEW_FRAGMENT_COMMAND_BYTES_PER_DRAW, scene_draws);
+	unsigned int command_memory_size = command_memory_required_size(
+		vdm_size, vertex_size, fragment_size, VIEW_COMMAND_MEMORY_REGIONS);
+	SceGxmDeferredContextParams params;
+	void *command_memory_addr;
+
+	view->id = id;
+	view->context = NULL;
+	view->context_host_mem = NULL;
+	view->command_memory_uid = -1;
+
+	if (scene_draws > VIEW_MAX_DEFERRED_DRAWS)
 		return;
 
-	sceGxmUnmapFragmentUsseMemory(addr);
+	command_memory_addr = gpu_alloc_map(GPU_MEMORY_COMMAND_LISTS,
+		SCE_KERNEL_MEMBLOCK_TYPE_USER_RW_UNCACHE, SCE_GXM_MEMORY_ATTRIB_READ,
+		command_memory_size, &view->command_memory_uid);
+	if (!command_memory_addr) {
+		view->command_memory_uid = -1;
+		return;
+	}
+
+	command_memory_init(&view->command_memory, command_memory_addr,
+		vdm_size, vertex_size, fragment_size, VIEW_COMMAND_MEMORY_REGIONS);
+
+	view->context_host_mem = malloc(SCE_GXM_MINIMUM_DEFERRED_CONTEXT_HOST_MEM_SIZE);
+
+	memset(&params, 0, sizeof(params));
+	params.hostMem = view->context_host_mem;
+	params.hostMemSize = SCE_GXM_MINIMUM_DEFERRED_CONTEXT_HOST_MEM_SIZE;
+	command_memory_set_deferred_context_params(&view->command_memory, &params);
+
+	/* Fall back to drawing the view on the immediate context */
+	if (!view->context_host_mem || sceGxmCreateDeferredContext(&params, &view->context) < 0) {
+		view->context = NULL;
+		view_destroy_deferred_context(view);
+	}
+}
+
+static void view_destroy_deferred_context(struct view *view)
+{
+	if (view->context)
+		sceGxmDestroyDeferredContext(view->context);
+	if (view->command_memory_uid >= 0)
+		gpu_unmap_free(view->command_memory_uid);
+	free(view->context_host_mem);
+
+	view->context = NULL;
+	view->context_host_mem = NULL;
+	view->command_memory_uid = -1;
+}
+
+/*
+ * Command lists do not inherit the state of the context that executes
+ * them, so each view sets the whole state its pass needs.
+ */
+static void set_view_render_state(SceGxmContext *context, const struct view *view)
+{
+	set_viewport(context, view->width, view->height);
+	sceGxmSetFrontDepthWriteEnable(context, SCE_GXM_DEPTH_WRITE_ENABLED);
+	sceGxmSetFrontDepthFunc(context, SCE_GXM_DEPTH_FUNC_LESS_EQUAL);
+
+	if (view->id == VIEW_PORTAL && portal_mode == PORTAL_MODE_STENCIL) {
+		/* Steps 6 and 7: only draw inside the portal frame */
+		sceGxmSetFrontStencilRef(context, 1);
+		sceGxmSetFrontStencilFunc(context,
+			SCE_GXM_STENCIL_FUNC_LESS_EQUAL,
+			SCE_GXM_STENCIL_OP_KEEP,
+			SCE_GXM_STENCIL_OP_KEEP,
+			SCE_GXM_STENCIL_OP_KEEP,
+			0xFF, 0);
+	} else {
+		sceGxmSetFrontStencilFunc(context,
+			SCE_GXM_STENCIL_FUNC_ALWAYS,
+			SCE_GXM_STENCIL_OP_KEEP,
+			SCE_GXM_STENCIL_OP_KEEP,
+			SCE_GXM_STENCIL_OP_KEEP,
+			0, 0);
+	}
+}
+
+static void record_view(struct job *job, void *data)
+{
+	struct view *view = *(struct view **)data;
+	uint64_t start = time_get_ns();
+
+	PROFILE_SCOPE(record, "record view");
+
+	command_memory_next_region(&view->command_memory);
+
+	render_counters_set_pass(view->context,
+		view->id == VIEW_PORTAL ? RENDER_PASS_PORTAL_VIEW : RENDER_PASS_MAIN_VIEW);
+
+	sceGxmBeginCommandList(view->context);
+	set_view_render_state(view->context, view);
+	draw_scene(view->context, view);
+	sceGxmEndCommandList(view->context, &view->command_list);
+
+	view->record_ns = time_get_ns() - start;
+	view->total_record_ns += view->record_ns;
+}
+
+static void draw_view(struct view *view)
+{
+	if (view->context) {
+		sceGxmExecuteCommandList(gxm_context, &view->command_list);
+	} else {
+		uint64_t start = time_get_ns();
+
+		set_view_render_state(gxm_context, view);
+		draw_scene(gxm_context, view);
+
+		view->record_ns = time_get_ns() - start;
+		view->total_record_ns += view->record_ns;
+	}
+}
+
+static void print_view_record_stats(unsigned int frames)
+{
+	static const char *const view_names[VIEW_COUNT] = {
+		[VIEW_PORTAL] = "portal",
+		[VIEW_MAIN] = "main"
+	};
+	int i;
+
+	for (i = 0; i < VIEW_COUNT; i++) {
+		struct view *view = &views[i];
+
+		printf("%s view: record %.3f ms", view_names[i],
+			time_ns_to_ms(view->total_record_ns) / frames);
+		if (view->context) {
+			const struct command_memory *memory = &view->command_memory;
+
+			printf(" (deferred, peak vdm %u vertex %u fragment %u bytes, %u failed)",
+				memory->vdm.peak, memory->vertex.peak, memory->fragment.peak,
+				memory->vdm.failed + memory->vertex.failed + memory->fragment.failed);
+		} else {
+			printf(" (immediate)");
+		}
+		printf("\n");
+
+		view->total_record_ns = 0;
+	}
+}
+
+static void print_occlusion_stats(unsigned int frames)
+{
+	static const char *const view_names[VIEW_COUNT] = {
+		[VIEW_PORTAL] = "portal",
+		[VIEW_MAIN] = "main"
+	};
+	int i;
 
-	sceKernelFreeMemBlock(uid);
+	for (i = 0; i < VIEW_COUNT; i++) {
+		struct view *view = &views[i];
+		float hidden = view->total_occlusion_tested ?
+			100.0f * view->total_occlusion_hidden / view->total_occlusion_tested : 0.0f;
+
+		printf("%s view: occlusion %.3f ms, %.1f%% of %.1f objects hidden\n",
+			view_names[i], time_ns_to_ms(view->total_occlusion_ns) / frames,
+			hidden, (float)view->total_occlusion_tested / frames);
+
+		view->total_occlusion_tested = 0;
+		view->total_occlusion_hidden = 0;
+		view->total_occlusion_ns = 0;
+	}
+
+	printf("portal passes skipped: %u of %u frames\n", total_portal_skipped, frames);
+	total_portal_skipped = 0;
+
+	if (scene_portal_count) {
+		printf("portal pair switches: %u in %u frames\n", total_portal_switches, frames);
+		total_portal_switches = 0;
+	}
+
+	if (portal_mode == PORTAL_MODE_TEXTURE) {
+		printf("portal texture reused: %u of %u frames\n",
+			total_portal_texture_reused, frames);
+		total_portal_texture_reused = 0;
+	}
+}
+
+static void update_camera(struct camera *camera, SceCtrlData *pad, float dt)
+{
+	vector3f camera_look;
+	vector3f camera_right;
+
+	camera_get_look_vector(camera, &camera_look);
+	camera_get_right_vector(camera, &camera_right);
+
+	float forward = 0.0f;
+	float lateral = 0.0f;
+
+	signed char lx = (signed char)pad->lx - 128;
+	if (abs(lx) > ANALOG_THRESHOLD)
+		lateral = lx * CAMERA_ANALOG_SPEED * dt;
+
+	signed char ly = (signed char)pad->ly - 128;
+	if (abs(ly) > ANALOG_THRESHOLD)
+		forward = ly * CAMERA_ANALOG_SPEED * dt;
+
+	signed char rx = (signed char)pad->rx - 128;
+	if (abs(rx) > ANALOG_THRESHOLD)
+		camera->rotation.y -= rx * CAMERA_ANALOG_SPEED * dt;
+
+	signed char ry = (signed char)pad->ry - 128;
+	if (abs(ry) > ANALOG_THRESHOLD)
+		camera->rotation.x -= ry * CAMERA_ANALOG_SPEED * dt;
+
+	if (pad->buttons & SCE_CTRL_RTRIGGER)
+		camera->position.y += CAMERA_VERTICAL_SPEED * dt;
+	else if (pad->buttons & SCE_CTRL_LTRIGGER)
+		camera->position.y -= CAMERA_VERTICAL_SPEED * dt;
+
+	vector3f_add_mult(&camera->position, &camera_look, forward);
+	vector3f_add_mult(&camera->position, &camera_right, lateral);
+
+	camera_update_view_matrix(camera);
+}
+
+static void set_cube_fragment_light_uniform_params(SceGxmContext *context,
+	const struct light *light, const struct light_gxm_params *params)
+{
+	set_fragment_default_uniform_data(context, params->position,
+		sizeof(light->position) / sizeof(float), &light->position);
+	set_fragment_default_uniform_data(context, params->color,
+		sizeof(light->color) / sizeof(float), &light->color);
+}
+
+static void set_cube_matrices_uniform_params(SceGxmContext *context, const matrix4x4 mvp_matrix,
+	const matrix4x4 modelview_matrix, const matrix3x3 normal_matrix)
+{
+	set_vertex_default_uniform_data(context, gxm_cube_vertex_program_u_mvp_matrix_param,
+		sizeof(matrix4x4) / sizeof(float), mvp_matrix);
+	set_fragment_default_uniform_data(context, gxm_cube_fragment_program_u_modelview_matrix_param,
+		sizeof(matrix4x4) / sizeof(float), modelview_matrix);
+	set_fragment_default_uniform_data(context, gxm_cube_fragment_program_u_normal_matrix_param,
+		sizeof(matrix3x3) / sizeof(float), normal_matrix);
+}
+
+static void set_cube_fragment_material_uniform_params(SceGxmContext *context,
+	const struct phong_material *material, const struct phong_material_gxm_params *params)
+{
+	set_fragment_default_uniform_data(context, params->ambient,
+		sizeof(material->ambient) / sizeof(float), &material->ambient);
+	set_fragment_default_uniform_data(context, params->diffuse,
+		sizeof(material->diffuse) / sizeof(float), &material->diffuse);
+	set_fragment_default_uniform_data(context, params->specular,
+		sizeof(material->specular) / sizeof(float), &material->specular);
+	set_fragment_default_uniform_data(context, params->shininess,
+		sizeof(material->shininess) / sizeof(float), &material->shininess);
+}
+
+void set_vertex_default_uniform_data(SceGxmContext *context,
+	const SceGxmProgramParameter *param, unsigned int component_count, const void *data)
+{
+	void *uniform_buffer;
+	sceGxmReserveVertexDefaultUniformBuffer(context, &uniform_buffer);
+	sceGxmSetUniformDataF(uniform_buffer, param, 0, component_count, data);
+}
+
+void set_fragment_default_uniform_data(SceGxmContext *context,
+	const SceGxmProgramParameter *param, unsigned int component_count, const void *data)
+{
+	void *uniform_buffer;
+	sceGxmReserveFragmentDefaultUniformBuffer(context, &uniform_buffer);
+	sceGxmSetUniformDataF(uniform_buffer, param, 0, component_count, data);
 }
 
 void *shader_patcher_host_alloc_cb(void *user_data, unsigned int size)
@@ -1422,11 +3618,15 @@ void display_queue_callback(const void *callbackData)
 	display_fb.size = sizeof(display_fb);
 	display_fb.base = cb_data->addr;
 	display_fb.pitch = DISPLAY_STRIDE;
-	display_fb.pixelformat = DISPLAY_PIXEL_FORMAT;
+	display_fb.pixelformat = color_mode->display_pixel_format;
 	display_fb.width = DISPLAY_WIDTH;
 	display_fb.height = DISPLAY_HEIGHT;
 
-	sceDisplaySetFrameBuf(&display_fb, SCE_DISPLAY_SETBUF_NEXTFRAME);
-
-	sceDisplayWaitVblankStart();
+	if (cb_data->vsync) {
+		sceDisplaySetFrameBuf(&display_fb, SCE_DISPLAY_SETBUF_NEXTFRAME);
+		sceDisplayWaitVblankStart();
+	} else {
+		/* Flip right away, tearing is fine when benchmarking */
+		sceDisplaySetFrameBuf(&display_fb, SCE_DISPLAY_SETBUF_IMMEDIATE);
+	}
 }
@@ -55,6 +55,13 @@ void vector3f_add_mult(vector3f *v, const vector3f *u, float a)
 	v->z += u->z * a;
 }
 
+void vector3f_lerp(vector3f *dst, const vector3f *v0, const vector3f *v1, float t)
+{
+	dst->x = v0->x + (v1->x - v0->x) * t;
+	dst->y = v0->y + (v1->y - v0->y) * t;
+	dst->z = v0->z + (v1->z - v0->z) * t;
+}
+
 void vector3f_opposite(vector3f *v1, const vector3f *v0)
 {
 	v1->x = -v0->x;
@@ -539,3 +546,58 @@ void matrix4x4_oblique_near_plane(matrix4x4 projection, const vector4f *clip_pla
 	projection[2][2] = c.z - projection[3][2];
 	projection[2][3] = c.w - projection[3][3];
 }
+
+/*
+ * Gribb-Hartmann plane extraction. The planes point inwards and are
+ * normalized, in the space the matrix transforms from.
+ */
+void matrix4x4_frustum_planes(vector4f planes[6], const matrix4x4 view_projection)
+{
+	int i;
+	const float *r0 = view_projection[0];
+	const float *r1 = view_projection[1];
+	const float *r2 = view_projection[2];
+	const float *r3 = view_projection[3];
+
+	vector4f_init(&planes[0], r3[0] + r0[0], r3[1] + r0[1], r3[2] + r0[2], r3[3] + r0[3]);
+	vector4f_init(&planes[1], r3[0] - r0[0], r3[1] - r0[1], r3[2] - r0[2], r3[3] - r0[3]);
+	vector4f_init(&planes[2], r3[0] + r1[0], r3[1] + r1[1], r3[2] + r1[2], r3[3] + r1[3]);
+	vector4f_init(&planes[3], r3[0] - r1[0], r3[1] - r1[1], r3[2] - r1[2], r3[3] - r1[3]);
+	vector4f_init(&planes[4], r3[0] + r2[0], r3[1] + r2[1], r3[2] + r2[2], r3[3] + r2[3]);
+	vector4f_init(&planes[5], r3[0] - r2[0], r3[1] - r2[1], r3[2] - r2[2], r3[3] - r2[3]);
+
+	for (i = 0; i < 6; i++) {
+		float length = sqrtf(planes[i].x * planes[i].x + planes[i].y * planes[i].y +
+			planes[i].z * planes[i].z);
+		if (length > 0.0f)
+			vector4f_scalar_mult_dest(&planes[i], &planes[i], 1.0f / length);
+	}
+}
+
+float matrix4x4_max_axis_scale(const matrix4x4 m)
+{
+	float sx = m[0][0] * m[0][0] + m[1][0] * m[1][0] + m[2][0] * m[2][0];
+	float sy = m[0][1] * m[0][1] + m[1][1] * m[1][1] + m[2][1] * m[2][1];
+	float sz = m[0][2] * m[0][2] + m[1][2] * m[1][2] + m[2][2] * m[2][2];
+	float max = sx;
+
+	if (sy > max)
+		max = sy;
+	if (sz > max)
+		max = sz;
+
+	return sqrtf(max);
+}
+
+int frustum_planes_test_sphere(const vector4f planes[6], const vector3f *center, float radius)
+{
+	int i;
+
+	for (i = 0; i < 6; i++) {
+		if (planes[i].x * center->x + planes[i].y * center->y +
+		    planes[i].z * center->z + planes[i].w < -radius)
+			return 0;
+	}
+
+	return 1;
+}
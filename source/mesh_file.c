@@ -0,0 +1,140 @@
+#include <string.h>
+#include "mesh_file.h"
+
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+/* Whether count elements of size bytes at offset fit in the file */
+static int section_fits(uint32_t offset, uint32_t count, size_t element_size, size_t size)
+{
+	if (offset % MESH_FILE_ALIGN || offset > size)
+		return 0;
+
+	return count <= (size - offset) / element_size;
+}
+
+const struct mesh_file_header *mesh_file_parse(const void *data, size_t size)
+{
+	const struct mesh_file_header *header = data;
+	unsigned int i;
+
+	if (size < sizeof(*header) ||
+	    memcmp(header->magic, MESH_FILE_MAGIC, sizeof(header->magic)) ||
+	    header->version != MESH_FILE_VERSION || header->size != size)
+		return NULL;
+
+	if (header->vertex_format != MESH_FILE_VERTEX_POSITION_NORMAL_COLOR ||
+	    header->vertex_size != MESH_FILE_POSITION_NORMAL_COLOR_SIZE ||
+	    !header->vertex_count || header->vertex_count > 65536 ||
+	    !section_fits(header->vertex_offset, header->vertex_count, header->vertex_size, size))
+		return NULL;
+
+	if (header->primitive != MESH_FILE_PRIMITIVE_TRIANGLES &&
+	    header->primitive != MESH_FILE_PRIMITIVE_TRIANGLE_STRIP)
+		return NULL;
+
+	if (!header->lod_count || header->lod_count > MESH_FILE_MAX_LODS)
+		return NULL;
+
+	for (i = 0; i < header->lod_count; i++) {
+		const struct mesh_file_lod *lod = &header->lods[i];
+
+		if (lod->index_count < 3 ||
+		    (header->primitive == MESH_FILE_PRIMITIVE_TRIANGLES && lod->index_count % 3) ||
+		    !section_fits(lod->index_offset, lod->index_count, sizeof(uint16_t), size))
+			return NULL;
+	}
+
+	return header;
+}
+
+FILE *mesh_file_open(const char *path, size_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	long end;
+
+	if (!file)
+		return NULL;
+
+	if (fseek(file, 0, SEEK_END) != 0 || (end = ftell(file)) < 0 ||
+	    fseek(file, 0, SEEK_SET) != 0) {
+		fclose(file);
+		return NULL;
+	}
+
+	*size = end;
+
+	return file;
+}
+
+const struct mesh_file_header *mesh_file_read(FILE *file, void *data, size_t size)
+{
+	size_t read = fread(data, 1, size, file);
+
+	fclose(file);
+	if (read != size)
+		return NULL;
+
+	return mesh_file_parse(data, size);
+}
+
+static int write_padding(FILE *file, uint32_t *offset)
+{
+	static const char zeros[MESH_FILE_ALIGN];
+	uint32_t aligned = ALIGN_UP(*offset, MESH_FILE_ALIGN);
+
+	if (fwrite(zeros, 1, aligned - *offset, file) != aligned - *offset)
+		return -1;
+
+	*offset = aligned;
+
+	return 0;
+}
+
+int mesh_file_write(const char *path, struct mesh_file_header *header,
+	const void *vertices, const uint16_t *const *lod_indices)
+{
+	uint32_t offset;
+	unsigned int i;
+	FILE *file;
+
+	memcpy(header->magic, MESH_FILE_MAGIC, sizeof(header->magic));
+	header->version = MESH_FILE_VERSION;
+
+	offset = ALIGN_UP(sizeof(*header), MESH_FILE_ALIGN);
+	header->vertex_offset = offset;
+	offset += header->vertex_count * header->vertex_size;
+	for (i = 0; i < header->lod_count; i++) {
+		offset = ALIGN_UP(offset, MESH_FILE_ALIGN);
+		header->lods[i].index_offset = offset;
+		header->lods[i].reserved = 0;
+		offset += header->lods[i].index_count * sizeof(uint16_t);
+	}
+	for (; i < MESH_FILE_MAX_LODS; i++)
+		memset(&header->lods[i], 0, sizeof(header->lods[i]));
+	header->size = offset;
+
+	file = fopen(path, "wb");
+	if (!file)
+		return -1;
+
+	offset = sizeof(*header);
+	if (fwrite(header, sizeof(*header), 1, file) != 1 || write_padding(file, &offset) < 0 ||
+	    fwrite(vertices, header->vertex_size, header->vertex_count, file) !=
+	    header->vertex_count)
+		goto err_close;
+	offset += header->vertex_count * header->vertex_size;
+
+	for (i = 0; i < header->lod_count; i++) {
+		if (write_padding(file, &offset) < 0 ||
+		    fwrite(lod_indices[i], sizeof(uint16_t), header->lods[i].index_count, file) !=
+		    header->lods[i].index_count)
+			goto err_close;
+		offset += header->lods[i].index_count * sizeof(uint16_t);
+	}
+
+	return fclose(file) == 0 ? 0 : -1;
+
+err_close:
+	fclose(file);
+	return -1;
+}
@@ -0,0 +1,526 @@
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "mesh_gen.h"
+
+/* Quads across a band of a grid, its rows of vertices fill half the cache */
+#define BAND_QUADS (MESH_GEN_CACHE_SIZE / 2 - 1)
+
+/*
+ * Axes (0 to 2 for x to z) and directions of a face's normal and of its
+ * u and v, u x v being the normal. u is the lower axis, so planes are
+ * split along x, y, z in order.
+ */
+struct face {
+	unsigned char normal_axis, u_axis, v_axis;
+	signed char normal_sign, u_sign, v_sign;
+};
+
+static const struct face faces[MESH_GEN_FACE_COUNT] = {
+	[MESH_GEN_FACE_FRONT]  = {2, 0, 1, +1, +1, +1},
+	[MESH_GEN_FACE_RIGHT]  = {0, 1, 2, +1, +1, +1},
+	[MESH_GEN_FACE_BACK]   = {2, 0, 1, -1, +1, -1},
+	[MESH_GEN_FACE_LEFT]   = {0, 1, 2, -1, +1, -1},
+	[MESH_GEN_FACE_TOP]    = {1, 0, 2, +1, +1, -1},
+	[MESH_GEN_FACE_BOTTOM] = {1, 0, 2, -1, +1, +1},
+};
+
+/* Outer corners 0 to 3 and inner corners 4 to 7 of a frame, counterclockwise in u, v */
+static const signed char frame_corners[4][2] = {
+	{-1, -1}, {+1, -1}, {+1, +1}, {-1, +1}
+};
+
+static const unsigned short frame_indices[24] = {
+	0, 1, 5, 0, 5, 4,
+	1, 2, 6, 1, 6, 5,
+	2, 3, 7, 2, 7, 6,
+	3, 0, 4, 3, 4, 7
+};
+
+static float *put_vertex(float *out, enum mesh_gen_format format, const float position[3],
+	const float normal[3], const vector4f *color)
+{
+	out[0] = position[0];
+	out[1] = position[1];
+	out[2] = position[2];
+	if (format == MESH_GEN_POSITION)
+		return out + 3;
+
+	out[3] = normal[0];
+	out[4] = normal[1];
+	out[5] = normal[2];
+	out[6] = color->r;
+	out[7] = color->g;
+	out[8] = color->b;
+	out[9] = color->a;
+
+	return out + 10;
+}
+
+/*
+ * Triangles of a grid of nu by nv quads whose vertex (a, b) is
+ * base + b * (nu + 1) + a, row by row in bands of BAND_QUADS quads. Quads
+ * are split from (a, b) to (a + 1, b + 1).
+ */
+static unsigned short *grid_indices(unsigned short *indices, unsigned int base,
+	unsigned int nu, unsigned int nv)
+{
+	unsigned int band, a, b;
+
+	for (band = 0; band < nu; band += BAND_QUADS) {
+		unsigned int end = band + BAND_QUADS < nu ? band + BAND_QUADS : nu;
+
+		for (b = 0; b < nv; b++) {
+			for (a = band; a < end; a++) {
+				unsigned short v00 = base + b * (nu + 1) + a;
+				unsigned short v01 = v00 + nu + 1;
+
+				indices[0] = v00;
+				indices[1] = v00 + 1;
+				indices[2] = v01 + 1;
+				indices[3] = v00;
+				indices[4] = v01 + 1;
+				indices[5] = v01;
+				indices += 6;
+			}
+		}
+	}
+
+	return indices;
+}
+
+/* Point (a, b) of a face of a box split in counts quads along each axis */
+static void face_lattice(const struct face *face, unsigned int a, unsigned int b,
+	const unsigned int counts[3], unsigned int lattice[3])
+{
+	lattice[face->u_axis] = face->u_sign > 0 ? a : counts[face->u_axis] - a;
+	lattice[face->v_axis] = face->v_sign > 0 ? b : counts[face->v_axis] - b;
+	lattice[face->normal_axis] = face->normal_sign > 0 ? counts[face->normal_axis] : 0;
+}
+
+static void lattice_position(const unsigned int lattice[3], const float step[3],
+	const float half[3], float position[3])
+{
+	position[0] = lattice[0] * step[0] - half[0];
+	position[1] = lattice[1] * step[1] - half[1];
+	position[2] = lattice[2] * step[2] - half[2];
+}
+
+/* Vertices of a face, in grid_indices() order */
+static float *face_vertices(float *out, enum mesh_gen_format format, const struct face *face,
+	const unsigned int counts[3], const float step[3], const float half[3],
+	const vector4f *color)
+{
+	unsigned int nu = counts[face->u_axis], nv = counts[face->v_axis];
+	unsigned int lattice[3], a, b;
+	float position[3], normal[3] = {0.0f, 0.0f, 0.0f};
+
+	normal[face->normal_axis] = face->normal_sign;
+
+	for (b = 0; b <= nv; b++) {
+		for (a = 0; a <= nu; a++) {
+			face_lattice(face, a, b, counts, lattice);
+			lattice_position(lattice, step, half, position);
+			out = put_vertex(out, format, position, normal, color);
+		}
+	}
+
+	return out;
+}
+
+/*
+ * A box's surface points without normals are shared by its faces: the
+ * bottom layer (y = 0) of (n + 1)^2 points, the rings of 4n points around
+ * the layers in between, then the top layer. Rings start at x = z = 0 and
+ * go along x first.
+ */
+static unsigned int ring_index(unsigned int x, unsigned int z, unsigned int n)
+{
+	if (z == 0 && x < n)
+		return x;
+	if (x == n && z < n)
+		return n + z;
+	if (z == n && x > 0)
+		return 3 * n - x;
+	return 4 * n - z;
+}
+
+static void ring_point(unsigned int t, unsigned int n, unsigned int lattice[3])
+{
+	if (t < n) {
+		lattice[0] = t;
+		lattice[2] = 0;
+	} else if (t < 2 * n) {
+		lattice[0] = n;
+		lattice[2] = t - n;
+	} else if (t < 3 * n) {
+		lattice[0] = 3 * n - t;
+		lattice[2] = n;
+	} else {
+		lattice[0] = 0;
+		lattice[2] = 4 * n - t;
+	}
+}
+
+static unsigned int box_point_index(const unsigned int lattice[3], unsigned int n)
+{
+	unsigned int layer = (n + 1) * (n + 1);
+
+	if (lattice[1] == 0)
+		return lattice[0] * (n + 1) + lattice[2];
+	if (lattice[1] == n)
+		return layer + (n - 1) * 4 * n + lattice[0] * (n + 1) + lattice[2];
+	return layer + (lattice[1] - 1) * 4 * n + ring_index(lattice[0], lattice[2], n);
+}
+
+static void box_count(unsigned int n, enum mesh_gen_format format, uint64_t *vertex_count,
+	uint64_t *index_count)
+{
+	uint64_t face = (uint64_t)(n + 1) * (n + 1);
+
+	if (format == MESH_GEN_POSITION)
+		*vertex_count = 2 * face + (uint64_t)4 * n * (n - 1);
+	else
+		*vertex_count = MESH_GEN_FACE_COUNT * face;
+	*index_count = (uint64_t)MESH_GEN_FACE_COUNT * 6 * n * n;
+}
+
+static void generate_box(const struct mesh_gen_shape *shape, enum mesh_gen_format format,
+	unsigned int n, float *vertices, unsigned short *indices)
+{
+	const unsigned int counts[3] = {n, n, n};
+	const float size[3] = {shape->size.x, shape->size.y, shape->size.z};
+	float step[3], half[3];
+	unsigned int lattice[3], face, i, j;
+
+	for (i = 0; i < 3; i++) {
+		step[i] = size[i] / n;
+		half[i] = size[i] / 2.0f;
+	}
+
+	if (format != MESH_GEN_POSITION) {
+		for (face = 0; face < MESH_GEN_FACE_COUNT; face++) {
+			const vector4f *color = shape->face_colors ?
+				&shape->face_colors[face] : &shape->color;
+
+			vertices = face_vertices(vertices, format, &faces[face], counts, step, half,
+				color);
+			indices = grid_indices(indices, face * (n + 1) * (n + 1), n, n);
+		}
+		return;
+	}
+
+	for (j = 0; j <= n; j++) {
+		float position[3];
+
+		lattice[1] = j;
+		if (j == 0 || j == n) {
+			for (lattice[0] = 0; lattice[0] <= n; lattice[0]++) {
+				for (lattice[2] = 0; lattice[2] <= n; lattice[2]++) {
+					lattice_position(lattice, step, half, position);
+					vertices = put_vertex(vertices, format, position, NULL, NULL);
+				}
+			}
+		} else {
+			for (i = 0; i < 4 * n; i++) {
+				ring_point(i, n, lattice);
+				lattice_position(lattice, step, half, position);
+				vertices = put_vertex(vertices, format, position, NULL, NULL);
+			}
+		}
+	}
+
+	/* The faces' own grid indices, mapped to the shared points */
+	for (face = 0; face < MESH_GEN_FACE_COUNT; face++) {
+		unsigned short *end = grid_indices(indices, 0, n, n);
+
+		for (; indices < end; indices++) {
+			face_lattice(&faces[face], *indices % (n + 1), *indices / (n + 1), counts,
+				lattice);
+			*indices = box_point_index(lattice, n);
+		}
+	}
+}
+
+static void generate_plane(const struct mesh_gen_shape *shape, enum mesh_gen_format format,
+	float *vertices, unsigned short *indices)
+{
+	const struct face *face = &faces[shape->face];
+	const float size[3] = {shape->size.x, shape->size.y, shape->size.z};
+	unsigned int counts[3];
+	float step[3], half[3];
+	unsigned int i;
+
+	counts[face->u_axis] = shape->segments[0];
+	counts[face->v_axis] = shape->segments[1];
+	counts[face->normal_axis] = 1;
+
+	for (i = 0; i < 3; i++) {
+		step[i] = i == face->normal_axis ? 0.0f : size[i] / counts[i];
+		half[i] = i == face->normal_axis ? 0.0f : size[i] / 2.0f;
+	}
+
+	face_vertices(vertices, format, face, counts, step, half, &shape->color);
+	grid_indices(indices, 0, shape->segments[0], shape->segments[1]);
+}
+
+static void generate_frame(const struct mesh_gen_shape *shape, enum mesh_gen_format format,
+	float *vertices, unsigned short *indices)
+{
+	const struct face *face = &faces[shape->face];
+	const float size[3] = {shape->size.x, shape->size.y, shape->size.z};
+	float normal[3] = {0.0f, 0.0f, 0.0f};
+	unsigned int ring, corner;
+
+	normal[face->normal_axis] = face->normal_sign;
+
+	for (ring = 0; ring < 2; ring++) {
+		float border = ring == 0 ? shape->border : 0.0f;
+
+		for (corner = 0; corner < 4; corner++) {
+			float position[3] = {0.0f, 0.0f, 0.0f};
+
+			position[face->u_axis] = face->u_sign * frame_corners[corner][0] *
+				(size[face->u_axis] / 2.0f + border);
+			position[face->v_axis] = face->v_sign * frame_corners[corner][1] *
+				(size[face->v_axis] / 2.0f + border);
+			vertices = put_vertex(vertices, format, position, normal, &shape->color);
+		}
+	}
+
+	memcpy(indices, frame_indices, sizeof(frame_indices));
+}
+
+/*
+ * The poles are single vertices, the rings in between have one vertex per
+ * segment, sharing the seam. Triangles go pole to pole in bands of segments.
+ */
+static void generate_sphere(const struct mesh_gen_shape *shape, enum mesh_gen_format format,
+	float *vertices, unsigned short *indices)
+{
+	unsigned int rings = shape->segments[0], segments = shape->segments[1];
+	unsigned int bottom = 1 + (rings - 1) * segments;
+	float segment_cos[MESH_GEN_MAX_SEGMENTS], segment_sin[MESH_GEN_MAX_SEGMENTS];
+	float position[3], normal[3];
+	unsigned int band, ring, s;
+
+	for (s = 0; s < segments; s++) {
+		float phi = 2.0f * M_PI * s / segments;
+
+		segment_cos[s] = cosf(phi);
+		segment_sin[s] = sinf(phi);
+	}
+
+	for (ring = 0; ring <= rings; ring++) {
+		float theta = M_PI * ring / rings;
+		float y = ring == 0 ? 1.0f : ring == rings ? -1.0f : cosf(theta);
+		float xz = sinf(theta);
+		unsigned int count = ring == 0 || ring == rings ? 1 : segments;
+
+		for (s = 0; s < count; s++) {
+			normal[0] = count == 1 ? 0.0f : xz * segment_cos[s];
+			normal[1] = y;
+			normal[2] = count == 1 ? 0.0f : xz * segment_sin[s];
+			position[0] = normal[0] * shape->radius;
+			position[1] = normal[1] * shape->radius;
+			position[2] = normal[2] * shape->radius;
+			vertices = put_vertex(vertices, format, position, normal, &shape->color);
+		}
+	}
+
+	for (band = 0; band < segments; band += BAND_QUADS) {
+		unsigned int end = band + BAND_QUADS < segments ? band + BAND_QUADS : segments;
+		unsigned int last = 1 + (rings - 2) * segments;
+
+		for (s = band; s < end; s++) {
+			unsigned int next = s + 1 < segments ? s + 1 : 0;
+
+			indices[0] = 0;
+			indices[1] = 1 + next;
+			indices[2] = 1 + s;
+			indices += 3;
+		}
+
+		for (ring = 1; ring < rings - 1; ring++) {
+			unsigned int upper = 1 + (ring - 1) * segments;
+			unsigned int lower = upper + segments;
+
+			for (s = band; s < end; s++) {
+				unsigned int next = s + 1 < segments ? s + 1 : 0;
+
+				indices[0] = upper + s;
+				indices[1] = upper + next;
+				indices[2] = lower + s;
+				indices[3] = lower + s;
+				indices[4] = upper + next;
+				indices[5] = lower + next;
+				indices += 6;
+			}
+		}
+
+		for (s = band; s < end; s++) {
+			unsigned int next = s + 1 < segments ? s + 1 : 0;
+
+			indices[0] = last + s;
+			indices[1] = last + next;
+			indices[2] = bottom;
+			indices += 3;
+		}
+	}
+}
+
+/* One box is generated, the others are copies of it moved into place */
+static void generate_grid(const struct mesh_gen_shape *shape, enum mesh_gen_format format,
+	float *vertices, unsigned short *indices)
+{
+	unsigned int columns = shape->segments[0], cells = columns * shape->segments[1];
+	size_t floats = mesh_gen_vertex_size(format) / sizeof(float);
+	float pitch_x = shape->size.x + shape->spacing;
+	float pitch_z = shape->size.z + shape->spacing;
+	float first_x = -(columns - 1.0f) * pitch_x / 2.0f;
+	float first_z = -(shape->segments[1] - 1.0f) * pitch_z / 2.0f;
+	uint64_t box_vertices, box_indices;
+	unsigned int cell, i;
+
+	box_count(1, format, &box_vertices, &box_indices);
+	generate_box(shape, format, 1, vertices, indices);
+
+	/* Backwards, the first box is moved last */
+	for (cell = cells; cell-- > 0;) {
+		float *cell_vertices = vertices + cell * box_vertices * floats;
+		unsigned short *cell_indices = indices + cell * box_indices;
+		float x = first_x + cell % columns * pitch_x;
+		float z = first_z + cell / columns * pitch_z;
+
+		if (cell > 0) {
+			memcpy(cell_vertices, vertices, box_vertices * floats * sizeof(float));
+			for (i = 0; i < box_indices; i++)
+				cell_indices[i] = indices[i] + cell * box_vertices;
+		}
+
+		for (i = 0; i < box_vertices; i++) {
+			cell_vertices[i * floats] += x;
+			cell_vertices[i * floats + 2] += z;
+		}
+	}
+}
+
+static void shape_bounds(const struct mesh_gen_shape *shape, struct mesh_gen_result *result)
+{
+	float extent[3] = {shape->size.x, shape->size.y, shape->size.z};
+	const struct face *face;
+	vector3f diagonal;
+
+	switch (shape->type) {
+	case MESH_GEN_PLANE:
+	case MESH_GEN_FRAME:
+		face = &faces[shape->face];
+		extent[face->normal_axis] = 0.0f;
+		if (shape->type == MESH_GEN_FRAME) {
+			extent[face->u_axis] += 2.0f * shape->border;
+			extent[face->v_axis] += 2.0f * shape->border;
+		}
+		break;
+	case MESH_GEN_SPHERE:
+		extent[0] = extent[1] = extent[2] = 2.0f * shape->radius;
+		break;
+	case MESH_GEN_GRID:
+		extent[0] = shape->segments[0] * (shape->size.x + shape->spacing) - shape->spacing;
+		extent[2] = shape->segments[1] * (shape->size.z + shape->spacing) - shape->spacing;
+		break;
+	default:
+		break;
+	}
+
+	vector3f_init(&result->bounds_min, -extent[0] / 2.0f, -extent[1] / 2.0f, -extent[2] / 2.0f);
+	vector3f_init(&result->bounds_max, extent[0] / 2.0f, extent[1] / 2.0f, extent[2] / 2.0f);
+	vector3f_init(&result->center, 0.0f, 0.0f, 0.0f);
+	vector3f_init(&diagonal, extent[0], extent[1], extent[2]);
+	result->radius = shape->type == MESH_GEN_SPHERE ?
+		shape->radius : vector3f_length(&diagonal) / 2.0f;
+}
+
+size_t mesh_gen_vertex_size(enum mesh_gen_format format)
+{
+	return (format == MESH_GEN_POSITION ? 3 : 10) * sizeof(float);
+}
+
+int mesh_gen_count(const struct mesh_gen_shape *shape, enum mesh_gen_format format,
+	unsigned int *vertex_count, unsigned int *index_count)
+{
+	unsigned int n = shape->segments[0], m = shape->segments[1];
+	uint64_t vertices, indices;
+
+	switch (shape->type) {
+	case MESH_GEN_BOX:
+		if (n < 1 || n >= MESH_GEN_MAX_VERTICES)
+			return -1;
+		box_count(n, format, &vertices, &indices);
+		break;
+	case MESH_GEN_PLANE:
+		if (shape->face >= MESH_GEN_FACE_COUNT || n < 1 || m < 1 ||
+		    n >= MESH_GEN_MAX_VERTICES || m >= MESH_GEN_MAX_VERTICES)
+			return -1;
+		vertices = (uint64_t)(n + 1) * (m + 1);
+		indices = (uint64_t)6 * n * m;
+		break;
+	case MESH_GEN_FRAME:
+		if (shape->face >= MESH_GEN_FACE_COUNT)
+			return -1;
+		vertices = 8;
+		indices = 24;
+		break;
+	case MESH_GEN_SPHERE:
+		if (n < 2 || m < 3 || n > MESH_GEN_MAX_SEGMENTS || m > MESH_GEN_MAX_SEGMENTS)
+			return -1;
+		vertices = 2 + (uint64_t)(n - 1) * m;
+		indices = (uint64_t)6 * m * (n - 1);
+		break;
+	case MESH_GEN_GRID:
+		if (n < 1 || m < 1 || n >= MESH_GEN_MAX_VERTICES || m >= MESH_GEN_MAX_VERTICES)
+			return -1;
+		box_count(1, format, &vertices, &indices);
+		vertices *= (uint64_t)n * m;
+		indices *= (uint64_t)n * m;
+		break;
+	default:
+		return -1;
+	}
+
+	if (vertices > MESH_GEN_MAX_VERTICES)
+		return -1;
+
+	*vertex_count = vertices;
+	*index_count = indices;
+
+	return 0;
+}
+
+int mesh_gen_generate(const struct mesh_gen_shape *shape, enum mesh_gen_format format,
+	void *vertices, unsigned short *indices, struct mesh_gen_result *result)
+{
+	if (mesh_gen_count(shape, format, &result->vertex_count, &result->index_count) < 0)
+		return -1;
+
+	switch (shape->type) {
+	case MESH_GEN_BOX:
+		generate_box(shape, format, shape->segments[0], vertices, indices);
+		break;
+	case MESH_GEN_PLANE:
+		generate_plane(shape, format, vertices, indices);
+		break;
+	case MESH_GEN_FRAME:
+		generate_frame(shape, format, vertices, indices);
+		break;
+	case MESH_GEN_SPHERE:
+		generate_sphere(shape, format, vertices, indices);
+		break;
+	case MESH_GEN_GRID:
+		generate_grid(shape, format, vertices, indices);
+		break;
+	}
+
+	shape_bounds(shape, result);
+
+	return 0;
+}
@@ -0,0 +1,612 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "mesh_simplify.h"
+
+/* Border planes are weighted up so the outline moves last */
+#define BORDER_WEIGHT 10.0f
+/* Flipping or nearly flipping a triangle rejects a collapse */
+#define FLIP_MIN_COS 0.2f
+
+enum vertex_kind {
+	VERTEX_MANIFOLD,
+	VERTEX_BORDER,
+	VERTEX_LOCKED
+};
+
+/* Symmetric quadric: error(p) = (p'Ap + 2b.p + c) / w */
+struct quadric {
+	float a00, a11, a22, a01, a02, a12;
+	float b0, b1, b2;
+	float c;
+	float w;
+};
+
+struct collapse {
+	float cost;
+	unsigned int from;
+	unsigned int to;
+};
+
+struct edge_entry {
+	uint32_t from;
+	uint32_t to;
+	unsigned int count;
+};
+
+struct simplifier {
+	const char *vertices;
+	size_t vertex_size;
+	unsigned int vertex_count;
+	/* First vertex with the same position, and a ring through all of them */
+	unsigned int *welded;
+	unsigned int *wedge_next;
+	/* Set on the first vertex when its copies have different attributes */
+	unsigned char *seams;
+	/* Index buffer rewrite of the collapsed vertices */
+	unsigned int *remap;
+	struct quadric *quadrics;
+	unsigned char *kinds;
+	unsigned char *touched;
+	/* Triangles around each welded vertex, rebuilt every pass */
+	unsigned int *adjacency_offsets;
+	unsigned int *adjacency;
+	/* Directed welded edges, open addressing */
+	struct edge_entry *edges;
+	unsigned int edge_mask;
+	struct collapse *collapses;
+};
+
+static const float *position(const struct simplifier *s, unsigned int v)
+{
+	return (const float *)(s->vertices + v * s->vertex_size);
+}
+
+static int same_attributes(const struct simplifier *s, unsigned int a, unsigned int b)
+{
+	return memcmp(s->vertices + a * s->vertex_size + 3 * sizeof(float),
+		s->vertices + b * s->vertex_size + 3 * sizeof(float),
+		s->vertex_size - 3 * sizeof(float)) == 0;
+}
+
+static uint32_t hash_uint(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+
+	return h;
+}
+
+static unsigned int table_size(unsigned int count)
+{
+	unsigned int size = 16;
+
+	while (size < count * 2)
+		size *= 2;
+
+	return size;
+}
+
+static int weld_vertices(struct simplifier *s)
+{
+	unsigned int size = table_size(s->vertex_count);
+	unsigned int *table = malloc(size * sizeof(*table));
+	unsigned int v;
+
+	if (!table)
+		return -1;
+
+	memset(table, 0xff, size * sizeof(*table));
+
+	for (v = 0; v < s->vertex_count; v++) {
+		const uint32_t *p = (const uint32_t *)position(s, v);
+		unsigned int slot = hash_uint(p[0] ^ hash_uint(p[1] ^ hash_uint(p[2]))) & (size - 1);
+
+		while (table[slot] != ~0u && memcmp(position(s, table[slot]), p, 3 * sizeof(float)))
+			slot = (slot + 1) & (size - 1);
+
+		if (table[slot] == ~0u) {
+			table[slot] = v;
+			s->welded[v] = v;
+			s->wedge_next[v] = v;
+		} else {
+			unsigned int first = table[slot];
+
+			s->welded[v] = first;
+			s->wedge_next[v] = s->wedge_next[first];
+			s->wedge_next[first] = v;
+			s->seams[first] |= !same_attributes(s, v, first);
+		}
+	}
+
+	free(table);
+
+	return 0;
+}
+
+static void triangle_normal(float *n, const float *a, const float *b, const float *c)
+{
+	float e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+	float e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+
+	n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+	n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+	n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+static void quadric_add_plane(struct quadric *q, const float *n, float d, float w)
+{
+	q->a00 += w * n[0] * n[0];
+	q->a11 += w * n[1] * n[1];
+	q->a22 += w * n[2] * n[2];
+	q->a01 += w * n[0] * n[1];
+	q->a02 += w * n[0] * n[2];
+	q->a12 += w * n[1] * n[2];
+	q->b0 += w * n[0] * d;
+	q->b1 += w * n[1] * d;
+	q->b2 += w * n[2] * d;
+	q->c += w * d * d;
+	q->w += w;
+}
+
+static void quadric_add(struct quadric *q, const struct quadric *r)
+{
+	q->a00 += r->a00;
+	q->a11 += r->a11;
+	q->a22 += r->a22;
+	q->a01 += r->a01;
+	q->a02 += r->a02;
+	q->a12 += r->a12;
+	q->b0 += r->b0;
+	q->b1 += r->b1;
+	q->b2 += r->b2;
+	q->c += r->c;
+	q->w += r->w;
+}
+
+static float quadric_error(const struct quadric *q, const float *p)
+{
+	float x = p[0], y = p[1], z = p[2];
+	float e = q->a00 * x * x + q->a11 * y * y + q->a22 * z * z +
+		2.0f * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z) +
+		2.0f * (q->b0 * x + q->b1 * y + q->b2 * z) + q->c;
+
+	if (q->w <= 0.0f)
+		return 0.0f;
+
+	return e > 0.0f ? e / q->w : 0.0f;
+}
+
+static struct edge_entry *find_edge(const struct simplifier *s, uint32_t from, uint32_t to)
+{
+	unsigned int slot = hash_uint(from * 0x9e3779b1u ^ to) & s->edge_mask;
+
+	while (s->edges[slot].count) {
+		if (s->edges[slot].from == from && s->edges[slot].to == to)
+			return &s->edges[slot];
+		slot = (slot + 1) & s->edge_mask;
+	}
+
+	return &s->edges[slot];
+}
+
+static unsigned int edge_count(const struct simplifier *s, uint32_t from, uint32_t to)
+{
+	return find_edge(s, from, to)->count;
+}
+
+/*
+ * Rebuild the welded topology of the current triangles: the directed
+ * edges, the triangles around each vertex and the kind of each vertex.
+ */
+static void build_topology(struct simplifier *s, const unsigned short *indices,
+	unsigned int index_count)
+{
+	unsigned int *border_counts = s->adjacency_offsets;
+	unsigned int i, v;
+
+	memset(s->edges, 0, (s->edge_mask + 1) * sizeof(*s->edges));
+	memset(s->kinds, VERTEX_MANIFOLD, s->vertex_count);
+
+	for (i = 0; i < index_count; i++) {
+		uint32_t from = s->welded[indices[i]];
+		uint32_t to = s->welded[indices[i % 3 == 2 ? i - 2 : i + 1]];
+		struct edge_entry *edge = find_edge(s, from, to);
+
+		edge->from = from;
+		edge->to = to;
+		/* The same directed edge twice means a non-manifold edge */
+		if (++edge->count > 1) {
+			s->kinds[from] = VERTEX_LOCKED;
+			s->kinds[to] = VERTEX_LOCKED;
+		}
+	}
+
+	/* Borders are the edges without a twin, a border vertex has two */
+	memset(border_counts, 0, (s->vertex_count + 1) * sizeof(*border_counts));
+	for (i = 0; i <= s->edge_mask; i++) {
+		const struct edge_entry *edge = &s->edges[i];
+
+		if (edge->count && !edge_count(s, edge->to, edge->from)) {
+			border_counts[edge->from]++;
+			border_counts[edge->to]++;
+		}
+	}
+
+	for (v = 0; v < s->vertex_count; v++) {
+		if (s->kinds[v] == VERTEX_LOCKED || !border_counts[v])
+			continue;
+		s->kinds[v] = border_counts[v] == 2 ? VERTEX_BORDER : VERTEX_LOCKED;
+	}
+
+	/* Counting sort of the triangles by welded vertex */
+	memset(s->adjacency_offsets, 0, (s->vertex_count + 1) * sizeof(*s->adjacency_offsets));
+	for (i = 0; i < index_count; i++)
+		s->adjacency_offsets[s->welded[indices[i]] + 1]++;
+	for (v = 0; v < s->vertex_count; v++)
+		s->adjacency_offsets[v + 1] += s->adjacency_offsets[v];
+	for (i = 0; i < index_count; i++)
+		s->adjacency[s->adjacency_offsets[s->welded[indices[i]]]++] = i / 3;
+	for (v = s->vertex_count; v > 0; v--)
+		s->adjacency_offsets[v] = s->adjacency_offsets[v - 1];
+	s->adjacency_offsets[0] = 0;
+}
+
+static void build_quadrics(struct simplifier *s, const unsigned short *indices,
+	unsigned int index_count)
+{
+	unsigned int i, j;
+
+	memset(s->quadrics, 0, s->vertex_count * sizeof(*s->quadrics));
+
+	for (i = 0; i < index_count; i += 3) {
+		const float *p[3];
+		float n[3], length;
+
+		for (j = 0; j < 3; j++)
+			p[j] = position(s, indices[i + j]);
+
+		triangle_normal(n, p[0], p[1], p[2]);
+		length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0f)
+			continue;
+
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+
+		/* Weighted by area */
+		for (j = 0; j < 3; j++) {
+			quadric_add_plane(&s->quadrics[s->welded[indices[i + j]]], n,
+				-(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]), length * 0.5f);
+		}
+
+		/* A plane through each border edge, perpendicular to the triangle */
+		for (j = 0; j < 3; j++) {
+			uint32_t from = s->welded[indices[i + j]];
+			uint32_t to = s->welded[indices[i + (j + 1) % 3]];
+			const float *a = p[j], *b = p[(j + 1) % 3];
+			float e[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+			float m[3], m_length;
+
+			if (edge_count(s, to, from))
+				continue;
+
+			m[0] = e[1] * n[2] - e[2] * n[1];
+			m[1] = e[2] * n[0] - e[0] * n[2];
+			m[2] = e[0] * n[1] - e[1] * n[0];
+			m_length = sqrtf(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+			if (m_length == 0.0f)
+				continue;
+
+			m[0] /= m_length;
+			m[1] /= m_length;
+			m[2] /= m_length;
+
+			float d = -(m[0] * a[0] + m[1] * a[1] + m[2] * a[2]);
+			float w = m_length * BORDER_WEIGHT;
+
+			quadric_add_plane(&s->quadrics[from], m, d, w);
+			quadric_add_plane(&s->quadrics[to], m, d, w);
+		}
+	}
+}
+
+static int can_collapse(const struct simplifier *s, unsigned int from, unsigned int to)
+{
+	if (s->kinds[from] == VERTEX_LOCKED)
+		return 0;
+	/* Along the border only */
+	if (s->kinds[from] == VERTEX_BORDER &&
+	    edge_count(s, from, to) + edge_count(s, to, from) != 1)
+		return 0;
+
+	return 1;
+}
+
+/* Whether moving from onto to keeps the orientation of its other triangles */
+static int collapse_keeps_orientation(const struct simplifier *s,
+	const unsigned short *indices, unsigned int from, unsigned int to)
+{
+	const float *target = position(s, to);
+	unsigned int i, j;
+
+	for (i = s->adjacency_offsets[from]; i < s->adjacency_offsets[from + 1]; i++) {
+		unsigned int triangle = s->adjacency[i];
+		const float *p[3], *q[3];
+		float n0[3], n1[3];
+		int contains_to = 0;
+
+		for (j = 0; j < 3; j++) {
+			unsigned int v = s->welded[indices[triangle * 3 + j]];
+
+			contains_to |= v == to;
+			p[j] = position(s, v);
+			q[j] = v == from ? target : p[j];
+		}
+
+		/* It goes away */
+		if (contains_to)
+			continue;
+
+		triangle_normal(n0, p[0], p[1], p[2]);
+		triangle_normal(n1, q[0], q[1], q[2]);
+
+		float dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+		float length0 = sqrtf(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+		float length1 = sqrtf(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+
+		if (dot <= FLIP_MIN_COS * length0 * length1)
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * A seam vertex maps each of its copies onto the copy of to with the
+ * same attributes. Any other vertex maps them all onto the copy of to its
+ * triangles already use, its attributes are interpolated away.
+ */
+static int remap_wedges(struct simplifier *s, const unsigned short *indices,
+	unsigned int from, unsigned int to)
+{
+	unsigned int v = from;
+
+	if (!s->seams[from]) {
+		unsigned int wedge = ~0u;
+		unsigned int i, j;
+
+		for (i = s->adjacency_offsets[from]; i < s->adjacency_offsets[from + 1]; i++) {
+			for (j = 0; j < 3; j++) {
+				unsigned int w = indices[s->adjacency[i] * 3 + j];
+
+				if (s->welded[w] != to)
+					continue;
+				/* The edge is on a seam of to */
+				if (wedge != ~0u && !same_attributes(s, wedge, w))
+					return 0;
+				wedge = w;
+			}
+		}
+
+		if (wedge == ~0u)
+			return 0;
+
+		do {
+			s->remap[v] = wedge;
+			v = s->wedge_next[v];
+		} while (v != from);
+
+		return 1;
+	}
+
+	do {
+		unsigned int w = to;
+
+		while (!same_attributes(s, v, w)) {
+			w = s->wedge_next[w];
+			if (w == to)
+				return 0;
+		}
+
+		v = s->wedge_next[v];
+	} while (v != from);
+
+	v = from;
+	do {
+		unsigned int w = to;
+
+		while (!same_attributes(s, v, w))
+			w = s->wedge_next[w];
+		s->remap[v] = w;
+
+		v = s->wedge_next[v];
+	} while (v != from);
+
+	return 1;
+}
+
+static void lock_neighbourhood(struct simplifier *s, const unsigned short *indices,
+	unsigned int v)
+{
+	unsigned int i, j;
+
+	for (i = s->adjacency_offsets[v]; i < s->adjacency_offsets[v + 1]; i++) {
+		for (j = 0; j < 3; j++)
+			s->touched[s->welded[indices[s->adjacency[i] * 3 + j]]] = 1;
+	}
+}
+
+static int compare_collapses(const void *a, const void *b)
+{
+	float cost_a = ((const struct collapse *)a)->cost;
+	float cost_b = ((const struct collapse *)b)->cost;
+
+	return (cost_a > cost_b) - (cost_a < cost_b);
+}
+
+/* Cheapest valid direction of each edge, returns how many there are */
+static unsigned int rank_collapses(struct simplifier *s, const unsigned short *indices,
+	unsigned int index_count, float max_cost)
+{
+	unsigned int count = 0;
+	unsigned int i;
+
+	for (i = 0; i < index_count; i++) {
+		uint32_t a = s->welded[indices[i]];
+		uint32_t b = s->welded[indices[i % 3 == 2 ? i - 2 : i + 1]];
+		struct quadric q;
+		float cost_ab, cost_ba;
+
+		/* Visit interior edges once, from their lower vertex */
+		if (a == b || (a > b && edge_count(s, b, a)))
+			continue;
+
+		q = s->quadrics[a];
+		quadric_add(&q, &s->quadrics[b]);
+
+		cost_ab = can_collapse(s, a, b) ? quadric_error(&q, position(s, b)) : INFINITY;
+		cost_ba = can_collapse(s, b, a) ? quadric_error(&q, position(s, a)) : INFINITY;
+
+		if (cost_ab <= cost_ba && cost_ab <= max_cost)
+			s->collapses[count++] = (struct collapse){cost_ab, a, b};
+		else if (cost_ba < cost_ab && cost_ba <= max_cost)
+			s->collapses[count++] = (struct collapse){cost_ba, b, a};
+	}
+
+	qsort(s->collapses, count, sizeof(*s->collapses), compare_collapses);
+
+	return count;
+}
+
+/* Rewrite the indices and drop the triangles that became degenerate */
+static unsigned int apply_remap(struct simplifier *s, unsigned short *indices,
+	unsigned int index_count)
+{
+	unsigned int count = 0;
+	unsigned int i;
+
+	for (i = 0; i < index_count; i += 3) {
+		unsigned int a = s->remap[indices[i + 0]];
+		unsigned int b = s->remap[indices[i + 1]];
+		unsigned int c = s->remap[indices[i + 2]];
+
+		if (s->welded[a] == s->welded[b] || s->welded[b] == s->welded[c] ||
+		    s->welded[c] == s->welded[a])
+			continue;
+
+		indices[count++] = a;
+		indices[count++] = b;
+		indices[count++] = c;
+	}
+
+	return count;
+}
+
+static void simplifier_free(struct simplifier *s)
+{
+	free(s->welded);
+	free(s->wedge_next);
+	free(s->seams);
+	free(s->remap);
+	free(s->quadrics);
+	free(s->kinds);
+	free(s->touched);
+	free(s->adjacency_offsets);
+	free(s->adjacency);
+	free(s->edges);
+	free(s->collapses);
+}
+
+int mesh_simplify(unsigned short *destination, const unsigned short *indices,
+	unsigned int index_count, const void *vertices, unsigned int vertex_count,
+	size_t vertex_size, unsigned int target_index_count, float target_error,
+	float *result_error)
+{
+	struct simplifier s;
+	float max_cost = target_error * target_error;
+	float error = 0.0f;
+	unsigned int edge_table_size = table_size(index_count);
+	unsigned int v;
+
+	memmove(destination, indices, index_count * sizeof(*indices));
+	index_count -= index_count % 3;
+
+	memset(&s, 0, sizeof(s));
+	s.vertices = vertices;
+	s.vertex_size = vertex_size;
+	s.vertex_count = vertex_count;
+	s.welded = malloc(vertex_count * sizeof(*s.welded));
+	s.wedge_next = malloc(vertex_count * sizeof(*s.wedge_next));
+	s.seams = calloc(vertex_count, 1);
+	s.remap = malloc(vertex_count * sizeof(*s.remap));
+	s.quadrics = malloc(vertex_count * sizeof(*s.quadrics));
+	s.kinds = malloc(vertex_count);
+	s.touched = malloc(vertex_count);
+	s.adjacency_offsets = malloc((vertex_count + 1) * sizeof(*s.adjacency_offsets));
+	s.adjacency = malloc(index_count * sizeof(*s.adjacency) + 1);
+	s.edges = malloc(edge_table_size * sizeof(*s.edges));
+	s.edge_mask = edge_table_size - 1;
+	s.collapses = malloc(index_count * sizeof(*s.collapses) + 1);
+
+	if (!s.welded || !s.wedge_next || !s.seams || !s.remap || !s.quadrics || !s.kinds ||
+	    !s.touched || !s.adjacency_offsets || !s.adjacency || !s.edges ||
+	    !s.collapses || weld_vertices(&s) < 0) {
+		simplifier_free(&s);
+		return -1;
+	}
+
+	build_topology(&s, destination, index_count);
+	build_quadrics(&s, destination, index_count);
+
+	/*
+	 * Each pass ranks the collapses of the current mesh and applies the
+	 * cheapest ones that don't touch each other's triangles.
+	 */
+	while (index_count > target_index_count) {
+		unsigned int collapse_count = rank_collapses(&s, destination, index_count, max_cost);
+		unsigned int removed = 0;
+		unsigned int i;
+
+		for (v = 0; v < vertex_count; v++)
+			s.remap[v] = v;
+		memset(s.touched, 0, vertex_count);
+
+		for (i = 0; i < collapse_count && index_count - removed > target_index_count; i++) {
+			const struct collapse *c = &s.collapses[i];
+
+			if (s.touched[c->from] || s.touched[c->to])
+				continue;
+			if (!collapse_keeps_orientation(&s, destination, c->from, c->to))
+				continue;
+			if (!remap_wedges(&s, destination, c->from, c->to))
+				continue;
+
+			quadric_add(&s.quadrics[c->to], &s.quadrics[c->from]);
+			lock_neighbourhood(&s, destination, c->from);
+			if (c->cost > error)
+				error = c->cost;
+
+			/* Two triangles inside, one on a border */
+			removed += s.kinds[c->from] == VERTEX_BORDER ? 3 : 6;
+		}
+
+		if (!removed)
+			break;
+
+		index_count = apply_remap(&s, destination, index_count);
+		build_topology(&s, destination, index_count);
+	}
+
+	simplifier_free(&s);
+
+	if (result_error)
+		*result_error = sqrtf(error);
+
+	return index_count;
+}
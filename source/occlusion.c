@@ -0,0 +1,301 @@
+#include <stdint.h>
+#include <float.h>
+#include "occlusion.h"
+
+typedef float vec4f __attribute__((vector_size(16)));
+typedef int32_t vec4i __attribute__((vector_size(16)));
+
+/* Vertex after the perspective divide, in pixels */
+struct screen_vertex {
+	float x, y, z;
+};
+
+static inline vec4f splat(float x)
+{
+	return (vec4f){x, x, x, x};
+}
+
+static inline vec4f blend(vec4i mask, vec4f a, vec4f b)
+{
+	return (vec4f)(((vec4i)a & mask) | ((vec4i)b & ~mask));
+}
+
+static inline float min_float(float a, float b)
+{
+	return a < b ? a : b;
+}
+
+static inline float max_float(float a, float b)
+{
+	return a > b ? a : b;
+}
+
+static inline int clamp_int(int x, int min, int max)
+{
+	return x < min ? min : (x > max ? max : x);
+}
+
+static void to_screen(struct screen_vertex *s, const vector4f *clip)
+{
+	float inv_w = 1.0f / clip->w;
+
+	s->x = (clip->x * inv_w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+	s->y = (0.5f - clip->y * inv_w * 0.5f) * OCCLUSION_HEIGHT;
+	s->z = clip->z * inv_w * 0.5f + 0.5f;
+}
+
+/* Pixel ranges are inclusive, the samples are at the pixel centers */
+static void rasterize_triangle(struct occlusion_buffer *buffer,
+	const struct screen_vertex *a, const struct screen_vertex *b,
+	const struct screen_vertex *c)
+{
+	static const vec4f lane_offsets = {0.5f, 1.5f, 2.5f, 3.5f};
+	float area = (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+	int x0, x1, y0, y1, x, y;
+
+	if (area == 0.0f)
+		return;
+
+	/* Make the edge functions positive inside whatever the winding */
+	if (area < 0.0f) {
+		const struct screen_vertex *tmp = b;
+		b = c;
+		c = tmp;
+		area = -area;
+	}
+
+	float min_x = min_float(a->x, min_float(b->x, c->x));
+	float max_x = max_float(a->x, max_float(b->x, c->x));
+	float min_y = min_float(a->y, min_float(b->y, c->y));
+	float max_y = max_float(a->y, max_float(b->y, c->y));
+
+	if (max_x < 0.0f || min_x > OCCLUSION_WIDTH || max_y < 0.0f || min_y > OCCLUSION_HEIGHT)
+		return;
+
+	x0 = clamp_int((int)(max_float(min_x, 0.0f) - 0.5f), 0, OCCLUSION_WIDTH - 1) & ~3;
+	x1 = clamp_int((int)(min_float(max_x, OCCLUSION_WIDTH) - 0.5f), 0, OCCLUSION_WIDTH - 1);
+	y0 = clamp_int((int)(max_float(min_y, 0.0f) - 0.5f), 0, OCCLUSION_HEIGHT - 1);
+	y1 = clamp_int((int)(min_float(max_y, OCCLUSION_HEIGHT) - 0.5f), 0, OCCLUSION_HEIGHT - 1);
+
+	/* Edge functions and depth as planes: e = ex * x + ey * y + e0 */
+	float e0x = a->y - b->y, e0y = b->x - a->x;
+	float e1x = b->y - c->y, e1y = c->x - b->x;
+	float e2x = c->y - a->y, e2y = a->x - c->x;
+	float e00 = -(e0x * a->x + e0y * a->y);
+	float e10 = -(e1x * b->x + e1y * b->y);
+	float e20 = -(e2x * c->x + e2y * c->y);
+
+	float inv_area = 1.0f / area;
+	float zx = ((b->z - a->z) * (c->y - a->y) - (c->z - a->z) * (b->y - a->y)) * inv_area;
+	float zy = ((c->z - a->z) * (b->x - a->x) - (b->z - a->z) * (c->x - a->x)) * inv_area;
+	float z0 = a->z - zx * a->x - zy * a->y;
+
+	vec4f e0_step = splat(e0x * 4.0f);
+	vec4f e1_step = splat(e1x * 4.0f);
+	vec4f e2_step = splat(e2x * 4.0f);
+	vec4f z_step = splat(zx * 4.0f);
+
+	for (y = y0; y <= y1; y++) {
+		float py = y + 0.5f;
+		vec4f px = splat((float)x0) + lane_offsets;
+		vec4f e0 = splat(e0x) * px + splat(e0y * py + e00);
+		vec4f e1 = splat(e1x) * px + splat(e1y * py + e10);
+		vec4f e2 = splat(e2x) * px + splat(e2y * py + e20);
+		vec4f z = splat(zx) * px + splat(zy * py + z0);
+		float *row = buffer->depth[y];
+
+		for (x = x0; x <= x1; x += 4) {
+			vec4f *depth = (vec4f *)&row[x];
+			vec4i mask = (e0 >= 0.0f) & (e1 >= 0.0f) & (e2 >= 0.0f) & (z < *depth);
+
+			*depth = blend(mask, z, *depth);
+
+			e0 += e0_step;
+			e1 += e1_step;
+			e2 += e2_step;
+			z += z_step;
+		}
+	}
+
+	buffer->occluder_triangles++;
+}
+
+/*
+ * Clip against the near plane (z >= -w) only, the rasterizer clamps to
+ * the screen and the depth test drops what is past the far plane.
+ */
+static void draw_triangle(struct occlusion_buffer *buffer, const vector4f clip[3])
+{
+	vector4f clipped[4];
+	struct screen_vertex screen[4];
+	unsigned int count = 0;
+	unsigned int i;
+
+	for (i = 0; i < 3; i++) {
+		const vector4f *p = &clip[i];
+		const vector4f *q = &clip[(i + 1) % 3];
+		float dp = p->z + p->w;
+		float dq = q->z + q->w;
+
+		if (dp >= 0.0f)
+			clipped[count++] = *p;
+		if ((dp >= 0.0f) != (dq >= 0.0f)) {
+			float t = dp / (dp - dq);
+
+			clipped[count].x = p->x + (q->x - p->x) * t;
+			clipped[count].y = p->y + (q->y - p->y) * t;
+			clipped[count].z = p->z + (q->z - p->z) * t;
+			clipped[count].w = p->w + (q->w - p->w) * t;
+			count++;
+		}
+	}
+
+	if (count < 3)
+		return;
+
+	for (i = 0; i < count; i++)
+		to_screen(&screen[i], &clipped[i]);
+
+	for (i = 1; i + 1 < count; i++)
+		rasterize_triangle(buffer, &screen[0], &screen[i], &screen[i + 1]);
+}
+
+void occlusion_begin(struct occlusion_buffer *buffer, const matrix4x4 view_projection)
+{
+	vec4f far = splat(1.0f);
+	unsigned int x, y;
+
+	for (y = 0; y < OCCLUSION_HEIGHT; y++) {
+		for (x = 0; x < OCCLUSION_WIDTH; x += 4)
+			*(vec4f *)&buffer->depth[y][x] = far;
+	}
+
+	matrix4x4_copy(buffer->view_projection, view_projection);
+	buffer->occluder_triangles = 0;
+}
+
+void occlusion_draw(struct occlusion_buffer *buffer, const matrix4x4 model_matrix,
+	const struct occlusion_mesh *mesh)
+{
+	matrix4x4 mvp;
+	unsigned int i, j;
+
+	matrix4x4_multiply(mvp, buffer->view_projection, model_matrix);
+
+	for (i = 0; i + 2 < mesh->index_count; i += 3) {
+		vector4f clip[3];
+
+		for (j = 0; j < 3; j++) {
+			const vector3f *v = &mesh->vertices[mesh->indices[i + j]];
+			vector4f position = {.x = v->x, .y = v->y, .z = v->z, .w = 1.0f};
+
+			vector4f_matrix4x4_mult(&clip[j], mvp, &position);
+		}
+
+		draw_triangle(buffer, clip);
+	}
+}
+
+void occlusion_end(struct occlusion_buffer *buffer)
+{
+	unsigned int tx, ty, x, y;
+
+	for (ty = 0; ty < OCCLUSION_TILES_Y; ty++) {
+		for (tx = 0; tx < OCCLUSION_TILES_X; tx++) {
+			vec4f max = splat(0.0f);
+
+			for (y = ty * OCCLUSION_TILE_SIZE; y < (ty + 1) * OCCLUSION_TILE_SIZE; y++) {
+				for (x = tx * OCCLUSION_TILE_SIZE; x < (tx + 1) * OCCLUSION_TILE_SIZE; x += 4) {
+					vec4f depth = *(const vec4f *)&buffer->depth[y][x];
+
+					max = blend(depth > max, depth, max);
+				}
+			}
+
+			buffer->tile_max_depth[ty][tx] = max_float(max_float(max[0], max[1]),
+				max_float(max[2], max[3]));
+		}
+	}
+}
+
+/* Whether any pixel of the rectangle is not in front of depth */
+static int test_rect(const struct occlusion_buffer *buffer, int x0, int y0,
+	int x1, int y1, float depth)
+{
+	int tx, ty, x, y;
+
+	for (ty = y0 / OCCLUSION_TILE_SIZE; ty <= y1 / OCCLUSION_TILE_SIZE; ty++) {
+		for (tx = x0 / OCCLUSION_TILE_SIZE; tx <= x1 / OCCLUSION_TILE_SIZE; tx++) {
+			int tile_y0, tile_y1, tile_x0, tile_x1;
+
+			if (buffer->tile_max_depth[ty][tx] < depth)
+				continue;
+
+			tile_y0 = clamp_int(ty * OCCLUSION_TILE_SIZE, y0, y1);
+			tile_y1 = clamp_int((ty + 1) * OCCLUSION_TILE_SIZE - 1, y0, y1);
+			tile_x0 = clamp_int(tx * OCCLUSION_TILE_SIZE, x0, x1);
+			tile_x1 = clamp_int((tx + 1) * OCCLUSION_TILE_SIZE - 1, x0, x1);
+
+			for (y = tile_y0; y <= tile_y1; y++) {
+				for (x = tile_x0; x <= tile_x1; x++) {
+					if (buffer->depth[y][x] >= depth)
+						return 1;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+int occlusion_test_points(const struct occlusion_buffer *buffer,
+	const vector3f *points, unsigned int count)
+{
+	float min_x = FLT_MAX, min_y = FLT_MAX, min_z = FLT_MAX;
+	float max_x = -FLT_MAX, max_y = -FLT_MAX;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		vector4f position = {.x = points[i].x, .y = points[i].y, .z = points[i].z, .w = 1.0f};
+		vector4f clip;
+		struct screen_vertex s;
+
+		vector4f_matrix4x4_mult(&clip, buffer->view_projection, &position);
+
+		/* Crosses the near plane, can't bound it on screen */
+		if (clip.z < -clip.w || clip.w <= 0.0f)
+			return 1;
+
+		to_screen(&s, &clip);
+		min_x = min_float(min_x, s.x);
+		max_x = max_float(max_x, s.x);
+		min_y = min_float(min_y, s.y);
+		max_y = max_float(max_y, s.y);
+		min_z = min_float(min_z, s.z);
+	}
+
+	if (max_x < 0.0f || min_x >= OCCLUSION_WIDTH || max_y < 0.0f || min_y >= OCCLUSION_HEIGHT)
+		return 0;
+
+	return test_rect(buffer,
+		clamp_int((int)max_float(min_x, 0.0f), 0, OCCLUSION_WIDTH - 1),
+		clamp_int((int)max_float(min_y, 0.0f), 0, OCCLUSION_HEIGHT - 1),
+		clamp_int((int)min_float(max_x, OCCLUSION_WIDTH), 0, OCCLUSION_WIDTH - 1),
+		clamp_int((int)min_float(max_y, OCCLUSION_HEIGHT), 0, OCCLUSION_HEIGHT - 1),
+		min_z);
+}
+
+int occlusion_test_aabb(const struct occlusion_buffer *buffer,
+	const vector3f *min, const vector3f *max)
+{
+	vector3f corners[8];
+	unsigned int i;
+
+	for (i = 0; i < 8; i++) {
+		corners[i].x = (i & 1) ? max->x : min->x;
+		corners[i].y = (i & 2) ? max->y : min->y;
+		corners[i].z = (i & 4) ? max->z : min->z;
+	}
+
+	return occlusion_test_points(buffer, corners, 8);
+}
@@ -0,0 +1,419 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmark.h"
+#include "options.h"
+
+#ifndef OPTIONS_DEFAULT_PIPELINE_MODE
+#define OPTIONS_DEFAULT_PIPELINE_MODE PIPELINE_MODE_OFF
+#endif
+
+#ifndef OPTIONS_DEFAULT_REPORT_INTERVAL
+#define OPTIONS_DEFAULT_REPORT_INTERVAL 0
+#endif
+
+#ifndef OPTIONS_DEFAULT_DISPLAY_BUFFERS
+#define OPTIONS_DEFAULT_DISPLAY_BUFFERS 2
+#endif
+
+#ifndef OPTIONS_DEFAULT_DISPLAY_LATENCY
+#define OPTIONS_DEFAULT_DISPLAY_LATENCY DISPLAY_LATENCY_LOW
+#endif
+
+#ifndef OPTIONS_DEFAULT_VSYNC
+#define OPTIONS_DEFAULT_VSYNC 1
+#endif
+
+#ifndef OPTIONS_DEFAULT_COLOR_DEPTH
+#define OPTIONS_DEFAULT_COLOR_DEPTH COLOR_DEPTH_32
+#endif
+
+#ifndef OPTIONS_DEFAULT_OCCLUSION
+#define OPTIONS_DEFAULT_OCCLUSION 1
+#endif
+
+#ifndef OPTIONS_DEFAULT_PORTAL_MODE
+#define OPTIONS_DEFAULT_PORTAL_MODE PORTAL_MODE_STENCIL
+#endif
+
+#ifndef OPTIONS_DEFAULT_DYNAMIC_RESOLUTION
+#define OPTIONS_DEFAULT_DYNAMIC_RESOLUTION 0
+#endif
+
+#ifndef OPTIONS_DEFAULT_DYNRES_TARGET_MS
+#define OPTIONS_DEFAULT_DYNRES_TARGET_MS (1000.0f / 60.0f)
+#endif
+
+#ifndef OPTIONS_DEFAULT_DYNRES_MIN_SCALE
+#define OPTIONS_DEFAULT_DYNRES_MIN_SCALE 0.5f
+#endif
+
+#ifndef OPTIONS_DEFAULT_DYNRES_MAX_SCALE
+#define OPTIONS_DEFAULT_DYNRES_MAX_SCALE 1.0f
+#endif
+
+#ifndef OPTIONS_DEFAULT_DYNRES_PORTAL_MIN_SCALE
+#define OPTIONS_DEFAULT_DYNRES_PORTAL_MIN_SCALE 0.25f
+#endif
+
+#ifndef OPTIONS_DEFAULT_DYNRES_PORTAL_MAX_SCALE
+#define OPTIONS_DEFAULT_DYNRES_PORTAL_MAX_SCALE 1.0f
+#endif
+
+#ifndef OPTIONS_DEFAULT_LOD_BIAS
+#define OPTIONS_DEFAULT_LOD_BIAS 1.0f
+#endif
+
+#ifndef OPTIONS_DEFAULT_SIMULATION_RATE
+#define OPTIONS_DEFAULT_SIMULATION_RATE 60
+#endif
+
+#ifndef OPTIONS_DEFAULT_FRAME_LIMIT
+#define OPTIONS_DEFAULT_FRAME_LIMIT 0
+#endif
+
+void options_init_default(struct options *options)
+{
+	memset(options, 0, sizeof(*options));
+	options->pipeline_mode = OPTIONS_DEFAULT_PIPELINE_MODE;
+	options->report_interval = OPTIONS_DEFAULT_REPORT_INTERVAL;
+	options->display_buffers = OPTIONS_DEFAULT_DISPLAY_BUFFERS;
+	options->display_latency = OPTIONS_DEFAULT_DISPLAY_LATENCY;
+	options->vsync = OPTIONS_DEFAULT_VSYNC;
+	options->color_depth = OPTIONS_DEFAULT_COLOR_DEPTH;
+	options->occlusion = OPTIONS_DEFAULT_OCCLUSION;
+	options->portal_mode = OPTIONS_DEFAULT_PORTAL_MODE;
+	options->dynamic_resolution = OPTIONS_DEFAULT_DYNAMIC_RESOLUTION;
+	options->dynres_target_ms = OPTIONS_DEFAULT_DYNRES_TARGET_MS;
+	options->dynres_min_scale = OPTIONS_DEFAULT_DYNRES_MIN_SCALE;
+	options->dynres_max_scale = OPTIONS_DEFAULT_DYNRES_MAX_SCALE;
+	options->dynres_portal_min_scale = OPTIONS_DEFAULT_DYNRES_PORTAL_MIN_SCALE;
+	options->dynres_portal_max_scale = OPTIONS_DEFAULT_DYNRES_PORTAL_MAX_SCALE;
+	options->lod_bias = OPTIONS_DEFAULT_LOD_BIAS;
+	options->simulation_rate = OPTIONS_DEFAULT_SIMULATION_RATE;
+	options->frame_limit = OPTIONS_DEFAULT_FRAME_LIMIT;
+	scene_gen_params_init(&options->scene);
+}
+
+static const char *option_value(const char *arg, const char *name)
+{
+	size_t length = strlen(name);
+
+	if (strncmp(arg, name, length) == 0 && arg[length] == '=')
+		return arg + length + 1;
+
+	return NULL;
+}
+
+static int parse_pipeline_mode(const char *value, enum pipeline_mode *mode)
+{
+	if (strcmp(value, "off") == 0)
+		*mode = PIPELINE_MODE_OFF;
+	else if (strcmp(value, "latency") == 0)
+		*mode = PIPELINE_MODE_LATENCY;
+	else if (strcmp(value, "throughput") == 0)
+		*mode = PIPELINE_MODE_THROUGHPUT;
+	else
+		return -1;
+
+	return 0;
+}
+
+static int parse_display_latency(const char *value, enum display_latency_mode *mode)
+{
+	if (strcmp(value, "low") == 0)
+		*mode = DISPLAY_LATENCY_LOW;
+	else if (strcmp(value, "throughput") == 0)
+		*mode = DISPLAY_LATENCY_THROUGHPUT;
+	else
+		return -1;
+
+	return 0;
+}
+
+static int parse_portal_mode(const char *value, enum portal_mode *mode)
+{
+	if (strcmp(value, "stencil") == 0)
+		*mode = PORTAL_MODE_STENCIL;
+	else if (strcmp(value, "texture") == 0)
+		*mode = PORTAL_MODE_TEXTURE;
+	else
+		return -1;
+
+	return 0;
+}
+
+static int parse_color_depth(const char *value, enum color_depth *depth)
+{
+	if (strcmp(value, "32") == 0)
+		*depth = COLOR_DEPTH_32;
+	else if (strcmp(value, "16") == 0)
+		*depth = COLOR_DEPTH_16;
+	else
+		return -1;
+
+	return 0;
+}
+
+/* MIN:MAX with 0 < MIN <= MAX <= 1 */
+static int parse_scale_range(const char *value, float *min, float *max)
+{
+	char *end;
+
+	*min = strtof(value, &end);
+	if (*end != ':')
+		return -1;
+	*max = strtof(end + 1, &end);
+	if (*end || !(*min > 0.0f && *min <= *max && *max <= 1.0f))
+		return -1;
+
+	return 0;
+}
+
+static int parse_bool(const char *value, int *result)
+{
+	if (strcmp(value, "on") == 0 || strcmp(value, "1") == 0)
+		*result = 1;
+	else if (strcmp(value, "off") == 0 || strcmp(value, "0") == 0)
+		*result = 0;
+	else
+		return -1;
+
+	return 0;
+}
+
+int options_parse(struct options *options, int argc, char *argv[])
+{
+	const char *value;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if ((value = option_value(argv[i], "--pipeline"))) {
+			if (parse_pipeline_mode(value, &options->pipeline_mode) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--report-interval"))) {
+			options->report_interval = strtoul(value, NULL, 0);
+		} else if ((value = option_value(argv[i], "--buffers"))) {
+			options->display_buffers = strtoul(value, NULL, 0);
+			if (options->display_buffers < OPTIONS_MIN_DISPLAY_BUFFERS ||
+			    options->display_buffers > OPTIONS_MAX_DISPLAY_BUFFERS)
+				return -1;
+		} else if ((value = option_value(argv[i], "--latency"))) {
+			if (parse_display_latency(value, &options->display_latency) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--vsync"))) {
+			if (parse_bool(value, &options->vsync) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--color"))) {
+			if (parse_color_depth(value, &options->color_depth) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--occlusion"))) {
+			if (parse_bool(value, &options->occlusion) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--portal"))) {
+			if (parse_portal_mode(value, &options->portal_mode) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--dynres"))) {
+			if (parse_bool(value, &options->dynamic_resolution) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--dynres-target"))) {
+			options->dynres_target_ms = strtof(value, NULL);
+			if (!(options->dynres_target_ms > 0.0f))
+				return -1;
+		} else if ((value = option_value(argv[i], "--dynres-scale"))) {
+			if (parse_scale_range(value, &options->dynres_min_scale,
+			    &options->dynres_max_scale) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--dynres-portal-scale"))) {
+			if (parse_scale_range(value, &options->dynres_portal_min_scale,
+			    &options->dynres_portal_max_scale) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--lod-bias"))) {
+			options->lod_bias = strtof(value, NULL);
+			if (!(options->lod_bias > 0.0f))
+				return -1;
+		} else if ((value = option_value(argv[i], "--mesh"))) {
+			if (!*value)
+				return -1;
+			options->mesh_path = value;
+		} else if ((value = option_value(argv[i], "--texture"))) {
+			if (!*value)
+				return -1;
+			options->texture_path = value;
+		} else if ((value = option_value(argv[i], "--scene"))) {
+			if (scene_gen_parse(&options->scene, value) < 0)
+				return -1;
+		} else if ((value = option_value(argv[i], "--assets"))) {
+			if (!*value)
+				return -1;
+			options->assets_path = value;
+		} else if ((value = option_value(argv[i], "--sim-rate"))) {
+			options->simulation_rate = strtoul(value, NULL, 0);
+			if (!options->simulation_rate)
+				return -1;
+		} else if ((value = option_value(argv[i], "--frames"))) {
+			options->frame_limit = strtoul(value, NULL, 0);
+		} else if ((value = option_value(argv[i], "--trace"))) {
+			if (!*value)
+				return -1;
+			options->trace_path = value;
+		} else if ((value = option_value(argv[i], "--profile"))) {
+			if (!*value)
+				return -1;
+			options->profile_path = value;
+		} else if ((value = option_value(argv[i], "--counters"))) {
+			if (!*value)
+				return -1;
+			options->counters_path = value;
+		} else if ((value = option_value(argv[i], "--record-input"))) {
+			if (!*value)
+				return -1;
+			options->record_input_path = value;
+		} else if ((value = option_value(argv[i], "--replay-input"))) {
+			if (!*value)
+				return -1;
+			options->replay_input_path = value;
+		} else if ((value = option_value(argv[i], "--camera-path"))) {
+			if (!*value)
+				return -1;
+			options->camera_path = value;
+		} else if ((value = option_value(argv[i], "--benchmark"))) {
+			if (!*value)
+				return -1;
+			options->benchmark_path = value;
+		} else {
+			return -1;
+		}
+	}
+
+	if (options->record_input_path && options->replay_input_path)
+		return -1;
+
+	/* A benchmark must end on its own and measures the uncapped frame rate */
+	if (options->benchmark_path) {
+		if (!options->frame_limit && !options->camera_path && !options->replay_input_path)
+			return -1;
+		/* Nothing would be left to measure after the warmup */
+		if (options->frame_limit && options->frame_limit <= BENCHMARK_WARMUP_FRAMES) {
+			printf("--benchmark needs more than the %u warmup frames, got --frames=%u\n",
+				BENCHMARK_WARMUP_FRAMES, options->frame_limit);
+			return -1;
+		}
+		options->vsync = 0;
+	}
+
+	return 0;
+}
+
+void options_print_usage(const char *program)
+{
+	printf("usage: %s [options]\n"
+		"  --pipeline=off|latency|throughput\n"
+		"      run the simulation on its own thread, one (latency)\n"
+		"      or two (throughput) frames ahead of rendering\n"
+		"  --report-interval=N\n"
+		"      print the frame timing report every N frames\n"
+		"  --buffers=2|3|4\n"
+		"      number of display color surfaces\n"
+		"  --latency=low|throughput\n"
+		"      queue at most one frame for display (low) or one\n"
+		"      per back buffer (throughput)\n"
+		"  --vsync=on|off\n"
+		"      off flips without waiting for vblank (uncapped)\n"
+		"  --color=32|16\n"
+		"      bits per pixel of the color surfaces and the display,\n"
+		"      16 renders in R5G6B5 for half the framebuffer bandwidth\n"
+		"  --occlusion=on|off\n"
+		"      cull the objects and the portal pass hidden by the\n"
+		"      occluders with a CPU depth buffer\n"
+		"  --portal=stencil|texture\n"
+		"      draw the portal view through a stencil mask, or render it\n"
+		"      offscreen and texture the portal with it, reusing the texture\n"
+		"      while the portal view and the scene stay the same\n"
+		"  --dynres=on|off\n"
+		"      render at a resolution that adapts to the frame time and\n"
+		"      stretch it to the display\n"
+		"  --dynres-target=MS\n"
+		"      frame time the resolution adapts to (default 16.67)\n"
+		"  --dynres-scale=MIN:MAX\n"
+		"      bounds of the render size over the display size (0.5:1)\n"
+		"  --dynres-portal-scale=MIN:MAX\n"
+		"      same for the portal view with --portal=texture (0.25:1), it\n"
+		"      gives up resolution before the main view\n"
+		"  --lod-bias=F\n"
+		"      above 1 draws coarser levels of detail, below 1 finer ones\n"
+		"  --mesh=FILE\n"
+		"      draw the cubes with the mesh in FILE, converted from OBJ or\n"
+		"      glTF by tools/mesh_convert\n"
+		"  --texture=FILE\n"
+		"      modulate the colors of the scene with the mipmapped texture in\n"
+		"      FILE, encoded by tools/texture_encode\n"
+		"  --scene=KEY=VALUE,...\n"
+		"      add a generated stress scene around the demo's: objects=N,\n"
+		"      portals=M (pairs), lights=K, materials=P (1-%u, 8), seed=S,\n"
+		"      layout=uniform|clustered|grid and extent=SIDE of the ground\n"
+		"      square (sized by the objects by default). The same values give\n"
+		"      the same scene; with --frames and --benchmark, runs over a range\n"
+		"      of counts measure how the frame time scales. The portal pairs\n"
+		"      add their frames and are candidates for the single portal\n"
+		"      view: only the nearest one in view is rendered through\n"
+		"  --assets=FILE\n"
+		"      stream the asset archive FILE (see tools/asset_pack) in the\n"
+		"      background while running, its cube.gxmm mesh replaces the\n"
+		"      cubes once loaded\n"
+		"  --sim-rate=HZ\n"
+		"      fixed simulation steps per second\n"
+		"  --frames=N\n"
+		"      exit after N frames (0 runs until START is pressed)\n"
+		"  --trace=FILE\n"
+		"      record the GXM commands to FILE for tools/gxm_replay\n"
+		"  --profile=FILE\n"
+		"      write the CPU profile as Chrome trace-event JSON to FILE\n"
+		"  --counters=FILE\n"
+		"      write the per-pass render counters of every frame to FILE (CSV)\n"
+		"  --record-input=FILE\n"
+		"      save the pad input and frame timing to FILE\n"
+		"  --replay-input=FILE\n"
+		"      simulate from the input saved by --record-input instead of\n"
+		"      the pad, exits at the end of the recording\n"
+		"  --camera-path=FILE\n"
+		"      move the camera and the portal along the spline in FILE\n"
+		"      (see include/camera_path.h), one simulation step per frame,\n"
+		"      exits at the end of the path\n"
+		"  --benchmark=FILE\n"
+		"      write frame time percentiles, CPU time per stage, draw counts\n"
+		"      and peak GPU memory as JSON to FILE, for tools/bench_compare.\n"
+		"      Turns vsync off and needs --frames (over the %u warmup\n"
+		"      frames), --camera-path or --replay-input to end the run\n",
+		program, SCENE_GEN_MAX_MATERIALS, BENCHMARK_WARMUP_FRAMES);
+}
+
+const char *display_latency_mode_name(enum display_latency_mode mode)
+{
+	switch (mode) {
+	case DISPLAY_LATENCY_THROUGHPUT:
+		return "throughput";
+	default:
+		return "low";
+	}
+}
+
+const char *portal_mode_name(enum portal_mode mode)
+{
+	switch (mode) {
+	case PORTAL_MODE_TEXTURE:
+		return "texture";
+	default:
+		return "stencil";
+	}
+}
+
+const char *color_depth_name(enum color_depth depth)
+{
+	switch (depth) {
+	case COLOR_DEPTH_16:
+		return "16-bit R5G6B5";
+	default:
+		return "32-bit A8B8G8R8";
+	}
+}
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "profiler.h"
+#include "time_utils.h"
+
+#define THREAD_EVENTS_MASK (PROFILER_THREAD_EVENTS - 1)
+#define CALIBRATION_NS 10000000
+
+struct profiler_event {
+	uint64_t start;
+	uint64_t end;
+	const char *name;
+};
+
+/*
+ * Single producer, single consumer ring: the owning thread advances head,
+ * profiler_collect() advances tail. The writer never waits for the
+ * reader, events it overwrites before they are collected are dropped.
+ */
+struct profiler_thread {
+	struct profiler_event events[PROFILER_THREAD_EVENTS];
+	unsigned int head;
+	unsigned int id;
+	const char *name;
+	/* Keep the reader's index off the writer's cache line */
+	unsigned int tail __attribute__((aligned(64)));
+};
+
+struct scope_stats {
+	const char *name;
+	unsigned int calls;
+	unsigned int window_count;
+	unsigned int window_pos;
+	uint64_t durations[PROFILER_WINDOW];
+	/* Since profiler_init() or profiler_reset_totals() */
+	unsigned int total_calls;
+	uint64_t total_ticks;
+};
+
+static struct {
+	int initialized;
+	pthread_key_t thread_key;
+	struct profiler_thread *threads[PROFILER_MAX_THREADS];
+	unsigned int thread_count;
+	struct scope_stats scopes[PROFILER_MAX_SCOPES];
+	unsigned int scope_count;
+	uint64_t dropped;
+	uint64_t base_ticks;
+	double ns_per_tick;
+	FILE *trace_file;
+	unsigned int trace_events;
+	struct profiler_event collected[PROFILER_THREAD_EVENTS];
+} profiler;
+
+static void calibrate(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint64_t start_ns = time_get_ns();
+	uint64_t start_ticks = profiler_ticks();
+	uint64_t end_ns, end_ticks;
+
+	do {
+		end_ns = time_get_ns();
+		end_ticks = profiler_ticks();
+	} while (end_ns - start_ns < CALIBRATION_NS);
+
+	profiler.ns_per_tick = (double)(end_ns - start_ns) / (end_ticks - start_ticks);
+#else
+	profiler.ns_per_tick = 1.0;
+#endif
+}
+
+static float ticks_to_ms(uint64_t ticks)
+{
+	return ticks * profiler.ns_per_tick / 1000000.0;
+}
+
+static double ticks_to_trace_us(uint64_t ticks)
+{
+	return (int64_t)(ticks - profiler.base_ticks) * profiler.ns_per_tick / 1000.0;
+}
+
+int profiler_init(const char *trace_path)
+{
+	if (profiler.initialized)
+		return -1;
+
+	if (trace_path) {
+		profiler.trace_file = fopen(trace_path, "w");
+		if (!profiler.trace_file)
+			return -1;
+		fprintf(profiler.trace_file, "{\"traceEvents\":[\n");
+	}
+
+	if (pthread_key_create(&profiler.thread_key, NULL) != 0) {
+		if (profiler.trace_file)
+			fclose(profiler.trace_file);
+		profiler.trace_file = NULL;
+		return -1;
+	}
+
+	calibrate();
+	profiler.base_ticks = profiler_ticks();
+	profiler.trace_events = 0;
+	profiler.dropped = 0;
+	profiler.initialized = 1;
+
+	return 0;
+}
+
+static struct profiler_thread *register_thread(void)
+{
+	struct profiler_thread *thread;
+	unsigned int id = __atomic_load_n(&profiler.thread_count, __ATOMIC_RELAXED);
+
+	do {
+		if (id >= PROFILER_MAX_THREADS)
+			return NULL;
+	} while (!__atomic_compare_exchange_n(&profiler.thread_count, &id, id + 1, 1,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	thread = calloc(1, sizeof(*thread));
+	if (!thread)
+		return NULL;
+
+	thread->id = id;
+	pthread_setspecific(profiler.thread_key, thread);
+	__atomic_store_n(&profiler.threads[id], thread, __ATOMIC_RELEASE);
+
+	return thread;
+}
+
+static struct profiler_thread *get_thread(void)
+{
+	struct profiler_thread *thread = pthread_getspecific(profiler.thread_key);
+
+	return thread ? thread : register_thread();
+}
+
+void profiler_set_thread_name(const char *name)
+{
+	struct profiler_thread *thread;
+
+	if (profiler.initialized && (thread = get_thread()))
+		thread->name = name;
+}
+
+void profiler_record(const char *name, uint64_t start)
+{
+	uint64_t end = profiler_ticks();
+	struct profiler_thread *thread;
+	struct profiler_event *event;
+	unsigned int head;
+
+	if (!profiler.initialized || !(thread = get_thread()))
+		return;
+
+	head = thread->head;
+	event = &thread->events[head & THREAD_EVENTS_MASK];
+	event->start = start;
+	event->end = end;
+	event->name = name;
+	__atomic_store_n(&thread->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void profiler_scope_end(const struct profiler_scope *scope)
+{
+	profiler_record(scope->name, scope->start);
+}
+
+static struct scope_stats *get_scope_stats(const char *name)
+{
+	struct scope_stats *stats;
+	unsigned int i;
+
+	for (i = 0; i < profiler.scope_count; i++) {
+		if (profiler.scopes[i].name == name)
+			return &profiler.scopes[i];
+	}
+
+	if (profiler.scope_count == PROFILER_MAX_SCOPES)
+		return NULL;
+
+	stats = &profiler.scopes[profiler.scope_count++];
+	memset(stats, 0, sizeof(*stats));
+	stats->name = name;
+
+	return stats;
+}
+
+static void add_event(const struct profiler_thread *thread, const struct profiler_event *event)
+{
+	struct scope_stats *stats = get_scope_stats(event->name);
+
+	if (stats) {
+		stats->calls++;
+		stats->total_calls++;
+		stats->total_ticks += event->end - event->start;
+		stats->durations[stats->window_pos] = event->end - event->start;
+		stats->window_pos = (stats->window_pos + 1) % PROFILER_WINDOW;
+		if (stats->window_count < PROFILER_WINDOW)
+			stats->window_count++;
+	}
+
+	if (profiler.trace_file) {
+		fprintf(profiler.trace_file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+			"\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			profiler.trace_events++ ? ",\n" : "", event->name, thread->id,
+			ticks_to_trace_us(event->start),
+			(event->end - event->start) * profiler.ns_per_tick / 1000.0);
+	}
+}
+
+static void collect_thread(struct profiler_thread *thread)
+{
+	unsigned int head = __atomic_load_n(&thread->head, __ATOMIC_ACQUIRE);
+	unsigned int tail = thread->tail;
+	unsigned int count, skip = 0, i;
+
+	if (head - tail > PROFILER_THREAD_EVENTS) {
+		profiler.dropped += head - tail - PROFILER_THREAD_EVENTS;
+		tail = head - PROFILER_THREAD_EVENTS;
+	}
+
+	count = head - tail;
+	for (i = 0; i < count; i++)
+		profiler.collected[i] = thread->events[(tail + i) & THREAD_EVENTS_MASK];
+
+	/* Drop the events the thread overwrote while they were being copied */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	head = __atomic_load_n(&thread->head, __ATOMIC_RELAXED);
+	if (head - tail > PROFILER_THREAD_EVENTS) {
+		skip = head - tail - PROFILER_THREAD_EVENTS;
+		if (skip > count)
+			skip = count;
+		profiler.dropped += skip;
+	}
+
+	for (i = skip; i < count; i++)
+		add_event(thread, &profiler.collected[i]);
+
+	thread->tail = tail + count;
+}
+
+void profiler_collect(void)
+{
+	unsigned int count, i;
+
+	if (!profiler.initialized)
+		return;
+
+	count = __atomic_load_n(&profiler.thread_count, __ATOMIC_RELAXED);
+	for (i = 0; i < count; i++) {
+		struct profiler_thread *thread = __atomic_load_n(&profiler.threads[i],
+			__ATOMIC_ACQUIRE);
+
+		if (thread)
+			collect_thread(thread);
+	}
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+void profiler_print_summary(void)
+{
+	uint64_t durations[PROFILER_WINDOW];
+	unsigned int i, j;
+
+	for (i = 0; i < profiler.scope_count; i++) {
+		struct scope_stats *stats = &profiler.scopes[i];
+		uint64_t total = 0;
+		unsigned int n = stats->window_count;
+
+		if (!n)
+			continue;
+
+		memcpy(durations, stats->durations, n * sizeof(*durations));
+		qsort(durations, n, sizeof(*durations), compare_u64);
+		for (j = 0; j < n; j++)
+			total += durations[j];
+
+		printf("profile %-24s %6u calls, min %.3f avg %.3f p99 %.3f max %.3f ms\n",
+			stats->name, stats->calls, ticks_to_ms(durations[0]),
+			ticks_to_ms(total) / n, ticks_to_ms(durations[(n - 1) * 99 / 100]),
+			ticks_to_ms(durations[n - 1]));
+
+		stats->calls = 0;
+	}
+
+	if (profiler.dropped)
+		printf("profile: %llu events dropped\n", (unsigned long long)profiler.dropped);
+}
+
+unsigned int profiler_get_totals(struct profiler_scope_total *totals, unsigned int max_scopes)
+{
+	unsigned int i;
+
+	for (i = 0; i < profiler.scope_count && i < max_scopes; i++) {
+		totals[i].name = profiler.scopes[i].name;
+		totals[i].calls = profiler.scopes[i].total_calls;
+		totals[i].total_ms = ticks_to_ms(profiler.scopes[i].total_ticks);
+	}
+
+	return i;
+}
+
+void profiler_reset_totals(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < profiler.scope_count; i++) {
+		profiler.scopes[i].total_calls = 0;
+		profiler.scopes[i].total_ticks = 0;
+	}
+}
+
+void profiler_finish(void)
+{
+	unsigned int i;
+
+	if (!profiler.initialized)
+		return;
+
+	profiler_collect();
+	profiler.initialized = 0;
+
+	for (i = 0; i < profiler.thread_count; i++) {
+		struct profiler_thread *thread = profiler.threads[i];
+
+		if (!thread)
+			continue;
+
+		if (profiler.trace_file) {
+			char name[32];
+
+			if (thread->name)
+				snprintf(name, sizeof(name), "%s", thread->name);
+			else
+				snprintf(name, sizeof(name), "thread %u", thread->id);
+
+			fprintf(profiler.trace_file, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+				"\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				profiler.trace_events++ ? ",\n" : "", thread->id, name);
+		}
+
+		free(thread);
+		profiler.threads[i] = NULL;
+	}
+
+	if (profiler.trace_file) {
+		fprintf(profiler.trace_file, "\n]}\n");
+		fclose(profiler.trace_file);
+		profiler.trace_file = NULL;
+	}
+
+	pthread_key_delete(profiler.thread_key);
+	profiler.thread_count = 0;
+	profiler.scope_count = 0;
+}
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#define RENDER_COUNTERS_NO_INTERPOSE
+#include "render_counters.h"
+
+#define MAX_CONTEXTS 8
+
+struct counted_context {
+	SceGxmContext *context;
+	enum render_pass pass;
+	uint32_t values[RENDER_PASS_COUNT][RENDER_COUNTER_COUNT];
+	/* Last reserved default uniform buffers, to route sceGxmSetUniformDataF */
+	void *vertex_uniforms;
+	void *fragment_uniforms;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct counted_context contexts[MAX_CONTEXTS];
+	unsigned int context_count;
+	struct render_counters_frame history[RENDER_COUNTERS_HISTORY];
+	unsigned int frame_count;
+	FILE *csv_file;
+} counters = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static const char *const pass_names[RENDER_PASS_COUNT] = {
+	[RENDER_PASS_OTHER] = "other",
+	[RENDER_PASS_CLEAR] = "clear",
+	[RENDER_PASS_STENCIL_MARK] = "stencil_mark",
+	[RENDER_PASS_PORTAL_VIEW] = "portal_view",
+	[RENDER_PASS_DEPTH_RESET] = "depth_reset",
+	[RENDER_PASS_MAIN_VIEW] = "main_view",
+	[RENDER_PASS_UPSCALE] = "upscale"
+};
+
+static const char *const counter_names[RENDER_COUNTER_COUNT] = {
+	[RENDER_COUNTER_DRAWS] = "draws",
+	[RENDER_COUNTER_PRIMITIVES] = "primitives",
+	[RENDER_COUNTER_VERTEX_PROGRAM_BINDS] = "vertex_programs",
+	[RENDER_COUNTER_FRAGMENT_PROGRAM_BINDS] = "fragment_programs",
+	[RENDER_COUNTER_STENCIL_STATE_CHANGES] = "stencil_state",
+	[RENDER_COUNTER_DEPTH_STATE_CHANGES] = "depth_state",
+	[RENDER_COUNTER_VERTEX_STREAM_BINDS] = "vertex_streams",
+	[RENDER_COUNTER_UNIFORM_RESERVATIONS] = "uniform_buffers",
+	[RENDER_COUNTER_UNIFORM_BYTES] = "uniform_bytes",
+	[RENDER_COUNTER_COMMAND_LISTS] = "command_lists"
+};
+
+const char *render_pass_name(enum render_pass pass)
+{
+	return pass < RENDER_PASS_COUNT ? pass_names[pass] : "unknown";
+}
+
+const char *render_counter_name(enum render_counter counter)
+{
+	return counter < RENDER_COUNTER_COUNT ? counter_names[counter] : "unknown";
+}
+
+int render_counters_init(const char *csv_path)
+{
+	unsigned int pass, counter;
+
+	counters.frame_count = 0;
+
+	if (!csv_path)
+		return 0;
+
+	counters.csv_file = fopen(csv_path, "w");
+	if (!counters.csv_file)
+		return -1;
+
+	fprintf(counters.csv_file, "frame");
+	for (pass = 0; pass < RENDER_PASS_COUNT; pass++) {
+		for (counter = 0; counter < RENDER_COUNTER_COUNT; counter++)
+			fprintf(counters.csv_file, ",%s_%s", pass_names[pass], counter_names[counter]);
+	}
+	fprintf(counters.csv_file, "\n");
+
+	return 0;
+}
+
+void render_counters_finish(void)
+{
+	if (counters.csv_file) {
+		fclose(counters.csv_file);
+		counters.csv_file = NULL;
+	}
+
+	counters.context_count = 0;
+}
+
+static struct counted_context *get_context(SceGxmContext *context)
+{
+	unsigned int count = __atomic_load_n(&counters.context_count, __ATOMIC_ACQUIRE);
+	struct counted_context *counted = NULL;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (counters.contexts[i].context == context)
+			return &counters.contexts[i];
+	}
+
+	pthread_mutex_lock(&counters.lock);
+
+	count = counters.context_count;
+	for (i = 0; i < count; i++) {
+		if (counters.contexts[i].context == context)
+			counted = &counters.contexts[i];
+	}
+
+	if (!counted && count < MAX_CONTEXTS) {
+		counted = &counters.contexts[count];
+		memset(counted, 0, sizeof(*counted));
+		counted->context = context;
+		counted->pass = RENDER_PASS_OTHER;
+		__atomic_store_n(&counters.context_count, count + 1, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&counters.lock);
+
+	return counted;
+}
+
+static void count(SceGxmContext *context, enum render_counter counter, uint32_t value)
+{
+	struct counted_context *counted = get_context(context);
+
+	if (counted)
+		counted->values[counted->pass][counter] += value;
+}
+
+void render_counters_set_pass(SceGxmContext *context, enum render_pass pass)
+{
+	struct counted_context *counted = get_context(context);
+
+	if (counted && pass < RENDER_PASS_COUNT)
+		counted->pass = pass;
+}
+
+void render_counters_end_frame(void)
+{
+	unsigned int count = __atomic_load_n(&counters.context_count, __ATOMIC_ACQUIRE);
+	struct render_counters_frame *frame =
+		&counters.history[counters.frame_count % RENDER_COUNTERS_HISTORY];
+	unsigned int i, pass, counter;
+
+	memset(frame, 0, sizeof(*frame));
+	frame->frame = counters.frame_count++;
+
+	for (i = 0; i < count; i++) {
+		struct counted_context *counted = &counters.contexts[i];
+
+		for (pass = 0; pass < RENDER_PASS_COUNT; pass++) {
+			for (counter = 0; counter < RENDER_COUNTER_COUNT; counter++)
+				frame->values[pass][counter] += counted->values[pass][counter];
+		}
+
+		memset(counted->values, 0, sizeof(counted->values));
+		counted->pass = RENDER_PASS_OTHER;
+	}
+
+	if (counters.csv_file) {
+		fprintf(counters.csv_file, "%u", frame->frame);
+		for (pass = 0; pass < RENDER_PASS_COUNT; pass++) {
+			for (counter = 0; counter < RENDER_COUNTER_COUNT; counter++)
+				fprintf(counters.csv_file, ",%u", frame->values[pass][counter]);
+		}
+		fprintf(counters.csv_file, "\n");
+	}
+}
+
+const struct render_counters_frame *render_counters_get_frame(unsigned int age)
+{
+	if (age >= counters.frame_count || age >= RENDER_COUNTERS_HISTORY)
+		return NULL;
+
+	return &counters.history[(counters.frame_count - 1 - age) % RENDER_COUNTERS_HISTORY];
+}
+
+void render_counters_print(unsigned int frames)
+{
+	static const char *const short_names[RENDER_COUNTER_COUNT] = {
+		"draws", "prims", "vprog", "fprog", "stencil", "depth",
+		"streams", "ubufs", "ubytes", "lists"
+	};
+	uint64_t totals[RENDER_PASS_COUNT][RENDER_COUNTER_COUNT];
+	const struct render_counters_frame *frame;
+	unsigned int i, pass, counter;
+
+	memset(totals, 0, sizeof(totals));
+
+	for (i = 0; i < frames && (frame = render_counters_get_frame(i)); i++) {
+		for (pass = 0; pass < RENDER_PASS_COUNT; pass++) {
+			for (counter = 0; counter < RENDER_COUNTER_COUNT; counter++)
+				totals[pass][counter] += frame->values[pass][counter];
+		}
+	}
+
+	if (!i)
+		return;
+	frames = i;
+
+	printf("counters per frame%-*s", 4, "");
+	for (counter = 0; counter < RENDER_COUNTER_COUNT; counter++)
+		printf(" %8s", short_names[counter]);
+	printf("\n");
+
+	for (pass = 0; pass < RENDER_PASS_COUNT; pass++) {
+		printf("  %-20s", pass_names[pass]);
+		for (counter = 0; counter < RENDER_COUNTER_COUNT; counter++)
+			printf(" %8.1f", (float)totals[pass][counter] / frames);
+		printf("\n");
+	}
+}
+
+void render_counters_set_vertex_program(SceGxmContext *context,
+	const SceGxmVertexProgram *vertexProgram)
+{
+	sceGxmSetVertexProgram(context, vertexProgram);
+	count(context, RENDER_COUNTER_VERTEX_PROGRAM_BINDS, 1);
+}
+
+void render_counters_set_fragment_program(SceGxmContext *context,
+	const SceGxmFragmentProgram *fragmentProgram)
+{
+	sceGxmSetFragmentProgram(context, fragmentProgram);
+	count(context, RENDER_COUNTER_FRAGMENT_PROGRAM_BINDS, 1);
+}
+
+int render_counters_reserve_vertex_default_uniform_buffer(SceGxmContext *context,
+	void **uniformBuffer)
+{
+	int ret = sceGxmReserveVertexDefaultUniformBuffer(context, uniformBuffer);
+	struct counted_context *counted;
+
+	if (ret >= 0 && (counted = get_context(context))) {
+		__atomic_store_n(&counted->vertex_uniforms, *uniformBuffer, __ATOMIC_RELAXED);
+		counted->values[counted->pass][RENDER_COUNTER_UNIFORM_RESERVATIONS]++;
+	}
+
+	return ret;
+}
+
+int render_counters_reserve_fragment_default_uniform_buffer(SceGxmContext *context,
+	void **uniformBuffer)
+{
+	int ret = sceGxmReserveFragmentDefaultUniformBuffer(context, uniformBuffer);
+	struct counted_context *counted;
+
+	if (ret >= 0 && (counted = get_context(context))) {
+		__atomic_store_n(&counted->fragment_uniforms, *uniformBuffer, __ATOMIC_RELAXED);
+		counted->values[counted->pass][RENDER_COUNTER_UNIFORM_RESERVATIONS]++;
+	}
+
+	return ret;
+}
+
+int render_counters_set_uniform_data(void *uniformBuffer, const SceGxmProgramParameter *parameter,
+	unsigned int componentOffset, unsigned int componentCount, const float *sourceData)
+{
+	int ret = sceGxmSetUniformDataF(uniformBuffer, parameter, componentOffset,
+		componentCount, sourceData);
+	unsigned int count, i;
+
+	if (ret < 0)
+		return ret;
+
+	/* The buffer was reserved on the calling thread's context */
+	count = __atomic_load_n(&counters.context_count, __ATOMIC_ACQUIRE);
+	for (i = 0; i < count; i++) {
+		struct counted_context *counted = &counters.contexts[i];
+
+		if (__atomic_load_n(&counted->vertex_uniforms, __ATOMIC_RELAXED) == uniformBuffer ||
+		    __atomic_load_n(&counted->fragment_uniforms, __ATOMIC_RELAXED) == uniformBuffer) {
+			counted->values[counted->pass][RENDER_COUNTER_UNIFORM_BYTES] +=
+				componentCount * sizeof(float);
+			break;
+		}
+	}
+
+	return ret;
+}
+
+void render_counters_set_front_stencil_func(SceGxmContext *context, SceGxmStencilFunc func,
+	SceGxmStencilOp stencilFail, SceGxmStencilOp depthFail, SceGxmStencilOp depthPass,
+	unsigned char compareMask, unsigned char writeMask)
+{
+	sceGxmSetFrontStencilFunc(context, func, stencilFail, depthFail, depthPass,
+		compareMask, writeMask);
+	count(context, RENDER_COUNTER_STENCIL_STATE_CHANGES, 1);
+}
+
+void render_counters_set_front_stencil_ref(SceGxmContext *context, unsigned int sref)
+{
+	sceGxmSetFrontStencilRef(context, sref);
+	count(context, RENDER_COUNTER_STENCIL_STATE_CHANGES, 1);
+}
+
+void render_counters_set_front_depth_func(SceGxmContext *context, SceGxmDepthFunc depthFunc)
+{
+	sceGxmSetFrontDepthFunc(context, depthFunc);
+	count(context, RENDER_COUNTER_DEPTH_STATE_CHANGES, 1);
+}
+
+void render_counters_set_front_depth_write_enable(SceGxmContext *context,
+	SceGxmDepthWriteMode enable)
+{
+	sceGxmSetFrontDepthWriteEnable(context, enable);
+	count(context, RENDER_COUNTER_DEPTH_STATE_CHANGES, 1);
+}
+
+int render_counters_set_vertex_stream(SceGxmContext *context, unsigned int streamIndex,
+	const void *streamData)
+{
+	int ret = sceGxmSetVertexStream(context, streamIndex, streamData);
+
+	if (ret >= 0)
+		count(context, RENDER_COUNTER_VERTEX_STREAM_BINDS, 1);
+
+	return ret;
+}
+
+static uint32_t primitive_count(SceGxmPrimitiveType type, unsigned int index_count)
+{
+	/* The demo only draws triangle lists and strips */
+	if (type == SCE_GXM_PRIMITIVE_TRIANGLE_STRIP)
+		return index_count >= 3 ? index_count - 2 : 0;
+
+	return index_count / 3;
+}
+
+int render_counters_draw(SceGxmContext *context, SceGxmPrimitiveType primType,
+	SceGxmIndexFormat indexType, const void *indexData, unsigned int indexCount)
+{
+	int ret = sceGxmDraw(context, primType, indexType, indexData, indexCount);
+	struct counted_context *counted;
+
+	if (ret >= 0 && (counted = get_context(context))) {
+		counted->values[counted->pass][RENDER_COUNTER_DRAWS]++;
+		counted->values[counted->pass][RENDER_COUNTER_PRIMITIVES] +=
+			primitive_count(primType, indexCount);
+	}
+
+	return ret;
+}
+
+int render_counters_execute_command_list(SceGxmContext *context, SceGxmCommandList *commandList)
+{
+	int ret = sceGxmExecuteCommandList(context, commandList);
+
+	if (ret >= 0)
+		count(context, RENDER_COUNTER_COMMAND_LISTS, 1);
+
+	return ret;
+}
@@ -0,0 +1,394 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scene_gen.h"
+
+/* Tries at a point outside the clear radius before taking the last one */
+#define PLACE_ATTEMPTS 16
+/* Share of the boxes stretched into pillars */
+#define PILLAR_FRACTION 0.2f
+
+enum stream {
+	STREAM_OBJECT,
+	STREAM_CLUSTER,
+	STREAM_PORTAL,
+	STREAM_LIGHT,
+	STREAM_MATERIAL
+};
+
+/* splitmix64, any state, even 0, gives a well mixed sequence */
+static uint64_t rng_next(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+
+	return z ^ (z >> 31);
+}
+
+static uint64_t rng_init(uint32_t seed, enum stream stream, unsigned int index)
+{
+	return (uint64_t)seed << 32 ^ (uint64_t)stream << 24 ^ index;
+}
+
+/* [0, 1) */
+static float rng_float(uint64_t *state)
+{
+	return (rng_next(state) >> 40) * (1.0f / 16777216.0f);
+}
+
+static float rng_range(uint64_t *state, float min, float max)
+{
+	return min + (max - min) * rng_float(state);
+}
+
+/* Standard normal, Box-Muller */
+static float rng_normal(uint64_t *state)
+{
+	float u = 1.0f - rng_float(state);
+	float v = rng_float(state);
+
+	return sqrtf(-2.0f * logf(u)) * cosf(2.0f * M_PI * v);
+}
+
+static void hsv_to_rgb(vector3f *rgb, float hue, float saturation, float value)
+{
+	float h = (hue - floorf(hue)) * 6.0f;
+	float c = value * saturation;
+	float x = c * (1.0f - fabsf(fmodf(h, 2.0f) - 1.0f));
+	float m = value - c;
+	float r, g, b;
+
+	switch ((int)h) {
+	case 0: r = c; g = x; b = 0; break;
+	case 1: r = x; g = c; b = 0; break;
+	case 2: r = 0; g = c; b = x; break;
+	case 3: r = 0; g = x; b = c; break;
+	case 4: r = x; g = 0; b = c; break;
+	default: r = c; g = 0; b = x; break;
+	}
+
+	vector3f_init(rgb, r + m, g + m, b + m);
+}
+
+static int outside_clear(const struct scene_gen_params *params, float x, float z)
+{
+	return x * x + z * z >= params->clear_radius * params->clear_radius;
+}
+
+static void place_uniform(uint64_t *rng, const struct scene_gen_params *params,
+	float extent, vector3f *position)
+{
+	int i;
+
+	for (i = 0; i < PLACE_ATTEMPTS; i++) {
+		position->x = rng_range(rng, -extent / 2.0f, extent / 2.0f);
+		position->z = rng_range(rng, -extent / 2.0f, extent / 2.0f);
+		if (outside_clear(params, position->x, position->z))
+			break;
+	}
+	position->y = 0.0f;
+}
+
+static void place_clustered(uint64_t *rng, const struct scene_gen_params *params,
+	float extent, const vector3f *centers, unsigned int cluster_count, vector3f *position)
+{
+	const vector3f *center = &centers[rng_next(rng) % cluster_count];
+	float sigma = extent / (4.0f * sqrtf(cluster_count));
+	int i;
+
+	for (i = 0; i < PLACE_ATTEMPTS; i++) {
+		position->x = fminf(fmaxf(center->x + sigma * rng_normal(rng), -extent / 2.0f),
+			extent / 2.0f);
+		position->z = fminf(fmaxf(center->z + sigma * rng_normal(rng), -extent / 2.0f),
+			extent / 2.0f);
+		if (outside_clear(params, position->x, position->z))
+			break;
+	}
+	position->y = 0.0f;
+}
+
+static float grid_cell_center(unsigned int cell, unsigned int side, float extent)
+{
+	return (cell + 0.5f) * extent / side - extent / 2.0f;
+}
+
+static unsigned int grid_cells_outside_clear(const struct scene_gen_params *params,
+	unsigned int side, float extent)
+{
+	unsigned int row, column, count = 0;
+
+	for (row = 0; row < side; row++) {
+		for (column = 0; column < side; column++) {
+			count += outside_clear(params, grid_cell_center(column, side, extent),
+				grid_cell_center(row, side, extent));
+		}
+	}
+
+	return count;
+}
+
+/* Smallest grid with a cell outside the clear radius for each object */
+static unsigned int grid_side(const struct scene_gen_params *params, float extent)
+{
+	unsigned int side = ceilf(sqrtf(params->object_count));
+
+	while (grid_cells_outside_clear(params, side, extent) < params->object_count)
+		side++;
+
+	return side;
+}
+
+static void generate_object(struct scene_gen_object *object, uint64_t *rng,
+	unsigned int material_count)
+{
+	float scale;
+
+	object->shape = rng_float(rng) < 0.5f ? SCENE_GEN_BOX : SCENE_GEN_SPHERE;
+	vector3f_init(&object->rotation, 0.0f, 0.0f, 0.0f);
+
+	if (object->shape == SCENE_GEN_BOX) {
+		object->scale.x = rng_range(rng, 0.5f, 2.0f);
+		object->scale.z = rng_range(rng, 0.5f, 2.0f);
+		object->scale.y = rng_float(rng) < PILLAR_FRACTION ?
+			rng_range(rng, 2.0f, 5.0f) : rng_range(rng, 0.5f, 2.0f);
+		object->rotation.y = rng_range(rng, 0.0f, 2.0f * M_PI);
+	} else {
+		scale = rng_range(rng, 0.5f, 2.0f);
+		vector3f_init(&object->scale, scale, scale, scale);
+	}
+
+	object->position.y = object->scale.y / 2.0f;
+	object->material = rng_next(rng) % material_count;
+}
+
+static void generate_material(struct scene_gen_material *material, uint64_t *rng,
+	unsigned int index, unsigned int count)
+{
+	float specular = rng_range(rng, 0.1f, 0.9f);
+
+	/* Hues spread around the wheel, then jittered */
+	hsv_to_rgb(&material->diffuse, (index + rng_range(rng, 0.0f, 0.5f)) / count,
+		rng_range(rng, 0.4f, 1.0f), rng_range(rng, 0.6f, 1.0f));
+	vector3f_init(&material->ambient, material->diffuse.r * 0.15f,
+		material->diffuse.g * 0.15f, material->diffuse.b * 0.15f);
+	vector3f_init(&material->specular, specular, specular, specular);
+	material->shininess = 4.0f * exp2f(rng_range(rng, 0.0f, 5.0f));
+}
+
+void scene_gen_params_init(struct scene_gen_params *params)
+{
+	memset(params, 0, sizeof(*params));
+	params->material_count = 8;
+	params->seed = 1;
+	params->layout = SCENE_GEN_UNIFORM;
+}
+
+static int parse_unsigned(const char *value, const char *end, unsigned int max,
+	unsigned int *result)
+{
+	char *parsed;
+	unsigned long number = strtoul(value, &parsed, 0);
+
+	if (parsed != end || value == end || number > max)
+		return -1;
+
+	*result = number;
+
+	return 0;
+}
+
+static int parse_field(struct scene_gen_params *params, const char *key, size_t key_length,
+	const char *value, const char *end)
+{
+	size_t value_length = end - value;
+	unsigned int seed;
+	char *parsed;
+
+#define KEY_IS(name) (key_length == strlen(name) && strncmp(key, name, key_length) == 0)
+#define VALUE_IS(name) (value_length == strlen(name) && strncmp(value, name, value_length) == 0)
+	if (KEY_IS("objects"))
+		return parse_unsigned(value, end, SCENE_GEN_MAX_OBJECTS, &params->object_count);
+	if (KEY_IS("portals"))
+		return parse_unsigned(value, end, SCENE_GEN_MAX_PORTALS, &params->portal_count);
+	if (KEY_IS("lights"))
+		return parse_unsigned(value, end, SCENE_GEN_MAX_LIGHTS, &params->light_count);
+	if (KEY_IS("materials")) {
+		if (parse_unsigned(value, end, SCENE_GEN_MAX_MATERIALS, &params->material_count) < 0)
+			return -1;
+		return params->material_count ? 0 : -1;
+	}
+	if (KEY_IS("seed")) {
+		if (parse_unsigned(value, end, UINT32_MAX, &seed) < 0)
+			return -1;
+		params->seed = seed;
+		return 0;
+	}
+	if (KEY_IS("layout")) {
+		if (VALUE_IS("uniform"))
+			params->layout = SCENE_GEN_UNIFORM;
+		else if (VALUE_IS("clustered"))
+			params->layout = SCENE_GEN_CLUSTERED;
+		else if (VALUE_IS("grid"))
+			params->layout = SCENE_GEN_GRID;
+		else
+			return -1;
+		return 0;
+	}
+	if (KEY_IS("extent")) {
+		params->extent = strtof(value, &parsed);
+		return parsed == end && params->extent > 0.0f ? 0 : -1;
+	}
+#undef KEY_IS
+#undef VALUE_IS
+
+	return -1;
+}
+
+int scene_gen_parse(struct scene_gen_params *params, const char *description)
+{
+	const char *field = description;
+
+	while (*field) {
+		const char *end = strchr(field, ',');
+		const char *equals;
+
+		if (!end)
+			end = field + strlen(field);
+
+		equals = memchr(field, '=', end - field);
+		if (!equals || parse_field(params, field, equals - field, equals + 1, end) < 0)
+			return -1;
+
+		field = *end ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+const char *scene_gen_layout_name(enum scene_gen_layout layout)
+{
+	switch (layout) {
+	case SCENE_GEN_CLUSTERED:
+		return "clustered";
+	case SCENE_GEN_GRID:
+		return "grid";
+	default:
+		return "uniform";
+	}
+}
+
+int scene_gen_generate(struct scene_gen *scene, const struct scene_gen_params *params)
+{
+	vector3f *cluster_centers = NULL;
+	unsigned int cluster_count = 0, side = 0, cell = 0, i;
+	uint64_t rng;
+
+	memset(scene, 0, sizeof(*scene));
+
+	scene->extent = params->extent;
+	if (!(scene->extent > 0.0f)) {
+		scene->extent = fmaxf(SCENE_GEN_MIN_EXTENT,
+			SCENE_GEN_SPACING * sqrtf(params->object_count) + 2.0f * params->clear_radius);
+	}
+
+	scene->material_count = params->material_count ? params->material_count : 1;
+	if (scene->material_count > SCENE_GEN_MAX_MATERIALS)
+		scene->material_count = SCENE_GEN_MAX_MATERIALS;
+	for (i = 0; i < scene->material_count; i++) {
+		rng = rng_init(params->seed, STREAM_MATERIAL, i);
+		generate_material(&scene->materials[i], &rng, i, scene->material_count);
+	}
+
+	if (params->object_count) {
+		scene->objects = malloc(params->object_count * sizeof(*scene->objects));
+		if (!scene->objects)
+			return -1;
+	}
+
+	if (params->layout == SCENE_GEN_CLUSTERED && params->object_count) {
+		cluster_count = lroundf(sqrtf(params->object_count) / 2.0f);
+		if (!cluster_count)
+			cluster_count = 1;
+
+		cluster_centers = malloc(cluster_count * sizeof(*cluster_centers));
+		if (!cluster_centers) {
+			scene_gen_free(scene);
+			return -1;
+		}
+
+		for (i = 0; i < cluster_count; i++) {
+			rng = rng_init(params->seed, STREAM_CLUSTER, i);
+			place_uniform(&rng, params, scene->extent, &cluster_centers[i]);
+		}
+	} else if (params->layout == SCENE_GEN_GRID && params->object_count) {
+		side = grid_side(params, scene->extent);
+	}
+
+	for (i = 0; i < params->object_count; i++) {
+		struct scene_gen_object *object = &scene->objects[i];
+		vector3f ground;
+
+		rng = rng_init(params->seed, STREAM_OBJECT, i);
+
+		switch (params->layout) {
+		case SCENE_GEN_CLUSTERED:
+			place_clustered(&rng, params, scene->extent, cluster_centers, cluster_count,
+				&ground);
+			break;
+		case SCENE_GEN_GRID:
+			do {
+				ground.x = grid_cell_center(cell % side, side, scene->extent);
+				ground.z = grid_cell_center(cell / side, side, scene->extent);
+				cell++;
+			} while (!outside_clear(params, ground.x, ground.z));
+			ground.x += rng_range(&rng, -0.15f, 0.15f) * scene->extent / side;
+			ground.z += rng_range(&rng, -0.15f, 0.15f) * scene->extent / side;
+			break;
+		default:
+			place_uniform(&rng, params, scene->extent, &ground);
+			break;
+		}
+
+		generate_object(object, &rng, scene->material_count);
+		object->position.x = ground.x;
+		object->position.z = ground.z;
+	}
+	scene->object_count = params->object_count;
+
+	free(cluster_centers);
+
+	scene->portal_count = params->portal_count < SCENE_GEN_MAX_PORTALS ?
+		params->portal_count : SCENE_GEN_MAX_PORTALS;
+	for (i = 0; i < scene->portal_count; i++) {
+		struct scene_gen_portal *portal = &scene->portals[i];
+
+		rng = rng_init(params->seed, STREAM_PORTAL, i);
+		place_uniform(&rng, params, scene->extent, &portal->end1_position);
+		place_uniform(&rng, params, scene->extent, &portal->end2_position);
+		vector3f_init(&portal->end1_rotation, 0.0f, rng_range(&rng, 0.0f, 2.0f * M_PI), 0.0f);
+		vector3f_init(&portal->end2_rotation, 0.0f, rng_range(&rng, 0.0f, 2.0f * M_PI), 0.0f);
+	}
+
+	scene->light_count = params->light_count < SCENE_GEN_MAX_LIGHTS ?
+		params->light_count : SCENE_GEN_MAX_LIGHTS;
+	for (i = 0; i < scene->light_count; i++) {
+		struct scene_gen_light *light = &scene->lights[i];
+
+		rng = rng_init(params->seed, STREAM_LIGHT, i);
+		light->position.x = rng_range(&rng, -scene->extent / 2.0f, scene->extent / 2.0f);
+		light->position.y = rng_range(&rng, 2.0f, 6.0f);
+		light->position.z = rng_range(&rng, -scene->extent / 2.0f, scene->extent / 2.0f);
+		hsv_to_rgb(&light->color, rng_float(&rng), rng_range(&rng, 0.3f, 0.7f), 1.0f);
+	}
+
+	return 0;
+}
+
+void scene_gen_free(struct scene_gen *scene)
+{
+	free(scene->objects);
+	scene->objects = NULL;
+	scene->object_count = 0;
+}
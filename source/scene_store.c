@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <string.h>
+#include "scene_store.h"
+
+#define GROW(array, capacity) \
+	((tmp = realloc((array), (capacity) * sizeof(*(array)))) ? ((array) = tmp, 1) : 0)
+
+static int scene_store_reserve(struct scene_store *store, unsigned int capacity)
+{
+	void *tmp;
+
+	if (capacity <= store->capacity)
+		return 0;
+
+	/* The arrays that were grown keep their contents, so a failure leaves the store usable */
+	if (!GROW(store->positions, capacity) ||
+	    !GROW(store->rotations, capacity) ||
+	    !GROW(store->scales, capacity) ||
+	    !GROW(store->parents, capacity) ||
+	    !GROW(store->flags, capacity) ||
+	    !GROW(store->local_matrices, capacity) ||
+	    !GROW(store->world_matrices, capacity) ||
+	    !GROW(store->bound_centers, capacity) ||
+	    !GROW(store->bound_radii, capacity) ||
+	    !GROW(store->world_centers, capacity) ||
+	    !GROW(store->world_radii, capacity) ||
+	    !GROW(store->meshes, capacity) ||
+	    !GROW(store->materials, capacity))
+		return -1;
+
+	store->capacity = capacity;
+
+	return 0;
+}
+
+int scene_store_init(struct scene_store *store, unsigned int capacity)
+{
+	memset(store, 0, sizeof(*store));
+
+	if (scene_store_reserve(store, capacity ? capacity : 1) < 0) {
+		scene_store_free(store);
+		return -1;
+	}
+
+	return 0;
+}
+
+void scene_store_free(struct scene_store *store)
+{
+	free(store->positions);
+	free(store->rotations);
+	free(store->scales);
+	free(store->parents);
+	free(store->flags);
+	free(store->local_matrices);
+	free(store->world_matrices);
+	free(store->bound_centers);
+	free(store->bound_radii);
+	free(store->world_centers);
+	free(store->world_radii);
+	free(store->meshes);
+	free(store->materials);
+	memset(store, 0, sizeof(*store));
+}
+
+void scene_store_clear(struct scene_store *store)
+{
+	store->count = 0;
+}
+
+uint32_t scene_store_add(struct scene_store *store, uint32_t parent,
+	const vector3f *position, const vector3f *rotation, const vector3f *scale)
+{
+	uint32_t node = store->count;
+
+	if (parent != SCENE_NODE_NONE && parent >= node)
+		return SCENE_NODE_NONE;
+
+	if (node == store->capacity && scene_store_reserve(store, store->capacity * 2) < 0)
+		return SCENE_NODE_NONE;
+
+	store->positions[node] = *position;
+	store->rotations[node] = *rotation;
+	store->scales[node] = *scale;
+	store->parents[node] = parent;
+	store->flags[node] = SCENE_NODE_DIRTY;
+	vector3f_init(&store->bound_centers[node], 0.0f, 0.0f, 0.0f);
+	store->bound_radii[node] = 0.0f;
+	store->meshes[node] = SCENE_HANDLE_NONE;
+	store->materials[node] = SCENE_HANDLE_NONE;
+
+	store->count++;
+
+	return node;
+}
+
+void scene_store_set_renderable(struct scene_store *store, uint32_t node,
+	uint16_t mesh, uint16_t material, const vector3f *bound_center, float bound_radius)
+{
+	store->meshes[node] = mesh;
+	store->materials[node] = material;
+	store->bound_centers[node] = *bound_center;
+	store->bound_radii[node] = bound_radius;
+	store->flags[node] |= SCENE_NODE_DIRTY;
+}
+
+void scene_store_set_position(struct scene_store *store, uint32_t node, const vector3f *position)
+{
+	store->positions[node] = *position;
+	store->flags[node] |= SCENE_NODE_DIRTY;
+}
+
+void scene_store_set_rotation(struct scene_store *store, uint32_t node, const vector3f *rotation)
+{
+	store->rotations[node] = *rotation;
+	store->flags[node] |= SCENE_NODE_DIRTY;
+}
+
+void scene_store_set_scale(struct scene_store *store, uint32_t node, const vector3f *scale)
+{
+	store->scales[node] = *scale;
+	store->flags[node] |= SCENE_NODE_DIRTY;
+}
+
+void scene_store_update_local(struct scene_store *store, unsigned int start, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = start; i < start + count; i++) {
+		const vector3f *scale = &store->scales[i];
+
+		if (!(store->flags[i] & SCENE_NODE_DIRTY))
+			continue;
+
+		matrix4x4_build_model_matrix(store->local_matrices[i],
+			&store->positions[i], &store->rotations[i]);
+		if (scale->x != 1.0f || scale->y != 1.0f || scale->z != 1.0f)
+			matrix4x4_scale(store->local_matrices[i], scale->x, scale->y, scale->z);
+	}
+}
+
+unsigned int scene_store_update_world(struct scene_store *store)
+{
+	unsigned int updated = 0;
+	unsigned int i;
+
+	for (i = 0; i < store->count; i++) {
+		uint32_t parent = store->parents[i];
+		uint8_t flags = store->flags[i];
+
+		if (parent != SCENE_NODE_NONE &&
+		    (store->flags[parent] & SCENE_NODE_WORLD_CHANGED))
+			flags |= SCENE_NODE_DIRTY;
+
+		if (!(flags & SCENE_NODE_DIRTY)) {
+			store->flags[i] = flags & ~SCENE_NODE_WORLD_CHANGED;
+			continue;
+		}
+
+		if (parent != SCENE_NODE_NONE)
+			matrix4x4_multiply(store->world_matrices[i],
+				store->world_matrices[parent], store->local_matrices[i]);
+		else
+			matrix4x4_copy(store->world_matrices[i], store->local_matrices[i]);
+
+		vector3f_matrix4x4_mult(&store->world_centers[i], store->world_matrices[i],
+			&store->bound_centers[i], 1.0f);
+		store->world_radii[i] = store->bound_radii[i] *
+			matrix4x4_max_axis_scale(store->world_matrices[i]);
+
+		store->flags[i] = SCENE_NODE_WORLD_CHANGED;
+		updated++;
+	}
+
+	return updated;
+}
@@ -0,0 +1,44 @@
+#include <string.h>
+#include "spsc_queue.h"
+
+#define SPSC_QUEUE_MASK (SPSC_QUEUE_CAPACITY - 1)
+
+void spsc_queue_init(struct spsc_queue *queue)
+{
+	memset(queue, 0, sizeof(*queue));
+}
+
+int spsc_queue_push(struct spsc_queue *queue, void *item)
+{
+	unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+	unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+	if (tail - head >= SPSC_QUEUE_CAPACITY)
+		return 0;
+
+	queue->items[tail & SPSC_QUEUE_MASK] = item;
+	__atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+void *spsc_queue_pop(struct spsc_queue *queue)
+{
+	unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+	unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+	void *item;
+
+	if (head == tail)
+		return NULL;
+
+	item = queue->items[head & SPSC_QUEUE_MASK];
+	__atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+	return item;
+}
+
+unsigned int spsc_queue_size(const struct spsc_queue *queue)
+{
+	return __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) -
+		__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,455 @@
+#include <math.h>
+#include <string.h>
+#include "texture_compress.h"
+
+#define POWER_ITERATIONS 8
+
+/* Offset of a texel, or a block, at x, y, see include/texture_file.h */
+static unsigned int morton_index(unsigned int x, unsigned int y,
+	unsigned int width, unsigned int height)
+{
+	unsigned int shorter = width < height ? width : height;
+	unsigned int index = 0, shift = 0;
+
+	for (; (1u << shift) < shorter; shift++) {
+		index |= (y & (1u << shift)) << shift;
+		index |= (x & (1u << shift)) << (shift + 1);
+	}
+
+	return index | ((width > height ? x : y) >> shift) << (2 * shift);
+}
+
+void texture_compress_downsample(const uint8_t *src, unsigned int width, unsigned int height,
+	uint8_t *dst)
+{
+	unsigned int dst_width = width > 1 ? width / 2 : 1;
+	unsigned int dst_height = height > 1 ? height / 2 : 1;
+	unsigned int step_x = width > 1 ? 4 : 0;
+	unsigned int step_y = height > 1 ? width * 4 : 0;
+	unsigned int x, y, i;
+
+	for (y = 0; y < dst_height; y++) {
+		for (x = 0; x < dst_width; x++) {
+			const uint8_t *p = src + ((y * 2 % height) * width + x * 2 % width) * 4;
+
+			for (i = 0; i < 4; i++)
+				dst[(y * dst_width + x) * 4 + i] = (p[i] + p[step_x + i] +
+					p[step_y + i] + p[step_x + step_y + i] + 2) / 4;
+		}
+	}
+}
+
+/* Nearest 565 color */
+static uint16_t quantize_565(const float color[3])
+{
+	int r = (int)lroundf(color[0] * 31.0f / 255.0f);
+	int g = (int)lroundf(color[1] * 63.0f / 255.0f);
+	int b = (int)lroundf(color[2] * 31.0f / 255.0f);
+
+	r = r < 0 ? 0 : (r > 31 ? 31 : r);
+	g = g < 0 ? 0 : (g > 63 ? 63 : g);
+	b = b < 0 ? 0 : (b > 31 ? 31 : b);
+
+	return r << 11 | g << 5 | b;
+}
+
+static void expand_565(uint16_t color, int out[3])
+{
+	int r = (color >> 11) & 0x1F, g = (color >> 5) & 0x3F, b = color & 0x1F;
+
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+/* The colors of a color block the way the sampler decodes them */
+static void color_palette(uint16_t c0, uint16_t c1, int four_colors, int palette[4][4])
+{
+	int i;
+
+	expand_565(c0, palette[0]);
+	expand_565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = 255;
+
+	for (i = 0; i < 3; i++) {
+		if (four_colors) {
+			palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+			palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+		} else {
+			palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+			palette[3][i] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = four_colors ? 255 : 0;
+}
+
+static int color_distance(const uint8_t *texel, const int *color)
+{
+	int dr = texel[0] - color[0], dg = texel[1] - color[1], db = texel[2] - color[2];
+
+	return dr * dr + dg * dg + db * db;
+}
+
+/* Indices of the nearest colors, returns the squared error */
+static int color_indices(const uint8_t texels[16][4], int transparent, uint16_t c0,
+	uint16_t c1, uint32_t *indices)
+{
+	int palette[4][4];
+	int i, j, error = 0;
+	int four_colors = c0 > c1;
+
+	color_palette(c0, c1, four_colors, palette);
+	*indices = 0;
+
+	for (i = 0; i < 16; i++) {
+		int best = 0, best_distance;
+
+		if (transparent && texels[i][3] < 128) {
+			*indices |= 3u << (2 * i);
+			continue;
+		}
+
+		best_distance = color_distance(texels[i], palette[0]);
+		for (j = 1; j < (four_colors ? 4 : 3); j++) {
+			int distance = color_distance(texels[i], palette[j]);
+
+			if (distance < best_distance) {
+				best = j;
+				best_distance = distance;
+			}
+		}
+		*indices |= (uint32_t)best << (2 * i);
+		error += best_distance;
+	}
+
+	return error;
+}
+
+/* Endpoints at the ends of the principal axis of the opaque texels */
+static int fit_endpoints(const uint8_t texels[16][4], int transparent, float e0[3],
+	float e1[3])
+{
+	float mean[3] = {0.0f, 0.0f, 0.0f}, covariance[6] = {0.0f};
+	float axis[3] = {1.0f, 1.0f, 1.0f};
+	float t_min = INFINITY, t_max = -INFINITY;
+	int i, j, count = 0;
+
+	for (i = 0; i < 16; i++) {
+		if (transparent && texels[i][3] < 128)
+			continue;
+		for (j = 0; j < 3; j++)
+			mean[j] += texels[i][j];
+		count++;
+	}
+	if (!count)
+		return 0;
+	for (j = 0; j < 3; j++)
+		mean[j] /= count;
+
+	for (i = 0; i < 16; i++) {
+		float d[3];
+
+		if (transparent && texels[i][3] < 128)
+			continue;
+		for (j = 0; j < 3; j++)
+			d[j] = texels[i][j] - mean[j];
+		covariance[0] += d[0] * d[0];
+		covariance[1] += d[0] * d[1];
+		covariance[2] += d[0] * d[2];
+		covariance[3] += d[1] * d[1];
+		covariance[4] += d[1] * d[2];
+		covariance[5] += d[2] * d[2];
+	}
+
+	for (i = 0; i < POWER_ITERATIONS; i++) {
+		float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+		float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+		float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+		float length = sqrtf(x * x + y * y + z * z);
+
+		/* All the texels are the same color */
+		if (length == 0.0f)
+			break;
+		axis[0] = x / length;
+		axis[1] = y / length;
+		axis[2] = z / length;
+	}
+
+	for (i = 0; i < 16; i++) {
+		float t;
+
+		if (transparent && texels[i][3] < 128)
+			continue;
+		t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] +
+			(texels[i][2] - mean[2]) * axis[2];
+		t_min = t < t_min ? t : t_min;
+		t_max = t > t_max ? t : t_max;
+	}
+
+	for (j = 0; j < 3; j++) {
+		e0[j] = mean[j] + axis[j] * t_max;
+		e1[j] = mean[j] + axis[j] * t_min;
+	}
+
+	return 1;
+}
+
+/*
+ * Endpoints minimizing the squared error of the texels with the four
+ * color indices given, returns 0 if they are degenerate
+ */
+static int refine_endpoints(const uint8_t texels[16][4], uint32_t indices, float e0[3],
+	float e1[3])
+{
+	static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+	float a = 0.0f, b = 0.0f, c = 0.0f, x[3] = {0.0f}, y[3] = {0.0f}, det;
+	int i, j;
+
+	for (i = 0; i < 16; i++) {
+		float w = weights[(indices >> (2 * i)) & 3];
+
+		a += w * w;
+		b += w * (1.0f - w);
+		c += (1.0f - w) * (1.0f - w);
+		for (j = 0; j < 3; j++) {
+			x[j] += w * texels[i][j];
+			y[j] += (1.0f - w) * texels[i][j];
+		}
+	}
+
+	det = a * c - b * b;
+	if (fabsf(det) < 1e-6f)
+		return 0;
+
+	for (j = 0; j < 3; j++) {
+		e0[j] = (c * x[j] - b * y[j]) / det;
+		e1[j] = (a * y[j] - b * x[j]) / det;
+	}
+
+	return 1;
+}
+
+static void write_color_block(uint16_t c0, uint16_t c1, uint32_t indices, uint8_t *out)
+{
+	int i;
+
+	out[0] = c0 & 0xFF;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF;
+	out[3] = c1 >> 8;
+	for (i = 0; i < 4; i++)
+		out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+/*
+ * Four color block with c0 > c1, or if transparent texels are allowed and
+ * there are some the three color one with c0 <= c1. With c0 == c1 both
+ * read index 0 as c0.
+ */
+static void encode_color_block(const uint8_t texels[16][4], int allow_transparent,
+	uint8_t *out)
+{
+	float e0[3], e1[3];
+	uint16_t c0, c1, r0, r1;
+	uint32_t indices, refined;
+	int i, error, transparent = 0;
+
+	for (i = 0; allow_transparent && i < 16; i++)
+		transparent |= texels[i][3] < 128;
+
+	if (!fit_endpoints(texels, transparent, e0, e1)) {
+		/* Nothing but transparent texels */
+		write_color_block(0, 0, 0xFFFFFFFFu, out);
+		return;
+	}
+
+	c0 = quantize_565(e0);
+	c1 = quantize_565(e1);
+	if ((c0 < c1) != transparent) {
+		uint16_t swap = c0;
+		c0 = c1;
+		c1 = swap;
+	}
+	error = color_indices(texels, transparent, c0, c1, &indices);
+
+	if (!transparent && c0 != c1 && refine_endpoints(texels, indices, e0, e1)) {
+		r0 = quantize_565(e0);
+		r1 = quantize_565(e1);
+		if (r0 < r1) {
+			uint16_t swap = r0;
+			r0 = r1;
+			r1 = swap;
+		}
+		if (r0 != r1 && color_indices(texels, 0, r0, r1, &refined) < error) {
+			c0 = r0;
+			c1 = r1;
+			indices = refined;
+		}
+	}
+
+	/* Equal endpoints read the three color palette, whose index 0 is c0 */
+	if (c0 == c1 && !transparent)
+		indices = 0;
+
+	write_color_block(c0, c1, indices, out);
+}
+
+/* Eight alpha levels between the largest and the smallest, in 3-bit indices */
+static void encode_alpha_block(const uint8_t texels[16][4], uint8_t *out)
+{
+	unsigned int a0 = 0, a1 = 255, palette[8];
+	uint64_t indices = 0;
+	int i, j;
+
+	for (i = 0; i < 16; i++) {
+		a0 = texels[i][3] > a0 ? texels[i][3] : a0;
+		a1 = texels[i][3] < a1 ? texels[i][3] : a1;
+	}
+
+	palette[0] = a0;
+	palette[1] = a1;
+	for (j = 2; j < 8; j++)
+		palette[j] = ((8 - j) * a0 + (j - 1) * a1) / 7;
+
+	for (i = 0; a0 > a1 && i < 16; i++) {
+		unsigned int best = 0, best_distance = 256;
+
+		for (j = 0; j < 8; j++) {
+			unsigned int distance = texels[i][3] > palette[j] ?
+				texels[i][3] - palette[j] : palette[j] - texels[i][3];
+
+			if (distance < best_distance) {
+				best = j;
+				best_distance = distance;
+			}
+		}
+		indices |= (uint64_t)best << (3 * i);
+	}
+
+	out[0] = a0;
+	out[1] = a1;
+	for (i = 0; i < 6; i++)
+		out[2 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+/* The 4x4 block at bx, by, repeating the edge texels of a smaller level */
+static void load_block(const uint8_t *src, unsigned int width, unsigned int height,
+	unsigned int bx, unsigned int by, uint8_t texels[16][4])
+{
+	unsigned int x, y;
+
+	for (y = 0; y < 4; y++) {
+		for (x = 0; x < 4; x++) {
+			unsigned int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+			unsigned int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+
+			memcpy(texels[y * 4 + x], src + (sy * width + sx) * 4, 4);
+		}
+	}
+}
+
+void texture_compress_level(enum texture_file_format format, const uint8_t *src,
+	unsigned int width, unsigned int height, void *dst)
+{
+	unsigned int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	uint8_t texels[16][4];
+	unsigned int x, y;
+
+	if (format == TEXTURE_FILE_FORMAT_RGBA8) {
+		for (y = 0; y < height; y++)
+			for (x = 0; x < width; x++)
+				memcpy((uint8_t *)dst + morton_index(x, y, width, height) * 4,
+					src + (y * width + x) * 4, 4);
+		return;
+	}
+
+	for (y = 0; y < blocks_y; y++) {
+		for (x = 0; x < blocks_x; x++) {
+			uint8_t *block = dst;
+
+			load_block(src, width, height, x, y, texels);
+			if (format == TEXTURE_FILE_FORMAT_UBC1) {
+				block += morton_index(x, y, blocks_x, blocks_y) * 8;
+				encode_color_block(texels, 1, block);
+			} else {
+				block += morton_index(x, y, blocks_x, blocks_y) * 16;
+				encode_alpha_block(texels, block);
+				encode_color_block(texels, 0, block + 8);
+			}
+		}
+	}
+}
+
+static void decode_color_block(const uint8_t *block, int four_colors, uint8_t texels[16][4])
+{
+	uint16_t c0 = block[0] | block[1] << 8, c1 = block[2] | block[3] << 8;
+	uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+	int palette[4][4];
+	int i, j;
+
+	color_palette(c0, c1, four_colors || c0 > c1, palette);
+	for (i = 0; i < 16; i++)
+		for (j = 0; j < 4; j++)
+			texels[i][j] = palette[(indices >> (2 * i)) & 3][j];
+}
+
+static void decode_alpha_block(const uint8_t *block, uint8_t texels[16][4])
+{
+	unsigned int a0 = block[0], a1 = block[1], palette[8];
+	uint64_t indices = 0;
+	int i;
+
+	for (i = 0; i < 6; i++)
+		indices |= (uint64_t)block[2 + i] << (8 * i);
+
+	palette[0] = a0;
+	palette[1] = a1;
+	for (i = 2; i < 8; i++) {
+		if (a0 > a1)
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+		else
+			palette[i] = i < 6 ? ((6 - i) * a0 + (i - 1) * a1) / 5 : (i == 6 ? 0 : 255);
+	}
+
+	for (i = 0; i < 16; i++)
+		texels[i][3] = palette[(indices >> (3 * i)) & 7];
+}
+
+void texture_decompress_level(enum texture_file_format format, const void *src,
+	unsigned int width, unsigned int height, uint8_t *dst)
+{
+	unsigned int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	uint8_t texels[16][4];
+	unsigned int x, y, i;
+
+	if (format == TEXTURE_FILE_FORMAT_RGBA8) {
+		for (y = 0; y < height; y++)
+			for (x = 0; x < width; x++)
+				memcpy(dst + (y * width + x) * 4,
+					(const uint8_t *)src + morton_index(x, y, width, height) * 4, 4);
+		return;
+	}
+
+	for (y = 0; y < blocks_y; y++) {
+		for (x = 0; x < blocks_x; x++) {
+			const uint8_t *block = src;
+
+			if (format == TEXTURE_FILE_FORMAT_UBC1) {
+				block += morton_index(x, y, blocks_x, blocks_y) * 8;
+				decode_color_block(block, 0, texels);
+			} else {
+				block += morton_index(x, y, blocks_x, blocks_y) * 16;
+				decode_color_block(block + 8, 1, texels);
+				decode_alpha_block(block, texels);
+			}
+
+			for (i = 0; i < 16; i++) {
+				unsigned int tx = x * 4 + i % 4, ty = y * 4 + i / 4;
+
+				if (tx < width && ty < height)
+					memcpy(dst + (ty * width + tx) * 4, texels[i], 4);
+			}
+		}
+	}
+}
@@ -0,0 +1,139 @@
+#include <string.h>
+#include "texture_file.h"
+
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+static const char *const format_names[TEXTURE_FILE_FORMAT_COUNT] = {
+	[TEXTURE_FILE_FORMAT_RGBA8] = "rgba8",
+	[TEXTURE_FILE_FORMAT_UBC1] = "ubc1",
+	[TEXTURE_FILE_FORMAT_UBC3] = "ubc3"
+};
+
+const char *texture_file_format_name(enum texture_file_format format)
+{
+	return format < TEXTURE_FILE_FORMAT_COUNT ? format_names[format] : "unknown";
+}
+
+size_t texture_file_level_size(enum texture_file_format format, unsigned int width,
+	unsigned int height)
+{
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+
+	switch (format) {
+	case TEXTURE_FILE_FORMAT_RGBA8:
+		return (size_t)width * height * 4;
+	case TEXTURE_FILE_FORMAT_UBC1:
+		return blocks * 8;
+	case TEXTURE_FILE_FORMAT_UBC3:
+		return blocks * 16;
+	default:
+		return 0;
+	}
+}
+
+size_t texture_file_data_size(enum texture_file_format format, unsigned int width,
+	unsigned int height, unsigned int level_count)
+{
+	size_t size = 0;
+	unsigned int i;
+
+	for (i = 0; i < level_count; i++) {
+		size += texture_file_level_size(format, width, height);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	return size;
+}
+
+static int is_power_of_two(uint32_t x)
+{
+	return x && !(x & (x - 1));
+}
+
+const struct texture_file_header *texture_file_parse(const void *data, size_t size)
+{
+	const struct texture_file_header *header = data;
+	unsigned int max_levels = 1;
+
+	if (size < sizeof(*header) ||
+	    memcmp(header->magic, TEXTURE_FILE_MAGIC, sizeof(header->magic)) ||
+	    header->version != TEXTURE_FILE_VERSION || header->size != size)
+		return NULL;
+
+	if (header->format >= TEXTURE_FILE_FORMAT_COUNT ||
+	    !is_power_of_two(header->width) || header->width > TEXTURE_FILE_MAX_SIZE ||
+	    !is_power_of_two(header->height) || header->height > TEXTURE_FILE_MAX_SIZE)
+		return NULL;
+
+	while ((header->width | header->height) >> max_levels)
+		max_levels++;
+	if (!header->level_count || header->level_count > max_levels)
+		return NULL;
+
+	if (header->data_offset % TEXTURE_FILE_ALIGN || header->data_offset > size ||
+	    texture_file_data_size(header->format, header->width, header->height,
+	    header->level_count) > size - header->data_offset)
+		return NULL;
+
+	return header;
+}
+
+FILE *texture_file_open(const char *path, size_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	long end;
+
+	if (!file)
+		return NULL;
+
+	if (fseek(file, 0, SEEK_END) != 0 || (end = ftell(file)) < 0 ||
+	    fseek(file, 0, SEEK_SET) != 0) {
+		fclose(file);
+		return NULL;
+	}
+
+	*size = end;
+
+	return file;
+}
+
+const struct texture_file_header *texture_file_read(FILE *file, void *data, size_t size)
+{
+	size_t read = fread(data, 1, size, file);
+
+	fclose(file);
+	if (read != size)
+		return NULL;
+
+	return texture_file_parse(data, size);
+}
+
+int texture_file_write(const char *path, struct texture_file_header *header,
+	const void *data)
+{
+	static const char zeros[TEXTURE_FILE_ALIGN];
+	size_t data_size;
+	FILE *file;
+
+	memcpy(header->magic, TEXTURE_FILE_MAGIC, sizeof(header->magic));
+	header->version = TEXTURE_FILE_VERSION;
+	header->data_offset = ALIGN_UP(sizeof(*header), TEXTURE_FILE_ALIGN);
+	data_size = texture_file_data_size(header->format, header->width, header->height,
+		header->level_count);
+	header->size = header->data_offset + data_size;
+
+	file = fopen(path, "wb");
+	if (!file)
+		return -1;
+
+	if (fwrite(header, sizeof(*header), 1, file) != 1 ||
+	    fwrite(zeros, 1, header->data_offset - sizeof(*header), file) !=
+	    header->data_offset - sizeof(*header) ||
+	    fwrite(data, 1, data_size, file) != data_size) {
+		fclose(file);
+		return -1;
+	}
+
+	return fclose(file) == 0 ? 0 : -1;
+}
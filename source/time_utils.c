@@ -0,0 +1,19 @@
+#ifdef __vita__
+#include <psp2/kernel/processmgr.h>
+#else
+#include <time.h>
+#endif
+#include "time_utils.h"
+
+uint64_t time_get_ns(void)
+{
+#ifdef __vita__
+	return sceKernelGetProcessTimeWide() * 1000;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
@@ -0,0 +1,313 @@
+/*
+ * Asset streaming benchmark.
+ *
+ * Writes a set of mesh-like assets (vertex and index data of spheres of
+ * several sizes) as separate files and as an archive, stored raw and
+ * with LZ4, then loads them:
+ *
+ *   files    one open and read per file, on the calling thread
+ *   archive  asset_archive_load() of each entry, on the calling thread
+ *   stream   asset_loader requests polled from a frame loop that spends
+ *            frame_ms of work per frame, as the demo does
+ *
+ * and reports the time the calling thread was blocked, the throughput
+ * and, for the streamed loads, the frames drawn meanwhile and the longest
+ * time a frame spent in the loader calls. The files come from the page
+ * cache here, so the numbers are CPU and system call costs; on the Vita
+ * the memory card reads dominate and LZ4 trades them for decompression.
+ *
+ * Usage: asset_load_bench [assets] [frame_ms] [directory]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "asset_archive.h"
+#include "asset_loader.h"
+#include "math_utils.h"
+#include "time_utils.h"
+
+#define MAX_ASSETS 64
+
+struct asset {
+	char name[ASSET_ARCHIVE_NAME_SIZE];
+	char path[256];
+	void *data;
+	uint32_t size;
+	void *loaded;
+};
+
+/* Positions, normals and colors of a sphere, then its triangle indices */
+static void *make_sphere(unsigned int rings, uint32_t *size)
+{
+	unsigned int segments = rings * 2;
+	unsigned int vertex_count = (rings + 1) * (segments + 1);
+	unsigned int index_count = rings * segments * 6;
+	float *vertices;
+	uint16_t *indices;
+	unsigned int r, s, count = 0;
+
+	*size = vertex_count * 10 * sizeof(float) + index_count * sizeof(uint16_t);
+	vertices = malloc(*size);
+	indices = (uint16_t *)(vertices + vertex_count * 10);
+
+	for (r = 0; r <= rings; r++) {
+		float theta = M_PI * r / rings;
+
+		for (s = 0; s <= segments; s++) {
+			float phi = 2.0f * M_PI * s / segments;
+			float *v = &vertices[(r * (segments + 1) + s) * 10];
+
+			v[3] = sinf(theta) * cosf(phi);
+			v[4] = cosf(theta);
+			v[5] = sinf(theta) * sinf(phi);
+			v[0] = v[3] * 2.0f;
+			v[1] = v[4] * 2.0f;
+			v[2] = v[5] * 2.0f;
+			v[6] = 0.8f;
+			v[7] = 0.8f;
+			v[8] = 0.8f;
+			v[9] = 1.0f;
+		}
+	}
+
+	for (r = 0; r < rings; r++) {
+		for (s = 0; s < segments; s++) {
+			uint16_t a = r * (segments + 1) + s;
+			uint16_t b = a + segments + 1;
+
+			indices[count++] = a;
+			indices[count++] = b;
+			indices[count++] = a + 1;
+			indices[count++] = a + 1;
+			indices[count++] = b;
+			indices[count++] = b + 1;
+		}
+	}
+
+	return vertices;
+}
+
+static int write_file(const char *path, const void *data, uint32_t size)
+{
+	FILE *file = fopen(path, "wb");
+	int ok;
+
+	if (!file)
+		return -1;
+
+	ok = fwrite(data, 1, size, file) == size;
+
+	return fclose(file) == 0 && ok ? 0 : -1;
+}
+
+static int check(const struct asset *assets, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (memcmp(assets[i].data, assets[i].loaded, assets[i].size))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void clear(struct asset *assets, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		memset(assets[i].loaded, 0, assets[i].size);
+}
+
+static float megabytes(uint64_t bytes)
+{
+	return bytes / (1024.0f * 1024.0f);
+}
+
+static void print_result(const char *name, uint64_t blocked_ns, uint64_t total_ns,
+	uint64_t bytes, int ok)
+{
+	printf("%-14s blocked %9.3f ms, total %9.3f ms, %8.1f MB/s: %s\n", name,
+		time_ns_to_ms(blocked_ns), time_ns_to_ms(total_ns),
+		megabytes(bytes) / (total_ns / 1e9f), ok ? "ok" : "FAILED");
+}
+
+static int load_files(struct asset *assets, unsigned int count, uint64_t bytes)
+{
+	uint64_t start = time_get_ns(), ns;
+	unsigned int i;
+	int ok = 1;
+
+	for (i = 0; i < count; i++) {
+		FILE *file = fopen(assets[i].path, "rb");
+
+		ok &= file && fread(assets[i].loaded, 1, assets[i].size, file) == assets[i].size;
+		if (file)
+			fclose(file);
+	}
+
+	ns = time_get_ns() - start;
+	ok &= check(assets, count);
+	print_result("files", ns, ns, bytes, ok);
+
+	return ok;
+}
+
+static int load_archive(const char *name, const char *path, struct asset *assets,
+	unsigned int count, uint64_t bytes)
+{
+	struct asset_archive archive;
+	uint64_t start = time_get_ns(), ns;
+	unsigned int i;
+	void *scratch;
+	int ok;
+
+	if (asset_archive_open(&archive, path) < 0)
+		return 0;
+
+	scratch = malloc(archive.max_compressed_size + 1);
+	ok = scratch != NULL;
+	for (i = 0; ok && i < count; i++) {
+		const struct asset_archive_entry *entry = asset_archive_find(&archive, assets[i].name);
+
+		ok = entry && asset_archive_load(&archive, entry, assets[i].loaded, scratch) == 0;
+	}
+
+	ns = time_get_ns() - start;
+	ok &= check(assets, count);
+	print_result(name, ns, ns, bytes, ok);
+
+	free(scratch);
+	asset_archive_close(&archive);
+
+	return ok;
+}
+
+/* Busy frames of frame_ms, polling the loader between them */
+static int stream_archive(const char *name, const char *path, struct asset *assets,
+	unsigned int count, uint64_t bytes, float frame_ms)
+{
+	struct asset_archive archive;
+	struct asset_loader loader;
+	struct asset_loader_stats stats;
+	struct asset_request *request;
+	uint64_t start, blocked_ns = 0, max_call_ns = 0, call_start;
+	unsigned int i, frames = 0, done = 0;
+	int ok = 1;
+
+	call_start = start = time_get_ns();
+	if (asset_archive_open(&archive, path) < 0 || asset_loader_init(&loader, &archive) < 0)
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		const struct asset_archive_entry *entry = asset_archive_find(&archive, assets[i].name);
+
+		ok &= entry && asset_loader_request(&loader, entry, assets[i].loaded, NULL) != NULL;
+	}
+	blocked_ns = max_call_ns = time_get_ns() - call_start;
+
+	while (ok && done < count) {
+		uint64_t frame_end = time_get_ns() + (uint64_t)(frame_ms * 1e6f), ns;
+
+		while (time_get_ns() < frame_end)
+			;
+		frames++;
+
+		call_start = time_get_ns();
+		while ((request = asset_loader_poll(&loader))) {
+			ok &= request->status == ASSET_REQUEST_DONE;
+			done++;
+		}
+		ns = time_get_ns() - call_start;
+		blocked_ns += ns;
+		if (ns > max_call_ns)
+			max_call_ns = ns;
+	}
+
+	asset_loader_get_stats(&loader, &stats);
+	asset_loader_finish(&loader);
+	asset_archive_close(&archive);
+
+	ok &= check(assets, count);
+	print_result(name, blocked_ns, time_get_ns() - start, bytes, ok);
+	printf("               %u frames, longest loader call %.3f ms\n", frames,
+		time_ns_to_ms(max_call_ns));
+	asset_loader_print_stats(&stats);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int count = argc > 1 ? strtoul(argv[1], NULL, 0) : 32;
+	float frame_ms = argc > 2 ? strtof(argv[2], NULL) : 2.0f;
+	const char *directory = argc > 3 ? argv[3] : ".";
+	struct asset_archive_source sources[MAX_ASSETS];
+	struct asset assets[MAX_ASSETS];
+	char raw_path[256], lz4_path[256];
+	uint64_t bytes = 0;
+	unsigned int i;
+	int ok = 1;
+
+	if (!count || count > MAX_ASSETS || !(frame_ms >= 0.0f)) {
+		fprintf(stderr, "assets must be 1 to %u\n", MAX_ASSETS);
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		/* 8 to 180 rings, 6 KB to 4 MB */
+		unsigned int rings = 8 + (i * 37) % 173;
+
+		snprintf(assets[i].name, sizeof(assets[i].name), "sphere_%02u.bin", i);
+		snprintf(assets[i].path, sizeof(assets[i].path), "%s/asset_load_bench_%02u.bin",
+			directory, i);
+		assets[i].data = make_sphere(rings, &assets[i].size);
+		assets[i].loaded = malloc(assets[i].size);
+		if (write_file(assets[i].path, assets[i].data, assets[i].size) < 0) {
+			fprintf(stderr, "Could not write %s\n", assets[i].path);
+			return 1;
+		}
+
+		sources[i].name = assets[i].name;
+		sources[i].data = assets[i].data;
+		sources[i].size = assets[i].size;
+		sources[i].alignment = 0;
+		bytes += assets[i].size;
+	}
+
+	snprintf(raw_path, sizeof(raw_path), "%s/asset_load_bench.gxma", directory);
+	snprintf(lz4_path, sizeof(lz4_path), "%s/asset_load_bench_lz4.gxma", directory);
+	for (i = 0; i < count; i++)
+		sources[i].compress = 0;
+	ok &= asset_archive_write(raw_path, sources, count) == 0;
+	for (i = 0; i < count; i++)
+		sources[i].compress = 1;
+	ok &= asset_archive_write(lz4_path, sources, count) == 0;
+	if (!ok) {
+		fprintf(stderr, "Could not write the archives\n");
+		return 1;
+	}
+
+	printf("%u assets, %.2f MB, frames of %.1f ms\n", count, megabytes(bytes), frame_ms);
+
+	ok &= load_files(assets, count, bytes);
+	clear(assets, count);
+	ok &= load_archive("archive", raw_path, assets, count, bytes);
+	clear(assets, count);
+	ok &= load_archive("archive lz4", lz4_path, assets, count, bytes);
+	clear(assets, count);
+	ok &= stream_archive("stream", raw_path, assets, count, bytes, frame_ms);
+	clear(assets, count);
+	ok &= stream_archive("stream lz4", lz4_path, assets, count, bytes, frame_ms);
+
+	for (i = 0; i < count; i++) {
+		remove(assets[i].path);
+		free(assets[i].data);
+		free(assets[i].loaded);
+	}
+	remove(raw_path);
+	remove(lz4_path);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/*
+ * Asset packer.
+ *
+ * Writes the files given on the command line to an asset archive (see
+ * include/asset_archive.h), each under its file name or under NAME when
+ * given as NAME=FILE, then reads the archive back to check it.
+ *
+ * Usage: asset_pack [--lz4] [--align=N] output [NAME=]FILE...
+ *   --lz4      store the entries LZ4 compressed when that makes them smaller
+ *   --align=N  align the entries to N bytes, a power of two from 16 to 4096
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "asset_archive.h"
+
+static void *read_file(const char *path, uint32_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	void *data = NULL;
+	long end;
+
+	if (!file)
+		return NULL;
+
+	if (fseek(file, 0, SEEK_END) == 0 && (end = ftell(file)) >= 0 && end <= UINT32_MAX &&
+	    fseek(file, 0, SEEK_SET) == 0) {
+		data = malloc(end ? end : 1);
+		if (data && fread(data, 1, end, file) != (size_t)end) {
+			free(data);
+			data = NULL;
+		}
+		*size = end;
+	}
+
+	fclose(file);
+
+	return data;
+}
+
+static void print_usage(const char *program)
+{
+	fprintf(stderr,
+		"Usage: %s [--lz4] [--align=N] output [NAME=]FILE...\n"
+		"  --lz4      store the entries LZ4 compressed when that makes them smaller\n"
+		"  --align=N  align the entries to N bytes, a power of two from %u to %u\n",
+		program, ASSET_ARCHIVE_MIN_ALIGN, ASSET_ARCHIVE_MAX_ALIGN);
+}
+
+int main(int argc, char *argv[])
+{
+	struct asset_archive_source *sources;
+	struct asset_archive archive;
+	const char *output = NULL;
+	uint32_t alignment = 0;
+	uint64_t size = 0, stored_size = 0;
+	unsigned int count = 0, i;
+	int compress = 0, arg, ok = 1;
+	void *scratch = NULL;
+
+	sources = calloc(argc, sizeof(*sources));
+	if (!sources)
+		return 1;
+
+	for (arg = 1; arg < argc; arg++) {
+		struct asset_archive_source *source = &sources[count];
+		const char *path, *equals, *slash;
+
+		if (strcmp(argv[arg], "--lz4") == 0) {
+			compress = 1;
+			continue;
+		} else if (strncmp(argv[arg], "--align=", 8) == 0) {
+			alignment = strtoul(argv[arg] + 8, NULL, 0);
+			continue;
+		} else if (!output) {
+			output = argv[arg];
+			continue;
+		}
+
+		equals = strchr(argv[arg], '=');
+		path = equals ? equals + 1 : argv[arg];
+		if (equals) {
+			source->name = strndup(argv[arg], equals - argv[arg]);
+		} else {
+			slash = strrchr(path, '/');
+			source->name = slash ? slash + 1 : path;
+		}
+
+		source->data = read_file(path, &source->size);
+		if (!source->data) {
+			fprintf(stderr, "Could not read %s\n", path);
+			return 1;
+		}
+		count++;
+	}
+
+	if (!output || !count) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		sources[i].alignment = alignment;
+		sources[i].compress = compress;
+	}
+
+	if (asset_archive_write(output, sources, count) < 0) {
+		fprintf(stderr, "Could not write %s: names must be unique and shorter than %u bytes,"
+			" the alignment a power of two from %u to %u\n", output,
+			ASSET_ARCHIVE_NAME_SIZE, ASSET_ARCHIVE_MIN_ALIGN, ASSET_ARCHIVE_MAX_ALIGN);
+		return 1;
+	}
+
+	if (asset_archive_open(&archive, output) < 0) {
+		fprintf(stderr, "Could not read %s back\n", output);
+		return 1;
+	}
+
+	if (archive.max_compressed_size)
+		scratch = malloc(archive.max_compressed_size);
+
+	for (i = 0; i < count; i++) {
+		const struct asset_archive_entry *entry = asset_archive_find(&archive, sources[i].name);
+		void *data = malloc(sources[i].size ? sources[i].size : 1);
+		int same = entry && data && asset_archive_load(&archive, entry, data, scratch) == 0 &&
+			memcmp(data, sources[i].data, sources[i].size) == 0;
+
+		if (same) {
+			printf("%-32s %10u -> %10u bytes%s\n", entry->name, entry->size,
+				entry->stored_size,
+				entry->compression == ASSET_COMPRESSION_LZ4 ? ", lz4" : "");
+			size += entry->size;
+			stored_size += entry->stored_size;
+		} else {
+			fprintf(stderr, "%s does not read back\n", sources[i].name);
+			ok = 0;
+		}
+		free(data);
+	}
+
+	printf("%s: %u entries, %llu -> %llu bytes of data, %u bytes in all\n", output, count,
+		(unsigned long long)size, (unsigned long long)stored_size, archive.header.size);
+
+	free(scratch);
+	asset_archive_close(&archive);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/*
+ * Benchmark regression gate.
+ *
+ * Compares the metrics of a gxmfun --benchmark=FILE run against a stored
+ * baseline. Every metric is lower-is-better; one regresses when it grows
+ * by more than the relative threshold and by more than the absolute
+ * tolerance, which keeps tiny, noisy timings from failing the gate.
+ * Metrics only present in one of the files are listed but don't fail it.
+ *
+ * Exits with 1 if any metric regressed, 2 if a file can't be read.
+ *
+ * Usage: bench_compare [-t percent] [-a tolerance] baseline.json result.json
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_METRICS 256
+#define MAX_NAME 96
+
+#define DEFAULT_THRESHOLD_PERCENT 5.0
+#define DEFAULT_TOLERANCE 0.05
+
+struct metric {
+	char name[MAX_NAME];
+	double value;
+};
+
+struct metrics {
+	struct metric metrics[MAX_METRICS];
+	unsigned int count;
+};
+
+static char *read_file(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	char *data;
+	long size;
+
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = malloc(size + 1);
+	if (data && fread(data, 1, size, file) != (size_t)size) {
+		free(data);
+		data = NULL;
+	}
+	if (data)
+		data[size] = '\0';
+
+	fclose(file);
+
+	return data;
+}
+
+static const char *skip_space(const char *p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == ',')
+		p++;
+	return p;
+}
+
+/* Reads the flat "name": number pairs of the "metrics" object */
+static int parse_metrics(const char *json, struct metrics *metrics)
+{
+	const char *p = strstr(json, "\"metrics\"");
+	char *end;
+
+	metrics->count = 0;
+
+	if (!p || !(p = strchr(p, '{')))
+		return -1;
+
+	for (p = skip_space(p + 1); *p != '}'; p = skip_space(p)) {
+		struct metric *metric = &metrics->metrics[metrics->count];
+		const char *name_end;
+		size_t length;
+
+		if (*p != '"' || !(name_end = strchr(p + 1, '"')))
+			return -1;
+
+		length = name_end - (p + 1);
+		if (length >= MAX_NAME || metrics->count == MAX_METRICS)
+			return -1;
+		memcpy(metric->name, p + 1, length);
+		metric->name[length] = '\0';
+
+		p = skip_space(name_end + 1);
+		if (*p != ':')
+			return -1;
+
+		metric->value = strtod(p + 1, &end);
+		if (end == p + 1)
+			return -1;
+		p = end;
+
+		metrics->count++;
+	}
+
+	return 0;
+}
+
+static int load_metrics(const char *path, struct metrics *metrics)
+{
+	char *json = read_file(path);
+	int ret;
+
+	if (!json) {
+		fprintf(stderr, "%s: can't read the file\n", path);
+		return -1;
+	}
+
+	ret = parse_metrics(json, metrics);
+	if (ret < 0)
+		fprintf(stderr, "%s: no valid \"metrics\" object\n", path);
+
+	free(json);
+
+	return ret;
+}
+
+static const struct metric *find_metric(const struct metrics *metrics, const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < metrics->count; i++) {
+		if (strcmp(metrics->metrics[i].name, name) == 0)
+			return &metrics->metrics[i];
+	}
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	static struct metrics baseline, result;
+	double threshold = DEFAULT_THRESHOLD_PERCENT;
+	double tolerance = DEFAULT_TOLERANCE;
+	const char *paths[2] = {NULL, NULL};
+	unsigned int path_count = 0, regressions = 0, i;
+
+	for (i = 1; i < (unsigned int)argc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < (unsigned int)argc)
+			threshold = strtod(argv[++i], NULL);
+		else if (strcmp(argv[i], "-a") == 0 && i + 1 < (unsigned int)argc)
+			tolerance = strtod(argv[++i], NULL);
+		else if (path_count < 2)
+			paths[path_count++] = argv[i];
+		else
+			path_count = 3;
+	}
+
+	if (path_count != 2) {
+		fprintf(stderr, "usage: %s [-t percent] [-a tolerance] baseline.json result.json\n",
+			argv[0]);
+		return 2;
+	}
+
+	if (load_metrics(paths[0], &baseline) < 0 || load_metrics(paths[1], &result) < 0)
+		return 2;
+
+	printf("%-40s %14s %14s %9s\n", "metric", "baseline", "result", "change");
+
+	for (i = 0; i < baseline.count; i++) {
+		const struct metric *base = &baseline.metrics[i];
+		const struct metric *current = find_metric(&result, base->name);
+		double change;
+		int regressed;
+
+		if (!current) {
+			printf("%-40s %14.4f %14s\n", base->name, base->value, "missing");
+			continue;
+		}
+
+		change = base->value ? (current->value - base->value) * 100.0 / base->value : 0.0;
+		regressed = current->value > base->value * (1.0 + threshold / 100.0) &&
+			current->value - base->value > tolerance;
+		regressions += regressed;
+
+		printf("%-40s %14.4f %14.4f %+8.1f%%%s\n", base->name, base->value,
+			current->value, change, regressed ? "  REGRESSION" : "");
+	}
+
+	for (i = 0; i < result.count; i++) {
+		if (!find_metric(&baseline, result.metrics[i].name))
+			printf("%-40s %14s %14.4f\n", result.metrics[i].name, "new",
+				result.metrics[i].value);
+	}
+
+	if (regressions) {
+		printf("%u metrics regressed by more than %.1f%%\n", regressions, threshold);
+		return 1;
+	}
+
+	printf("no regressions (threshold %.1f%%, tolerance %g)\n", threshold, tolerance);
+
+	return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * BVH culling benchmark.
+ *
+ * Scatters objects over a large area and culls them against a camera and
+ * two portal-like views, comparing one BVH traversal for all the views
+ * with a linear test of every object per view. Also times the SAH build
+ * and a refit after a fraction of the objects moved, and checks that the
+ * BVH reports the same objects as the linear test.
+ *
+ * Usage: bvh_bench [object_count] [iterations] [moved_percent]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math_utils.h"
+#include "bvh.h"
+#include "time_utils.h"
+
+#define VIEW_COUNT 3
+#define WORLD_SIZE 400.0f
+
+static void random_box(struct bvh_aabb *box)
+{
+	vector3f center;
+	float radius = 0.5f + (rand() % 100) / 50.0f;
+
+	vector3f_init(&center, (rand() % 40000) / 40000.0f * WORLD_SIZE - WORLD_SIZE / 2.0f,
+		(rand() % 2000) / 100.0f, (rand() % 40000) / 40000.0f * WORLD_SIZE - WORLD_SIZE / 2.0f);
+	vector3f_init(&box->min, center.x - radius, center.y - radius, center.z - radius);
+	vector3f_init(&box->max, center.x + radius, center.y + radius, center.z + radius);
+}
+
+/* Same plane tests as the BVH, one box at a time */
+static int linear_test(const vector4f planes[6], const struct bvh_aabb *box)
+{
+	float cx = (box->min.x + box->max.x) * 0.5f;
+	float cy = (box->min.y + box->max.y) * 0.5f;
+	float cz = (box->min.z + box->max.z) * 0.5f;
+	float ex = (box->max.x - box->min.x) * 0.5f;
+	float ey = (box->max.y - box->min.y) * 0.5f;
+	float ez = (box->max.z - box->min.z) * 0.5f;
+	int i;
+
+	for (i = 0; i < 6; i++) {
+		float d = planes[i].x * cx + planes[i].y * cy + planes[i].z * cz + planes[i].w;
+		float r = fabsf(planes[i].x) * ex + fabsf(planes[i].y) * ey + fabsf(planes[i].z) * ez;
+
+		if (d + r < 0.0f)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int count = argc > 1 ? atoi(argv[1]) : 100000;
+	unsigned int iterations = argc > 2 ? atoi(argv[2]) : 50;
+	unsigned int moved_percent = argc > 3 ? atoi(argv[3]) : 10;
+	struct bvh_frustum frustums[VIEW_COUNT];
+	vector4f planes[VIEW_COUNT][6];
+	uint32_t *visible[VIEW_COUNT];
+	unsigned int visible_count[VIEW_COUNT];
+	unsigned int linear_count[VIEW_COUNT];
+	matrix4x4 projection_matrix;
+	struct bvh bvh;
+	struct bvh_aabb *boxes;
+	uint8_t *changed;
+	uint32_t *expected;
+	uint64_t start, build_ns, refit_ns = 0, cull_ns, linear_ns;
+	unsigned int i, j, iteration;
+	int failed = 0;
+
+	boxes = malloc(count * sizeof(*boxes));
+	changed = malloc(count);
+	expected = malloc(count * sizeof(*expected));
+	for (i = 0; i < VIEW_COUNT; i++)
+		visible[i] = malloc(count * sizeof(*visible[i]));
+
+	srand(1234);
+	for (i = 0; i < count; i++)
+		random_box(&boxes[i]);
+
+	matrix4x4_init_perspective(projection_matrix, 90.0f, 960.0f / 544.0f, 0.01f, 100.0f);
+
+	for (i = 0; i < VIEW_COUNT; i++) {
+		struct camera_setup { vector3f translation, rotation; } cameras[VIEW_COUNT] = {
+			{{.x = 0.0f, .y = 3.0f, .z = 5.0f}, {.x = 0.0f, .y = 0.0f, .z = 0.0f}},
+			{{.x = 60.0f, .y = 2.0f, .z = -50.0f}, {.x = 0.0f, .y = 2.0f, .z = 0.0f}},
+			{{.x = -80.0f, .y = 10.0f, .z = 80.0f}, {.x = -0.3f, .y = 4.0f, .z = 0.0f}},
+		};
+		matrix4x4 camera_model, view_matrix, view_projection_matrix;
+
+		matrix4x4_build_model_matrix(camera_model, &cameras[i].translation, &cameras[i].rotation);
+		matrix4x4_invert(view_matrix, camera_model);
+		matrix4x4_multiply(view_projection_matrix, projection_matrix, view_matrix);
+		matrix4x4_frustum_planes(planes[i], view_projection_matrix);
+		bvh_frustum_init(&frustums[i], planes[i]);
+	}
+
+	bvh_init(&bvh);
+
+	start = time_get_ns();
+	if (bvh_build(&bvh, boxes, count) < 0) {
+		fprintf(stderr, "bvh_build failed\n");
+		return 1;
+	}
+	build_ns = time_get_ns() - start;
+
+	printf("%u objects, %u views, %u nodes (%u bytes each)\n", count, VIEW_COUNT,
+		bvh.node_count, (unsigned int)sizeof(struct bvh_node));
+
+	/* Move some objects every iteration and refit */
+	for (iteration = 0; iteration < iterations; iteration++) {
+		memset(changed, 0, count);
+		for (j = 0; j < count * moved_percent / 100; j++) {
+			i = rand() % count;
+			boxes[i].min.x += 0.5f;
+			boxes[i].max.x += 0.5f;
+			changed[i] = 1;
+		}
+
+		start = time_get_ns();
+		bvh_refit(&bvh, boxes, changed);
+		refit_ns += time_get_ns() - start;
+	}
+
+	start = time_get_ns();
+	for (iteration = 0; iteration < iterations; iteration++)
+		bvh_cull(&bvh, boxes, frustums, VIEW_COUNT, visible, visible_count, count);
+	cull_ns = time_get_ns() - start;
+
+	start = time_get_ns();
+	for (iteration = 0; iteration < iterations; iteration++) {
+		for (i = 0; i < VIEW_COUNT; i++) {
+			linear_count[i] = 0;
+			for (j = 0; j < count; j++) {
+				if (linear_test(planes[i], &boxes[j]))
+					expected[linear_count[i]++] = j;
+			}
+		}
+	}
+	linear_ns = time_get_ns() - start;
+
+	for (i = 0; i < VIEW_COUNT; i++) {
+		linear_count[i] = 0;
+		for (j = 0; j < count; j++) {
+			if (linear_test(planes[i], &boxes[j]))
+				expected[linear_count[i]++] = j;
+		}
+
+		qsort(visible[i], visible_count[i], sizeof(*visible[i]), compare_u32);
+		if (visible_count[i] != linear_count[i] ||
+		    memcmp(visible[i], expected, linear_count[i] * sizeof(*expected))) {
+			fprintf(stderr, "view %u: BVH found %u objects, linear test %u\n",
+				i, visible_count[i], linear_count[i]);
+			failed = 1;
+		}
+		printf("view %u: %u visible\n", i, visible_count[i]);
+	}
+
+	printf("build %.3f ms, refit (%u%% moved) %.3f ms\n", time_ns_to_ms(build_ns),
+		moved_percent, time_ns_to_ms(refit_ns) / iterations);
+	printf("cull %u views: BVH %.3f ms, linear %.3f ms, %.1fx\n", VIEW_COUNT,
+		time_ns_to_ms(cull_ns) / iterations, time_ns_to_ms(linear_ns) / iterations,
+		(float)linear_ns / cull_ns);
+
+	bvh_free(&bvh);
+	for (i = 0; i < VIEW_COUNT; i++)
+		free(visible[i]);
+	free(expected);
+	free(changed);
+	free(boxes);
+
+	return failed;
+}
@@ -0,0 +1,184 @@
+/*
+ * Color depth fill-rate benchmark.
+ *
+ * Runs the demo (built for the host) headless with 32-bit and 16-bit
+ * color and reports the frame time, raster time, fill rate and color
+ * bytes written per scene of each, and how close the 16-bit image is to
+ * the 32-bit one. The remaining arguments are passed to the demo, e.g.
+ * --portal=texture or --dynres=on.
+ *
+ * Usage: fillrate_bench [gxmfun] [frames] [gxmfun options...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define DUMP_PATTERN "fillrate_bench_%u_%%u.ppm"
+
+struct result {
+	float frame_ms;
+	float raster_ms;
+	float mpixels_per_second;
+	float color_mb;
+};
+
+static const unsigned int depths[] = {32, 16};
+
+static int run(const char *program, const char *extra, unsigned int depth,
+	unsigned int frames, struct result *result)
+{
+	char command[1024], value[64], line[512];
+	float geometry_ms, covered, shaded, triangles;
+	unsigned int n;
+	int found = 0;
+	FILE *pipe;
+
+	setenv("GXMFUN_HOST_STATS", "1", 1);
+	/* Only the first frame is dumped, it does not depend on timing */
+	snprintf(value, sizeof(value), DUMP_PATTERN, depth);
+	setenv("GXMFUN_HOST_DUMP", value, 1);
+	snprintf(value, sizeof(value), "%u", frames + 1);
+	setenv("GXMFUN_HOST_DUMP_INTERVAL", value, 1);
+
+	snprintf(command, sizeof(command),
+		"%s --frames=%u --report-interval=%u --vsync=off --color=%u%s",
+		program, frames, frames, depth, extra);
+
+	pipe = popen(command, "r");
+	if (!pipe)
+		return -1;
+
+	while (fgets(line, sizeof(line), pipe)) {
+		if (sscanf(line, "frames %u: frame %f ms", &n, &result->frame_ms) == 2)
+			found |= 1;
+		else if (sscanf(line, "host gxm: %u raster threads, %u scenes, %f triangles, "
+			"geometry %f ms, raster %f ms per scene, %f Mpixels covered, "
+			"%f Mpixels shaded per scene, %f Mpixels/s, %f MB color written",
+			&n, &n, &triangles, &geometry_ms, &result->raster_ms, &covered, &shaded,
+			&result->mpixels_per_second, &result->color_mb) == 9)
+			found |= 2;
+	}
+
+	if (pclose(pipe) != 0 || found != 3)
+		return -1;
+
+	return 0;
+}
+
+/* Path of the first frame dumped by the run with the given color depth */
+static void dump_path(char *path, size_t size, unsigned int depth)
+{
+	char pattern[64];
+
+	snprintf(pattern, sizeof(pattern), DUMP_PATTERN, depth);
+	snprintf(path, size, pattern, 0);
+}
+
+static unsigned char *read_ppm(const char *path, unsigned int *width, unsigned int *height)
+{
+	unsigned char *data;
+	size_t size;
+	FILE *file = fopen(path, "rb");
+
+	if (!file)
+		return NULL;
+
+	if (fscanf(file, "P6 %u %u 255", width, height) != 2 || fgetc(file) == EOF) {
+		fclose(file);
+		return NULL;
+	}
+
+	size = (size_t)*width * *height * 3;
+	data = malloc(size);
+	if (data && fread(data, 1, size, file) != size) {
+		free(data);
+		data = NULL;
+	}
+
+	fclose(file);
+
+	return data;
+}
+
+/* Peak signal to noise ratio of b against a in dB, negative on error */
+static double compare_ppm(const char *a, const char *b)
+{
+	unsigned int width_a, height_a, width_b, height_b;
+	unsigned char *data_a = read_ppm(a, &width_a, &height_a);
+	unsigned char *data_b = read_ppm(b, &width_b, &height_b);
+	double squared_error = 0.0, psnr = -1.0;
+	size_t i, size;
+
+	if (data_a && data_b && width_a == width_b && height_a == height_b) {
+		size = (size_t)width_a * height_a * 3;
+		for (i = 0; i < size; i++) {
+			double d = (double)data_a[i] - data_b[i];
+
+			squared_error += d * d;
+		}
+		psnr = squared_error > 0.0 ?
+			10.0 * log10(255.0 * 255.0 * size / squared_error) : INFINITY;
+	}
+
+	free(data_a);
+	free(data_b);
+
+	return psnr;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *program = argc > 1 ? argv[1] : "./gxmfun";
+	unsigned int frames = argc > 2 ? atoi(argv[2]) : 100;
+	struct result results[2];
+	char extra[512] = "", paths[2][64];
+	unsigned int i;
+	double psnr;
+	int arg;
+
+	if (frames < 2)
+		frames = 2;
+
+	for (arg = 3; arg < argc; arg++) {
+		if (strlen(extra) + strlen(argv[arg]) + 2 > sizeof(extra)) {
+			fprintf(stderr, "Too many options\n");
+			return 1;
+		}
+		strcat(extra, " ");
+		strcat(extra, argv[arg]);
+	}
+
+	printf("%s%s, %u frames\n", program, extra, frames);
+	printf("color    frame ms   raster ms  Mpixels/s  MB/scene\n");
+
+	for (i = 0; i < 2; i++) {
+		if (run(program, extra, depths[i], frames, &results[i]) < 0) {
+			fprintf(stderr, "%u-bit: could not run %s\n", depths[i], program);
+			return 1;
+		}
+
+		dump_path(paths[i], sizeof(paths[i]), depths[i]);
+		printf("%2u-bit %11.3f %11.3f %10.1f %9.3f\n", depths[i], results[i].frame_ms,
+			results[i].raster_ms, results[i].mpixels_per_second, results[i].color_mb);
+	}
+
+	printf("16-bit: %.2fx fill rate, %.2fx frame time, %.0f%% of the color bytes\n",
+		results[1].mpixels_per_second / results[0].mpixels_per_second,
+		results[1].frame_ms / results[0].frame_ms,
+		100.0f * results[1].color_mb / results[0].color_mb);
+
+	psnr = compare_ppm(paths[0], paths[1]);
+	for (i = 0; i < 2; i++)
+		remove(paths[i]);
+
+	if (psnr < 0.0) {
+		fprintf(stderr, "Could not compare the first frames\n");
+		return 1;
+	}
+
+	/* R5G6B5 rounding alone stays well above this */
+	printf("first frame PSNR of 16-bit against 32-bit: %.1f dB\n", psnr);
+
+	return psnr < 30.0;
+}
@@ -0,0 +1,751 @@
+/*
+ * GXM trace player.
+ *
+ * Replays a trace recorded with gxmfun --trace=FILE through the host GXM
+ * backend, as fast as possible and without the demo's CPU work, and
+ * reports the frame times and the time spent in each kind of command.
+ * Frames can be dumped with GXMFUN_HOST_DUMP as when running the demo.
+ *
+ * The trace is mapped read-only and blobs are used in place; pages that
+ * have been replayed are dropped every few frames so long traces do not
+ * stay resident.
+ *
+ * Usage: gxm_replay [-v] trace
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <psp2/gxm.h>
+#include <psp2/display.h>
+#include "gxm_trace_format.h"
+#include "time_utils.h"
+
+#define ALIGN(x, a) (((x) + ((a) - 1)) & ~((a) - 1))
+
+#define MAX_PROGRAMS 32
+#define MAX_TARGETS 8
+#define MAX_SURFACES 16
+#define RING_BUFFER_SIZE (4 * 1024 * 1024)
+/* Replayed pages are dropped every RELEASE_INTERVAL frames */
+#define RELEASE_INTERVAL 64
+
+struct program {
+	SceGxmShaderPatcherId id;
+	const SceGxmProgram *gxp;
+	void *patched;
+};
+
+struct target {
+	unsigned int width;
+	unsigned int height;
+	SceGxmRenderTarget *render_target;
+};
+
+struct surface {
+	void *data;
+	size_t size;
+	SceGxmColorFormat format;
+	unsigned int stride;
+};
+
+struct record_stats {
+	unsigned int count;
+	uint64_t ns;
+};
+
+static const char *record_names[GXM_TRACE_RECORD_TYPE_COUNT] = {
+	"blob", "vertex program", "fragment program", "begin scene", "end scene",
+	"end frame", "begin command list", "end command list", "set vertex program",
+	"set fragment program", "reserve vertex uniforms", "reserve fragment uniforms",
+	"uniform data", "set stencil func", "set stencil ref", "set depth func",
+	"set depth write", "set vertex stream", "draw", "set fragment texture",
+	"set viewport"
+};
+
+static struct {
+	const unsigned char *data;
+	size_t size;
+	int verbose;
+
+	SceGxmContext *context;
+	SceGxmShaderPatcher *shader_patcher;
+	void *vdm_ring_buffer;
+	void *vertex_ring_buffer;
+	void *fragment_ring_buffer;
+	void *fragment_usse_ring_buffer;
+	void *context_host_mem;
+
+	struct target targets[MAX_TARGETS];
+	unsigned int target_count;
+	struct surface surfaces[MAX_SURFACES];
+	void *depth_stencil_buffer;
+	size_t depth_stencil_size;
+	/* Surface of the last scene, displayed at the end of the frame */
+	const struct surface *display_surface;
+	unsigned int display_width;
+	unsigned int display_height;
+
+	const void **blobs;
+	unsigned int blob_count;
+	struct program vertex_programs[MAX_PROGRAMS];
+	struct program fragment_programs[MAX_PROGRAMS];
+	const struct program *vertex_program;
+	const struct program *fragment_program;
+	void *vertex_uniforms;
+	void *fragment_uniforms;
+	/* Viewport of the immediate context, restored after inlined command lists */
+	int in_command_list;
+	int viewport_set;
+	struct gxm_trace_viewport viewport;
+
+	struct record_stats record_stats[GXM_TRACE_RECORD_TYPE_COUNT];
+	unsigned int frames;
+	uint64_t frame_start_ns;
+	float frame_min_ms;
+	float frame_max_ms;
+	float frame_total_ms;
+} replay;
+
+static void *shader_patcher_host_alloc_cb(void *user_data, unsigned int size)
+{
+	return malloc(size);
+}
+
+static void shader_patcher_host_free_cb(void *user_data, void *mem)
+{
+	free(mem);
+}
+
+static int gxm_init(void)
+{
+	SceGxmInitializeParams init_params;
+	SceGxmContextParams context_params;
+	SceGxmShaderPatcherParams shader_patcher_params;
+
+	memset(&init_params, 0, sizeof(init_params));
+	init_params.displayQueueMaxPendingCount = 1;
+	init_params.parameterBufferSize = SCE_GXM_DEFAULT_PARAMETER_BUFFER_SIZE;
+	if (sceGxmInitialize(&init_params) < 0)
+		return -1;
+
+	replay.context_host_mem = malloc(SCE_GXM_MINIMUM_CONTEXT_HOST_MEM_SIZE);
+	replay.vdm_ring_buffer = malloc(RING_BUFFER_SIZE);
+	replay.vertex_ring_buffer = malloc(RING_BUFFER_SIZE);
+	replay.fragment_ring_buffer = malloc(RING_BUFFER_SIZE);
+	replay.fragment_usse_ring_buffer = malloc(RING_BUFFER_SIZE);
+
+	memset(&context_params, 0, sizeof(context_params));
+	context_params.hostMem = replay.context_host_mem;
+	context_params.hostMemSize = SCE_GXM_MINIMUM_CONTEXT_HOST_MEM_SIZE;
+	context_params.vdmRingBufferMem = replay.vdm_ring_buffer;
+	context_params.vdmRingBufferMemSize = RING_BUFFER_SIZE;
+	context_params.vertexRingBufferMem = replay.vertex_ring_buffer;
+	context_params.vertexRingBufferMemSize = RING_BUFFER_SIZE;
+	context_params.fragmentRingBufferMem = replay.fragment_ring_buffer;
+	context_params.fragmentRingBufferMemSize = RING_BUFFER_SIZE;
+	context_params.fragmentUsseRingBufferMem = replay.fragment_usse_ring_buffer;
+	context_params.fragmentUsseRingBufferMemSize = RING_BUFFER_SIZE;
+	if (sceGxmCreateContext(&context_params, &replay.context) < 0)
+		return -1;
+
+	memset(&shader_patcher_params, 0, sizeof(shader_patcher_params));
+	shader_patcher_params.hostAllocCallback = shader_patcher_host_alloc_cb;
+	shader_patcher_params.hostFreeCallback = shader_patcher_host_free_cb;
+	if (sceGxmShaderPatcherCreate(&shader_patcher_params, &replay.shader_patcher) < 0)
+		return -1;
+
+	return 0;
+}
+
+static void destroy_targets(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < replay.target_count; i++)
+		sceGxmDestroyRenderTarget(replay.targets[i].render_target);
+	for (i = 0; i < MAX_SURFACES; i++)
+		free(replay.surfaces[i].data);
+	free(replay.depth_stencil_buffer);
+}
+
+static void gxm_finish(void)
+{
+	unsigned int i;
+
+	sceGxmFinish(replay.context);
+
+	for (i = 0; i < MAX_PROGRAMS; i++) {
+		if (replay.vertex_programs[i].id) {
+			sceGxmShaderPatcherReleaseVertexProgram(replay.shader_patcher,
+				replay.vertex_programs[i].patched);
+			sceGxmShaderPatcherUnregisterProgram(replay.shader_patcher,
+				replay.vertex_programs[i].id);
+		}
+		if (replay.fragment_programs[i].id) {
+			sceGxmShaderPatcherReleaseFragmentProgram(replay.shader_patcher,
+				replay.fragment_programs[i].patched);
+			sceGxmShaderPatcherUnregisterProgram(replay.shader_patcher,
+				replay.fragment_programs[i].id);
+		}
+	}
+
+	destroy_targets();
+	sceGxmShaderPatcherDestroy(replay.shader_patcher);
+	sceGxmDestroyContext(replay.context);
+	sceGxmTerminate();
+
+	free(replay.context_host_mem);
+	free(replay.vdm_ring_buffer);
+	free(replay.vertex_ring_buffer);
+	free(replay.fragment_ring_buffer);
+	free(replay.fragment_usse_ring_buffer);
+	free(replay.blobs);
+}
+
+/* A render target is created for the first scene of each size */
+static SceGxmRenderTarget *get_render_target(unsigned int width, unsigned int height)
+{
+	SceGxmRenderTargetParams params;
+	struct target *target;
+	unsigned int i;
+
+	for (i = 0; i < replay.target_count; i++) {
+		if (replay.targets[i].width == width && replay.targets[i].height == height)
+			return replay.targets[i].render_target;
+	}
+
+	if (replay.target_count == MAX_TARGETS)
+		return NULL;
+
+	memset(&params, 0, sizeof(params));
+	params.width = width;
+	params.height = height;
+	params.scenesPerFrame = 1;
+	params.multisampleMode = SCE_GXM_MULTISAMPLE_NONE;
+	params.driverMemBlock = -1;
+
+	target = &replay.targets[replay.target_count];
+	if (sceGxmCreateRenderTarget(&params, &target->render_target) < 0)
+		return NULL;
+	target->width = width;
+	target->height = height;
+	replay.target_count++;
+
+	return target->render_target;
+}
+
+/* Surfaces grow to the largest scene that draws to them */
+static struct surface *get_surface(uint32_t id, SceGxmColorFormat format, unsigned int stride,
+	unsigned int height)
+{
+	size_t size = (size_t)stride * height *
+		(format == SCE_GXM_COLOR_FORMAT_U5U6U5_RGB ? 2 : 4);
+	struct surface *surface;
+	void *data;
+
+	if (id >= MAX_SURFACES)
+		return NULL;
+
+	surface = &replay.surfaces[id];
+	if (size > surface->size) {
+		data = realloc(surface->data, size);
+		if (!data)
+			return NULL;
+		memset((char *)data + surface->size, 0, size - surface->size);
+		surface->data = data;
+		surface->size = size;
+	}
+	surface->format = format;
+	surface->stride = stride;
+
+	return surface;
+}
+
+static int begin_scene(const struct gxm_trace_begin_scene *record)
+{
+	unsigned int depth_stencil_width = ALIGN(record->width, SCE_GXM_TILE_SIZEX);
+	size_t depth_stencil_size = (size_t)depth_stencil_width *
+		ALIGN(record->height, SCE_GXM_TILE_SIZEY) * 4;
+	SceGxmValidRegion region = {
+		record->x_min, record->y_min, record->x_max, record->y_max
+	};
+	SceGxmDepthStencilSurface depth_stencil_surface;
+	SceGxmColorSurface color_surface;
+	SceGxmRenderTarget *render_target;
+	struct surface *surface;
+
+	render_target = get_render_target(record->width, record->height);
+	surface = get_surface(record->surface, record->color_format, record->stride,
+		record->height);
+	if (!render_target || !surface)
+		return -1;
+
+	/* Scenes clear the depth and stencil they use, so it can be shared */
+	if (record->depth_stencil && depth_stencil_size > replay.depth_stencil_size) {
+		free(replay.depth_stencil_buffer);
+		replay.depth_stencil_buffer = calloc(depth_stencil_size, 1);
+		if (!replay.depth_stencil_buffer)
+			return -1;
+		replay.depth_stencil_size = depth_stencil_size;
+	}
+
+	sceGxmColorSurfaceInit(&color_surface, record->color_format,
+		SCE_GXM_COLOR_SURFACE_LINEAR, SCE_GXM_COLOR_SURFACE_SCALE_NONE,
+		SCE_GXM_OUTPUT_REGISTER_SIZE_32BIT, record->width, record->height,
+		record->stride, surface->data);
+	sceGxmDepthStencilSurfaceInit(&depth_stencil_surface,
+		SCE_GXM_DEPTH_STENCIL_FORMAT_S8D24, SCE_GXM_DEPTH_STENCIL_SURFACE_TILED,
+		depth_stencil_width, replay.depth_stencil_buffer, NULL);
+
+	replay.display_surface = surface;
+	replay.display_width = record->width;
+	replay.display_height = record->height;
+
+	return sceGxmBeginScene(replay.context, record->flags, render_target, &region,
+		NULL, NULL, &color_surface, record->depth_stencil ? &depth_stencil_surface : NULL);
+}
+
+static const void *get_blob(uint32_t id)
+{
+	return id < replay.blob_count ? replay.blobs[id] : NULL;
+}
+
+/*
+ * Textures sample what an earlier scene drew to their surface, or texels
+ * stored in a blob
+ */
+static int set_fragment_texture(const struct gxm_trace_texture *record)
+{
+	const struct surface *surface = record->surface < MAX_SURFACES ?
+		&replay.surfaces[record->surface] : NULL;
+	SceGxmTexture texture;
+	const void *data;
+	int ret;
+
+	if (record->surface == 0xFFFFFFFF) {
+		data = get_blob(record->blob);
+		if (!data)
+			return -1;
+	} else {
+		if (!surface || record->offset >= surface->size ||
+		    (record->type != SCE_GXM_TEXTURE_SWIZZLED &&
+		     (size_t)record->stride * record->height > surface->size - record->offset))
+			return -1;
+		data = (const char *)surface->data + record->offset;
+	}
+
+	if (record->type == SCE_GXM_TEXTURE_SWIZZLED)
+		ret = sceGxmTextureInitSwizzled(&texture, data, record->format,
+			record->width, record->height, record->mip_count);
+	else
+		ret = sceGxmTextureInitLinearStrided(&texture, data, record->format,
+			record->width, record->height, record->stride);
+	if (ret < 0)
+		return ret;
+
+	sceGxmTextureSetMinFilter(&texture, record->min_filter);
+	sceGxmTextureSetMagFilter(&texture, record->mag_filter);
+	sceGxmTextureSetMipFilter(&texture, record->mip_filter);
+	sceGxmTextureSetUAddrMode(&texture, record->u_addr_mode);
+	sceGxmTextureSetVAddrMode(&texture, record->v_addr_mode);
+
+	return sceGxmSetFragmentTexture(replay.context, record->index, &texture);
+}
+
+/* Deferred command lists start from the default state */
+static void reset_state(void)
+{
+	sceGxmSetFrontStencilFunc(replay.context, SCE_GXM_STENCIL_FUNC_ALWAYS,
+		SCE_GXM_STENCIL_OP_KEEP, SCE_GXM_STENCIL_OP_KEEP, SCE_GXM_STENCIL_OP_KEEP,
+		0xFF, 0xFF);
+	sceGxmSetFrontStencilRef(replay.context, 0);
+	sceGxmSetFrontDepthFunc(replay.context, SCE_GXM_DEPTH_FUNC_ALWAYS);
+	sceGxmSetFrontDepthWriteEnable(replay.context, SCE_GXM_DEPTH_WRITE_ENABLED);
+	replay.vertex_program = NULL;
+	replay.fragment_program = NULL;
+	replay.vertex_uniforms = NULL;
+	replay.fragment_uniforms = NULL;
+}
+
+static int add_blob(const struct gxm_trace_blob *blob)
+{
+	if (blob->id >= replay.blob_count) {
+		unsigned int count = replay.blob_count ? replay.blob_count : 256;
+		const void **blobs;
+
+		while (count <= blob->id)
+			count *= 2;
+
+		blobs = realloc(replay.blobs, count * sizeof(*blobs));
+		if (!blobs)
+			return -1;
+		memset(blobs + replay.blob_count, 0,
+			(count - replay.blob_count) * sizeof(*blobs));
+		replay.blobs = blobs;
+		replay.blob_count = count;
+	}
+
+	replay.blobs[blob->id] = blob + 1;
+
+	return 0;
+}
+
+static int add_vertex_program(const struct gxm_trace_vertex_program *record)
+{
+	SceGxmVertexAttribute attributes[GXM_TRACE_MAX_ATTRIBUTES];
+	SceGxmVertexStream streams[GXM_TRACE_MAX_STREAMS];
+	struct program *program;
+	unsigned int i;
+
+	if (record->id >= MAX_PROGRAMS || record->attribute_count > GXM_TRACE_MAX_ATTRIBUTES ||
+	    record->stream_count > GXM_TRACE_MAX_STREAMS)
+		return -1;
+
+	for (i = 0; i < record->attribute_count; i++) {
+		attributes[i].streamIndex = record->attributes[i].stream_index;
+		attributes[i].offset = record->attributes[i].offset;
+		attributes[i].format = record->attributes[i].format;
+		attributes[i].componentCount = record->attributes[i].component_count;
+		attributes[i].regIndex = record->attributes[i].reg_index;
+	}
+	for (i = 0; i < record->stream_count; i++) {
+		streams[i].stride = record->streams[i].stride;
+		streams[i].indexSource = record->streams[i].index_source;
+	}
+
+	program = &replay.vertex_programs[record->id];
+	program->gxp = get_blob(record->program_blob);
+	if (!program->gxp ||
+	    sceGxmShaderPatcherRegisterProgram(replay.shader_patcher, program->gxp, &program->id) < 0)
+		return -1;
+
+	return sceGxmShaderPatcherCreateVertexProgram(replay.shader_patcher, program->id,
+		attributes, record->attribute_count, streams, record->stream_count,
+		(SceGxmVertexProgram **)&program->patched);
+}
+
+static int add_fragment_program(const struct gxm_trace_fragment_program *record)
+{
+	SceGxmBlendInfo blend_info;
+	struct program *program;
+
+	if (record->id >= MAX_PROGRAMS)
+		return -1;
+
+	blend_info.colorMask = record->blend.color_mask;
+	blend_info.colorFunc = record->blend.color_func;
+	blend_info.alphaFunc = record->blend.alpha_func;
+	blend_info.colorSrc = record->blend.color_src;
+	blend_info.colorDst = record->blend.color_dst;
+	blend_info.alphaSrc = record->blend.alpha_src;
+	blend_info.alphaDst = record->blend.alpha_dst;
+
+	program = &replay.fragment_programs[record->id];
+	program->gxp = get_blob(record->program_blob);
+	if (!program->gxp ||
+	    sceGxmShaderPatcherRegisterProgram(replay.shader_patcher, program->gxp, &program->id) < 0)
+		return -1;
+
+	return sceGxmShaderPatcherCreateFragmentProgram(replay.shader_patcher, program->id,
+		record->output_format, record->multisample_mode,
+		record->has_blend ? &blend_info : NULL, NULL,
+		(SceGxmFragmentProgram **)&program->patched);
+}
+
+static int set_uniform_data(const struct gxm_trace_uniform_data *record)
+{
+	const struct program *program = record->fragment ? replay.fragment_program :
+		replay.vertex_program;
+	void *buffer = record->fragment ? replay.fragment_uniforms : replay.vertex_uniforms;
+	const SceGxmProgramParameter *parameter;
+
+	if (!program || !buffer)
+		return -1;
+
+	parameter = sceGxmProgramGetParameter(program->gxp, record->parameter);
+	if (!parameter)
+		return -1;
+
+	return sceGxmSetUniformDataF(buffer, parameter, record->offset, record->count,
+		(const float *)(record + 1));
+}
+
+static void set_viewport(const struct gxm_trace_viewport *viewport)
+{
+	sceGxmSetViewport(replay.context, viewport->x_offset, viewport->x_scale,
+		viewport->y_offset, viewport->y_scale, viewport->z_offset, viewport->z_scale);
+}
+
+static void end_frame(void)
+{
+	SceDisplayFrameBuf display_fb;
+	uint64_t now;
+	float ms;
+
+	if (replay.display_surface) {
+		memset(&display_fb, 0, sizeof(display_fb));
+		display_fb.size = sizeof(display_fb);
+		display_fb.base = replay.display_surface->data;
+		display_fb.pitch = replay.display_surface->stride;
+		display_fb.pixelformat =
+			replay.display_surface->format == SCE_GXM_COLOR_FORMAT_U5U6U5_RGB ?
+			SCE_DISPLAY_PIXELFORMAT_R5G6B5 : SCE_DISPLAY_PIXELFORMAT_A8B8G8R8;
+		display_fb.width = replay.display_width;
+		display_fb.height = replay.display_height;
+		sceDisplaySetFrameBuf(&display_fb, SCE_DISPLAY_SETBUF_IMMEDIATE);
+	}
+
+	now = time_get_ns();
+	ms = time_ns_to_ms(now - replay.frame_start_ns);
+	replay.frame_start_ns = now;
+
+	if (!replay.frames || ms < replay.frame_min_ms)
+		replay.frame_min_ms = ms;
+	if (ms > replay.frame_max_ms)
+		replay.frame_max_ms = ms;
+	replay.frame_total_ms += ms;
+
+	if (replay.verbose)
+		printf("frame %u: %.3f ms\n", replay.frames, ms);
+
+	replay.frames++;
+}
+
+static int replay_record(uint32_t type, const void *payload)
+{
+	const struct program *program;
+
+	switch (type) {
+	case GXM_TRACE_BLOB:
+		return add_blob(payload);
+	case GXM_TRACE_VERTEX_PROGRAM:
+		return add_vertex_program(payload);
+	case GXM_TRACE_FRAGMENT_PROGRAM:
+		return add_fragment_program(payload);
+	case GXM_TRACE_BEGIN_SCENE:
+		return begin_scene(payload);
+	case GXM_TRACE_END_SCENE:
+		return sceGxmEndScene(replay.context, NULL, NULL);
+	case GXM_TRACE_END_FRAME:
+		end_frame();
+		return 0;
+	case GXM_TRACE_BEGIN_COMMAND_LIST:
+		reset_state();
+		replay.in_command_list = 1;
+		return 0;
+	case GXM_TRACE_END_COMMAND_LIST:
+		reset_state();
+		replay.in_command_list = 0;
+		if (replay.viewport_set)
+			set_viewport(&replay.viewport);
+		return 0;
+	case GXM_TRACE_SET_VERTEX_PROGRAM: {
+		const struct gxm_trace_program_id *record = payload;
+
+		if (record->id >= MAX_PROGRAMS || !replay.vertex_programs[record->id].patched)
+			return -1;
+		program = &replay.vertex_programs[record->id];
+		sceGxmSetVertexProgram(replay.context, program->patched);
+		replay.vertex_program = program;
+		return 0;
+	}
+	case GXM_TRACE_SET_FRAGMENT_PROGRAM: {
+		const struct gxm_trace_program_id *record = payload;
+
+		if (record->id >= MAX_PROGRAMS || !replay.fragment_programs[record->id].patched)
+			return -1;
+		program = &replay.fragment_programs[record->id];
+		sceGxmSetFragmentProgram(replay.context, program->patched);
+		replay.fragment_program = program;
+		return 0;
+	}
+	case GXM_TRACE_RESERVE_VERTEX_UNIFORMS:
+		return sceGxmReserveVertexDefaultUniformBuffer(replay.context,
+			&replay.vertex_uniforms);
+	case GXM_TRACE_RESERVE_FRAGMENT_UNIFORMS:
+		return sceGxmReserveFragmentDefaultUniformBuffer(replay.context,
+			&replay.fragment_uniforms);
+	case GXM_TRACE_UNIFORM_DATA:
+		return set_uniform_data(payload);
+	case GXM_TRACE_SET_STENCIL_FUNC: {
+		const struct gxm_trace_stencil_func *record = payload;
+
+		sceGxmSetFrontStencilFunc(replay.context, record->func, record->stencil_fail,
+			record->depth_fail, record->depth_pass, record->compare_mask,
+			record->write_mask);
+		return 0;
+	}
+	case GXM_TRACE_SET_STENCIL_REF:
+		sceGxmSetFrontStencilRef(replay.context,
+			((const struct gxm_trace_value *)payload)->value);
+		return 0;
+	case GXM_TRACE_SET_DEPTH_FUNC:
+		sceGxmSetFrontDepthFunc(replay.context,
+			((const struct gxm_trace_value *)payload)->value);
+		return 0;
+	case GXM_TRACE_SET_DEPTH_WRITE:
+		sceGxmSetFrontDepthWriteEnable(replay.context,
+			((const struct gxm_trace_value *)payload)->value);
+		return 0;
+	case GXM_TRACE_SET_VERTEX_STREAM: {
+		const struct gxm_trace_vertex_stream *record = payload;
+		const void *data = get_blob(record->blob);
+
+		if (!data)
+			return -1;
+		return sceGxmSetVertexStream(replay.context, record->index, data);
+	}
+	case GXM_TRACE_DRAW: {
+		const struct gxm_trace_draw *record = payload;
+		const void *indices = get_blob(record->index_blob);
+
+		if (!indices)
+			return -1;
+		return sceGxmDraw(replay.context, record->primitive, record->index_format,
+			indices, record->index_count);
+	}
+	case GXM_TRACE_SET_FRAGMENT_TEXTURE:
+		return set_fragment_texture(payload);
+	case GXM_TRACE_SET_VIEWPORT:
+		if (!replay.in_command_list) {
+			replay.viewport = *(const struct gxm_trace_viewport *)payload;
+			replay.viewport_set = 1;
+		}
+		set_viewport(payload);
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+static int replay_trace(void)
+{
+	const struct gxm_trace_header *header = (const void *)replay.data;
+	size_t offset = sizeof(*header), released = 0;
+	unsigned int release_frame = RELEASE_INTERVAL;
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	if (replay.size < sizeof(*header) ||
+	    memcmp(header->magic, GXM_TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->version != GXM_TRACE_VERSION) {
+		fprintf(stderr, "Not a version %u GXM trace\n", GXM_TRACE_VERSION);
+		return -1;
+	}
+
+	replay.frame_start_ns = time_get_ns();
+
+	while (offset + sizeof(struct gxm_trace_record) <= replay.size) {
+		const struct gxm_trace_record *record = (const void *)(replay.data + offset);
+		uint64_t start;
+		int ret;
+
+		if (record->size > replay.size - offset - sizeof(*record) ||
+		    record->type >= GXM_TRACE_RECORD_TYPE_COUNT) {
+			fprintf(stderr, "Corrupt record at offset %zu\n", offset);
+			return -1;
+		}
+
+		start = time_get_ns();
+		ret = replay_record(record->type, record + 1);
+		replay.record_stats[record->type].ns += time_get_ns() - start;
+		replay.record_stats[record->type].count++;
+
+		if (ret < 0) {
+			fprintf(stderr, "Replaying %s record at offset %zu failed (0x%08X)\n",
+				record_names[record->type], offset, ret);
+			return -1;
+		}
+
+		offset += sizeof(*record) + record->size;
+
+		/*
+		 * Blobs are referenced long after they were read (programs and
+		 * static meshes are only stored once), so replayed pages are
+		 * only dropped from memory: they are read back from the
+		 * file if they are used again.
+		 */
+		if (replay.frames == release_frame) {
+			size_t end = offset & ~(size_t)(page_size - 1);
+
+			if (end > released)
+				madvise((void *)(replay.data + released), end - released,
+					MADV_DONTNEED);
+			released = end;
+			release_frame += RELEASE_INTERVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void print_stats(void)
+{
+	unsigned int i;
+
+	printf("%-26s %10s %12s %10s\n", "record", "count", "total ms", "avg us");
+	for (i = 0; i < GXM_TRACE_RECORD_TYPE_COUNT; i++) {
+		const struct record_stats *stats = &replay.record_stats[i];
+
+		if (!stats->count)
+			continue;
+
+		printf("%-26s %10u %12.3f %10.3f\n", record_names[i], stats->count,
+			time_ns_to_ms(stats->ns), time_ns_to_ms(stats->ns) * 1000.0f / stats->count);
+	}
+
+	if (replay.frames)
+		printf("%u frames: avg %.3f ms, min %.3f ms, max %.3f ms\n", replay.frames,
+			replay.frame_total_ms / replay.frames, replay.frame_min_ms,
+			replay.frame_max_ms);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = NULL;
+	struct stat st;
+	int i, fd, ret;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-v") == 0)
+			replay.verbose = 1;
+		else
+			path = argv[i];
+	}
+
+	if (!path) {
+		fprintf(stderr, "usage: %s [-v] trace\n", argv[0]);
+		return 1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return 1;
+	}
+
+	replay.size = st.st_size;
+	replay.data = mmap(NULL, replay.size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (replay.data == MAP_FAILED) {
+		fprintf(stderr, "Could not map %s\n", path);
+		return 1;
+	}
+	madvise((void *)replay.data, replay.size, MADV_SEQUENTIAL);
+
+	if (gxm_init() < 0) {
+		fprintf(stderr, "Could not initialize GXM\n");
+		return 1;
+	}
+
+	ret = replay_trace();
+	print_stats();
+
+	gxm_finish();
+	munmap((void *)replay.data, replay.size);
+
+	return ret < 0 ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * Job system stress test and scaling benchmark.
+ *
+ * Runs the same transform + per-view culling/packet workload the frame loop
+ * uses over a large object count with 1 to N threads, checks that every
+ * thread count produces bit-identical results and reports the speedup.
+ *
+ * Usage: job_bench [max_threads] [object_count] [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math_utils.h"
+#include "job_system.h"
+#include "time_utils.h"
+
+#define VIEW_COUNT 2
+#define OBJECTS_PER_JOB 64
+
+struct object {
+	vector3f translation;
+	vector3f rotation;
+	matrix4x4 model_matrix;
+	vector3f world_center;
+};
+
+struct packet {
+	int visible;
+	matrix4x4 mvp_matrix;
+	matrix3x3 normal_matrix;
+};
+
+struct view {
+	const struct object *objects;
+	matrix4x4 view_matrix;
+	matrix4x4 view_projection_matrix;
+	vector4f frustum_planes[6];
+	struct packet *packets;
+};
+
+static void update_transforms(void *data, unsigned int start, unsigned int count)
+{
+	struct object *objects = data;
+	static const vector3f origin = {.x = 0.0f, .y = 0.0f, .z = 0.0f};
+	unsigned int i;
+
+	for (i = start; i < start + count; i++) {
+		matrix4x4_build_model_matrix(objects[i].model_matrix,
+			&objects[i].translation, &objects[i].rotation);
+		vector3f_matrix4x4_mult(&objects[i].world_center,
+			objects[i].model_matrix, &origin, 1.0f);
+	}
+}
+
+static void prepare_packets(void *data, unsigned int start, unsigned int count)
+{
+	struct view *view = data;
+	unsigned int i;
+
+	for (i = start; i < start + count; i++) {
+		const struct object *object = &view->objects[i];
+		struct packet *packet = &view->packets[i];
+		matrix4x4 modelview_matrix;
+
+		packet->visible = frustum_planes_test_sphere(view->frustum_planes,
+			&object->world_center, 1.0f);
+		if (!packet->visible)
+			continue;
+
+		matrix4x4_multiply(modelview_matrix, view->view_matrix, object->model_matrix);
+		matrix4x4_multiply(packet->mvp_matrix, view->view_projection_matrix, object->model_matrix);
+		matrix3x3_normal_matrix(packet->normal_matrix, modelview_matrix);
+	}
+}
+
+static void run_frame(struct object *objects, struct view *views, unsigned int count,
+	unsigned int granularity)
+{
+	struct job *transforms_job;
+	struct job *view_jobs[VIEW_COUNT];
+	int i;
+
+	transforms_job = job_parallel_for(update_transforms, objects, count, granularity);
+
+	for (i = 0; i < VIEW_COUNT; i++) {
+		view_jobs[i] = job_parallel_for(prepare_packets, &views[i], count, granularity);
+		job_add_dependency(view_jobs[i], transforms_job);
+		job_run(view_jobs[i]);
+	}
+
+	job_run(transforms_job);
+
+	for (i = 0; i < VIEW_COUNT; i++)
+		job_wait(view_jobs[i]);
+}
+
+static unsigned int checksum(const struct view *views, unsigned int count)
+{
+	unsigned int hash = 2166136261u;
+	unsigned int i, j;
+
+	for (i = 0; i < VIEW_COUNT; i++) {
+		for (j = 0; j < count; j++) {
+			const struct packet *packet = &views[i].packets[j];
+			const unsigned char *bytes;
+			size_t k;
+
+			hash = (hash ^ packet->visible) * 16777619u;
+			if (!packet->visible)
+				continue;
+
+			bytes = (const unsigned char *)packet->mvp_matrix;
+			for (k = 0; k < sizeof(packet->mvp_matrix) + sizeof(packet->normal_matrix); k++)
+				hash = (hash ^ bytes[k]) * 16777619u;
+		}
+	}
+
+	return hash;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int max_threads = argc > 1 ? atoi(argv[1]) : 0;
+	unsigned int count = argc > 2 ? atoi(argv[2]) : 100000;
+	unsigned int iterations = argc > 3 ? atoi(argv[3]) : 20;
+	unsigned int threads, i, iteration;
+	unsigned int reference = 0;
+	float single_thread_ms = 0.0f;
+	int failed = 0;
+
+	if (max_threads == 0)
+		max_threads = job_system_get_default_thread_count();
+	if (max_threads > JOB_SYSTEM_MAX_THREADS)
+		max_threads = JOB_SYSTEM_MAX_THREADS;
+
+	struct object *objects = malloc(count * sizeof(*objects));
+	struct view views[VIEW_COUNT];
+	matrix4x4 projection_matrix;
+
+	matrix4x4_init_perspective(projection_matrix, 90.0f, 960.0f / 544.0f, 0.01f, 100.0f);
+
+	srand(1234);
+	for (i = 0; i < count; i++) {
+		vector3f_init(&objects[i].translation, (rand() % 2000) / 20.0f - 50.0f,
+			(rand() % 200) / 20.0f, (rand() % 2000) / 20.0f - 50.0f);
+		vector3f_init(&objects[i].rotation, (rand() % 628) / 100.0f,
+			(rand() % 628) / 100.0f, 0.0f);
+	}
+
+	for (i = 0; i < VIEW_COUNT; i++) {
+		struct camera_setup { vector3f translation, rotation; } cameras[VIEW_COUNT] = {
+			{{.x = 0.0f, .y = 3.0f, .z = 5.0f}, {.x = 0.0f, .y = 0.0f, .z = 0.0f}},
+			{{.x = 10.0f, .y = 2.0f, .z = -5.0f}, {.x = 0.0f, .y = 2.0f, .z = 0.0f}},
+		};
+		matrix4x4 camera_model;
+
+		views[i].objects = objects;
+		views[i].packets = malloc(count * sizeof(struct packet));
+		matrix4x4_build_model_matrix(camera_model, &cameras[i].translation, &cameras[i].rotation);
+		matrix4x4_invert(views[i].view_matrix, camera_model);
+		matrix4x4_multiply(views[i].view_projection_matrix, projection_matrix, views[i].view_matrix);
+		matrix4x4_frustum_planes(views[i].frustum_planes, views[i].view_projection_matrix);
+	}
+
+	printf("%u objects, %u views, %u iterations\n", count, VIEW_COUNT, iterations);
+	printf("threads    frame ms   speedup  efficiency\n");
+
+	for (threads = 1; threads <= max_threads; threads++) {
+		uint64_t start, elapsed;
+		unsigned int sum;
+		float ms;
+
+		if (job_system_init(threads) < 0) {
+			fprintf(stderr, "job_system_init(%u) failed\n", threads);
+			return 1;
+		}
+
+		/* Stress the deques with single object jobs first */
+		for (iteration = 0; iteration < 4; iteration++) {
+			for (i = 0; i < VIEW_COUNT; i++)
+				memset(views[i].packets, 0, count * sizeof(struct packet));
+			run_frame(objects, views, count, 1);
+
+			sum = checksum(views, count);
+			if (threads == 1 && iteration == 0)
+				reference = sum;
+			if (sum != reference) {
+				fprintf(stderr, "%u threads: checksum mismatch (granularity 1)\n", threads);
+				failed = 1;
+			}
+		}
+
+		start = time_get_ns();
+		for (iteration = 0; iteration < iterations; iteration++)
+			run_frame(objects, views, count, OBJECTS_PER_JOB);
+		elapsed = time_get_ns() - start;
+
+		if (checksum(views, count) != reference) {
+			fprintf(stderr, "%u threads: checksum mismatch\n", threads);
+			failed = 1;
+		}
+
+		job_system_finish();
+
+		ms = time_ns_to_ms(elapsed) / iterations;
+		if (threads == 1)
+			single_thread_ms = ms;
+
+		printf("%7u %10.3f %9.2fx %10.0f%%\n", threads, ms, single_thread_ms / ms,
+			100.0f * single_thread_ms / (ms * threads));
+	}
+
+	for (i = 0; i < VIEW_COUNT; i++)
+		free(views[i].packets);
+	free(objects);
+
+	return failed;
+}
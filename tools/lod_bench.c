@@ -0,0 +1,237 @@
+/*
+ * Mesh simplifier benchmark.
+ *
+ * Builds a chain of levels of detail for a tessellated sphere, halving
+ * the triangles at each level, and reports the time, the triangle count
+ * and the geometric error of each level. Also checks that a flat grid
+ * collapses to a couple of triangles without moving its outline and that
+ * a cube with one normal per face is left untouched.
+ *
+ * Usage: lod_bench [sphere_rings] [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math_utils.h"
+#include "mesh_simplify.h"
+#include "time_utils.h"
+
+#define LOD_COUNT 6
+
+struct vertex {
+	vector3f position;
+	vector3f normal;
+};
+
+static unsigned int make_sphere(struct vertex *vertices, unsigned short *indices,
+	unsigned int rings, unsigned int *index_count)
+{
+	unsigned int segments = rings * 2;
+	unsigned int count = 0;
+	unsigned int r, s;
+
+	for (r = 0; r <= rings; r++) {
+		float theta = M_PI * r / rings;
+
+		for (s = 0; s <= segments; s++) {
+			float phi = 2.0f * M_PI * (s % segments) / segments;
+			struct vertex *v = &vertices[r * (segments + 1) + s];
+
+			/* The seam and the poles share positions */
+			vector3f_init(&v->normal, sinf(theta) * cosf(phi), cosf(theta),
+				sinf(theta) * sinf(phi));
+			if (r == 0 || r == rings)
+				vector3f_init(&v->normal, 0.0f, r ? -1.0f : 1.0f, 0.0f);
+			v->position = v->normal;
+		}
+	}
+
+	for (r = 0; r < rings; r++) {
+		for (s = 0; s < segments; s++) {
+			unsigned short a = r * (segments + 1) + s;
+			unsigned short b = a + segments + 1;
+
+			if (r != 0) {
+				indices[count++] = a;
+				indices[count++] = b;
+				indices[count++] = a + 1;
+			}
+			if (r != rings - 1) {
+				indices[count++] = a + 1;
+				indices[count++] = b;
+				indices[count++] = b + 1;
+			}
+		}
+	}
+
+	*index_count = count;
+
+	return (rings + 1) * (segments + 1);
+}
+
+static unsigned int make_grid(struct vertex *vertices, unsigned short *indices,
+	unsigned int size, unsigned int *index_count)
+{
+	unsigned int count = 0;
+	unsigned int x, z;
+
+	for (z = 0; z <= size; z++) {
+		for (x = 0; x <= size; x++) {
+			struct vertex *v = &vertices[z * (size + 1) + x];
+
+			vector3f_init(&v->position, (float)x / size, 0.0f, (float)z / size);
+			vector3f_init(&v->normal, 0.0f, 1.0f, 0.0f);
+		}
+	}
+
+	for (z = 0; z < size; z++) {
+		for (x = 0; x < size; x++) {
+			unsigned short a = z * (size + 1) + x;
+			unsigned short b = a + size + 1;
+
+			indices[count++] = a;
+			indices[count++] = b;
+			indices[count++] = a + 1;
+			indices[count++] = a + 1;
+			indices[count++] = b;
+			indices[count++] = b + 1;
+		}
+	}
+
+	*index_count = count;
+
+	return (size + 1) * (size + 1);
+}
+
+static unsigned int make_cube(struct vertex *vertices, unsigned short *indices,
+	unsigned int *index_count)
+{
+	unsigned int face, i;
+
+	for (face = 0; face < 6; face++) {
+		int axis = face % 3;
+		float sign = face < 3 ? 1.0f : -1.0f;
+
+		for (i = 0; i < 4; i++) {
+			float c[3], n[3] = {0.0f, 0.0f, 0.0f};
+
+			c[axis] = sign;
+			c[(axis + 1) % 3] = (i & 1) ? 1.0f : -1.0f;
+			c[(axis + 2) % 3] = (i & 2) ? 1.0f : -1.0f;
+			n[axis] = sign;
+			vector3f_init(&vertices[face * 4 + i].position, c[0], c[1], c[2]);
+			vector3f_init(&vertices[face * 4 + i].normal, n[0], n[1], n[2]);
+		}
+
+		indices[face * 6 + 0] = face * 4 + 0;
+		indices[face * 6 + 1] = face * 4 + 1;
+		indices[face * 6 + 2] = face * 4 + 2;
+		indices[face * 6 + 3] = face * 4 + 2;
+		indices[face * 6 + 4] = face * 4 + 1;
+		indices[face * 6 + 5] = face * 4 + 3;
+	}
+
+	*index_count = 36;
+
+	return 24;
+}
+
+static int check_grid(void)
+{
+	static struct vertex vertices[33 * 33];
+	static unsigned short indices[32 * 32 * 6];
+	unsigned int index_count, i;
+	unsigned int vertex_count = make_grid(vertices, indices, 32, &index_count);
+	float error;
+	int count;
+
+	count = mesh_simplify(indices, indices, index_count, vertices, vertex_count,
+		sizeof(*vertices), 0, 1e-4f, &error);
+
+	/* The corners are the only vertices left */
+	for (i = 0; i < (unsigned int)count; i++) {
+		const vector3f *p = &vertices[indices[i]].position;
+
+		if ((p->x != 0.0f && p->x != 1.0f) || (p->z != 0.0f && p->z != 1.0f))
+			break;
+	}
+
+	printf("grid: %u -> %d triangles, error %g: %s\n", index_count / 3, count / 3, error,
+		count == 6 && i == (unsigned int)count ? "ok" : "FAILED");
+
+	return count == 6 && i == (unsigned int)count;
+}
+
+static int check_cube(void)
+{
+	struct vertex vertices[24];
+	unsigned short indices[36];
+	unsigned int index_count;
+	unsigned int vertex_count = make_cube(vertices, indices, &index_count);
+	int count;
+
+	count = mesh_simplify(indices, indices, index_count, vertices, vertex_count,
+		sizeof(*vertices), 0, 10.0f, NULL);
+
+	printf("cube: %u -> %d triangles: %s\n", index_count / 3, count / 3,
+		count == 36 ? "ok" : "FAILED");
+
+	return count == 36;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int rings = argc > 1 ? strtoul(argv[1], NULL, 0) : 96;
+	unsigned int iterations = argc > 2 ? strtoul(argv[2], NULL, 0) : 5;
+	unsigned int max_vertices = (rings + 1) * (rings * 2 + 1);
+	unsigned int index_count, vertex_count, lod, i;
+	struct vertex *vertices;
+	unsigned short *lods[LOD_COUNT];
+	int ok = 1;
+
+	if (!rings || max_vertices > 65536) {
+		fprintf(stderr, "sphere_rings must be 1 to 180\n");
+		return 1;
+	}
+
+	vertices = malloc(max_vertices * sizeof(*vertices));
+	for (lod = 0; lod < LOD_COUNT; lod++)
+		lods[lod] = malloc(rings * rings * 2 * 6 * sizeof(unsigned short));
+
+	vertex_count = make_sphere(vertices, lods[0], rings, &index_count);
+	printf("sphere: %u vertices, %u triangles, %u iterations\n",
+		vertex_count, index_count / 3, iterations);
+
+	for (lod = 1; lod < LOD_COUNT; lod++) {
+		unsigned int previous_count = index_count;
+		uint64_t total_ns = 0;
+		float error = 0.0f;
+		int count = 0;
+
+		for (i = 0; i < iterations; i++) {
+			uint64_t start = time_get_ns();
+
+			count = mesh_simplify(lods[lod], lods[lod - 1], previous_count, vertices,
+				vertex_count, sizeof(*vertices), previous_count / 2, 1.0f, &error);
+			total_ns += time_get_ns() - start;
+		}
+
+		if (count < 0) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+
+		index_count = count;
+		printf("lod %u: %6u triangles, error %.5f, %.3f ms\n", lod, index_count / 3,
+			error, time_ns_to_ms(total_ns) / iterations);
+	}
+
+	ok &= check_grid();
+	ok &= check_cube();
+
+	for (lod = 0; lod < LOD_COUNT; lod++)
+		free(lods[lod]);
+	free(vertices);
+
+	return ok ? 0 : 1;
+}
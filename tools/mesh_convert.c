@@ -0,0 +1,1381 @@
+/*
+ * Mesh converter.
+ *
+ * Converts a Wavefront OBJ or glTF 2.0 (.gltf or .glb) model to the
+ * binary mesh file of include/mesh_file.h: a triangle list over welded
+ * position, normal and color vertices, its bounds, and a chain of levels
+ * of detail built with the simplifier and the limits the demo uses, so
+ * loading it does no work per vertex.
+ *
+ * OBJ: v (with an optional r g b after the position), vn and f lines,
+ * polygons are split into fans. glTF: the triangle, strip and fan
+ * primitives of the meshes of the default scene, with their node
+ * transforms (every mesh untransformed if there is no scene), from
+ * POSITION, NORMAL and COLOR_0. Materials, textures and sparse accessors
+ * are ignored. Missing normals are smoothed over the triangles sharing a
+ * position, missing colors are --color.
+ *
+ * Usage: mesh_convert [options] input output
+ *   --color=R,G,B[,A]  color of the vertices without one (0.8,0.8,0.8,1)
+ *   --fit=SIZE         center the mesh and scale its largest side to SIZE
+ *   --lods=N           levels of detail, the full mesh included (1 to 4, 4)
+ *   --lod-error=F      error of a level over the bounding radius (0.05)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mesh_file.h"
+#include "mesh_simplify.h"
+
+#define LOD_MIN_REDUCTION 0.8f
+#define JSON_MAX_DEPTH 64
+#define GLTF_MAX_NODE_DEPTH 64
+
+/* MESH_FILE_VERTEX_POSITION_NORMAL_COLOR */
+struct vertex {
+	float position[3];
+	float normal[3];
+	float color[4];
+};
+
+/* Three corners per triangle, a zero normal where the input has none */
+struct soup {
+	struct vertex *corners;
+	unsigned int count;
+	unsigned int capacity;
+};
+
+struct settings {
+	float color[4];
+	float fit_size;
+	unsigned int lod_count;
+	float lod_error;
+};
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p && size) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	return p;
+}
+
+static void soup_add(struct soup *soup, const struct vertex *corner)
+{
+	if (soup->count == soup->capacity) {
+		soup->capacity = soup->capacity ? soup->capacity * 2 : 1024;
+		soup->corners = xrealloc(soup->corners, soup->capacity * sizeof(*soup->corners));
+	}
+
+	soup->corners[soup->count++] = *corner;
+}
+
+/* NUL terminated contents of the file */
+static char *read_file(const char *path, size_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	char *data;
+	long end;
+
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return NULL;
+	}
+
+	if (fseek(file, 0, SEEK_END) != 0 || (end = ftell(file)) < 0 ||
+	    fseek(file, 0, SEEK_SET) != 0) {
+		fclose(file);
+		return NULL;
+	}
+
+	data = xrealloc(NULL, end + 1);
+	if (fread(data, 1, end, file) != (size_t)end) {
+		fprintf(stderr, "Could not read %s\n", path);
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+
+	fclose(file);
+	data[end] = '\0';
+	*size = end;
+
+	return data;
+}
+
+/* OBJ */
+
+struct float_array {
+	float *values;
+	unsigned int count;
+	unsigned int capacity;
+};
+
+static void float_array_add(struct float_array *array, const float *values, unsigned int count)
+{
+	while (array->count + count > array->capacity) {
+		array->capacity = array->capacity ? array->capacity * 2 : 1024;
+		array->values = xrealloc(array->values, array->capacity * sizeof(*array->values));
+	}
+
+	memcpy(array->values + array->count, values, count * sizeof(*values));
+	array->count += count;
+}
+
+/* 1-based, negative counts back from the last element; -1 if out of range */
+static long obj_index(long index, unsigned int count)
+{
+	if (index < 0)
+		index += count;
+	else
+		index--;
+
+	return index >= 0 && index < (long)count ? index : -1;
+}
+
+static int obj_corner(const char *token, const struct float_array *positions,
+	const struct float_array *colors, const struct float_array *normals,
+	const struct settings *settings, struct vertex *corner)
+{
+	long position, normal = 0;
+	char *end;
+
+	position = obj_index(strtol(token, &end, 10), positions->count / 3);
+	if (end == token || position < 0)
+		return -1;
+
+	/* v, v/vt, v//vn or v/vt/vn */
+	if (*end == '/') {
+		end = strchr(end + 1, '/');
+		if (end) {
+			const char *start = end + 1;
+
+			normal = strtol(start, &end, 10);
+			if (end != start && (normal = obj_index(normal, normals->count / 3) + 1) == 0)
+				return -1;
+		}
+	}
+
+	memcpy(corner->position, &positions->values[position * 3], sizeof(corner->position));
+	memcpy(corner->color, &colors->values[position * 4], sizeof(corner->color));
+	if (normal)
+		memcpy(corner->normal, &normals->values[(normal - 1) * 3], sizeof(corner->normal));
+	else
+		memset(corner->normal, 0, sizeof(corner->normal));
+
+	return 0;
+}
+
+static int load_obj(const char *path, const struct settings *settings, struct soup *soup)
+{
+	struct float_array positions = {NULL, 0, 0};
+	struct float_array colors = {NULL, 0, 0};
+	struct float_array normals = {NULL, 0, 0};
+	unsigned int line_number = 0;
+	char *data, *line, *next;
+	size_t size;
+	int ret = 0;
+
+	data = read_file(path, &size);
+	if (!data)
+		return -1;
+
+	for (line = data; line && ret == 0; line = next) {
+		float values[6];
+		int count;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		line_number++;
+
+		while (*line == ' ' || *line == '\t')
+			line++;
+
+		if (strncmp(line, "v ", 2) == 0) {
+			float color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+			count = sscanf(line + 2, "%f %f %f %f %f %f", &values[0], &values[1],
+				&values[2], &values[3], &values[4], &values[5]);
+			if (count < 3) {
+				fprintf(stderr, "%s:%u: expected a position\n", path, line_number);
+				ret = -1;
+			}
+			float_array_add(&positions, values, 3);
+			if (count == 6)
+				memcpy(color, &values[3], 3 * sizeof(float));
+			else
+				memcpy(color, settings->color, sizeof(color));
+			float_array_add(&colors, color, 4);
+		} else if (strncmp(line, "vn ", 3) == 0) {
+			if (sscanf(line + 3, "%f %f %f", &values[0], &values[1], &values[2]) != 3) {
+				fprintf(stderr, "%s:%u: expected a normal\n", path, line_number);
+				ret = -1;
+			}
+			float_array_add(&normals, values, 3);
+		} else if (strncmp(line, "f ", 2) == 0) {
+			struct vertex first, previous, corner;
+			char *token, *save;
+
+			count = 0;
+			for (token = strtok_r(line + 2, " \t\r", &save); token;
+			     token = strtok_r(NULL, " \t\r", &save)) {
+				if (obj_corner(token, &positions, &colors, &normals, settings,
+				    &corner) < 0) {
+					fprintf(stderr, "%s:%u: bad face corner %s\n", path, line_number,
+						token);
+					ret = -1;
+					break;
+				}
+
+				if (count == 0) {
+					first = corner;
+				} else if (count >= 2) {
+					soup_add(soup, &first);
+					soup_add(soup, &previous);
+					soup_add(soup, &corner);
+				}
+				previous = corner;
+				count++;
+			}
+		}
+	}
+
+	free(positions.values);
+	free(colors.values);
+	free(normals.values);
+	free(data);
+
+	return ret;
+}
+
+/* JSON, enough for glTF */
+
+enum json_type {
+	JSON_NULL,
+	JSON_BOOL,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_ARRAY,
+	JSON_OBJECT
+};
+
+struct json {
+	enum json_type type;
+	double number;
+	char *string;
+	/* Name of the member, in an object */
+	char *key;
+	struct json *items;
+	unsigned int count;
+};
+
+static void json_free(struct json *value)
+{
+	unsigned int i;
+
+	for (i = 0; i < value->count; i++)
+		json_free(&value->items[i]);
+	free(value->items);
+	free(value->string);
+	free(value->key);
+}
+
+static const char *json_skip_space(const char *p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+		p++;
+
+	return p;
+}
+
+static void put_utf8(char *out, unsigned int *length, unsigned int code)
+{
+	if (code < 0x80) {
+		out[(*length)++] = code;
+	} else if (code < 0x800) {
+		out[(*length)++] = 0xC0 | (code >> 6);
+		out[(*length)++] = 0x80 | (code & 0x3F);
+	} else {
+		out[(*length)++] = 0xE0 | (code >> 12);
+		out[(*length)++] = 0x80 | ((code >> 6) & 0x3F);
+		out[(*length)++] = 0x80 | (code & 0x3F);
+	}
+}
+
+static const char *json_parse_string(const char *p, char **string)
+{
+	unsigned int length = 0;
+	const char *start = ++p;
+	char *out;
+
+	/* Escapes only shrink the string */
+	while (*p && *p != '"')
+		p += *p == '\\' && p[1] ? 2 : 1;
+	if (*p != '"')
+		return NULL;
+
+	out = xrealloc(NULL, p - start + 1);
+	for (p = start; *p != '"'; p++) {
+		unsigned int code;
+
+		if (*p != '\\') {
+			out[length++] = *p;
+			continue;
+		}
+
+		switch (*++p) {
+		case 'b': out[length++] = '\b'; break;
+		case 'f': out[length++] = '\f'; break;
+		case 'n': out[length++] = '\n'; break;
+		case 'r': out[length++] = '\r'; break;
+		case 't': out[length++] = '\t'; break;
+		case 'u':
+			if (sscanf(p + 1, "%4x", &code) != 1) {
+				free(out);
+				return NULL;
+			}
+			put_utf8(out, &length, code);
+			p += 4;
+			break;
+		default:
+			out[length++] = *p;
+			break;
+		}
+	}
+
+	out[length] = '\0';
+	*string = out;
+
+	return p + 1;
+}
+
+static const char *json_parse_value(const char *p, struct json *value, unsigned int depth);
+
+static const char *json_parse_items(const char *p, struct json *value, char end,
+	unsigned int depth)
+{
+	unsigned int capacity = 0;
+
+	p = json_skip_space(p + 1);
+	if (*p == end)
+		return p + 1;
+
+	for (;;) {
+		struct json *item;
+		char *key = NULL;
+
+		if (value->count == capacity) {
+			capacity = capacity ? capacity * 2 : 8;
+			value->items = xrealloc(value->items, capacity * sizeof(*value->items));
+		}
+		item = &value->items[value->count];
+
+		if (value->type == JSON_OBJECT) {
+			if (*p != '"' || !(p = json_parse_string(p, &key)))
+				return NULL;
+			p = json_skip_space(p);
+			if (*p++ != ':') {
+				free(key);
+				return NULL;
+			}
+		}
+
+		p = json_parse_value(json_skip_space(p), item, depth + 1);
+		item->key = key;
+		value->count++;
+		if (!p)
+			return NULL;
+
+		p = json_skip_space(p);
+		if (*p == end)
+			return p + 1;
+		if (*p++ != ',')
+			return NULL;
+		p = json_skip_space(p);
+	}
+}
+
+static const char *json_parse_value(const char *p, struct json *value, unsigned int depth)
+{
+	char *end;
+
+	memset(value, 0, sizeof(*value));
+
+	if (depth > JSON_MAX_DEPTH)
+		return NULL;
+
+	switch (*p) {
+	case '{':
+		value->type = JSON_OBJECT;
+		return json_parse_items(p, value, '}', depth);
+	case '[':
+		value->type = JSON_ARRAY;
+		return json_parse_items(p, value, ']', depth);
+	case '"':
+		value->type = JSON_STRING;
+		return json_parse_string(p, &value->string);
+	case 't':
+		value->type = JSON_BOOL;
+		value->number = 1.0;
+		return strncmp(p, "true", 4) == 0 ? p + 4 : NULL;
+	case 'f':
+		value->type = JSON_BOOL;
+		return strncmp(p, "false", 5) == 0 ? p + 5 : NULL;
+	case 'n':
+		return strncmp(p, "null", 4) == 0 ? p + 4 : NULL;
+	default:
+		value->type = JSON_NUMBER;
+		value->number = strtod(p, &end);
+		return end != p ? end : NULL;
+	}
+}
+
+static const struct json *json_get(const struct json *object, const char *key)
+{
+	unsigned int i;
+
+	if (!object || object->type != JSON_OBJECT)
+		return NULL;
+
+	for (i = 0; i < object->count; i++) {
+		if (strcmp(object->items[i].key, key) == 0)
+			return &object->items[i];
+	}
+
+	return NULL;
+}
+
+static const struct json *json_at(const struct json *array, long index)
+{
+	if (!array || array->type != JSON_ARRAY || index < 0 || index >= (long)array->count)
+		return NULL;
+
+	return &array->items[index];
+}
+
+static double json_number(const struct json *value, double fallback)
+{
+	return value && (value->type == JSON_NUMBER || value->type == JSON_BOOL) ?
+		value->number : fallback;
+}
+
+static long json_int(const struct json *object, const char *key, long fallback)
+{
+	return (long)json_number(json_get(object, key), fallback);
+}
+
+static const char *json_string(const struct json *object, const char *key)
+{
+	const struct json *value = json_get(object, key);
+
+	return value && value->type == JSON_STRING ? value->string : NULL;
+}
+
+/* glTF */
+
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+
+#define GLTF_BYTE 5120
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_SHORT 5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+
+#define GLTF_TRIANGLES 4
+#define GLTF_TRIANGLE_STRIP 5
+#define GLTF_TRIANGLE_FAN 6
+
+struct gltf_buffer {
+	unsigned char *data;
+	size_t size;
+	/* The GLB binary chunk is owned by the file data */
+	int owned;
+};
+
+struct gltf {
+	const char *path;
+	struct json root;
+	struct gltf_buffer *buffers;
+	unsigned int buffer_count;
+};
+
+/* Column-major, as in glTF */
+typedef float matrix[16];
+
+static void matrix_identity(matrix m)
+{
+	memset(m, 0, sizeof(matrix));
+	m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+static void matrix_multiply(matrix out, const matrix a, const matrix b)
+{
+	matrix result;
+	int row, column, k;
+
+	for (column = 0; column < 4; column++) {
+		for (row = 0; row < 4; row++) {
+			result[column * 4 + row] = 0.0f;
+			for (k = 0; k < 4; k++)
+				result[column * 4 + row] += a[k * 4 + row] * b[column * 4 + k];
+		}
+	}
+
+	memcpy(out, result, sizeof(matrix));
+}
+
+static const unsigned char *base64_table(void)
+{
+	static const char alphabet[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	static unsigned char table[256];
+	int i;
+
+	if (!table['B']) {
+		memset(table, 0xFF, sizeof(table));
+		for (i = 0; i < 64; i++)
+			table[(unsigned char)alphabet[i]] = i;
+	}
+
+	return table;
+}
+
+static unsigned char *base64_decode(const char *text, size_t *size)
+{
+	const unsigned char *table = base64_table();
+	unsigned char *data = xrealloc(NULL, strlen(text) / 4 * 3 + 3);
+	unsigned int bits = 0, count = 0;
+
+	*size = 0;
+	for (; *text && *text != '='; text++) {
+		if (table[(unsigned char)*text] == 0xFF) {
+			free(data);
+			return NULL;
+		}
+		bits = (bits << 6) | table[(unsigned char)*text];
+		count += 6;
+		if (count >= 8) {
+			count -= 8;
+			data[(*size)++] = bits >> count;
+		}
+	}
+
+	return data;
+}
+
+static int gltf_load_buffers(struct gltf *gltf, const unsigned char *bin, size_t bin_size)
+{
+	const struct json *buffers = json_get(&gltf->root, "buffers");
+	unsigned int i;
+
+	gltf->buffer_count = buffers && buffers->type == JSON_ARRAY ? buffers->count : 0;
+	gltf->buffers = xrealloc(NULL, (gltf->buffer_count + 1) * sizeof(*gltf->buffers));
+	memset(gltf->buffers, 0, (gltf->buffer_count + 1) * sizeof(*gltf->buffers));
+
+	for (i = 0; i < gltf->buffer_count; i++) {
+		struct gltf_buffer *buffer = &gltf->buffers[i];
+		const char *uri = json_string(&buffers->items[i], "uri");
+		size_t length = json_int(&buffers->items[i], "byteLength", 0);
+
+		if (!uri) {
+			buffer->data = (unsigned char *)bin;
+			buffer->size = bin_size;
+		} else if (strncmp(uri, "data:", 5) == 0) {
+			const char *comma = strchr(uri, ',');
+
+			buffer->data = comma && strstr(uri, ";base64,") ?
+				base64_decode(comma + 1, &buffer->size) : NULL;
+			buffer->owned = 1;
+		} else {
+			/* Relative to the .gltf */
+			const char *slash = strrchr(gltf->path, '/');
+			size_t directory = slash ? slash - gltf->path + 1 : 0;
+			char *path = xrealloc(NULL, directory + strlen(uri) + 1);
+
+			memcpy(path, gltf->path, directory);
+			strcpy(path + directory, uri);
+			buffer->data = (unsigned char *)read_file(path, &buffer->size);
+			buffer->owned = 1;
+			free(path);
+		}
+
+		if (!buffer->data || buffer->size < length) {
+			fprintf(stderr, "%s: buffer %u is missing or too short\n", gltf->path, i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static unsigned int gltf_type_components(const char *type)
+{
+	if (!type)
+		return 0;
+	if (strcmp(type, "SCALAR") == 0)
+		return 1;
+	if (strcmp(type, "VEC2") == 0)
+		return 2;
+	if (strcmp(type, "VEC3") == 0)
+		return 3;
+	if (strcmp(type, "VEC4") == 0)
+		return 4;
+
+	return 0;
+}
+
+static unsigned int gltf_component_size(long component_type)
+{
+	switch (component_type) {
+	case GLTF_BYTE:
+	case GLTF_UNSIGNED_BYTE:
+		return 1;
+	case GLTF_SHORT:
+	case GLTF_UNSIGNED_SHORT:
+		return 2;
+	case GLTF_UNSIGNED_INT:
+	case GLTF_FLOAT:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+/* A resolved accessor */
+struct gltf_view {
+	const unsigned char *data;
+	unsigned int count;
+	unsigned int components;
+	long component_type;
+	int normalized;
+	size_t stride;
+};
+
+static int gltf_accessor(const struct gltf *gltf, long index, struct gltf_view *view)
+{
+	const struct json *accessor = json_at(json_get(&gltf->root, "accessors"), index);
+	const struct json *buffer_view;
+	const struct gltf_buffer *buffer;
+	size_t offset, length, element_size;
+	long buffer_index;
+
+	if (!accessor || json_get(accessor, "sparse"))
+		return -1;
+
+	view->count = json_int(accessor, "count", 0);
+	view->components = gltf_type_components(json_string(accessor, "type"));
+	view->component_type = json_int(accessor, "componentType", 0);
+	view->normalized = json_number(json_get(accessor, "normalized"), 0.0) != 0.0;
+	element_size = view->components * gltf_component_size(view->component_type);
+	if (!element_size)
+		return -1;
+
+	buffer_view = json_at(json_get(&gltf->root, "bufferViews"),
+		json_int(accessor, "bufferView", -1));
+	if (!buffer_view)
+		return -1;
+
+	buffer_index = json_int(buffer_view, "buffer", -1);
+	if (buffer_index < 0 || buffer_index >= (long)gltf->buffer_count)
+		return -1;
+	buffer = &gltf->buffers[buffer_index];
+
+	offset = json_int(buffer_view, "byteOffset", 0) + json_int(accessor, "byteOffset", 0);
+	length = json_int(buffer_view, "byteLength", 0);
+	view->stride = json_int(buffer_view, "byteStride", 0);
+	if (!view->stride)
+		view->stride = element_size;
+
+	if (view->count && (offset > buffer->size ||
+	    (view->count - 1) * view->stride + element_size > buffer->size - offset ||
+	    (view->count - 1) * view->stride + element_size >
+	    length + json_int(accessor, "byteOffset", 0)))
+		return -1;
+
+	view->data = buffer->data + offset;
+
+	return 0;
+}
+
+static float gltf_component(const struct gltf_view *view, const unsigned char *p)
+{
+	uint16_t u16;
+	int16_t s16;
+	uint32_t u32;
+	float f;
+
+	switch (view->component_type) {
+	case GLTF_BYTE:
+		return view->normalized ? fmaxf(*(const int8_t *)p / 127.0f, -1.0f) :
+			*(const int8_t *)p;
+	case GLTF_UNSIGNED_BYTE:
+		return view->normalized ? *p / 255.0f : *p;
+	case GLTF_SHORT:
+		memcpy(&s16, p, sizeof(s16));
+		return view->normalized ? fmaxf(s16 / 32767.0f, -1.0f) : s16;
+	case GLTF_UNSIGNED_SHORT:
+		memcpy(&u16, p, sizeof(u16));
+		return view->normalized ? u16 / 65535.0f : u16;
+	case GLTF_UNSIGNED_INT:
+		memcpy(&u32, p, sizeof(u32));
+		return u32;
+	default:
+		memcpy(&f, p, sizeof(f));
+		return f;
+	}
+}
+
+static void gltf_element(const struct gltf_view *view, unsigned int index, float *out)
+{
+	const unsigned char *p = view->data + index * view->stride;
+	unsigned int size = gltf_component_size(view->component_type);
+	unsigned int i;
+
+	for (i = 0; i < view->components; i++)
+		out[i] = gltf_component(view, p + i * size);
+}
+
+static uint32_t gltf_index(const struct gltf_view *view, unsigned int index)
+{
+	const unsigned char *p = view->data + index * view->stride;
+	uint16_t u16;
+	uint32_t u32;
+
+	switch (view->component_type) {
+	case GLTF_UNSIGNED_BYTE:
+		return *p;
+	case GLTF_UNSIGNED_SHORT:
+		memcpy(&u16, p, sizeof(u16));
+		return u16;
+	default:
+		memcpy(&u32, p, sizeof(u32));
+		return u32;
+	}
+}
+
+static void transform_corner(struct vertex *corner, const matrix m, const float normal_matrix[9])
+{
+	float p[3], n[3], length;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		p[i] = m[i] * corner->position[0] + m[4 + i] * corner->position[1] +
+			m[8 + i] * corner->position[2] + m[12 + i];
+		n[i] = normal_matrix[i] * corner->normal[0] + normal_matrix[3 + i] * corner->normal[1] +
+			normal_matrix[6 + i] * corner->normal[2];
+	}
+
+	length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	for (i = 0; i < 3; i++) {
+		corner->position[i] = p[i];
+		corner->normal[i] = length > 0.0f ? n[i] / length : 0.0f;
+	}
+}
+
+static int gltf_add_primitive(const struct gltf *gltf, const struct json *primitive,
+	const matrix m, const struct settings *settings, struct soup *soup)
+{
+	const struct json *attributes = json_get(primitive, "attributes");
+	long mode = json_int(primitive, "mode", GLTF_TRIANGLES);
+	struct gltf_view positions, normals, colors, indices;
+	int has_normals, has_colors, has_indices;
+	unsigned int count, triangle_count, t, i;
+	float normal_matrix[9], det;
+
+	if (mode != GLTF_TRIANGLES && mode != GLTF_TRIANGLE_STRIP && mode != GLTF_TRIANGLE_FAN)
+		return 0;
+
+	if (gltf_accessor(gltf, json_int(attributes, "POSITION", -1), &positions) < 0 ||
+	    positions.components != 3) {
+		fprintf(stderr, "%s: primitive without usable positions\n", gltf->path);
+		return -1;
+	}
+	has_normals = gltf_accessor(gltf, json_int(attributes, "NORMAL", -1), &normals) == 0 &&
+		normals.components == 3 && normals.count == positions.count;
+	has_colors = gltf_accessor(gltf, json_int(attributes, "COLOR_0", -1), &colors) == 0 &&
+		colors.components >= 3 && colors.count == positions.count;
+	has_indices = json_get(primitive, "indices") != NULL;
+	if (has_indices && (gltf_accessor(gltf, json_int(primitive, "indices", -1), &indices) < 0 ||
+	    indices.components != 1)) {
+		fprintf(stderr, "%s: primitive with unusable indices\n", gltf->path);
+		return -1;
+	}
+
+	/* Cofactors of the upper 3x3, the inverse transpose up to a scale */
+	for (i = 0; i < 3; i++) {
+		unsigned int a = (i + 1) % 3, b = (i + 2) % 3;
+
+		normal_matrix[i * 3 + 0] = m[a * 4 + 1] * m[b * 4 + 2] - m[a * 4 + 2] * m[b * 4 + 1];
+		normal_matrix[i * 3 + 1] = m[a * 4 + 2] * m[b * 4 + 0] - m[a * 4 + 0] * m[b * 4 + 2];
+		normal_matrix[i * 3 + 2] = m[a * 4 + 0] * m[b * 4 + 1] - m[a * 4 + 1] * m[b * 4 + 0];
+	}
+	det = m[0] * normal_matrix[0] + m[1] * normal_matrix[1] + m[2] * normal_matrix[2];
+	if (det < 0.0f) {
+		for (i = 0; i < 9; i++)
+			normal_matrix[i] = -normal_matrix[i];
+	}
+
+	count = has_indices ? indices.count : positions.count;
+	if (mode == GLTF_TRIANGLES)
+		triangle_count = count / 3;
+	else
+		triangle_count = count >= 3 ? count - 2 : 0;
+
+	for (t = 0; t < triangle_count; t++) {
+		unsigned int corners[3];
+		struct vertex corner[3];
+
+		if (mode == GLTF_TRIANGLES) {
+			corners[0] = t * 3;
+			corners[1] = t * 3 + 1;
+			corners[2] = t * 3 + 2;
+		} else if (mode == GLTF_TRIANGLE_STRIP) {
+			/* Every other triangle of a strip is wound the other way */
+			corners[0] = t + (t & 1);
+			corners[1] = t + 1 - (t & 1);
+			corners[2] = t + 2;
+		} else {
+			corners[0] = 0;
+			corners[1] = t + 1;
+			corners[2] = t + 2;
+		}
+
+		for (i = 0; i < 3; i++) {
+			uint32_t vertex = has_indices ? gltf_index(&indices, corners[i]) : corners[i];
+
+			if (vertex >= positions.count) {
+				fprintf(stderr, "%s: index %u out of range\n", gltf->path, vertex);
+				return -1;
+			}
+
+			gltf_element(&positions, vertex, corner[i].position);
+			if (has_normals)
+				gltf_element(&normals, vertex, corner[i].normal);
+			else
+				memset(corner[i].normal, 0, sizeof(corner[i].normal));
+			memcpy(corner[i].color, settings->color, sizeof(corner[i].color));
+			if (has_colors)
+				gltf_element(&colors, vertex, corner[i].color);
+			transform_corner(&corner[i], m, normal_matrix);
+		}
+
+		/* A mirroring transform flips the winding */
+		soup_add(soup, &corner[0]);
+		soup_add(soup, &corner[det < 0.0f ? 2 : 1]);
+		soup_add(soup, &corner[det < 0.0f ? 1 : 2]);
+	}
+
+	return 0;
+}
+
+static int gltf_add_mesh(const struct gltf *gltf, long index, const matrix m,
+	const struct settings *settings, struct soup *soup)
+{
+	const struct json *mesh = json_at(json_get(&gltf->root, "meshes"), index);
+	const struct json *primitives = json_get(mesh, "primitives");
+	unsigned int i;
+
+	if (!mesh) {
+		fprintf(stderr, "%s: no mesh %ld\n", gltf->path, index);
+		return -1;
+	}
+
+	for (i = 0; primitives && i < primitives->count; i++) {
+		if (gltf_add_primitive(gltf, &primitives->items[i], m, settings, soup) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void node_matrix(const struct json *node, matrix m)
+{
+	const struct json *values = json_get(node, "matrix");
+	float t[3] = {0.0f, 0.0f, 0.0f}, r[4] = {0.0f, 0.0f, 0.0f, 1.0f}, s[3] = {1.0f, 1.0f, 1.0f};
+	float x, y, z, w;
+	int i;
+
+	if (values) {
+		for (i = 0; i < 16; i++)
+			m[i] = json_number(json_at(values, i), i % 5 == 0 ? 1.0 : 0.0);
+		return;
+	}
+
+	for (i = 0; i < 3; i++) {
+		t[i] = json_number(json_at(json_get(node, "translation"), i), t[i]);
+		s[i] = json_number(json_at(json_get(node, "scale"), i), s[i]);
+	}
+	for (i = 0; i < 4; i++)
+		r[i] = json_number(json_at(json_get(node, "rotation"), i), r[i]);
+
+	x = r[0];
+	y = r[1];
+	z = r[2];
+	w = r[3];
+	m[0] = (1.0f - 2.0f * (y * y + z * z)) * s[0];
+	m[1] = (2.0f * (x * y + z * w)) * s[0];
+	m[2] = (2.0f * (x * z - y * w)) * s[0];
+	m[3] = 0.0f;
+	m[4] = (2.0f * (x * y - z * w)) * s[1];
+	m[5] = (1.0f - 2.0f * (x * x + z * z)) * s[1];
+	m[6] = (2.0f * (y * z + x * w)) * s[1];
+	m[7] = 0.0f;
+	m[8] = (2.0f * (x * z + y * w)) * s[2];
+	m[9] = (2.0f * (y * z - x * w)) * s[2];
+	m[10] = (1.0f - 2.0f * (x * x + y * y)) * s[2];
+	m[11] = 0.0f;
+	m[12] = t[0];
+	m[13] = t[1];
+	m[14] = t[2];
+	m[15] = 1.0f;
+}
+
+static int gltf_add_node(const struct gltf *gltf, long index, const matrix parent,
+	const struct settings *settings, struct soup *soup, unsigned int depth)
+{
+	const struct json *node = json_at(json_get(&gltf->root, "nodes"), index);
+	const struct json *children;
+	matrix local, world;
+	unsigned int i;
+
+	if (!node || depth > GLTF_MAX_NODE_DEPTH) {
+		fprintf(stderr, "%s: bad node %ld\n", gltf->path, index);
+		return -1;
+	}
+
+	node_matrix(node, local);
+	matrix_multiply(world, parent, local);
+
+	if (json_get(node, "mesh") &&
+	    gltf_add_mesh(gltf, json_int(node, "mesh", -1), world, settings, soup) < 0)
+		return -1;
+
+	children = json_get(node, "children");
+	for (i = 0; children && i < children->count; i++) {
+		if (gltf_add_node(gltf, (long)json_number(&children->items[i], -1), world,
+		    settings, soup, depth + 1) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static uint32_t read_u32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int load_gltf(const char *path, const struct settings *settings, struct soup *soup)
+{
+	struct gltf gltf;
+	const struct json *scenes, *scene, *nodes, *meshes;
+	const unsigned char *bin = NULL;
+	const char *json_text;
+	char *json_copy = NULL;
+	size_t size, bin_size = 0;
+	unsigned char *data;
+	matrix identity;
+	unsigned int i;
+	int ret = -1;
+
+	memset(&gltf, 0, sizeof(gltf));
+	gltf.path = path;
+
+	data = (unsigned char *)read_file(path, &size);
+	if (!data)
+		return -1;
+	json_text = (const char *)data;
+
+	/* GLB: header, JSON chunk, optional binary chunk */
+	if (size >= 12 && read_u32(data) == GLB_MAGIC) {
+		size_t json_size = size >= 20 ? read_u32(data + 12) : 0;
+
+		if (read_u32(data + 4) != 2 || size < 20 + json_size ||
+		    read_u32(data + 16) != GLB_CHUNK_JSON) {
+			fprintf(stderr, "%s: not a glTF 2.0 binary\n", path);
+			goto out;
+		}
+
+		if (size >= 28 + json_size && read_u32(data + 24 + json_size) == GLB_CHUNK_BIN) {
+			bin_size = read_u32(data + 20 + json_size);
+			bin = data + 28 + json_size;
+			if (bin_size > size - 28 - json_size)
+				goto out;
+		}
+
+		/* The chunk is not terminated */
+		json_copy = xrealloc(NULL, json_size + 1);
+		memcpy(json_copy, data + 20, json_size);
+		json_copy[json_size] = '\0';
+		json_text = json_copy;
+	}
+
+	if (!json_parse_value(json_skip_space(json_text), &gltf.root, 0) ||
+	    gltf.root.type != JSON_OBJECT) {
+		fprintf(stderr, "%s: malformed JSON\n", path);
+		goto out;
+	}
+
+	if (gltf_load_buffers(&gltf, bin, bin_size) < 0)
+		goto out;
+
+	matrix_identity(identity);
+	scenes = json_get(&gltf.root, "scenes");
+	scene = json_at(scenes, json_int(&gltf.root, "scene", 0));
+	if (scene) {
+		nodes = json_get(scene, "nodes");
+		for (i = 0; nodes && i < nodes->count; i++) {
+			if (gltf_add_node(&gltf, (long)json_number(&nodes->items[i], -1), identity,
+			    settings, soup, 0) < 0)
+				goto out;
+		}
+	} else {
+		meshes = json_get(&gltf.root, "meshes");
+		for (i = 0; meshes && i < meshes->count; i++) {
+			if (gltf_add_mesh(&gltf, i, identity, settings, soup) < 0)
+				goto out;
+		}
+	}
+
+	ret = 0;
+
+out:
+	for (i = 0; i < gltf.buffer_count; i++) {
+		if (gltf.buffers[i].owned)
+			free(gltf.buffers[i].data);
+	}
+	free(gltf.buffers);
+	json_free(&gltf.root);
+	free(json_copy);
+	free(data);
+
+	return ret;
+}
+
+/* Welding */
+
+static uint32_t hash_bytes(const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		hash = (hash ^ p[i]) * 16777619u;
+
+	return hash;
+}
+
+/*
+ * Index of the first element equal to each of the count elements of
+ * size bytes (compared over key_size bytes), in remap. Returns the number
+ * of distinct elements, which are moved to the front of data.
+ */
+static unsigned int weld(void *data, unsigned int count, size_t size, size_t key_size,
+	uint32_t *remap)
+{
+	unsigned int capacity = 1, distinct = 0, i;
+	uint32_t *table;
+	char *elements = data;
+
+	while (capacity < count * 2)
+		capacity *= 2;
+	table = xrealloc(NULL, capacity * sizeof(*table));
+	memset(table, 0xFF, capacity * sizeof(*table));
+
+	for (i = 0; i < count; i++) {
+		const char *element = elements + i * size;
+		uint32_t slot = hash_bytes(element, key_size) & (capacity - 1);
+
+		while (table[slot] != UINT32_MAX &&
+		       memcmp(elements + table[slot] * size, element, key_size))
+			slot = (slot + 1) & (capacity - 1);
+
+		if (table[slot] == UINT32_MAX) {
+			memmove(elements + distinct * size, element, size);
+			table[slot] = distinct++;
+		}
+		remap[i] = table[slot];
+	}
+
+	free(table);
+
+	return distinct;
+}
+
+/* Area weighted normals, over the corners at the same position, where missing */
+static void smooth_normals(struct soup *soup)
+{
+	struct vertex *positions = xrealloc(NULL, soup->count * sizeof(*positions));
+	uint32_t *remap = xrealloc(NULL, soup->count * sizeof(*remap));
+	float (*sums)[3];
+	unsigned int i, j, count;
+	int missing = 0;
+
+	for (i = 0; i < soup->count; i++)
+		missing |= !soup->corners[i].normal[0] && !soup->corners[i].normal[1] &&
+			!soup->corners[i].normal[2];
+	if (!missing) {
+		free(positions);
+		free(remap);
+		return;
+	}
+
+	memcpy(positions, soup->corners, soup->count * sizeof(*positions));
+	count = weld(positions, soup->count, sizeof(*positions), sizeof(positions->position), remap);
+	sums = xrealloc(NULL, count * sizeof(*sums));
+	memset(sums, 0, count * sizeof(*sums));
+
+	for (i = 0; i + 2 < soup->count; i += 3) {
+		const float *a = soup->corners[i].position;
+		const float *b = soup->corners[i + 1].position;
+		const float *c = soup->corners[i + 2].position;
+		float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+		float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+		float n[3] = {
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0]
+		};
+
+		for (j = 0; j < 3; j++) {
+			sums[remap[i + j]][0] += n[0];
+			sums[remap[i + j]][1] += n[1];
+			sums[remap[i + j]][2] += n[2];
+		}
+	}
+
+	for (i = 0; i < soup->count; i++) {
+		float *normal = soup->corners[i].normal;
+		const float *sum = sums[remap[i]];
+		float length = sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+
+		if ((normal[0] || normal[1] || normal[2]) || length == 0.0f)
+			continue;
+
+		normal[0] = sum[0] / length;
+		normal[1] = sum[1] / length;
+		normal[2] = sum[2] / length;
+	}
+
+	free(sums);
+	free(remap);
+	free(positions);
+}
+
+static void compute_bounds(const struct vertex *vertices, unsigned int count,
+	struct mesh_file_header *header)
+{
+	unsigned int i, j;
+	float radius = 0.0f;
+
+	for (j = 0; j < 3; j++) {
+		header->bounds_min[j] = INFINITY;
+		header->bounds_max[j] = -INFINITY;
+	}
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < 3; j++) {
+			header->bounds_min[j] = fminf(header->bounds_min[j], vertices[i].position[j]);
+			header->bounds_max[j] = fmaxf(header->bounds_max[j], vertices[i].position[j]);
+		}
+	}
+
+	for (j = 0; j < 3; j++)
+		header->center[j] = (header->bounds_min[j] + header->bounds_max[j]) / 2.0f;
+
+	for (i = 0; i < count; i++) {
+		float d[3];
+
+		for (j = 0; j < 3; j++)
+			d[j] = vertices[i].position[j] - header->center[j];
+		radius = fmaxf(radius, sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+	}
+
+	header->radius = radius;
+}
+
+static void fit(struct vertex *corners, unsigned int count, float size)
+{
+	struct mesh_file_header bounds;
+	float extent = 0.0f, scale;
+	unsigned int i, j;
+
+	compute_bounds(corners, count, &bounds);
+	for (j = 0; j < 3; j++)
+		extent = fmaxf(extent, bounds.bounds_max[j] - bounds.bounds_min[j]);
+	scale = extent > 0.0f ? size / extent : 1.0f;
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < 3; j++)
+			corners[i].position[j] = (corners[i].position[j] - bounds.center[j]) * scale;
+	}
+}
+
+static int parse_color(const char *value, float color[4])
+{
+	color[3] = 1.0f;
+
+	return sscanf(value, "%f,%f,%f,%f", &color[0], &color[1], &color[2], &color[3]) >= 3 ?
+		0 : -1;
+}
+
+static void print_usage(const char *program)
+{
+	fprintf(stderr,
+		"Usage: %s [options] input.obj|input.gltf|input.glb output\n"
+		"  --color=R,G,B[,A]  color of the vertices without one (0.8,0.8,0.8,1)\n"
+		"  --fit=SIZE         center the mesh and scale its largest side to SIZE\n"
+		"  --lods=N           levels of detail, the full mesh included (1 to %u, %u)\n"
+		"  --lod-error=F      error of a level over the bounding radius (0.05)\n",
+		program, MESH_FILE_MAX_LODS, MESH_FILE_MAX_LODS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct settings settings = {{0.8f, 0.8f, 0.8f, 1.0f}, 0.0f, MESH_FILE_MAX_LODS, 0.05f};
+	struct soup soup = {NULL, 0, 0};
+	struct mesh_file_header header;
+	uint16_t *lods[MESH_FILE_MAX_LODS];
+	const char *input = NULL, *output = NULL, *extension;
+	unsigned int vertex_count, i, j;
+	uint32_t *remap;
+	int arg, ret;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp(argv[arg], "--color=", 8) == 0) {
+			if (parse_color(argv[arg] + 8, settings.color) < 0)
+				break;
+		} else if (strncmp(argv[arg], "--fit=", 6) == 0) {
+			settings.fit_size = strtof(argv[arg] + 6, NULL);
+			if (!(settings.fit_size > 0.0f))
+				break;
+		} else if (strncmp(argv[arg], "--lods=", 7) == 0) {
+			settings.lod_count = strtoul(argv[arg] + 7, NULL, 0);
+			if (!settings.lod_count || settings.lod_count > MESH_FILE_MAX_LODS)
+				break;
+		} else if (strncmp(argv[arg], "--lod-error=", 12) == 0) {
+			settings.lod_error = strtof(argv[arg] + 12, NULL);
+			if (!(settings.lod_error > 0.0f))
+				break;
+		} else if (!input) {
+			input = argv[arg];
+		} else if (!output) {
+			output = argv[arg];
+		} else {
+			break;
+		}
+	}
+
+	if (arg < argc || !output) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	extension = strrchr(input, '.');
+	if (extension && strcmp(extension, ".obj") == 0)
+		ret = load_obj(input, &settings, &soup);
+	else if (extension && (strcmp(extension, ".gltf") == 0 || strcmp(extension, ".glb") == 0))
+		ret = load_gltf(input, &settings, &soup);
+	else
+		ret = -1, fprintf(stderr, "%s: expected .obj, .gltf or .glb\n", input);
+
+	if (ret < 0)
+		return 1;
+	if (!soup.count) {
+		fprintf(stderr, "%s: no triangles\n", input);
+		return 1;
+	}
+
+	if (settings.fit_size > 0.0f)
+		fit(soup.corners, soup.count, settings.fit_size);
+	smooth_normals(&soup);
+
+	/* -0.0 and 0.0 must weld */
+	for (i = 0; i < soup.count; i++) {
+		float *values = soup.corners[i].position;
+
+		for (j = 0; j < sizeof(struct vertex) / sizeof(float); j++)
+			values[j] += 0.0f;
+	}
+
+	remap = xrealloc(NULL, soup.count * sizeof(*remap));
+	vertex_count = weld(soup.corners, soup.count, sizeof(struct vertex), sizeof(struct vertex),
+		remap);
+	if (vertex_count > 65536) {
+		fprintf(stderr, "%s: %u vertices, 16-bit indices address 65536, split the mesh\n",
+			input, vertex_count);
+		return 1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.vertex_format = MESH_FILE_VERTEX_POSITION_NORMAL_COLOR;
+	header.vertex_size = sizeof(struct vertex);
+	header.vertex_count = vertex_count;
+	header.primitive = MESH_FILE_PRIMITIVE_TRIANGLES;
+	compute_bounds(soup.corners, vertex_count, &header);
+
+	/* Triangles collapsed by welding, e.g. at the poles of a sphere, are dropped */
+	lods[0] = xrealloc(NULL, soup.count * sizeof(*lods[0]));
+	for (i = 0; i + 2 < soup.count; i += 3) {
+		if (remap[i] == remap[i + 1] || remap[i + 1] == remap[i + 2] ||
+		    remap[i + 2] == remap[i])
+			continue;
+
+		for (j = 0; j < 3; j++)
+			lods[0][header.lods[0].index_count++] = remap[i + j];
+	}
+	if (!header.lods[0].index_count) {
+		fprintf(stderr, "%s: only degenerate triangles\n", input);
+		return 1;
+	}
+	header.lod_count = 1;
+
+	/* Same chain as mesh_build_lods() in the demo */
+	while (header.lod_count < settings.lod_count) {
+		const struct mesh_file_lod *previous = &header.lods[header.lod_count - 1];
+		struct mesh_file_lod *lod = &header.lods[header.lod_count];
+		uint16_t *indices = xrealloc(NULL, previous->index_count * sizeof(*indices));
+		float error;
+		int count;
+
+		count = mesh_simplify(indices, lods[header.lod_count - 1], previous->index_count,
+			soup.corners, vertex_count, sizeof(struct vertex), previous->index_count / 2,
+			header.radius * settings.lod_error, &error);
+		if (count <= 0 || count > previous->index_count * LOD_MIN_REDUCTION) {
+			free(indices);
+			break;
+		}
+
+		lods[header.lod_count] = indices;
+		lod->index_count = count;
+		lod->error = previous->error + error;
+		header.lod_count++;
+	}
+
+	if (mesh_file_write(output, &header, soup.corners, (const uint16_t *const *)lods) < 0) {
+		fprintf(stderr, "Could not write %s\n", output);
+		return 1;
+	}
+
+	printf("%s: %u vertices, radius %g, %u bytes\n", output, vertex_count, header.radius,
+		header.size);
+	for (i = 0; i < header.lod_count; i++) {
+		printf("  lod %u: %u triangles, error %g\n", i, header.lods[i].index_count / 3,
+			header.lods[i].error);
+		free(lods[i]);
+	}
+
+	free(remap);
+	free(soup.corners);
+
+	return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * Mesh generator benchmark.
+ *
+ * Generates each kind of shape at about the largest size 16-bit indices
+ * allow, as many times as it takes to reach a total triangle count (a
+ * million by default), and reports the time per million triangles and
+ * the average number of vertices transformed per triangle with a FIFO
+ * post-transform cache of MESH_GEN_CACHE_SIZE entries, next to the same
+ * for the plane and the sphere with their rows of quads in plain order.
+ * Also checks that each shape's indices are in range and not degenerate,
+ * that every vertex is used and none are duplicates, and that the bounds
+ * hold the vertices.
+ *
+ * Usage: mesh_gen_bench [triangles]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math_utils.h"
+#include "mesh_gen.h"
+#include "time_utils.h"
+
+struct bench_shape {
+	const char *name;
+	enum mesh_gen_format format;
+	struct mesh_gen_shape shape;
+};
+
+static const vector4f face_colors[MESH_GEN_FACE_COUNT] = {
+	{.r = 1.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f},
+	{.r = 0.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f},
+	{.r = 0.0f, .g = 0.0f, .b = 1.0f, .a = 1.0f},
+	{.r = 1.0f, .g = 1.0f, .b = 0.0f, .a = 1.0f},
+	{.r = 0.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f},
+	{.r = 1.0f, .g = 0.0f, .b = 1.0f, .a = 1.0f},
+};
+
+static const struct bench_shape shapes[] = {
+	{"box", MESH_GEN_POSITION_NORMAL_COLOR, {
+		.type = MESH_GEN_BOX, .size = {.x = 1.0f, .y = 2.0f, .z = 3.0f},
+		.segments = {100}, .face_colors = face_colors}},
+	{"box position", MESH_GEN_POSITION, {
+		.type = MESH_GEN_BOX, .size = {.x = 1.0f, .y = 2.0f, .z = 3.0f},
+		.segments = {100}}},
+	{"plane", MESH_GEN_POSITION_NORMAL_COLOR, {
+		.type = MESH_GEN_PLANE, .face = MESH_GEN_FACE_TOP,
+		.size = {.x = 20.0f, .z = 10.0f}, .segments = {255, 255},
+		.color = {.r = 0.5f, .g = 0.5f, .b = 0.5f, .a = 1.0f}}},
+	{"frame", MESH_GEN_POSITION_NORMAL_COLOR, {
+		.type = MESH_GEN_FRAME, .face = MESH_GEN_FACE_BACK,
+		.size = {.x = 4.0f, .y = 3.0f}, .border = 0.2f,
+		.color = {.r = 0.3f, .g = 0.0f, .b = 1.0f, .a = 1.0f}}},
+	{"sphere", MESH_GEN_POSITION_NORMAL_COLOR, {
+		.type = MESH_GEN_SPHERE, .radius = 2.0f,
+		.segments = {MESH_GEN_MAX_SEGMENTS, MESH_GEN_MAX_SEGMENTS},
+		.color = {.r = 0.8f, .g = 0.8f, .b = 0.8f, .a = 1.0f}}},
+	{"grid", MESH_GEN_POSITION_NORMAL_COLOR, {
+		.type = MESH_GEN_GRID, .size = {.x = 1.0f, .y = 1.0f, .z = 1.0f},
+		.segments = {50, 50}, .spacing = 0.5f, .face_colors = face_colors}},
+};
+
+/* Vertices transformed per triangle with a FIFO cache */
+static float cache_misses(const unsigned short *indices, unsigned int index_count,
+	unsigned int vertex_count)
+{
+	unsigned int *stamps = calloc(vertex_count, sizeof(*stamps));
+	unsigned int i, misses = 0;
+
+	/* A vertex is cached if it was missed within the last cache size misses */
+	for (i = 0; i < index_count; i++) {
+		if (!stamps[indices[i]] || misses - stamps[indices[i]] >= MESH_GEN_CACHE_SIZE)
+			stamps[indices[i]] = ++misses;
+	}
+
+	free(stamps);
+
+	return misses / (index_count / 3.0f);
+}
+
+/* The plane's quads, or the sphere's between its caps, row after row */
+static float row_order_misses(const struct mesh_gen_shape *shape, unsigned int vertex_count)
+{
+	unsigned int columns = shape->segments[shape->type == MESH_GEN_SPHERE ? 1 : 0];
+	unsigned int rows = shape->type == MESH_GEN_SPHERE ?
+		shape->segments[0] - 2 : shape->segments[1];
+	unsigned int stride = shape->type == MESH_GEN_SPHERE ? columns : columns + 1;
+	unsigned short *indices = malloc(rows * columns * 6 * sizeof(*indices));
+	unsigned int a, b, count = 0;
+	float misses;
+
+	for (b = 0; b < rows; b++) {
+		for (a = 0; a < columns; a++) {
+			unsigned int next = shape->type == MESH_GEN_SPHERE && a + 1 == columns ? 0 : a + 1;
+			unsigned short v00 = b * stride + a, v10 = b * stride + next;
+
+			indices[count++] = v00;
+			indices[count++] = v10;
+			indices[count++] = v10 + stride;
+			indices[count++] = v00;
+			indices[count++] = v10 + stride;
+			indices[count++] = v00 + stride;
+		}
+	}
+
+	misses = cache_misses(indices, count, vertex_count);
+	free(indices);
+
+	return misses;
+}
+
+static size_t compare_size;
+
+static int compare_vertices(const void *a, const void *b)
+{
+	return memcmp(a, b, compare_size);
+}
+
+static int check(const struct bench_shape *bench, const void *vertices,
+	const unsigned short *indices, const struct mesh_gen_result *result)
+{
+	size_t vertex_size = mesh_gen_vertex_size(bench->format);
+	unsigned char *used = calloc(result->vertex_count, 1);
+	char *sorted = malloc(result->vertex_count * vertex_size);
+	unsigned int i;
+	int ok = 1;
+
+	for (i = 0; i < result->index_count; i += 3) {
+		unsigned short a = indices[i], b = indices[i + 1], c = indices[i + 2];
+
+		if (a >= result->vertex_count || b >= result->vertex_count ||
+		    c >= result->vertex_count || a == b || b == c || a == c) {
+			printf("  triangle %u is degenerate or out of range\n", i / 3);
+			ok = 0;
+			break;
+		}
+		used[a] = used[b] = used[c] = 1;
+	}
+
+	for (i = 0; ok && i < result->vertex_count; i++) {
+		const float *position = (const float *)((const char *)vertices + i * vertex_size);
+		vector3f offset;
+
+		vector3f_init(&offset, position[0] - result->center.x,
+			position[1] - result->center.y, position[2] - result->center.z);
+		if (!used[i]) {
+			printf("  vertex %u is not used\n", i);
+			ok = 0;
+		} else if (position[0] < result->bounds_min.x - 1e-4f ||
+		           position[1] < result->bounds_min.y - 1e-4f ||
+		           position[2] < result->bounds_min.z - 1e-4f ||
+		           position[0] > result->bounds_max.x + 1e-4f ||
+		           position[1] > result->bounds_max.y + 1e-4f ||
+		           position[2] > result->bounds_max.z + 1e-4f ||
+		           vector3f_length(&offset) > result->radius * 1.0001f) {
+			printf("  vertex %u is out of bounds\n", i);
+			ok = 0;
+		}
+	}
+
+	memcpy(sorted, vertices, result->vertex_count * vertex_size);
+	compare_size = vertex_size;
+	qsort(sorted, result->vertex_count, vertex_size, compare_vertices);
+	for (i = 1; ok && i < result->vertex_count; i++) {
+		if (memcmp(sorted + (i - 1) * vertex_size, sorted + i * vertex_size, vertex_size) == 0) {
+			printf("  vertices are not welded\n");
+			ok = 0;
+		}
+	}
+
+	free(sorted);
+	free(used);
+
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long triangles = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+	unsigned int i;
+	int ok = 1;
+
+	printf("%-13s %8s %8s %8s %10s %12s %8s %8s\n", "shape", "vertices", "tris",
+		"meshes", "ms", "ms/Mtri", "misses", "rows");
+
+	for (i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+		const struct bench_shape *bench = &shapes[i];
+		struct mesh_gen_result result;
+		unsigned int vertex_count, index_count, meshes, mesh;
+		unsigned short *indices;
+		uint64_t start, ns;
+		void *vertices;
+		float rows = 0.0f;
+
+		if (mesh_gen_count(&bench->shape, bench->format, &vertex_count, &index_count) < 0) {
+			printf("%-13s does not fit\n", bench->name);
+			ok = 0;
+			continue;
+		}
+
+		vertices = malloc(vertex_count * mesh_gen_vertex_size(bench->format));
+		indices = malloc(index_count * sizeof(*indices));
+		meshes = (triangles + index_count / 3 - 1) / (index_count / 3);
+		if (!meshes)
+			meshes = 1;
+
+		start = time_get_ns();
+		for (mesh = 0; mesh < meshes; mesh++)
+			mesh_gen_generate(&bench->shape, bench->format, vertices, indices, &result);
+		ns = time_get_ns() - start;
+
+		if (bench->shape.type == MESH_GEN_PLANE || bench->shape.type == MESH_GEN_SPHERE)
+			rows = row_order_misses(&bench->shape, vertex_count);
+
+		printf("%-13s %8u %8u %8u %10.3f %12.3f %8.3f ", bench->name, result.vertex_count,
+			result.index_count / 3, meshes, time_ns_to_ms(ns),
+			time_ns_to_ms(ns) / ((double)meshes * result.index_count / 3 / 1e6),
+			cache_misses(indices, result.index_count, result.vertex_count));
+		if (rows > 0.0f)
+			printf("%8.3f\n", rows);
+		else
+			printf("%8s\n", "-");
+
+		ok &= check(bench, vertices, indices, &result);
+
+		free(vertices);
+		free(indices);
+	}
+
+	printf("%s\n", ok ? "ok" : "FAILED");
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+/*
+ * Mesh load benchmark.
+ *
+ * Compares the two ways the demo gets a mesh ready to draw: building it
+ * at startup (a tessellated sphere computed per vertex, then its levels
+ * of detail simplified the way mesh_build_lods() does) and loading the
+ * same mesh from a mesh file with the levels precomputed, one read into
+ * memory and a check of the header. Reports the time of each and the
+ * read throughput, and checks that the file round-trips.
+ *
+ * Usage: mesh_load_bench [sphere_rings] [iterations] [file]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math_utils.h"
+#include "mesh_file.h"
+#include "mesh_simplify.h"
+#include "time_utils.h"
+
+/* As in main.c */
+#define LOD_MAX_ERROR 0.05f
+#define LOD_MIN_REDUCTION 0.8f
+
+struct vertex {
+	vector3f position;
+	vector3f normal;
+	vector4f color;
+};
+
+struct mesh {
+	struct mesh_file_header header;
+	struct vertex *vertices;
+	unsigned short *lods[MESH_FILE_MAX_LODS];
+};
+
+static void make_sphere(struct mesh *mesh, unsigned int rings)
+{
+	unsigned int segments = rings * 2;
+	unsigned int count = 0;
+	unsigned int r, s;
+	unsigned short *indices = mesh->lods[0];
+
+	for (r = 0; r <= rings; r++) {
+		float theta = M_PI * r / rings;
+
+		for (s = 0; s <= segments; s++) {
+			float phi = 2.0f * M_PI * (s % segments) / segments;
+			struct vertex *v = &mesh->vertices[r * (segments + 1) + s];
+
+			vector3f_init(&v->normal, sinf(theta) * cosf(phi), cosf(theta),
+				sinf(theta) * sinf(phi));
+			if (r == 0 || r == rings)
+				vector3f_init(&v->normal, 0.0f, r ? -1.0f : 1.0f, 0.0f);
+			v->position = v->normal;
+			vector4f_init(&v->color, 0.5f + 0.5f * v->normal.x, 0.5f + 0.5f * v->normal.y,
+				0.5f + 0.5f * v->normal.z, 1.0f);
+		}
+	}
+
+	for (r = 0; r < rings; r++) {
+		for (s = 0; s < segments; s++) {
+			unsigned short a = r * (segments + 1) + s;
+			unsigned short b = a + segments + 1;
+
+			if (r != 0) {
+				indices[count++] = a;
+				indices[count++] = b;
+				indices[count++] = a + 1;
+			}
+			if (r != rings - 1) {
+				indices[count++] = a + 1;
+				indices[count++] = b;
+				indices[count++] = b + 1;
+			}
+		}
+	}
+
+	memset(&mesh->header, 0, sizeof(mesh->header));
+	mesh->header.vertex_format = MESH_FILE_VERTEX_POSITION_NORMAL_COLOR;
+	mesh->header.vertex_size = sizeof(struct vertex);
+	mesh->header.vertex_count = (rings + 1) * (segments + 1);
+	mesh->header.primitive = MESH_FILE_PRIMITIVE_TRIANGLES;
+	mesh->header.lod_count = 1;
+	mesh->header.lods[0].index_count = count;
+	for (r = 0; r < 3; r++) {
+		mesh->header.bounds_min[r] = -1.0f;
+		mesh->header.bounds_max[r] = 1.0f;
+	}
+	mesh->header.radius = 1.0f;
+}
+
+static int build_lods(struct mesh *mesh)
+{
+	struct mesh_file_header *header = &mesh->header;
+
+	while (header->lod_count < MESH_FILE_MAX_LODS) {
+		const struct mesh_file_lod *previous = &header->lods[header->lod_count - 1];
+		struct mesh_file_lod *lod = &header->lods[header->lod_count];
+		float error;
+		int count;
+
+		count = mesh_simplify(mesh->lods[header->lod_count], mesh->lods[header->lod_count - 1],
+			previous->index_count, mesh->vertices, header->vertex_count,
+			sizeof(struct vertex), previous->index_count / 2,
+			header->radius * LOD_MAX_ERROR, &error);
+		if (count < 0)
+			return -1;
+		if (count > previous->index_count * LOD_MIN_REDUCTION)
+			break;
+
+		lod->index_count = count;
+		lod->error = previous->error + error;
+		header->lod_count++;
+	}
+
+	return 0;
+}
+
+static int same_mesh(const struct mesh *mesh, const struct mesh_file_header *header)
+{
+	unsigned int i;
+
+	if (header->vertex_count != mesh->header.vertex_count ||
+	    header->lod_count != mesh->header.lod_count ||
+	    memcmp(mesh_file_vertices(header), mesh->vertices,
+	    header->vertex_count * sizeof(struct vertex)))
+		return 0;
+
+	for (i = 0; i < header->lod_count; i++) {
+		if (header->lods[i].index_count != mesh->header.lods[i].index_count ||
+		    memcmp(mesh_file_indices(header, i), mesh->lods[i],
+		    header->lods[i].index_count * sizeof(unsigned short)))
+			return 0;
+	}
+
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int rings = argc > 1 ? strtoul(argv[1], NULL, 0) : 180;
+	unsigned int iterations = argc > 2 ? strtoul(argv[2], NULL, 0) : 10;
+	const char *path = argc > 3 ? argv[3] : "mesh_load_bench.gxmm";
+	unsigned int max_vertices = (rings + 1) * (rings * 2 + 1);
+	const struct mesh_file_header *loaded = NULL;
+	uint64_t build_ns = 0, load_ns = 0;
+	size_t size = 0;
+	struct mesh mesh;
+	void *data = NULL;
+	unsigned int lod, i;
+	int ok;
+
+	if (!rings || max_vertices > 65536 || !iterations) {
+		fprintf(stderr, "sphere_rings must be 1 to 180, iterations at least 1\n");
+		return 1;
+	}
+
+	mesh.vertices = malloc(max_vertices * sizeof(*mesh.vertices));
+	for (lod = 0; lod < MESH_FILE_MAX_LODS; lod++)
+		mesh.lods[lod] = malloc(rings * rings * 2 * 6 * sizeof(unsigned short));
+
+	for (i = 0; i < iterations; i++) {
+		uint64_t start = time_get_ns();
+
+		make_sphere(&mesh, rings);
+		if (build_lods(&mesh) < 0) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		build_ns += time_get_ns() - start;
+	}
+
+	if (mesh_file_write(path, &mesh.header, mesh.vertices,
+	    (const unsigned short *const *)mesh.lods) < 0) {
+		fprintf(stderr, "Could not write %s\n", path);
+		return 1;
+	}
+
+	for (i = 0; i < iterations; i++) {
+		uint64_t start = time_get_ns();
+		FILE *file = mesh_file_open(path, &size);
+
+		if (!file)
+			break;
+		free(data);
+		data = malloc(size);
+		loaded = mesh_file_read(file, data, size);
+		load_ns += time_get_ns() - start;
+		if (!loaded)
+			break;
+	}
+
+	ok = loaded && same_mesh(&mesh, loaded);
+
+	printf("sphere: %u vertices, %u triangles, %u levels of detail, %u iterations\n",
+		mesh.header.vertex_count, mesh.header.lods[0].index_count / 3,
+		mesh.header.lod_count, iterations);
+	printf("build: %.3f ms\n", time_ns_to_ms(build_ns) / iterations);
+	printf("load:  %.3f ms, %.2f MB, %.1f MB/s, %.1fx faster\n",
+		time_ns_to_ms(load_ns) / iterations, size / (1024.0f * 1024.0f),
+		size / (1024.0f * 1024.0f) / (time_ns_to_ms(load_ns) / iterations / 1000.0f),
+		(float)build_ns / load_ns);
+	printf("round trip: %s\n", ok ? "ok" : "FAILED");
+
+	remove(path);
+	free(data);
+	for (lod = 0; lod < MESH_FILE_MAX_LODS; lod++)
+		free(mesh.lods[lod]);
+	free(mesh.vertices);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+/*
+ * Profiler marker overhead benchmark.
+ *
+ * Times a loop of empty scoped markers on 1 to N threads while the main
+ * thread keeps collecting the events, as the frame loop does, and reports
+ * the CPU cost of a marker next to the cost of the clock read it does
+ * twice.
+ *
+ * Usage: profiler_bench [max_threads] [markers_per_thread]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "profiler.h"
+#include "time_utils.h"
+
+#define MAX_THREADS 16
+/* Often enough that the thread rings do not wrap between two collections */
+#define COLLECT_INTERVAL_US 200
+#define CLOCK_READS 1000000
+
+static unsigned int markers_per_thread;
+static int running;
+
+static void *worker_thread(void *arg)
+{
+	unsigned int i;
+
+	profiler_set_thread_name("bench");
+
+	for (i = 0; i < markers_per_thread; i++) {
+		PROFILE_SCOPE(marker, "marker");
+		__asm__ volatile("" ::: "memory");
+	}
+
+	__atomic_sub_fetch(&running, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static float clock_read_ns(void)
+{
+	uint64_t start = time_get_ns();
+	volatile uint64_t ticks;
+	unsigned int i;
+
+	for (i = 0; i < CLOCK_READS; i++)
+		ticks = profiler_ticks();
+	(void)ticks;
+
+	return (float)(time_get_ns() - start) / CLOCK_READS;
+}
+
+static int run(unsigned int thread_count, unsigned int cpu_count)
+{
+	pthread_t threads[MAX_THREADS];
+	unsigned int busy_cpus = thread_count < cpu_count ? thread_count : cpu_count;
+	uint64_t start, ns;
+	unsigned int i;
+
+	if (profiler_init(NULL) < 0)
+		return -1;
+
+	start = time_get_ns();
+	running = thread_count;
+	for (i = 0; i < thread_count; i++) {
+		if (pthread_create(&threads[i], NULL, worker_thread, NULL) != 0)
+			return -1;
+	}
+
+	while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+		usleep(COLLECT_INTERVAL_US);
+		profiler_collect();
+	}
+
+	for (i = 0; i < thread_count; i++)
+		pthread_join(threads[i], NULL);
+	ns = time_get_ns() - start;
+
+	printf("%2u threads: %.1f ns per marker\n", thread_count,
+		(double)ns * busy_cpus / ((uint64_t)thread_count * markers_per_thread));
+	profiler_print_summary();
+	profiler_finish();
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int max_threads = argc > 1 ? strtoul(argv[1], NULL, 0) : 4;
+	unsigned int cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int threads;
+
+	markers_per_thread = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000000;
+
+	if (!PROFILER_ENABLED) {
+		printf("The markers are compiled out (PROFILER_ENABLED=0)\n");
+		return 0;
+	}
+
+	if (max_threads < 1)
+		max_threads = 1;
+	if (max_threads > MAX_THREADS)
+		max_threads = MAX_THREADS;
+
+	printf("%u CPUs, clock read %.1f ns\n", cpu_count, clock_read_ns());
+
+	for (threads = 1; threads <= max_threads; threads *= 2) {
+		if (run(threads, cpu_count) < 0) {
+			fprintf(stderr, "Could not run with %u threads\n", threads);
+			return 1;
+		}
+	}
+
+	return 0;
+}
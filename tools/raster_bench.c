@@ -0,0 +1,149 @@
+/*
+ * Host rasterizer scaling benchmark.
+ *
+ * Runs the demo (built for the host) headless over the current scene with
+ * 1 to N raster threads, checks that the first frame is bit-identical for
+ * every thread count and reports the frame time, raster time, fill rate
+ * and speedup.
+ *
+ * Usage: raster_bench [gxmfun] [max_threads] [frames]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_THREADS 16
+#define DUMP_PATTERN "raster_bench_%u_%%u.ppm"
+
+struct result {
+	float frame_ms;
+	float raster_ms;
+	float mpixels_per_second;
+};
+
+static int run(const char *program, unsigned int threads, unsigned int frames,
+	struct result *result)
+{
+	char command[512], value[64], line[512];
+	float geometry_ms, covered, shaded, triangles;
+	unsigned int n;
+	int found = 0;
+	FILE *pipe;
+
+	snprintf(value, sizeof(value), "%u", threads);
+	setenv("GXMFUN_HOST_RASTER_THREADS", value, 1);
+	setenv("GXMFUN_HOST_STATS", "1", 1);
+	/* Only the first frame is dumped, it does not depend on timing */
+	snprintf(value, sizeof(value), DUMP_PATTERN, threads);
+	setenv("GXMFUN_HOST_DUMP", value, 1);
+	snprintf(value, sizeof(value), "%u", frames + 1);
+	setenv("GXMFUN_HOST_DUMP_INTERVAL", value, 1);
+
+	snprintf(command, sizeof(command), "%s --frames=%u --report-interval=%u --vsync=off",
+		program, frames, frames);
+
+	pipe = popen(command, "r");
+	if (!pipe)
+		return -1;
+
+	while (fgets(line, sizeof(line), pipe)) {
+		if (sscanf(line, "frames %u: frame %f ms", &n, &result->frame_ms) == 2)
+			found |= 1;
+		else if (sscanf(line, "host gxm: %u raster threads, %u scenes, %f triangles, "
+			"geometry %f ms, raster %f ms per scene, %f Mpixels covered, "
+			"%f Mpixels shaded per scene, %f Mpixels/s", &n, &n, &triangles,
+			&geometry_ms, &result->raster_ms, &covered, &shaded,
+			&result->mpixels_per_second) == 8)
+			found |= 2;
+	}
+
+	if (pclose(pipe) != 0 || found != 3)
+		return -1;
+
+	return 0;
+}
+
+/* Path of the first frame dumped by the run with the given thread count */
+static void dump_path(char *path, size_t size, unsigned int threads)
+{
+	char pattern[64];
+
+	snprintf(pattern, sizeof(pattern), DUMP_PATTERN, threads);
+	snprintf(path, size, pattern, 0);
+}
+
+static int same_file(const char *a, const char *b)
+{
+	FILE *fa = fopen(a, "rb");
+	FILE *fb = fopen(b, "rb");
+	int ca, cb, same = fa && fb;
+
+	while (same) {
+		ca = fgetc(fa);
+		cb = fgetc(fb);
+		if (ca != cb)
+			same = 0;
+		if (ca == EOF)
+			break;
+	}
+
+	if (fa)
+		fclose(fa);
+	if (fb)
+		fclose(fb);
+
+	return same;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *program = argc > 1 ? argv[1] : "./gxmfun";
+	unsigned int max_threads = argc > 2 ? atoi(argv[2]) : 0;
+	unsigned int frames = argc > 3 ? atoi(argv[3]) : 100;
+	char reference[64], dump[64];
+	float single_thread_ms = 0.0f;
+	unsigned int threads;
+	int failed = 0;
+
+	if (max_threads == 0)
+		max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (max_threads > MAX_THREADS)
+		max_threads = MAX_THREADS;
+	if (frames < 2)
+		frames = 2;
+
+	printf("%s, %u frames\n", program, frames);
+	printf("threads    frame ms   raster ms  Mpixels/s   speedup  efficiency\n");
+
+	dump_path(reference, sizeof(reference), 1);
+
+	for (threads = 1; threads <= max_threads; threads++) {
+		struct result result;
+
+		if (run(program, threads, frames, &result) < 0) {
+			fprintf(stderr, "%u threads: could not run %s\n", threads, program);
+			return 1;
+		}
+
+		dump_path(dump, sizeof(dump), threads);
+		if (!same_file(dump, reference)) {
+			fprintf(stderr, "%u threads: %s differs from %s\n", threads, dump, reference);
+			failed = 1;
+		}
+		if (threads > 1)
+			remove(dump);
+
+		if (threads == 1)
+			single_thread_ms = result.raster_ms;
+
+		printf("%7u %11.3f %11.3f %10.1f %8.2fx %10.0f%%\n", threads,
+			result.frame_ms, result.raster_ms, result.mpixels_per_second,
+			single_thread_ms / result.raster_ms,
+			100.0f * single_thread_ms / (result.raster_ms * threads));
+	}
+
+	remove(reference);
+
+	return failed;
+}
@@ -0,0 +1,292 @@
+/*
+ * Texture encoder.
+ *
+ * Converts a binary PPM (P6) image, or a generated test pattern, to the
+ * texture file of include/texture_file.h read by gxmfun --texture=FILE:
+ * a box filtered mip chain, each level compressed to UBC1 (4 bits per
+ * texel) or UBC3 (8 bits per texel, with alpha) or kept as 32-bit RGBA,
+ * in the swizzled order the GPU samples. Prints the size of each level
+ * and the PSNR of its decoded texels, and the size of the chain next to
+ * the same chain in RGBA.
+ *
+ * PPM images are opaque. The width and the height must be powers of two
+ * up to TEXTURE_FILE_MAX_SIZE.
+ *
+ * Usage: texture_encode [options] input.ppm|--pattern=SIZE output
+ *   --format=ubc1|ubc3|rgba8  format of the levels (ubc1)
+ *   --levels=N                levels of the chain, 0 for all down to 1x1 (0)
+ *   --pattern=SIZE            encode a SIZE by SIZE tiled test pattern
+ */
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "texture_compress.h"
+#include "texture_file.h"
+#include "time_utils.h"
+
+#define PATTERN_TILES 8
+
+static void *xmalloc(size_t size)
+{
+	void *p = malloc(size);
+
+	if (!p) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	return p;
+}
+
+static int is_power_of_two(unsigned int x)
+{
+	return x && !(x & (x - 1));
+}
+
+/* Skip whitespace and # comments between the fields of a PPM header */
+static int read_ppm_value(FILE *file, unsigned int *value)
+{
+	int c = fgetc(file);
+
+	for (;;) {
+		if (c == '#') {
+			while (c != '\n' && c != EOF)
+				c = fgetc(file);
+		} else if (isspace(c)) {
+			c = fgetc(file);
+		} else {
+			break;
+		}
+	}
+
+	if (!isdigit(c))
+		return -1;
+
+	*value = 0;
+	while (isdigit(c)) {
+		*value = *value * 10 + (c - '0');
+		c = fgetc(file);
+	}
+
+	/* The single whitespace ending the header */
+	return isspace(c) ? 0 : -1;
+}
+
+static uint8_t *load_ppm(const char *path, unsigned int *width, unsigned int *height)
+{
+	unsigned int max_value, i;
+	uint8_t *rgba = NULL;
+	char magic[2];
+	FILE *file;
+
+	file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "Could not open %s\n", path);
+		return NULL;
+	}
+
+	if (fread(magic, 1, 2, file) != 2 || magic[0] != 'P' || magic[1] != '6' ||
+	    read_ppm_value(file, width) < 0 || read_ppm_value(file, height) < 0 ||
+	    read_ppm_value(file, &max_value) < 0 || max_value != 255) {
+		fprintf(stderr, "%s: expected a binary PPM with 8-bit channels\n", path);
+		goto out;
+	}
+
+	if (!is_power_of_two(*width) || *width > TEXTURE_FILE_MAX_SIZE ||
+	    !is_power_of_two(*height) || *height > TEXTURE_FILE_MAX_SIZE) {
+		fprintf(stderr, "%s: %ux%u, the sides must be powers of two up to %u\n", path,
+			*width, *height, TEXTURE_FILE_MAX_SIZE);
+		goto out;
+	}
+
+	rgba = xmalloc((size_t)*width * *height * 4);
+	for (i = 0; i < *width * *height; i++) {
+		if (fread(&rgba[i * 4], 1, 3, file) != 3) {
+			fprintf(stderr, "%s: truncated\n", path);
+			free(rgba);
+			rgba = NULL;
+			goto out;
+		}
+		rgba[i * 4 + 3] = 255;
+	}
+
+out:
+	fclose(file);
+	return rgba;
+}
+
+/*
+ * Tiles of a few colors in a checkerboard, with fine diagonal stripes and
+ * dark grout between them: detail that aliases without mipmaps.
+ */
+static uint8_t *generate_pattern(unsigned int size)
+{
+	static const uint8_t colors[][3] = {
+		{200, 80, 60}, {90, 160, 70}, {70, 110, 190},
+		{210, 180, 80}, {150, 90, 170}, {80, 170, 170},
+	};
+	unsigned int tile = size >= PATTERN_TILES ? size / PATTERN_TILES : 1;
+	uint8_t *rgba = xmalloc((size_t)size * size * 4);
+	unsigned int x, y, i;
+
+	for (y = 0; y < size; y++) {
+		for (x = 0; x < size; x++) {
+			unsigned int tx = x / tile, ty = y / tile;
+			const uint8_t *color = colors[(tx + ty * 3) % (sizeof(colors) / sizeof(colors[0]))];
+			float shade = (tx + ty) % 2 ? 1.0f : 0.75f;
+			uint8_t *texel = &rgba[(y * size + x) * 4];
+
+			if (x % tile < tile / 16 + 1 || y % tile < tile / 16 + 1)
+				shade = 0.2f;
+			else if ((x + y) / 2 % 2)
+				shade *= 0.85f;
+
+			for (i = 0; i < 3; i++)
+				texel[i] = (uint8_t)(color[i] * shade);
+			texel[3] = 255;
+		}
+	}
+
+	return rgba;
+}
+
+static float psnr(const uint8_t *a, const uint8_t *b, size_t texels, int alpha)
+{
+	double error = 0.0;
+	size_t i, j;
+
+	for (i = 0; i < texels; i++) {
+		for (j = 0; j < (alpha ? 4 : 3); j++) {
+			int d = a[i * 4 + j] - b[i * 4 + j];
+			error += d * d;
+		}
+	}
+
+	if (error == 0.0)
+		return INFINITY;
+
+	return 10.0 * log10(255.0 * 255.0 / (error / (texels * (alpha ? 4 : 3))));
+}
+
+static void print_usage(const char *program)
+{
+	fprintf(stderr,
+		"Usage: %s [options] input.ppm|--pattern=SIZE output\n"
+		"  --format=ubc1|ubc3|rgba8  format of the levels (ubc1)\n"
+		"  --levels=N                levels of the chain, 0 for all down to 1x1 (0)\n"
+		"  --pattern=SIZE            encode a SIZE by SIZE tiled test pattern\n",
+		program);
+}
+
+int main(int argc, char *argv[])
+{
+	enum texture_file_format format = TEXTURE_FILE_FORMAT_UBC1;
+	struct texture_file_header header;
+	const char *input = NULL, *output = NULL;
+	unsigned int levels = 0, pattern = 0, width, height, max_levels, i;
+	uint8_t *image, *next, *decoded, *data, *level;
+	uint64_t encode_ns = 0, start;
+	size_t rgba_size;
+	int arg;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp(argv[arg], "--format=", 9) == 0) {
+			for (format = 0; format < TEXTURE_FILE_FORMAT_COUNT; format++) {
+				if (strcmp(argv[arg] + 9, texture_file_format_name(format)) == 0)
+					break;
+			}
+			if (format == TEXTURE_FILE_FORMAT_COUNT)
+				break;
+		} else if (strncmp(argv[arg], "--levels=", 9) == 0) {
+			levels = strtoul(argv[arg] + 9, NULL, 0);
+			if (levels > TEXTURE_FILE_MAX_LEVELS)
+				break;
+		} else if (strncmp(argv[arg], "--pattern=", 10) == 0) {
+			pattern = strtoul(argv[arg] + 10, NULL, 0);
+			if (!is_power_of_two(pattern) || pattern > TEXTURE_FILE_MAX_SIZE)
+				break;
+		} else if (!input && !pattern) {
+			input = argv[arg];
+		} else if (!output) {
+			output = argv[arg];
+		} else {
+			break;
+		}
+	}
+
+	if (arg < argc || !output) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if (pattern) {
+		width = height = pattern;
+		image = generate_pattern(pattern);
+	} else {
+		image = load_ppm(input, &width, &height);
+		if (!image)
+			return 1;
+	}
+
+	for (max_levels = 1; (width | height) >> max_levels; max_levels++)
+		;
+	if (!levels || levels > max_levels)
+		levels = max_levels;
+
+	memset(&header, 0, sizeof(header));
+	header.format = format;
+	header.width = width;
+	header.height = height;
+	header.level_count = levels;
+
+	data = xmalloc(texture_file_data_size(format, width, height, levels));
+	decoded = xmalloc((size_t)width * height * 4);
+	next = xmalloc((size_t)width * height * 4);
+
+	printf("%s: %s %ux%u, %u levels\n", output, texture_file_format_name(format),
+		width, height, levels);
+
+	level = data;
+	for (i = 0; i < levels; i++) {
+		unsigned int level_width = width >> i ? width >> i : 1;
+		unsigned int level_height = height >> i ? height >> i : 1;
+		uint8_t *swap;
+
+		start = time_get_ns();
+		texture_compress_level(format, image, level_width, level_height, level);
+		encode_ns += time_get_ns() - start;
+
+		texture_decompress_level(format, level, level_width, level_height, decoded);
+		printf("  level %u: %ux%u, %zu bytes, PSNR %.2f dB\n", i, level_width, level_height,
+			texture_file_level_size(format, level_width, level_height),
+			psnr(image, decoded, (size_t)level_width * level_height,
+				format != TEXTURE_FILE_FORMAT_UBC1));
+
+		level += texture_file_level_size(format, level_width, level_height);
+		if (i + 1 < levels) {
+			texture_compress_downsample(image, level_width, level_height, next);
+			swap = image;
+			image = next;
+			next = swap;
+		}
+	}
+
+	if (texture_file_write(output, &header, data) < 0) {
+		fprintf(stderr, "Could not write %s\n", output);
+		return 1;
+	}
+
+	rgba_size = texture_file_data_size(TEXTURE_FILE_FORMAT_RGBA8, width, height, levels);
+	printf("%u bytes, %zu in RGBA (%.1fx), encoded in %.3f ms\n", header.size, rgba_size,
+		(double)rgba_size / texture_file_data_size(format, width, height, levels),
+		time_ns_to_ms(encode_ns));
+
+	free(image);
+	free(next);
+	free(decoded);
+	free(data);
+
+	return 0;
+}